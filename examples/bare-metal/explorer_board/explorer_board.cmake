@@ -54,7 +54,7 @@ target_sources(example_bare_metal_explorer_board PUBLIC ${APP_SOURCES})
 target_include_directories(example_bare_metal_explorer_board PUBLIC ${APP_INCLUDES})
 target_compile_definitions(example_bare_metal_explorer_board PRIVATE ${APP_COMPILE_DEFINITIONS})
 target_compile_options(example_bare_metal_explorer_board PRIVATE ${APP_COMPILER_FLAGS})
-target_link_libraries(example_bare_metal_explorer_board PUBLIC core::general io::all core::multitile_support)
+target_link_libraries(example_bare_metal_explorer_board PUBLIC core::general io::all core::multitile_support sdk::bm_pipeline sdk::bm_worker_pool sdk::button_engine sdk::qspi_flash_cal::qspi_io)
 target_link_options(example_bare_metal_explorer_board PRIVATE ${APP_LINK_OPTIONS})
 
 # MCLK_FREQ,  PDM_FREQ, MIC_COUNT,  SAMPLES_PER_FRAME
@@ -18,4 +18,13 @@
 #define appconfPDM_CLOCK_FREQUENCY              3072000
 #define appconfPIPELINE_AUDIO_SAMPLE_RATE       16000
 
+/* GPIO Configuration, in reference clock ticks */
+#define appconfGPIO_DEBOUNCE_TICKS              (20 * 100000)   /* 20 ms */
+#define appconfGPIO_LONG_PRESS_TICKS            (1000 * 100000) /* 1 s */
+#define appconfGPIO_REPEAT_DELAY_TICKS          (500 * 100000)  /* 500 ms */
+#define appconfGPIO_REPEAT_PERIOD_TICKS         (100 * 100000)  /* 100 ms */
+
+/* QSPI flash timing calibration, kept in the last 4 KiB sector of the flash */
+#define appconfFLASH_CAL_ADDR                   0x3FF000
+
 #endif /* APP_CONF_H_ */
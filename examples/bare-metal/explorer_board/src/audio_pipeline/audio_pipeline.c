@@ -5,7 +5,6 @@
 #include <platform.h>
 #include <xs1.h>
 #include <string.h>
-#include <xcore/triggerable.h>
 
 /* SDK headers */
 #include "xcore_utils.h"
@@ -16,141 +15,152 @@
 #include "app_conf.h"
 #include "audio_pipeline.h"
 
-//#include <hwtimer.h>
-void ap_stage_a(chanend_t c_input, chanend_t c_output) {
-    // initialise the array which will hold the data
-    int32_t DWORD_ALIGNED input [appconfAUDIO_FRAME_LENGTH][appconfMIC_COUNT];
-    int32_t DWORD_ALIGNED output [appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
+/* Frames are passed between stages in [channel][sample] order */
+typedef struct {
+    int32_t samples[appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
+} ap_frame_t;
 
-    while(1)
-    {
-        // get the frame from the mic array
-        ma_frame_rx_transpose((int32_t *) input, c_input, appconfMIC_COUNT, appconfAUDIO_FRAME_LENGTH);
-        // change the frame format to [channel][sample]
-        for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
-            for(int smp = 0; smp < appconfAUDIO_FRAME_LENGTH; smp ++){
-                output[ch][smp] = input[smp][ch];
-            }
-        }
-        // send the frame to the next stage
-        s_chan_out_buf_word(c_output, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
-    }
-}
+typedef struct {
+    chanend_t c_mic;
+    int32_t DWORD_ALIGNED input[appconfAUDIO_FRAME_LENGTH][appconfMIC_COUNT];
+} ap_stage_a_state_t;
 
-void ap_stage_b(chanend_t c_input, chanend_t c_output, chanend_t c_from_gpio) {
-    // initialise the array which will hold the data
-    int32_t DWORD_ALIGNED output[appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
-    // initialise block floating point structures for both channels
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, output[0], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
-    bfp_s32_init(&ch1, output[1], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+typedef struct {
+    int gain_db;
+} ap_stage_b_state_t;
 
-    int gain_db = appconfINITIAL_GAIN;
+typedef struct {
+    const ap_frame_t *in;
+    ap_frame_t *out;
+    float_s32_t gain;
+} ap_gain_job_t;
 
-    triggerable_disable_all();
-    // initialise events
-    TRIGGERABLE_SETUP_EVENT_VECTOR(c_input, input_frames);
-    TRIGGERABLE_SETUP_EVENT_VECTOR(c_from_gpio, gpio_request);
+typedef struct {
+    chanend_t c_output;
+    chanend_t c_to_gpio;
+    int32_t DWORD_ALIGNED output[appconfAUDIO_FRAME_LENGTH][appconfMIC_COUNT];
+} ap_stage_c_state_t;
 
-    triggerable_enable_trigger(c_input);
-    triggerable_enable_trigger(c_from_gpio);
+static ap_stage_a_state_t stage_a_state;
+static ap_stage_b_state_t stage_b_state;
+static ap_stage_c_state_t stage_c_state;
 
-    while(1)
-    {
-        TRIGGERABLE_WAIT_EVENT(input_frames, gpio_request);
-        {
-            input_frames:
-            {
-                // recieve frame over the channel
-                s_chan_in_buf_word(c_input, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
-                // calculate the headroom of the new frames
-                bfp_s32_headroom(&ch0);
-                bfp_s32_headroom(&ch1);
-                // update the gain
-                float power = (float)gain_db / 20.0;
-                float gain_fl = powf(10.0, power);
-                float_s32_t gain = float_to_float_s32(gain_fl);
-                // scale both channels 
-                bfp_s32_scale(&ch0, &ch0, gain);
-                bfp_s32_scale(&ch1, &ch1, gain);
-                // normalise exponent
-                bfp_s32_use_exponent(&ch0, appconfEXP);
-                bfp_s32_use_exponent(&ch1, appconfEXP);
-                // send frame over the channel
-                s_chan_out_buf_word(c_output, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
-            }
-            continue;
-        }
-        {
-            gpio_request:
-            {
-                char msg = chanend_in_byte(c_from_gpio);
-                switch(msg)
-                {
-                default:
-                    break;
-                case 0x01:  /* Btn A */
-                    gain_db = (gain_db >= appconfAUDIO_PIPELINE_MAX_GAIN) ? gain_db : gain_db + appconfAUDIO_PIPELINE_GAIN_STEP;
-                    break;
-                case 0x02:  /* Btn B */
-                    gain_db = (gain_db <= appconfAUDIO_PIPELINE_MIN_GAIN) ? gain_db : gain_db - appconfAUDIO_PIPELINE_GAIN_STEP;
-                    break;
-                }
-                debug_printf("Gain set to %f\n", gain_db);
-            }
-            continue;
+bm_worker_pool_t ap_worker_pool;
+
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_a(ap_stage_a_state_t *state, const void *in, ap_frame_t *out);
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_b(ap_stage_b_state_t *state, const ap_frame_t *in, ap_frame_t *out);
+BM_PIPELINE_CTRL_ATTR static void ap_stage_b_ctrl(ap_stage_b_state_t *state, chanend_t c_from_gpio);
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_c(ap_stage_c_state_t *state, const ap_frame_t *in, void *out);
+
+BM_PIPELINE_HOP(hop_ab, ap_frame_t);
+BM_PIPELINE_HOP(hop_bc, ap_frame_t);
+
+BM_PIPELINE_STAGE(stage_a, NULL, &hop_ab, ap_stage_a, &stage_a_state);
+BM_PIPELINE_STAGE(stage_b, &hop_ab, &hop_bc, ap_stage_b, &stage_b_state);
+BM_PIPELINE_STAGE(stage_c, &hop_bc, NULL, ap_stage_c, &stage_c_state);
+
+bm_pipeline_stage_t *const ap_stages[AP_STAGES] = {&stage_a, &stage_b, &stage_c};
+
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_a(ap_stage_a_state_t *state, const void *in, ap_frame_t *out)
+{
+    // get the frame from the mic array
+    ma_frame_rx_transpose((int32_t *) state->input, state->c_mic, appconfMIC_COUNT, appconfAUDIO_FRAME_LENGTH);
+    // change the frame format to [channel][sample], straight into the next stage's buffer
+    for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
+        for(int smp = 0; smp < appconfAUDIO_FRAME_LENGTH; smp ++){
+            out->samples[ch][smp] = state->input[smp][ch];
         }
     }
 }
 
-void ap_stage_c(chanend_t c_input, chanend_t c_output, chanend_t c_to_gpio) {
-
-    int32_t DWORD_ALIGNED input[appconfMIC_COUNT][appconfAUDIO_FRAME_LENGTH];
-    int32_t DWORD_ALIGNED output[appconfAUDIO_FRAME_LENGTH][appconfMIC_COUNT];
-    // initialise block floating point structures for both channels
-    bfp_s32_t ch0, ch1;
-    bfp_s32_init(&ch0, input[0], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
-    bfp_s32_init(&ch1, input[1], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+BM_WORKER_POOL_ATTR static void ap_gain_channels(ap_gain_job_t *job, size_t begin, size_t end)
+{
+    for(size_t ch = begin; ch < end; ch ++){
+        bfp_s32_t ch_in, ch_out;
+        // the input frame is only read, so the headroom is calculated on init
+        bfp_s32_init(&ch_in, (int32_t *) job->in->samples[ch], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
+        bfp_s32_init(&ch_out, job->out->samples[ch], appconfEXP, appconfAUDIO_FRAME_LENGTH, 0);
+        // scale the channel into the next stage's buffer
+        bfp_s32_scale(&ch_out, &ch_in, job->gain);
+        // normalise exponent
+        bfp_s32_use_exponent(&ch_out, appconfEXP);
+    }
+}
 
-    triggerable_disable_all();
-    // initialise event
-    TRIGGERABLE_SETUP_EVENT_VECTOR(c_input, input_frames);
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_b(ap_stage_b_state_t *state, const ap_frame_t *in, ap_frame_t *out)
+{
+    // update the gain
+    float power = (float)state->gain_db / 20.0;
+    float gain_fl = powf(10.0, power);
+    ap_gain_job_t job = {
+        .in = in,
+        .out = out,
+        .gain = float_to_float_s32(gain_fl),
+    };
 
-    triggerable_enable_trigger(c_input);
+    // share the channels between this thread and the pool's workers
+    bm_worker_pool_parallel_for(&ap_worker_pool, (bm_worker_pool_fn_t) ap_gain_channels, &job, appconfMIC_COUNT);
+}
 
-    while(1)
+BM_PIPELINE_CTRL_ATTR static void ap_stage_b_ctrl(ap_stage_b_state_t *state, chanend_t c_from_gpio)
+{
+    int gain_db = state->gain_db;
+    char msg = chanend_in_byte(c_from_gpio);
+    switch(msg)
     {
-        TRIGGERABLE_WAIT_EVENT(input_frames);
-        {
-            input_frames:
-            {
-                uint8_t led_byte = 0;
-                // recieve frame over the channel
-                s_chan_in_buf_word(c_input, (uint32_t*) input, appconfFRAMES_IN_ALL_CHANS);
-                // calculate the headroom of the new frames
-                bfp_s32_headroom(&ch0);
-                bfp_s32_headroom(&ch1);
-                // calculate the frame energy
-                float_s32_t frame_energy_ch0 = float_s64_to_float_s32(bfp_s32_energy(&ch0));
-                float_s32_t frame_energy_ch1 = float_s64_to_float_s32(bfp_s32_energy(&ch1));
-                // calculate the frame power
-                float frame_pow0 = float_s32_to_float(frame_energy_ch0) / (float)appconfAUDIO_FRAME_LENGTH;
-                float frame_pow1 = float_s32_to_float(frame_energy_ch1) / (float)appconfAUDIO_FRAME_LENGTH;
-                if((frame_pow0 > appconfPOWER_THRESHOLD) || (frame_pow1 > appconfPOWER_THRESHOLD)){
-                    led_byte = 1;
-                }
-                // send led value to gpio
-                chanend_out_byte(c_to_gpio, led_byte);
-                // change the array format to [sample][channel]
-                for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
-                    for(int smp = 0; smp < appconfAUDIO_FRAME_LENGTH; smp ++){
-                        output[smp][ch] = input[ch][smp];
-                    }
-                }
-                // send frame over the channel
-                s_chan_out_buf_word(c_output, (uint32_t*) output, appconfFRAMES_IN_ALL_CHANS);
-            }
-            continue;
+    default:
+        break;
+    case 0x01:  /* Btn A */
+        gain_db = (gain_db >= appconfAUDIO_PIPELINE_MAX_GAIN) ? gain_db : gain_db + appconfAUDIO_PIPELINE_GAIN_STEP;
+        break;
+    case 0x02:  /* Btn B */
+        gain_db = (gain_db <= appconfAUDIO_PIPELINE_MIN_GAIN) ? gain_db : gain_db - appconfAUDIO_PIPELINE_GAIN_STEP;
+        break;
+    }
+    state->gain_db = gain_db;
+    debug_printf("Gain set to %d\n", gain_db);
+}
+
+BM_PIPELINE_PROCESS_ATTR static void ap_stage_c(ap_stage_c_state_t *state, const ap_frame_t *in, void *out)
+{
+    uint8_t led_byte = 0;
+    float frame_pow[appconfMIC_COUNT];
+
+    for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
+        bfp_s32_t ch_in;
+        // calculate the headroom of the frame
+        bfp_s32_init(&ch_in, (int32_t *) in->samples[ch], appconfEXP, appconfAUDIO_FRAME_LENGTH, 1);
+        // calculate the frame energy
+        float_s32_t frame_energy = float_s64_to_float_s32(bfp_s32_energy(&ch_in));
+        // calculate the frame power
+        frame_pow[ch] = float_s32_to_float(frame_energy) / (float)appconfAUDIO_FRAME_LENGTH;
+        if(frame_pow[ch] > appconfPOWER_THRESHOLD){
+            led_byte = 1;
+        }
+    }
+    // send led value to gpio
+    chanend_out_byte(state->c_to_gpio, led_byte);
+    // change the array format to [sample][channel]
+    for(int ch = 0; ch < appconfMIC_COUNT; ch ++){
+        for(int smp = 0; smp < appconfAUDIO_FRAME_LENGTH; smp ++){
+            state->output[smp][ch] = in->samples[ch][smp];
         }
     }
+    // I2S takes the frame a sample at a time, so it is streamed
+    s_chan_out_buf_word(state->c_output, (uint32_t*) state->output, appconfFRAMES_IN_ALL_CHANS);
+}
+
+void audio_pipeline_init(chanend_t c_mic,
+                         chanend_t c_output,
+                         chanend_t c_from_gpio,
+                         chanend_t c_to_gpio)
+{
+    stage_a_state.c_mic = c_mic;
+    stage_b_state.gain_db = appconfINITIAL_GAIN;
+    stage_c_state.c_output = c_output;
+    stage_c_state.c_to_gpio = c_to_gpio;
+
+    bm_worker_pool_init(&ap_worker_pool, AP_WORKERS);
+    bm_pipeline_stage_ctrl_set(&stage_b, c_from_gpio, (bm_pipeline_ctrl_t) ap_stage_b_ctrl);
+    bm_pipeline_init(ap_stages, AP_STAGES);
 }
@@ -1,14 +1,26 @@
-// Copyright 2021 XMOS LIMITED.
+// Copyright 2021-2022 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
 #ifndef AUDIO_PIPELINE_H_
 #define AUDIO_PIPELINE_H_
 
-#include <xcore/parallel.h>
 #include <xcore/chanend.h>
 
-DECLARE_JOB(ap_stage_a, (chanend_t, chanend_t));
-DECLARE_JOB(ap_stage_b, (chanend_t, chanend_t, chanend_t));
-DECLARE_JOB(ap_stage_c, (chanend_t, chanend_t, chanend_t));
+#include "bm_pipeline.h"
+#include "bm_worker_pool.h"
+
+#define AP_STAGES   3
+#define AP_WORKERS  1
+
+/* The pipeline's stages, to run with bm_pipeline_stage_run() */
+extern bm_pipeline_stage_t *const ap_stages[AP_STAGES];
+
+/* The workers that share stage b's channels, to run with bm_worker_pool_worker_run() */
+extern bm_worker_pool_t ap_worker_pool;
+
+void audio_pipeline_init(chanend_t c_mic,
+                         chanend_t c_output,
+                         chanend_t c_from_gpio,
+                         chanend_t c_to_gpio);
 
 #endif /* AUDIO_PIPELINE_H_ */
@@ -7,16 +7,79 @@
 #include <xcore/hwtimer.h>
 #include <xcore/triggerable.h>
 
+/* SDK headers */
+#include "button_engine.h"
+
 /* App headers */
+#include "app_conf.h"
 #include "app_demos.h"
 
 #define HEARTBEAT_TICKS 50000000
 
+static const button_engine_config_t button_config = {
+    .num_buttons = 2,
+    .active_low = 0x03,
+    .debounce_ticks = appconfGPIO_DEBOUNCE_TICKS,
+    .long_press_ticks = appconfGPIO_LONG_PRESS_TICKS,
+    .repeat_mask = 0x03,
+    .repeat_delay_ticks = appconfGPIO_REPEAT_DELAY_TICKS,
+    .repeat_period_ticks = appconfGPIO_REPEAT_PERIOD_TICKS,
+};
+
+/* Handles the decoded button events, and returns the new LED value */
+static uint32_t button_events(button_engine_t *engine, chanend_t c_from_gpio, uint32_t led_val)
+{
+    button_engine_event_t event;
+
+    while (button_engine_event_get(engine, &event)) {
+        const uint32_t led = 1 << event.button;
+
+        switch (event.type) {
+        case BUTTON_ENGINE_PRESS:
+            debug_printf("Button %c pressed\n", 'A' + event.button);
+            led_val |= led;
+            /* fallthrough */
+        case BUTTON_ENGINE_REPEAT:
+            /* Button A is 0x01 and button B is 0x02 */
+            chanend_out_byte(c_from_gpio, led);
+            break;
+        case BUTTON_ENGINE_RELEASE:
+            led_val &= ~led;
+            break;
+        case BUTTON_ENGINE_LONG_PRESS:
+            debug_printf("Button %c held\n", 'A' + event.button);
+            break;
+        }
+    }
+
+    return led_val;
+}
+
+/*
+ * Updates the button engine, sets the button timer to its next debounce,
+ * long press or repeat deadline, and returns the new LED value
+ */
+static uint32_t buttons_update(button_engine_t *engine, hwtimer_t tmr_btn, uint32_t btn_val, chanend_t c_from_gpio, uint32_t led_val)
+{
+    uint32_t btn_time;
+
+    if (button_engine_update(engine, btn_val, get_reference_time(), &btn_time)) {
+        hwtimer_set_trigger_time(tmr_btn, btn_time);
+        triggerable_enable_trigger(tmr_btn);
+    } else {
+        triggerable_disable_trigger(tmr_btn);
+    }
+
+    return button_events(engine, c_from_gpio, led_val);
+}
+
 void gpio_server(chanend_t c_from_gpio, chanend_t c_to_gpio)
 {
     port_t p_leds = PORT_LEDS;
     port_t p_btns = PORT_BUTTONS;
     hwtimer_t tmr = hwtimer_alloc();
+    hwtimer_t tmr_btn = hwtimer_alloc();
+    button_engine_t engine;
 
     port_enable(p_leds);
     port_enable(p_btns);
@@ -25,9 +88,12 @@ void gpio_server(chanend_t c_from_gpio, chanend_t c_to_gpio)
     uint32_t heartbeat_val = 0;
     uint32_t btn_val = port_in(p_btns);
 
+    button_engine_init(&engine, &button_config, btn_val, get_reference_time());
+
     triggerable_disable_all();
 
     TRIGGERABLE_SETUP_EVENT_VECTOR(p_btns, event_btn);
+    TRIGGERABLE_SETUP_EVENT_VECTOR(tmr_btn, event_btn_timer);
     TRIGGERABLE_SETUP_EVENT_VECTOR(c_to_gpio, event_chan);
     TRIGGERABLE_SETUP_EVENT_VECTOR(tmr, event_timer);
 
@@ -40,31 +106,22 @@ void gpio_server(chanend_t c_from_gpio, chanend_t c_to_gpio)
 
     while(1)
     {
-        TRIGGERABLE_WAIT_EVENT(event_btn, event_chan, event_timer);
+        TRIGGERABLE_WAIT_EVENT(event_btn, event_btn_timer, event_chan, event_timer);
         {
             event_btn:
             {
                 btn_val = port_in(p_btns);
                 port_set_trigger_value(p_btns, btn_val);
-                int btn0 = ( btn_val >> 0 ) & 0x01;
-                int btn1 = ( btn_val >> 1 ) & 0x01;
-                if (btn0 == 0)
-                {
-                    debug_printf("Button A pressed\n");
-                    chanend_out_byte(c_from_gpio, 0x01);
-                    led_val |= 0x01;
-                } else {
-                    led_val &= ~0x01;
-                }
-
-                if (btn1 == 0)
-                {
-                    debug_printf("Button B pressed\n");
-                    chanend_out_byte(c_from_gpio, 0x02);
-                    led_val |= 0x02;
-                } else {
-                    led_val &= ~0x02;
-                }
+                led_val = buttons_update(&engine, tmr_btn, btn_val, c_from_gpio, led_val);
+                port_out(p_leds, led_val);
+            }
+            continue;
+        }
+        {
+            event_btn_timer:
+            {
+                (void) hwtimer_get_time(tmr_btn);
+                led_val = buttons_update(&engine, tmr_btn, btn_val, c_from_gpio, led_val);
                 port_out(p_leds, led_val);
             }
             continue;
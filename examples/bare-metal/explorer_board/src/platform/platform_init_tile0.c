@@ -1,7 +1,11 @@
 // Copyright (c) 2021 XMOS LIMITED. This Software is subject to the terms of the
 // XMOS Public License: Version 1
 
+/* SDK headers */
+#include "qspi_flash_cal_qspi_io.h"
+
 /* App headers */
+#include "app_conf.h"
 #include "platform_init.h"
 
 static void tile0_setup_mclk(void);
@@ -9,6 +13,7 @@ static void tile0_init_i2c(void);
 static void tile0_init_spi(void);
 static void tile0_init_spi_device(spi_master_t *spi_ctx);
 static void tile0_init_flash(qspi_flash_ctx_t *qspi_flash_ctx);
+static void tile0_calibrate_flash(qspi_flash_ctx_t *qspi_flash_ctx);
 
 void platform_init_tile_0(chanend_t c_other_tile)
 {
@@ -37,6 +42,7 @@ void platform_init_tile_0(chanend_t c_other_tile)
     tile0_init_spi_device(&tile0_ctx->spi_ctx);
 
     tile0_init_flash(&tile0_ctx->qspi_flash_ctx);
+    tile0_calibrate_flash(&tile0_ctx->qspi_flash_ctx);
 }
 
 static void tile0_init_spi(void)
@@ -132,3 +138,36 @@ static void tile0_init_flash(qspi_flash_ctx_t *qspi_flash_ctx)
 
     qspi_flash_init(qspi_flash_ctx);
 }
+
+static void tile0_calibrate_flash(qspi_flash_ctx_t *qspi_flash_ctx)
+{
+    /* 100 MHz down to the 25 MHz SPI read clock */
+    static const uint8_t divisors[] = { 3, 4, 5, 6, 8, 12 };
+    const qspi_flash_cal_config_t config = {
+        .addr = appconfFLASH_CAL_ADDR,
+        .divisors = divisors,
+        .divisor_count = sizeof(divisors),
+        .max_sample_delay = 2,
+        .max_pad_delay = 5,
+        .margin = 1,
+        .reads_per_point = 8,
+        .bench_bytes = 64 * 1024,
+        /* The SPI read clock configuration, which the flash always meets */
+        .safe = { .divisor = 12, .sample_delay = 0, .sample_edge = QSPI_FLASH_CAL_EDGE_FALLING, .pad_delay = 0 },
+    };
+    qspi_flash_cal_result_t result;
+    int ret;
+
+    /* Replaces the full speed clock configuration with the fastest that reads reliably */
+    ret = qspi_flash_cal_qspi_flash(qspi_flash_ctx, &config, &result);
+
+    debug_printf("Flash %d MHz, sample delay %d %s edge, pad delay %d (%s), %d kB/s reads\n",
+                 600 / (2 * result.setting.divisor),
+                 result.setting.sample_delay,
+                 result.setting.sample_edge == QSPI_FLASH_CAL_EDGE_RISING ? "rising" : "falling",
+                 result.setting.pad_delay,
+                 ret != 0 ? "calibration failed" :
+                 result.source == QSPI_FLASH_CAL_SOURCE_CACHE ? "cached" :
+                 result.source == QSPI_FLASH_CAL_SOURCE_SWEEP ? "calibrated" : "no margin",
+                 result.read_bytes_per_sec / 1000);
+}
@@ -27,7 +27,12 @@ else()
     endif()
 
     add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/device_control/host)
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/iot/host)
     add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/tracealyzer/host)
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/freertos/usb/host)
+    add_subdirectory(modules/metrics/host)
+    add_subdirectory(modules/qspi_flash_cal/host)
+    add_subdirectory(modules/sample_rate_conversion/host)
     add_subdirectory(modules/xscope_fileio/xscope_fileio/host)
     install(TARGETS xscope_host_endpoint DESTINATION ${HOST_INSTALL_DIR})
 endif()
@@ -35,6 +35,8 @@ set(APP_LINK_OPTIONS
 
 set(APP_LINK_LIBRARIES
     rtos::bsp_config::xcore_ai_explorer
+    sdk::metrics
+    sdk::button_engine
 )
 
 #**********************
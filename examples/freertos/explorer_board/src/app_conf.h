@@ -43,14 +43,21 @@
 #define appconfUART_BAUD_RATE                   806400
 
 /* GPIO Configuration */
+#define appconfGPIO_DEBOUNCE_MS                 20
+#define appconfGPIO_LONG_PRESS_MS               1000
+#define appconfGPIO_VOLUME_RAPID_FIRE_DELAY_MS  500
 #define appconfGPIO_VOLUME_RAPID_FIRE_MS        100
 
+/* Metrics Configuration */
+#define appconfMETRICS_PERIOD_MS                1000
+#define appconfMETRICS_XSCOPE_PROBE             1   /* The "metrics" probe in config.xscope */
+
 /* Task Priorities */
 #define appconfSTARTUP_TASK_PRIORITY            ( configMAX_PRIORITIES - 1 )
 #define appconfAUDIO_PIPELINE_TASK_PRIORITY     ( configMAX_PRIORITIES - 4 )
 #define appconfGPIO_TASK_PRIORITY               ( configMAX_PRIORITIES - 2 )
 #define appconfFILESYSTEM_DEMO_TASK_PRIORITY    ( configMAX_PRIORITIES - 2 )
-#define appconfMEM_ANALYSIS_TASK_PRIORITY       ( configMAX_PRIORITIES - 1 )
+#define appconfMETRICS_TASK_PRIORITY            ( tskIDLE_PRIORITY + 1 )
 #define appconfSPI_MASTER_TASK_PRIORITY         ( configMAX_PRIORITIES - 1 )
 #define appconfQSPI_FLASH_TASK_PRIORITY         ( configMAX_PRIORITIES - 1 )
 #define appconfUART_RX_TASK_PRIORITY            ( configMAX_PRIORITIES - 1 )
@@ -3,28 +3,39 @@
 
 /* System headers */
 #include <platform.h>
+#include <xcore/hwtimer.h>
 
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
-#include "timers.h"
 
 /* Library headers */
+#include "button_engine.h"
 
 /* App headers */
 #include "app_conf.h"
 #include "example_pipeline/example_pipeline.h"
 #include "platform/driver_instances.h"
 
+#define GPIO_MS_TO_REF_TICKS(ms)    ((ms) * (PLATFORM_REFERENCE_HZ / 1000))
+
+static const button_engine_config_t button_config = {
+    .num_buttons = 2,
+    .active_low = 0x03,
+    .debounce_ticks = GPIO_MS_TO_REF_TICKS(appconfGPIO_DEBOUNCE_MS),
+    .long_press_ticks = GPIO_MS_TO_REF_TICKS(appconfGPIO_LONG_PRESS_MS),
+    .repeat_mask = 0x03,
+    .repeat_delay_ticks = GPIO_MS_TO_REF_TICKS(appconfGPIO_VOLUME_RAPID_FIRE_DELAY_MS),
+    .repeat_period_ticks = GPIO_MS_TO_REF_TICKS(appconfGPIO_VOLUME_RAPID_FIRE_MS),
+};
+
 RTOS_GPIO_ISR_CALLBACK_ATTR
 static void button_callback(rtos_gpio_t *ctx, void *app_data, rtos_gpio_port_id_t port_id, uint32_t value)
 {
     TaskHandle_t task = app_data;
     BaseType_t xYieldRequired = pdFALSE;
 
-    value = (~value) & 0x3;
-
     xTaskNotifyFromISR(task, value, eSetValueWithOverwrite, &xYieldRequired);
 
     portYIELD_FROM_ISR(xYieldRequired);
@@ -52,14 +63,18 @@ static void volume_down( void )
     audiopipeline_set_stage1_gain( gain );
 }
 
-void vVolumeUpCallback( TimerHandle_t pxTimer )
+/* Returns the RTOS ticks to wait until a reference time, rounded up */
+static TickType_t ticks_until(uint32_t time)
 {
-    volume_up();
-}
+    const uint32_t ref_ticks = time - get_reference_time();
+    TickType_t ticks;
 
-void vVolumeDownCallback( TimerHandle_t pxTimer )
-{
-    volume_down();
+    if( (int32_t) ref_ticks <= 0 )
+    {
+        return 0;
+    }
+    ticks = pdMS_TO_TICKS( (ref_ticks + GPIO_MS_TO_REF_TICKS(1) - 1) / GPIO_MS_TO_REF_TICKS(1) );
+    return ticks > 0 ? ticks : 1;
 }
 
 void gpio_ctrl(void)
@@ -67,10 +82,10 @@ void gpio_ctrl(void)
     uint32_t status;
     uint32_t buttons_val;
     uint32_t led_val;
-    uint32_t buttonA;
-    uint32_t buttonB;
-    TimerHandle_t volume_up_timer;
-    TimerHandle_t volume_down_timer;
+    uint32_t next_time;
+    TickType_t timeout = portMAX_DELAY;
+    button_engine_t engine;
+    button_engine_event_t event;
 
     const rtos_gpio_port_id_t button_port = rtos_gpio_port(PORT_BUTTONS);
     const rtos_gpio_port_id_t led_port = rtos_gpio_port(PORT_LEDS);
@@ -79,68 +94,59 @@ void gpio_ctrl(void)
     rtos_printf("enable button port %d\n", led_port);
     rtos_gpio_port_enable(gpio_ctx_t0, button_port);
 
+    button_engine_init(&engine, &button_config, rtos_gpio_port_in(gpio_ctx_t0, button_port), get_reference_time());
+
     rtos_printf("enable button isr\n");
     rtos_gpio_isr_callback_set(gpio_ctx_t0, button_port, button_callback, xTaskGetCurrentTaskHandle());
     rtos_gpio_interrupt_enable(gpio_ctx_t0, button_port);
 
-    rtos_printf("enable button timers\n");
-    volume_up_timer = xTimerCreate(
-                            "vol_up",
-                            pdMS_TO_TICKS(appconfGPIO_VOLUME_RAPID_FIRE_MS),
-                            pdTRUE,
-                            NULL,
-                            vVolumeUpCallback );
-
-    volume_down_timer = xTimerCreate(
-                            "vol_down",
-                            pdMS_TO_TICKS(appconfGPIO_VOLUME_RAPID_FIRE_MS),
-                            pdTRUE,
-                            NULL,
-                            vVolumeDownCallback);
-
     for (;;) {
+        /*
+         * Wake on a button change, or when the button engine next has a
+         * debounce, long press or repeat deadline.
+         */
         xTaskNotifyWait(
                 0x00000000UL,    /* Don't clear notification bits on entry */
                 0xFFFFFFFFUL,    /* Reset full notification value on exit */
                 &status,         /* Pass out notification value into status */
-                portMAX_DELAY ); /* Wait indefinitely until next notification */
+                timeout );
 
         buttons_val = rtos_gpio_port_in(gpio_ctx_t0, button_port);
-        led_val = rtos_gpio_port_in(gpio_ctx_t0, led_port);
-        
-        /* Mask out LED 2*/
-        led_val &= 0x4;
-        led_val |= (~ buttons_val) & 0x3;
-
-        /* Turn on LEDS based on buttons */
-        rtos_gpio_port_out(gpio_ctx_t0, led_port, led_val);
 
-        buttonA = ( buttons_val >> 0 ) & 0x01;
-        buttonB = ( buttons_val >> 1 ) & 0x01;
-
-        /* Adjust volume based on LEDs */
-        if( buttonA == 0 )   /* Up */
+        if( button_engine_update(&engine, buttons_val, get_reference_time(), &next_time) )
         {
-            xTimerStart( volume_up_timer, 0 );
-            volume_up();
-            // rtos_printf("volume up start\n");
+            timeout = ticks_until(next_time);
         }
         else
         {
-            xTimerStop( volume_up_timer, 0 );
+            timeout = portMAX_DELAY;
         }
 
-        if( buttonB == 0 )   /* Down */
+        /* Adjust volume on presses and rapid fire repeats */
+        while( button_engine_event_get(&engine, &event) )
         {
-            xTimerStart( volume_down_timer, 0 );
-            volume_down();
-            // rtos_printf("volume down start\n");
-        }
-        else
-        {
-            xTimerStop( volume_down_timer, 0 );
+            if( event.type == BUTTON_ENGINE_PRESS || event.type == BUTTON_ENGINE_REPEAT )
+            {
+                if( event.button == 0 )   /* Up */
+                {
+                    volume_up();
+                }
+                else                      /* Down */
+                {
+                    volume_down();
+                }
+            }
         }
 
+        led_val = rtos_gpio_port_in(gpio_ctx_t0, led_port);
+
+        /* Mask out LED 2*/
+        led_val &= 0x4;
+        led_val |= button_engine_pressed(&engine, 0) ? 0x1 : 0;
+        led_val |= button_engine_pressed(&engine, 1) ? 0x2 : 0;
+
+        /* Turn on LEDS based on buttons */
+        rtos_gpio_port_out(gpio_ctx_t0, led_port, led_val);
     }
 }
 
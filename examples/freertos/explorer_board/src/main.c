@@ -11,12 +11,12 @@
 
 /* Library headers */
 #include "fs_support.h"
+#include "rtos_metrics.h"
 
 /* App headers */
 #include "app_conf.h"
 #include "platform/platform_init.h"
 #include "platform/driver_instances.h"
-#include "mem_analysis/mem_analysis.h"
 #include "example_pipeline/example_pipeline.h"
 #include "filesystem/filesystem_demo.h"
 #include "gpio_ctrl/gpio_ctrl.h"
@@ -33,12 +33,16 @@ void vApplicationStackOverflowHook(TaskHandle_t pxTask, char *pcTaskName) {
     configASSERT(0);
 }
 
+static rtos_metrics_t metrics;
+
 void startup_task(void *arg)
 {
     rtos_printf("Startup task running from tile %d on core %d\n", THIS_XCORE_TILE, portGET_CORE_ID());
 
     platform_start();
 
+    rtos_metrics_init(&metrics, appconfMETRICS_XSCOPE_PROBE, appconfMETRICS_PERIOD_MS);
+
 #if ON_TILE(0)
     /* Initialize filesystem  */
     rtos_fatfs_init(qspi_flash_ctx);
@@ -55,13 +59,15 @@ void startup_task(void *arg)
     example_pipeline_init(appconfAUDIO_PIPELINE_TASK_PRIORITY);
 
     /* Create uart demo tasks and receivers */
-    uart_demo_create(appconfFILESYSTEM_DEMO_TASK_PRIORITY);
+    rtos_metrics_queue_add(&metrics,
+                           uart_demo_create(appconfFILESYSTEM_DEMO_TASK_PRIORITY),
+                           "uart_lb");
 #endif
 
-	for (;;) {
-		rtos_printf("Tile[%d]:\n\tMinimum heap free: %d\n\tCurrent heap free: %d\n", THIS_XCORE_TILE, xPortGetMinimumEverFreeHeapSize(), xPortGetFreeHeapSize());
-		vTaskDelay(pdMS_TO_TICKS(5000));
-	}
+    /* Stream system metrics snapshots over xscope */
+    rtos_metrics_start(&metrics, appconfMETRICS_TASK_PRIORITY);
+
+    vTaskDelete(NULL);
 }
 
 static void tile_common_init(chanend_t c)
@@ -150,7 +150,7 @@ void uart_rx_demo(void *arg){
 
 }
 
-void uart_demo_create(UBaseType_t priority)
+QueueHandle_t uart_demo_create(UBaseType_t priority)
 {
     QueueHandle_t loopback_queue = xQueueCreate(2, MAX_TEST_VECT_SIZE);
 
@@ -167,5 +167,7 @@ void uart_demo_create(UBaseType_t priority)
                 loopback_queue,
                 priority,
                 NULL);
+
+    return loopback_queue;
 }
 
@@ -5,8 +5,10 @@
 #define UART_DEMO_H_
 
 #include "FreeRTOS.h"
+#include "queue.h"
 
-void uart_demo_create(UBaseType_t priority);
+/* Returns the queue between the tx and rx tasks */
+QueueHandle_t uart_demo_create(UBaseType_t priority);
 void uart_rx_pre_os_startup_init(void);
 
 #endif //UART_DEMO_H_
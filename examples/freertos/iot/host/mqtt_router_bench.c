@@ -0,0 +1,600 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * MQTT command router host benchmark.
+ *
+ * First checks topic matching and the dispatch of single, batched and
+ * malformed LED control messages against the LED state they should give,
+ * and exits with an error on any mismatch.
+ *
+ * Then reports the messages per second the router dispatches for single
+ * and batched LED messages, beside the strstr chain the demo used before,
+ * which only handles single updates. Times are CPU time, so run on an idle
+ * machine for stable results.
+ *
+ * With -b host[:port], it then also measures end to end messages per
+ * second through an MQTT broker, such as mosquitto with the example's
+ * mosquitto.conf, which has a plain listener on 127.0.0.1:1883. It
+ * subscribes to the demo topic, publishes messages to it at QoS 0 with a
+ * window of messages in flight, and dispatches each one it receives.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mqtt_router.h"
+
+#define TOPIC               "explorer/ledctrl"
+#define BENCH_S             0.5
+#define BROKER_MESSAGES     100000
+#define BROKER_WINDOW       64
+
+/*
+ * The LED route, as in the demo, with the port write replaced by a count
+ */
+
+typedef struct {
+    int32_t led;
+    int status;
+    uint32_t val;
+    uint32_t writes;
+} led_ctrl_t;
+
+static int led_field(void *ctx, const mqtt_router_value_t *value)
+{
+    led_ctrl_t *ctrl = ctx;
+
+    if (mqtt_router_value_to_int(value, &ctrl->led) != 0 || ctrl->led < 0 || ctrl->led > 3) {
+        ctrl->led = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static int status_field(void *ctx, const mqtt_router_value_t *value)
+{
+    led_ctrl_t *ctrl = ctx;
+
+    if (mqtt_router_value_equals(value, "on")) {
+        ctrl->status = 1;
+    } else if (mqtt_router_value_equals(value, "off")) {
+        ctrl->status = 0;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void led_object_begin(void *ctx)
+{
+    led_ctrl_t *ctrl = ctx;
+
+    ctrl->led = -1;
+    ctrl->status = -1;
+}
+
+static int led_object_end(void *ctx)
+{
+    led_ctrl_t *ctrl = ctx;
+
+    if (ctrl->led < 0 || ctrl->status < 0) {
+        return -1;
+    }
+    if (ctrl->status) {
+        ctrl->val |= 1 << ctrl->led;
+    } else {
+        ctrl->val &= ~(1 << ctrl->led);
+    }
+    return 0;
+}
+
+static void led_message_end(void *ctx, int failures)
+{
+    led_ctrl_t *ctrl = ctx;
+
+    (void) failures;
+    ctrl->writes++;
+}
+
+static led_ctrl_t led_ctrl;
+
+static const mqtt_router_field_t led_fields[] = {
+    { "LED", led_field },
+    { "status", status_field },
+};
+
+static const mqtt_router_route_t routes[] = {
+    {
+        .topic = "explorer/+/config",
+        .fields = NULL,
+        .num_fields = 0,
+    },
+    {
+        .topic = TOPIC,
+        .fields = led_fields,
+        .num_fields = sizeof(led_fields) / sizeof(led_fields[0]),
+        .object_begin = led_object_begin,
+        .object_end = led_object_end,
+        .message_end = led_message_end,
+        .ctx = &led_ctrl,
+    },
+};
+
+static mqtt_router_t router;
+
+/*
+ * The demo's previous message handling, for comparison. It needs a NUL
+ * terminated payload.
+ */
+static void legacy_dispatch(const char *payload)
+{
+    static const char *const leds[] = { "0", "1", "2", "3" };
+
+    for (int i = 0; i < 4; i++) {
+        if (strstr(payload, leds[i]) != NULL) {
+            if (strstr(payload, "on") != NULL) {
+                led_ctrl.val |= (1 << i);
+            } else if (strstr(payload, "off") != NULL) {
+                led_ctrl.val &= ~(1 << i);
+            }
+            break;
+        }
+    }
+    led_ctrl.writes++;
+}
+
+static int dispatch(const char *topic, const char *payload)
+{
+    return mqtt_router_dispatch(&router, topic, strlen(topic), payload, strlen(payload));
+}
+
+/*
+ * Checks
+ */
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void check_topics(void)
+{
+    static const struct {
+        const char *pattern;
+        const char *topic;
+        int match;
+    } cases[] = {
+        { "a/b", "a/b", 1 },
+        { "a/b", "a/bc", 0 },
+        { "a/b", "a", 0 },
+        { "a/+", "a/b", 1 },
+        { "a/+", "a/b/c", 0 },
+        { "a/+/c", "a//c", 1 },
+        { "+/+", "a/b", 1 },
+        { "a/#", "a", 1 },
+        { "a/#", "a/b/c", 1 },
+        { "#", "a/b", 1 },
+        { "#", "$SYS/x", 0 },
+        { "+/x", "$SYS/x", 0 },
+        { "$SYS/#", "$SYS/x", 1 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char what[80];
+
+        snprintf(what, sizeof(what), "pattern %s, topic %s", cases[i].pattern, cases[i].topic);
+        check(mqtt_router_topic_match(cases[i].pattern, cases[i].topic, strlen(cases[i].topic)) == cases[i].match, what);
+    }
+}
+
+static void check_dispatch(void)
+{
+    led_ctrl.val = 0;
+
+    check(dispatch(TOPIC, "{\"LED\": \"0\", \"status\": \"on\"}") == 0 && led_ctrl.val == 0x1, "single update");
+    check(dispatch(TOPIC, "{\"status\": \"on\", \"LED\": 2}") == 0 && led_ctrl.val == 0x5, "keys in any order, number value");
+    check(dispatch(TOPIC, "[{\"LED\": \"1\", \"status\": \"on\"}, {\"LED\": \"0\", \"status\": \"off\"}, {\"LED\": \"3\", \"status\": \"on\"}]") == 0 &&
+          led_ctrl.val == 0xE, "batched updates");
+    check(dispatch(TOPIC, "{\"LED\": \"1\", \"status\": \"off\", \"note\": {\"from\": [1, 2]}}") == 0 && led_ctrl.val == 0xC, "unknown nested key skipped");
+    check(dispatch(TOPIC, "[{\"LED\": \"9\", \"status\": \"on\"}, {\"LED\": \"1\", \"status\": \"on\"}]") == -1 && led_ctrl.val == 0xE,
+          "bad object in a batch rejected, others applied");
+    check(dispatch(TOPIC, "{\"LED\": \"0\", \"status\": \"on\"") == -1 && led_ctrl.val == 0xE, "truncated message rejected");
+    check(dispatch(TOPIC, "[{\"LED\": \"0\", \"status\": \"on\"}, 5]") == -1 && led_ctrl.val == 0xE, "batch with a non object rejected whole");
+    check(dispatch("explorer/other", "{\"LED\": \"0\", \"status\": \"on\"}") == 1 && led_ctrl.val == 0xE, "unrouted topic ignored");
+
+    /*
+     * jsmn, unless built with JSMN_STRICT, accepts keys without values and
+     * values without separators. None of these may be handled, in part or
+     * whole, nor make the router read past the last token.
+     */
+    {
+        static const char *const malformed[] = {
+            "{\"LED\"}",
+            "{\"LED\": \"0\", \"status\"}",
+            "{\"LED\", \"status\": \"on\"}",
+            "{\"LED\" \"0\" \"status\" \"on\"}",
+            "[{\"LED\": \"0\", \"status\": \"on\"}, {\"LED\"}]",
+            "[{\"LED\": \"0\", \"status\": \"on\"}, {\"status\": \"on\", \"LED\"}]",
+        };
+        const uint32_t parse_errors = router.stats.parse_errors;
+        const uint32_t objects = router.stats.objects;
+
+        for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+            char what[96];
+
+            snprintf(what, sizeof(what), "malformed message %s rejected", malformed[i]);
+            check(dispatch(TOPIC, malformed[i]) == -1 && led_ctrl.val == 0xE, what);
+        }
+        check(router.stats.parse_errors - parse_errors == sizeof(malformed) / sizeof(malformed[0]) &&
+              router.stats.objects == objects, "malformed messages counted as parse errors, no objects handled");
+    }
+
+    /* The payload need not be NUL terminated */
+    {
+        const char payload[] = "{\"LED\": \"0\", \"status\": \"on\"}XXXX";
+
+        check(mqtt_router_dispatch(&router, TOPIC, strlen(TOPIC), payload, sizeof(payload) - 5) == 0 && led_ctrl.val == 0xF,
+              "payload without NUL");
+    }
+}
+
+/*
+ * Offline throughput
+ */
+
+static double seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static const char *const single_msgs[] = {
+    "{\"LED\": \"0\", \"status\": \"on\"}",
+    "{\"LED\": \"1\", \"status\": \"on\"}",
+    "{\"LED\": \"0\", \"status\": \"off\"}",
+    "{\"LED\": \"1\", \"status\": \"off\"}",
+};
+
+static const char *const batch_msgs[] = {
+    "[{\"LED\": \"0\", \"status\": \"on\"}, {\"LED\": \"1\", \"status\": \"on\"}, {\"LED\": \"2\", \"status\": \"on\"}, {\"LED\": \"3\", \"status\": \"on\"}]",
+    "[{\"LED\": \"0\", \"status\": \"off\"}, {\"LED\": \"1\", \"status\": \"off\"}, {\"LED\": \"2\", \"status\": \"off\"}, {\"LED\": \"3\", \"status\": \"off\"}]",
+};
+
+#define NUM_SINGLE  (sizeof(single_msgs) / sizeof(single_msgs[0]))
+#define NUM_BATCH   (sizeof(batch_msgs) / sizeof(batch_msgs[0]))
+
+static void bench_offline(void)
+{
+    size_t single_len[NUM_SINGLE];
+    size_t batch_len[NUM_BATCH];
+    uint32_t n;
+    clock_t start;
+    double s;
+
+    for (size_t i = 0; i < NUM_SINGLE; i++) {
+        single_len[i] = strlen(single_msgs[i]);
+    }
+    for (size_t i = 0; i < NUM_BATCH; i++) {
+        batch_len[i] = strlen(batch_msgs[i]);
+    }
+
+    printf("\n%-32s %14s %14s\n", "dispatch", "messages/s", "updates/s");
+
+    n = 0;
+    start = clock();
+    do {
+        for (int i = 0; i < 1000; i++, n++) {
+            legacy_dispatch(single_msgs[n % NUM_SINGLE]);
+        }
+    } while ((s = seconds(start)) < BENCH_S);
+    printf("%-32s %14.0f %14.0f\n", "strstr chain, single", n / s, n / s);
+
+    n = 0;
+    start = clock();
+    do {
+        for (int i = 0; i < 1000; i++, n++) {
+            mqtt_router_dispatch(&router, TOPIC, sizeof(TOPIC) - 1, single_msgs[n % NUM_SINGLE], single_len[n % NUM_SINGLE]);
+        }
+    } while ((s = seconds(start)) < BENCH_S);
+    printf("%-32s %14.0f %14.0f\n", "router, single", n / s, n / s);
+
+    n = 0;
+    start = clock();
+    do {
+        for (int i = 0; i < 1000; i++, n++) {
+            mqtt_router_dispatch(&router, TOPIC, sizeof(TOPIC) - 1, batch_msgs[n % NUM_BATCH], batch_len[n % NUM_BATCH]);
+        }
+    } while ((s = seconds(start)) < BENCH_S);
+    printf("%-32s %14.0f %14.0f\n", "router, batch of 4", n / s, 4 * n / s);
+}
+
+/*
+ * End to end through a broker, over plain MQTT 3.1.1
+ */
+
+#ifndef _WIN32
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int broker_connect(const char *host, const char *port)
+{
+    struct addrinfo hints = { 0 };
+    struct addrinfo *res;
+    int fd = -1;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        return -1;
+    }
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, 0);
+
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Writes a fixed header, returning its length */
+static size_t packet_header(uint8_t *buf, uint8_t type, size_t remaining)
+{
+    size_t i = 0;
+
+    buf[i++] = type;
+    do {
+        uint8_t b = remaining % 128;
+
+        remaining /= 128;
+        buf[i++] = b | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+    return i;
+}
+
+static size_t put_string(uint8_t *buf, const char *str, size_t len)
+{
+    buf[0] = len >> 8;
+    buf[1] = len & 0xFF;
+    memcpy(&buf[2], str, len);
+    return len + 2;
+}
+
+/* The receive buffer, from which whole packets are taken */
+static uint8_t rx_buf[65536];
+static size_t rx_len;
+
+/*
+ * Receives the next packet. Returns its type byte, with the variable
+ * header and payload in *body, or -1 on error.
+ */
+static int packet_recv(int fd, const uint8_t **body, size_t *body_len, size_t *consumed)
+{
+    for (;;) {
+        size_t remaining = 0;
+        size_t i = 1;
+        int complete = 0;
+
+        if (rx_len >= 2) {
+            for (int shift = 0; i < rx_len && i < 5; i++, shift += 7) {
+                remaining |= (size_t) (rx_buf[i] & 0x7F) << shift;
+                if ((rx_buf[i] & 0x80) == 0) {
+                    complete = 1;
+                    i++;
+                    break;
+                }
+            }
+        }
+        if (complete && rx_len >= i + remaining) {
+            *body = &rx_buf[i];
+            *body_len = remaining;
+            *consumed = i + remaining;
+            return rx_buf[0];
+        }
+
+        ssize_t n = recv(fd, &rx_buf[rx_len], sizeof(rx_buf) - rx_len, 0);
+
+        if (n <= 0) {
+            return -1;
+        }
+        rx_len += n;
+    }
+}
+
+static void packet_consume(size_t consumed)
+{
+    memmove(rx_buf, &rx_buf[consumed], rx_len - consumed);
+    rx_len -= consumed;
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench_broker(const char *address)
+{
+    char host[256];
+    const char *port = "1883";
+    char *colon;
+    uint8_t pkt[512];
+    size_t len;
+    const uint8_t *body;
+    size_t body_len;
+    size_t consumed;
+    int fd;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    double start;
+    double s;
+
+    snprintf(host, sizeof(host), "%s", address);
+    colon = strrchr(host, ':');
+    if (colon != NULL) {
+        *colon = '\0';
+        port = colon + 1;
+    }
+
+    fd = broker_connect(host, port);
+    if (fd < 0) {
+        printf("Could not connect to %s:%s\n", host, port);
+        return -1;
+    }
+
+    /* CONNECT, clean session, 60 s keep alive */
+    {
+        static const uint8_t var_header[] = { 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60 };
+        static const char client_id[] = "mqtt_router_bench";
+        uint8_t payload[64];
+        size_t payload_len = put_string(payload, client_id, sizeof(client_id) - 1);
+
+        len = packet_header(pkt, 0x10, sizeof(var_header) + payload_len);
+        memcpy(&pkt[len], var_header, sizeof(var_header));
+        len += sizeof(var_header);
+        memcpy(&pkt[len], payload, payload_len);
+        len += payload_len;
+    }
+    if (send_all(fd, pkt, len) != 0 ||
+        packet_recv(fd, &body, &body_len, &consumed) != 0x20 || body_len != 2 || body[1] != 0) {
+        printf("MQTT connect refused\n");
+        close(fd);
+        return -1;
+    }
+    packet_consume(consumed);
+
+    /* SUBSCRIBE at QoS 0 */
+    len = packet_header(pkt, 0x82, 2 + 2 + sizeof(TOPIC) - 1 + 1);
+    pkt[len++] = 0;
+    pkt[len++] = 1;
+    len += put_string(&pkt[len], TOPIC, sizeof(TOPIC) - 1);
+    pkt[len++] = 0;
+    if (send_all(fd, pkt, len) != 0 ||
+        packet_recv(fd, &body, &body_len, &consumed) != 0x90) {
+        printf("MQTT subscribe failed\n");
+        close(fd);
+        return -1;
+    }
+    packet_consume(consumed);
+
+    mqtt_router_init(&router, routes, sizeof(routes) / sizeof(routes[0]));
+
+    start = wall_seconds();
+    while (received < BROKER_MESSAGES) {
+        if (sent < BROKER_MESSAGES && sent - received < BROKER_WINDOW) {
+            const char *msg = single_msgs[sent % NUM_SINGLE];
+            const size_t msg_len = strlen(msg);
+
+            len = packet_header(pkt, 0x30, 2 + sizeof(TOPIC) - 1 + msg_len);
+            len += put_string(&pkt[len], TOPIC, sizeof(TOPIC) - 1);
+            memcpy(&pkt[len], msg, msg_len);
+            len += msg_len;
+            if (send_all(fd, pkt, len) != 0) {
+                break;
+            }
+            sent++;
+            continue;
+        }
+
+        int type = packet_recv(fd, &body, &body_len, &consumed);
+
+        if (type < 0) {
+            break;
+        }
+        if ((type & 0xF0) == 0x30 && body_len >= 2) {
+            const size_t topic_len = (body[0] << 8) | body[1];
+
+            /* QoS 0, so no packet identifier after the topic */
+            if (2 + topic_len <= body_len) {
+                mqtt_router_dispatch(&router, (const char *) &body[2], topic_len,
+                                     (const char *) &body[2 + topic_len], body_len - 2 - topic_len);
+                received++;
+            }
+        }
+        packet_consume(consumed);
+    }
+    s = wall_seconds() - start;
+
+    pkt[0] = 0xE0;
+    pkt[1] = 0;
+    (void) send_all(fd, pkt, 2);
+    close(fd);
+
+    printf("\nBroker %s:%s, window of %d: %u sent, %u received and dispatched in %.2f s, %.0f messages/s\n",
+           host, port, BROKER_WINDOW, sent, received, s, received / s);
+    printf("Router: %u messages, %u fields, %u failures\n",
+           router.stats.messages, router.stats.fields, router.stats.failures);
+
+    return received == BROKER_MESSAGES ? 0 : -1;
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+    const char *broker = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            broker = argv[++i];
+        } else {
+            printf("Usage: %s [-b host[:port]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    mqtt_router_init(&router, routes, sizeof(routes) / sizeof(routes[0]));
+
+    check_topics();
+    check_dispatch();
+    if (failures) {
+        return EXIT_FAILURE;
+    }
+    printf("Topic matching and dispatch checks passed\n");
+
+    mqtt_router_init(&router, routes, sizeof(routes) / sizeof(routes[0]));
+    bench_offline();
+
+    if (broker != NULL) {
+#ifndef _WIN32
+        if (bench_broker(broker) != 0) {
+            return EXIT_FAILURE;
+        }
+#else
+        printf("The broker benchmark is not supported on Windows\n");
+        return EXIT_FAILURE;
+#endif
+    }
+
+    return EXIT_SUCCESS;
+}
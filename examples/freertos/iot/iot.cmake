@@ -6,7 +6,6 @@ set(APP_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/src
     ${CMAKE_CURRENT_LIST_DIR}/src/network_demos
     ${CMAKE_CURRENT_LIST_DIR}/src/mqtt_demo
-    ${CMAKE_CURRENT_LIST_DIR}/src/mem_analysis
 )
 
 #**********************
@@ -50,6 +49,7 @@ set(APP_LINK_LIBRARIES
     rtos::drivers::wifi
     rtos::iot
     rtos::bsp_config::xcore_ai_explorer
+    sdk::metrics
 )
 
 #**********************
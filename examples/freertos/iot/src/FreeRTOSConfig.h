@@ -129,4 +129,7 @@ your application. */
 /* A header file that defines trace macro can be included here. */
 // #include "xcore_trace.h"
 
+/* Measures the load of each core for the metrics service */
+#include "rtos_metrics_trace.h"
+
 #endif /* FREERTOS_CONFIG_H */
@@ -18,12 +18,25 @@
 #define appconfMQTT_HOSTNAME "your endpoint here"
 #define appconfMQTT_CLIENT_ID "explorer"
 #define appconfMQTT_DEMO_TOPIC "explorer/ledctrl"
+// The MQTT keep alive interval. A shorter interval detects a dropped
+// connection sooner, at the cost of more traffic while idle.
+#define appconfMQTT_KEEP_ALIVE_S 60
+// The delay before reconnecting after an established connection drops.
+// Failed connection attempts back off from 1 s to 15 s.
+#define appconfMQTT_FAST_RECONNECT_DELAY_MS 100
+// How long a TLS session is offered for resumption after it was established.
+// 0 disables resumption, so that every connection performs a full handshake.
+#define appconfTLS_SESSION_LIFETIME_S 3600
+
+/* Metrics Configuration */
+#define appconfMETRICS_PERIOD_MS 1000
+#define appconfMETRICS_XSCOPE_PROBE 1 /* The "metrics" probe in config.xscope */
 
 /* Task Priorities */
 #define appconfMQTT_TASK_PRIORITY (configMAX_PRIORITIES - 3)
 #define appconfSNTPD_TASK_PRIORITY (configMAX_PRIORITIES - 2)
 #define appconfSTARTUP_TASK_PRIORITY (configMAX_PRIORITIES - 1)
-#define appconfMEM_ANALYSIS_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#define appconfMETRICS_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
 #define appconfWIFI_SETUP_TASK_PRIORITY (configMAX_PRIORITIES / 2 - 1)
 #define appconfWIFI_CONN_MNGR_TASK_PRIORITY (configMAX_PRIORITIES - 3)
 #define appconfWIFI_DHCP_SERVER_TASK_PRIORITY (configMAX_PRIORITIES - 3)
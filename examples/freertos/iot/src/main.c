@@ -13,13 +13,13 @@
 #include "FreeRTOS_DHCP.h"
 
 /* Library headers */
+#include "rtos_metrics.h"
 
 /* App headers */
 #include "app_conf.h"
 #include "platform/platform_init.h"
 #include "platform/driver_instances.h"
 #include "fs_support.h"
-#include "mem_analysis.h"
 #include "mqtt_demo_client.h"
 #include "network_setup.h"
 #include "sntpd.h"
@@ -37,6 +37,8 @@ void vApplicationStackOverflowHook(TaskHandle_t pxTask, char *pcTaskName) {
     configASSERT(0);
 }
 
+static rtos_metrics_t metrics;
+
 void startup_task(void *arg)
 {
     rtos_printf("Startup task running from tile %d on core %d\n", THIS_XCORE_TILE, portGET_CORE_ID());
@@ -60,10 +62,11 @@ void startup_task(void *arg)
     mqtt_demo_create(gpio_ctx_t0, appconfMQTT_TASK_PRIORITY);
 #endif
 
-	for (;;) {
-		rtos_printf("Tile[%d]:\n\tMinimum heap free: %d\n\tCurrent heap free: %d\n", THIS_XCORE_TILE, xPortGetMinimumEverFreeHeapSize(), xPortGetFreeHeapSize());
-		vTaskDelay(pdMS_TO_TICKS(5000));
-	}
+    /* Stream system metrics snapshots over xscope */
+    rtos_metrics_init(&metrics, appconfMETRICS_XSCOPE_PROBE, appconfMETRICS_PERIOD_MS);
+    rtos_metrics_start(&metrics, appconfMETRICS_TASK_PRIORITY);
+
+    vTaskDelete(NULL);
 }
 
 static void tile_common_init(chanend_t c)
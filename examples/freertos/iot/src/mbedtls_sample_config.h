@@ -66,6 +66,10 @@
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
 
+/* Enable session tickets, so that the client may resume a session without
+ * the server keeping it in a cache. */
+#define MBEDTLS_SSL_SESSION_TICKETS
+
 /* Enable TLS v1.2 only. */
 #define MBEDTLS_SSL_PROTO_TLS1_2
 
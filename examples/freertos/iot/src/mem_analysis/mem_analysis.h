@@ -1,9 +0,0 @@
-// Copyright 2020-2021 XMOS LIMITED.
-// This Software is subject to the terms of the XMOS Public Licence: Version 1.
-
-#ifndef MEM_ANALYSIS_H_
-#define MEM_ANALYSIS_H_
-
-void mem_analysis_create( const char* task_name );
-
-#endif /* MEM_ANALYSIS_H_ */
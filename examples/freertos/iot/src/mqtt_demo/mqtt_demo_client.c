@@ -21,7 +21,8 @@
 /* App headers */
 #include "app_conf.h"
 #include "mqtt_demo_client.h"
-#include "jsmn.h"
+#include "mqtt_router.h"
+#include "tls_session_cache.h"
 #include "sntpd.h"
 
 #ifdef MBEDTLS_DEBUG_C
@@ -43,80 +44,123 @@ typedef struct net_conn_args
 	Socket_t socket;
 	mbedtls_ssl_context* ssl_ctx;
 	TaskHandle_t connection_task;
+	int connected;
 } net_conn_args_t;
 
 static rtos_gpio_t* gpio = NULL;
 static rtos_gpio_port_id_t led_port = 0;
 static uint32_t val;
 
-#define MAX_TOKENS 10
+/* The LED update in the object being handled */
+typedef struct
+{
+	int32_t led;
+	int status;
+} led_update_t;
 
+static led_update_t led_update;
 
-void messageArrived(MessageData* data)
+static int led_field( void *ctx, const mqtt_router_value_t *value )
 {
-	char* payload = data->message->payload;
-	int payload_len = data->message->payloadlen;
-	jsmn_parser p;
-	jsmntok_t tkn[MAX_TOKENS];
-	int r;
-
-	jsmn_init(&p);
-	r = jsmn_parse(&p, payload, payload_len, tkn, MAX_TOKENS );
-	debug_printf("r:%d\n",r);
-	for( int i=0; i<r; i++ )
+	led_update_t *update = ctx;
+
+	if( mqtt_router_value_to_int( value, &update->led ) != 0 || update->led < 0 || update->led > 3 )
 	{
-		debug_printf("json[%d]:%.*s\n", i, tkn[i].end - tkn[i].start, payload + tkn[i].start);
+		update->led = -1;
+		return -1;
 	}
+	return 0;
+}
 
-	if( strstr( payload, "0" ) != NULL )
+static int status_field( void *ctx, const mqtt_router_value_t *value )
+{
+	led_update_t *update = ctx;
+
+	if( mqtt_router_value_equals( value, "on" ) )
 	{
-		if( strstr( payload, "on" ) != NULL )
-		{
-			val |= ( 1 << 0 );
-		}
-		else if( strstr( payload, "off" ) != NULL )
-		{
-			val &= ~( 1 << 0 );
-		}
+		update->status = 1;
 	}
-	else if( strstr( payload, "1" ) != NULL )
+	else if( mqtt_router_value_equals( value, "off" ) )
 	{
-		if( strstr( payload, "on" ) != NULL )
-		{
-			val |= ( 1 << 1 );
-		}
-		else if( strstr( payload, "off" ) != NULL )
-		{
-			val &= ~( 1 << 1 );
-		}
+		update->status = 0;
 	}
-	else if( strstr( payload, "2" ) != NULL )
+	else
 	{
-		if( strstr( payload, "on" ) != NULL )
-		{
-			val |= ( 1 << 2 );
-		}
-		else if( strstr( payload, "off" ) != NULL )
-		{
-			val &= ~( 1 << 2 );
-		}
+		return -1;
 	}
-	else if( strstr( payload, "3" ) != NULL )
+	return 0;
+}
+
+static void led_object_begin( void *ctx )
+{
+	led_update_t *update = ctx;
+
+	update->led = -1;
+	update->status = -1;
+}
+
+static int led_object_end( void *ctx )
+{
+	led_update_t *update = ctx;
+
+	if( update->led < 0 || update->status < 0 )
 	{
-		if( strstr( payload, "on" ) != NULL )
-		{
-			val |= ( 1 << 3 );
-		}
-		else if( strstr( payload, "off" ) != NULL )
-		{
-			val &= ~( 1 << 3 );
-		}
+		return -1;
 	}
 
-    rtos_gpio_port_out(gpio, led_port, val);
+	if( update->status )
+	{
+		val |= ( 1 << update->led );
+	}
+	else
+	{
+		val &= ~( 1 << update->led );
+	}
+	return 0;
+}
+
+static void led_message_end( void *ctx, int failures )
+{
+	( void ) ctx;
+
+	/* All of the message's updates are applied at once */
+	rtos_gpio_port_out(gpio, led_port, val);
+
+	if( failures )
+	{
+		debug_printf("%d LED updates ignored\n", failures);
+	}
+}
+
+static const mqtt_router_field_t led_fields[] = {
+	{ "LED", led_field },
+	{ "status", status_field },
+};
 
-	debug_printf("Message arrived on topic %.*s: %.*s\n", data->topicName->lenstring.len, data->topicName->lenstring.data,
-		data->message->payloadlen, data->message->payload);
+static const mqtt_router_route_t routes[] = {
+	{
+		.topic = appconfMQTT_DEMO_TOPIC,
+		.fields = led_fields,
+		.num_fields = sizeof( led_fields ) / sizeof( led_fields[0] ),
+		.object_begin = led_object_begin,
+		.object_end = led_object_end,
+		.message_end = led_message_end,
+		.ctx = &led_update,
+	},
+};
+
+static mqtt_router_t router;
+
+void messageArrived(MessageData* data)
+{
+	int ret;
+
+	ret = mqtt_router_dispatch( &router,
+								data->topicName->lenstring.data, data->topicName->lenstring.len,
+								data->message->payload, data->message->payloadlen );
+
+	debug_printf("Message arrived on topic %.*s: %.*s (%d)\n", data->topicName->lenstring.len, data->topicName->lenstring.data,
+		data->message->payloadlen, data->message->payload, ret);
 }
 
 
@@ -145,6 +189,7 @@ static void mqtt_handler( void* arg )
 
 	connectData.MQTTVersion = 3;
 	connectData.clientID.cstring = ( char * )client_str;
+	connectData.keepAliveInterval = appconfMQTT_KEEP_ALIVE_S;
 
 	for( ;; )
 	{
@@ -156,6 +201,7 @@ static void mqtt_handler( void* arg )
 		else
 		{
 			debug_printf("MQTT Connected\n");
+			args->connected = 1;
 
 			if( ( retval = MQTTSubscribe( &client, topic, QOS1, messageArrived ) ) != 0 )
 			{
@@ -183,6 +229,26 @@ static void mqtt_handler( void* arg )
 	vTaskDelete( NULL );
 }
 
+static int reconnect_backoff( int mqtt_timeout )
+{
+	return ( ( mqtt_timeout + MQTT_RECONNECT_DELAY_STEP_MS ) > MQTT_RECONNECT_DELAY_MAX_MS )
+			? ( MQTT_RECONNECT_DELAY_MAX_MS )
+			: ( mqtt_timeout + MQTT_RECONNECT_DELAY_STEP_MS );
+}
+
+static void handshake_report( tls_session_cache_t* session_cache, int resumed )
+{
+	tls_session_cache_stats_t stats;
+
+	tls_session_cache_stats_get( session_cache, &stats );
+
+	debug_printf("TLS handshake %s in %u ms (resumed: %u, avg %u ms; full: %u, avg %u ms; failed: %u)\n",
+		resumed ? "resumed" : "full", stats.last_ms,
+		stats.resumed, stats.resumed ? stats.resumed_ms_total / stats.resumed : 0,
+		stats.full, stats.full ? stats.full_ms_total / stats.full : 0,
+		stats.failed);
+}
+
 static void mqtt_demo_connect( void* arg )
 {
 	( void ) arg;
@@ -272,6 +338,11 @@ static void mqtt_demo_connect( void* arg )
 
 	tls_ctx_t* tls_ctx = pvPortMalloc( sizeof( tls_ctx_t ) );
 
+	/* The session outlives each connection, so that the next one may resume it */
+	tls_session_cache_t* session_cache = pvPortMalloc( sizeof( tls_session_cache_t ) );
+
+	tls_session_cache_init( session_cache, appconfTLS_SESSION_LIFETIME_S );
+
 	int mqtt_timeout = MQTT_RECONNECT_DELAY_MS;
 	for( ;; )
 	{
@@ -290,6 +361,11 @@ static void mqtt_demo_connect( void* arg )
 
 		mbedtls_ssl_set_bio( ssl_ctx, tls_ctx, tls_send, tls_recv, NULL );
 
+		if( tls_session_cache_apply( session_cache, ssl_ctx ) )
+		{
+			debug_printf("Offering cached TLS session\n");
+		}
+
 		while( FreeRTOS_IsNetworkUp() == pdFALSE )
 		{
 			vTaskDelay( pdMS_TO_TICKS( 100 ) );
@@ -318,6 +394,8 @@ static void mqtt_demo_connect( void* arg )
 		if(	FreeRTOS_connect( socket, &sAddr, sizeof( sAddr ) ) == 0 )
 		{
 			tls_ctx->socket = socket;
+			TickType_t handshake_start = xTaskGetTickCount();
+
 			/* attempt to handshake */
 			while( ( tmpval = mbedtls_ssl_handshake( ssl_ctx ) ) != 0 )
 			{
@@ -328,8 +406,13 @@ static void mqtt_demo_connect( void* arg )
 				}
 			}
 
+			int resumed = tls_session_cache_handshake_done( session_cache, ssl_ctx, tmpval,
+															( xTaskGetTickCount() - handshake_start ) * portTICK_PERIOD_MS );
+
 			if( tmpval == 0 )
 			{
+				handshake_report( session_cache, resumed );
+
 				/* Reset timeout on successful handshake */
 				mqtt_timeout = MQTT_RECONNECT_DELAY_MS;
 
@@ -346,17 +429,27 @@ static void mqtt_demo_connect( void* arg )
 					handler_args->socket = socket;
 					handler_args->ssl_ctx = ssl_ctx;
 					handler_args->connection_task = xTaskGetCurrentTaskHandle();
+					handler_args->connected = 0;
 
 					xTaskCreate( mqtt_handler, "mqtt", MQTT_DEMO_HANDLER_STACK_SIZE, ( void * ) handler_args, uxTaskPriorityGet( NULL ) + 1, &handler_task );
 
 					vTaskSuspend( NULL );
+
+					/*
+					 * A connection that was up has dropped, so reconnect
+					 * straight away while the broker still has the session.
+					 */
+					if( handler_args->connected && tls_session_cache_valid( session_cache ) )
+					{
+						mqtt_timeout = appconfMQTT_FAST_RECONNECT_DELAY_MS;
+					}
 					vPortFree( handler_args );
 				}
 				mbedtls_ssl_close_notify( ssl_ctx );
 			}
 			else
 			{
-				mqtt_timeout += MQTT_RECONNECT_DELAY_STEP_MS;
+				mqtt_timeout = reconnect_backoff( mqtt_timeout );
 			}
 
 			FreeRTOS_shutdown( socket, FREERTOS_SHUT_RDWR );
@@ -377,9 +470,7 @@ static void mqtt_demo_connect( void* arg )
 		}
 		else
 		{
-			mqtt_timeout = ( ( mqtt_timeout + MQTT_RECONNECT_DELAY_STEP_MS ) > MQTT_RECONNECT_DELAY_MAX_MS )
-							? ( MQTT_RECONNECT_DELAY_MAX_MS )
-							: ( mqtt_timeout + MQTT_RECONNECT_DELAY_STEP_MS );
+			mqtt_timeout = reconnect_backoff( mqtt_timeout );
 		}
 
 		FreeRTOS_closesocket( socket );
@@ -388,6 +479,8 @@ static void mqtt_demo_connect( void* arg )
 		vTaskDelay( pdMS_TO_TICKS( mqtt_timeout ) );
 	}
 
+	tls_session_cache_free( session_cache );
+	vPortFree( session_cache );
 	vPortFree( tls_ctx );
 	vPortFree( ssl_ctx );
 	vPortFree( ssl_conf );
@@ -405,6 +498,8 @@ void mqtt_demo_create( rtos_gpio_t *gpio_ctx, UBaseType_t priority )
         rtos_gpio_port_enable(gpio_ctx, led_port);
         gpio = gpio_ctx;
 
+        mqtt_router_init( &router, routes, sizeof( routes ) / sizeof( routes[0] ) );
+
         xTaskCreate( mqtt_demo_connect, "mqtt_demo", MQTT_DEMO_CONNECT_STACK_SIZE, ( void * ) NULL, priority, NULL );
     }
 }
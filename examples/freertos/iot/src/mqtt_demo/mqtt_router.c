@@ -0,0 +1,333 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "jsmn.h"
+
+#include "mqtt_router.h"
+
+/*
+ * Returns the index of the token after a token and all of its children, or
+ * -1 if they run past the last token.
+ */
+static int token_next( const jsmntok_t *tokens, int num_tokens, int i )
+{
+	int pending = 1;
+
+	while( pending > 0 )
+	{
+		if( i >= num_tokens )
+		{
+			return -1;
+		}
+		pending += tokens[i].size - 1;
+		i++;
+	}
+	return i;
+}
+
+/*
+ * Checks that the token at i is an object whose keys each have exactly one
+ * value. jsmn, unless built with JSMN_STRICT, accepts a key without a value
+ * such as {"LED"}. Returns the index of the token after the object, or -1.
+ */
+static int object_check( const jsmntok_t *tokens, int num_tokens, int i )
+{
+	int num_keys;
+
+	if( i >= num_tokens || tokens[i].type != JSMN_OBJECT )
+	{
+		return -1;
+	}
+
+	num_keys = tokens[i].size;
+	i++;
+	for( int k = 0; k < num_keys && i >= 0; k++ )
+	{
+		if( i + 1 >= num_tokens || tokens[i].size != 1 )
+		{
+			return -1;
+		}
+		i = token_next( tokens, num_tokens, i + 1 );
+	}
+	return i;
+}
+
+static void token_value( const char *payload, const jsmntok_t *token, mqtt_router_value_t *value )
+{
+	value->ptr = payload + token->start;
+	value->len = token->end - token->start;
+
+	switch( token->type )
+	{
+	case JSMN_STRING:
+		value->type = MQTT_ROUTER_STRING;
+		break;
+	case JSMN_OBJECT:
+		value->type = MQTT_ROUTER_OBJECT;
+		break;
+	case JSMN_ARRAY:
+		value->type = MQTT_ROUTER_ARRAY;
+		break;
+	default:
+		value->type = MQTT_ROUTER_PRIMITIVE;
+		break;
+	}
+}
+
+static const mqtt_router_field_t *field_find( const mqtt_router_route_t *route, const char *key, size_t key_len )
+{
+	for( size_t i = 0; i < route->num_fields; i++ )
+	{
+		const mqtt_router_field_t *field = &route->fields[i];
+
+		if( strncmp( field->key, key, key_len ) == 0 && field->key[key_len] == '\0' )
+		{
+			return field;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Handles the object at token i, which object_check() has accepted. Returns
+ * 0 on success, or -1 if a handler rejected it.
+ */
+static int object_dispatch( mqtt_router_t *router, const mqtt_router_route_t *route,
+							const char *payload, const jsmntok_t *tokens, int num_tokens, int i )
+{
+	const int num_keys = tokens[i].size;
+	int status = 0;
+
+	router->stats.objects++;
+
+	if( route->object_begin != NULL )
+	{
+		route->object_begin( route->ctx );
+	}
+
+	i++;
+	for( int k = 0; k < num_keys; k++ )
+	{
+		const jsmntok_t *key = &tokens[i];
+		const mqtt_router_field_t *field = NULL;
+
+		if( key->type == JSMN_STRING )
+		{
+			field = field_find( route, payload + key->start, key->end - key->start );
+		}
+
+		if( field != NULL )
+		{
+			mqtt_router_value_t value;
+
+			token_value( payload, &tokens[i + 1], &value );
+			router->stats.fields++;
+			if( field->fn( route->ctx, &value ) != 0 )
+			{
+				router->stats.failures++;
+				status = -1;
+			}
+		}
+		else
+		{
+			router->stats.unknown_keys++;
+		}
+
+		/* Skip the key and its value, which may be an object or array */
+		i = token_next( tokens, num_tokens, i + 1 );
+	}
+
+	if( route->object_end != NULL && route->object_end( route->ctx ) != 0 )
+	{
+		router->stats.failures++;
+		status = -1;
+	}
+
+	return status;
+}
+
+void mqtt_router_init( mqtt_router_t *router, const mqtt_router_route_t *routes, size_t num_routes )
+{
+	memset( router, 0, sizeof( *router ) );
+	router->routes = routes;
+	router->num_routes = num_routes;
+}
+
+int mqtt_router_dispatch( mqtt_router_t *router,
+						  const char *topic, size_t topic_len,
+						  const char *payload, size_t payload_len )
+{
+	const mqtt_router_route_t *route = NULL;
+	jsmn_parser parser;
+	jsmntok_t tokens[MQTT_ROUTER_MAX_TOKENS];
+	int num_tokens;
+	int failures = 0;
+
+	router->stats.messages++;
+
+	for( size_t i = 0; i < router->num_routes; i++ )
+	{
+		if( mqtt_router_topic_match( router->routes[i].topic, topic, topic_len ) )
+		{
+			route = &router->routes[i];
+			break;
+		}
+	}
+	if( route == NULL )
+	{
+		router->stats.unrouted++;
+		return 1;
+	}
+
+	jsmn_init( &parser );
+	num_tokens = jsmn_parse( &parser, payload, payload_len, tokens, MQTT_ROUTER_MAX_TOKENS );
+
+	if( num_tokens < 1 )
+	{
+		router->stats.parse_errors++;
+		return -1;
+	}
+
+	if( tokens[0].type == JSMN_OBJECT )
+	{
+		if( object_check( tokens, num_tokens, 0 ) < 0 )
+		{
+			router->stats.parse_errors++;
+			return -1;
+		}
+		failures += ( object_dispatch( router, route, payload, tokens, num_tokens, 0 ) != 0 );
+	}
+	else if( tokens[0].type == JSMN_ARRAY )
+	{
+		const int num_objects = tokens[0].size;
+		int i = 1;
+
+		/* A batch, so check it is all well formed objects before handling any of it */
+		for( int k = 0; k < num_objects; k++ )
+		{
+			i = object_check( tokens, num_tokens, i );
+			if( i < 0 )
+			{
+				router->stats.parse_errors++;
+				return -1;
+			}
+		}
+
+		i = 1;
+		for( int k = 0; k < num_objects; k++ )
+		{
+			failures += ( object_dispatch( router, route, payload, tokens, num_tokens, i ) != 0 );
+			i = token_next( tokens, num_tokens, i );
+		}
+	}
+	else
+	{
+		router->stats.parse_errors++;
+		return -1;
+	}
+
+	if( route->message_end != NULL )
+	{
+		route->message_end( route->ctx, failures );
+	}
+
+	return failures ? -1 : 0;
+}
+
+int mqtt_router_topic_match( const char *pattern, const char *topic, size_t topic_len )
+{
+	size_t t = 0;
+
+	/* Wildcards do not match the first level of topics such as $SYS */
+	if( topic_len > 0 && topic[0] == '$' && ( pattern[0] == '+' || pattern[0] == '#' ) )
+	{
+		return 0;
+	}
+
+	for( ;; )
+	{
+		if( *pattern == '#' )
+		{
+			return 1;
+		}
+
+		if( *pattern == '+' )
+		{
+			pattern++;
+			while( t < topic_len && topic[t] != '/' )
+			{
+				t++;
+			}
+		}
+		else
+		{
+			while( *pattern != '\0' && *pattern != '/' )
+			{
+				if( t >= topic_len || topic[t] != *pattern )
+				{
+					return 0;
+				}
+				pattern++;
+				t++;
+			}
+			if( t < topic_len && topic[t] != '/' )
+			{
+				return 0;
+			}
+		}
+
+		/* Both are now at the end of a level */
+		if( *pattern == '\0' )
+		{
+			return t == topic_len;
+		}
+		if( t == topic_len )
+		{
+			/* "a/#" also matches "a" */
+			return pattern[1] == '#' && pattern[2] == '\0';
+		}
+		pattern++;
+		t++;
+	}
+}
+
+int mqtt_router_value_equals( const mqtt_router_value_t *value, const char *str )
+{
+	return strncmp( value->ptr, str, value->len ) == 0 && str[value->len] == '\0';
+}
+
+int mqtt_router_value_to_int( const mqtt_router_value_t *value, int32_t *result )
+{
+	size_t i = 0;
+	int negative = 0;
+	int32_t n = 0;
+
+	if( value->type != MQTT_ROUTER_STRING && value->type != MQTT_ROUTER_PRIMITIVE )
+	{
+		return -1;
+	}
+
+	if( value->len > 0 && value->ptr[0] == '-' )
+	{
+		negative = 1;
+		i++;
+	}
+	if( i == value->len || value->len - i > 9 )
+	{
+		return -1;
+	}
+
+	for( ; i < value->len; i++ )
+	{
+		if( value->ptr[i] < '0' || value->ptr[i] > '9' )
+		{
+			return -1;
+		}
+		n = n * 10 + ( value->ptr[i] - '0' );
+	}
+
+	*result = negative ? -n : n;
+	return 0;
+}
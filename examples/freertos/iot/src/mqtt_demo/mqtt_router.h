@@ -0,0 +1,115 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef MQTT_ROUTER_H_
+#define MQTT_ROUTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Table driven MQTT command router.
+ *
+ * A route matches a topic pattern, with the MQTT '+' and '#' wildcards,
+ * and has a table of the JSON keys it handles. A message payload is either
+ * one JSON object or an array of them, so several updates may be batched
+ * in one message. Each object's keys are looked up in the table of the
+ * first route that matches the topic, and the value of each known key is
+ * passed to its handler. Values point into the payload, which is parsed in
+ * place and never copied, so they are not NUL terminated.
+ *
+ * Handlers are called in the order the keys appear. The route's optional
+ * object_begin and object_end are called around each object, so a handler
+ * may record a field and object_end may act on all the fields of the
+ * object together. The optional message_end is called once all the objects
+ * of a message have been handled, to apply a batch at once.
+ */
+
+/* The most JSON tokens a message may have. They are kept on the stack of the dispatching task. */
+#ifndef MQTT_ROUTER_MAX_TOKENS
+#define MQTT_ROUTER_MAX_TOKENS 32
+#endif
+
+typedef enum {
+	MQTT_ROUTER_STRING,
+	MQTT_ROUTER_PRIMITIVE,	/* A number, true, false or null */
+	MQTT_ROUTER_OBJECT,
+	MQTT_ROUTER_ARRAY,
+} mqtt_router_type_t;
+
+typedef struct {
+	const char *ptr;		/* Points into the payload, without the quotes of a string */
+	size_t len;
+	mqtt_router_type_t type;
+} mqtt_router_value_t;
+
+/* Returns 0 on success, or -1 if the value is not valid for the key */
+typedef int (*mqtt_router_field_fn_t)( void *ctx, const mqtt_router_value_t *value );
+typedef void (*mqtt_router_object_fn_t)( void *ctx );
+/* Returns 0 on success, or -1 if the object's fields are not valid together */
+typedef int (*mqtt_router_object_end_fn_t)( void *ctx );
+/* Called with the number of objects that failed, 0 if none did */
+typedef void (*mqtt_router_message_end_fn_t)( void *ctx, int failures );
+
+typedef struct {
+	const char *key;
+	mqtt_router_field_fn_t fn;
+} mqtt_router_field_t;
+
+typedef struct {
+	const char *topic;		/* The topic pattern */
+	const mqtt_router_field_t *fields;
+	size_t num_fields;
+	mqtt_router_object_fn_t object_begin;
+	mqtt_router_object_end_fn_t object_end;
+	mqtt_router_message_end_fn_t message_end;
+	void *ctx;				/* Passed to all of the route's functions */
+} mqtt_router_route_t;
+
+typedef struct {
+	uint32_t messages;		/* Messages dispatched */
+	uint32_t unrouted;		/* Messages on a topic with no route */
+	uint32_t parse_errors;	/* Messages that were not a well formed object or an array of them */
+	uint32_t objects;		/* Objects handled */
+	uint32_t fields;		/* Fields passed to handlers */
+	uint32_t unknown_keys;	/* Keys not in the route's table */
+	uint32_t failures;		/* Fields or objects that a handler rejected */
+} mqtt_router_stats_t;
+
+typedef struct {
+	const mqtt_router_route_t *routes;
+	size_t num_routes;
+	mqtt_router_stats_t stats;
+} mqtt_router_t;
+
+/*
+ * Initializes a router with a table of routes, which must remain valid.
+ * Routes are tried in order.
+ */
+void mqtt_router_init( mqtt_router_t *router, const mqtt_router_route_t *routes, size_t num_routes );
+
+/*
+ * Dispatches a message to the first route that matches its topic.
+ * Neither the topic nor the payload need be NUL terminated.
+ *
+ * Returns 0 if every object and field was handled, 1 if there was no
+ * route for the topic, or -1 if the payload could not be parsed or a
+ * handler rejected a field or object.
+ */
+int mqtt_router_dispatch( mqtt_router_t *router,
+						  const char *topic, size_t topic_len,
+						  const char *payload, size_t payload_len );
+
+/* Returns non-zero if an MQTT topic pattern matches a topic */
+int mqtt_router_topic_match( const char *pattern, const char *topic, size_t topic_len );
+
+/* Returns non-zero if a value is equal to a NUL terminated string */
+int mqtt_router_value_equals( const mqtt_router_value_t *value, const char *str );
+
+/*
+ * Converts a decimal integer value, either a primitive or a string.
+ * Returns 0 on success, or -1 if the value is not a decimal integer.
+ */
+int mqtt_router_value_to_int( const mqtt_router_value_t *value, int32_t *result );
+
+#endif /* MQTT_ROUTER_H_ */
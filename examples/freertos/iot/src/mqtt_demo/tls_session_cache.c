@@ -0,0 +1,124 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* App headers */
+#include "tls_session_cache.h"
+
+static uint32_t now_ms( void )
+{
+	return ( uint32_t ) xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+void tls_session_cache_init( tls_session_cache_t *cache, uint32_t lifetime_s )
+{
+	memset( cache, 0, sizeof( tls_session_cache_t ) );
+	mbedtls_ssl_session_init( &cache->session );
+	cache->lifetime_ms = lifetime_s * 1000;
+}
+
+int tls_session_cache_valid( tls_session_cache_t *cache )
+{
+	if( cache->valid && ( now_ms() - cache->saved_ms ) >= cache->lifetime_ms )
+	{
+		/* The server will have forgotten it too */
+		tls_session_cache_invalidate( cache );
+	}
+	return cache->valid;
+}
+
+int tls_session_cache_apply( tls_session_cache_t *cache, mbedtls_ssl_context *ssl_ctx )
+{
+	if( !tls_session_cache_valid( cache ) )
+	{
+		return 0;
+	}
+
+	if( mbedtls_ssl_set_session( ssl_ctx, &cache->session ) != 0 )
+	{
+		tls_session_cache_invalidate( cache );
+		return 0;
+	}
+	return 1;
+}
+
+int tls_session_cache_handshake_done( tls_session_cache_t *cache,
+									  mbedtls_ssl_context *ssl_ctx,
+									  int handshake_ret,
+									  uint32_t handshake_ms )
+{
+	mbedtls_ssl_session session;
+	int resumed;
+
+	if( handshake_ret != 0 )
+	{
+		/* Don't offer a session that may be why the handshake failed */
+		cache->stats.failed++;
+		tls_session_cache_invalidate( cache );
+		return 0;
+	}
+
+	mbedtls_ssl_session_init( &session );
+	if( mbedtls_ssl_get_session( ssl_ctx, &session ) != 0 )
+	{
+		mbedtls_ssl_session_free( &session );
+		tls_session_cache_invalidate( cache );
+		resumed = 0;
+	}
+	else
+	{
+		/*
+		 * A full handshake always derives a new master secret, so the
+		 * session was resumed if and only if it is unchanged.
+		 */
+		resumed = cache->valid && memcmp( session.master, cache->session.master, sizeof( session.master ) ) == 0;
+
+		if( cache->lifetime_ms > 0 )
+		{
+			mbedtls_ssl_session_free( &cache->session );
+			cache->session = session;
+			cache->valid = 1;
+			cache->saved_ms = now_ms();
+		}
+		else
+		{
+			mbedtls_ssl_session_free( &session );
+		}
+	}
+
+	if( resumed )
+	{
+		cache->stats.resumed++;
+		cache->stats.resumed_ms_total += handshake_ms;
+	}
+	else
+	{
+		cache->stats.full++;
+		cache->stats.full_ms_total += handshake_ms;
+	}
+	cache->stats.last_ms = handshake_ms;
+
+	return resumed;
+}
+
+void tls_session_cache_invalidate( tls_session_cache_t *cache )
+{
+	mbedtls_ssl_session_free( &cache->session );
+	mbedtls_ssl_session_init( &cache->session );
+	cache->valid = 0;
+}
+
+void tls_session_cache_stats_get( tls_session_cache_t *cache, tls_session_cache_stats_t *stats )
+{
+	*stats = cache->stats;
+}
+
+void tls_session_cache_free( tls_session_cache_t *cache )
+{
+	tls_session_cache_invalidate( cache );
+}
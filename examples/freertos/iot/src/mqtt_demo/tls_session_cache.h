@@ -0,0 +1,79 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef TLS_SESSION_CACHE_H_
+#define TLS_SESSION_CACHE_H_
+
+#include <stdint.h>
+
+#include "mbedtls/ssl.h"
+
+/*
+ * Client side TLS session cache, used to resume the previous session when
+ * reconnecting instead of performing a full handshake.
+ *
+ * After each successful handshake the session is saved, including its
+ * session ticket if the server issued one. It is offered to the server
+ * before the next handshake, and the server either resumes it, which
+ * skips the key exchange and certificate verification, or falls back to
+ * a full handshake. A session that fails to handshake is dropped.
+ *
+ * The session holds the master secret, so it is only ever kept in RAM.
+ */
+
+/* Handshake statistics, in milliseconds */
+typedef struct
+{
+	uint32_t resumed;			/* Handshakes that resumed the cached session */
+	uint32_t full;				/* Full handshakes */
+	uint32_t failed;			/* Handshakes that failed */
+	uint32_t resumed_ms_total;	/* The sum of the resumed handshake times */
+	uint32_t full_ms_total;		/* The sum of the full handshake times */
+	uint32_t last_ms;			/* The time of the last successful handshake */
+} tls_session_cache_stats_t;
+
+typedef struct
+{
+	mbedtls_ssl_session session;
+	int valid;
+	uint32_t saved_ms;
+	uint32_t lifetime_ms;
+
+	tls_session_cache_stats_t stats;
+} tls_session_cache_t;
+
+/*
+ * Initializes an empty cache. Sessions older than lifetime_s seconds are
+ * not offered. A lifetime of 0 disables resumption, while still keeping
+ * the handshake statistics.
+ */
+void tls_session_cache_init( tls_session_cache_t *cache, uint32_t lifetime_s );
+
+/*
+ * Offers the cached session, if there is one, to a connection that has
+ * been set up but not yet started its handshake.
+ * Returns 1 if a session was offered, otherwise 0.
+ */
+int tls_session_cache_apply( tls_session_cache_t *cache, mbedtls_ssl_context *ssl_ctx );
+
+/*
+ * Records the outcome of a handshake that took handshake_ms milliseconds.
+ * On success the connection's session is saved for the next connection.
+ * Returns 1 if the handshake resumed the cached session, otherwise 0.
+ */
+int tls_session_cache_handshake_done( tls_session_cache_t *cache,
+									  mbedtls_ssl_context *ssl_ctx,
+									  int handshake_ret,
+									  uint32_t handshake_ms );
+
+/* Drops the cached session, so that the next handshake is a full one */
+void tls_session_cache_invalidate( tls_session_cache_t *cache );
+
+/* Returns 1 if there is a session to offer, otherwise 0 */
+int tls_session_cache_valid( tls_session_cache_t *cache );
+
+void tls_session_cache_stats_get( tls_session_cache_t *cache, tls_session_cache_stats_t *stats );
+
+void tls_session_cache_free( tls_session_cache_t *cache );
+
+#endif /* TLS_SESSION_CACHE_H_ */
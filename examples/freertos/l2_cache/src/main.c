@@ -8,6 +8,7 @@
 
 #include "rtos_qspi_flash.h"
 #include "rtos_l2_cache.h"
+#include "qspi_flash_cal_qspi_io.h"
 
 #include "l2_cache.h"
 
@@ -25,6 +26,9 @@ rtos_l2_cache_t *l2_cache_ctx = &l2_cache_ctx_s;
 /* 1 for direct, 0 for two way associative */
 #define DIRECT_MAP 0
 
+/* QSPI flash timing calibration, kept in the last 4 KiB sector of the flash */
+#define FLASH_CAL_ADDR 0x3FF000
+
 void vApplicationMallocFailedHook(void)
 {
     debug_printf("Malloc failed!\n");
@@ -69,8 +73,68 @@ void app(void *args)
     }
 }
 
+/*
+ * Finds the fastest full speed clock configuration that reads the flash
+ * reliably, before the driver is started with it.
+ */
+static void flash_calibrate(qspi_flash_cal_result_t *result)
+{
+    /* 100 MHz down to the 25 MHz SPI read clock */
+    static const uint8_t divisors[] = { 3, 4, 5, 6, 8, 12 };
+    const qspi_flash_cal_config_t config = {
+        .addr = FLASH_CAL_ADDR,
+        .divisors = divisors,
+        .divisor_count = sizeof(divisors),
+        .max_sample_delay = 2,
+        .max_pad_delay = 5,
+        .margin = 1,
+        .reads_per_point = 8,
+        .bench_bytes = 64 * 1024,
+        /* The SPI read clock configuration, which the flash always meets */
+        .safe = { .divisor = 12, .sample_delay = 0, .sample_edge = QSPI_FLASH_CAL_EDGE_FALLING, .pad_delay = 0 },
+    };
+    qspi_flash_ctx_t *ctx = &qspi_flash_ctx->ctx;
+    qspi_io_ctx_t *qspi_io_ctx = &ctx->qspi_io_ctx;
+    int ret;
+
+    ctx->custom_clock_setup = 1;
+    ctx->quad_page_program_cmd = qspi_flash_page_program_1_4_4;
+    ctx->source_clock = qspi_io_source_clock_xcore;
+
+    qspi_io_ctx->clock_block = XS1_CLKBLK_1;
+    qspi_io_ctx->cs_port = PORT_SQI_CS;
+    qspi_io_ctx->sclk_port = PORT_SQI_SCLK;
+    qspi_io_ctx->sio_port = PORT_SQI_SIO;
+
+    qspi_io_ctx->full_speed_clk_divisor = 12;
+    qspi_io_ctx->full_speed_sclk_sample_delay = 0;
+    qspi_io_ctx->full_speed_sclk_sample_edge = qspi_io_sample_edge_falling;
+    qspi_io_ctx->full_speed_sio_pad_delay = 0;
+
+    qspi_io_ctx->spi_read_clk_divisor = 12;
+    qspi_io_ctx->spi_read_sclk_sample_delay = 0;
+    qspi_io_ctx->spi_read_sclk_sample_edge = qspi_io_sample_edge_falling;
+    qspi_io_ctx->spi_read_sio_pad_delay = 0;
+
+    qspi_flash_init(ctx);
+    ret = qspi_flash_cal_qspi_flash(ctx, &config, result);
+    qspi_flash_deinit(ctx);
+
+    rtos_printf("Flash %d MHz, sample delay %d %s edge, pad delay %d (%s), %d kB/s reads\n",
+                600 / (2 * result->setting.divisor),
+                result->setting.sample_delay,
+                result->setting.sample_edge == QSPI_FLASH_CAL_EDGE_RISING ? "rising" : "falling",
+                result->setting.pad_delay,
+                ret != 0 ? "calibration failed" :
+                result->source == QSPI_FLASH_CAL_SOURCE_CACHE ? "cached" :
+                result->source == QSPI_FLASH_CAL_SOURCE_SWEEP ? "calibrated" : "no margin",
+                result->read_bytes_per_sec / 1000);
+}
+
 void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
 {
+    qspi_flash_cal_result_t flash_cal;
+
     (void)c0;
     (void)c1;
     (void)c2;
@@ -101,15 +165,19 @@ void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
     qspi_flash_ctx->ctx.sr2_read_cmd = 0xEEFFEFEF;
     qspi_flash_ctx->ctx.sr2_write_cmd = 0xEEEEEEEE;
 
+    flash_calibrate(&flash_cal);
+
     rtos_qspi_flash_init(qspi_flash_ctx, XS1_CLKBLK_1, PORT_SQI_CS,
                          PORT_SQI_SCLK, PORT_SQI_SIO,
 
                          /** Derive QSPI clock from the 600 MHz xcore clock **/
                          qspi_io_source_clock_xcore,
 
-                         /** Full speed clock configuration **/
-                         5, // 600 MHz / (2*5) -> 60 MHz,
-                         1, qspi_io_sample_edge_rising, 0,
+                         /** Full speed clock configuration, from calibration **/
+                         flash_cal.setting.divisor,
+                         flash_cal.setting.sample_delay,
+                         qspi_flash_cal_qspi_io_edge(&flash_cal.setting),
+                         flash_cal.setting.pad_delay,
 
                          /** SPI read clock configuration **/
                          12, // 600 MHz / (2*12) -> 25 MHz
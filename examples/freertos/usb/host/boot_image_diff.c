@@ -0,0 +1,235 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "boot_image_diff.h"
+#include "boot_image_patch.h"
+
+#define MIN_MATCH       BOOT_IMAGE_DIFF_MIN_MATCH
+#define MIN_FILL        16
+#define HASH_BITS       20
+#define HASH_SIZE       (1 << HASH_BITS)
+#define MAX_CANDIDATES  32
+#define NO_POS          0xFFFFFFFF
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    int failed;
+    boot_image_diff_stats_t stats;
+} patch_buf_t;
+
+static void put(patch_buf_t *p, const void *data, size_t len)
+{
+    if (p->failed) {
+        return;
+    }
+    if (p->len + len > p->cap) {
+        size_t cap = p->cap ? p->cap : 4096;
+        uint8_t *buf;
+
+        while (cap < p->len + len) {
+            cap *= 2;
+        }
+        if ((buf = realloc(p->buf, cap)) == NULL) {
+            p->failed = 1;
+            return;
+        }
+        p->buf = buf;
+        p->cap = cap;
+    }
+    memcpy(&p->buf[p->len], data, len);
+    p->len += len;
+}
+
+static void put_cmd(patch_buf_t *p, uint32_t op, uint32_t len, uint32_t arg)
+{
+    const uint32_t w[2] = { (op << 28) | len, arg };
+
+    put(p, w, sizeof(w));
+}
+
+static void emit_copy(patch_buf_t *p, uint32_t src_off, uint32_t len)
+{
+    while (len > 0) {
+        const uint32_t n = (len > BOOT_IMAGE_PATCH_LEN_MASK) ? BOOT_IMAGE_PATCH_LEN_MASK : len;
+
+        put_cmd(p, BOOT_IMAGE_PATCH_OP_COPY, n, src_off);
+        p->stats.copy_cmds++;
+        p->stats.copied += n;
+        src_off += n;
+        len -= n;
+    }
+}
+
+/* Sends new bytes, as fills where a byte repeats long enough to be worth it */
+static void emit_literal(patch_buf_t *p, const uint8_t *data, uint32_t len)
+{
+    uint32_t start = 0;
+    uint32_t i = 0;
+
+    while (i < len) {
+        uint32_t run = 1;
+
+        while (i + run < len && data[i + run] == data[i]) {
+            run++;
+        }
+        if (run < MIN_FILL) {
+            i += run;
+            continue;
+        }
+        if (i > start) {
+            put_cmd(p, BOOT_IMAGE_PATCH_OP_DATA, i - start, 0);
+            put(p, &data[start], i - start);
+            p->stats.data_cmds++;
+            p->stats.literal += i - start;
+        }
+        put_cmd(p, BOOT_IMAGE_PATCH_OP_FILL, run, data[i]);
+        p->stats.fill_cmds++;
+        p->stats.filled += run;
+        i += run;
+        start = i;
+    }
+    if (len > start) {
+        put_cmd(p, BOOT_IMAGE_PATCH_OP_DATA, len - start, 0);
+        put(p, &data[start], len - start);
+        p->stats.data_cmds++;
+        p->stats.literal += len - start;
+    }
+}
+
+static uint32_t hash(const uint8_t *data)
+{
+    uint32_t h = 0;
+
+    for (int i = 0; i < MIN_MATCH; i++) {
+        h = (h * 0x01000193) ^ data[i];
+    }
+    return (h * 0x9E3779B1) >> (32 - HASH_BITS);
+}
+
+static size_t match_len(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+    const size_t max = (a_len < b_len) ? a_len : b_len;
+    size_t n = 0;
+
+    while (n < max && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+static uint32_t image_crc(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < len; i += sizeof(uint32_t)) {
+        uint32_t w;
+
+        memcpy(&w, &data[i], sizeof(w));
+        crc = boot_image_patch_crc(crc, &w, 1);
+    }
+    return ~crc;
+}
+
+uint8_t *boot_image_diff(const uint8_t *src, size_t src_len,
+                         const uint8_t *tgt, size_t tgt_len,
+                         size_t *patch_len, boot_image_diff_stats_t *stats)
+{
+    patch_buf_t p = { 0 };
+    boot_image_patch_header_t h;
+    uint32_t *head;
+    uint32_t *chain;
+    size_t lit_start = 0;
+    size_t pos = 0;
+    size_t expect = NO_POS;   /* The source offset that follows the last copy */
+
+    if ((src_len % sizeof(uint32_t)) != 0 || (tgt_len % sizeof(uint32_t)) != 0 ||
+        tgt_len == 0 || tgt_len > 0xFFFFFFFF || src_len > 0xFFFFFFFF) {
+        return NULL;
+    }
+
+    head = malloc(HASH_SIZE * sizeof(uint32_t));
+    chain = malloc((src_len + 1) * sizeof(uint32_t));
+    if (head == NULL || chain == NULL) {
+        free(head);
+        free(chain);
+        return NULL;
+    }
+
+    /* Later offsets are found first, so where code has moved nearby wins */
+    memset(head, 0xFF, HASH_SIZE * sizeof(uint32_t));
+    for (size_t i = 0; i + MIN_MATCH <= src_len; i++) {
+        const uint32_t k = hash(&src[i]);
+
+        chain[i] = head[k];
+        head[k] = (uint32_t) i;
+    }
+
+    h.magic = BOOT_IMAGE_PATCH_MAGIC;
+    h.source_size = (uint32_t) src_len;
+    h.source_crc = image_crc(src, src_len);
+    h.target_size = (uint32_t) tgt_len;
+    h.target_crc = image_crc(tgt, tgt_len);
+    h.header_crc = ~boot_image_patch_crc(0xFFFFFFFF, (const uint32_t *) &h, 5);
+    put(&p, &h, sizeof(h));
+
+    while (pos < tgt_len) {
+        size_t best_len = 0;
+        size_t best_src = 0;
+
+        if (expect != NO_POS && expect < src_len) {
+            best_len = match_len(&src[expect], src_len - expect, &tgt[pos], tgt_len - pos);
+            best_src = expect;
+        }
+
+        if (best_len < MIN_MATCH && pos + MIN_MATCH <= tgt_len) {
+            uint32_t cand = head[hash(&tgt[pos])];
+
+            for (int i = 0; i < MAX_CANDIDATES && cand != NO_POS; i++, cand = chain[cand]) {
+                const size_t n = match_len(&src[cand], src_len - cand, &tgt[pos], tgt_len - pos);
+
+                if (n > best_len) {
+                    best_len = n;
+                    best_src = cand;
+                }
+            }
+        }
+
+        if (best_len < MIN_MATCH) {
+            /* Keep the continuation in step with a changed byte, as patched code does */
+            if (expect != NO_POS) {
+                expect++;
+            }
+            pos++;
+            continue;
+        }
+
+        if (pos > lit_start) {
+            emit_literal(&p, &tgt[lit_start], (uint32_t) (pos - lit_start));
+        }
+        emit_copy(&p, (uint32_t) best_src, (uint32_t) best_len);
+        pos += best_len;
+        lit_start = pos;
+        expect = best_src + best_len;
+    }
+    if (pos > lit_start) {
+        emit_literal(&p, &tgt[lit_start], (uint32_t) (pos - lit_start));
+    }
+
+    free(head);
+    free(chain);
+
+    if (p.failed) {
+        free(p.buf);
+        return NULL;
+    }
+    *patch_len = p.len;
+    if (stats != NULL) {
+        *stats = p.stats;
+    }
+    return p.buf;
+}
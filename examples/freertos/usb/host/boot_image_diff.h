@@ -0,0 +1,57 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BOOT_IMAGE_DIFF_H_
+#define BOOT_IMAGE_DIFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup boot_image_diff
+ *
+ * Makes delta update patches for boot_image_patch on the host.
+ *
+ * Every offset of the source image is indexed by a hash of the bytes that
+ * start there. The new image is then scanned: where it carries on from
+ * the last range copied, or where a run of BOOT_IMAGE_DIFF_MIN_MATCH bytes
+ * is found in the index, the match is extended as far as it goes and
+ * copied from the source image, and everything else is sent as data. So
+ * code that has moved, as well as code that has not changed, costs one
+ * command. Runs of a single byte are sent as fills.
+ * @{
+ */
+
+/** The shortest match that is copied rather than sent. */
+#define BOOT_IMAGE_DIFF_MIN_MATCH   32
+
+/** Patch statistics. */
+typedef struct {
+    uint32_t copy_cmds;         /**< COPY commands. */
+    uint32_t copied;            /**< Bytes copied from the source image. */
+    uint32_t data_cmds;         /**< DATA commands. */
+    uint32_t literal;           /**< Bytes sent in the patch. */
+    uint32_t fill_cmds;         /**< FILL commands. */
+    uint32_t filled;            /**< Bytes filled. */
+} boot_image_diff_stats_t;
+
+/**
+ * Makes a patch that turns one image into another.
+ *
+ * \param src        The image the device has
+ * \param src_len    Its size, a whole number of words
+ * \param tgt        The new image
+ * \param tgt_len    Its size, a whole number of words
+ * \param patch_len  Receives the size of the patch
+ * \param stats      Receives the patch statistics, or NULL
+ *
+ * \return the patch, to be freed with free(), or NULL if an image size is
+ *         not a whole number of words or there is not enough memory
+ */
+uint8_t *boot_image_diff(const uint8_t *src, size_t src_len,
+                         const uint8_t *tgt, size_t tgt_len,
+                         size_t *patch_len, boot_image_diff_stats_t *stats);
+
+/**@}*/
+
+#endif /* BOOT_IMAGE_DIFF_H_ */
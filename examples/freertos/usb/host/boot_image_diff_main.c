@@ -0,0 +1,88 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Makes a delta update patch for the dfu_runtime demo.
+ *
+ *   example_freertos_usb_boot_image_diff <old image> <new image> <patch>
+ *
+ * The old image must be the upgrade image, as made by xflash --upgrade,
+ * that the device is running, or the factory image as it is in flash.
+ * Download the patch as you would the new image:
+ *
+ *   dfu-util -D <patch>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "boot_image_diff.h"
+
+static uint8_t *file_read(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    long size;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        buf = malloc(size > 0 ? (size_t) size : 1);
+        if (buf != NULL && fread(buf, 1, (size_t) size, f) != (size_t) size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = (size_t) size;
+    }
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    boot_image_diff_stats_t stats;
+    uint8_t *src;
+    uint8_t *tgt;
+    uint8_t *patch;
+    size_t src_len = 0;
+    size_t tgt_len = 0;
+    size_t patch_len = 0;
+    FILE *f;
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <old image> <new image> <patch>\n", argv[0]);
+        return 1;
+    }
+
+    if ((src = file_read(argv[1], &src_len)) == NULL) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    if ((tgt = file_read(argv[2], &tgt_len)) == NULL) {
+        fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+
+    patch = boot_image_diff(src, src_len, tgt, tgt_len, &patch_len, &stats);
+    if (patch == NULL) {
+        fprintf(stderr, "cannot make a patch, image sizes must be a whole number of words\n");
+        return 1;
+    }
+
+    if ((f = fopen(argv[3], "wb")) == NULL || fwrite(patch, 1, patch_len, f) != patch_len) {
+        fprintf(stderr, "cannot write %s\n", argv[3]);
+        return 1;
+    }
+    fclose(f);
+
+    printf("new image %zu bytes, patch %zu bytes (%.1f%%)\n",
+           tgt_len, patch_len, 100.0 * patch_len / tgt_len);
+    printf("copy %u commands %u bytes, data %u commands %u bytes, fill %u commands %u bytes\n",
+           stats.copy_cmds, stats.copied, stats.data_cmds, stats.literal, stats.fill_cmds, stats.filled);
+
+    free(src);
+    free(tgt);
+    free(patch);
+    return 0;
+}
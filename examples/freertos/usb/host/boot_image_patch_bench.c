@@ -0,0 +1,489 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Host test and benchmark for delta updates with boot_image_patch.
+ *
+ * The flash is a file, erased to 0xFF, that the flash access functions
+ * read and program with NOR semantics, accounting time with the same
+ * QSPI model as the other flash benchmarks. A factory image is placed in
+ * it, and new images are built from it with small changes, with code
+ * inserted part way through, and with nothing in common. For each, a
+ * patch is made with boot_image_diff and applied in DFU sized blocks into
+ * the slot that boot_image_locate_available_spot() would return, and the
+ * update time is compared with downloading the whole image over a slow
+ * control link.
+ *
+ * It also checks that a patch split at every byte gives the same image,
+ * that the source image is chosen by its CRC from the current and factory
+ * images, and that a patch for another image, a corrupt patch and a
+ * truncated patch all leave the destination without an image header. The
+ * exit code is non-zero on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "boot_image_diff.h"
+#include "boot_image_patch.h"
+
+#define FLASH_SIZE              (4 * 1024 * 1024)
+#define SECTOR_SIZE             BOOT_IMAGE_PATCH_SECTOR_SIZE
+#define FACTORY_ADDR            0x1E40      /* after the second stage loader */
+#define IMAGE_SIZE              (1024 * 1024)
+#define BOOT_PARTITION_SIZE     0x380000
+
+/* Flash timing model, in nanoseconds */
+#define SIM_CMD_NS              2000        /* command, address, dummy cycles and driver overhead */
+#define SIM_NS_PER_BYTE         33          /* quad SPI at 60 MHz */
+#define SIM_PAGE_SIZE           256
+#define SIM_PAGE_PROGRAM_NS     400000
+#define SIM_ERASE_4K_NS         45000000
+
+/* A slow control link: full speed DFU, 4 KiB blocks */
+#define LINK_BLOCK              4096
+#define LINK_REQUEST_NS         2000000     /* DFU_DNLOAD and DFU_GETSTATUS turnaround per block */
+#define LINK_NS_PER_BYTE        30000       /* about 33 KB/s */
+
+typedef struct {
+    FILE *file;
+    uint64_t busy_ns;
+    uint32_t erases;
+    uint64_t read_bytes;
+    int errors;
+} file_flash_t;
+
+static file_flash_t flash;
+static boot_image_patch_t patcher;
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/*
+ * File backed flash
+ */
+
+static void file_flash_reset(file_flash_t *f)
+{
+    static uint8_t blank[SECTOR_SIZE];
+
+    if (f->file == NULL) {
+        f->file = tmpfile();
+        if (f->file == NULL) {
+            perror("tmpfile");
+            exit(1);
+        }
+    }
+    memset(blank, 0xFF, sizeof(blank));
+    fseek(f->file, 0, SEEK_SET);
+    for (uint32_t i = 0; i < FLASH_SIZE; i += SECTOR_SIZE) {
+        fwrite(blank, 1, SECTOR_SIZE, f->file);
+    }
+    fflush(f->file);
+    f->busy_ns = 0;
+    f->erases = 0;
+    f->read_bytes = 0;
+    f->errors = 0;
+}
+
+static void file_flash_load(file_flash_t *f, uint32_t addr, const uint8_t *buf, size_t len)
+{
+    fseek(f->file, addr, SEEK_SET);
+    fwrite(buf, 1, len, f->file);
+    fflush(f->file);
+}
+
+static void file_flash_peek(file_flash_t *f, uint32_t addr, uint8_t *buf, size_t len)
+{
+    fseek(f->file, addr, SEEK_SET);
+    if (fread(buf, 1, len, f->file) != len) {
+        memset(buf, 0, len);
+    }
+}
+
+size_t boot_image_patch_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    file_flash_t *f = app_data;
+
+    file_flash_peek(f, addr, buf, len);
+    f->busy_ns += SIM_CMD_NS + (uint64_t) len * SIM_NS_PER_BYTE;
+    f->read_bytes += len;
+
+    return len;
+}
+
+size_t boot_image_patch_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    file_flash_t *f = app_data;
+    static uint8_t cur[SECTOR_SIZE];
+
+    for (size_t done = 0; done < len;) {
+        size_t n = len - done;
+
+        if (n > sizeof(cur)) {
+            n = sizeof(cur);
+        }
+        file_flash_peek(f, addr + done, cur, n);
+        for (size_t i = 0; i < n; i++) {
+            if ((cur[i] & buf[done + i]) != buf[done + i]) {
+                f->errors++;
+            }
+            cur[i] &= buf[done + i];
+        }
+        file_flash_load(f, addr + done, cur, n);
+        done += n;
+    }
+
+    for (size_t done = 0; done < len;) {
+        size_t n = SIM_PAGE_SIZE - ((addr + done) % SIM_PAGE_SIZE);
+        if (n > len - done) {
+            n = len - done;
+        }
+        f->busy_ns += SIM_CMD_NS + (uint64_t) n * SIM_NS_PER_BYTE + SIM_PAGE_PROGRAM_NS;
+        done += n;
+    }
+
+    return len;
+}
+
+void boot_image_patch_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    file_flash_t *f = app_data;
+    static uint8_t blank[SECTOR_SIZE];
+
+    memset(blank, 0xFF, sizeof(blank));
+    for (size_t done = 0; done < len; done += SECTOR_SIZE) {
+        file_flash_load(f, addr + done, blank, SECTOR_SIZE);
+    }
+    f->busy_ns += (len / SECTOR_SIZE) * (uint64_t) SIM_ERASE_4K_NS;
+    f->erases += len / SECTOR_SIZE;
+}
+
+/*
+ * Images
+ */
+
+/* Where boot_image_locate_available_spot() puts the image after one at addr */
+static uint32_t next_slot(uint32_t addr, uint32_t size)
+{
+    return ((addr + size) / SECTOR_SIZE + 1) * SECTOR_SIZE;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand_next(void)
+{
+    /* xorshift32, as the low bits of an LCG repeat too soon to stand in for code */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void image_random(uint8_t *img, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        img[i] = (uint8_t) rand_next();
+    }
+}
+
+/* Rewrites a few functions and bumps the version word */
+static void image_edit(uint8_t *img, size_t len, int edits)
+{
+    img[20]++;
+    for (int e = 0; e < edits; e++) {
+        const size_t at = (rand_next() % (len - 2048)) & ~3u;
+        const size_t n = 64 + (rand_next() % 1024);
+
+        for (size_t i = 0; i < n; i++) {
+            img[at + i] = (uint8_t) rand_next();
+        }
+    }
+}
+
+/* Inserts new code part way through, moving everything after it */
+static size_t image_insert(uint8_t *dst, const uint8_t *src, size_t len, size_t at, size_t n)
+{
+    memcpy(dst, src, at);
+    image_random(&dst[at], n);
+    memcpy(&dst[at + n], &src[at], len - at - n);
+    return len;
+}
+
+/*
+ * Patching
+ */
+
+typedef struct {
+    const char *name;
+    size_t patch_len;
+    uint64_t link_ns;
+    uint64_t flash_ns;
+    boot_image_patch_stats_t stats;
+} run_t;
+
+static uint64_t link_ns(size_t len)
+{
+    const uint64_t blocks = (len + LINK_BLOCK - 1) / LINK_BLOCK + 1;    /* and the zero length block */
+
+    return blocks * LINK_REQUEST_NS + (uint64_t) len * LINK_NS_PER_BYTE;
+}
+
+static void patch_begin(uint32_t dst, uint32_t current_addr, uint32_t current_size)
+{
+    boot_image_patch_init(&patcher, dst, BOOT_PARTITION_SIZE - dst, &flash);
+    if (current_size > 0) {
+        boot_image_patch_source_add(&patcher, current_addr, current_size);
+    }
+    boot_image_patch_source_add(&patcher, FACTORY_ADDR, IMAGE_SIZE);
+}
+
+/* Applies a patch in blocks, returning the first error or the result of finishing */
+static int patch_apply(run_t *r, const uint8_t *patch, size_t len, size_t block)
+{
+    const uint64_t t0 = flash.busy_ns;
+    int ret = BOOT_IMAGE_PATCH_OK;
+
+    for (size_t off = 0; off < len && ret == BOOT_IMAGE_PATCH_OK; off += block) {
+        ret = boot_image_patch_write(&patcher, &patch[off], (len - off < block) ? len - off : block);
+    }
+    if (ret == BOOT_IMAGE_PATCH_OK) {
+        ret = boot_image_patch_finish(&patcher);
+    }
+
+    if (r != NULL) {
+        r->patch_len = len;
+        r->link_ns = link_ns(len);
+        r->flash_ns = flash.busy_ns - t0;
+        boot_image_patch_stats_get(&patcher, &r->stats);
+    }
+    return ret;
+}
+
+static int flash_equals(uint32_t addr, const uint8_t *img, size_t len)
+{
+    static uint8_t buf[IMAGE_SIZE];
+
+    file_flash_peek(&flash, addr, buf, len);
+    return memcmp(buf, img, len) == 0;
+}
+
+static int flash_blank(uint32_t addr, size_t len)
+{
+    uint8_t buf[SECTOR_SIZE];
+
+    file_flash_peek(&flash, addr, buf, len);
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != 0xFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report(run_t *r, const run_t *full)
+{
+    const double total_s = (r->link_ns + r->flash_ns) / 1e9;
+    const double full_s = (full->link_ns + full->flash_ns) / 1e9;
+
+    printf("%-12s %9zu %6.1f%% %8u %8u %8.2f %8.2f %8.2f %7.1fx\n",
+           r->name, r->patch_len, 100.0 * r->patch_len / IMAGE_SIZE,
+           r->stats.copied / 1024, r->stats.literal / 1024,
+           r->link_ns / 1e9, r->flash_ns / 1e9, total_s, full_s / total_s);
+}
+
+/* Makes a patch, applies it into the slot after the factory image and checks the result */
+static void run_update(run_t *r, const uint8_t *src, size_t src_len, const uint8_t *tgt, const run_t *full)
+{
+    const uint32_t dst = next_slot(FACTORY_ADDR, IMAGE_SIZE);
+    uint8_t *patch;
+    size_t len;
+    int ret;
+
+    patch = boot_image_diff(src, src_len, tgt, IMAGE_SIZE, &len, NULL);
+    check(patch != NULL, "patch made");
+    if (patch == NULL) {
+        return;
+    }
+
+    patch_begin(dst, 0, 0);
+    ret = patch_apply(r, patch, len, LINK_BLOCK);
+    check(ret == BOOT_IMAGE_PATCH_OK, r->name);
+    check(flash_equals(dst, tgt, IMAGE_SIZE), "new image in flash");
+    check(flash.errors == 0, "no programming of unerased flash");
+
+    report(r, full != NULL ? full : r);
+    free(patch);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t factory[IMAGE_SIZE];
+    static uint8_t small[IMAGE_SIZE];
+    static uint8_t inserted[IMAGE_SIZE];
+    static uint8_t later[IMAGE_SIZE];
+    static uint8_t unrelated[IMAGE_SIZE];
+    const uint32_t slot1 = next_slot(FACTORY_ADDR, IMAGE_SIZE);
+    const uint32_t slot2 = next_slot(slot1, IMAGE_SIZE);
+    uint8_t *patch;
+    size_t len;
+    int ret;
+
+    (void) argc;
+    (void) argv;
+
+    image_random(factory, IMAGE_SIZE);
+    memcpy(small, factory, IMAGE_SIZE);
+    image_edit(small, IMAGE_SIZE, 8);
+    image_insert(inserted, factory, IMAGE_SIZE, IMAGE_SIZE * 2 / 5, 2048);
+    image_edit(inserted, IMAGE_SIZE, 4);
+    memcpy(later, small, IMAGE_SIZE);
+    image_edit(later, IMAGE_SIZE, 2);
+    image_random(unrelated, IMAGE_SIZE);
+
+    printf("flash model: %u ns/cmd, %u ns/byte, %u us/page, %u ms erase 4K\n",
+           SIM_CMD_NS, SIM_NS_PER_BYTE, SIM_PAGE_PROGRAM_NS / 1000, SIM_ERASE_4K_NS / 1000000);
+    printf("link model: %u byte blocks, %u us/block, %u ns/byte\n",
+           LINK_BLOCK, LINK_REQUEST_NS / 1000, LINK_NS_PER_BYTE);
+    printf("image: %u bytes, patcher RAM %zu bytes\n\n", IMAGE_SIZE, sizeof(boot_image_patch_t));
+    printf("%-12s %9s %7s %8s %8s %8s %8s %8s %8s\n",
+           "update", "patch", "", "copy KB", "data KB", "link s", "flash s", "total s", "speedup");
+
+    /* A patch with an empty source image is the whole image */
+    {
+        run_t full = {.name = "full image"};
+        run_t small_run = {.name = "small edits"};
+        run_t insert_run = {.name = "insertion"};
+        run_t unrelated_run = {.name = "unrelated"};
+
+        file_flash_reset(&flash);
+        file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+
+        run_update(&full, factory, 0, small, NULL);
+        run_update(&small_run, factory, IMAGE_SIZE, small, &full);
+        run_update(&insert_run, factory, IMAGE_SIZE, inserted, &full);
+        run_update(&unrelated_run, factory, IMAGE_SIZE, unrelated, &full);
+
+        check(small_run.patch_len < IMAGE_SIZE / 50, "small edits make a small patch");
+        check(insert_run.patch_len < IMAGE_SIZE / 50, "inserted code makes a small patch");
+        check(unrelated_run.patch_len < IMAGE_SIZE + IMAGE_SIZE / 100, "unrelated image patch is not much bigger");
+        check(flash_equals(FACTORY_ADDR, factory, IMAGE_SIZE), "factory image untouched");
+    }
+
+    /* The same patch split at every byte, and in odd sized pieces */
+    {
+        static const size_t blocks[] = {1, 7, 61, 4093};
+
+        patch = boot_image_diff(factory, IMAGE_SIZE, inserted, IMAGE_SIZE, &len, NULL);
+        for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+            file_flash_reset(&flash);
+            file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+            patch_begin(slot1, 0, 0);
+            check(patch_apply(NULL, patch, len, blocks[i]) == BOOT_IMAGE_PATCH_OK, "split patch applied");
+            check(flash_equals(slot1, inserted, IMAGE_SIZE), "split patch gives the new image");
+        }
+        free(patch);
+    }
+
+    /* The source is chosen by CRC, from the current image then the factory image */
+    {
+        boot_image_patch_stats_t stats;
+
+        file_flash_reset(&flash);
+        file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+        file_flash_load(&flash, slot1, small, IMAGE_SIZE);
+
+        patch = boot_image_diff(small, IMAGE_SIZE, later, IMAGE_SIZE, &len, NULL);
+        patch_begin(slot2, slot1, IMAGE_SIZE);
+        check(patch_apply(NULL, patch, len, LINK_BLOCK) == BOOT_IMAGE_PATCH_OK, "patch from current image");
+        boot_image_patch_stats_get(&patcher, &stats);
+        check(stats.source_addr == slot1, "current image used as source");
+        check(flash_equals(slot2, later, IMAGE_SIZE), "image from current in flash");
+        free(patch);
+
+        patch = boot_image_diff(factory, IMAGE_SIZE, later, IMAGE_SIZE, &len, NULL);
+        patch_begin(slot2, slot1, IMAGE_SIZE);
+        check(patch_apply(NULL, patch, len, LINK_BLOCK) == BOOT_IMAGE_PATCH_OK, "patch from factory image");
+        boot_image_patch_stats_get(&patcher, &stats);
+        check(stats.source_addr == FACTORY_ADDR, "factory image used as source");
+        check(flash_equals(slot2, later, IMAGE_SIZE), "image from factory in flash");
+
+        /* With no free slot the current image is overwritten, so it cannot be the source */
+        patch_begin(slot1, slot1, IMAGE_SIZE);
+        check(patch_apply(NULL, patch, len, LINK_BLOCK) == BOOT_IMAGE_PATCH_OK, "patch over current image");
+        boot_image_patch_stats_get(&patcher, &stats);
+        check(stats.source_addr == FACTORY_ADDR, "overlapping image not used as source");
+        free(patch);
+
+        /* Even when it is the only image the patch was made from */
+        {
+            const uint32_t erases = flash.erases;
+
+            file_flash_load(&flash, slot1, small, IMAGE_SIZE);
+            patch = boot_image_diff(small, IMAGE_SIZE, later, IMAGE_SIZE, &len, NULL);
+            patch_begin(slot1, slot1, IMAGE_SIZE);
+            check(patch_apply(NULL, patch, len, LINK_BLOCK) == BOOT_IMAGE_PATCH_ERR_SOURCE, "patch from overlapping image rejected");
+            check(flash.erases == erases, "patch from overlapping image erases nothing");
+            check(flash_equals(slot1, small, IMAGE_SIZE), "overlapping image intact");
+            free(patch);
+        }
+    }
+
+    /* A patch for an image that is not in flash is rejected before anything is erased */
+    {
+        file_flash_reset(&flash);
+        file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+        file_flash_load(&flash, slot1, small, IMAGE_SIZE);
+
+        patch = boot_image_diff(unrelated, IMAGE_SIZE, later, IMAGE_SIZE, &len, NULL);
+        patch_begin(slot1, 0, 0);
+        ret = boot_image_patch_write(&patcher, patch, LINK_BLOCK);
+        check(ret == BOOT_IMAGE_PATCH_ERR_SOURCE, "unknown source rejected");
+        check(flash.erases == 0, "unknown source erases nothing");
+        free(patch);
+    }
+
+    /* A corrupt or truncated patch leaves no image header */
+    {
+        patch = boot_image_diff(factory, IMAGE_SIZE, inserted, IMAGE_SIZE, &len, NULL);
+
+        file_flash_reset(&flash);
+        file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+        patch[len - 100] ^= 0x10;
+        patch_begin(slot1, 0, 0);
+        ret = patch_apply(NULL, patch, len, LINK_BLOCK);
+        check(ret == BOOT_IMAGE_PATCH_ERR_VERIFY, "corrupt patch fails verification");
+        check(flash_blank(slot1, SECTOR_SIZE), "corrupt patch leaves no header");
+        patch[len - 100] ^= 0x10;
+
+        file_flash_reset(&flash);
+        file_flash_load(&flash, FACTORY_ADDR, factory, IMAGE_SIZE);
+        patch_begin(slot1, 0, 0);
+        ret = patch_apply(NULL, patch, len - 5, LINK_BLOCK);
+        check(ret == BOOT_IMAGE_PATCH_ERR_INCOMPLETE, "truncated patch rejected");
+        check(flash_blank(slot1, SECTOR_SIZE), "truncated patch leaves no header");
+
+        patch[0] ^= 1;
+        patch_begin(slot1, 0, 0);
+        ret = patch_apply(NULL, patch, len, LINK_BLOCK);
+        check(ret == BOOT_IMAGE_PATCH_ERR_HEADER, "corrupt header rejected");
+        free(patch);
+    }
+
+    fclose(flash.file);
+
+    if (failures) {
+        printf("\nFAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("\nAll checks passed\n");
+    return 0;
+}
@@ -0,0 +1,424 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Host benchmark for the dfu demo's image stream.
+ *
+ * A 1 MiB upgrade image is downloaded into a simulated NOR flash, which
+ * accounts time with the same model of QSPI command overhead, transfer
+ * rate, page program and erase times as the MSC flash benchmark. The USB
+ * side is modelled as dfu-util drives it: a DFU_DNLOAD request for each
+ * block, then DFU_GETSTATUS requests until the device is idle, sleeping
+ * for the poll timeout the device returns between them.
+ *
+ *   rmw            - read, erase and write the sector of each block before
+ *                    completing it, as the dfu_runtime demo does
+ *   stream serial  - the image stream, programming each sector before
+ *                    completing the block that filled it
+ *   stream         - the image stream, programming each sector while the
+ *                    next one is downloaded
+ *   resume         - the image stream, downloading again after the first
+ *                    attempt was interrupted half way through
+ *
+ * The flash contents are checked against the image after each download,
+ * and the image stream is checked to reject a bad header on the first
+ * block, to leave no header in flash when interrupted, and to report
+ * truncated images, sectors that fail to verify and a resumed image whose
+ * flash has changed since it was journaled. The exit code is
+ * non-zero on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfu_image_stream.h"
+
+#define IMAGE_SIZE              (1024 * 1024)
+#define IMAGE_VERSION           2
+#define BASE_ADDR               0x100000
+#define JOURNAL_ADDR            0x400000
+#define FLASH_SIZE              (JOURNAL_ADDR + DFU_IMAGE_STREAM_SECTOR_SIZE)
+#define SECTOR_SIZE             DFU_IMAGE_STREAM_SECTOR_SIZE
+
+/* Flash timing model, in nanoseconds */
+#define SIM_CMD_NS              2000        /* command, address, dummy cycles and driver overhead */
+#define SIM_NS_PER_BYTE         33          /* quad SPI at 60 MHz */
+#define SIM_PAGE_SIZE           256
+#define SIM_PAGE_PROGRAM_NS     400000
+#define SIM_ERASE_4K_NS         45000000
+
+/* USB high speed control transfers, as issued by dfu-util through libusb */
+#define USB_REQUEST_NS          250000      /* host stack and bus turnaround per request */
+#define USB_NS_PER_BYTE         25
+
+#define NIBBLE_SWAP_INT(X) ((((X) & 0x0f0f0f0f) << 4) | (((X) & 0xf0f0f0f0) >> 4))
+
+typedef struct {
+    uint8_t mem[FLASH_SIZE];
+    uint64_t busy_ns;
+    uint32_t erases;
+    uint32_t stuck_addr;        /* a byte that always reads back 0, or 0 for none */
+    int errors;
+} sim_flash_t;
+
+static sim_flash_t flash;
+static uint8_t image[IMAGE_SIZE] __attribute__((aligned(4)));
+static dfu_image_stream_t stream;
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static void sim_flash_reset(sim_flash_t *f)
+{
+    memset(f->mem, 0xFF, sizeof(f->mem));
+    f->busy_ns = 0;
+    f->erases = 0;
+    f->stuck_addr = 0;
+    f->errors = 0;
+}
+
+size_t dfu_image_stream_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    memcpy(buf, &f->mem[addr], len);
+    if (f->stuck_addr >= addr && f->stuck_addr < addr + len) {
+        buf[f->stuck_addr - addr] = 0;
+    }
+    f->busy_ns += SIM_CMD_NS + (uint64_t) len * SIM_NS_PER_BYTE;
+
+    return len;
+}
+
+size_t dfu_image_stream_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    for (size_t i = 0; i < len; i++) {
+        f->mem[addr + i] &= buf[i];
+        if (f->mem[addr + i] != buf[i]) {
+            f->errors++;
+        }
+    }
+
+    for (size_t done = 0; done < len;) {
+        size_t n = SIM_PAGE_SIZE - ((addr + done) % SIM_PAGE_SIZE);
+        if (n > len - done) {
+            n = len - done;
+        }
+        f->busy_ns += SIM_CMD_NS + (uint64_t) n * SIM_NS_PER_BYTE + SIM_PAGE_PROGRAM_NS;
+        done += n;
+    }
+
+    return len;
+}
+
+void dfu_image_stream_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    memset(&f->mem[addr], 0xFF, len);
+    f->busy_ns += (len / SECTOR_SIZE) * (uint64_t) SIM_ERASE_4K_NS;
+    f->erases += len / SECTOR_SIZE;
+}
+
+/* Builds an upgrade image with a header the boot image manager accepts */
+static void image_build(uint8_t *img, uint32_t seed)
+{
+    uint32_t *w = (uint32_t *) img;
+    uint32_t crc = 0xFFFFFFFF;
+    const uint32_t zero = 0;
+
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        img[i] = (uint8_t) (seed >> 16);
+    }
+
+    w[0] = NIBBLE_SWAP_INT(0x0FF51DE);
+    w[4] = NIBBLE_SWAP_INT((uint32_t) IMAGE_SIZE);
+    w[5] = NIBBLE_SWAP_INT((uint32_t) IMAGE_VERSION);
+    for (int i = 3; i < 64; i++) {
+        const uint32_t v = NIBBLE_SWAP_INT(w[i]);
+        crc = dfu_image_stream_crc(crc, &v, 1);
+    }
+
+    /* The data word is XORed straight into the CRC, so this makes the final CRC all ones */
+    w[1] = NIBBLE_SWAP_INT(~dfu_image_stream_crc(crc, &zero, 1));
+}
+
+/*
+ * Download models. Elapsed time is in nanoseconds, on the host's clock.
+ */
+
+typedef struct {
+    const char *name;
+    uint32_t block;
+    uint64_t elapsed_ns;
+    uint32_t requests;
+} run_t;
+
+static uint64_t usb_request(run_t *r, size_t len)
+{
+    r->requests++;
+    return USB_REQUEST_NS + (uint64_t) len * USB_NS_PER_BYTE;
+}
+
+static uint64_t ms_ceil(uint64_t ns)
+{
+    return ((ns + 999999) / 1000000) * 1000000;
+}
+
+/* Read, erase and write the sector of each block, completing the block afterwards */
+static void run_rmw(run_t *r)
+{
+    static uint8_t sector[SECTOR_SIZE];
+
+    for (uint32_t off = 0; off < IMAGE_SIZE; off += r->block) {
+        const uint32_t addr = BASE_ADDR + off;
+        const uint32_t sector_addr = addr - (addr % SECTOR_SIZE);
+        const uint64_t t0 = flash.busy_ns;
+
+        r->elapsed_ns += usb_request(r, r->block);     /* DFU_DNLOAD */
+        r->elapsed_ns += usb_request(r, 6);            /* DFU_GETSTATUS, busy */
+
+        dfu_image_stream_flash_read(&flash, sector_addr, sector, SECTOR_SIZE);
+        memcpy(&sector[addr - sector_addr], &image[off], r->block);
+        dfu_image_stream_flash_erase(&flash, sector_addr, SECTOR_SIZE);
+        dfu_image_stream_flash_write(&flash, sector_addr, sector, SECTOR_SIZE);
+
+        /* The device stays busy past the 1 ms poll timeout it returns */
+        const uint64_t busy_ns = flash.busy_ns - t0;
+        r->elapsed_ns += (busy_ns > 1000000) ? busy_ns : 1000000;
+        r->elapsed_ns += usb_request(r, 6);            /* DFU_GETSTATUS, idle */
+    }
+
+    /* Manifestation */
+    r->elapsed_ns += usb_request(r, 0) + usb_request(r, 6);
+}
+
+/*
+ * The image stream. With overlap, each full sector is programmed by the
+ * flash side, starting when the sector is full or when the previous one
+ * is done, whichever is later. A block that needs the buffer of a sector
+ * still being programmed is completed only when that sector is done, and
+ * the host polls for it at the interval the device returns, which is the
+ * time the last sector took. Without overlap, the block that fills a
+ * sector is completed only once the sector is programmed.
+ *
+ * Returns the result of dfu_image_stream_finish(), or of the first write
+ * that failed. Stops after stop_at bytes if that is less than the image.
+ */
+static int run_stream(run_t *r, const uint8_t *img, int overlap, uint32_t stop_at)
+{
+    uint64_t free_at[DFU_IMAGE_STREAM_BUFFERS] = {0};
+    uint64_t flash_free_at = 0;
+    uint64_t sector_ns = SIM_ERASE_4K_NS;
+    int ret;
+
+    for (uint32_t off = 0; off < IMAGE_SIZE && off < stop_at; off += r->block) {
+        const uint32_t sector = off / SECTOR_SIZE;
+        const unsigned b = (sector - 1) % DFU_IMAGE_STREAM_BUFFERS;
+        const int starts_sector = sector > 0 && (off % SECTOR_SIZE) == 0;
+
+        r->elapsed_ns += usb_request(r, r->block);     /* DFU_DNLOAD */
+        r->elapsed_ns += usb_request(r, 6);            /* DFU_GETSTATUS, busy */
+
+        if (starts_sector && free_at[b] > r->elapsed_ns) {
+            /* Not ready, so the device returned the time of the last sector as its poll timeout */
+            do {
+                r->elapsed_ns += ms_ceil(sector_ns);
+                r->elapsed_ns += usb_request(r, 6);
+            } while (free_at[b] > r->elapsed_ns);
+        } else {
+            r->elapsed_ns += usb_request(r, 6);        /* DFU_GETSTATUS, idle */
+        }
+
+        ret = dfu_image_stream_write(&stream, off, &img[off], r->block);
+        if (ret != DFU_IMAGE_STREAM_OK) {
+            return ret;
+        }
+
+        if (dfu_image_stream_queued(&stream) > 0) {
+            const uint32_t full = (off + r->block) / SECTOR_SIZE - 1;
+            const uint64_t t0 = flash.busy_ns;
+
+            ret = dfu_image_stream_program(&stream);
+            if (ret < 0) {
+                return ret;
+            }
+            sector_ns = flash.busy_ns - t0;
+
+            if (overlap) {
+                const uint64_t start = (flash_free_at > r->elapsed_ns) ? flash_free_at : r->elapsed_ns;
+                flash_free_at = start + sector_ns;
+                free_at[(full - 1) % DFU_IMAGE_STREAM_BUFFERS] = flash_free_at;
+            } else {
+                r->elapsed_ns += ms_ceil(sector_ns) + usb_request(r, 6);
+            }
+        }
+    }
+
+    if (stop_at < IMAGE_SIZE) {
+        /* Interrupted: the flash side finishes the sectors it already has */
+        while (dfu_image_stream_program(&stream) > 0) {
+            ;
+        }
+        return DFU_IMAGE_STREAM_ERR_INCOMPLETE;
+    }
+
+    /* Manifestation waits for the flash side, then programs the header */
+    r->elapsed_ns += usb_request(r, 0) + usb_request(r, 6);
+    if (flash_free_at > r->elapsed_ns) {
+        r->elapsed_ns = flash_free_at;
+    }
+    const uint64_t t0 = flash.busy_ns;
+    ret = dfu_image_stream_finish(&stream);
+    r->elapsed_ns += ms_ceil(flash.busy_ns - t0) + usb_request(r, 6);
+
+    return ret;
+}
+
+static void report(run_t *r, int result, int uses_stream)
+{
+    dfu_image_stream_stats_t s;
+    char programmed[16] = "-";
+    char skipped[16] = "-";
+
+    if (uses_stream) {
+        dfu_image_stream_stats_get(&stream, &s);
+        snprintf(programmed, sizeof(programmed), "%u", s.programmed);
+        snprintf(skipped, sizeof(skipped), "%u", s.skipped);
+    }
+
+    check(result == DFU_IMAGE_STREAM_OK, "download completes");
+    check(memcmp(&flash.mem[BASE_ADDR], image, IMAGE_SIZE) == 0, "flash holds the image");
+    check(flash.errors == 0, "no programming of unerased flash");
+
+    printf("%-14s %6u %10.1f %8.3f %9u %8s %8s\n",
+           r->name, r->block,
+           r->elapsed_ns / 1e6,
+           ((double) IMAGE_SIZE * 1000.0) / (double) r->elapsed_ns,
+           r->requests, programmed, skipped);
+}
+
+static void stream_begin(void)
+{
+    dfu_image_stream_init(&stream, BASE_ADDR, JOURNAL_ADDR - BASE_ADDR, JOURNAL_ADDR, &flash);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t blocks[] = {512, 4096};
+    int ret;
+
+    (void) argc;
+    (void) argv;
+
+    image_build(image, 1);
+
+    printf("flash model: %u ns/cmd, %u ns/byte, %u us/page, %u ms erase 4K; usb %u us/request, %u ns/byte\n",
+           SIM_CMD_NS, SIM_NS_PER_BYTE, SIM_PAGE_PROGRAM_NS / 1000, SIM_ERASE_4K_NS / 1000000,
+           USB_REQUEST_NS / 1000, USB_NS_PER_BYTE);
+    printf("image: %u bytes, %d sector buffers\n\n", IMAGE_SIZE, DFU_IMAGE_STREAM_BUFFERS);
+    printf("%-14s %6s %10s %8s %9s %8s %8s\n", "download", "block", "ms", "MB/s", "requests", "written", "resumed");
+
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        run_t rmw = {.name = "rmw", .block = blocks[i]};
+        run_t serial = {.name = "stream serial", .block = blocks[i]};
+        run_t overlap = {.name = "stream", .block = blocks[i]};
+        run_t first = {.name = "interrupted", .block = blocks[i]};
+        run_t resume = {.name = "resume", .block = blocks[i]};
+
+        sim_flash_reset(&flash);
+        run_rmw(&rmw);
+        report(&rmw, DFU_IMAGE_STREAM_OK, 0);
+
+        sim_flash_reset(&flash);
+        stream_begin();
+        report(&serial, run_stream(&serial, image, 0, IMAGE_SIZE), 1);
+
+        sim_flash_reset(&flash);
+        stream_begin();
+        report(&overlap, run_stream(&overlap, image, 1, IMAGE_SIZE), 1);
+
+        sim_flash_reset(&flash);
+        stream_begin();
+        ret = run_stream(&first, image, 1, IMAGE_SIZE / 2);
+        check(ret == DFU_IMAGE_STREAM_ERR_INCOMPLETE, "interrupted download is incomplete");
+        check(flash.mem[BASE_ADDR] == 0xFF && memcmp(&flash.mem[BASE_ADDR], &flash.mem[BASE_ADDR + 1], 63) == 0,
+              "interrupted download leaves no header");
+        report(&resume, run_stream(&resume, image, 1, IMAGE_SIZE), 1);
+        check(resume.elapsed_ns < overlap.elapsed_ns, "resume is faster than a full download");
+    }
+
+    /* A download of something that is not an image fails on its first block */
+    {
+        static uint8_t bad[SECTOR_SIZE];
+        memcpy(bad, image, sizeof(bad));
+        bad[100] ^= 1;
+
+        sim_flash_reset(&flash);
+        stream_begin();
+        ret = dfu_image_stream_write(&stream, 0, bad, 512);
+        check(ret == DFU_IMAGE_STREAM_ERR_HEADER, "bad header rejected on the first block");
+        check(flash.erases == 0, "bad header erases nothing");
+    }
+
+    /* A truncated image is not completed */
+    {
+        sim_flash_reset(&flash);
+        stream_begin();
+        for (uint32_t off = 0; off < 64 * SECTOR_SIZE; off += SECTOR_SIZE) {
+            dfu_image_stream_write(&stream, off, &image[off], SECTOR_SIZE);
+            dfu_image_stream_program(&stream);
+        }
+        ret = dfu_image_stream_finish(&stream);
+        check(ret == DFU_IMAGE_STREAM_ERR_INCOMPLETE, "truncated image rejected");
+        check(flash.mem[BASE_ADDR] == 0xFF, "truncated image leaves no header");
+    }
+
+    /* A sector that does not read back fails the download */
+    {
+        run_t r = {.name = "stuck bit", .block = SECTOR_SIZE};
+
+        sim_flash_reset(&flash);
+        flash.stuck_addr = BASE_ADDR + 10 * SECTOR_SIZE;
+        while (image[flash.stuck_addr - BASE_ADDR] == 0) {
+            flash.stuck_addr++;
+        }
+        stream_begin();
+        ret = run_stream(&r, image, 1, IMAGE_SIZE);
+        check(ret == DFU_IMAGE_STREAM_ERR_VERIFY, "verify failure reported");
+        check(flash.mem[BASE_ADDR] == 0xFF, "failed image leaves no header");
+    }
+
+    /* A resumed download rejects a journaled sector that has since changed */
+    {
+        run_t r = {.name = "changed", .block = SECTOR_SIZE};
+        const uint32_t addr = BASE_ADDR + 10 * SECTOR_SIZE;
+
+        sim_flash_reset(&flash);
+        stream_begin();
+        run_stream(&r, image, 1, IMAGE_SIZE / 2);
+        check(flash.mem[addr] == image[addr - BASE_ADDR], "sector journaled before the interruption");
+        flash.mem[addr] ^= 1;
+        ret = run_stream(&r, image, 1, IMAGE_SIZE);
+        check(ret == DFU_IMAGE_STREAM_ERR_VERIFY, "changed sector rejected");
+        check(flash.mem[BASE_ADDR] == 0xFF, "changed image leaves no header");
+    }
+
+    if (failures) {
+        printf("\nFAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("\nAll checks passed\n");
+    return 0;
+}
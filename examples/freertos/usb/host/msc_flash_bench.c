@@ -0,0 +1,404 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Host benchmark for the msc_flash demo's block cache.
+ *
+ * The cache is linked against a simulated NOR flash that accounts time with
+ * a simple model of QSPI command overhead, transfer rate, page program and
+ * erase times. The MSC READ10/WRITE10 callback sequences a host would issue
+ * are replayed against three backends:
+ *
+ *   direct     - flash read per READ10, read/erase/program per sector per WRITE10
+ *   cache      - msc_flash_cache without read-ahead
+ *   cache+ra   - msc_flash_cache with read-ahead overlapping the USB transfer
+ *
+ * All data read back is checked against a reference image, and the flash
+ * contents are checked after the final flush. The exit code is non-zero on
+ * any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msc_flash_cache.h"
+
+#define DISK_SIZE               (1024 * 1024)
+#define DISK_BLOCKS             (DISK_SIZE / MSC_FLASH_BLOCK_SIZE)
+
+/* Flash timing model, in nanoseconds */
+#define SIM_CMD_NS              2000        /* command, address, dummy cycles and driver overhead */
+#define SIM_NS_PER_BYTE         33          /* quad SPI at 60 MHz */
+#define SIM_PAGE_SIZE           256
+#define SIM_PAGE_PROGRAM_NS     400000
+#define SIM_ERASE_4K_NS         45000000
+#define SIM_ERASE_32K_NS        120000000
+#define SIM_ERASE_64K_NS        150000000
+
+/* USB high speed bulk, roughly 40 MB/s of payload */
+#define USB_NS_PER_BYTE         25
+
+typedef struct {
+    uint8_t mem[DISK_SIZE];
+    uint64_t busy_ns;
+    uint32_t reads;
+    uint32_t programs;
+    uint32_t erases;
+    int errors;
+} sim_flash_t;
+
+static sim_flash_t flash;
+static uint8_t ref[DISK_SIZE];
+static msc_flash_cache_t cache;
+static int data_errors;
+
+static void sim_flash_reset(sim_flash_t *f)
+{
+    memset(f->mem, 0xFF, sizeof(f->mem));
+    f->busy_ns = 0;
+    f->reads = 0;
+    f->programs = 0;
+    f->erases = 0;
+    f->errors = 0;
+}
+
+size_t msc_flash_cache_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    memcpy(buf, &f->mem[addr], len);
+    f->busy_ns += SIM_CMD_NS + (uint64_t) len * SIM_NS_PER_BYTE;
+    f->reads++;
+
+    return len;
+}
+
+size_t msc_flash_cache_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    for (size_t i = 0; i < len; i++) {
+        f->mem[addr + i] &= buf[i];
+        if (f->mem[addr + i] != buf[i]) {
+            f->errors++;
+        }
+    }
+
+    /* Each page touched is a separate program command */
+    for (size_t done = 0; done < len;) {
+        size_t n = SIM_PAGE_SIZE - ((addr + done) % SIM_PAGE_SIZE);
+        if (n > len - done) {
+            n = len - done;
+        }
+        f->busy_ns += SIM_CMD_NS + (uint64_t) n * SIM_NS_PER_BYTE + SIM_PAGE_PROGRAM_NS;
+        f->programs++;
+        done += n;
+    }
+
+    return len;
+}
+
+void msc_flash_cache_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    sim_flash_t *f = app_data;
+
+    memset(&f->mem[addr], 0xFF, len);
+
+    /* Largest aligned erase that fits, as the QSPI flash driver does */
+    while (len > 0) {
+        size_t n;
+        if ((addr % 0x10000) == 0 && len >= 0x10000) {
+            n = 0x10000;
+            f->busy_ns += SIM_ERASE_64K_NS;
+        } else if ((addr % 0x8000) == 0 && len >= 0x8000) {
+            n = 0x8000;
+            f->busy_ns += SIM_ERASE_32K_NS;
+        } else {
+            n = 0x1000;
+            f->busy_ns += SIM_ERASE_4K_NS;
+        }
+        f->erases++;
+        addr += n;
+        len -= n;
+    }
+}
+
+/*
+ * Backends
+ */
+
+typedef struct {
+    const char *name;
+    int32_t (*read)(uint32_t lba, uint8_t *buf, uint32_t len);
+    int32_t (*write)(uint32_t lba, const uint8_t *buf, uint32_t len);
+    void (*sync)(void);
+    int readahead;
+} backend_t;
+
+static int32_t direct_read(uint32_t lba, uint8_t *buf, uint32_t len)
+{
+    return msc_flash_cache_flash_read(&flash, lba * MSC_FLASH_BLOCK_SIZE, buf, len);
+}
+
+static int32_t direct_write(uint32_t lba, const uint8_t *buf, uint32_t len)
+{
+    static uint8_t sector[MSC_FLASH_SECTOR_SIZE];
+    uint32_t addr = lba * MSC_FLASH_BLOCK_SIZE;
+    uint32_t done = 0;
+
+    while (done < len) {
+        const uint32_t sector_addr = (addr + done) - ((addr + done) % MSC_FLASH_SECTOR_SIZE);
+        uint32_t n = MSC_FLASH_SECTOR_SIZE - ((addr + done) - sector_addr);
+        if (n > len - done) {
+            n = len - done;
+        }
+        msc_flash_cache_flash_read(&flash, sector_addr, sector, MSC_FLASH_SECTOR_SIZE);
+        memcpy(&sector[(addr + done) - sector_addr], buf + done, n);
+        msc_flash_cache_flash_erase(&flash, sector_addr, MSC_FLASH_SECTOR_SIZE);
+        msc_flash_cache_flash_write(&flash, sector_addr, sector, MSC_FLASH_SECTOR_SIZE);
+        done += n;
+    }
+
+    return len;
+}
+
+static void direct_sync(void)
+{
+}
+
+static int32_t cache_read(uint32_t lba, uint8_t *buf, uint32_t len)
+{
+    return msc_flash_cache_read(&cache, lba, 0, buf, len);
+}
+
+static int32_t cache_write(uint32_t lba, const uint8_t *buf, uint32_t len)
+{
+    return msc_flash_cache_write(&cache, lba, 0, buf, len);
+}
+
+static void cache_sync(void)
+{
+    msc_flash_cache_flush(&cache);
+}
+
+static const backend_t backends[] = {
+    {"direct",   direct_read, direct_write, direct_sync, 0},
+    {"cache",    cache_read,  cache_write,  cache_sync,  0},
+    {"cache+ra", cache_read,  cache_write,  cache_sync,  1},
+};
+
+/*
+ * Replay helpers. Elapsed time is the flash time on the critical path plus
+ * the USB transfer time. Read-ahead runs while the previous READ10 data is
+ * on the wire, so only the part of it longer than the transfer is exposed.
+ */
+
+typedef struct {
+    const backend_t *be;
+    uint64_t elapsed_ns;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+} run_t;
+
+static void do_read(run_t *r, uint32_t lba, uint32_t len)
+{
+    static uint8_t buf[64 * 1024];
+    uint64_t t0 = flash.busy_ns;
+
+    if (r->be->read(lba, buf, len) != (int32_t) len) {
+        data_errors++;
+    }
+    if (memcmp(buf, &ref[lba * MSC_FLASH_BLOCK_SIZE], len) != 0) {
+        data_errors++;
+    }
+
+    const uint64_t demand_ns = flash.busy_ns - t0;
+    const uint64_t usb_ns = (uint64_t) len * USB_NS_PER_BYTE;
+    uint64_t overlap_ns = 0;
+
+    if (r->be->readahead && msc_flash_cache_prefetch_pending(&cache)) {
+        t0 = flash.busy_ns;
+        msc_flash_cache_prefetch(&cache);
+        overlap_ns = flash.busy_ns - t0;
+    }
+
+    r->elapsed_ns += demand_ns + (overlap_ns > usb_ns ? overlap_ns : usb_ns);
+    r->bytes_read += len;
+}
+
+static void do_write(run_t *r, uint32_t lba, uint32_t len, uint32_t seed)
+{
+    static uint8_t buf[64 * 1024];
+    const uint64_t t0 = flash.busy_ns;
+
+    for (uint32_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (uint8_t) (seed >> 16);
+    }
+    memcpy(&ref[lba * MSC_FLASH_BLOCK_SIZE], buf, len);
+
+    if (r->be->write(lba, buf, len) != (int32_t) len) {
+        data_errors++;
+    }
+
+    r->elapsed_ns += (flash.busy_ns - t0) + (uint64_t) len * USB_NS_PER_BYTE;
+    r->bytes_written += len;
+}
+
+static void do_sync(run_t *r)
+{
+    const uint64_t t0 = flash.busy_ns;
+    r->be->sync();
+    r->elapsed_ns += flash.busy_ns - t0;
+}
+
+/*
+ * Workloads
+ */
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+static void prefill(const backend_t *be)
+{
+    run_t r = {.be = be};
+
+    for (uint32_t lba = 0; lba < DISK_BLOCKS; lba += 16) {
+        do_write(&r, lba, 16 * MSC_FLASH_BLOCK_SIZE, lba);
+    }
+    do_sync(&r);
+}
+
+static void wl_seq_read(run_t *r, uint32_t chunk)
+{
+    for (uint32_t lba = 0; lba < DISK_BLOCKS; lba += chunk / MSC_FLASH_BLOCK_SIZE) {
+        do_read(r, lba, chunk);
+    }
+}
+
+static void wl_seq_write(run_t *r, uint32_t chunk)
+{
+    for (uint32_t lba = 0; lba < DISK_BLOCKS; lba += chunk / MSC_FLASH_BLOCK_SIZE) {
+        do_write(r, lba, chunk, lba + 7);
+    }
+    do_sync(r);
+}
+
+/* Files of 16 KiB copied onto a FAT volume: data, then FAT and directory updates */
+static void wl_file_copy(run_t *r, uint32_t chunk)
+{
+    const uint32_t data_start = 64;
+    const uint32_t file_blocks = 16 * 1024 / MSC_FLASH_BLOCK_SIZE;
+
+    for (uint32_t f = 0; f < 32; f++) {
+        const uint32_t first = data_start + f * file_blocks;
+        for (uint32_t lba = first; lba < first + file_blocks; lba += chunk / MSC_FLASH_BLOCK_SIZE) {
+            do_write(r, lba, chunk, lba);
+        }
+        do_write(r, 1 + (f / 16), MSC_FLASH_BLOCK_SIZE, f);
+        do_write(r, 32 + (f / 16), MSC_FLASH_BLOCK_SIZE, f + 100);
+    }
+    do_sync(r);
+}
+
+/* Random 4 KiB reads, 80% of them to a small hot set */
+static void wl_hot_read(run_t *r, uint32_t chunk)
+{
+    const uint32_t chunks = DISK_SIZE / chunk;
+    const uint32_t hot = 6;
+
+    rng_state = 1;
+    for (int i = 0; i < 2048; i++) {
+        uint32_t c = (rng() % 10) < 8 ? (rng() % hot) : (rng() % chunks);
+        do_read(r, c * (chunk / MSC_FLASH_BLOCK_SIZE), chunk);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)(run_t *r, uint32_t chunk);
+    int needs_prefill;
+} workload_t;
+
+static const workload_t workloads[] = {
+    {"seq read",   wl_seq_read,  1},
+    {"hot read",   wl_hot_read,  1},
+    {"seq write",  wl_seq_write, 0},
+    {"file copy",  wl_file_copy, 0},
+};
+
+static double mbps(uint64_t bytes, uint64_t ns)
+{
+    return ns ? ((double) bytes * 1000.0) / (double) ns : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t chunks[] = {512, 4096};
+
+    (void) argc;
+    (void) argv;
+
+    printf("flash model: %u ns/cmd, %u ns/byte, %u us/page, %u/%u/%u ms erase 4K/32K/64K; usb %u ns/byte\n",
+           SIM_CMD_NS, SIM_NS_PER_BYTE, SIM_PAGE_PROGRAM_NS / 1000,
+           SIM_ERASE_4K_NS / 1000000, SIM_ERASE_32K_NS / 1000000, SIM_ERASE_64K_NS / 1000000,
+           USB_NS_PER_BYTE);
+    printf("cache: %d lines of %d bytes, read-ahead %d sectors\n\n",
+           MSC_FLASH_CACHE_LINES, MSC_FLASH_SECTOR_SIZE, MSC_FLASH_READAHEAD_SECTORS);
+    printf("%-10s %-6s %-9s %10s %8s %8s %8s\n", "workload", "chunk", "backend", "MB/s", "erases", "reads", "hit %");
+
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+                const backend_t *be = &backends[b];
+                run_t r = {.be = be};
+
+                sim_flash_reset(&flash);
+                memset(ref, 0xFF, sizeof(ref));
+                msc_flash_cache_init(&cache, 0, DISK_BLOCKS, &flash);
+
+                if (workloads[w].needs_prefill) {
+                    prefill(be);
+                    msc_flash_cache_invalidate(&cache);
+                    msc_flash_cache_init(&cache, 0, DISK_BLOCKS, &flash);
+                }
+                const uint32_t erases0 = flash.erases;
+                const uint32_t reads0 = flash.reads;
+
+                workloads[w].fn(&r, chunks[c]);
+
+                if (memcmp(flash.mem, ref, DISK_SIZE) != 0) {
+                    data_errors++;
+                }
+                data_errors += flash.errors;
+
+                msc_flash_cache_stats_t s;
+                msc_flash_cache_stats_get(&cache, &s);
+
+                char hit[16] = "-";
+                if (be->read == cache_read && s.read_blocks) {
+                    snprintf(hit, sizeof(hit), "%.1f", 100.0 * s.read_hits / s.read_blocks);
+                }
+
+                printf("%-10s %-6u %-9s %10.3f %8u %8u %8s\n",
+                       workloads[w].name, chunks[c], be->name,
+                       mbps(r.bytes_read + r.bytes_written, r.elapsed_ns),
+                       flash.erases - erases0, flash.reads - reads0, hit);
+            }
+        }
+    }
+
+    if (data_errors) {
+        printf("\nFAILED: %d data errors\n", data_errors);
+        return 1;
+    }
+
+    printf("\nAll data verified\n");
+    return 0;
+}
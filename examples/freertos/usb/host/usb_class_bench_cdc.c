@@ -0,0 +1,326 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * CDC class throughput benchmark.
+ *
+ * Runs the cdc_dual_ports descriptors and the TinyUSB CDC class driver on
+ * the virtual device controller. The poll function stands in for the demo's
+ * cdc_task() and either sinks, sources or echoes the data on port 0, or
+ * runs several cdc_stream producers into it. The stream producers write
+ * faster than the bus drains, so the stream test also exercises the drop
+ * and back-pressure paths, and the host checks that every record arrives
+ * whole and in order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tusb.h"
+
+#include "cdc_stream.h"
+#include "usb_vdcd.h"
+
+#define BENCH_BYTES         (16 * 1024 * 1024)
+
+/* Empty IN reads, NAKs or zero length packets, before a test gives up */
+#define IDLE_MAX            2
+
+/* Interface numbers from the cdc_dual_ports descriptors */
+#define ITF_NUM_CDC_0       0
+#define ITF_NUM_CDC_0_DATA  1
+#define ITF_NUM_CDC_1       2
+
+enum {
+    MODE_IDLE,
+    MODE_SINK,
+    MODE_SOURCE,
+    MODE_ECHO,
+    MODE_STREAM,
+};
+
+#define STREAM_PRODUCERS        4
+#define STREAM_RING_BYTES       2048
+#define STREAM_RECORD_BYTES     32
+#define STREAM_RECORDS_PER_POLL 4
+
+static cdc_stream_t stream;
+static cdc_stream_producer_t producers[STREAM_PRODUCERS];
+static uint8_t rings[STREAM_PRODUCERS][STREAM_RING_BYTES];
+static uint32_t producer_seq[STREAM_PRODUCERS];
+
+/* Record: producer id, 32-bit sequence number, then id ^ seq as padding */
+static void stream_record(uint8_t *rec, uint8_t id, uint32_t seq)
+{
+    rec[0] = id;
+    memcpy(&rec[1], &seq, sizeof(seq));
+    memset(&rec[5], id ^ (uint8_t) seq, STREAM_RECORD_BYTES - 5);
+}
+
+static int mode;
+static uint64_t source_left;
+static uint64_t sink_bytes;
+static uint8_t pattern[CFG_TUD_CDC_TX_BUFSIZE];
+static const usb_vdcd_ep_t *ep_out;
+static const usb_vdcd_ep_t *ep_in;
+
+static void cdc_poll(void)
+{
+    uint8_t buf[CFG_TUD_CDC_RX_BUFSIZE];
+    uint32_t n;
+
+    switch (mode) {
+    case MODE_SINK:
+        while ((n = tud_cdc_n_read(0, buf, sizeof(buf))) > 0) {
+            sink_bytes += n;
+        }
+        break;
+
+    case MODE_SOURCE:
+        n = tud_cdc_n_write_available(0);
+        if (n > source_left) {
+            n = (uint32_t) source_left;
+        }
+        if (n > 0) {
+            source_left -= tud_cdc_n_write(0, pattern, n);
+        }
+        tud_cdc_n_write_flush(0);
+        break;
+
+    case MODE_ECHO:
+        n = tud_cdc_n_available(0);
+        if (n > tud_cdc_n_write_available(0)) {
+            n = tud_cdc_n_write_available(0);
+        }
+        if (n > 0) {
+            n = tud_cdc_n_read(0, buf, n);
+            tud_cdc_n_write(0, buf, n);
+            tud_cdc_n_write_flush(0);
+        }
+        break;
+
+    case MODE_STREAM:
+        for (int i = 0; i < STREAM_PRODUCERS; i++) {
+            uint8_t rec[STREAM_RECORD_BYTES];
+
+            for (int j = 0; j < STREAM_RECORDS_PER_POLL; j++) {
+                stream_record(rec, i, producer_seq[i]);
+                if (cdc_stream_write(&producers[i], rec, sizeof(rec)) == 0) {
+                    break;
+                }
+                producer_seq[i]++;
+            }
+        }
+        cdc_stream_service(&stream, 1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static int bench_out(size_t chunk)
+{
+    uint8_t *buf = malloc(chunk);
+    usb_vdcd_stats_t stats;
+    char name[32];
+    uint64_t sent = 0;
+
+    memset(buf, 0x5A, chunk);
+    mode = MODE_SINK;
+    sink_bytes = 0;
+
+    usb_vdcd_stats_reset();
+    while (sent < BENCH_BYTES) {
+        const size_t n = usb_vdcd_bulk_out(ep_out, buf, chunk);
+        if (n == 0) {
+            break;
+        }
+        sent += n;
+    }
+    usb_vdcd_pump();
+    usb_vdcd_stats_get(&stats);
+
+    snprintf(name, sizeof(name), "cdc out %u B", (unsigned) chunk);
+    usb_vdcd_report(name, sink_bytes, &stats);
+
+    mode = MODE_IDLE;
+    free(buf);
+    return sink_bytes == BENCH_BYTES ? 0 : 1;
+}
+
+static int bench_in(void)
+{
+    uint8_t buf[512];
+    usb_vdcd_stats_t stats;
+    uint64_t got = 0;
+    int idle = 0;
+
+    mode = MODE_SOURCE;
+    source_left = BENCH_BYTES;
+
+    usb_vdcd_stats_reset();
+    usb_vdcd_pump();
+    while (got < BENCH_BYTES) {
+        const size_t n = usb_vdcd_bulk_in(ep_in, buf, sizeof(buf));
+        if (n == 0 && ++idle > IDLE_MAX) {
+            break;
+        }
+        got += n;
+    }
+    usb_vdcd_stats_get(&stats);
+
+    usb_vdcd_report("cdc in", got, &stats);
+
+    mode = MODE_IDLE;
+    return got == BENCH_BYTES ? 0 : 1;
+}
+
+static int bench_echo(size_t chunk)
+{
+    const uint32_t count = BENCH_BYTES / 16 / chunk;
+    uint8_t *tx = malloc(chunk);
+    uint8_t *rx = malloc(chunk);
+    usb_vdcd_stats_t stats;
+    char name[32];
+    int errors = 0;
+
+    mode = MODE_ECHO;
+
+    usb_vdcd_stats_reset();
+    for (uint32_t i = 0; i < count; i++) {
+        size_t got = 0;
+        int idle = 0;
+
+        memset(tx, i, chunk);
+        usb_vdcd_bulk_out(ep_out, tx, chunk);
+        while (got < chunk) {
+            const size_t n = usb_vdcd_bulk_in(ep_in, rx + got, chunk - got);
+            if (n == 0 && ++idle > IDLE_MAX) {
+                break;
+            }
+            got += n;
+        }
+        if (got != chunk || memcmp(tx, rx, chunk) != 0) {
+            errors++;
+        }
+    }
+    usb_vdcd_stats_get(&stats);
+
+    snprintf(name, sizeof(name), "cdc echo %u B", (unsigned) chunk);
+    usb_vdcd_report(name, (uint64_t) count * chunk * 2, &stats);
+
+    mode = MODE_IDLE;
+    free(tx);
+    free(rx);
+    return errors;
+}
+
+static int bench_stream(void)
+{
+    uint8_t buf[512 + STREAM_RECORD_BYTES];
+    uint32_t expect_seq[STREAM_PRODUCERS] = {0};
+    cdc_stream_stats_t stream_stats;
+    usb_vdcd_stats_t stats;
+    uint32_t dropped = 0;
+    uint64_t got = 0;
+    size_t held = 0;
+    int errors = 0;
+    int idle = 0;
+
+    cdc_stream_init(&stream, 0, NULL, NULL);
+    for (int i = 0; i < STREAM_PRODUCERS; i++) {
+        cdc_stream_producer_add(&stream, &producers[i], rings[i], sizeof(rings[i]));
+    }
+    mode = MODE_STREAM;
+
+    usb_vdcd_stats_reset();
+    usb_vdcd_pump();
+    while (got < BENCH_BYTES) {
+        const size_t n = usb_vdcd_bulk_in(ep_in, buf + held, 512);
+        size_t i;
+
+        if (n == 0 && ++idle > IDLE_MAX) {
+            break;
+        }
+        got += n;
+        held += n;
+
+        /* Every record must arrive whole, in order within its producer */
+        for (i = 0; i + STREAM_RECORD_BYTES <= held; i += STREAM_RECORD_BYTES) {
+            uint8_t rec[STREAM_RECORD_BYTES];
+            const uint8_t id = buf[i];
+            uint32_t seq;
+
+            memcpy(&seq, &buf[i + 1], sizeof(seq));
+            if (id >= STREAM_PRODUCERS) {
+                errors++;
+                break;
+            }
+            stream_record(rec, id, seq);
+            if (memcmp(rec, &buf[i], STREAM_RECORD_BYTES) != 0 || seq != expect_seq[id]) {
+                errors++;
+            }
+            expect_seq[id] = seq + 1;
+        }
+        memmove(buf, buf + i, held - i);
+        held -= i;
+    }
+    usb_vdcd_stats_get(&stats);
+    mode = MODE_IDLE;
+
+    cdc_stream_stats_get(&stream, &stream_stats);
+    for (int i = 0; i < STREAM_PRODUCERS; i++) {
+        cdc_stream_producer_stats_t ps;
+        cdc_stream_producer_stats_get(&producers[i], &ps);
+        dropped += ps.dropped_records;
+    }
+
+    usb_vdcd_report("cdc stream x4", got, &stats);
+    printf("%24s %u records dropped, %u back-pressure, %u tud_cdc_n_write calls\n",
+           "", dropped, stream_stats.back_pressure, stream_stats.writes);
+
+    return errors + (got < BENCH_BYTES);
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = i;
+    }
+
+    usb_vdcd_poll_set(cdc_poll);
+    if (usb_vdcd_init(1) != 0) {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+
+    ep_out = usb_vdcd_find_ep(ITF_NUM_CDC_0_DATA, 0, 0x00, TUSB_XFER_BULK);
+    ep_in = usb_vdcd_find_ep(ITF_NUM_CDC_0_DATA, 0, 0x80, TUSB_XFER_BULK);
+    if (ep_out == NULL || ep_in == NULL) {
+        printf("CDC endpoints not found\n");
+        return 1;
+    }
+
+    /* Raise DTR and RTS so the class driver treats the port as open */
+    usb_vdcd_control(0x21, CDC_REQUEST_SET_CONTROL_LINE_STATE, 0x0003, ITF_NUM_CDC_0, NULL, 0);
+    usb_vdcd_control(0x21, CDC_REQUEST_SET_CONTROL_LINE_STATE, 0x0003, ITF_NUM_CDC_1, NULL, 0);
+
+    usb_vdcd_report_header();
+    errors += bench_out(64);
+    errors += bench_out(4096);
+    errors += bench_in();
+    errors += bench_echo(64);
+    errors += bench_echo(512);
+    errors += bench_stream();
+
+    if (errors) {
+        printf("%d tests failed\n", errors);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * MSC class throughput benchmark.
+ *
+ * Runs the msc_dual_lun descriptors and the TinyUSB MSC class driver on the
+ * virtual device controller, backed by a RAM disk, and times bulk-only
+ * transport READ10 and WRITE10 commands of several sizes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tusb.h"
+
+#include "usb_vdcd.h"
+
+#define DISK_BLOCK_SIZE     512
+#define DISK_BLOCK_COUNT    2048
+#define BENCH_BYTES         (32 * 1024 * 1024)
+
+#define CBW_SIGNATURE       0x43425355
+#define CSW_SIGNATURE       0x53425355
+#define CBW_LEN             31
+#define CSW_LEN             13
+
+static uint8_t disk[DISK_BLOCK_COUNT][DISK_BLOCK_SIZE];
+static const usb_vdcd_ep_t *ep_out;
+static const usb_vdcd_ep_t *ep_in;
+static uint32_t tag;
+
+/*
+ * MSC callbacks.
+ */
+
+uint8_t tud_msc_get_maxlun_cb(void)
+{
+    return 1;
+}
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+    (void) lun;
+
+    memcpy(vendor_id, "XMOS    ", 8);
+    memcpy(product_id, "Bench RAM disk  ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+    (void) lun;
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
+{
+    (void) lun;
+
+    *block_count = DISK_BLOCK_COUNT;
+    *block_size = DISK_BLOCK_SIZE;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+    (void) lun;
+
+    memcpy(buffer, &disk[lba][offset], bufsize);
+    return (int32_t) bufsize;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    (void) lun;
+
+    memcpy(&disk[lba][offset], buffer, bufsize);
+    return (int32_t) bufsize;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+{
+    (void) scsi_cmd;
+    (void) buffer;
+    (void) bufsize;
+
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    return -1;
+}
+
+/*
+ * Host side bulk-only transport.
+ */
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Runs one READ10 or WRITE10 command. Returns 0 on success. */
+static int rw10(int write, uint32_t lba, void *buf, uint16_t blocks)
+{
+    const uint32_t len = (uint32_t) blocks * DISK_BLOCK_SIZE;
+    uint8_t cbw[CBW_LEN] = {0};
+    uint8_t csw[CSW_LEN];
+    size_t n;
+
+    tag++;
+    put_le32(&cbw[0], CBW_SIGNATURE);
+    put_le32(&cbw[4], tag);
+    put_le32(&cbw[8], len);
+    cbw[12] = write ? 0x00 : 0x80;
+    cbw[13] = 0;
+    cbw[14] = 10;
+    cbw[15] = write ? SCSI_CMD_WRITE_10 : SCSI_CMD_READ_10;
+    put_be32(&cbw[17], lba);
+    cbw[22] = blocks >> 8;
+    cbw[23] = blocks & 0xFF;
+
+    if (usb_vdcd_bulk_out(ep_out, cbw, sizeof(cbw)) != sizeof(cbw)) {
+        return -1;
+    }
+
+    if (write) {
+        n = usb_vdcd_bulk_out(ep_out, buf, len);
+    } else {
+        n = usb_vdcd_bulk_in(ep_in, buf, len);
+    }
+    if (n != len) {
+        return -1;
+    }
+
+    if (usb_vdcd_bulk_in(ep_in, csw, sizeof(csw)) != sizeof(csw) ||
+        get_le32(&csw[0]) != CSW_SIGNATURE || get_le32(&csw[4]) != tag ||
+        get_le32(&csw[8]) != 0 || csw[12] != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int run(int write, size_t xfer_size)
+{
+    const uint16_t blocks = xfer_size / DISK_BLOCK_SIZE;
+    const uint32_t count = BENCH_BYTES / xfer_size;
+    uint8_t *buf = malloc(xfer_size);
+    usb_vdcd_stats_t stats;
+    char name[32];
+    uint32_t lba = 0;
+    int errors = 0;
+
+    for (size_t i = 0; i < xfer_size; i++) {
+        buf[i] = rand();
+    }
+
+    usb_vdcd_stats_reset();
+    for (uint32_t i = 0; i < count; i++) {
+        if (rw10(write, lba, buf, blocks) != 0) {
+            errors++;
+        } else if (memcmp(buf, disk[lba], xfer_size) != 0) {
+            errors++;
+        }
+        lba += blocks;
+        if (lba + blocks > DISK_BLOCK_COUNT) {
+            lba = 0;
+        }
+    }
+    usb_vdcd_stats_get(&stats);
+
+    snprintf(name, sizeof(name), "msc %s %u KiB", write ? "write10" : "read10", (unsigned) (xfer_size / 1024));
+    usb_vdcd_report(name, (uint64_t) count * xfer_size, &stats);
+
+    free(buf);
+    return errors;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = {4096, 16384, 65536};
+    int errors = 0;
+
+    if (usb_vdcd_init(1) != 0) {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+
+    ep_out = usb_vdcd_find_ep(-1, 0, 0x00, TUSB_XFER_BULK);
+    ep_in = usb_vdcd_find_ep(-1, 0, 0x80, TUSB_XFER_BULK);
+    if (ep_out == NULL || ep_in == NULL) {
+        printf("MSC endpoints not found\n");
+        return 1;
+    }
+
+    usb_vdcd_report_header();
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        errors += run(1, sizes[i]);
+        errors += run(0, sizes[i]);
+    }
+
+    if (errors) {
+        printf("%d transfers failed\n", errors);
+        return 1;
+    }
+
+    return 0;
+}
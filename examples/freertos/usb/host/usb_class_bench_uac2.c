@@ -0,0 +1,193 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * UAC2 class throughput benchmark.
+ *
+ * Runs the uac2_headset descriptors and the TinyUSB audio class driver on
+ * the virtual device controller at high speed and 96 kHz. Each microframe
+ * the host sends a speaker packet and reads a microphone packet, and once
+ * per frame it signals SOF and reads the feedback endpoint. The callbacks
+ * move the audio with tud_audio_read() and tud_audio_write(), as the demo's
+ * do, so the figures cover the class driver's FIFO copies.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+#include "usb_vdcd.h"
+
+#define SAMPLE_RATE         96000
+#define MICROFRAMES         (8 * 8000)
+
+static uint32_t spk_rx_bytes;
+static uint32_t mic_packet_bytes;
+static uint8_t spk_buf[CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ];
+static uint8_t mic_buf[CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ];
+
+/*
+ * Audio class callbacks.
+ */
+
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void) rhport;
+    (void) p_request;
+    return false;
+}
+
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf)
+{
+    audio_control_request_t const *request = (audio_control_request_t const *) p_request;
+
+    (void) rhport;
+    (void) buf;
+
+    return request->bEntityID == UAC2_ENTITY_CLOCK &&
+           request->bControlSelector == AUDIO_CS_CTRL_SAM_FREQ &&
+           request->bRequest == AUDIO_CS_REQ_CUR;
+}
+
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void) rhport;
+    (void) p_request;
+    return true;
+}
+
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    const uint8_t itf = tu_u16_low(tu_le16toh(p_request->wIndex));
+
+    (void) rhport;
+
+    if (itf == ITF_NUM_AUDIO_STREAMING_SPK) {
+        /* Nominal rate in 16.16 samples per microframe */
+        tud_audio_fb_set((SAMPLE_RATE / 8000) << 16);
+    }
+
+    return true;
+}
+
+bool tud_audio_rx_done_pre_read_cb(uint8_t rhport, uint16_t n_bytes_received, uint8_t func_id, uint8_t ep_out, uint8_t cur_alt_setting)
+{
+    (void) rhport;
+    (void) func_id;
+    (void) ep_out;
+    (void) cur_alt_setting;
+
+    spk_rx_bytes += tud_audio_read(spk_buf, n_bytes_received);
+    return true;
+}
+
+bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting)
+{
+    (void) rhport;
+    (void) itf;
+    (void) ep_in;
+    (void) cur_alt_setting;
+
+    tud_audio_write(mic_buf, (uint16_t) mic_packet_bytes);
+    return true;
+}
+
+void tud_audio_fb_done_cb(uint8_t rhport)
+{
+    (void) rhport;
+
+    tud_audio_fb_set((SAMPLE_RATE / 8000) << 16);
+}
+
+/*
+ * Host side.
+ */
+
+static int run(uint8_t alt, unsigned bytes_per_sample)
+{
+    const size_t spk_len = (SAMPLE_RATE / 8000) * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX * bytes_per_sample;
+    const usb_vdcd_ep_t *ep_spk;
+    const usb_vdcd_ep_t *ep_fb;
+    const usb_vdcd_ep_t *ep_mic;
+    uint8_t pkt[1024];
+    uint64_t mic_bytes = 0;
+    usb_vdcd_stats_t stats;
+    char name[32];
+    int errors = 0;
+
+    ep_spk = usb_vdcd_find_ep(ITF_NUM_AUDIO_STREAMING_SPK, alt, 0x00, TUSB_XFER_ISOCHRONOUS);
+    ep_fb = usb_vdcd_find_ep(ITF_NUM_AUDIO_STREAMING_SPK, alt, 0x80, TUSB_XFER_ISOCHRONOUS);
+    ep_mic = usb_vdcd_find_ep(ITF_NUM_AUDIO_STREAMING_MIC, alt, 0x80, TUSB_XFER_ISOCHRONOUS);
+    if (ep_spk == NULL || ep_fb == NULL || ep_mic == NULL) {
+        printf("Audio endpoints not found for alternate setting %u\n", alt);
+        return 1;
+    }
+
+    mic_packet_bytes = (SAMPLE_RATE / 8000) * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX * bytes_per_sample;
+    spk_rx_bytes = 0;
+    memset(pkt, 0x33, sizeof(pkt));
+
+    if (usb_vdcd_set_interface(ITF_NUM_AUDIO_STREAMING_SPK, alt) != 0 ||
+        usb_vdcd_set_interface(ITF_NUM_AUDIO_STREAMING_MIC, alt) != 0) {
+        printf("SET_INTERFACE failed\n");
+        return 1;
+    }
+
+    usb_vdcd_stats_reset();
+    for (int i = 0; i < MICROFRAMES; i++) {
+        int n;
+
+        if ((i & 7) == 0) {
+            usb_vdcd_sof();
+            usb_vdcd_iso_in(ep_fb, pkt);
+        }
+        usb_vdcd_iso_out(ep_spk, pkt, spk_len);
+        if ((n = usb_vdcd_iso_in(ep_mic, pkt)) > 0) {
+            mic_bytes += n;
+        }
+    }
+    usb_vdcd_stats_get(&stats);
+
+    if (spk_rx_bytes != (uint64_t) MICROFRAMES * spk_len) {
+        errors++;
+    }
+
+    snprintf(name, sizeof(name), "uac2 alt %u %u B/sample", alt, bytes_per_sample);
+    usb_vdcd_report(name, spk_rx_bytes + mic_bytes, &stats);
+
+    usb_vdcd_set_interface(ITF_NUM_AUDIO_STREAMING_SPK, 0);
+    usb_vdcd_set_interface(ITF_NUM_AUDIO_STREAMING_MIC, 0);
+
+    return errors;
+}
+
+int main(void)
+{
+    const uint32_t rate = SAMPLE_RATE;
+    int errors = 0;
+
+    if (usb_vdcd_init(1) != 0) {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+
+    if (usb_vdcd_control(0x21, AUDIO_CS_REQ_CUR, AUDIO_CS_CTRL_SAM_FREQ << 8,
+                         (UAC2_ENTITY_CLOCK << 8) | ITF_NUM_AUDIO_CONTROL,
+                         (void *) &rate, sizeof(rate)) < 0) {
+        printf("Sample rate request failed\n");
+        return 1;
+    }
+
+    usb_vdcd_report_header();
+    errors += run(1, CFG_TUD_AUDIO_FUNC_1_FORMAT_1_N_BYTES_PER_SAMPLE_RX);
+    errors += run(2, CFG_TUD_AUDIO_FUNC_1_FORMAT_2_N_BYTES_PER_SAMPLE_RX);
+
+    if (errors) {
+        printf("%d tests failed\n", errors);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * UVC class throughput benchmark.
+ *
+ * Runs the video_capture descriptors, frame pool and the TinyUSB video class
+ * driver on the virtual device controller at full speed, as the demo is
+ * built. The host negotiates the stream with probe and commit, selects the
+ * isochronous alternate setting and reads one packet per frame. The poll
+ * function stands in for the demo's video_task() and fills and submits a
+ * frame whenever the pool has one free, so the stream runs at the rate the
+ * bus allows. The class driver sends whatever size it is given, so frame
+ * sizes other than the one in the descriptors are used to measure the
+ * sustained frame rate at other resolutions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "uvc_frame_pool.h"
+
+#include "usb_vdcd.h"
+
+#define POOL_FRAMES         2
+#define FRAME_BYTES_MAX     (320 * 240 * 2)
+#define BENCH_FRAMES        50
+
+static uint8_t frame_storage[POOL_FRAMES][FRAME_BYTES_MAX] __attribute__((aligned(4)));
+static uvc_frame_pool_t frame_pool;
+static size_t frame_bytes;
+static unsigned frame_num;
+
+/*
+ * Video class callbacks.
+ */
+
+static void video_poll(void)
+{
+    uvc_frame_t *frame;
+
+    if (!tud_video_n_streaming(0, 0) || frame_bytes == 0) {
+        return;
+    }
+
+    if ((frame = uvc_frame_pool_acquire(&frame_pool)) != NULL) {
+        memset(frame->buf, frame_num++, frame_bytes);
+        frame->size = frame_bytes;
+        uvc_frame_pool_submit(&frame_pool, frame);
+    }
+}
+
+void tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
+{
+    (void) ctl_idx;
+    (void) stm_idx;
+
+    uvc_frame_pool_xfer_complete(&frame_pool);
+}
+
+int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
+                        video_probe_and_commit_control_t const *parameters)
+{
+    (void) ctl_idx;
+    (void) stm_idx;
+    (void) parameters;
+
+    uvc_frame_pool_flush(&frame_pool);
+    return VIDEO_ERROR_NONE;
+}
+
+/*
+ * Host side.
+ */
+
+static int start_stream(void)
+{
+    video_probe_and_commit_control_t probe;
+    const uint16_t len = sizeof(probe);
+
+    if (usb_vdcd_control(0xA1, VIDEO_REQUEST_GET_CUR, VIDEO_VS_CTL_PROBE << 8,
+                         ITF_NUM_VIDEO_STREAMING, &probe, len) != len ||
+        usb_vdcd_control(0x21, VIDEO_REQUEST_SET_CUR, VIDEO_VS_CTL_PROBE << 8,
+                         ITF_NUM_VIDEO_STREAMING, &probe, len) != len ||
+        usb_vdcd_control(0x21, VIDEO_REQUEST_SET_CUR, VIDEO_VS_CTL_COMMIT << 8,
+                         ITF_NUM_VIDEO_STREAMING, &probe, len) != len) {
+        return -1;
+    }
+
+    return usb_vdcd_set_interface(ITF_NUM_VIDEO_STREAMING, 1);
+}
+
+static int run(const usb_vdcd_ep_t *ep, unsigned width, unsigned height)
+{
+    const unsigned packets_max = BENCH_FRAMES * (width * height * 2 / 16);
+    uvc_frame_pool_stats_t start;
+    uvc_frame_pool_stats_t end;
+    usb_vdcd_stats_t stats;
+    uint8_t pkt[1024];
+    unsigned packets = 0;
+    unsigned frames;
+    char name[32];
+
+    uvc_frame_pool_stats_get(&frame_pool, &start);
+    frame_bytes = width * height * 2;
+    usb_vdcd_stats_reset();
+    usb_vdcd_pump();
+
+    do {
+        usb_vdcd_sof();
+        usb_vdcd_iso_in(ep, pkt);
+        packets++;
+        uvc_frame_pool_stats_get(&frame_pool, &end);
+        frames = end.sent - start.sent;
+    } while (frames < BENCH_FRAMES && packets < packets_max);
+
+    usb_vdcd_stats_get(&stats);
+
+    snprintf(name, sizeof(name), "uvc %ux%u yuy2", width, height);
+    usb_vdcd_report(name, end.bytes - start.bytes, &stats);
+    printf("%24s %u frames in %u ms of bus time, %.1f fps sustained\n",
+           "", frames, packets, frames * 1000.0 / packets);
+
+    /* Let the submitted frames finish before changing size */
+    frame_bytes = 0;
+    while (end.sent + end.aborted != end.submitted && packets++ < packets_max) {
+        usb_vdcd_sof();
+        usb_vdcd_iso_in(ep, pkt);
+        uvc_frame_pool_stats_get(&frame_pool, &end);
+    }
+
+    return frames < BENCH_FRAMES;
+}
+
+int main(void)
+{
+    static const unsigned resolutions[][2] = {
+        {64, 48}, {FRAME_WIDTH, FRAME_HEIGHT}, {160, 120}, {320, 240},
+    };
+    uint8_t *bufs[POOL_FRAMES];
+    const usb_vdcd_ep_t *ep;
+    int errors = 0;
+
+    for (int i = 0; i < POOL_FRAMES; i++) {
+        bufs[i] = frame_storage[i];
+    }
+    uvc_frame_pool_init(&frame_pool, 0, 0, bufs, POOL_FRAMES);
+
+    usb_vdcd_poll_set(video_poll);
+    if (usb_vdcd_init(0) != 0) {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+
+    ep = usb_vdcd_find_ep(ITF_NUM_VIDEO_STREAMING, 1, 0x80, TUSB_XFER_ISOCHRONOUS);
+    if (ep == NULL) {
+        printf("Video endpoint not found\n");
+        return 1;
+    }
+
+    if (start_stream() != 0) {
+        printf("Stream negotiation failed\n");
+        return 1;
+    }
+
+    usb_vdcd_report_header();
+    for (size_t i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++) {
+        errors += run(ep, resolutions[i][0], resolutions[i][1]);
+    }
+
+    if (errors) {
+        printf("%d tests stalled\n", errors);
+        return 1;
+    }
+
+    return 0;
+}
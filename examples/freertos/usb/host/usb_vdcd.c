@@ -0,0 +1,540 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tusb.h"
+#include "device/dcd.h"
+
+#include "usb_vdcd.h"
+
+#define EP_NUM_MAX          16
+#define EP_DESC_MAX         32
+#define CONFIG_DESC_MAX     2048
+
+/* tud_task() runs before a token is answered with NAK */
+#define NAK_RETRIES         4
+
+typedef struct {
+    uint8_t *buf;
+    tu_fifo_t *ff;
+    uint16_t total;
+    uint16_t done;
+    uint16_t mps;
+    uint8_t armed;
+    uint8_t stalled;
+} vep_t;
+
+static vep_t vep[EP_NUM_MAX][2];
+static usb_vdcd_ep_t ep_desc[EP_DESC_MAX];
+static int ep_desc_count;
+static void (*app_poll)(void);
+static usb_vdcd_stats_t stats;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static vep_t *ep_get(uint8_t addr)
+{
+    return &vep[tu_edpt_number(addr)][tu_edpt_dir(addr) == TUSB_DIR_IN];
+}
+
+/*
+ * DCD interface, called by TinyUSB.
+ */
+
+void dcd_init(uint8_t rhport)
+{
+    (void) rhport;
+
+    memset(vep, 0, sizeof(vep));
+    vep[0][0].mps = CFG_TUD_ENDPOINT0_SIZE;
+    vep[0][1].mps = CFG_TUD_ENDPOINT0_SIZE;
+}
+
+void dcd_int_handler(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_int_enable(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_int_disable(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_set_address(uint8_t rhport, uint8_t dev_addr)
+{
+    (void) dev_addr;
+
+    /* The status stage is sent before the new address takes effect */
+    dcd_edpt_xfer(rhport, tu_edpt_addr(0, TUSB_DIR_IN), NULL, 0);
+}
+
+void dcd_remote_wakeup(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_connect(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_disconnect(uint8_t rhport)
+{
+    (void) rhport;
+}
+
+void dcd_sof_enable(uint8_t rhport, bool en)
+{
+    (void) rhport;
+    (void) en;
+}
+
+bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *desc_ep)
+{
+    const uint8_t *raw = (const uint8_t *) desc_ep;
+    vep_t *e = ep_get(desc_ep->bEndpointAddress);
+
+    (void) rhport;
+
+    memset(e, 0, sizeof(*e));
+    e->mps = (raw[4] | (raw[5] << 8)) & 0x7FF;
+
+    return true;
+}
+
+void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr)
+{
+    vep_t *e = ep_get(ep_addr);
+
+    (void) rhport;
+
+    e->armed = 0;
+    e->stalled = 0;
+}
+
+void dcd_edpt_close_all(uint8_t rhport)
+{
+    (void) rhport;
+
+    for (int i = 1; i < EP_NUM_MAX; i++) {
+        vep[i][0].armed = 0;
+        vep[i][1].armed = 0;
+    }
+}
+
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
+{
+    vep_t *e = ep_get(ep_addr);
+
+    (void) rhport;
+
+    e->buf = buffer;
+    e->ff = NULL;
+    e->total = total_bytes;
+    e->done = 0;
+    e->armed = 1;
+
+    return true;
+}
+
+bool dcd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t *ff, uint16_t total_bytes)
+{
+    vep_t *e = ep_get(ep_addr);
+
+    (void) rhport;
+
+    e->buf = NULL;
+    e->ff = ff;
+    e->total = total_bytes;
+    e->done = 0;
+    e->armed = 1;
+
+    return true;
+}
+
+void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr)
+{
+    vep_t *e = ep_get(ep_addr);
+
+    (void) rhport;
+
+    e->armed = 0;
+    e->stalled = 1;
+}
+
+void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
+{
+    (void) rhport;
+
+    ep_get(ep_addr)->stalled = 0;
+}
+
+uint32_t tusb_time_millis_api(void)
+{
+    return (uint32_t) (now_ns() / 1000000);
+}
+
+/*
+ * Virtual host.
+ */
+
+void usb_vdcd_pump(void)
+{
+    const uint64_t start = now_ns();
+
+    tud_task();
+    if (app_poll != NULL) {
+        app_poll();
+    }
+
+    stats.device_ns += now_ns() - start;
+}
+
+static void xfer_done(uint8_t addr, vep_t *e)
+{
+    e->armed = 0;
+    if (tu_edpt_number(addr) != 0) {
+        stats.xfers++;
+    }
+    dcd_event_xfer_complete(0, addr, e->done, XFER_RESULT_SUCCESS, false);
+    usb_vdcd_pump();
+}
+
+static vep_t *wait_armed(uint8_t addr)
+{
+    vep_t *e = ep_get(addr);
+
+    for (int i = 0; !e->armed && !e->stalled && i < NAK_RETRIES; i++) {
+        usb_vdcd_pump();
+    }
+
+    return e->armed ? e : NULL;
+}
+
+/* Moves one IN packet from the armed transfer to the host */
+static size_t packet_in(uint8_t addr, vep_t *e, uint8_t *dst, size_t max)
+{
+    size_t n = e->total - e->done;
+
+    if (n > e->mps) {
+        n = e->mps;
+    }
+    if (n > max) {
+        n = max;
+    }
+
+    if (n > 0) {
+        if (e->ff != NULL) {
+            tu_fifo_read_n(e->ff, dst, (uint16_t) n);
+        } else {
+            memcpy(dst, e->buf + e->done, n);
+        }
+        stats.copy_bytes += n;
+    }
+    e->done += (uint16_t) n;
+
+    if (e->done == e->total || n < e->mps) {
+        xfer_done(addr, e);
+    }
+
+    return n;
+}
+
+/* Moves one OUT packet from the host into the armed transfer */
+static size_t packet_out(uint8_t addr, vep_t *e, const uint8_t *src, size_t len)
+{
+    size_t n = e->total - e->done;
+
+    if (n > len) {
+        n = len;
+    }
+
+    if (n > 0) {
+        if (e->ff != NULL) {
+            tu_fifo_write_n(e->ff, src, (uint16_t) n);
+        } else {
+            memcpy(e->buf + e->done, src, n);
+        }
+        stats.copy_bytes += n;
+    }
+    e->done += (uint16_t) n;
+
+    if (e->done == e->total || len < e->mps) {
+        xfer_done(addr, e);
+    }
+
+    return n;
+}
+
+void usb_vdcd_poll_set(void (*poll)(void))
+{
+    app_poll = poll;
+}
+
+int usb_vdcd_control(uint8_t bm_request_type, uint8_t b_request, uint16_t w_value,
+                     uint16_t w_index, void *data, uint16_t w_length)
+{
+    const uint8_t setup[8] = {
+        bm_request_type, b_request,
+        w_value & 0xFF, w_value >> 8,
+        w_index & 0xFF, w_index >> 8,
+        w_length & 0xFF, w_length >> 8,
+    };
+    const int dir_in = (bm_request_type & 0x80) != 0;
+    const uint8_t data_addr = dir_in ? 0x80 : 0x00;
+    uint8_t status_addr;
+    uint8_t *p = data;
+    size_t got = 0;
+    vep_t *e;
+
+    /* A SETUP packet clears any transfer or stall left on endpoint 0 */
+    memset(&vep[0][0], 0, sizeof(vep_t));
+    memset(&vep[0][1], 0, sizeof(vep_t));
+    vep[0][0].mps = CFG_TUD_ENDPOINT0_SIZE;
+    vep[0][1].mps = CFG_TUD_ENDPOINT0_SIZE;
+
+    stats.setups++;
+    dcd_event_setup_received(0, setup, false);
+    usb_vdcd_pump();
+
+    while (got < w_length) {
+        size_t n;
+
+        if ((e = wait_armed(data_addr)) == NULL) {
+            stats.stalls++;
+            return -1;
+        }
+        if (dir_in) {
+            n = packet_in(data_addr, e, p + got, w_length - got);
+        } else {
+            n = w_length - got;
+            n = packet_out(data_addr, e, p + got, n < CFG_TUD_ENDPOINT0_SIZE ? n : CFG_TUD_ENDPOINT0_SIZE);
+        }
+        got += n;
+        if (n < CFG_TUD_ENDPOINT0_SIZE) {
+            break;
+        }
+    }
+
+    /* Status stage, in the opposite direction to the data stage */
+    status_addr = (dir_in && w_length > 0) ? 0x00 : 0x80;
+    if ((e = wait_armed(status_addr)) == NULL) {
+        stats.stalls++;
+        return -1;
+    }
+    if (status_addr & 0x80) {
+        packet_in(status_addr, e, NULL, 0);
+    } else {
+        packet_out(status_addr, e, NULL, 0);
+    }
+
+    return (int) got;
+}
+
+int usb_vdcd_set_interface(uint8_t itf, uint8_t alt)
+{
+    return usb_vdcd_control(0x01, TUSB_REQ_SET_INTERFACE, alt, itf, NULL, 0) < 0 ? -1 : 0;
+}
+
+static void parse_config(const uint8_t *desc, size_t len)
+{
+    uint8_t itf = 0;
+    uint8_t alt = 0;
+
+    ep_desc_count = 0;
+    for (size_t i = 0; i + 1 < len && desc[i] != 0; i += desc[i]) {
+        if (desc[i + 1] == TUSB_DESC_INTERFACE) {
+            itf = desc[i + 2];
+            alt = desc[i + 3];
+        } else if (desc[i + 1] == TUSB_DESC_ENDPOINT && ep_desc_count < EP_DESC_MAX) {
+            usb_vdcd_ep_t *ep = &ep_desc[ep_desc_count++];
+            ep->itf = itf;
+            ep->alt = alt;
+            ep->addr = desc[i + 2];
+            ep->type = desc[i + 3] & 0x03;
+            ep->mps = (desc[i + 4] | (desc[i + 5] << 8)) & 0x7FF;
+            ep->interval = desc[i + 6];
+        }
+    }
+}
+
+int usb_vdcd_init(int high_speed)
+{
+    static uint8_t desc[CONFIG_DESC_MAX];
+    size_t total;
+
+    tusb_init();
+    dcd_event_bus_reset(0, high_speed ? TUSB_SPEED_HIGH : TUSB_SPEED_FULL, false);
+    usb_vdcd_pump();
+
+    if (usb_vdcd_control(0x80, TUSB_REQ_GET_DESCRIPTOR, TUSB_DESC_DEVICE << 8, 0, desc, 18) != 18 ||
+        usb_vdcd_control(0x00, TUSB_REQ_SET_ADDRESS, 1, 0, NULL, 0) < 0 ||
+        usb_vdcd_control(0x80, TUSB_REQ_GET_DESCRIPTOR, TUSB_DESC_CONFIGURATION << 8, 0, desc, 9) != 9) {
+        return -1;
+    }
+
+    total = desc[2] | (desc[3] << 8);
+    if (total > sizeof(desc) ||
+        usb_vdcd_control(0x80, TUSB_REQ_GET_DESCRIPTOR, TUSB_DESC_CONFIGURATION << 8, 0, desc, (uint16_t) total) != (int) total) {
+        return -1;
+    }
+    parse_config(desc, total);
+
+    if (usb_vdcd_control(0x00, TUSB_REQ_SET_CONFIGURATION, 1, 0, NULL, 0) < 0 || !tud_mounted()) {
+        return -1;
+    }
+
+    usb_vdcd_stats_reset();
+
+    return 0;
+}
+
+const usb_vdcd_ep_t *usb_vdcd_find_ep(int itf, uint8_t alt, uint8_t addr_dir, uint8_t type)
+{
+    for (int i = 0; i < ep_desc_count; i++) {
+        const usb_vdcd_ep_t *ep = &ep_desc[i];
+
+        if ((itf < 0 || ep->itf == itf) && ep->alt == alt &&
+            (ep->addr & 0x80) == addr_dir && ep->type == type) {
+            return ep;
+        }
+    }
+
+    return NULL;
+}
+
+size_t usb_vdcd_bulk_out(const usb_vdcd_ep_t *ep, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    size_t sent = 0;
+
+    do {
+        size_t n = len - sent;
+        vep_t *e;
+
+        if (n > ep->mps) {
+            n = ep->mps;
+        }
+        if ((e = wait_armed(ep->addr)) == NULL) {
+            stats.naks++;
+            break;
+        }
+        n = packet_out(ep->addr, e, p + sent, n);
+        stats.packets++;
+        stats.bytes += n;
+        sent += n;
+    } while (sent < len);
+
+    return sent;
+}
+
+size_t usb_vdcd_bulk_in(const usb_vdcd_ep_t *ep, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    size_t got = 0;
+
+    while (got < len) {
+        size_t n;
+        vep_t *e;
+
+        if ((e = wait_armed(ep->addr)) == NULL) {
+            stats.naks++;
+            break;
+        }
+        n = packet_in(ep->addr, e, p + got, len - got);
+        stats.packets++;
+        stats.bytes += n;
+        got += n;
+        if (n < ep->mps) {
+            break;
+        }
+    }
+
+    return got;
+}
+
+int usb_vdcd_iso_out(const usb_vdcd_ep_t *ep, const void *buf, size_t len)
+{
+    vep_t *e = ep_get(ep->addr);
+    size_t n;
+
+    if (!e->armed) {
+        usb_vdcd_pump();
+    }
+    if (!e->armed) {
+        stats.iso_missed++;
+        return -1;
+    }
+
+    n = packet_out(ep->addr, e, buf, len);
+    stats.packets++;
+    stats.bytes += n;
+
+    return (int) n;
+}
+
+int usb_vdcd_iso_in(const usb_vdcd_ep_t *ep, void *buf)
+{
+    vep_t *e = ep_get(ep->addr);
+    size_t n;
+
+    if (!e->armed) {
+        usb_vdcd_pump();
+    }
+    if (!e->armed) {
+        stats.iso_missed++;
+        return -1;
+    }
+
+    n = packet_in(ep->addr, e, buf, ep->mps);
+    stats.packets++;
+    stats.bytes += n;
+
+    return (int) n;
+}
+
+void usb_vdcd_sof(void)
+{
+    dcd_event_bus_signal(0, DCD_EVENT_SOF, false);
+    usb_vdcd_pump();
+}
+
+void usb_vdcd_stats_get(usb_vdcd_stats_t *s)
+{
+    *s = stats;
+}
+
+void usb_vdcd_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void usb_vdcd_report_header(void)
+{
+    printf("%-24s %10s %10s %8s %8s %6s %6s\n",
+           "test", "MB/s", "us/xfer", "copies", "xfers", "naks", "missed");
+}
+
+void usb_vdcd_report(const char *name, uint64_t bytes, const usb_vdcd_stats_t *s)
+{
+    const double mbps = s->device_ns ? ((double) bytes * 1000.0) / (double) s->device_ns : 0.0;
+    const double us_per_xfer = s->xfers ? (double) s->device_ns / 1000.0 / s->xfers : 0.0;
+    const double copies = bytes ? (double) s->copy_bytes / (double) bytes : 0.0;
+
+    printf("%-24s %10.1f %10.2f %8.2f %8u %6u %6u\n",
+           name, mbps, us_per_xfer, copies, s->xfers, s->naks, s->iso_missed);
+}
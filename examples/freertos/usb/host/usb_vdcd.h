@@ -0,0 +1,191 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef USB_VDCD_H_
+#define USB_VDCD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup usb_vdcd
+ *
+ * A virtual TinyUSB device controller for running the USB demos on a host.
+ *
+ * usb_vdcd.c implements the TinyUSB DCD interface in place of the rtos_usb
+ * port and also plays the part of the USB host. The benchmark drives the bus
+ * with the functions below, each of which delivers packets to the endpoints
+ * TinyUSB has armed and then runs tud_task() and the application poll
+ * function until the device is idle. Everything runs on one thread with
+ * CFG_TUSB_OS set to OPT_OS_NONE, so a demo's tusb_config.h and
+ * usb_descriptors.c are used unchanged.
+ *
+ * Time spent in tud_task() and the poll function is accumulated as device
+ * time, so throughput figures measure the TinyUSB class path and the
+ * application callbacks rather than the virtual bus.
+ * @{
+ */
+
+/** Endpoint found in the configuration descriptor. */
+typedef struct {
+    uint8_t itf;                /**< Interface number. */
+    uint8_t alt;                /**< Alternate setting. */
+    uint8_t addr;               /**< Endpoint address, bit 7 set for IN. */
+    uint8_t type;               /**< Transfer type, 1 iso, 2 bulk, 3 interrupt. */
+    uint16_t mps;               /**< Maximum packet size. */
+    uint8_t interval;           /**< bInterval. */
+} usb_vdcd_ep_t;
+
+/** Bus statistics. */
+typedef struct {
+    uint64_t device_ns;         /**< Time spent in tud_task() and the poll function. */
+    uint32_t setups;            /**< SETUP packets sent. */
+    uint32_t xfers;             /**< Transfers completed on non-control endpoints. */
+    uint32_t packets;           /**< Packets on non-control endpoints. */
+    uint64_t bytes;             /**< Payload bytes on non-control endpoints. */
+    uint64_t copy_bytes;        /**< Bytes copied between host and device buffers. */
+    uint32_t naks;              /**< Host tokens the device was not ready for. */
+    uint32_t iso_missed;        /**< Isochronous intervals with no transfer armed. */
+    uint32_t stalls;            /**< Requests or transfers answered with STALL. */
+} usb_vdcd_stats_t;
+
+/**
+ * Resets the bus, enumerates the device at the given speed and selects
+ * configuration 1.
+ *
+ * \param high_speed  Non-zero to enumerate at high speed
+ *
+ * \return 0 on success, -1 if enumeration failed
+ */
+int usb_vdcd_init(int high_speed);
+
+/**
+ * Sets a function called after every tud_task() run, standing in for the
+ * demo's application task.
+ *
+ * \param poll  The poll function, or NULL
+ */
+void usb_vdcd_poll_set(void (*poll)(void));
+
+/**
+ * Runs tud_task() and the poll function once.
+ */
+void usb_vdcd_pump(void);
+
+/**
+ * Issues a control transfer on endpoint 0.
+ *
+ * \param bm_request_type  bmRequestType
+ * \param b_request        bRequest
+ * \param w_value          wValue
+ * \param w_index          wIndex
+ * \param data             The data stage buffer
+ * \param w_length         wLength
+ *
+ * \return the number of data stage bytes transferred, or -1 on STALL
+ */
+int usb_vdcd_control(uint8_t bm_request_type, uint8_t b_request, uint16_t w_value,
+                     uint16_t w_index, void *data, uint16_t w_length);
+
+/**
+ * Issues SET_INTERFACE.
+ *
+ * \param itf  The interface number
+ * \param alt  The alternate setting
+ *
+ * \return 0 on success, -1 on STALL
+ */
+int usb_vdcd_set_interface(uint8_t itf, uint8_t alt);
+
+/**
+ * Looks up an endpoint in the configuration descriptor.
+ *
+ * \param itf   The interface number, or -1 for any
+ * \param alt   The alternate setting
+ * \param addr_dir  0x80 for an IN endpoint, 0 for OUT
+ * \param type  The transfer type
+ *
+ * \return the endpoint, or NULL if there is none
+ */
+const usb_vdcd_ep_t *usb_vdcd_find_ep(int itf, uint8_t alt, uint8_t addr_dir, uint8_t type);
+
+/**
+ * Sends data on a bulk or interrupt OUT endpoint, in packets of the
+ * maximum packet size. Stops early if the device NAKs.
+ *
+ * \param ep   The endpoint
+ * \param buf  The data
+ * \param len  The number of bytes
+ *
+ * \return the number of bytes the device accepted
+ */
+size_t usb_vdcd_bulk_out(const usb_vdcd_ep_t *ep, const void *buf, size_t len);
+
+/**
+ * Receives data on a bulk or interrupt IN endpoint. Stops at a short
+ * packet, after len bytes, or if the device NAKs.
+ *
+ * \param ep   The endpoint
+ * \param buf  The buffer to receive into
+ * \param len  The buffer size
+ *
+ * \return the number of bytes received
+ */
+size_t usb_vdcd_bulk_in(const usb_vdcd_ep_t *ep, void *buf, size_t len);
+
+/**
+ * Sends one isochronous OUT packet.
+ *
+ * \param ep   The endpoint
+ * \param buf  The packet
+ * \param len  The packet length, at most the maximum packet size
+ *
+ * \return the number of bytes the device accepted, or -1 if no transfer
+ *         was armed
+ */
+int usb_vdcd_iso_out(const usb_vdcd_ep_t *ep, const void *buf, size_t len);
+
+/**
+ * Receives one isochronous IN packet.
+ *
+ * \param ep   The endpoint
+ * \param buf  The buffer to receive into, at least the maximum packet size
+ *
+ * \return the packet length, or -1 if no transfer was armed
+ */
+int usb_vdcd_iso_in(const usb_vdcd_ep_t *ep, void *buf);
+
+/**
+ * Signals a start of frame.
+ */
+void usb_vdcd_sof(void);
+
+/**
+ * Gets the bus statistics.
+ *
+ * \param stats  A pointer to the struct to populate
+ */
+void usb_vdcd_stats_get(usb_vdcd_stats_t *stats);
+
+/**
+ * Clears the bus statistics.
+ */
+void usb_vdcd_stats_reset(void);
+
+/**
+ * Prints the column headings for usb_vdcd_report().
+ */
+void usb_vdcd_report_header(void);
+
+/**
+ * Prints one result line in the common benchmark format.
+ *
+ * \param name   The test name
+ * \param bytes  The payload bytes moved by the test
+ * \param stats  The statistics collected over the test
+ */
+void usb_vdcd_report(const char *name, uint64_t bytes, const usb_vdcd_stats_t *stats);
+
+/**@}*/
+
+#endif /* USB_VDCD_H_ */
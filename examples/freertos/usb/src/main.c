@@ -41,7 +41,7 @@ void startup_task(void *arg)
     create_tinyusb_disks(qspi_flash_ctx);
 #endif
 
-#if DFU_DEMO
+#if DFU_DEMO || MSC_FLASH_DEMO
     demo_args_t *demo_task_args = pvPortMalloc(sizeof(demo_args_t));
     demo_task_args->gpio_ctx = gpio_ctx_t0;
     demo_task_args->qspi_ctx = qspi_flash_ctx;
@@ -0,0 +1,208 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "tusb.h"
+
+#include "compiler_barrier.h"
+#include "cdc_stream.h"
+
+void cdc_stream_init(cdc_stream_t *ctx, uint8_t itf, void (*wake)(void *arg), void *wake_arg)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->itf = itf;
+    ctx->packet_size = CFG_TUD_CDC_EP_BUFSIZE;
+    ctx->wake = wake;
+    ctx->wake_arg = wake_arg;
+}
+
+void cdc_stream_producer_add(cdc_stream_t *ctx, cdc_stream_producer_t *prod, uint8_t *buf, size_t size)
+{
+    memset(prod, 0, sizeof(*prod));
+    prod->buf = buf;
+    prod->mask = size - 1;
+    prod->stream = ctx;
+
+    /* The producer must be complete before the consumer can see it */
+    prod->next = ctx->producers;
+    COMPILER_BARRIER();
+    ctx->producers = prod;
+}
+
+size_t cdc_stream_write(cdc_stream_producer_t *prod, const void *data, size_t len)
+{
+    const uint32_t wr = prod->wr;
+    const uint32_t level = wr - prod->rd;
+    const uint32_t size = prod->mask + 1;
+    const uint32_t packet = prod->stream->packet_size;
+    size_t first;
+
+    if (len > size - level) {
+        prod->stats.dropped_records++;
+        prod->stats.dropped_bytes += len;
+        return 0;
+    }
+
+    first = size - (wr & prod->mask);
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&prod->buf[wr & prod->mask], data, first);
+    memcpy(prod->buf, (const uint8_t *) data + first, len - first);
+
+    /* The record must be in the ring before the write index publishes it */
+    COMPILER_BARRIER();
+    prod->wr = wr + len;
+
+    prod->stats.records++;
+    prod->stats.bytes += len;
+    if (level + len > prod->stats.high_water) {
+        prod->stats.high_water = level + len;
+    }
+
+    /* Wake the consumer once this ring alone can fill a bulk packet */
+    if (level < packet && level + len >= packet && prod->stream->wake != NULL) {
+        prod->stream->wake(prod->stream->wake_arg);
+    }
+
+    return len;
+}
+
+/* Picks the next producer with data after the last one drained */
+static cdc_stream_producer_t *next_producer(cdc_stream_t *ctx)
+{
+    cdc_stream_producer_t *start = ctx->last != NULL ? ctx->last->next : NULL;
+    cdc_stream_producer_t *p;
+
+    if (start == NULL) {
+        start = ctx->producers;
+    }
+
+    p = start;
+    do {
+        if (p == NULL) {
+            return NULL;
+        }
+        if (p->wr != p->rd) {
+            return p;
+        }
+        p = p->next != NULL ? p->next : ctx->producers;
+    } while (p != start);
+
+    return NULL;
+}
+
+static size_t pending_bytes(const cdc_stream_t *ctx)
+{
+    size_t pending = 0;
+
+    for (const cdc_stream_producer_t *p = ctx->producers; p != NULL; p = p->next) {
+        pending += p->wr - p->rd;
+    }
+
+    return pending;
+}
+
+/* Writes up to n bytes from the producer's ring, which may wrap */
+static uint32_t ring_to_cdc(cdc_stream_t *ctx, cdc_stream_producer_t *p, uint32_t n)
+{
+    const uint32_t rd = p->rd;
+    uint32_t first = p->mask + 1 - (rd & p->mask);
+    uint32_t written;
+
+    if (first > n) {
+        first = n;
+    }
+
+    /* Only send what the write index has published */
+    COMPILER_BARRIER();
+    written = tud_cdc_n_write(ctx->itf, &p->buf[rd & p->mask], first);
+    if (written == first && n > first) {
+        written += tud_cdc_n_write(ctx->itf, p->buf, n - first);
+    }
+    /* The records must be copied out before the read index frees them */
+    COMPILER_BARRIER();
+    p->rd = rd + written;
+
+    ctx->stats.writes++;
+    ctx->stats.bytes += written;
+
+    return written;
+}
+
+size_t cdc_stream_service(cdc_stream_t *ctx, int flush)
+{
+    const uint32_t packet = tud_speed_get() == TUSB_SPEED_HIGH ? 512 : 64;
+    size_t pending;
+
+    ctx->packet_size = packet;
+
+    if (!tud_cdc_n_connected(ctx->itf)) {
+        /* Nobody is listening, so keep the rings empty for fresh data */
+        for (cdc_stream_producer_t *p = ctx->producers; p != NULL; p = p->next) {
+            const uint32_t wr = p->wr;
+            ctx->stats.discarded += wr - p->rd;
+            p->rd = wr;
+        }
+        ctx->cur = NULL;
+        return 0;
+    }
+
+    pending = pending_bytes(ctx);
+    if (!flush && ctx->cur == NULL && pending < packet) {
+        return pending;
+    }
+
+    while (pending > 0) {
+        uint32_t avail;
+        uint32_t n;
+        cdc_stream_producer_t *p;
+
+        if (ctx->cur == NULL) {
+            if ((p = next_producer(ctx)) == NULL) {
+                break;
+            }
+            ctx->cur = p;
+            ctx->cur_end = p->wr;
+        }
+        p = ctx->cur;
+
+        if ((avail = tud_cdc_n_write_available(ctx->itf)) == 0) {
+            ctx->stats.back_pressure++;
+            break;
+        }
+
+        n = ctx->cur_end - p->rd;
+        if (n > avail) {
+            n = avail;
+        }
+        n = ring_to_cdc(ctx, p, n);
+        pending -= n;
+
+        /* Finish the records snapshotted from this producer before the next */
+        if (p->rd == ctx->cur_end) {
+            ctx->last = p;
+            ctx->cur = NULL;
+        }
+    }
+
+    if (flush) {
+        const uint32_t sent = tud_cdc_n_write_flush(ctx->itf);
+        if (sent > 0 && sent < packet) {
+            ctx->stats.flushes++;
+        }
+    }
+
+    return pending;
+}
+
+void cdc_stream_stats_get(const cdc_stream_t *ctx, cdc_stream_stats_t *stats)
+{
+    *stats = ctx->stats;
+}
+
+void cdc_stream_producer_stats_get(const cdc_stream_producer_t *prod, cdc_stream_producer_stats_t *stats)
+{
+    *stats = prod->stats;
+}
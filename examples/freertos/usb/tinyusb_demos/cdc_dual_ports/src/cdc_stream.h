@@ -0,0 +1,154 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef CDC_STREAM_H_
+#define CDC_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup cdc_stream
+ *
+ * A streaming transmit path for a CDC ACM port, for telemetry and logs.
+ *
+ * Each producer task owns a ring buffer and writes whole records into it
+ * without blocking. A record that does not fit is dropped and counted, so
+ * a slow or absent host never stalls a producer. A single consumer,
+ * normally a task woken by the producers and by TinyUSB's transmit complete
+ * callback, moves the rings into the TinyUSB CDC FIFO with
+ * tud_cdc_n_write(). It writes only while at least one bulk packet's worth
+ * is pending, so data leaves in full 64 or 512 byte packets, and sends a
+ * short packet only when asked to flush.
+ *
+ * Records from one producer are sent in order and records from different
+ * producers are never interleaved. Each ring has one writer and one reader,
+ * ordered with COMPILER_BARRIER(), so no locks are needed.
+ * @{
+ */
+
+/** Producer statistics. */
+typedef struct {
+    uint32_t records;           /**< Records written. */
+    uint32_t bytes;             /**< Bytes written. */
+    uint32_t dropped_records;   /**< Records dropped because the ring was full. */
+    uint32_t dropped_bytes;     /**< Bytes in the dropped records. */
+    uint32_t high_water;        /**< Highest ring level seen after a write. */
+} cdc_stream_producer_stats_t;
+
+/** Stream statistics. */
+typedef struct {
+    uint32_t bytes;             /**< Bytes passed to tud_cdc_n_write(). */
+    uint32_t writes;            /**< Calls to tud_cdc_n_write(). */
+    uint32_t flushes;           /**< Short packets sent by a flush. */
+    uint32_t back_pressure;     /**< Service calls that left data pending because the CDC FIFO was full. */
+    uint32_t discarded;         /**< Bytes discarded while the port was closed. */
+} cdc_stream_stats_t;
+
+/**
+ * Typedef to the stream instance struct.
+ */
+typedef struct cdc_stream_struct cdc_stream_t;
+
+/**
+ * Typedef to the producer instance struct.
+ */
+typedef struct cdc_stream_producer_struct cdc_stream_producer_t;
+
+/**
+ * Struct representing a producer instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct cdc_stream_producer_struct {
+    uint8_t *buf;
+    uint32_t mask;
+    volatile uint32_t wr;
+    volatile uint32_t rd;
+    cdc_stream_t *stream;
+    cdc_stream_producer_t *volatile next;
+    cdc_stream_producer_stats_t stats;
+};
+
+/**
+ * Struct representing a stream instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct cdc_stream_struct {
+    uint8_t itf;
+    cdc_stream_producer_t *volatile producers;
+    cdc_stream_producer_t *cur;
+    cdc_stream_producer_t *last;
+    uint32_t cur_end;
+    volatile uint32_t packet_size;
+    void (*wake)(void *arg);
+    void *wake_arg;
+    cdc_stream_stats_t stats;
+};
+
+/**
+ * Initializes a stream on a CDC interface.
+ *
+ * \param ctx       A pointer to the stream instance
+ * \param itf       The CDC interface number
+ * \param wake      Called by a producer when its ring first holds a full bulk
+ *                  packet, to wake the consumer. May be NULL if the consumer polls.
+ *                  Must not block.
+ * \param wake_arg  The argument passed to \p wake
+ */
+void cdc_stream_init(cdc_stream_t *ctx, uint8_t itf, void (*wake)(void *arg), void *wake_arg);
+
+/**
+ * Adds a producer to a stream. Producers may be added while the stream is
+ * running, but only from one task at a time.
+ *
+ * \param ctx   A pointer to the stream instance
+ * \param prod  A pointer to the producer instance
+ * \param buf   The producer's ring buffer
+ * \param size  The size of \p buf in bytes. Must be a power of two.
+ */
+void cdc_stream_producer_add(cdc_stream_t *ctx, cdc_stream_producer_t *prod, uint8_t *buf, size_t size);
+
+/**
+ * Writes one record. Must only be called by the task that owns the
+ * producer. Never blocks.
+ *
+ * \param prod  A pointer to the producer instance
+ * \param data  The record
+ * \param len   The record length in bytes
+ *
+ * \return \p len if the record was queued, or 0 if it was dropped
+ */
+size_t cdc_stream_write(cdc_stream_producer_t *prod, const void *data, size_t len);
+
+/**
+ * Moves pending records into the CDC FIFO. Must only be called by the
+ * consumer.
+ *
+ * \param ctx    A pointer to the stream instance
+ * \param flush  Non-zero to also send data short of a full packet
+ *
+ * \return the number of bytes still pending
+ */
+size_t cdc_stream_service(cdc_stream_t *ctx, int flush);
+
+/**
+ * Gets a snapshot of the stream statistics.
+ *
+ * \param ctx    A pointer to the stream instance
+ * \param stats  A pointer to the struct to populate
+ */
+void cdc_stream_stats_get(const cdc_stream_t *ctx, cdc_stream_stats_t *stats);
+
+/**
+ * Gets a snapshot of a producer's statistics.
+ *
+ * \param prod   A pointer to the producer instance
+ * \param stats  A pointer to the struct to populate
+ */
+void cdc_stream_producer_stats_get(const cdc_stream_producer_t *prod, cdc_stream_producer_stats_t *stats);
+
+/**@}*/
+
+#endif /* CDC_STREAM_H_ */
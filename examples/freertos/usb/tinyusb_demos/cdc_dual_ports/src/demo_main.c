@@ -29,37 +29,103 @@
 #include <ctype.h>
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "demo_main.h"
 #include "tusb.h"
+#include "cdc_stream.h"
 
-// echo to either Serial0 or Serial1
-// with Serial0 as all lower case, Serial1 as all upper case
-static void echo_serial_port(uint8_t itf, uint8_t buf[], uint32_t count)
+//--------------------------------------------------------------------+
+// Serial0 telemetry and Serial1 data streams
+//--------------------------------------------------------------------+
+
+// Data short of a full packet waits at most this long before it is sent
+#define STREAM_FLUSH_MS       5
+
+#define STREAM_RING_BYTES     2048
+#define TELEMETRY_PERIOD_MS   100
+
+static cdc_stream_t telemetry_stream;
+static cdc_stream_t data_stream;
+static cdc_stream_producer_t echo_producer;
+static cdc_stream_producer_t telemetry_producer;
+static uint8_t echo_ring[STREAM_RING_BYTES];
+static uint8_t telemetry_ring[STREAM_RING_BYTES];
+static TaskHandle_t stream_task_handle;
+
+static void stream_wake(void *arg)
 {
-  for(uint32_t i=0; i<count; i++)
-  {
-    if (itf == 0)
-    {
-      // echo back 1st port as lower case
-      if (isupper(buf[i])) buf[i] += 'a' - 'A';
-    }
-    else
-    {
-      // echo back 2nd port as upper case
-      if (islower(buf[i])) buf[i] -= 'a' - 'A';
-    }
+  (void) arg;
+  xTaskNotifyGive(stream_task_handle);
+}
+
+// Invoked when a CDC IN transfer completes
+void tud_cdc_tx_complete_cb(uint8_t itf)
+{
+  (void) itf;
+  stream_wake(NULL);
+}
+
+static void stream_task(void *arg)
+{
+  (void) arg;
+
+  while(1) {
+    // Woken for a full packet or a completed transfer. A timeout means the
+    // stream has gone quiet, so send what is left.
+    uint32_t woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STREAM_FLUSH_MS));
+    cdc_stream_service(&data_stream, woken == 0);
+    cdc_stream_service(&telemetry_stream, woken == 0);
+  }
+}
+
+// Periodic status line on Serial0, kept apart from the data on Serial1
+static void telemetry_task(void *arg)
+{
+  TickType_t last_wake_time = xTaskGetTickCount();
+  cdc_stream_stats_t stats;
+  cdc_stream_producer_stats_t echo_stats;
+  char line[128];
 
-    tud_cdc_n_write_char(itf, buf[i]);
+  (void) arg;
+
+  while(1) {
+    vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(TELEMETRY_PERIOD_MS));
+
+    cdc_stream_stats_get(&data_stream, &stats);
+    cdc_stream_producer_stats_get(&echo_producer, &echo_stats);
+
+    int len = snprintf(line, sizeof(line),
+                       "[%lu ms] sent %lu B, echo dropped %lu B, back-pressure %lu, discarded %lu B\r\n",
+                       (unsigned long) (last_wake_time * portTICK_PERIOD_MS),
+                       (unsigned long) stats.bytes, (unsigned long) echo_stats.dropped_bytes,
+                       (unsigned long) stats.back_pressure, (unsigned long) stats.discarded);
+    if (len > 0) {
+      cdc_stream_write(&telemetry_producer, line, TU_MIN((size_t) len, sizeof(line) - 1));
+    }
   }
-  tud_cdc_n_write_flush(itf);
 }
 
 //--------------------------------------------------------------------+
 // USB CDC
 //--------------------------------------------------------------------+
+
+// echo to Serial1 as all upper case
+static void echo_serial_port(uint8_t const buf[], uint32_t count)
+{
+  uint8_t out[64];
+
+  for(uint32_t i=0; i<count; i++)
+  {
+    out[i] = toupper(buf[i]);
+  }
+
+  cdc_stream_write(&echo_producer, out, count);
+}
+
 static void cdc_task(void)
 {
   uint8_t itf;
+  bool idle = true;
 
   for (itf = 0; itf < CFG_TUD_CDC; itf++)
   {
@@ -73,12 +139,17 @@ static void cdc_task(void)
 
         uint32_t count = tud_cdc_n_read(itf, buf, sizeof(buf));
 
-        // echo back to both serial ports
-        echo_serial_port(0, buf, count);
-        echo_serial_port(1, buf, count);
+        // echo back to the data port
+        echo_serial_port(buf, count);
+        idle = false;
       }
     }
   }
+
+  if (idle)
+  {
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
 }
 
 static void cdc_task_wrapper(void *arg) {
@@ -89,6 +160,25 @@ static void cdc_task_wrapper(void *arg) {
 
 void create_tinyusb_demo(rtos_gpio_t *ctx, unsigned priority)
 {
+    cdc_stream_init(&telemetry_stream, 0, stream_wake, NULL);
+    cdc_stream_producer_add(&telemetry_stream, &telemetry_producer, telemetry_ring, sizeof(telemetry_ring));
+    cdc_stream_init(&data_stream, 1, stream_wake, NULL);
+    cdc_stream_producer_add(&data_stream, &echo_producer, echo_ring, sizeof(echo_ring));
+
+    xTaskCreate((TaskFunction_t) stream_task,
+                "cdc_stream",
+                portTASK_STACK_DEPTH(stream_task),
+                NULL,
+                priority + 1,
+                &stream_task_handle);
+
+    xTaskCreate((TaskFunction_t) telemetry_task,
+                "telemetry",
+                portTASK_STACK_DEPTH(telemetry_task),
+                NULL,
+                priority,
+                NULL);
+
     xTaskCreate((TaskFunction_t) cdc_task_wrapper,
                 "cdc_task",
                 portTASK_STACK_DEPTH(cdc_task_wrapper),
@@ -28,16 +28,24 @@
 #include <string.h>
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "rtos_gpio.h"
 #include "demo_main.h"
 #include "tusb.h"
 
+#include "dfu_image_stream.h"
+#include "flash_boot_image.h"
+
 /*
  * After device is enumerated in dfu mode run the following commands
  *
- * To transfer firmware from host to device (best to test with text file)
+ * To write an upgrade image to flash, streaming it in as it is downloaded
+ *
+ * $ xflash --factory-version 15.1 --upgrade 1 [filename.xe] -o upgrade.bin
+ * $ dfu-util -d cafe -a 0 -D upgrade.bin
+ *
+ * To transfer data from host to device and print it (best to test with text file)
  *
- * $ dfu-util -d cafe -a 0 -D [filename]
  * $ dfu-util -d cafe -a 1 -D [filename]
  *
  * To transfer firmware from device to host:
@@ -73,6 +81,191 @@ static rtos_gpio_port_id_t led_port = 0;
 static uint32_t led_val = 0;
 static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 
+//--------------------------------------------------------------------+
+// Upgrade image streaming
+//--------------------------------------------------------------------+
+
+#define FLASH_PAGE_SIZE     (4096)
+#define FLASH_PAGE_COUNT    (32768)
+
+/* Notifications to the flash task */
+#define FLASH_EVT_BLOCK     0x01
+#define FLASH_EVT_MANIFEST  0x02
+
+static boot_image_manager_ctx_t bim_ctx;
+static dfu_image_stream_t image_stream;
+static int image_stream_enabled = 0;
+static TaskHandle_t flash_task_handle = NULL;
+
+/* The block the stream had no buffer for, retried by the flash task */
+static const uint8_t *pending_data = NULL;
+static uint16_t pending_len = 0;
+static uint32_t pending_offset = 0;
+
+static uint32_t dn_offset = 0;
+static TickType_t dn_start_ticks = 0;
+static uint32_t sector_ms = 1;
+
+size_t dfu_image_stream_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_read((rtos_qspi_flash_t *) app_data, buf, addr, len);
+    return len;
+}
+
+size_t dfu_image_stream_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_write((rtos_qspi_flash_t *) app_data, (uint8_t *) buf, addr, len);
+    return len;
+}
+
+void dfu_image_stream_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    rtos_qspi_flash_erase((rtos_qspi_flash_t *) app_data, addr, len);
+}
+
+static uint8_t image_stream_status(int ret)
+{
+    switch (ret) {
+    case DFU_IMAGE_STREAM_OK:
+        return DFU_STATUS_OK;
+    case DFU_IMAGE_STREAM_ERR_HEADER:
+        return DFU_STATUS_ERR_FILE;
+    case DFU_IMAGE_STREAM_ERR_VERIFY:
+        return DFU_STATUS_ERR_VERIFY;
+    case DFU_IMAGE_STREAM_ERR_INCOMPLETE:
+        return DFU_STATUS_ERR_NOTDONE;
+    default:
+        return DFU_STATUS_ERR_ADDRESS;
+    }
+}
+
+/*
+ * Writes a downloaded block into the stream. The block is completed at
+ * once if there is a free sector buffer for it, otherwise the flash task
+ * completes it once it has programmed a sector. The host does not send
+ * the next block, so the data stays in TinyUSB's buffer, until then.
+ */
+static void image_stream_block(const uint8_t *data, uint16_t length)
+{
+    const uint32_t offset = dn_offset;
+    int ret;
+
+    dn_offset += length;
+    ret = dfu_image_stream_write(&image_stream, offset, data, length);
+
+    if (ret == DFU_IMAGE_STREAM_WAIT) {
+        pending_data = data;
+        pending_len = length;
+        pending_offset = offset;
+        xTaskNotify(flash_task_handle, FLASH_EVT_BLOCK, eSetBits);
+        return;
+    }
+
+    if (ret < 0) {
+        rtos_printf("Image rejected at offset %u (%d)\r\n", offset, ret);
+    } else if (dfu_image_stream_queued(&image_stream) > 0) {
+        xTaskNotify(flash_task_handle, FLASH_EVT_BLOCK, eSetBits);
+    }
+    tud_dfu_finish_flashing(image_stream_status(ret));
+}
+
+static void image_stream_report(int ret)
+{
+    dfu_image_stream_stats_t stats;
+    const uint32_t ms = (xTaskGetTickCount() - dn_start_ticks) * portTICK_PERIOD_MS;
+
+    dfu_image_stream_stats_get(&image_stream, &stats);
+    if (ret != DFU_IMAGE_STREAM_OK) {
+        rtos_printf("Upgrade image failed (%d) after %u bytes\r\n", ret, stats.received);
+        return;
+    }
+
+    rtos_printf("Upgrade image version %u, %u bytes, crc 0x%08x in %u ms (%u KB/s)\r\n",
+                stats.image_version, stats.image_size, stats.image_crc,
+                ms, ms ? stats.image_size / ms : 0);
+    rtos_printf("Sectors programmed %u, already in flash %u, verify failures %u\r\n",
+                stats.programmed, stats.skipped, stats.verify_failures);
+}
+
+/*
+ * Programs full sector buffers while the USB side fills the next, and
+ * completes the image when the host ends the download.
+ */
+static void flash_task(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        uint32_t events;
+        int ret;
+
+        xTaskNotifyWait(0x00000000UL, 0xFFFFFFFFUL, &events, portMAX_DELAY);
+
+        for (;;) {
+            const TickType_t t0 = xTaskGetTickCount();
+
+            ret = dfu_image_stream_program(&image_stream);
+            if (ret > 0) {
+                sector_ms = (xTaskGetTickCount() - t0) * portTICK_PERIOD_MS + 1;
+            }
+
+            /* A block only waits while a sector is queued, so this cannot spin */
+            if (pending_data != NULL) {
+                const int wret = dfu_image_stream_write(&image_stream, pending_offset, pending_data, pending_len);
+
+                if (wret != DFU_IMAGE_STREAM_WAIT) {
+                    pending_data = NULL;
+                    tud_dfu_finish_flashing(image_stream_status(wret));
+                }
+            }
+
+            if (ret == 0 && pending_data == NULL) {
+                break;
+            }
+        }
+
+        if (events & FLASH_EVT_MANIFEST) {
+            ret = dfu_image_stream_finish(&image_stream);
+            image_stream_report(ret);
+            tud_dfu_finish_flashing(image_stream_status(ret));
+        }
+    }
+}
+
+static void image_stream_init(rtos_qspi_flash_t *qspi_ctx, unsigned priority)
+{
+    uint32_t addr = 0;
+    size_t bytes_avail = 0;
+    uint32_t journal_addr;
+
+    boot_image_manager_init(&bim_ctx, FLASH_PAGE_SIZE, FLASH_PAGE_COUNT, qspi_ctx);
+    if (boot_image_build_table(&bim_ctx) == 0 ||
+        bim_ctx.boot_partition_size == 0 ||
+        bim_ctx.boot_partition_size == 0xFFFFFFFF ||
+        boot_image_locate_available_spot(&bim_ctx, &addr, &bytes_avail) != 1) {
+        rtos_printf("No boot partition, upgrade images are disabled\r\n");
+        return;
+    }
+
+    /* The last sector of the boot partition holds the journal */
+    journal_addr = bim_ctx.boot_partition_size - DFU_IMAGE_STREAM_SECTOR_SIZE;
+    if (addr >= journal_addr) {
+        rtos_printf("No space for an upgrade image\r\n");
+        return;
+    }
+
+    rtos_printf("Upgrade image at 0x%x, up to %u bytes\r\n", addr, journal_addr - addr);
+    dfu_image_stream_init(&image_stream, addr, journal_addr - addr, journal_addr, qspi_ctx);
+    image_stream_enabled = 1;
+
+    xTaskCreate((TaskFunction_t) flash_task,
+                "dfu_flash",
+                portTASK_STACK_DEPTH(flash_task),
+                NULL,
+                priority,
+                &flash_task_handle);
+}
+
 //--------------------------------------------------------------------+
 // Device callbacks
 //--------------------------------------------------------------------+
@@ -117,14 +310,18 @@ uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state)
   if ( state == DFU_DNBUSY )
   {
     // For this example
-    // - Atl0 Flash is fast : 1   ms
+    // - Alt0 Flash takes a block at once while a sector buffer is free,
+    //   otherwise once the sector being programmed is done
     // - Alt1 EEPROM is slow: 100 ms
-    return (alt == 0) ? 1 : 100;
+    if (alt == 0) {
+      return dfu_image_stream_ready(&image_stream) ? 0 : sector_ms;
+    }
+    return 100;
   }
   else if (state == DFU_MANIFEST)
   {
-    // since we don't buffer entire image and do any flashing in manifest stage
-    return 0;
+    // Alt0 programs the sectors still waiting and then the first sector
+    return (alt == 0) ? sector_ms * (dfu_image_stream_queued(&image_stream) + 1) : 0;
   }
 
   return 0;
@@ -135,7 +332,22 @@ uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state)
 // Once finished flashing, application must call tud_dfu_finish_flashing()
 void tud_dfu_download_cb(uint8_t alt, uint16_t block_num, uint8_t const* data, uint16_t length)
 {
-  (void) alt;
+  if (alt == 0)
+  {
+    if (!image_stream_enabled)
+    {
+      tud_dfu_finish_flashing(DFU_STATUS_ERR_ADDRESS);
+      return;
+    }
+    if (block_num == 0)
+    {
+      dn_offset = 0;
+      dn_start_ticks = xTaskGetTickCount();
+    }
+    image_stream_block(data, length);
+    return;
+  }
+
   (void) block_num;
 
   //printf("\r\nReceived Alt %u BlockNum %u of length %u\r\n", alt, wBlockNum, length);
@@ -154,9 +366,15 @@ void tud_dfu_download_cb(uint8_t alt, uint16_t block_num, uint8_t const* data, u
 // Once finished flashing, application must call tud_dfu_finish_flashing()
 void tud_dfu_manifest_cb(uint8_t alt)
 {
-  (void) alt;
   rtos_printf("Download completed, enter manifestation\r\n");
 
+  if (alt == 0 && image_stream_enabled)
+  {
+    // The flash task completes the image and then finishes the manifestation
+    xTaskNotify(flash_task_handle, FLASH_EVT_MANIFEST, eSetBits);
+    return;
+  }
+
   // flashing op for manifest is complete without error
   // Application can perform checksum, should it fail, use appropriate status such as errVERIFY.
   tud_dfu_finish_flashing(DFU_STATUS_OK);
@@ -177,6 +395,7 @@ uint16_t tud_dfu_upload_cb(uint8_t alt, uint16_t block_num, uint8_t* data, uint1
 }
 
 // Invoked when the Host has terminated a download or upload transfer
+// A download to alt 0 that is started again resumes from the last sector in flash
 void tud_dfu_abort_cb(uint8_t alt)
 {
   (void) alt;
@@ -207,6 +426,10 @@ void led_blinky_cb(TimerHandle_t xTimer)
 
 void create_tinyusb_demo(demo_args_t *ctx, unsigned priority)
 {
+    if (flash_task_handle == NULL) {
+        image_stream_init(ctx->qspi_ctx, priority);
+    }
+
     if (gpio_ctx == NULL) {
         gpio_ctx = ctx->gpio_ctx;
 
@@ -0,0 +1,406 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "boot_image_crc.h"
+#include "compiler_barrier.h"
+#include "dfu_image_stream.h"
+
+#define NIBBLE_SWAP_INT(X) ((((X) & 0x0f0f0f0f) << 4) | (((X) & 0xf0f0f0f0) >> 4))
+
+/* Upgrade image header, as found by the boot image manager */
+#define IMAGETAG_13             0x0FF51DE
+#define IMAGE_PAGE_SIZE         64
+#define IMAGETAG_OFFSET         0
+#define PAGE_CRC_OFFSET         1
+#define CRC_START_OFFSET_13     3
+#define IMAGESIZE_OFFSET_13     4
+#define IMAGEVERSION_OFFSET_13  5
+
+#define JOURNAL_MAGIC           0x4A554644  /* "DFUJ" */
+#define JOURNAL_WORDS           5
+
+#define SECTOR_SIZE             DFU_IMAGE_STREAM_SECTOR_SIZE
+#define SECTOR_ADDR(c, s)       ((c)->base_addr + ((s) * SECTOR_SIZE))
+#define SECTOR_BUF(c, s)        (((s) == 0) ? (c)->first : (c)->buf[((s) - 1) % DFU_IMAGE_STREAM_BUFFERS])
+#define JOURNAL_ENTRY_ADDR(c, s) ((c)->journal_addr + DFU_IMAGE_STREAM_JOURNAL_HEADER + (((s) - 1) * 8))
+
+uint32_t dfu_image_stream_crc(uint32_t crc, const uint32_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        crc = boot_image_crc_word(crc, words[i]);
+    }
+    return crc;
+}
+
+int dfu_image_stream_header_check(const uint32_t *page, uint32_t *size, uint32_t *version)
+{
+    uint32_t crc = BOOT_IMAGE_CRC_INIT;
+
+    if (NIBBLE_SWAP_INT(page[IMAGETAG_OFFSET]) != IMAGETAG_13) {
+        return 0;
+    }
+
+    for (int i = CRC_START_OFFSET_13; i < IMAGE_PAGE_SIZE; i++) {
+        crc = boot_image_crc_word(crc, NIBBLE_SWAP_INT(page[i]));
+    }
+    crc = boot_image_crc_word(crc, NIBBLE_SWAP_INT(page[PAGE_CRC_OFFSET]));
+
+    if (~crc != 0) {
+        return 0;
+    }
+
+    *size = NIBBLE_SWAP_INT(page[IMAGESIZE_OFFSET_13]);
+    *version = NIBBLE_SWAP_INT(page[IMAGEVERSION_OFFSET_13]);
+    return 1;
+}
+
+void dfu_image_stream_init(dfu_image_stream_t *ctx, uint32_t base_addr, uint32_t max_size, uint32_t journal_addr, void *app_data)
+{
+    memset(ctx, 0, sizeof(dfu_image_stream_t));
+    ctx->app_data = app_data;
+    ctx->base_addr = base_addr;
+    ctx->max_size = max_size;
+    ctx->journal_addr = journal_addr;
+}
+
+static int stream_idle(dfu_image_stream_t *ctx)
+{
+    for (int i = 0; i < DFU_IMAGE_STREAM_BUFFERS; i++) {
+        if (ctx->queued[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void stream_reset(dfu_image_stream_t *ctx)
+{
+    ctx->received = 0;
+    ctx->image_size = 0;
+    ctx->image_version = 0;
+    ctx->page_crc = 0;
+    ctx->image_crc = BOOT_IMAGE_CRC_INIT;
+    ctx->fill_crc = BOOT_IMAGE_CRC_INIT;
+    ctx->crc_pos = 0;
+    ctx->header_valid = 0;
+    ctx->setup_pending = 0;
+    ctx->error = 0;
+    ctx->next = 0;
+    ctx->resume = 0;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+}
+
+/* Accumulates the CRC of the whole words of the current sector up to end */
+static void crc_advance(dfu_image_stream_t *ctx, const uint8_t *sector, uint32_t end)
+{
+    const uint32_t *w = (const uint32_t *) sector;
+
+    for (uint32_t i = ctx->crc_pos / sizeof(uint32_t); i < end / sizeof(uint32_t); i++) {
+        ctx->fill_crc = boot_image_crc_word(ctx->fill_crc, w[i]);
+        ctx->image_crc = boot_image_crc_word(ctx->image_crc, w[i]);
+    }
+    ctx->crc_pos = end & ~(sizeof(uint32_t) - 1);
+}
+
+static void sector_complete(dfu_image_stream_t *ctx, uint32_t sector)
+{
+    if (sector == 0) {
+        ctx->first_crc = ctx->fill_crc;
+    } else {
+        const unsigned b = (sector - 1) % DFU_IMAGE_STREAM_BUFFERS;
+
+        ctx->sector[b] = sector;
+        ctx->crc[b] = ctx->fill_crc;
+
+        /* The buffer must be full before the flag hands it to the flash side */
+        COMPILER_BARRIER();
+        ctx->queued[b] = 1;
+    }
+    ctx->fill_crc = BOOT_IMAGE_CRC_INIT;
+    ctx->crc_pos = 0;
+}
+
+int dfu_image_stream_ready(dfu_image_stream_t *ctx)
+{
+    const uint32_t sector = ctx->received / SECTOR_SIZE;
+
+    if (ctx->error || sector == 0 || (ctx->received % SECTOR_SIZE) != 0) {
+        return 1;
+    }
+    return !ctx->queued[(sector - 1) % DFU_IMAGE_STREAM_BUFFERS];
+}
+
+int dfu_image_stream_write(dfu_image_stream_t *ctx, uint32_t offset, const uint8_t *data, size_t len)
+{
+    if (offset == 0) {
+        if (!stream_idle(ctx)) {
+            return DFU_IMAGE_STREAM_WAIT;
+        }
+        stream_reset(ctx);
+    }
+
+    if (ctx->error) {
+        return ctx->error;
+    }
+    if (offset != ctx->received) {
+        return DFU_IMAGE_STREAM_ERR_ORDER;
+    }
+    if (len > SECTOR_SIZE || (ctx->header_valid && ctx->received + len > ctx->image_size)) {
+        ctx->error = DFU_IMAGE_STREAM_ERR_SIZE;
+        return ctx->error;
+    }
+
+    /* Every sector buffer this data will start must be free before any of it is taken */
+    for (uint32_t pos = ctx->received; pos < ctx->received + len; pos = (pos / SECTOR_SIZE + 1) * SECTOR_SIZE) {
+        const uint32_t sector = pos / SECTOR_SIZE;
+
+        if (sector > 0 && (pos % SECTOR_SIZE) == 0 && ctx->queued[(sector - 1) % DFU_IMAGE_STREAM_BUFFERS]) {
+            return DFU_IMAGE_STREAM_WAIT;
+        }
+    }
+
+    while (len > 0) {
+        const uint32_t sector = ctx->received / SECTOR_SIZE;
+        const uint32_t pos = ctx->received % SECTOR_SIZE;
+        uint8_t *dst = SECTOR_BUF(ctx, sector);
+        size_t n = SECTOR_SIZE - pos;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(&dst[pos], data, n);
+        crc_advance(ctx, dst, pos + n);
+        ctx->received += n;
+
+        if (!ctx->header_valid && ctx->received >= IMAGE_PAGE_SIZE * sizeof(uint32_t)) {
+            const uint32_t *page = (const uint32_t *) ctx->first;
+
+            if (!dfu_image_stream_header_check(page, &ctx->image_size, &ctx->image_version)) {
+                ctx->error = DFU_IMAGE_STREAM_ERR_HEADER;
+                return ctx->error;
+            }
+            if (ctx->image_size > ctx->max_size || ctx->received > ctx->image_size) {
+                ctx->error = DFU_IMAGE_STREAM_ERR_SIZE;
+                return ctx->error;
+            }
+            ctx->page_crc = page[PAGE_CRC_OFFSET];
+            ctx->header_valid = 1;
+            ctx->stats.image_size = ctx->image_size;
+            ctx->stats.image_version = ctx->image_version;
+
+            /*
+             * The flash side prepares the journal before it programs the
+             * first sector, so the header fields must be set before the flag
+             */
+            COMPILER_BARRIER();
+            ctx->setup_pending = 1;
+        }
+
+        if (pos + n == SECTOR_SIZE) {
+            sector_complete(ctx, sector);
+        }
+
+        data += n;
+        len -= n;
+    }
+
+    return DFU_IMAGE_STREAM_OK;
+}
+
+/*
+ * Resumes the interrupted download recorded in the journal if it was of
+ * the same image to the same address. Otherwise starts a new journal,
+ * after erasing the header of whatever image was there before.
+ */
+static void stream_setup(dfu_image_stream_t *ctx)
+{
+    uint32_t *journal = (uint32_t *) ctx->verify;
+
+    dfu_image_stream_flash_read(ctx->app_data, ctx->journal_addr, ctx->verify, JOURNAL_WORDS * sizeof(uint32_t));
+
+    if (journal[0] == JOURNAL_MAGIC &&
+        journal[1] == ctx->base_addr &&
+        journal[2] == ctx->image_size &&
+        journal[3] == ctx->image_version &&
+        journal[4] == ctx->page_crc) {
+        ctx->resume = 1;
+        ctx->stats.resumed = 1;
+    } else {
+        dfu_image_stream_flash_erase(ctx->app_data, ctx->base_addr, SECTOR_SIZE);
+        dfu_image_stream_flash_erase(ctx->app_data, ctx->journal_addr, SECTOR_SIZE);
+
+        journal[0] = JOURNAL_MAGIC;
+        journal[1] = ctx->base_addr;
+        journal[2] = ctx->image_size;
+        journal[3] = ctx->image_version;
+        journal[4] = ctx->page_crc;
+        dfu_image_stream_flash_write(ctx->app_data, ctx->journal_addr, ctx->verify, JOURNAL_WORDS * sizeof(uint32_t));
+        ctx->resume = 0;
+    }
+    ctx->setup_pending = 0;
+}
+
+/* Continues crc over a sector of flash */
+static uint32_t flash_crc(dfu_image_stream_t *ctx, uint32_t crc, uint32_t addr)
+{
+    for (uint32_t done = 0; done < SECTOR_SIZE; done += DFU_IMAGE_STREAM_VERIFY_SIZE) {
+        dfu_image_stream_flash_read(ctx->app_data, addr + done, ctx->verify, DFU_IMAGE_STREAM_VERIFY_SIZE);
+        crc = dfu_image_stream_crc(crc, (const uint32_t *) ctx->verify, DFU_IMAGE_STREAM_VERIFY_SIZE / sizeof(uint32_t));
+    }
+    return crc;
+}
+
+/*
+ * Erases, programs and verifies a sector, unless the journal shows that it
+ * already holds the same data. Sector 0 is never journaled.
+ */
+static int sector_store(dfu_image_stream_t *ctx, uint32_t sector, const uint8_t *data, uint32_t crc)
+{
+    const uint32_t addr = SECTOR_ADDR(ctx, sector);
+    int journaled = sector > 0 && sector <= DFU_IMAGE_STREAM_JOURNAL_ENTRIES;
+    uint32_t entry[2];
+
+    if (journaled) {
+        dfu_image_stream_flash_read(ctx->app_data, JOURNAL_ENTRY_ADDR(ctx, sector), (uint8_t *) entry, sizeof(entry));
+
+        if (entry[0] == 0xFFFFFFFF && entry[1] == 0xFFFFFFFF) {
+            /* Not yet written */
+        } else if (ctx->resume && entry[1] == ~entry[0] && entry[0] == crc) {
+            ctx->stats.skipped++;
+            return 0;
+        } else {
+            /*
+             * The entry is for other data, so must not outlive the sector's
+             * old contents. Zero is never a valid entry, and needs no erase.
+             */
+            entry[0] = 0;
+            entry[1] = 0;
+            dfu_image_stream_flash_write(ctx->app_data, JOURNAL_ENTRY_ADDR(ctx, sector), (const uint8_t *) entry, sizeof(entry));
+            journaled = 0;
+        }
+    }
+
+    dfu_image_stream_flash_erase(ctx->app_data, addr, SECTOR_SIZE);
+    dfu_image_stream_flash_write(ctx->app_data, addr, data, SECTOR_SIZE);
+
+    if (flash_crc(ctx, BOOT_IMAGE_CRC_INIT, addr) != crc) {
+        ctx->stats.verify_failures++;
+        ctx->error = DFU_IMAGE_STREAM_ERR_VERIFY;
+        return ctx->error;
+    }
+    ctx->stats.programmed++;
+
+    if (journaled) {
+        entry[0] = crc;
+        entry[1] = ~crc;
+        dfu_image_stream_flash_write(ctx->app_data, JOURNAL_ENTRY_ADDR(ctx, sector), (const uint8_t *) entry, sizeof(entry));
+    }
+
+    return 0;
+}
+
+int dfu_image_stream_program(dfu_image_stream_t *ctx)
+{
+    const unsigned b = ctx->next;
+    int ret = 0;
+
+    if (!ctx->queued[b]) {
+        return 0;
+    }
+
+    /* The flag was read before the buffer it hands over */
+    COMPILER_BARRIER();
+
+    /* After an error the rest of the image is dropped */
+    if (!ctx->error) {
+        if (ctx->setup_pending) {
+            stream_setup(ctx);
+        }
+        ret = sector_store(ctx, ctx->sector[b], ctx->buf[b], ctx->crc[b]);
+    }
+
+    /* The buffer must be programmed before the flag frees it */
+    COMPILER_BARRIER();
+    ctx->queued[b] = 0;
+    ctx->next = (b + 1) % DFU_IMAGE_STREAM_BUFFERS;
+
+    return (ret < 0) ? ret : 1;
+}
+
+int dfu_image_stream_finish(dfu_image_stream_t *ctx)
+{
+    const uint32_t last = ctx->received / SECTOR_SIZE;
+    const uint32_t pos = ctx->received % SECTOR_SIZE;
+    uint32_t crc;
+    int ret;
+
+    if (ctx->error) {
+        return ctx->error;
+    }
+    if (!ctx->header_valid || ctx->received != ctx->image_size) {
+        return DFU_IMAGE_STREAM_ERR_INCOMPLETE;
+    }
+
+    /* The last sector is padded as erased flash would be */
+    if (pos != 0) {
+        uint8_t *dst = SECTOR_BUF(ctx, last);
+
+        memset(&dst[pos], 0xFF, SECTOR_SIZE - pos);
+        crc_advance(ctx, dst, SECTOR_SIZE);
+        sector_complete(ctx, last);
+    }
+
+    while ((ret = dfu_image_stream_program(ctx)) > 0) {
+        ;
+    }
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (ctx->setup_pending) {
+        stream_setup(ctx);
+    }
+
+    /*
+     * The image as it was received, and then as it reads back from flash.
+     * This also covers the sectors a resumed download skipped.
+     */
+    crc = dfu_image_stream_crc(BOOT_IMAGE_CRC_INIT, (const uint32_t *) ctx->first, SECTOR_SIZE / sizeof(uint32_t));
+    for (uint32_t sector = 1; sector < (ctx->image_size + SECTOR_SIZE - 1) / SECTOR_SIZE; sector++) {
+        crc = flash_crc(ctx, crc, SECTOR_ADDR(ctx, sector));
+    }
+    if (crc != ctx->image_crc) {
+        ctx->error = DFU_IMAGE_STREAM_ERR_VERIFY;
+        return ctx->error;
+    }
+
+    /* The header goes in last, once the rest of the image is known to be good */
+    ret = sector_store(ctx, 0, ctx->first, ctx->first_crc);
+    if (ret < 0) {
+        return ret;
+    }
+
+    dfu_image_stream_flash_erase(ctx->app_data, ctx->journal_addr, SECTOR_SIZE);
+    ctx->stats.image_crc = ctx->image_crc;
+
+    return DFU_IMAGE_STREAM_OK;
+}
+
+int dfu_image_stream_queued(dfu_image_stream_t *ctx)
+{
+    int queued = 0;
+
+    for (int i = 0; i < DFU_IMAGE_STREAM_BUFFERS; i++) {
+        queued += ctx->queued[i] ? 1 : 0;
+    }
+    return queued;
+}
+
+void dfu_image_stream_stats_get(dfu_image_stream_t *ctx, dfu_image_stream_stats_t *stats)
+{
+    *stats = ctx->stats;
+    stats->received = ctx->received;
+}
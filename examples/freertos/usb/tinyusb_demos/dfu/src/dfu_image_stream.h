@@ -0,0 +1,271 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef DFU_IMAGE_STREAM_H_
+#define DFU_IMAGE_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef DFU_IMAGE_STREAM_SECTOR_SIZE
+#define DFU_IMAGE_STREAM_SECTOR_SIZE    4096
+#endif
+
+/* Sector buffers shared between the USB and flash sides */
+#ifndef DFU_IMAGE_STREAM_BUFFERS
+#define DFU_IMAGE_STREAM_BUFFERS        2
+#endif
+
+/* Size of the buffer used to read sectors back for verification */
+#ifndef DFU_IMAGE_STREAM_VERIFY_SIZE
+#define DFU_IMAGE_STREAM_VERIFY_SIZE    256
+#endif
+
+#define DFU_IMAGE_STREAM_JOURNAL_HEADER 32
+#define DFU_IMAGE_STREAM_JOURNAL_ENTRIES ((DFU_IMAGE_STREAM_SECTOR_SIZE - DFU_IMAGE_STREAM_JOURNAL_HEADER) / 8)
+
+/** \name Return codes
+ * @{
+ */
+#define DFU_IMAGE_STREAM_OK             0   /**< Done. */
+#define DFU_IMAGE_STREAM_WAIT           1   /**< No free sector buffer, retry once a sector has been programmed. */
+#define DFU_IMAGE_STREAM_ERR_ORDER     -1   /**< Data did not follow on from the previous write. */
+#define DFU_IMAGE_STREAM_ERR_HEADER    -2   /**< The image header is not valid. */
+#define DFU_IMAGE_STREAM_ERR_SIZE      -3   /**< The image is larger than its header says, or than the space for it. */
+#define DFU_IMAGE_STREAM_ERR_VERIFY    -4   /**< A sector, or the whole image, did not read back as received. */
+#define DFU_IMAGE_STREAM_ERR_INCOMPLETE -5  /**< The image is shorter than its header says. */
+/**@}*/
+
+/**
+ * \defgroup dfu_image_stream
+ *
+ * The public API for streaming a boot image into flash as it is downloaded.
+ *
+ * The image header is checked as soon as its first page arrives, so a
+ * download of something that is not a boot image fails on its first
+ * block rather than after it has been written. The CRC of each sector is
+ * computed with the crc32 instruction as its data arrives, and the sector
+ * is verified against it by reading it back once it is programmed.
+ *
+ * Data is copied into one of DFU_IMAGE_STREAM_BUFFERS sector buffers as
+ * it arrives, and a full buffer is handed to the flash side, which erases,
+ * programs and verifies it while the next one fills. The USB side calls
+ * dfu_image_stream_write() and the flash side, normally a separate task,
+ * calls dfu_image_stream_program() and dfu_image_stream_finish().
+ *
+ * The first sector, which holds the image header, is kept in RAM and
+ * programmed last, once the CRC of the whole image read back from flash
+ * matches the CRC of the image as it arrived, so that an interrupted or
+ * corrupt download never leaves a valid header in front of a bad image.
+ *
+ * Each verified sector is recorded, with its CRC, in a journal sector.
+ * When a download of the same image to the same address starts again
+ * after an interruption, sectors that the journal shows are already in
+ * flash with the same CRC are not programmed again, so the download
+ * resumes from the last verified sector at the speed of USB alone. The
+ * journal is erased once the image is complete.
+ * @{
+ */
+
+/** Stream statistics. */
+typedef struct {
+    uint32_t image_size;        /**< The image size from its header. */
+    uint32_t image_version;     /**< The image version from its header. */
+    uint32_t image_crc;         /**< The CRC of the sectors the image occupies, padded with 0xFF. */
+    uint32_t received;          /**< Bytes received. */
+    uint32_t programmed;        /**< Sectors erased, programmed and verified. */
+    uint32_t skipped;           /**< Sectors already in flash from an interrupted download. */
+    uint32_t verify_failures;   /**< Sectors that did not read back as written. */
+    uint32_t resumed;           /**< 1 if the download resumed an interrupted one. */
+} dfu_image_stream_stats_t;
+
+/**
+ * Typedef to the image stream instance struct.
+ */
+typedef struct dfu_image_stream_struct dfu_image_stream_t;
+
+/**
+ * Struct representing an image stream instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct dfu_image_stream_struct {
+    /**
+     * A pointer to application specific data. Passed to the flash access
+     * functions.
+     */
+    void *app_data;
+
+    uint32_t base_addr;
+    uint32_t max_size;
+    uint32_t journal_addr;
+
+    /* Written by the USB side */
+    uint32_t received;
+    uint32_t image_size;
+    uint32_t image_version;
+    uint32_t page_crc;
+    uint32_t image_crc;
+    uint32_t fill_crc;
+    uint32_t crc_pos;
+    uint32_t first_crc;
+    int header_valid;
+    volatile int setup_pending;
+
+    /* Written by the flash side */
+    volatile int error;
+    unsigned next;
+    int resume;
+
+    /* Handed from the USB side to the flash side */
+    volatile int queued[DFU_IMAGE_STREAM_BUFFERS];
+    uint32_t sector[DFU_IMAGE_STREAM_BUFFERS];
+    uint32_t crc[DFU_IMAGE_STREAM_BUFFERS];
+
+    dfu_image_stream_stats_t stats;
+
+    uint8_t first[DFU_IMAGE_STREAM_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint8_t buf[DFU_IMAGE_STREAM_BUFFERS][DFU_IMAGE_STREAM_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint8_t verify[DFU_IMAGE_STREAM_VERIFY_SIZE] __attribute__((aligned(4)));
+};
+
+/**
+ * User defined flash read function
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to read from
+ * \param buf       A pointer to the buffer to read into
+ * \param len       The number of bytes to read
+ *
+ * \return number of bytes read
+ */
+size_t dfu_image_stream_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len);
+
+/**
+ * User defined flash program function. The region has been erased.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to program
+ * \param buf       A pointer to the buffer to write from
+ * \param len       The number of bytes to write
+ *
+ * \return number of bytes written
+ */
+size_t dfu_image_stream_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len);
+
+/**
+ * User defined flash erase function.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The sector aligned flash address to erase
+ * \param len       The number of bytes to erase, a multiple of the sector size
+ */
+void dfu_image_stream_flash_erase(void *app_data, unsigned addr, size_t len);
+
+/**
+ * Accumulates the CRC of a run of words, as the crc32 instruction does
+ * with the polynomial 0xEDB88320.
+ *
+ * \param crc    The CRC so far
+ * \param words  A pointer to the words
+ * \param count  The number of words
+ *
+ * \return the updated CRC
+ */
+uint32_t dfu_image_stream_crc(uint32_t crc, const uint32_t *words, size_t count);
+
+/**
+ * Checks the header page of a boot image, as the boot image manager does
+ * when it finds an upgrade image in flash.
+ *
+ * \param page     A pointer to the first 64 words of the image
+ * \param size     Receives the image size
+ * \param version  Receives the image version
+ *
+ * \return 1 if the header is valid, 0 otherwise
+ */
+int dfu_image_stream_header_check(const uint32_t *page, uint32_t *size, uint32_t *version);
+
+/**
+ * Initializes an image stream.
+ *
+ * \param ctx           A pointer to the image stream instance
+ * \param base_addr     The sector aligned flash address to write the image to
+ * \param max_size      The space available for the image, in bytes
+ * \param journal_addr  The sector aligned flash address of the journal, which
+ *                      must not overlap the space for the image
+ * \param app_data      A pointer to the application specific data
+ */
+void dfu_image_stream_init(dfu_image_stream_t *ctx, uint32_t base_addr, uint32_t max_size, uint32_t journal_addr, void *app_data);
+
+/**
+ * Adds downloaded data to the image. Called by the USB side. A write to
+ * offset 0 starts a new download.
+ *
+ * \param ctx     A pointer to the image stream instance
+ * \param offset  The offset of the data in the image, which must follow on
+ *                from the previous write
+ * \param data    A pointer to the data
+ * \param len     The number of bytes, at most DFU_IMAGE_STREAM_SECTOR_SIZE
+ *
+ * \retval DFU_IMAGE_STREAM_OK    if the data was taken
+ * \retval DFU_IMAGE_STREAM_WAIT  if there is no free sector buffer. Retry
+ *                                once dfu_image_stream_program() has
+ *                                programmed a sector.
+ * \retval <0                     one of the error codes. The download must
+ *                                start again from offset 0.
+ */
+int dfu_image_stream_write(dfu_image_stream_t *ctx, uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * Checks whether dfu_image_stream_write() could take a block without
+ * waiting. Called by the USB side.
+ *
+ * \param ctx  A pointer to the image stream instance
+ *
+ * \return 1 if a sector buffer is free, 0 otherwise
+ */
+int dfu_image_stream_ready(dfu_image_stream_t *ctx);
+
+/**
+ * Programs the oldest full sector buffer, and frees it. Called by the
+ * flash side whenever a write has filled a buffer.
+ *
+ * \param ctx  A pointer to the image stream instance
+ *
+ * \return 1 if a sector was handled, 0 if there was none waiting, or
+ *         DFU_IMAGE_STREAM_ERR_VERIFY
+ */
+int dfu_image_stream_program(dfu_image_stream_t *ctx);
+
+/**
+ * Completes the image once the download has ended. Called by the flash
+ * side. Programs the sectors still waiting, checks the CRC of the whole
+ * image read back from flash, then programs the first sector and erases
+ * the journal.
+ *
+ * \param ctx  A pointer to the image stream instance
+ *
+ * \return DFU_IMAGE_STREAM_OK if the image is complete and verified,
+ *         otherwise one of the error codes
+ */
+int dfu_image_stream_finish(dfu_image_stream_t *ctx);
+
+/**
+ * Gets the number of full sector buffers waiting to be programmed.
+ *
+ * \param ctx  A pointer to the image stream instance
+ */
+int dfu_image_stream_queued(dfu_image_stream_t *ctx);
+
+/**
+ * Gets the statistics of the current or last download.
+ *
+ * \param ctx    A pointer to the image stream instance
+ * \param stats  Receives the statistics
+ */
+void dfu_image_stream_stats_get(dfu_image_stream_t *ctx, dfu_image_stream_stats_t *stats);
+
+/**@}*/
+
+#endif /* DFU_IMAGE_STREAM_H_ */
@@ -75,7 +75,8 @@
 #define CFG_TUD_DFU    1
 
 // DFU buffer size, it has to be set to the buffer size used in TUD_DFU_DESCRIPTOR
-#define CFG_TUD_DFU_XFER_BUFSIZE    ( OPT_MODE_HIGH_SPEED ? 512 : 64 )
+// At high speed a block is a whole flash sector, so each one is a single request
+#define CFG_TUD_DFU_XFER_BUFSIZE    ( BOARD_DEVICE_RHPORT_SPEED == OPT_MODE_HIGH_SPEED ? 4096 : 64 )
 
 #ifdef __cplusplus
  }
@@ -0,0 +1,48 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BOOT_IMAGE_CRC_H_
+#define BOOT_IMAGE_CRC_H_
+
+#include <stdint.h>
+
+/**
+ * \defgroup boot_image_crc
+ *
+ * The CRC-32 used by boot image headers, computed a word at a time as the
+ * crc32 instruction does. The host builds use the same algorithm in C.
+ * @{
+ */
+
+#define BOOT_IMAGE_CRC_POLY     0xEDB88320  /**< The CRC polynomial, bit reversed. */
+#define BOOT_IMAGE_CRC_INIT     0xFFFFFFFF  /**< The initial CRC value. */
+
+/**
+ * Accumulates the CRC of one word.
+ *
+ * \param crc   The CRC so far
+ * \param data  The word to add
+ *
+ * \return the updated CRC
+ */
+static inline uint32_t boot_image_crc_word(uint32_t crc, uint32_t data)
+{
+#if defined(__xcore__)
+    asm volatile("crc32 %0, %2, %3" : "=r" (crc) : "0" (crc), "r" (data), "r" (BOOT_IMAGE_CRC_POLY));
+#else
+    /* The data is shifted in from the top as the CRC is shifted out */
+    for (int i = 0; i < 32; i++) {
+        const uint32_t lsb = crc & 1;
+        crc = (crc >> 1) | (data << 31);
+        data >>= 1;
+        if (lsb) {
+            crc ^= BOOT_IMAGE_CRC_POLY;
+        }
+    }
+#endif
+    return crc;
+}
+
+/**@}*/
+
+#endif /* BOOT_IMAGE_CRC_H_ */
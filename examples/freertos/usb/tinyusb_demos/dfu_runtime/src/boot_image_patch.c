@@ -0,0 +1,374 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "boot_image_crc.h"
+#include "boot_image_patch.h"
+
+#define SECTOR_SIZE             BOOT_IMAGE_PATCH_SECTOR_SIZE
+#define VERIFY_SIZE             BOOT_IMAGE_PATCH_VERIFY_SIZE
+#define HEADER_WORDS            (BOOT_IMAGE_PATCH_HEADER_SIZE / sizeof(uint32_t))
+#define SECTORS(b)              (((b) + SECTOR_SIZE - 1) / SECTOR_SIZE)
+
+uint32_t boot_image_patch_crc(uint32_t crc, const uint32_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        crc = boot_image_crc_word(crc, words[i]);
+    }
+    return crc;
+}
+
+/* The CRC of len bytes of flash, a whole number of words */
+static uint32_t flash_crc(boot_image_patch_t *ctx, uint32_t crc, uint32_t addr, uint32_t len)
+{
+    while (len > 0) {
+        const uint32_t n = (len < VERIFY_SIZE) ? len : VERIFY_SIZE;
+
+        boot_image_patch_flash_read(ctx->app_data, addr, ctx->verify, n);
+        crc = boot_image_patch_crc(crc, (const uint32_t *) ctx->verify, n / sizeof(uint32_t));
+        addr += n;
+        len -= n;
+    }
+    return crc;
+}
+
+int boot_image_patch_is_patch(const uint8_t *data, size_t len)
+{
+    uint32_t magic;
+
+    if (len < sizeof(magic)) {
+        return 0;
+    }
+    memcpy(&magic, data, sizeof(magic));
+    return magic == BOOT_IMAGE_PATCH_MAGIC;
+}
+
+void boot_image_patch_init(boot_image_patch_t *ctx, uint32_t dst_addr, uint32_t dst_size, void *app_data)
+{
+    memset(ctx, 0, sizeof(boot_image_patch_t));
+    ctx->app_data = app_data;
+    ctx->dst_addr = dst_addr;
+    ctx->dst_size = dst_size;
+}
+
+int boot_image_patch_source_add(boot_image_patch_t *ctx, uint32_t addr, uint32_t size)
+{
+    if (ctx->src_count == BOOT_IMAGE_PATCH_MAX_SOURCES) {
+        return BOOT_IMAGE_PATCH_ERR_SIZE;
+    }
+    ctx->src_addr[ctx->src_count] = addr;
+    ctx->src_size[ctx->src_count] = size;
+    ctx->src_count++;
+    return BOOT_IMAGE_PATCH_OK;
+}
+
+static int patch_fail(boot_image_patch_t *ctx, int err)
+{
+    ctx->error = err;
+    return err;
+}
+
+/*
+ * Finds the source image, and erases the first sector of the destination
+ * so that no image is seen there until the new one is complete.
+ */
+static int header_accept(boot_image_patch_t *ctx)
+{
+    boot_image_patch_header_t *h = &ctx->header;
+    uint32_t dst_end;
+
+    memcpy(h, ctx->hold, sizeof(boot_image_patch_header_t));
+
+    if (h->magic != BOOT_IMAGE_PATCH_MAGIC ||
+        ~boot_image_patch_crc(BOOT_IMAGE_CRC_INIT, (const uint32_t *) ctx->hold, HEADER_WORDS - 1) != h->header_crc ||
+        h->target_size == 0 ||
+        (h->source_size % sizeof(uint32_t)) != 0 ||
+        (h->target_size % sizeof(uint32_t)) != 0) {
+        return BOOT_IMAGE_PATCH_ERR_HEADER;
+    }
+    if (h->target_size > ctx->dst_size) {
+        return BOOT_IMAGE_PATCH_ERR_SIZE;
+    }
+
+    /* The sectors the new image will be written to, which no source may overlap */
+    dst_end = ctx->dst_addr + SECTORS(h->target_size) * SECTOR_SIZE;
+
+    for (int i = 0; i < ctx->src_count; i++) {
+        const uint32_t addr = ctx->src_addr[i];
+
+        if (ctx->src_size[i] < h->source_size ||
+            (addr < dst_end && ctx->dst_addr < addr + h->source_size)) {
+            continue;
+        }
+        if (~flash_crc(ctx, BOOT_IMAGE_CRC_INIT, addr, h->source_size) == h->source_crc) {
+            ctx->src_base = addr;
+            ctx->stats.source_addr = addr;
+            ctx->header_valid = 1;
+            break;
+        }
+    }
+    if (!ctx->header_valid) {
+        return BOOT_IMAGE_PATCH_ERR_SOURCE;
+    }
+
+    boot_image_patch_flash_erase(ctx->app_data, ctx->dst_addr, SECTOR_SIZE);
+    ctx->crc = BOOT_IMAGE_CRC_INIT;
+    return BOOT_IMAGE_PATCH_OK;
+}
+
+/*
+ * Adds a full sector of the new image to its CRC and, unless it is the
+ * first, programs it. Only the first len bytes are part of the image.
+ */
+static void sector_flush(boot_image_patch_t *ctx, uint32_t sector, uint32_t len)
+{
+    const uint8_t *buf = (sector == 0) ? ctx->first : ctx->sector;
+    const uint32_t addr = ctx->dst_addr + sector * SECTOR_SIZE;
+
+    ctx->crc = boot_image_patch_crc(ctx->crc, (const uint32_t *) buf, len / sizeof(uint32_t));
+
+    if (sector > 0) {
+        boot_image_patch_flash_erase(ctx->app_data, addr, SECTOR_SIZE);
+        boot_image_patch_flash_write(ctx->app_data, addr, buf, SECTOR_SIZE);
+        ctx->stats.sectors++;
+    }
+}
+
+/* Returns where the next byte of the new image goes, and the room left in its sector */
+static uint8_t *out_ptr(boot_image_patch_t *ctx, uint32_t *room)
+{
+    const uint32_t pos = ctx->produced % SECTOR_SIZE;
+    uint8_t *buf = (ctx->produced < SECTOR_SIZE) ? ctx->first : ctx->sector;
+
+    *room = SECTOR_SIZE - pos;
+    return &buf[pos];
+}
+
+static void out_advance(boot_image_patch_t *ctx, uint32_t n)
+{
+    ctx->produced += n;
+    if ((ctx->produced % SECTOR_SIZE) == 0) {
+        sector_flush(ctx, ctx->produced / SECTOR_SIZE - 1, SECTOR_SIZE);
+    }
+}
+
+static void op_copy(boot_image_patch_t *ctx)
+{
+    ctx->stats.copied += ctx->remaining;
+
+    while (ctx->remaining > 0) {
+        uint32_t n;
+        uint8_t *out = out_ptr(ctx, &n);
+
+        if (n > ctx->remaining) {
+            n = ctx->remaining;
+        }
+        boot_image_patch_flash_read(ctx->app_data, ctx->src_base + ctx->arg, out, n);
+        ctx->arg += n;
+        ctx->remaining -= n;
+        out_advance(ctx, n);
+    }
+}
+
+static void op_fill(boot_image_patch_t *ctx)
+{
+    ctx->stats.filled += ctx->remaining;
+
+    while (ctx->remaining > 0) {
+        uint32_t n;
+        uint8_t *out = out_ptr(ctx, &n);
+
+        if (n > ctx->remaining) {
+            n = ctx->remaining;
+        }
+        memset(out, (int) ctx->arg, n);
+        ctx->remaining -= n;
+        out_advance(ctx, n);
+    }
+}
+
+/* Takes up to len bytes of a DATA command, returning the number taken */
+static size_t op_data(boot_image_patch_t *ctx, const uint8_t *data, size_t len)
+{
+    size_t taken = 0;
+
+    while (ctx->remaining > 0 && taken < len) {
+        uint32_t n;
+        uint8_t *out = out_ptr(ctx, &n);
+
+        if (n > ctx->remaining) {
+            n = ctx->remaining;
+        }
+        if (n > len - taken) {
+            n = len - taken;
+        }
+        memcpy(out, &data[taken], n);
+        ctx->remaining -= n;
+        taken += n;
+        out_advance(ctx, n);
+    }
+    ctx->stats.literal += taken;
+    return taken;
+}
+
+/* Decodes a command, and applies it unless its data is still to come */
+static int command_start(boot_image_patch_t *ctx)
+{
+    const boot_image_patch_header_t *h = &ctx->header;
+    uint32_t w[2];
+
+    memcpy(w, ctx->hold, sizeof(w));
+    ctx->op = w[0] >> 28;
+    ctx->remaining = w[0] & BOOT_IMAGE_PATCH_LEN_MASK;
+    ctx->arg = w[1];
+
+    if (ctx->remaining > h->target_size - ctx->produced) {
+        return BOOT_IMAGE_PATCH_ERR_SIZE;
+    }
+
+    switch (ctx->op) {
+    case BOOT_IMAGE_PATCH_OP_COPY:
+        if (ctx->arg > h->source_size || ctx->remaining > h->source_size - ctx->arg) {
+            return BOOT_IMAGE_PATCH_ERR_SIZE;
+        }
+        op_copy(ctx);
+        break;
+    case BOOT_IMAGE_PATCH_OP_FILL:
+        if (ctx->arg > 0xFF) {
+            return BOOT_IMAGE_PATCH_ERR_COMMAND;
+        }
+        op_fill(ctx);
+        break;
+    case BOOT_IMAGE_PATCH_OP_DATA:
+        break;
+    default:
+        return BOOT_IMAGE_PATCH_ERR_COMMAND;
+    }
+
+    if (ctx->remaining == 0) {
+        ctx->op = 0;
+    }
+    return BOOT_IMAGE_PATCH_OK;
+}
+
+int boot_image_patch_write(boot_image_patch_t *ctx, const uint8_t *data, size_t len)
+{
+    if (ctx->error) {
+        return ctx->error;
+    }
+    ctx->stats.patch_bytes += len;
+
+    while (len > 0) {
+        size_t n;
+
+        if (ctx->op == BOOT_IMAGE_PATCH_OP_DATA) {
+            n = op_data(ctx, data, len);
+            if (ctx->remaining == 0) {
+                ctx->op = 0;
+            }
+        } else {
+            /* Gather the header or the next command, which may be split across writes */
+            const uint32_t want = ctx->header_valid ? BOOT_IMAGE_PATCH_CMD_SIZE : BOOT_IMAGE_PATCH_HEADER_SIZE;
+            int ret;
+
+            n = want - ctx->held;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(&ctx->hold[ctx->held], data, n);
+            ctx->held += n;
+
+            if (ctx->held == want) {
+                ctx->held = 0;
+                ret = ctx->header_valid ? command_start(ctx) : header_accept(ctx);
+                if (ret < 0) {
+                    return patch_fail(ctx, ret);
+                }
+            }
+        }
+
+        data += n;
+        len -= n;
+    }
+
+    return BOOT_IMAGE_PATCH_OK;
+}
+
+int boot_image_patch_finish(boot_image_patch_t *ctx)
+{
+    const boot_image_patch_header_t *h = &ctx->header;
+    const uint32_t first_len = (h->target_size < SECTOR_SIZE) ? h->target_size : SECTOR_SIZE;
+    const uint32_t pos = ctx->produced % SECTOR_SIZE;
+    uint32_t crc;
+
+    if (ctx->error) {
+        return ctx->error;
+    }
+    if (!ctx->header_valid || ctx->op != 0 || ctx->held != 0 || ctx->produced != h->target_size) {
+        return patch_fail(ctx, BOOT_IMAGE_PATCH_ERR_INCOMPLETE);
+    }
+
+    /* The last sector is padded as erased flash would be */
+    if (pos != 0) {
+        uint32_t room;
+
+        memset(out_ptr(ctx, &room), 0xFF, SECTOR_SIZE - pos);
+        sector_flush(ctx, ctx->produced / SECTOR_SIZE, pos);
+    }
+
+    /* The image as it was built, and then as it reads back from flash */
+    if (~ctx->crc != h->target_crc) {
+        return patch_fail(ctx, BOOT_IMAGE_PATCH_ERR_VERIFY);
+    }
+    crc = boot_image_patch_crc(BOOT_IMAGE_CRC_INIT, (const uint32_t *) ctx->first, first_len / sizeof(uint32_t));
+    crc = flash_crc(ctx, crc, ctx->dst_addr + first_len, h->target_size - first_len);
+    if (~crc != h->target_crc) {
+        return patch_fail(ctx, BOOT_IMAGE_PATCH_ERR_VERIFY);
+    }
+
+    /* Only now is the new image made visible to the boot image manager */
+    boot_image_patch_flash_write(ctx->app_data, ctx->dst_addr, ctx->first, SECTOR_SIZE);
+    ctx->stats.sectors++;
+    if (flash_crc(ctx, BOOT_IMAGE_CRC_INIT, ctx->dst_addr, first_len) !=
+        boot_image_patch_crc(BOOT_IMAGE_CRC_INIT, (const uint32_t *) ctx->first, first_len / sizeof(uint32_t))) {
+        return patch_fail(ctx, BOOT_IMAGE_PATCH_ERR_VERIFY);
+    }
+
+    return BOOT_IMAGE_PATCH_OK;
+}
+
+void boot_image_patch_stats_get(boot_image_patch_t *ctx, boot_image_patch_stats_t *stats)
+{
+    *stats = ctx->stats;
+}
+
+__attribute__((weak))
+size_t boot_image_patch_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    (void) app_data;
+    (void) addr;
+    (void) buf;
+    (void) len;
+
+    return 0;
+}
+
+__attribute__((weak))
+size_t boot_image_patch_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    (void) app_data;
+    (void) addr;
+    (void) buf;
+    (void) len;
+
+    return 0;
+}
+
+__attribute__((weak))
+void boot_image_patch_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    (void) app_data;
+    (void) addr;
+    (void) len;
+}
@@ -0,0 +1,261 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BOOT_IMAGE_PATCH_H_
+#define BOOT_IMAGE_PATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef BOOT_IMAGE_PATCH_SECTOR_SIZE
+#define BOOT_IMAGE_PATCH_SECTOR_SIZE    4096
+#endif
+
+/* Size of the buffer used to read flash back for verification */
+#ifndef BOOT_IMAGE_PATCH_VERIFY_SIZE
+#define BOOT_IMAGE_PATCH_VERIFY_SIZE    256
+#endif
+
+/* The number of images a patch may be applied to */
+#ifndef BOOT_IMAGE_PATCH_MAX_SOURCES
+#define BOOT_IMAGE_PATCH_MAX_SOURCES    2
+#endif
+
+/**
+ * \name Patch format
+ *
+ * A patch is a header followed by commands. Each command is two words,
+ * the opcode in the top 4 bits of the first and the length in bytes in
+ * the rest, and an argument. DATA commands are followed by their data.
+ * All words are little endian.
+ *
+ * Image CRCs are the CRC-32 (polynomial 0xEDB88320, initial value
+ * 0xFFFFFFFF, inverted) of the image words, as the crc32 instruction
+ * computes it. Image sizes are a whole number of words.
+ * @{
+ */
+#define BOOT_IMAGE_PATCH_MAGIC          0x31504942  /**< "BIP1" */
+#define BOOT_IMAGE_PATCH_HEADER_SIZE    24
+#define BOOT_IMAGE_PATCH_CMD_SIZE       8
+#define BOOT_IMAGE_PATCH_LEN_MASK       0x0FFFFFFF
+
+#define BOOT_IMAGE_PATCH_OP_COPY        1   /**< Copy length bytes from the source image at offset argument. */
+#define BOOT_IMAGE_PATCH_OP_DATA        2   /**< Copy the length bytes that follow the command. */
+#define BOOT_IMAGE_PATCH_OP_FILL        3   /**< Repeat the byte in the argument length times. */
+/**@}*/
+
+/** \name Return codes
+ * @{
+ */
+#define BOOT_IMAGE_PATCH_OK             0   /**< Done. */
+#define BOOT_IMAGE_PATCH_ERR_HEADER    -1   /**< The data is not a patch, or its header is corrupt. */
+#define BOOT_IMAGE_PATCH_ERR_SOURCE    -2   /**< No image in flash matches the patch's source image. */
+#define BOOT_IMAGE_PATCH_ERR_SIZE      -3   /**< The new image does not fit, or a command goes past the end of an image. */
+#define BOOT_IMAGE_PATCH_ERR_COMMAND   -4   /**< A command is not valid. */
+#define BOOT_IMAGE_PATCH_ERR_VERIFY    -5   /**< The new image does not have the CRC the patch says it should. */
+#define BOOT_IMAGE_PATCH_ERR_INCOMPLETE -6  /**< The patch ended before the new image was complete. */
+/**@}*/
+
+/**
+ * \defgroup boot_image_patch
+ *
+ * The public API for applying a delta update to a boot image.
+ *
+ * A patch, made on the host by comparing the new image with one already
+ * in flash, describes the new image as ranges copied from the old image
+ * and the data that is new. It is applied as it is downloaded: each
+ * command writes into a sector buffer, copying from the old image in
+ * flash or from the patch, and each full buffer is erased and programmed
+ * into the destination. RAM use is two sectors whatever the image size.
+ *
+ * The header names the source image by its size and CRC. When it arrives
+ * the candidate images, usually the current image and then the factory
+ * image, are checked in turn, and the patch is rejected if none matches.
+ * Candidates that overlap the destination are not used.
+ *
+ * The first sector of the new image, which holds its header, is kept in
+ * RAM. Once the rest has been programmed it is read back, and only if the
+ * whole image has the CRC the patch gives is the first sector programmed.
+ * Until then the boot image manager does not see the new image, and an
+ * interrupted or corrupt patch leaves the current image in use.
+ * @{
+ */
+
+/** Patch header. */
+typedef struct {
+    uint32_t magic;         /**< BOOT_IMAGE_PATCH_MAGIC. */
+    uint32_t source_size;   /**< The size of the source image in bytes. */
+    uint32_t source_crc;    /**< The CRC of the source image. */
+    uint32_t target_size;   /**< The size of the new image in bytes. */
+    uint32_t target_crc;    /**< The CRC of the new image. */
+    uint32_t header_crc;    /**< The CRC of the words above. */
+} boot_image_patch_header_t;
+
+/** Patch statistics. */
+typedef struct {
+    uint32_t patch_bytes;   /**< Patch bytes received. */
+    uint32_t copied;        /**< New image bytes copied from the source image. */
+    uint32_t literal;       /**< New image bytes taken from the patch. */
+    uint32_t filled;        /**< New image bytes filled. */
+    uint32_t sectors;       /**< Sectors programmed. */
+    uint32_t source_addr;   /**< The address of the source image used. */
+} boot_image_patch_stats_t;
+
+/**
+ * Typedef to the patch instance struct.
+ */
+typedef struct boot_image_patch_struct boot_image_patch_t;
+
+/**
+ * Struct representing a patch instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct boot_image_patch_struct {
+    /**
+     * A pointer to application specific data. Passed to the flash access
+     * functions.
+     */
+    void *app_data;
+
+    uint32_t dst_addr;
+    uint32_t dst_size;
+
+    uint32_t src_addr[BOOT_IMAGE_PATCH_MAX_SOURCES];
+    uint32_t src_size[BOOT_IMAGE_PATCH_MAX_SOURCES];
+    int src_count;
+    uint32_t src_base;
+
+    boot_image_patch_header_t header;
+    int header_valid;
+    int error;
+
+    /* The command being parsed or applied */
+    uint8_t hold[BOOT_IMAGE_PATCH_HEADER_SIZE] __attribute__((aligned(4)));
+    uint32_t held;
+    uint32_t op;
+    uint32_t remaining;
+    uint32_t arg;
+
+    uint32_t produced;
+    uint32_t crc;
+
+    boot_image_patch_stats_t stats;
+
+    uint8_t first[BOOT_IMAGE_PATCH_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint8_t sector[BOOT_IMAGE_PATCH_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint8_t verify[BOOT_IMAGE_PATCH_VERIFY_SIZE] __attribute__((aligned(4)));
+};
+
+/**
+ * User defined flash read function
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to read from
+ * \param buf       A pointer to the buffer to read into
+ * \param len       The number of bytes to read
+ *
+ * \return number of bytes read
+ */
+size_t boot_image_patch_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len);
+
+/**
+ * User defined flash program function. The region has been erased.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to program
+ * \param buf       A pointer to the buffer to write from
+ * \param len       The number of bytes to write
+ *
+ * \return number of bytes written
+ */
+size_t boot_image_patch_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len);
+
+/**
+ * User defined flash erase function.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The sector aligned flash address to erase
+ * \param len       The number of bytes to erase, a multiple of the sector size
+ */
+void boot_image_patch_flash_erase(void *app_data, unsigned addr, size_t len);
+
+/**
+ * Accumulates the CRC of a run of words, as the crc32 instruction does
+ * with the polynomial 0xEDB88320.
+ *
+ * \param crc    The CRC so far, 0xFFFFFFFF to start
+ * \param words  A pointer to the words
+ * \param count  The number of words
+ *
+ * \return the updated CRC, to be inverted once the last word is added
+ */
+uint32_t boot_image_patch_crc(uint32_t crc, const uint32_t *words, size_t count);
+
+/**
+ * Checks whether downloaded data starts with a patch header.
+ *
+ * \param data  A pointer to the first bytes downloaded
+ * \param len   The number of bytes
+ *
+ * \return 1 if the data is a patch, 0 otherwise
+ */
+int boot_image_patch_is_patch(const uint8_t *data, size_t len);
+
+/**
+ * Initializes a patch instance, ready for the first byte of a patch.
+ *
+ * \param ctx       A pointer to the patch instance
+ * \param dst_addr  The sector aligned flash address to write the new image to
+ * \param dst_size  The space available for the new image, in bytes
+ * \param app_data  A pointer to the application specific data
+ */
+void boot_image_patch_init(boot_image_patch_t *ctx, uint32_t dst_addr, uint32_t dst_size, void *app_data);
+
+/**
+ * Adds an image in flash that the patch may have been made from. Images
+ * are tried in the order they are added.
+ *
+ * \param ctx   A pointer to the patch instance
+ * \param addr  The flash address of the image
+ * \param size  The size of the image in bytes
+ *
+ * \return BOOT_IMAGE_PATCH_OK, or BOOT_IMAGE_PATCH_ERR_SIZE if there are
+ *         already BOOT_IMAGE_PATCH_MAX_SOURCES images
+ */
+int boot_image_patch_source_add(boot_image_patch_t *ctx, uint32_t addr, uint32_t size);
+
+/**
+ * Applies the next part of a patch. The patch may be split anywhere.
+ *
+ * \param ctx   A pointer to the patch instance
+ * \param data  A pointer to the patch data
+ * \param len   The number of bytes
+ *
+ * \return BOOT_IMAGE_PATCH_OK, or one of the error codes. After an error
+ *         the patch must be started again from the beginning.
+ */
+int boot_image_patch_write(boot_image_patch_t *ctx, const uint8_t *data, size_t len);
+
+/**
+ * Completes the new image once the whole patch has been written. Verifies
+ * the CRC of the new image in flash, then programs its first sector.
+ *
+ * \param ctx  A pointer to the patch instance
+ *
+ * \return BOOT_IMAGE_PATCH_OK if the new image is complete and verified,
+ *         otherwise one of the error codes
+ */
+int boot_image_patch_finish(boot_image_patch_t *ctx);
+
+/**
+ * Gets the statistics of the current or last patch.
+ *
+ * \param ctx    A pointer to the patch instance
+ * \param stats  Receives the statistics
+ */
+void boot_image_patch_stats_get(boot_image_patch_t *ctx, boot_image_patch_stats_t *stats);
+
+/**@}*/
+
+#endif /* BOOT_IMAGE_PATCH_H_ */
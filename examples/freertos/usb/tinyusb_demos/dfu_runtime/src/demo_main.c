@@ -56,6 +56,13 @@
  *
  * $ xflash --factory-version 15.0 --upgrade 0 [.xe file] -o [upgrade image filename]
  *
+ * To create a delta update from the upgrade image the device is running, or
+ * the factory image, use the host tool in examples/freertos/usb/host
+ *
+ * $ example_freertos_usb_boot_image_diff [old image] [new image] [patch filename]
+ *
+ * and download the patch in place of the new image.
+ *
  */
 
 #include <stdlib.h>
@@ -64,11 +71,13 @@
 #include <xs1.h>
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "rtos_gpio.h"
 #include "demo_main.h"
 #include "tusb.h"
 
 #include "flash_boot_image.h"
+#include "boot_image_patch.h"
 
 #define FLASH_PAGE_SIZE     (4096)
 #define FLASH_PAGE_COUNT    (32768)
@@ -136,6 +145,68 @@ void tud_resume_cb(void)
 static size_t total_len = 0;
 static size_t bytes_avail = 0;
 static uint32_t dn_base_addr = 0;
+
+/*
+ * A download that starts with a patch header is a delta update. The patch
+ * is applied by the patch task, since a single block may copy enough of
+ * the old image to take longer than the host waits for a request.
+ */
+static boot_image_patch_t patch_ctx;
+static int dn_is_patch = 0;
+static TaskHandle_t patch_task_handle = NULL;
+static uint8_t *patch_data = NULL;
+static uint16_t patch_len = 0;
+
+size_t boot_image_patch_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_read((rtos_qspi_flash_t *) app_data, buf, addr, len);
+    return len;
+}
+
+size_t boot_image_patch_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_write((rtos_qspi_flash_t *) app_data, (uint8_t *) buf, addr, len);
+    return len;
+}
+
+void boot_image_patch_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    rtos_qspi_flash_erase((rtos_qspi_flash_t *) app_data, addr, len);
+}
+
+static void patch_begin(uint32_t addr)
+{
+    boot_image_patch_init(&patch_ctx, addr, bim_ctx_ptr->boot_partition_size - addr, bim_ctx_ptr->app_data);
+
+    /* The image running now, if it is an upgrade, and then the factory image */
+    if (bim_ctx_ptr->valid_img_cnt > 1) {
+        boot_image_t *current = &bim_ctx_ptr->img_table[bim_ctx_ptr->valid_img_cnt - 1];
+        boot_image_patch_source_add(&patch_ctx, current->startAddress, current->size);
+    }
+    if (bim_ctx_ptr->valid_img_cnt > 0) {
+        boot_image_t *factory = boot_image_get_factory_image(bim_ctx_ptr);
+        boot_image_patch_source_add(&patch_ctx, factory->startAddress, factory->size);
+    }
+    dn_is_patch = 1;
+}
+
+static void patch_task(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        int ret;
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        ret = boot_image_patch_write(&patch_ctx, patch_data, patch_len);
+        if (ret != BOOT_IMAGE_PATCH_OK) {
+            rtos_printf("Patch failed (%d)\n", ret);
+        }
+        total_len += patch_len;
+        tud_dfu_dnload_complete();
+    }
+}
 bool tud_dfu_firmware_valid_check_cb()
 {
     uint8_t dummy;
@@ -166,7 +237,20 @@ void tud_dfu_req_dnload_data_cb(uint16_t wBlockNum, uint8_t* data, uint16_t leng
       dn_base_addr = addr;
   }
 
-  if(length > 0)
+  if (wBlockNum == 0 && boot_image_patch_is_patch(data, length))
+  {
+      rtos_printf("Delta update\n");
+      patch_begin(dn_base_addr);
+  }
+
+  if(dn_is_patch && length > 0)
+  {
+    // The data stays in the transfer buffer until the block is completed
+    patch_data = data;
+    patch_len = length;
+    xTaskNotifyGive(patch_task_handle);
+  }
+  else if(length > 0)
   {
     unsigned cur_addr = dn_base_addr + (wBlockNum * bim_ctx_ptr->page_size);
     if((bytes_avail - total_len) >= length)
@@ -184,6 +268,19 @@ void tud_dfu_req_dnload_data_cb(uint16_t wBlockNum, uint8_t* data, uint16_t leng
 
 bool tud_dfu_device_data_done_check_cb()
 {
+  if (dn_is_patch)
+  {
+    boot_image_patch_stats_t stats;
+
+    // The new image is only made bootable once its CRC has been verified
+    int ret = boot_image_patch_finish(&patch_ctx);
+    boot_image_patch_stats_get(&patch_ctx, &stats);
+    rtos_printf("Delta update from image at 0x%x: patch %u bytes, copied %u, new %u, filled %u, result %d\n",
+                stats.source_addr, stats.patch_bytes, stats.copied, stats.literal, stats.filled, ret);
+    dn_is_patch = 0;
+    return ret == BOOT_IMAGE_PATCH_OK;
+  }
+
   rtos_printf("Dummy device data done check... Returning true\n");
   return true;
 }
@@ -191,6 +288,7 @@ bool tud_dfu_device_data_done_check_cb()
 void tud_dfu_abort_cb()
 {
   rtos_printf("Host Aborted transfer\n");
+  dn_is_patch = 0;
 }
 
 uint16_t tud_dfu_req_upload_data_cb(uint16_t block_num, uint8_t* data, uint16_t length)
@@ -258,6 +356,13 @@ void create_tinyusb_demo(demo_args_t *args, unsigned priority)
     gpio_ctx = args->gpio_ctx;
     qspi_ctx =  args->qspi_ctx;
 
+    xTaskCreate((TaskFunction_t) patch_task,
+                "dfu_patch",
+                portTASK_STACK_DEPTH(patch_task),
+                NULL,
+                priority,
+                &patch_task_handle);
+
     if (gpio_ctx != NULL) {
         led_port = rtos_gpio_port(PORT_LEDS);
         rtos_gpio_port_enable(gpio_ctx, led_port);
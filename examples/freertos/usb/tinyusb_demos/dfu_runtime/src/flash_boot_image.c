@@ -5,6 +5,7 @@
 #include <xcore/assert.h>
 
 #include "rtos_support.h"
+#include "boot_image_crc.h"
 #include "flash_boot_image.h"
 
 #define NIBBLE_SWAP_INT(X) (((X&0x0f0f0f0f)<<4) | ((X&0xf0f0f0f0)>>4))
@@ -170,15 +171,14 @@ static int boot_image_find_factory_image(boot_image_manager_ctx_t* ctx)
 
 static uint32_t image_crc(uint32_t *data, uint32_t num_words, uint32_t expected_crc)
 {
-    uint32_t crc = 0xFFFFFFFF;
-    uint32_t polynom = 0xedb88320;
+    uint32_t crc = BOOT_IMAGE_CRC_INIT;
 
     for(uint32_t i=0; i<num_words; i++)
     {
-        asm volatile("crc32 %0, %2, %3" : "=r" (crc) : "0" (crc), "r" (NIBBLE_SWAP_INT(data[i])), "r" (polynom));
+        crc = boot_image_crc_word(crc, NIBBLE_SWAP_INT(data[i]));
     }
 
-    asm volatile("crc32 %0, %2, %3" : "=r" (crc) : "0" (crc), "r" (expected_crc), "r" (polynom));
+    crc = boot_image_crc_word(crc, expected_crc);
 
     return ~crc;
 }
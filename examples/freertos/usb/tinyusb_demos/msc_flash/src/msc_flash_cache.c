@@ -0,0 +1,408 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "msc_flash_cache.h"
+
+#define NO_SECTOR           0xFFFFFFFF
+
+#define FULL_MASK           ((MSC_FLASH_BLOCKS_PER_SECTOR == 32) ? 0xFFFFFFFF : ((1u << MSC_FLASH_BLOCKS_PER_SECTOR) - 1))
+#define SECTOR_ADDR(c, s)   ((c)->base_addr + ((s) * MSC_FLASH_SECTOR_SIZE))
+#define SECTOR_COUNT(c)     (((c)->block_count + MSC_FLASH_BLOCKS_PER_SECTOR - 1) / MSC_FLASH_BLOCKS_PER_SECTOR)
+
+static msc_flash_cache_line_t *line_find(msc_flash_cache_t *ctx, uint32_t sector)
+{
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        if (ctx->line[i].sector == sector) {
+            return &ctx->line[i];
+        }
+    }
+    return NULL;
+}
+
+static void line_touch(msc_flash_cache_t *ctx, msc_flash_cache_line_t *line)
+{
+    line->lru_stamp = ++ctx->lru_clock;
+}
+
+/*
+ * Reads the blocks in mask that are not yet valid. Each contiguous run of
+ * missing blocks costs one flash read.
+ */
+static int line_fill(msc_flash_cache_t *ctx, msc_flash_cache_line_t *line, uint32_t mask)
+{
+    uint32_t missing = mask & ~line->valid_mask;
+    int reads = 0;
+    int i = 0;
+
+    while (i < MSC_FLASH_BLOCKS_PER_SECTOR) {
+        if ((missing & (1u << i)) == 0) {
+            i++;
+            continue;
+        }
+        int run = 1;
+        while ((i + run) < MSC_FLASH_BLOCKS_PER_SECTOR && (missing & (1u << (i + run)))) {
+            run++;
+        }
+        msc_flash_cache_flash_read(ctx->app_data,
+                                   SECTOR_ADDR(ctx, line->sector) + (i * MSC_FLASH_BLOCK_SIZE),
+                                   &line->data[i * MSC_FLASH_BLOCK_SIZE],
+                                   run * MSC_FLASH_BLOCK_SIZE);
+        i += run;
+        reads++;
+    }
+    line->valid_mask |= missing;
+
+    return reads;
+}
+
+static int page_is_erased(const uint8_t *page)
+{
+    const uint32_t *w = (const uint32_t *) page;
+    for (size_t i = 0; i < MSC_FLASH_PAGE_SIZE / sizeof(uint32_t); i++) {
+        if (w[i] != 0xFFFFFFFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Programs an erased sector, skipping pages that would be left erased anyway.
+ */
+static void line_program(msc_flash_cache_t *ctx, msc_flash_cache_line_t *line)
+{
+    const uint32_t addr = SECTOR_ADDR(ctx, line->sector);
+    int start = -1;
+
+    for (int p = 0; p <= MSC_FLASH_SECTOR_SIZE / MSC_FLASH_PAGE_SIZE; p++) {
+        const int erased = (p == MSC_FLASH_SECTOR_SIZE / MSC_FLASH_PAGE_SIZE) ||
+                           page_is_erased(&line->data[p * MSC_FLASH_PAGE_SIZE]);
+        if (!erased && start < 0) {
+            start = p;
+        } else if (erased && start >= 0) {
+            msc_flash_cache_flash_write(ctx->app_data,
+                                        addr + (start * MSC_FLASH_PAGE_SIZE),
+                                        &line->data[start * MSC_FLASH_PAGE_SIZE],
+                                        (p - start) * MSC_FLASH_PAGE_SIZE);
+            start = -1;
+        }
+    }
+
+    line->dirty_mask = 0;
+    ctx->stats.write_backs++;
+}
+
+static void line_prepare_write_back(msc_flash_cache_t *ctx, msc_flash_cache_line_t *line)
+{
+    if (line->valid_mask != FULL_MASK) {
+        line_fill(ctx, line, FULL_MASK);
+        ctx->stats.write_fills++;
+    }
+}
+
+/*
+ * Writes back the run of adjacent dirty sectors containing line, so that the
+ * flash driver can use its largest erase size that fits.
+ */
+static int run_write_back(msc_flash_cache_t *ctx, msc_flash_cache_line_t *line)
+{
+    msc_flash_cache_line_t *run[MSC_FLASH_CACHE_LINES];
+    msc_flash_cache_line_t *prev;
+    int n = 0;
+
+    while (line->sector > 0 && (prev = line_find(ctx, line->sector - 1)) != NULL && prev->dirty_mask != 0) {
+        line = prev;
+    }
+
+    run[n++] = line;
+    while (n < MSC_FLASH_CACHE_LINES) {
+        msc_flash_cache_line_t *next = line_find(ctx, line->sector + n);
+        if (next == NULL || next->dirty_mask == 0) {
+            break;
+        }
+        run[n++] = next;
+    }
+
+    for (int i = 0; i < n; i++) {
+        line_prepare_write_back(ctx, run[i]);
+    }
+    msc_flash_cache_flash_erase(ctx->app_data, SECTOR_ADDR(ctx, line->sector), n * MSC_FLASH_SECTOR_SIZE);
+    for (int i = 0; i < n; i++) {
+        line_program(ctx, run[i]);
+    }
+
+    return n;
+}
+
+/*
+ * Returns a line for sector, evicting the least recently used line if
+ * required. When allow_dirty is zero a dirty victim is not written back
+ * and NULL is returned instead.
+ */
+static msc_flash_cache_line_t *line_alloc(msc_flash_cache_t *ctx, uint32_t sector, int allow_dirty)
+{
+    msc_flash_cache_line_t *victim = NULL;
+
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        msc_flash_cache_line_t *line = &ctx->line[i];
+        if (line->sector == NO_SECTOR) {
+            victim = line;
+            break;
+        }
+        if (victim == NULL || (int32_t) (line->lru_stamp - victim->lru_stamp) < 0) {
+            victim = line;
+        }
+    }
+
+    if (victim->sector != NO_SECTOR) {
+        if (victim->dirty_mask != 0) {
+            if (!allow_dirty) {
+                return NULL;
+            }
+            run_write_back(ctx, victim);
+        }
+        ctx->stats.evictions++;
+    }
+
+    victim->sector = sector;
+    victim->valid_mask = 0;
+    victim->dirty_mask = 0;
+    victim->prefetched = 0;
+    line_touch(ctx, victim);
+
+    return victim;
+}
+
+static int range_valid(msc_flash_cache_t *ctx, uint32_t lba, uint32_t offset, uint32_t len)
+{
+    const uint64_t end = ((uint64_t) lba * MSC_FLASH_BLOCK_SIZE) + offset + len;
+    return lba < ctx->block_count && end <= (uint64_t) ctx->block_count * MSC_FLASH_BLOCK_SIZE;
+}
+
+static uint32_t block_mask(uint32_t first, uint32_t last)
+{
+    uint32_t mask = FULL_MASK;
+    mask &= FULL_MASK << first;
+    mask &= FULL_MASK >> (MSC_FLASH_BLOCKS_PER_SECTOR - 1 - last);
+    return mask;
+}
+
+static int popcount(uint32_t x)
+{
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+}
+
+void msc_flash_cache_init(msc_flash_cache_t *ctx, uint32_t base_addr, uint32_t block_count, void *app_data)
+{
+    memset(ctx, 0x00, sizeof(msc_flash_cache_t));
+    ctx->app_data = app_data;
+    ctx->base_addr = base_addr;
+    ctx->block_count = block_count;
+    ctx->prefetch_sector = NO_SECTOR;
+
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        ctx->line[i].sector = NO_SECTOR;
+    }
+}
+
+int32_t msc_flash_cache_read(msc_flash_cache_t *ctx, uint32_t lba, uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    if (!range_valid(ctx, lba, offset, len)) {
+        return -1;
+    }
+
+    uint64_t pos = ((uint64_t) lba * MSC_FLASH_BLOCK_SIZE) + offset;
+    const uint64_t end = pos + len;
+
+    if (pos == ctx->next_pos) {
+        ctx->seq_count++;
+    } else {
+        ctx->seq_count = 0;
+    }
+    ctx->next_pos = end;
+
+    while (pos < end) {
+        const uint32_t sector = pos / MSC_FLASH_SECTOR_SIZE;
+        const uint32_t sector_offset = pos % MSC_FLASH_SECTOR_SIZE;
+        uint32_t n = MSC_FLASH_SECTOR_SIZE - sector_offset;
+        if (n > end - pos) {
+            n = end - pos;
+        }
+        const uint32_t mask = block_mask(sector_offset / MSC_FLASH_BLOCK_SIZE,
+                                         (sector_offset + n - 1) / MSC_FLASH_BLOCK_SIZE);
+
+        msc_flash_cache_line_t *line = line_find(ctx, sector);
+        if (line == NULL) {
+            line = line_alloc(ctx, sector, 1);
+        }
+
+        if (line->prefetched) {
+            line->prefetched = 0;
+            ctx->stats.prefetch_hits++;
+        }
+
+        const int hit_blocks = popcount(mask & line->valid_mask);
+        if ((mask & line->valid_mask) != mask) {
+            /*
+             * A sequential stream loads the whole sector so that the rest of
+             * it is a hit. Random reads only load the blocks asked for.
+             */
+            line_fill(ctx, line, ctx->seq_count > 0 ? FULL_MASK : mask);
+            ctx->stats.read_misses++;
+        }
+        line_touch(ctx, line);
+
+        memcpy(buf, &line->data[sector_offset], n);
+
+        ctx->stats.read_blocks += popcount(mask);
+        ctx->stats.read_hits += hit_blocks;
+        buf += n;
+        pos += n;
+    }
+
+    if (ctx->seq_count >= MSC_FLASH_READAHEAD_THRESHOLD) {
+        const uint32_t next_sector = (end + MSC_FLASH_SECTOR_SIZE - 1) / MSC_FLASH_SECTOR_SIZE;
+        if (next_sector < SECTOR_COUNT(ctx)) {
+            ctx->prefetch_sector = next_sector;
+        }
+    }
+
+    return (int32_t) len;
+}
+
+int32_t msc_flash_cache_write(msc_flash_cache_t *ctx, uint32_t lba, uint32_t offset, const uint8_t *buf, uint32_t len)
+{
+    if (!range_valid(ctx, lba, offset, len)) {
+        return -1;
+    }
+
+    uint64_t pos = ((uint64_t) lba * MSC_FLASH_BLOCK_SIZE) + offset;
+    const uint64_t end = pos + len;
+
+    while (pos < end) {
+        const uint32_t sector = pos / MSC_FLASH_SECTOR_SIZE;
+        const uint32_t sector_offset = pos % MSC_FLASH_SECTOR_SIZE;
+        uint32_t n = MSC_FLASH_SECTOR_SIZE - sector_offset;
+        if (n > end - pos) {
+            n = end - pos;
+        }
+        const uint32_t first = sector_offset / MSC_FLASH_BLOCK_SIZE;
+        const uint32_t last = (sector_offset + n - 1) / MSC_FLASH_BLOCK_SIZE;
+
+        msc_flash_cache_line_t *line = line_find(ctx, sector);
+        if (line == NULL) {
+            /* Nothing is read here. Blocks the host does not overwrite are read at write back. */
+            line = line_alloc(ctx, sector, 1);
+        }
+
+        /* Blocks only partially covered by this write need their old contents */
+        uint32_t partial = 0;
+        if ((sector_offset % MSC_FLASH_BLOCK_SIZE) != 0) {
+            partial |= 1u << first;
+        }
+        if (((sector_offset + n) % MSC_FLASH_BLOCK_SIZE) != 0) {
+            partial |= 1u << last;
+        }
+        if (partial & ~line->valid_mask) {
+            line_fill(ctx, line, partial);
+        }
+
+        memcpy(&line->data[sector_offset], buf, n);
+
+        const uint32_t mask = block_mask(first, last);
+        line->valid_mask |= mask;
+        line->dirty_mask |= mask;
+        line->prefetched = 0;
+        line_touch(ctx, line);
+
+        ctx->stats.write_blocks += popcount(mask);
+        buf += n;
+        pos += n;
+    }
+
+    return (int32_t) len;
+}
+
+int msc_flash_cache_prefetch_pending(msc_flash_cache_t *ctx)
+{
+    return ctx->prefetch_sector != NO_SECTOR;
+}
+
+int msc_flash_cache_prefetch(msc_flash_cache_t *ctx)
+{
+    int loaded = 0;
+    const uint32_t first = ctx->prefetch_sector;
+
+    ctx->prefetch_sector = NO_SECTOR;
+
+    if (first == NO_SECTOR) {
+        return 0;
+    }
+
+    for (uint32_t s = first; s < first + MSC_FLASH_READAHEAD_SECTORS && s < SECTOR_COUNT(ctx); s++) {
+        msc_flash_cache_line_t *line = line_find(ctx, s);
+        if (line != NULL) {
+            continue;
+        }
+
+        /* Read-ahead never stalls on a write back */
+        line = line_alloc(ctx, s, 0);
+        if (line == NULL) {
+            break;
+        }
+        line_fill(ctx, line, FULL_MASK);
+        line->prefetched = 1;
+        ctx->stats.prefetches++;
+        loaded++;
+    }
+
+    return loaded;
+}
+
+int msc_flash_cache_flush(msc_flash_cache_t *ctx)
+{
+    int count = 0;
+
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        if (ctx->line[i].dirty_mask != 0) {
+            count += run_write_back(ctx, &ctx->line[i]);
+        }
+    }
+
+    return count;
+}
+
+int msc_flash_cache_dirty(msc_flash_cache_t *ctx)
+{
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        if (ctx->line[i].dirty_mask != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void msc_flash_cache_invalidate(msc_flash_cache_t *ctx)
+{
+    msc_flash_cache_flush(ctx);
+
+    for (int i = 0; i < MSC_FLASH_CACHE_LINES; i++) {
+        ctx->line[i].sector = NO_SECTOR;
+        ctx->line[i].valid_mask = 0;
+        ctx->line[i].prefetched = 0;
+    }
+    ctx->prefetch_sector = NO_SECTOR;
+    ctx->seq_count = 0;
+}
+
+void msc_flash_cache_stats_get(msc_flash_cache_t *ctx, msc_flash_cache_stats_t *stats)
+{
+    memcpy(stats, &ctx->stats, sizeof(msc_flash_cache_stats_t));
+}
@@ -0,0 +1,246 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef MSC_FLASH_CACHE_H_
+#define MSC_FLASH_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MSC_FLASH_BLOCK_SIZE
+#define MSC_FLASH_BLOCK_SIZE        512
+#endif
+
+#ifndef MSC_FLASH_SECTOR_SIZE
+#define MSC_FLASH_SECTOR_SIZE       4096
+#endif
+
+#ifndef MSC_FLASH_CACHE_LINES
+#define MSC_FLASH_CACHE_LINES       8
+#endif
+
+#ifndef MSC_FLASH_READAHEAD_SECTORS
+#define MSC_FLASH_READAHEAD_SECTORS 2
+#endif
+
+/* Number of consecutive sequential reads before read-ahead kicks in */
+#ifndef MSC_FLASH_READAHEAD_THRESHOLD
+#define MSC_FLASH_READAHEAD_THRESHOLD 2
+#endif
+
+/* Program granularity. Pages left erased by the host are not programmed. */
+#ifndef MSC_FLASH_PAGE_SIZE
+#define MSC_FLASH_PAGE_SIZE         256
+#endif
+
+#define MSC_FLASH_BLOCKS_PER_SECTOR (MSC_FLASH_SECTOR_SIZE / MSC_FLASH_BLOCK_SIZE)
+
+#if (MSC_FLASH_BLOCKS_PER_SECTOR * MSC_FLASH_BLOCK_SIZE) != MSC_FLASH_SECTOR_SIZE
+#error MSC_FLASH_SECTOR_SIZE must be a multiple of MSC_FLASH_BLOCK_SIZE
+#endif
+
+#if MSC_FLASH_BLOCKS_PER_SECTOR > 32
+#error MSC_FLASH_SECTOR_SIZE / MSC_FLASH_BLOCK_SIZE must not exceed 32
+#endif
+
+/**
+ * \defgroup msc_flash_cache
+ *
+ * The public API for the flash backed mass storage block cache.
+ *
+ * The cache holds whole flash erase sectors. Reads are served from the cache
+ * and missing sectors are loaded with a single flash read. Writes are merged
+ * into the cached sector and written back with one erase and one program
+ * when the sector is evicted or the cache is flushed, so that several
+ * WRITE10 commands to the same sector cost a single erase cycle.
+ *
+ * None of the functions are thread safe. The caller must serialize access
+ * when the cache is shared between tasks.
+ * @{
+ */
+
+/** Cache statistics. */
+typedef struct {
+    uint32_t read_blocks;       /**< Blocks returned to the host. */
+    uint32_t read_hits;         /**< Blocks served without a demand flash read. */
+    uint32_t read_misses;       /**< Sectors loaded on the read path. */
+    uint32_t prefetches;        /**< Sectors loaded by read-ahead. */
+    uint32_t prefetch_hits;     /**< Prefetched sectors later read by the host. */
+    uint32_t write_blocks;      /**< Blocks written by the host. */
+    uint32_t write_backs;       /**< Sectors erased and programmed. */
+    uint32_t write_fills;       /**< Sectors that had to be read before write back. */
+    uint32_t evictions;         /**< Lines replaced to make room. */
+} msc_flash_cache_stats_t;
+
+/** A single cached erase sector. */
+typedef struct {
+    uint32_t sector;            /**< Sector index relative to the disk base address. */
+    uint32_t lru_stamp;         /**< Value of the cache clock at the last access. */
+    uint32_t valid_mask;        /**< One bit per block holding valid data. */
+    uint32_t dirty_mask;        /**< One bit per block not yet written to flash. */
+    uint32_t prefetched;        /**< Loaded by read-ahead and not yet read. */
+    uint8_t  data[MSC_FLASH_SECTOR_SIZE]; /**< Sector contents, word aligned. */
+} msc_flash_cache_line_t;
+
+/**
+ * Typedef to the flash block cache instance struct.
+ */
+typedef struct msc_flash_cache_struct msc_flash_cache_t;
+
+/**
+ * Struct representing a flash block cache instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct msc_flash_cache_struct {
+    /**
+     * A pointer to application specific data. Passed to the flash access
+     * functions.
+     */
+    void *app_data;
+
+    /**
+     * The flash byte address of block 0.
+     */
+    uint32_t base_addr;
+
+    /**
+     * The number of MSC_FLASH_BLOCK_SIZE blocks on the disk.
+     */
+    uint32_t block_count;
+
+    uint32_t lru_clock;
+    uint64_t next_pos;
+    uint32_t seq_count;
+    uint32_t prefetch_sector;
+
+    msc_flash_cache_stats_t stats;
+    msc_flash_cache_line_t line[MSC_FLASH_CACHE_LINES];
+};
+
+/**
+ * User defined flash read function
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to read from
+ * \param buf       A pointer to the buffer to read into
+ * \param len       The number of bytes to read
+ *
+ * \return number of bytes read
+ */
+size_t msc_flash_cache_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len);
+
+/**
+ * User defined flash program function. The region has been erased.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to program
+ * \param buf       A pointer to the buffer to write from
+ * \param len       The number of bytes to write
+ *
+ * \return number of bytes written
+ */
+size_t msc_flash_cache_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len);
+
+/**
+ * User defined flash erase function.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The sector aligned flash address to erase
+ * \param len       The number of bytes to erase, a multiple of the sector size
+ */
+void msc_flash_cache_flash_erase(void *app_data, unsigned addr, size_t len);
+
+/**
+ * Initializes a flash block cache.
+ *
+ * \param ctx         A pointer to the cache instance
+ * \param base_addr   The sector aligned flash address of block 0
+ * \param block_count The number of MSC_FLASH_BLOCK_SIZE blocks on the disk
+ * \param app_data    A pointer to the application specific data
+ */
+void msc_flash_cache_init(msc_flash_cache_t *ctx, uint32_t base_addr, uint32_t block_count, void *app_data);
+
+/**
+ * Reads from the disk.
+ *
+ * \param ctx     A pointer to the cache instance
+ * \param lba     The first block to read
+ * \param offset  The byte offset into the first block
+ * \param buf     A pointer to the buffer to read into
+ * \param len     The number of bytes to read
+ *
+ * \return the number of bytes read, or -1 if the range is outside the disk
+ */
+int32_t msc_flash_cache_read(msc_flash_cache_t *ctx, uint32_t lba, uint32_t offset, uint8_t *buf, uint32_t len);
+
+/**
+ * Writes to the disk. The data is held in the cache until the sector is
+ * evicted or msc_flash_cache_flush() is called.
+ *
+ * \param ctx     A pointer to the cache instance
+ * \param lba     The first block to write
+ * \param offset  The byte offset into the first block
+ * \param buf     A pointer to the data to write
+ * \param len     The number of bytes to write
+ *
+ * \return the number of bytes written, or -1 if the range is outside the disk
+ */
+int32_t msc_flash_cache_write(msc_flash_cache_t *ctx, uint32_t lba, uint32_t offset, const uint8_t *buf, uint32_t len);
+
+/**
+ * Loads the sectors following a detected sequential read stream. Intended
+ * to be called from a lower priority task while the USB transfer of the
+ * previous read is in flight.
+ *
+ * \param ctx  A pointer to the cache instance
+ *
+ * \return the number of sectors loaded
+ */
+int msc_flash_cache_prefetch(msc_flash_cache_t *ctx);
+
+/**
+ * Checks whether msc_flash_cache_prefetch() has work to do.
+ *
+ * \param ctx  A pointer to the cache instance
+ *
+ * \return non-zero if a read-ahead is pending
+ */
+int msc_flash_cache_prefetch_pending(msc_flash_cache_t *ctx);
+
+/**
+ * Writes all dirty sectors back to flash.
+ *
+ * \param ctx  A pointer to the cache instance
+ *
+ * \return the number of sectors written back
+ */
+int msc_flash_cache_flush(msc_flash_cache_t *ctx);
+
+/**
+ * Checks whether the cache holds data not yet written to flash.
+ *
+ * \param ctx  A pointer to the cache instance
+ *
+ * \return non-zero if any sector is dirty
+ */
+int msc_flash_cache_dirty(msc_flash_cache_t *ctx);
+
+/**
+ * Drops all clean lines. Dirty lines are written back first.
+ *
+ * \param ctx  A pointer to the cache instance
+ */
+void msc_flash_cache_invalidate(msc_flash_cache_t *ctx);
+
+/**
+ * Gets a snapshot of the cache statistics.
+ *
+ * \param ctx    A pointer to the cache instance
+ * \param stats  A pointer to the struct to populate
+ */
+void msc_flash_cache_stats_get(msc_flash_cache_t *ctx, msc_flash_cache_stats_t *stats);
+
+/**@}*/
+
+#endif /* MSC_FLASH_CACHE_H_ */
@@ -0,0 +1,241 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "rtos_qspi_flash.h"
+#include "msc_flash_disk.h"
+#include "tusb.h"
+
+#if CFG_TUD_MSC
+
+#define SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL   0x1E
+#define SCSI_CMD_SYNCHRONIZE_CACHE_10           0x35
+
+#define DISK_BLOCK_NUM  (MSC_FLASH_DISK_SIZE / MSC_FLASH_BLOCK_SIZE)
+
+static msc_flash_cache_t disk_cache;
+static SemaphoreHandle_t disk_lock = NULL;
+static TaskHandle_t disk_task = NULL;
+static rtos_qspi_flash_t *qspi_ctx = NULL;
+static TickType_t last_write_tick = 0;
+
+// whether host does safe-eject
+static bool ejected = false;
+
+size_t msc_flash_cache_flash_read(void *app_data, unsigned addr, uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_read((rtos_qspi_flash_t *) app_data, buf, addr, len);
+    return len;
+}
+
+size_t msc_flash_cache_flash_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    rtos_qspi_flash_write((rtos_qspi_flash_t *) app_data, (uint8_t *) buf, addr, len);
+    return len;
+}
+
+void msc_flash_cache_flash_erase(void *app_data, unsigned addr, size_t len)
+{
+    rtos_qspi_flash_erase((rtos_qspi_flash_t *) app_data, addr, len);
+}
+
+static void disk_flush(void)
+{
+    /* Hold the driver lock so the erase and program sequence is not interleaved with other flash users */
+    rtos_qspi_flash_lock(qspi_ctx);
+    msc_flash_cache_flush(&disk_cache);
+    rtos_qspi_flash_unlock(qspi_ctx);
+}
+
+static void msc_flash_disk_task(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MSC_FLASH_DISK_IDLE_FLUSH_MS));
+
+        xSemaphoreTake(disk_lock, portMAX_DELAY);
+        if (notified) {
+            msc_flash_cache_prefetch(&disk_cache);
+        } else if (msc_flash_cache_dirty(&disk_cache) &&
+                   (xTaskGetTickCount() - last_write_tick) >= pdMS_TO_TICKS(MSC_FLASH_DISK_IDLE_FLUSH_MS)) {
+            disk_flush();
+
+#if MSC_FLASH_DISK_STATS_PRINT
+            msc_flash_cache_stats_t *s = &disk_cache.stats;
+            rtos_printf("msc flash: rd %u blk (%u hit, %u miss, %u/%u prefetch used), wr %u blk -> %u sector writes (%u filled)\n",
+                        s->read_blocks, s->read_hits, s->read_misses, s->prefetch_hits, s->prefetches,
+                        s->write_blocks, s->write_backs, s->write_fills);
+#endif
+        }
+        xSemaphoreGive(disk_lock);
+    }
+}
+
+void msc_flash_disk_init(rtos_qspi_flash_t *ctx, unsigned priority)
+{
+    qspi_ctx = ctx;
+    msc_flash_cache_init(&disk_cache, MSC_FLASH_DISK_BASE_ADDR, DISK_BLOCK_NUM, ctx);
+
+    disk_lock = xSemaphoreCreateMutex();
+    xTaskCreate((TaskFunction_t) msc_flash_disk_task,
+                "msc_flash_disk",
+                portTASK_STACK_DEPTH(msc_flash_disk_task),
+                NULL,
+                priority,
+                &disk_task);
+}
+
+void msc_flash_disk_stats_get(msc_flash_cache_stats_t *stats)
+{
+    xSemaphoreTake(disk_lock, portMAX_DELAY);
+    msc_flash_cache_stats_get(&disk_cache, stats);
+    xSemaphoreGive(disk_lock);
+}
+
+// Invoked when received SCSI_CMD_INQUIRY
+// Application fill vendor id, product id and revision with string up to 8, 16, 4 characters respectively
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+    (void) lun;
+
+    const char vid[] = "XMOS";
+    const char pid[] = "Flash Storage";
+    const char rev[] = "1.0";
+
+    memcpy(vendor_id  , vid, strlen(vid));
+    memcpy(product_id , pid, strlen(pid));
+    memcpy(product_rev, rev, strlen(rev));
+}
+
+// Invoked when received Test Unit Ready command.
+// return true allowing host to read/write this LUN e.g SD card inserted
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+    if (ejected || disk_lock == NULL) {
+        // Additional Sense 3A-00 is NOT_FOUND
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3a, 0x00);
+        return false;
+    }
+
+    return true;
+}
+
+// Invoked when received SCSI_CMD_READ_CAPACITY_10 and SCSI_CMD_READ_FORMAT_CAPACITY to determine the disk size
+// Application update block count and block size
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size)
+{
+    (void) lun;
+
+    *block_count = DISK_BLOCK_NUM;
+    *block_size  = MSC_FLASH_BLOCK_SIZE;
+}
+
+// Invoked when received Start Stop Unit command
+// - Start = 0 : stopped power mode, if load_eject = 1 : unload disk storage
+// - Start = 1 : active mode, if load_eject = 1 : load disk storage
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
+{
+    (void) lun;
+    (void) power_condition;
+
+    if (load_eject) {
+        xSemaphoreTake(disk_lock, portMAX_DELAY);
+        if (start) {
+            msc_flash_cache_invalidate(&disk_cache);
+            ejected = false;
+        } else {
+            disk_flush();
+            ejected = true;
+        }
+        xSemaphoreGive(disk_lock);
+    }
+
+    return true;
+}
+
+// Callback invoked when received READ10 command.
+// Copy disk's data to buffer (up to bufsize) and return number of copied bytes.
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+    (void) lun;
+    int32_t ret;
+    int prefetch;
+
+    xSemaphoreTake(disk_lock, portMAX_DELAY);
+    /* A miss may evict a dirty sector, which is erased and programmed as in disk_flush() */
+    rtos_qspi_flash_lock(qspi_ctx);
+    ret = msc_flash_cache_read(&disk_cache, lba, offset, buffer, bufsize);
+    rtos_qspi_flash_unlock(qspi_ctx);
+    prefetch = msc_flash_cache_prefetch_pending(&disk_cache);
+    xSemaphoreGive(disk_lock);
+
+    /* Read ahead while this buffer is on the wire */
+    if (prefetch) {
+        xTaskNotifyGive(disk_task);
+    }
+
+    return ret;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun)
+{
+    (void) lun;
+
+    return true;
+}
+
+// Callback invoked when received WRITE10 command.
+// Process data in buffer to disk's storage and return number of written bytes
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+    (void) lun;
+    int32_t ret;
+
+    xSemaphoreTake(disk_lock, portMAX_DELAY);
+    /* A miss may evict a dirty sector, which is erased and programmed as in disk_flush() */
+    rtos_qspi_flash_lock(qspi_ctx);
+    ret = msc_flash_cache_write(&disk_cache, lba, offset, buffer, bufsize);
+    rtos_qspi_flash_unlock(qspi_ctx);
+    last_write_tick = xTaskGetTickCount();
+    xSemaphoreGive(disk_lock);
+
+    return ret;
+}
+
+// Callback invoked when received an SCSI command not in built-in list below
+// - READ_CAPACITY10, READ_FORMAT_CAPACITY, INQUIRY, MODE_SENSE6, REQUEST_SENSE
+// - READ10 and WRITE10 has their own callbacks
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize)
+{
+    (void) buffer;
+    (void) bufsize;
+
+    int32_t resplen = 0;
+
+    switch (scsi_cmd[0]) {
+    case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+    case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+        xSemaphoreTake(disk_lock, portMAX_DELAY);
+        disk_flush();
+        xSemaphoreGive(disk_lock);
+        break;
+
+    default:
+        // Set Sense = Invalid Command Operation
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+
+        // negative means error -> tinyusb could stall and/or response with failed status
+        resplen = -1;
+        break;
+    }
+
+    return resplen;
+}
+
+#endif
@@ -0,0 +1,46 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef MSC_FLASH_DISK_H_
+#define MSC_FLASH_DISK_H_
+
+#include "rtos_qspi_flash.h"
+#include "msc_flash_cache.h"
+
+/* Flash region exposed to the host as LUN 0 */
+#ifndef MSC_FLASH_DISK_BASE_ADDR
+#define MSC_FLASH_DISK_BASE_ADDR        0x400000
+#endif
+
+#ifndef MSC_FLASH_DISK_SIZE
+#define MSC_FLASH_DISK_SIZE             (1024 * 1024)
+#endif
+
+/* Dirty sectors are written back once no write has been seen for this long */
+#ifndef MSC_FLASH_DISK_IDLE_FLUSH_MS
+#define MSC_FLASH_DISK_IDLE_FLUSH_MS    500
+#endif
+
+/* Set to 1 to print the cache statistics after each idle write back */
+#ifndef MSC_FLASH_DISK_STATS_PRINT
+#define MSC_FLASH_DISK_STATS_PRINT      0
+#endif
+
+/**
+ * Starts the flash disk service task, which performs read-ahead and idle
+ * write back for the MSC callbacks.
+ *
+ * \param qspi_ctx  A pointer to the QSPI flash driver instance
+ * \param priority  The priority of the service task. Should be lower than
+ *                  the USB task so read-ahead overlaps USB transfers.
+ */
+void msc_flash_disk_init(rtos_qspi_flash_t *qspi_ctx, unsigned priority);
+
+/**
+ * Gets a snapshot of the flash disk cache statistics.
+ *
+ * \param stats  A pointer to the struct to populate
+ */
+void msc_flash_disk_stats_get(msc_flash_cache_stats_t *stats);
+
+#endif /* MSC_FLASH_DISK_H_ */
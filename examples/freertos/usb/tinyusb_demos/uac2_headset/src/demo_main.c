@@ -32,6 +32,7 @@
 #include "tusb.h"
 
 #include "usb_descriptors.h"
+#include "uac2_stream.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTOTYPES
@@ -89,17 +90,13 @@ static uint32_t led_val = 0;
 int8_t mute[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1];       // +1 for master channel 0
 int16_t volume[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1];    // +1 for master channel 0
 
-// Buffer for microphone data
-int32_t mic_buf[CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ / 4];
 // Buffer for speaker data
 int32_t spk_buf[CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ / 4];
-// Speaker data size received in the last frame
-int spk_data_size;
 // Resolution per format
-const uint8_t resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_RX,
-                                                                        CFG_TUD_AUDIO_FUNC_1_FORMAT_2_RESOLUTION_RX};
-// Current resolution, update on format change
-uint8_t current_resolution;
+const uint8_t spk_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_RX,
+                                                                            CFG_TUD_AUDIO_FUNC_1_FORMAT_2_RESOLUTION_RX};
+const uint8_t mic_resolutions_per_format[CFG_TUD_AUDIO_FUNC_1_N_FORMATS] = {CFG_TUD_AUDIO_FUNC_1_FORMAT_1_RESOLUTION_TX,
+                                                                            CFG_TUD_AUDIO_FUNC_1_FORMAT_2_RESOLUTION_TX};
 
 //--------------------------------------------------------------------+
 // Device callbacks
@@ -188,7 +185,14 @@ static bool tud_audio_clock_set_request(uint8_t rhport, audio_control_request_t
   {
     TU_VERIFY(request->wLength == sizeof(audio_control_cur_4_t));
 
-    current_sample_rate = ((audio_control_cur_4_t const *)buf)->bCur;
+    uint32_t rate = ((audio_control_cur_4_t const *)buf)->bCur;
+    uint8_t i;
+
+    for(i = 0; i < N_SAMPLE_RATES && sample_rates[i] != rate; i++);
+    TU_VERIFY(i < N_SAMPLE_RATES);
+
+    current_sample_rate = rate;
+    uac2_stream_rate_set(current_sample_rate);
 
     TU_LOG1("Clock set current freq: %d\r\n", current_sample_rate);
 
@@ -318,7 +322,12 @@ bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const
   uint8_t const alt = tu_u16_low(tu_le16toh(p_request->wValue));
 
   if (ITF_NUM_AUDIO_STREAMING_SPK == itf && alt == 0)
+  {
     xTimerChangePeriod(blinky_timer_ctx, pdMS_TO_TICKS(BLINK_MOUNTED), 0);
+    uac2_stream_spk_format_set(0);
+  }
+  if (ITF_NUM_AUDIO_STREAMING_MIC == itf && alt == 0)
+    uac2_stream_mic_format_set(0);
 
   return true;
 }
@@ -333,11 +342,18 @@ bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const * p_reque
   if (ITF_NUM_AUDIO_STREAMING_SPK == itf && alt != 0)
       xTimerChangePeriod(blinky_timer_ctx, pdMS_TO_TICKS(BLINK_STREAMING), 0);
 
-  // Clear buffer when streaming format is changed
-  spk_data_size = 0;
-  if(alt != 0)
+  // Restart the stream when the format changes
+  if (ITF_NUM_AUDIO_STREAMING_SPK == itf)
+  {
+    uac2_stream_spk_format_set(alt != 0 ? spk_resolutions_per_format[alt-1] : 0);
+#if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
+    if (alt != 0)
+      tud_audio_fb_set(uac2_stream_feedback(tud_speed_get() == TUSB_SPEED_HIGH));
+#endif
+  }
+  else if (ITF_NUM_AUDIO_STREAMING_MIC == itf)
   {
-    current_resolution = resolutions_per_format[alt-1];
+    uac2_stream_mic_format_set(alt != 0 ? mic_resolutions_per_format[alt-1] : 0);
   }
 
   return true;
@@ -350,7 +366,7 @@ bool tud_audio_rx_done_pre_read_cb(uint8_t rhport, uint16_t n_bytes_received, ui
   (void)ep_out;
   (void)cur_alt_setting;
 
-  spk_data_size = tud_audio_read(spk_buf, n_bytes_received);
+  uac2_stream_spk_rx(spk_buf, tud_audio_read(spk_buf, n_bytes_received));
   return true;
 }
 
@@ -361,60 +377,19 @@ bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, u
   (void)ep_in;
   (void)cur_alt_setting;
 
-  // This callback could be used to fill microphone data separately
+  uac2_stream_mic_tx();
   return true;
 }
 
-//--------------------------------------------------------------------+
-// AUDIO Task
-//--------------------------------------------------------------------+
-
-void audio_task(void)
+#if CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP
+// Invoked when the previous feedback value has been sent, queue the next one
+void tud_audio_fb_done_cb(uint8_t rhport)
 {
-  // When new data arrived, copy data from speaker buffer, to microphone buffer
-  // and send it over
-  // Only support speaker & headphone both have the same resolution
-  // If one is 16bit another is 24bit be care of LOUD noise !
-  if (spk_data_size)
-  {
-    if (current_resolution == 16)
-    {
-      int16_t *src = (int16_t*)spk_buf;
-      int16_t *limit = (int16_t*)spk_buf + spk_data_size / 2;
-      int16_t *dst = (int16_t*)mic_buf;
-      while (src < limit)
-      {
-        // Combine two channels into one
-        int32_t left = *src++;
-        int32_t right = *src++;
-        *dst++ = (left >> 1) + (right >> 1);
-      }
-      tud_audio_write((uint8_t *)mic_buf, spk_data_size / 2);
-      spk_data_size = 0;
-    }
-    else if (current_resolution == 24)
-    {
-      int32_t *src = spk_buf;
-      int32_t *limit = spk_buf + spk_data_size / 4;
-      int32_t *dst = mic_buf;
-      while (src < limit)
-      {
-        // Combine two channels into one
-        int32_t left = *src++;
-        int32_t right = *src++;
-        *dst++ = ((left >> 1) + (right >> 1)) & 0xffffff00;
-      }
-      tud_audio_write((uint8_t *)mic_buf, spk_data_size / 2);
-      spk_data_size = 0;
-    }
-  }
-}
+  (void)rhport;
 
-static void audio_task_wrapper(void *arg) {
-    while(1) {
-        audio_task();
-    }
+  tud_audio_fb_set(uac2_stream_feedback(tud_speed_get() == TUSB_SPEED_HIGH));
 }
+#endif
 
 void led_blinky_cb(TimerHandle_t xTimer)
 {
@@ -451,11 +426,6 @@ void create_tinyusb_demo(rtos_gpio_t *ctx, unsigned priority)
                                         led_blinky_cb);
         xTimerStart(blinky_timer_ctx, 0);
 
-        xTaskCreate((TaskFunction_t) audio_task_wrapper,
-                    "audio_task",
-                    portTASK_STACK_DEPTH(audio_task_wrapper),
-                    NULL,
-                    priority,
-                    NULL);
+        uac2_stream_init(current_sample_rate, priority);
     }
 }
@@ -0,0 +1,78 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "compiler_barrier.h"
+#include "sample_fifo.h"
+
+void sample_fifo_init(sample_fifo_t *ctx, int32_t *buf, size_t size)
+{
+    ctx->buf = buf;
+    ctx->mask = size - 1;
+    ctx->wr = 0;
+    ctx->rd = 0;
+}
+
+size_t sample_fifo_write(sample_fifo_t *ctx, const int32_t *src, size_t n)
+{
+    const uint32_t wr = ctx->wr;
+    const size_t space = ctx->mask + 1 - (wr - ctx->rd);
+    size_t first;
+
+    if (n > space) {
+        n = space;
+    }
+
+    first = ctx->mask + 1 - (wr & ctx->mask);
+    if (first > n) {
+        first = n;
+    }
+    memcpy(&ctx->buf[wr & ctx->mask], src, first * sizeof(int32_t));
+    memcpy(ctx->buf, src + first, (n - first) * sizeof(int32_t));
+
+    /* The samples must be in the buffer before the write index publishes them */
+    COMPILER_BARRIER();
+    ctx->wr = wr + n;
+
+    return n;
+}
+
+size_t sample_fifo_read(sample_fifo_t *ctx, int32_t *dst, size_t n)
+{
+    const uint32_t rd = ctx->rd;
+    const size_t level = ctx->wr - rd;
+    size_t first;
+
+    if (n > level) {
+        n = level;
+    }
+
+    /* Only read the samples that the write index has published */
+    COMPILER_BARRIER();
+    first = ctx->mask + 1 - (rd & ctx->mask);
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, &ctx->buf[rd & ctx->mask], first * sizeof(int32_t));
+    memcpy(dst + first, ctx->buf, (n - first) * sizeof(int32_t));
+
+    /* The samples must be copied out before the read index frees their space */
+    COMPILER_BARRIER();
+    ctx->rd = rd + n;
+
+    return n;
+}
+
+size_t sample_fifo_skip(sample_fifo_t *ctx, size_t n)
+{
+    const uint32_t rd = ctx->rd;
+    const size_t level = ctx->wr - rd;
+
+    if (n > level) {
+        n = level;
+    }
+    ctx->rd = rd + n;
+
+    return n;
+}
@@ -0,0 +1,108 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SAMPLE_FIFO_H_
+#define SAMPLE_FIFO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup sample_fifo
+ *
+ * A lock-free single producer, single consumer FIFO of 32-bit audio samples.
+ *
+ * The producer only ever writes the write index and the consumer only ever
+ * writes the read index, so one task or ISR may push while another pops
+ * without any locking. Both indices run freely and are masked on access, so
+ * the capacity must be a power of two.
+ * @{
+ */
+
+/**
+ * Typedef to the sample FIFO instance struct.
+ */
+typedef struct sample_fifo_struct sample_fifo_t;
+
+/**
+ * Struct representing a sample FIFO instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct sample_fifo_struct {
+    int32_t *buf;
+    uint32_t mask;
+    volatile uint32_t wr;
+    volatile uint32_t rd;
+};
+
+/**
+ * Initializes a sample FIFO.
+ *
+ * \param ctx   A pointer to the FIFO instance
+ * \param buf   A pointer to the sample storage
+ * \param size  The number of samples in \p buf. Must be a power of two.
+ */
+void sample_fifo_init(sample_fifo_t *ctx, int32_t *buf, size_t size);
+
+/**
+ * Gets the number of samples available to read. May be called from
+ * either side.
+ *
+ * \param ctx  A pointer to the FIFO instance
+ *
+ * \return the number of samples in the FIFO
+ */
+static inline size_t sample_fifo_level(const sample_fifo_t *ctx)
+{
+    return ctx->wr - ctx->rd;
+}
+
+/**
+ * Gets the number of samples that can be written. May be called from
+ * either side.
+ *
+ * \param ctx  A pointer to the FIFO instance
+ *
+ * \return the free space in samples
+ */
+static inline size_t sample_fifo_space(const sample_fifo_t *ctx)
+{
+    return ctx->mask + 1 - (ctx->wr - ctx->rd);
+}
+
+/**
+ * Writes samples to the FIFO. Producer side only.
+ *
+ * \param ctx   A pointer to the FIFO instance
+ * \param src   A pointer to the samples to write
+ * \param n     The number of samples to write
+ *
+ * \return the number of samples written, less than \p n if the FIFO is full
+ */
+size_t sample_fifo_write(sample_fifo_t *ctx, const int32_t *src, size_t n);
+
+/**
+ * Reads samples from the FIFO. Consumer side only.
+ *
+ * \param ctx   A pointer to the FIFO instance
+ * \param dst   A pointer to the buffer to read into
+ * \param n     The number of samples to read
+ *
+ * \return the number of samples read, less than \p n if the FIFO runs empty
+ */
+size_t sample_fifo_read(sample_fifo_t *ctx, int32_t *dst, size_t n);
+
+/**
+ * Discards samples from the FIFO. Consumer side only.
+ *
+ * \param ctx   A pointer to the FIFO instance
+ * \param n     The number of samples to discard, or SIZE_MAX for all
+ *
+ * \return the number of samples discarded
+ */
+size_t sample_fifo_skip(sample_fifo_t *ctx, size_t n);
+
+/**@}*/
+
+#endif /* SAMPLE_FIFO_H_ */
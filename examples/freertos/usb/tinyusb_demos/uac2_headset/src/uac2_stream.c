@@ -0,0 +1,458 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <platform.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "rtos_printf.h"
+#include "sample_fifo.h"
+#include "uac2_stream.h"
+#include "tusb.h"
+
+#if UAC2_STREAM_ASRC
+#include "src.h"
+#include "src_rate_est.h"
+#endif
+
+#define SPK_CH  UAC2_STREAM_SPK_CHANNELS
+#define MIC_CH  UAC2_STREAM_MIC_CHANNELS
+
+#define SPK_TARGET_FRAMES   (UAC2_STREAM_SPK_FIFO_FRAMES / 2)
+#define MIC_TARGET_FRAMES   (UAC2_STREAM_MIC_FIFO_FRAMES / 2)
+
+#define MAX_RATE            TU_MAX(CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE, UAC2_STREAM_DEVICE_RATE)
+
+/* Frames the audio task will process in one period, allowing it to catch up after a late wakeup */
+#define MAX_DUE_FRAMES      (4 * UAC2_STREAM_PERIOD_MS * ((MAX_RATE + 999) / 1000))
+
+#define LOOPBACK_CHUNK_FRAMES 32
+
+#define MIC_PKT_MAX_BYTES   CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX
+#define SPK_PKT_MAX_SAMPLES (CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ / 2)
+
+static struct {
+    /* Written by the USB callbacks */
+    volatile uint32_t usb_rate;
+    volatile uint8_t spk_res;
+    volatile uint8_t mic_res;
+    volatile uint32_t generation;
+
+    /* Written by the audio task */
+    volatile int running;
+    volatile int32_t spk_level_q8;
+
+    uac2_stream_stats_t stats;
+} stream;
+
+static int32_t spk_fifo_buf[UAC2_STREAM_SPK_FIFO_FRAMES * SPK_CH];
+static int32_t mic_fifo_buf[UAC2_STREAM_MIC_FIFO_FRAMES * MIC_CH];
+static sample_fifo_t spk_fifo;
+static sample_fifo_t mic_fifo;
+
+/* USB task side microphone state */
+static uint32_t mic_acc;
+static int mic_primed;
+
+#if UAC2_STREAM_ASRC
+
+#define ASRC_BLOCK_FRAMES       4
+#define ASRC_MAX_OUT_FRAMES     (ASRC_BLOCK_FRAMES * 5)
+
+static asrc_state_t asrc_state[SPK_CH];
+static int asrc_stack[SPK_CH][ASRC_STACK_LENGTH_MULT * ASRC_BLOCK_FRAMES];
+static asrc_ctrl_t asrc_ctrl[SPK_CH];
+static asrc_adfir_coefs_t asrc_adfir_coefs;
+
+/* Input over output rate in Q4.28, steered by the rate estimator to hold the speaker FIFO at its target */
+static src_rate_est_t asrc_rate_est;
+static volatile unsigned asrc_ratio;
+
+static int32_t asrc_out[(MAX_DUE_FRAMES + ASRC_MAX_OUT_FRAMES) * SPK_CH];
+static size_t asrc_out_frames;
+
+static fs_code_t asrc_fs_code(uint32_t rate)
+{
+    switch (rate) {
+    case 44100:  return FS_CODE_44;
+    case 88200:  return FS_CODE_88;
+    case 96000:  return FS_CODE_96;
+    case 176400: return FS_CODE_176;
+    case 192000: return FS_CODE_192;
+    default:     return FS_CODE_48;
+    }
+}
+
+static void asrc_restart(uint32_t in_rate, uint32_t out_rate)
+{
+    src_rate_est_config_t config;
+    unsigned nominal_ratio;
+
+    for (int ch = 0; ch < SPK_CH; ch++) {
+        asrc_ctrl[ch].psState = &asrc_state[ch];
+        asrc_ctrl[ch].piStack = asrc_stack[ch];
+        asrc_ctrl[ch].piADCoefs = asrc_adfir_coefs.iASRCADFIRCoefs;
+    }
+    nominal_ratio = asrc_init(asrc_fs_code(in_rate), asrc_fs_code(out_rate),
+                              asrc_ctrl, SPK_CH, ASRC_BLOCK_FRAMES, OFF);
+    asrc_out_frames = 0;
+
+    src_rate_est_config_default(&config, nominal_ratio, in_rate, out_rate,
+                                PLATFORM_REFERENCE_HZ, SPK_TARGET_FRAMES);
+    src_rate_est_init(&asrc_rate_est, &config);
+    asrc_ratio = nominal_ratio;
+    stream.stats.asrc_locked = 0;
+}
+#endif
+
+__attribute__((weak))
+void uac2_stream_device_out(const int32_t *frames, size_t n_frames)
+{
+    (void) frames;
+    (void) n_frames;
+}
+
+static size_t frames_due(uint64_t *acc, uint32_t elapsed_ticks, uint32_t rate)
+{
+    size_t n;
+
+    *acc += (uint64_t) elapsed_ticks * rate;
+    n = *acc / PLATFORM_REFERENCE_HZ;
+    *acc -= (uint64_t) n * PLATFORM_REFERENCE_HZ;
+
+    return n;
+}
+
+/* Downmixes speaker frames into the microphone FIFO */
+static void mic_loopback(const int32_t *frames, size_t n_frames)
+{
+    int32_t mono[LOOPBACK_CHUNK_FRAMES * MIC_CH];
+
+    if (stream.mic_res == 0) {
+        return;
+    }
+
+    while (n_frames > 0) {
+        const size_t n = n_frames < LOOPBACK_CHUNK_FRAMES ? n_frames : LOOPBACK_CHUNK_FRAMES;
+        size_t written;
+
+        for (size_t i = 0; i < n; i++) {
+            int64_t sum = 0;
+            for (int ch = 0; ch < SPK_CH; ch++) {
+                sum += frames[ch];
+            }
+            for (int ch = 0; ch < MIC_CH; ch++) {
+                mono[i * MIC_CH + ch] = (int32_t) (sum / SPK_CH);
+            }
+            frames += SPK_CH;
+        }
+
+        written = sample_fifo_write(&mic_fifo, mono, n * MIC_CH);
+        stream.stats.mic_overruns += n - written / MIC_CH;
+        n_frames -= n;
+    }
+}
+
+static void stream_restart(uint32_t *rate, uint32_t *dev_rate)
+{
+    const uac2_stream_stats_t *s = &stream.stats;
+
+    if (s->spk_frames || s->mic_frames) {
+        rtos_printf("uac2: spk %u frames (%u over, %u under), mic %u frames (%u over, %u under), fb 0x%x\n",
+                    s->spk_frames, s->spk_overruns, s->spk_underruns,
+                    s->mic_frames, s->mic_overruns, s->mic_underruns, s->feedback);
+    }
+
+    sample_fifo_skip(&spk_fifo, SIZE_MAX);
+    stream.running = 0;
+    stream.spk_level_q8 = 0;
+    stream.stats.restarts++;
+
+    *rate = stream.usb_rate;
+    *dev_rate = (UAC2_STREAM_ASRC && UAC2_STREAM_DEVICE_RATE) ? UAC2_STREAM_DEVICE_RATE : *rate;
+
+#if UAC2_STREAM_ASRC
+    asrc_restart(*rate, *dev_rate);
+#endif
+}
+
+/*
+ * Fills frames with due frames from the speaker FIFO and feeds the microphone
+ * loopback. Returns the number of frames that were available, the rest are
+ * silence.
+ */
+static size_t spk_pull(int32_t *frames, size_t due)
+{
+#if UAC2_STREAM_ASRC
+    while (asrc_out_frames < due) {
+        int32_t in[ASRC_BLOCK_FRAMES * SPK_CH];
+
+        if (sample_fifo_level(&spk_fifo) < ASRC_BLOCK_FRAMES * SPK_CH) {
+            break;
+        }
+        sample_fifo_read(&spk_fifo, in, ASRC_BLOCK_FRAMES * SPK_CH);
+        mic_loopback(in, ASRC_BLOCK_FRAMES);
+        asrc_out_frames += asrc_process((int *) in, (int *) &asrc_out[asrc_out_frames * SPK_CH],
+                                        asrc_ratio, asrc_ctrl);
+    }
+
+    const size_t got = asrc_out_frames < due ? asrc_out_frames : due;
+    memcpy(frames, asrc_out, got * SPK_CH * sizeof(int32_t));
+    asrc_out_frames -= got;
+    memmove(asrc_out, &asrc_out[got * SPK_CH], asrc_out_frames * SPK_CH * sizeof(int32_t));
+#else
+    const size_t got = sample_fifo_read(&spk_fifo, frames, due * SPK_CH) / SPK_CH;
+#endif
+
+    memset(&frames[got * SPK_CH], 0, (due - got) * SPK_CH * sizeof(int32_t));
+
+#if !UAC2_STREAM_ASRC
+    /* Device and host rates match, so the loopback runs from the device clock */
+    mic_loopback(frames, due);
+#endif
+
+    return got;
+}
+
+static void uac2_stream_task(void *arg)
+{
+    static int32_t frames[MAX_DUE_FRAMES * SPK_CH];
+    static int32_t silence[MAX_DUE_FRAMES * SPK_CH];
+    uint64_t dev_acc = 0;
+    uint64_t usb_acc = 0;
+    uint32_t rate = 0;
+    uint32_t dev_rate = 0;
+    uint32_t generation = stream.generation - 1;
+    uint32_t last = get_reference_time();
+    TickType_t wake = xTaskGetTickCount();
+
+    (void) arg;
+
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(UAC2_STREAM_PERIOD_MS));
+
+        const uint32_t now = get_reference_time();
+        const uint32_t elapsed = now - last;
+        last = now;
+
+        if (generation != stream.generation) {
+            generation = stream.generation;
+            stream_restart(&rate, &dev_rate);
+            dev_acc = 0;
+            usb_acc = 0;
+        }
+
+        size_t dev_due = frames_due(&dev_acc, elapsed, dev_rate);
+        size_t usb_due = frames_due(&usb_acc, elapsed, rate);
+        if (dev_due > MAX_DUE_FRAMES) {
+            dev_due = MAX_DUE_FRAMES;
+        }
+        if (usb_due > MAX_DUE_FRAMES) {
+            usb_due = MAX_DUE_FRAMES;
+        }
+
+        const size_t level = sample_fifo_level(&spk_fifo) / SPK_CH;
+
+        if (!stream.running && stream.spk_res != 0 && level >= SPK_TARGET_FRAMES) {
+            stream.spk_level_q8 = level << 8;
+            stream.running = 1;
+        }
+
+        if (stream.running) {
+            if (spk_pull(frames, dev_due) < dev_due) {
+                /* Ran dry, play out the partial period and wait for the FIFO to refill */
+                stream.stats.spk_underruns++;
+                stream.running = 0;
+            }
+            uac2_stream_device_out(frames, dev_due);
+
+            const int32_t level_q8 = (sample_fifo_level(&spk_fifo) / SPK_CH) << 8;
+            stream.spk_level_q8 += (level_q8 - stream.spk_level_q8) >> 3;
+
+#if UAC2_STREAM_ASRC
+            /* The estimator compensates and smooths the level itself */
+            asrc_ratio = src_rate_est_update(&asrc_rate_est, level_q8, get_reference_time());
+            stream.stats.asrc_ratio = asrc_ratio;
+            stream.stats.asrc_locked = src_rate_est_locked(&asrc_rate_est);
+#endif
+        } else {
+            uac2_stream_device_out(silence, dev_due);
+            mic_loopback(silence, usb_due);
+        }
+
+#if UAC2_STREAM_ASRC
+        /* The device clock runs whether or not the stream does */
+        src_rate_est_out_timestamp(&asrc_rate_est, dev_due, now);
+#endif
+    }
+}
+
+void uac2_stream_init(uint32_t rate, unsigned priority)
+{
+    sample_fifo_init(&spk_fifo, spk_fifo_buf, UAC2_STREAM_SPK_FIFO_FRAMES * SPK_CH);
+    sample_fifo_init(&mic_fifo, mic_fifo_buf, UAC2_STREAM_MIC_FIFO_FRAMES * MIC_CH);
+    stream.usb_rate = rate;
+
+    xTaskCreate((TaskFunction_t) uac2_stream_task,
+                "uac2_stream",
+                portTASK_STACK_DEPTH(uac2_stream_task),
+                NULL,
+                priority,
+                NULL);
+}
+
+void uac2_stream_rate_set(uint32_t rate)
+{
+    if (rate != stream.usb_rate) {
+        stream.usb_rate = rate;
+        stream.generation++;
+    }
+}
+
+void uac2_stream_spk_format_set(uint8_t resolution)
+{
+    if (resolution != stream.spk_res) {
+        stream.spk_res = resolution;
+        stream.generation++;
+    }
+}
+
+void uac2_stream_mic_format_set(uint8_t resolution)
+{
+    /* The USB task is the microphone FIFO consumer, so it may flush it here */
+    stream.mic_res = resolution;
+    sample_fifo_skip(&mic_fifo, SIZE_MAX);
+    mic_acc = 0;
+    mic_primed = 0;
+}
+
+void uac2_stream_spk_rx(const void *buf, size_t len)
+{
+    static int32_t samples[SPK_PKT_MAX_SAMPLES];
+    const int32_t *src;
+    size_t n;
+
+    if (stream.spk_res == 0) {
+        return;
+    }
+
+    if (stream.spk_res > 16) {
+        /* 24 bit samples arrive left justified in 32 bit slots */
+        src = buf;
+        n = len / sizeof(int32_t);
+    } else {
+        const int16_t *in = buf;
+        n = len / sizeof(int16_t);
+        if (n > SPK_PKT_MAX_SAMPLES) {
+            n = SPK_PKT_MAX_SAMPLES;
+        }
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = (int32_t) in[i] << 16;
+        }
+        src = samples;
+    }
+
+    n -= n % SPK_CH;
+    const size_t written = sample_fifo_write(&spk_fifo, src, n);
+    stream.stats.spk_frames += n / SPK_CH;
+    stream.stats.spk_overruns += (n - written) / SPK_CH;
+
+#if UAC2_STREAM_ASRC
+    src_rate_est_in_timestamp(&asrc_rate_est, written / SPK_CH, get_reference_time());
+#endif
+}
+
+void uac2_stream_mic_tx(void)
+{
+    static int32_t samples[MIC_PKT_MAX_BYTES / 2];
+    static uint32_t pkt[MIC_PKT_MAX_BYTES / sizeof(uint32_t)];
+    const uint8_t res = stream.mic_res;
+    const size_t bytes = res > 16 ? 4 : 2;
+    const size_t max_frames = MIC_PKT_MAX_BYTES / (bytes * MIC_CH);
+    const uint32_t pkt_rate = tud_speed_get() == TUSB_SPEED_HIGH ? 8000 : 1000;
+    size_t level;
+    size_t got = 0;
+    size_t n;
+
+    if (res == 0) {
+        return;
+    }
+
+    /* Nominal frames per packet, nudged by one to hold the FIFO at its target */
+    mic_acc += stream.usb_rate;
+    n = mic_acc / pkt_rate;
+    mic_acc -= n * pkt_rate;
+
+    level = sample_fifo_level(&mic_fifo) / MIC_CH;
+    if (!mic_primed && level >= MIC_TARGET_FRAMES) {
+        mic_primed = 1;
+    }
+
+    if (mic_primed) {
+        if (level > MIC_TARGET_FRAMES + n) {
+            n++;
+        } else if (level + n < MIC_TARGET_FRAMES && n > 0) {
+            n--;
+        }
+    }
+    if (n > max_frames) {
+        n = max_frames;
+    }
+
+    if (mic_primed) {
+        got = sample_fifo_read(&mic_fifo, samples, n * MIC_CH) / MIC_CH;
+        if (got < n) {
+            stream.stats.mic_underruns++;
+            mic_primed = 0;
+        }
+    }
+    memset(&samples[got * MIC_CH], 0, (n - got) * MIC_CH * sizeof(int32_t));
+
+    if (bytes == 4) {
+        for (size_t i = 0; i < n * MIC_CH; i++) {
+            pkt[i] = samples[i] & 0xffffff00;
+        }
+    } else {
+        int16_t *dst = (int16_t *) pkt;
+        for (size_t i = 0; i < n * MIC_CH; i++) {
+            dst[i] = samples[i] >> 16;
+        }
+    }
+
+    tud_audio_write((uint8_t *) pkt, n * MIC_CH * bytes);
+    stream.stats.mic_frames += n;
+}
+
+uint32_t uac2_stream_feedback(int high_speed)
+{
+    /* Frames per millisecond in Q16 */
+    int64_t fb = ((uint64_t) stream.usb_rate << 16) / 1000;
+
+#if !UAC2_STREAM_ASRC
+    if (stream.running) {
+        const int32_t err_q8 = (SPK_TARGET_FRAMES << 8) - stream.spk_level_q8;
+        const int64_t limit = fb >> 8;
+        int64_t adj = ((int64_t) err_q8 << 8) / UAC2_STREAM_FB_GAIN;
+
+        if (adj > limit) {
+            adj = limit;
+        } else if (adj < -limit) {
+            adj = -limit;
+        }
+        fb += adj;
+    }
+#endif
+
+    /* 16.16 per microframe at high speed, 10.14 per frame at full speed */
+    stream.stats.feedback = high_speed ? (uint32_t) (fb / 8) : (uint32_t) (fb >> 2);
+
+    return stream.stats.feedback;
+}
+
+void uac2_stream_stats_get(uac2_stream_stats_t *stats)
+{
+    *stats = stream.stats;
+}
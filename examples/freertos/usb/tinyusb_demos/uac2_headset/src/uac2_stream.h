@@ -0,0 +1,164 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef UAC2_STREAM_H_
+#define UAC2_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tusb_config.h"
+
+#define UAC2_STREAM_SPK_CHANNELS    CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX
+#define UAC2_STREAM_MIC_CHANNELS    CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
+
+/* Speaker FIFO depth in frames. Streaming starts once it is half full. */
+#ifndef UAC2_STREAM_SPK_FIFO_FRAMES
+#define UAC2_STREAM_SPK_FIFO_FRAMES 1024
+#endif
+
+/* Microphone FIFO depth in frames. */
+#ifndef UAC2_STREAM_MIC_FIFO_FRAMES
+#define UAC2_STREAM_MIC_FIFO_FRAMES 512
+#endif
+
+/* Period of the device audio clock task */
+#ifndef UAC2_STREAM_PERIOD_MS
+#define UAC2_STREAM_PERIOD_MS       1
+#endif
+
+/*
+ * Speaker FIFO error, in frames, that moves the reported feedback rate by
+ * one frame per millisecond.
+ */
+#ifndef UAC2_STREAM_FB_GAIN
+#define UAC2_STREAM_FB_GAIN         64
+#endif
+
+/*
+ * Set to 1 to pass the speaker stream through the lib_src ASRC. The device
+ * side then runs at UAC2_STREAM_DEVICE_RATE, or at the host rate when that
+ * is 0, and the ASRC ratio is set by the lib_src rate estimator from the
+ * packet and device period timestamps and the FIFO level, instead of the
+ * feedback endpoint.
+ */
+#ifndef UAC2_STREAM_ASRC
+#define UAC2_STREAM_ASRC            0
+#endif
+
+#ifndef UAC2_STREAM_DEVICE_RATE
+#define UAC2_STREAM_DEVICE_RATE     0
+#endif
+
+#if (UAC2_STREAM_SPK_FIFO_FRAMES & (UAC2_STREAM_SPK_FIFO_FRAMES - 1)) || \
+    (UAC2_STREAM_MIC_FIFO_FRAMES & (UAC2_STREAM_MIC_FIFO_FRAMES - 1))
+#error UAC2_STREAM_SPK_FIFO_FRAMES and UAC2_STREAM_MIC_FIFO_FRAMES must be powers of two
+#endif
+
+/**
+ * \defgroup uac2_stream
+ *
+ * The audio streaming engine for the UAC2 headset demo.
+ *
+ * Speaker packets from the host are unpacked into a FIFO of 32-bit samples.
+ * A task running from the device audio clock drains it, passes the frames to
+ * uac2_stream_device_out() and loops a mono downmix back into the microphone
+ * FIFO, which is drained one packet at a time as the host polls the IN
+ * endpoint. The speaker FIFO fill level sets the value reported on the
+ * asynchronous feedback endpoint, so the host tracks the device clock and
+ * the FIFO stays centred.
+ *
+ * The USB callbacks and the device audio task never share a lock. Format and
+ * rate changes are published to the audio task, which restarts the stream
+ * at its next period.
+ * @{
+ */
+
+/** Stream statistics. */
+typedef struct {
+    uint32_t spk_frames;        /**< Frames received from the host. */
+    uint32_t spk_overruns;      /**< Frames dropped because the speaker FIFO was full. */
+    uint32_t spk_underruns;     /**< Device periods that ran out of speaker frames. */
+    uint32_t mic_frames;        /**< Frames sent to the host. */
+    uint32_t mic_overruns;      /**< Frames dropped because the microphone FIFO was full. */
+    uint32_t mic_underruns;     /**< Packets padded with silence. */
+    uint32_t restarts;          /**< Stream restarts after a format or rate change. */
+    uint32_t feedback;          /**< Last value returned by uac2_stream_feedback(). */
+    uint32_t asrc_ratio;        /**< Last ASRC input over output rate, Q4.28. 0 without UAC2_STREAM_ASRC. */
+    uint32_t asrc_locked;       /**< Non-zero while the ASRC rate estimator is locked. */
+} uac2_stream_stats_t;
+
+/**
+ * User defined device output function. Receives the speaker frames at the
+ * device rate, interleaved, left justified. The default discards them.
+ *
+ * \param frames    A pointer to the frames
+ * \param n_frames  The number of frames
+ */
+void uac2_stream_device_out(const int32_t *frames, size_t n_frames);
+
+/**
+ * Starts the device audio clock task.
+ *
+ * \param rate      The initial sample rate
+ * \param priority  The priority of the audio task
+ */
+void uac2_stream_init(uint32_t rate, unsigned priority);
+
+/**
+ * Sets the sample rate requested by the host. The caller must have checked
+ * it against the advertised rates.
+ *
+ * \param rate  The new sample rate in Hz
+ */
+void uac2_stream_rate_set(uint32_t rate);
+
+/**
+ * Sets the speaker format after an alternate setting change.
+ *
+ * \param resolution  The sample resolution in bits, or 0 when streaming stops
+ */
+void uac2_stream_spk_format_set(uint8_t resolution);
+
+/**
+ * Sets the microphone format after an alternate setting change.
+ *
+ * \param resolution  The sample resolution in bits, or 0 when streaming stops
+ */
+void uac2_stream_mic_format_set(uint8_t resolution);
+
+/**
+ * Unpacks a speaker packet into the speaker FIFO. Called from
+ * tud_audio_rx_done_pre_read_cb().
+ *
+ * \param buf  A pointer to the packet
+ * \param len  The packet length in bytes
+ */
+void uac2_stream_spk_rx(const void *buf, size_t len);
+
+/**
+ * Writes the next microphone packet with tud_audio_write(). Called from
+ * tud_audio_tx_done_pre_load_cb().
+ */
+void uac2_stream_mic_tx(void);
+
+/**
+ * Computes the value for the feedback endpoint from the speaker FIFO level.
+ *
+ * \param high_speed  Non-zero for 16.16 samples per microframe, zero for
+ *                    10.14 samples per frame
+ *
+ * \return the feedback value
+ */
+uint32_t uac2_stream_feedback(int high_speed);
+
+/**
+ * Gets a snapshot of the stream statistics.
+ *
+ * \param stats  A pointer to the struct to populate
+ */
+void uac2_stream_stats_get(uac2_stream_stats_t *stats);
+
+/**@}*/
+
+#endif /* UAC2_STREAM_H_ */
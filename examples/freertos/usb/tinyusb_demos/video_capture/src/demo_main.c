@@ -33,6 +33,7 @@
 
 #include "tusb.h"
 #include "usb_descriptors.h"
+#include "uvc_frame_pool.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
@@ -89,20 +90,42 @@ void tud_resume_cb(void)
 //--------------------------------------------------------------------+
 // USB Video
 //--------------------------------------------------------------------+
+#define FRAME_BYTES   (FRAME_WIDTH * FRAME_HEIGHT * 16 / 8)
+
+/* Number of frames in the pool. Two lets frame N+1 be produced while
+ * frame N is on the bus. */
+#ifndef VIDEO_FRAMES
+#define VIDEO_FRAMES  2
+#endif
+
+static uvc_frame_pool_t frame_pool;
 static unsigned frame_num = 0;
-static volatile unsigned tx_busy = 0;
-static unsigned interval_ms = 1000 / FRAME_RATE;
+static volatile unsigned interval_ms = 1000 / FRAME_RATE;
 
-/* YUY2 frame buffer */
 #ifdef CFG_EXAMPLE_VIDEO_READONLY
+/* The frames point straight into the scrolling image, so the pool needs no
+ * buffers of its own. */
 #include "images.h"
+static uint8_t *frame_bufs[VIDEO_FRAMES];
+
+static void produce_frame(uvc_frame_t *frame, unsigned start_position)
+{
+  frame->data = &frame_buffer[(start_position % (FRAME_WIDTH / 2)) * 4];
+  frame->size = FRAME_BYTES;
+}
 #else
-static uint8_t frame_buffer[FRAME_WIDTH * FRAME_HEIGHT * 16 / 8];
-static void fill_color_bar(uint8_t *buffer, unsigned start_position)
+/* Each of the eight bars is a whole number of YUYV pixel pairs */
+_Static_assert((FRAME_WIDTH / 2) % 8 == 0, "FRAME_WIDTH must be a multiple of 16");
+
+static uint8_t frame_storage[VIDEO_FRAMES][FRAME_BYTES] __attribute__((aligned(4)));
+static uint8_t *frame_bufs[VIDEO_FRAMES];
+
+/* Writes scrolling EBU color bars straight into the frame buffer */
+static void produce_frame(uvc_frame_t *frame, unsigned start_position)
 {
   /* EBU color bars
    * See also https://stackoverflow.com/questions/6939422 */
-  static uint8_t const bar_color[8][4] = {
+  static uint8_t const bar_yuyv[8][4] = {
     /*  Y,   U,   Y,   V */
     { 235, 128, 235, 128}, /* 100% White */
     { 219,  16, 219, 138}, /* Yellow */
@@ -113,75 +136,65 @@ static void fill_color_bar(uint8_t *buffer, unsigned start_position)
     {  32, 240,  32, 118}, /* Blue */
     {  16, 128,  16, 128}, /* Black */
   };
-  uint8_t *p;
-
-  /* Generate the 1st line */
-  uint8_t *end = &buffer[FRAME_WIDTH * 2];
-  unsigned idx = (FRAME_WIDTH / 2 - 1) - (start_position % (FRAME_WIDTH / 2));
-  p = &buffer[idx * 4];
-  for (unsigned i = 0; i < 8; ++i) {
-    for (int j = 0; j < FRAME_WIDTH / (2 * 8); ++j) {
-      memcpy(p, &bar_color[i], 4);
-      p += 4;
-      if (end <= p) {
-        p = buffer;
-      }
+  const unsigned pairs = FRAME_WIDTH / 2;
+  const unsigned bar_pairs = pairs / 8;
+  const unsigned shift = pairs - 1 - (start_position % pairs);
+  uint32_t *p = (uint32_t *) frame->buf;
+  uint32_t bar_color[8];
+
+  memcpy(bar_color, bar_yuyv, sizeof(bar_color));
+
+  /* Each 32-bit word is one YUYV pixel pair */
+  for (unsigned y = 0; y < FRAME_HEIGHT; ++y) {
+    for (unsigned x = 0; x < pairs; ++x) {
+      *p++ = bar_color[((x + pairs - shift) % pairs) / bar_pairs];
     }
   }
-  /* Duplicate the 1st line to the others */
-  p = &buffer[FRAME_WIDTH * 2];
-  for (unsigned i = 1; i < FRAME_HEIGHT; ++i) {
-    memcpy(p, buffer, FRAME_WIDTH * 2);
-    p += FRAME_WIDTH * 2;
-  }
+
+  frame->size = FRAME_BYTES;
 }
 #endif
 
-void video_task(void)
+/* Produces frames at the negotiated frame interval */
+static void video_task(void *arg)
 {
-  // static unsigned start_ms = 0;
-  // static unsigned already_sent = 0;
+  TickType_t last_wake_time = xTaskGetTickCount();
+  TickType_t window_start = last_wake_time;
+  uvc_frame_pool_stats_t stats;
+  uint32_t window_sent = 0;
+  unsigned fps_x10;
 
-  if (!tud_video_n_streaming(0, 0)) {
-    // already_sent  = 0;
-    frame_num     = 0;
-    return;
-  }
+  (void) arg;
 
-  // if (!already_sent) {
-  //   already_sent = 1;
-    // start_ms = board_millis();
-#ifdef CFG_EXAMPLE_VIDEO_READONLY
-    tud_video_n_frame_xfer(0, 0, (void*)(uintptr_t) &frame_buffer[(frame_num % (FRAME_WIDTH / 2)) * 4],
-                           FRAME_WIDTH * FRAME_HEIGHT * 16/8);
-#else
-    fill_color_bar(frame_buffer, frame_num);
-    tud_video_n_frame_xfer(0, 0, (void*)frame_buffer, FRAME_WIDTH * FRAME_HEIGHT * 16/8);
-#endif
-  // }
+  for (;;) {
+    vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(interval_ms));
 
-  // unsigned cur = board_millis();
-  // if (cur - start_ms < interval_ms) return; // not enough time
-  // if (tx_busy) return;
-  // start_ms += interval_ms;
-  do {
-  } while(tx_busy != 0);
+    if (!tud_video_n_streaming(0, 0)) {
+      frame_num = 0;
+      continue;
+    }
 
-#ifdef CFG_EXAMPLE_VIDEO_READONLY
-  tud_video_n_frame_xfer(0, 0, (void*)(uintptr_t) &frame_buffer[(frame_num % (FRAME_WIDTH / 2)) * 4],
-                         FRAME_WIDTH * FRAME_HEIGHT * 16/8);
-#else
-  fill_color_bar(frame_buffer, frame_num);
-  tud_video_n_frame_xfer(0, 0, (void*)frame_buffer, FRAME_WIDTH * FRAME_HEIGHT * 16/8);
-#endif
+    uvc_frame_t *frame = uvc_frame_pool_acquire(&frame_pool);
+    if (frame != NULL) {
+      produce_frame(frame, frame_num++);
+      uvc_frame_pool_submit(&frame_pool, frame);
+    }
+
+    /* Sustained frame rate, from completed transfers, over 5 second windows */
+    if (last_wake_time - window_start >= pdMS_TO_TICKS(5000)) {
+      uvc_frame_pool_stats_get(&frame_pool, &stats);
+      fps_x10 = (stats.sent - window_sent) * 10000 / ((last_wake_time - window_start) * portTICK_PERIOD_MS);
+      rtos_printf("video: %u.%u fps, %u frames dropped\n", fps_x10 / 10, fps_x10 % 10, stats.no_frame);
+      window_sent = stats.sent;
+      window_start = last_wake_time;
+    }
+  }
 }
 
 void tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
 {
   (void)ctl_idx; (void)stm_idx;
-  tx_busy = 0;
-  /* flip buffer */
-  ++frame_num;
+  uvc_frame_pool_xfer_complete(&frame_pool);
 }
 
 int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
@@ -190,6 +203,10 @@ int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
   (void)ctl_idx; (void)stm_idx;
   /* convert unit to ms from 100 ns */
   interval_ms = parameters->dwFrameInterval / 10000;
+  if (interval_ms == 0) {
+    interval_ms = 1;
+  }
+  uvc_frame_pool_flush(&frame_pool);
   return VIDEO_ERROR_NONE;
 }
 
@@ -217,13 +234,6 @@ void led_blinky_task(void *args)
     }
 }
 
-static void video_task_wrapper(void *arg) {
-    while(1) {
-        video_task();
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-
 void create_tinyusb_demo(rtos_gpio_t *ctx, unsigned priority)
 {
     if (gpio_ctx == NULL) {
@@ -248,9 +258,16 @@ void create_tinyusb_demo(rtos_gpio_t *ctx, unsigned priority)
                     configMAX_PRIORITIES - 1,
                     NULL);
 
-        xTaskCreate((TaskFunction_t) video_task_wrapper,
+#ifndef CFG_EXAMPLE_VIDEO_READONLY
+        for (int i = 0; i < VIDEO_FRAMES; i++) {
+            frame_bufs[i] = frame_storage[i];
+        }
+#endif
+        uvc_frame_pool_init(&frame_pool, 0, 0, frame_bufs, VIDEO_FRAMES);
+
+        xTaskCreate((TaskFunction_t) video_task,
                     "video_task",
-                    portTASK_STACK_DEPTH(video_task_wrapper),
+                    portTASK_STACK_DEPTH(video_task),
                     NULL,
                     priority,
                     NULL);
@@ -0,0 +1,141 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "tusb.h"
+#include "device/usbd_pvt.h"
+
+#include "compiler_barrier.h"
+#include "uvc_frame_pool.h"
+
+#define MASK (UVC_FRAME_POOL_MAX - 1)
+
+static void free_push(uvc_frame_pool_t *ctx, uvc_frame_t *frame)
+{
+    ctx->free_q[ctx->free_wr & MASK] = frame - ctx->frames;
+    /* The entry must be written before the index publishes it */
+    COMPILER_BARRIER();
+    ctx->free_wr++;
+}
+
+static void ready_push(uvc_frame_pool_t *ctx, uvc_frame_t *frame)
+{
+    ctx->ready_q[ctx->ready_wr & MASK] = frame - ctx->frames;
+    /* The entry must be written before the index publishes it */
+    COMPILER_BARRIER();
+    ctx->ready_wr++;
+}
+
+static uvc_frame_t *ready_pop(uvc_frame_pool_t *ctx)
+{
+    uvc_frame_t *frame;
+
+    if (ctx->ready_wr == ctx->ready_rd) {
+        return NULL;
+    }
+    /* Read the entry only after seeing it published, and before freeing it */
+    COMPILER_BARRIER();
+    frame = &ctx->frames[ctx->ready_q[ctx->ready_rd & MASK]];
+    COMPILER_BARRIER();
+    ctx->ready_rd++;
+
+    return frame;
+}
+
+/* Runs in the USB task. Starts the next queued frame if the bus is idle. */
+static void pool_start(uvc_frame_pool_t *ctx)
+{
+    uvc_frame_t *frame;
+
+    while (ctx->in_flight == NULL && (frame = ready_pop(ctx)) != NULL) {
+        if (tud_video_n_frame_xfer(ctx->ctl_idx, ctx->stm_idx, (void *) frame->data, frame->size)) {
+            ctx->in_flight = frame;
+        } else {
+            ctx->stats.aborted++;
+            free_push(ctx, frame);
+        }
+    }
+}
+
+static void pool_start_deferred(void *arg)
+{
+    pool_start(arg);
+}
+
+void uvc_frame_pool_init(uvc_frame_pool_t *ctx, uint8_t ctl_idx, uint8_t stm_idx,
+                         uint8_t *const bufs[], size_t n_frames)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ctl_idx = ctl_idx;
+    ctx->stm_idx = stm_idx;
+
+    for (size_t i = 0; i < n_frames && i < UVC_FRAME_POOL_MAX; i++) {
+        ctx->frames[i].buf = bufs[i];
+        free_push(ctx, &ctx->frames[i]);
+    }
+}
+
+uvc_frame_t *uvc_frame_pool_acquire(uvc_frame_pool_t *ctx)
+{
+    uvc_frame_t *frame;
+
+    if (ctx->free_wr == ctx->free_rd) {
+        ctx->stats.no_frame++;
+        return NULL;
+    }
+    /* Read the entry only after seeing it published, and before freeing it */
+    COMPILER_BARRIER();
+    frame = &ctx->frames[ctx->free_q[ctx->free_rd & MASK]];
+    COMPILER_BARRIER();
+    ctx->free_rd++;
+
+    frame->data = frame->buf;
+    frame->size = 0;
+
+    return frame;
+}
+
+void uvc_frame_pool_submit(uvc_frame_pool_t *ctx, uvc_frame_t *frame)
+{
+    frame->seq = ctx->seq++;
+    ctx->stats.submitted++;
+    ready_push(ctx, frame);
+
+    usbd_defer_func(pool_start_deferred, ctx, false);
+}
+
+void uvc_frame_pool_xfer_complete(uvc_frame_pool_t *ctx)
+{
+    uvc_frame_t *frame = ctx->in_flight;
+
+    if (frame != NULL) {
+        ctx->in_flight = NULL;
+        ctx->stats.sent++;
+        ctx->stats.bytes += frame->size;
+        free_push(ctx, frame);
+    }
+
+    pool_start(ctx);
+}
+
+void uvc_frame_pool_flush(uvc_frame_pool_t *ctx)
+{
+    uvc_frame_t *frame;
+
+    if (ctx->in_flight != NULL) {
+        ctx->stats.aborted++;
+        free_push(ctx, ctx->in_flight);
+        ctx->in_flight = NULL;
+    }
+
+    while ((frame = ready_pop(ctx)) != NULL) {
+        ctx->stats.aborted++;
+        free_push(ctx, frame);
+    }
+}
+
+void uvc_frame_pool_stats_get(const uvc_frame_pool_t *ctx, uvc_frame_pool_stats_t *stats)
+{
+    *stats = ctx->stats;
+}
@@ -0,0 +1,143 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef UVC_FRAME_POOL_H_
+#define UVC_FRAME_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum number of frames in a pool. Must be a power of two. */
+#ifndef UVC_FRAME_POOL_MAX
+#define UVC_FRAME_POOL_MAX 4
+#endif
+
+#if (UVC_FRAME_POOL_MAX & (UVC_FRAME_POOL_MAX - 1))
+#error UVC_FRAME_POOL_MAX must be a power of two
+#endif
+
+/**
+ * \defgroup uvc_frame_pool
+ *
+ * A pool of video frames passed between a frame producer and the TinyUSB
+ * video class without copying.
+ *
+ * The producer acquires a free frame, writes the image straight into its
+ * buffer and submits it. Submitted frames are handed to
+ * tud_video_n_frame_xfer() in order, and each frame returns to the free
+ * list from tud_video_frame_xfer_complete_cb(), at which point the next
+ * submitted frame is started. With two or more frames the producer fills
+ * frame N+1 while frame N is on the bus.
+ *
+ * Frames move between the producer and the USB task through two
+ * single producer, single consumer index queues, so neither side takes a
+ * lock. Transfers are only ever started from the USB task: a submit defers
+ * the start to it with usbd_defer_func().
+ * @{
+ */
+
+/** A frame in the pool. */
+typedef struct {
+    uint8_t *buf;               /**< The buffer owned by the pool. */
+    const uint8_t *data;        /**< The image to send. Set to buf by uvc_frame_pool_acquire(). */
+    size_t size;                /**< The image size in bytes. */
+    uint32_t seq;               /**< Sequence number set by uvc_frame_pool_submit(). */
+} uvc_frame_t;
+
+/** Pool statistics. */
+typedef struct {
+    uint32_t submitted;         /**< Frames submitted by the producer. */
+    uint32_t sent;              /**< Frames whose transfer completed. */
+    uint32_t no_frame;          /**< Acquire calls that found no free frame. */
+    uint32_t aborted;           /**< Frames returned unsent because streaming stopped. */
+    uint64_t bytes;             /**< Image bytes sent. */
+} uvc_frame_pool_stats_t;
+
+/**
+ * Typedef to the frame pool instance struct.
+ */
+typedef struct uvc_frame_pool_struct uvc_frame_pool_t;
+
+/**
+ * Struct representing a frame pool instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct uvc_frame_pool_struct {
+    uvc_frame_t frames[UVC_FRAME_POOL_MAX];
+    uint8_t free_q[UVC_FRAME_POOL_MAX];
+    uint8_t ready_q[UVC_FRAME_POOL_MAX];
+    volatile uint32_t free_wr;
+    volatile uint32_t free_rd;
+    volatile uint32_t ready_wr;
+    volatile uint32_t ready_rd;
+    uvc_frame_t *in_flight;
+    uint8_t ctl_idx;
+    uint8_t stm_idx;
+    uint32_t seq;
+    uvc_frame_pool_stats_t stats;
+};
+
+/**
+ * Initializes a frame pool.
+ *
+ * \param ctx       A pointer to the pool instance
+ * \param ctl_idx   The video control interface index
+ * \param stm_idx   The video streaming interface index
+ * \param bufs      An array of \p n_frames frame buffers. An entry may be
+ *                  NULL for a producer that only submits frames held
+ *                  elsewhere.
+ * \param n_frames  The number of frames, at most UVC_FRAME_POOL_MAX
+ */
+void uvc_frame_pool_init(uvc_frame_pool_t *ctx, uint8_t ctl_idx, uint8_t stm_idx,
+                         uint8_t *const bufs[], size_t n_frames);
+
+/**
+ * Takes a free frame for the producer to fill. Called from the producer.
+ *
+ * \param ctx  A pointer to the pool instance
+ *
+ * \return the frame, or NULL if every frame is queued or on the bus
+ */
+uvc_frame_t *uvc_frame_pool_acquire(uvc_frame_pool_t *ctx);
+
+/**
+ * Queues a filled frame for transmission. Called from the producer.
+ *
+ * The frame's data and size must be set. data normally points at the
+ * frame's own buffer but may point at any image that stays valid until the
+ * frame is acquired again, such as one in read-only memory.
+ *
+ * \param ctx    A pointer to the pool instance
+ * \param frame  A frame returned by uvc_frame_pool_acquire()
+ */
+void uvc_frame_pool_submit(uvc_frame_pool_t *ctx, uvc_frame_t *frame);
+
+/**
+ * Completes the frame on the bus and starts the next one. Called from
+ * tud_video_frame_xfer_complete_cb().
+ *
+ * \param ctx  A pointer to the pool instance
+ */
+void uvc_frame_pool_xfer_complete(uvc_frame_pool_t *ctx);
+
+/**
+ * Returns the frame on the bus and all queued frames to the free list.
+ * Called from the USB task when the stream is (re)started, such as from
+ * tud_video_commit_cb().
+ *
+ * \param ctx  A pointer to the pool instance
+ */
+void uvc_frame_pool_flush(uvc_frame_pool_t *ctx);
+
+/**
+ * Gets a snapshot of the pool statistics.
+ *
+ * \param ctx    A pointer to the pool instance
+ * \param stats  A pointer to the struct to populate
+ */
+void uvc_frame_pool_stats_get(const uvc_frame_pool_t *ctx, uvc_frame_pool_stats_t *stats);
+
+/**@}*/
+
+#endif /* UVC_FRAME_POOL_H_ */
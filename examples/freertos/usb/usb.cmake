@@ -43,6 +43,7 @@ set(APP_LINK_LIBRARIES
     rtos::drivers::audio
     rtos::usb_device_control
     rtos::bsp_config::xcore_ai_explorer
+    sdk::compiler_barrier
 )
 
 # **********************
@@ -172,7 +173,10 @@ create_debug_target(example_freertos_usb_tusb_demo_cdc_msc)
 # DFU Tile Targets
 #**********************
 file(GLOB_RECURSE DEMO_SOURCES ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/dfu/src/*.c )
-set(DEMO_INCLUDES              ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/dfu/src/)
+list(APPEND DEMO_SOURCES       ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/dfu_runtime/src/flash_boot_image.c)
+set(DEMO_INCLUDES              ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/dfu/src/
+                               ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/dfu_runtime/src/
+)
 set(DEMO_COMPILE_DEFINITIONS   BOARD_DEVICE_RHPORT_SPEED=OPT_MODE_HIGH_SPEED
                                DFU_DEMO=1
 )
@@ -501,19 +505,71 @@ create_run_target(example_freertos_usb_tusb_demo_msc_dual_lun)
 create_debug_target(example_freertos_usb_tusb_demo_msc_dual_lun)
 
 
+#**********************
+# MSC Flash Disk Tile Targets
+#**********************
+file(GLOB_RECURSE DEMO_SOURCES ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/msc_flash/src/*.c )
+set(DEMO_INCLUDES              ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/msc_flash/src/)
+set(DEMO_COMPILE_DEFINITIONS   BOARD_DEVICE_RHPORT_SPEED=OPT_MODE_HIGH_SPEED
+                               MSC_FLASH_DEMO=1
+)
+set(TARGET_NAME tile0_example_freertos_usb_tusb_demo_msc_flash)
+add_executable(${TARGET_NAME} EXCLUDE_FROM_ALL)
+target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES} ${DEMO_SOURCES})
+target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES} ${DEMO_INCLUDES})
+target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} ${DEMO_COMPILE_DEFINITIONS} THIS_XCORE_TILE=0)
+target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
+target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES})
+target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
+unset(TARGET_NAME)
+
+set(TARGET_NAME tile1_example_freertos_usb_tusb_demo_msc_flash)
+add_executable(${TARGET_NAME} EXCLUDE_FROM_ALL)
+target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES} ${DEMO_SOURCES})
+target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES} ${DEMO_INCLUDES})
+target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} ${DEMO_COMPILE_DEFINITIONS} THIS_XCORE_TILE=1)
+target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
+target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES})
+target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
+unset(TARGET_NAME)
+unset(DEMO_SOURCES)
+unset(DEMO_INCLUDES)
+unset(DEMO_COMPILE_DEFINITIONS)
+
+#**********************
+# Merge binaries
+#**********************
+merge_binaries(example_freertos_usb_tusb_demo_msc_flash tile0_example_freertos_usb_tusb_demo_msc_flash tile1_example_freertos_usb_tusb_demo_msc_flash 1)
+
+#**********************
+# Create run and debug targets
+#**********************
+create_run_target(example_freertos_usb_tusb_demo_msc_flash)
+create_debug_target(example_freertos_usb_tusb_demo_msc_flash)
+
+
 #**********************
 # UAC2 Headset Tile Targets
 #**********************
 file(GLOB_RECURSE DEMO_SOURCES ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/uac2_headset/src/*.c )
 set(DEMO_INCLUDES              ${CMAKE_CURRENT_LIST_DIR}/tinyusb_demos/uac2_headset/src/)
 set(DEMO_COMPILE_DEFINITIONS   BOARD_DEVICE_RHPORT_SPEED=OPT_MODE_HIGH_SPEED)
+set(DEMO_LINK_LIBRARIES        "")
+
+option(UAC2_STREAM_ASRC "Pass the UAC2 headset speaker stream through the lib_src ASRC" OFF)
+set(UAC2_STREAM_DEVICE_RATE 0 CACHE STRING "The UAC2 headset device side rate with UAC2_STREAM_ASRC, or 0 for the host rate")
+if(UAC2_STREAM_ASRC)
+    list(APPEND DEMO_COMPILE_DEFINITIONS UAC2_STREAM_ASRC=1 UAC2_STREAM_DEVICE_RATE=${UAC2_STREAM_DEVICE_RATE})
+    list(APPEND DEMO_LINK_LIBRARIES sdk::lib_src sdk::lib_src::rate_estimator)
+endif()
+
 set(TARGET_NAME tile0_example_freertos_usb_tusb_demo_uac2_headset)
 add_executable(${TARGET_NAME} EXCLUDE_FROM_ALL)
 target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES} ${DEMO_SOURCES})
 target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES} ${DEMO_INCLUDES})
 target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} ${DEMO_COMPILE_DEFINITIONS} THIS_XCORE_TILE=0)
 target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
-target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES})
+target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES} ${DEMO_LINK_LIBRARIES})
 target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
 unset(TARGET_NAME)
 
@@ -523,12 +579,13 @@ target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES} ${DEMO_SOURCES})
 target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES} ${DEMO_INCLUDES})
 target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} ${DEMO_COMPILE_DEFINITIONS} THIS_XCORE_TILE=1)
 target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
-target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES})
+target_link_libraries(${TARGET_NAME} PUBLIC ${APP_LINK_LIBRARIES} ${DEMO_LINK_LIBRARIES})
 target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
 unset(TARGET_NAME)
 unset(DEMO_SOURCES)
 unset(DEMO_INCLUDES)
 unset(DEMO_COMPILE_DEFINITIONS)
+unset(DEMO_LINK_LIBRARIES)
 
 #**********************
 # Merge binaries
@@ -5,6 +5,9 @@
 #define APP_CONF_H_
 
 /* XLINK Configuration */
+/* 0 = a byte at a time; 1 = CRC checked, credit flow controlled word frames */
+#define appconfXLINK_STREAM_MODE  1
+
 /* 0 = 2 wire; 1 = 5 wire */
 #define appconfXLINK_WIRE_TYPE  0
 #define appconfLINK_NUM  2
@@ -15,12 +18,25 @@
 #define appconfRX_DIRECTION 0
 #define appconfRX_NODE_ID 0x20
 #define appconfRX_DEBUG_I2C_SLAVE_ADDR 0xc
+#if appconfXLINK_STREAM_MODE
+#define appconfRX_TIME_OUT_TICKS 10000000     /* Frames arrive continuously, so 100 ms of silence means the link is down */
+#else
 #define appconfRX_TIME_OUT_TICKS 500000000
+#endif
+
+/* Credits are sent to this resource ID, which is routed out of the link by DIMF */
+#define appconfRX_CREDIT_DEST 0x80210902
 
 #define appconfTX_DIRECTION 5
 #define appconfRE_ENABLE_TX_PERIOD 6
 #define appconfSEND_CTRL_TOKEN 2500000
 
+/* Streaming mode */
+#define appconfXLINK_STREAM_FRAME_WORDS           256
+#define appconfXLINK_STREAM_CREDITS               4           /* Frames in flight. Each credit is one token buffered on the return path. */
+#define appconfXLINK_STREAM_CREDIT_TIME_OUT_TICKS 10000000    /* 100 ms */
+#define appconfXLINK_STREAM_GAP_TICKS             1000000     /* Gaps longer than 10 ms between frames are timed as recoveries */
+
 /* Intertile Communication Configuration */
 #define appconfI2C_MASTER_RPC_PORT 10
 #define appconfI2C_MASTER_RPC_PRIORITY (configMAX_PRIORITIES/2)
@@ -16,12 +16,15 @@
 #include "app_conf.h"
 #include "link_helpers.h"
 #include "xlink_rx.h"
+#include "xlink_stream.h"
 #include "platform/platform_init.h"
 #include "platform/driver_instances.h"
 
+#if !appconfXLINK_STREAM_MODE
 static int g_data_tokens = 0;
 static int g_ctrl_tokens = 0;
 static int g_timeout_cnts = 0;
+#endif
 
 /* XLINK RX debug info */
 #define RX_STATE_ID 0x01
@@ -29,6 +32,11 @@ static int g_timeout_cnts = 0;
 #define RX_REPORT_CTRL_TOKENS_PER_SEC_ID 0x83
 #define RX_REPORT_TIMEOUTS_PER_SEC_ID 0x84
 
+#if appconfXLINK_STREAM_MODE
+static xlink_stream_rx_t g_stream_rx;
+static unsigned g_rx_state = 0;
+#endif
+
 static void i2c_send_word(uint8_t id, uint32_t word) {
     uint8_t debug_buf[5] = {0};
     size_t n = 0;
@@ -38,6 +46,70 @@ static void i2c_send_word(uint8_t id, uint32_t word) {
     rtos_i2c_master_write(i2c_master_ctx, appconfRX_DEBUG_I2C_SLAVE_ADDR, debug_buf, sizeof(debug_buf), &n, 1);
 }
 
+#if appconfXLINK_STREAM_MODE
+void xlink_report_task(void) {
+    xlink_stream_report_t report = {
+        .id = XLINK_STREAM_REPORT_ID,
+        .version = XLINK_STREAM_REPORT_VERSION,
+    };
+    uint32_t last_time = get_reference_time();
+    uint32_t last_bytes = g_stream_rx.stats.bytes;
+    uint32_t last_frames = g_stream_rx.stats.frames;
+    size_t n = 0;
+
+    while(1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+
+        /*
+         * The counters are only written by the receive task, on another
+         * core, so they are read and the interval taken as the difference
+         * from the last reading rather than cleared here.
+         */
+        const uint32_t now = get_reference_time();
+        const xlink_stream_rx_stats_t *stats = &g_stream_rx.stats;
+        const uint32_t bytes = stats->bytes;
+        const uint32_t frames = stats->frames;
+
+        report.rx_state = g_rx_state;
+        report.interval_ticks = now - last_time;
+        report.bytes = bytes - last_bytes;
+        report.frames = frames - last_frames;
+        last_time = now;
+        last_bytes = bytes;
+        last_frames = frames;
+
+        report.bytes_per_sec = (uint64_t) report.bytes * PLATFORM_REFERENCE_HZ / report.interval_ticks;
+        if (report.bytes_per_sec > report.bytes_per_sec_max) {
+            report.bytes_per_sec_max = report.bytes_per_sec;
+        }
+        report.crc_errors = stats->crc_errors;
+        report.seq_errors = stats->seq_errors;
+        report.sync_errors = stats->sync_errors;
+        report.ctrl_tokens = stats->ctrl_tokens;
+        report.timeouts = stats->timeouts;
+        report.recoveries = stats->recoveries;
+        report.recovery_ticks_last = stats->recovery_ticks_last;
+        report.recovery_ticks_max = stats->recovery_ticks_max;
+
+        rtos_i2c_master_write(i2c_master_ctx, appconfRX_DEBUG_I2C_SLAVE_ADDR, (uint8_t *) &report, sizeof(report), &n, 1);
+    }
+}
+
+/* Handles the next token from the link */
+static void stream_rx_token(chanend_t c) {
+    if (chanend_test_control_token_next_byte(c)) {
+        if (xlink_stream_rx_ctrl(&g_stream_rx, chanend_in_control_token(c)) == XLINK_STREAM_RX_CREDIT) {
+            chanend_out_control_token(c, XLINK_STREAM_CREDIT_TOKEN);
+        }
+    } else if (xlink_stream_rx_discarding(&g_stream_rx) || chanend_test_control_token_next_word(c) != 0) {
+        /* A control token within the next word means the frame was cut short */
+        (void) chanend_in_byte(c);
+        xlink_stream_rx_byte(&g_stream_rx);
+    } else {
+        xlink_stream_rx_word(&g_stream_rx, chanend_in_word(c));
+    }
+}
+#else
 void xlink_report_task(void) {
     int full_rep_cnt = 0;
     uint8_t debug_buf[5] = {0};
@@ -53,6 +125,7 @@ void xlink_report_task(void) {
         g_data_tokens = 0;
     }
 }
+#endif
 
 void xlink_rx(void) {
     unsigned comm_state = 0;
@@ -72,7 +145,14 @@ void xlink_rx(void) {
     rtos_osal_thread_core_exclusion_set(NULL, ~(1 << appconfXLINK_RX_IO_CORE));
     rtos_osal_thread_preemption_disable(NULL);
 
+#if appconfXLINK_STREAM_MODE
+    xlink_stream_rx_init(&g_stream_rx);
+#endif
+
     while(1) {
+#if appconfXLINK_STREAM_MODE
+        g_rx_state = comm_state;
+#endif
         i2c_send_word(RX_STATE_ID, comm_state);
 
         switch (comm_state) {
@@ -87,6 +167,14 @@ void xlink_rx(void) {
                 break;
             case 1: /* Channel alloc */
                 c_tileid = chanend_alloc();
+#if appconfXLINK_STREAM_MODE
+                /* Credits are returned out of the link, as the transmitter sends its data */
+                chanend_set_dest(c_tileid, appconfRX_CREDIT_DEST);
+
+                (void) read_sswitch_reg(appconfRX_NODE_ID, XS1_SSWITCH_DIMENSION_DIRECTION1_NUM, &x);
+                x = XS1_DIMF_DIR_SET(x, appconfRX_DIRECTION);
+                (void) write_sswitch_reg(appconfRX_NODE_ID, XS1_SSWITCH_DIMENSION_DIRECTION1_NUM, x);
+#endif
                 comm_state = 2;
                 break;
             case 2: /* Reconfigure links, setting up a single static link */
@@ -139,6 +227,9 @@ void xlink_rx(void) {
                     {
                         transaction:
                         {
+#if appconfXLINK_STREAM_MODE
+                            stream_rx_token(c_tileid);
+#else
                             if (chanend_test_control_token_next_byte(c_tileid)) {
                                 rx = chanend_in_control_token(c_tileid);
                                 g_ctrl_tokens++;
@@ -146,6 +237,7 @@ void xlink_rx(void) {
                                 rx = chanend_in_byte(c_tileid);
                                 g_data_tokens++;
                             }
+#endif
                             triggerable_disable_trigger(tmr_rx);
                             hwtimer_clear_trigger_time(tmr_rx);
                             trigger_time = hwtimer_get_time(tmr_rx) + appconfRX_TIME_OUT_TICKS;
@@ -158,6 +250,9 @@ void xlink_rx(void) {
                             triggerable_disable_trigger(c_tileid);
                             triggerable_disable_trigger(tmr_rx);
                             rx_loop = 0;
+#if appconfXLINK_STREAM_MODE
+                            xlink_stream_rx_reset(&g_stream_rx);
+#endif
                             comm_state = 3;
                             continue;
                         }
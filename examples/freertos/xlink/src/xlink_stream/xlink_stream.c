@@ -0,0 +1,245 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <xcore/chanend.h>
+#include <xcore/triggerable.h>
+#include <xcore/hwtimer.h>
+
+/* App headers */
+#include "app_conf.h"
+#include "xlink_stream.h"
+
+enum {
+    RX_HEADER = 0,
+    RX_PAYLOAD,
+    RX_CRC,
+    RX_END,
+    RX_DISCARD,
+};
+
+static inline uint32_t stream_crc(uint32_t crc, uint32_t word)
+{
+#if defined(__XS3A__) || defined(__XS2A__)
+    /* The crc32 instruction */
+    return __builtin_crc32(crc, word, XLINK_STREAM_CRC_POLY);
+#else
+    crc ^= word;
+    for (int i = 0; i < 32; i++) {
+        crc = (crc & 1) ? (crc >> 1) ^ XLINK_STREAM_CRC_POLY : crc >> 1;
+    }
+    return crc;
+#endif
+}
+
+/*
+ * Transmit
+ */
+
+void xlink_stream_tx_init(xlink_stream_tx_t *tx)
+{
+    tx->credits = 0;
+    tx->credits_received = 0;
+    tx->seq = 0;
+    tx->tmr = hwtimer_alloc();
+
+    for (int i = 0; i < appconfXLINK_STREAM_FRAME_WORDS; i++) {
+        tx->payload[i] = 0x01010101 * (i & 0xFF);
+    }
+}
+
+void xlink_stream_tx_reset(xlink_stream_tx_t *tx)
+{
+    tx->credits = appconfXLINK_STREAM_CREDITS;
+}
+
+/* Waits for a credit token. Anything else arriving on the return path is dropped. */
+static int tx_wait_credit(xlink_stream_tx_t *tx, chanend_t c)
+{
+    int got_credit = 0;
+
+    triggerable_disable_all();
+    TRIGGERABLE_SETUP_EVENT_VECTOR(tx->tmr, timeout);
+    TRIGGERABLE_SETUP_EVENT_VECTOR(c, credit);
+    hwtimer_set_trigger_time(tx->tmr, hwtimer_get_time(tx->tmr) + appconfXLINK_STREAM_CREDIT_TIME_OUT_TICKS);
+    triggerable_enable_trigger(tx->tmr);
+    triggerable_enable_trigger(c);
+
+    while (!got_credit) {
+        TRIGGERABLE_WAIT_EVENT(timeout, credit);
+        {
+            credit:
+            {
+                if (chanend_test_control_token_next_byte(c)) {
+                    got_credit = chanend_in_control_token(c) == XLINK_STREAM_CREDIT_TOKEN;
+                } else {
+                    (void) chanend_in_byte(c);
+                }
+                continue;
+            }
+            timeout:
+            {
+                break;
+            }
+        }
+    }
+
+    triggerable_disable_all();
+    hwtimer_clear_trigger_time(tx->tmr);
+
+    return got_credit;
+}
+
+int xlink_stream_tx_frame(xlink_stream_tx_t *tx, chanend_t c)
+{
+    const uint32_t hdr = (XLINK_STREAM_MAGIC << 24) | (tx->seq << 16) | appconfXLINK_STREAM_FRAME_WORDS;
+    uint32_t crc;
+
+    if (tx->credits == 0) {
+        if (!tx_wait_credit(tx, c)) {
+            return -1;
+        }
+        tx->credits++;
+        tx->credits_received++;
+    }
+    tx->credits--;
+
+    /* The first payload word changes with every frame */
+    tx->payload[0] = tx->seq;
+
+    chanend_out_word(c, hdr);
+    crc = stream_crc(0xFFFFFFFF, hdr);
+    for (int i = 0; i < appconfXLINK_STREAM_FRAME_WORDS; i++) {
+        chanend_out_word(c, tx->payload[i]);
+        crc = stream_crc(crc, tx->payload[i]);
+    }
+    chanend_out_word(c, crc);
+    chanend_out_control_token(c, XS1_CT_END);
+
+    tx->seq++;
+
+    return 0;
+}
+
+/*
+ * Receive
+ */
+
+void xlink_stream_rx_init(xlink_stream_rx_t *rx)
+{
+    rx->state = RX_HEADER;
+    rx->synced = 0;
+    rx->last_frame_time = 0;
+    rx->stats = (xlink_stream_rx_stats_t) {0};
+}
+
+void xlink_stream_rx_reset(xlink_stream_rx_t *rx)
+{
+    rx->state = RX_HEADER;
+    rx->stats.timeouts++;
+}
+
+int xlink_stream_rx_discarding(const xlink_stream_rx_t *rx)
+{
+    return rx->state == RX_DISCARD;
+}
+
+void xlink_stream_rx_word(xlink_stream_rx_t *rx, uint32_t word)
+{
+    switch (rx->state) {
+        case RX_HEADER:
+            rx->words = word & 0xFFFF;
+            if ((word >> 24) != XLINK_STREAM_MAGIC || rx->words == 0) {
+                rx->stats.sync_errors++;
+                rx->state = RX_DISCARD;
+                break;
+            }
+            rx->seq = (word >> 16) & 0xFF;
+            rx->idx = 0;
+            rx->crc = stream_crc(0xFFFFFFFF, word);
+            rx->state = RX_PAYLOAD;
+            break;
+
+        case RX_PAYLOAD:
+            rx->crc = stream_crc(rx->crc, word);
+            if (++rx->idx == rx->words) {
+                rx->state = RX_CRC;
+            }
+            break;
+
+        case RX_CRC:
+            if (word == rx->crc) {
+                rx->state = RX_END;
+            } else {
+                rx->stats.crc_errors++;
+                rx->state = RX_DISCARD;
+            }
+            break;
+
+        default:
+            /* Data after the CRC */
+            rx->stats.sync_errors++;
+            rx->state = RX_DISCARD;
+            break;
+    }
+}
+
+void xlink_stream_rx_byte(xlink_stream_rx_t *rx)
+{
+    if (rx->state != RX_DISCARD) {
+        rx->stats.sync_errors++;
+        rx->state = RX_DISCARD;
+    }
+}
+
+static void rx_frame_done(xlink_stream_rx_t *rx)
+{
+    const uint32_t now = get_reference_time();
+
+    if (rx->synced) {
+        rx->stats.seq_errors += (uint8_t) (rx->seq - rx->seq_next);
+
+        if (now - rx->last_frame_time > appconfXLINK_STREAM_GAP_TICKS) {
+            const uint32_t gap = now - rx->last_frame_time;
+
+            rx->stats.recoveries++;
+            rx->stats.recovery_ticks_last = gap;
+            if (gap > rx->stats.recovery_ticks_max) {
+                rx->stats.recovery_ticks_max = gap;
+            }
+        }
+    }
+
+    rx->synced = 1;
+    rx->seq_next = rx->seq + 1;
+    rx->last_frame_time = now;
+    rx->stats.frames++;
+    rx->stats.bytes += rx->words * sizeof(uint32_t);
+}
+
+int xlink_stream_rx_ctrl(xlink_stream_rx_t *rx, uint8_t ct)
+{
+    if (ct != XS1_CT_END) {
+        rx->stats.ctrl_tokens++;
+        return 0;
+    }
+
+    switch (rx->state) {
+        case RX_END:
+            rx_frame_done(rx);
+            break;
+        case RX_DISCARD:
+            /* Already counted */
+            break;
+        default:
+            /* Truncated frame, or an END without a frame */
+            rx->stats.sync_errors++;
+            break;
+    }
+
+    /* The transmitter spent a credit on every END it sent */
+    rx->state = RX_HEADER;
+    return XLINK_STREAM_RX_CREDIT;
+}
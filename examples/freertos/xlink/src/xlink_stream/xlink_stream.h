@@ -0,0 +1,123 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef XLINK_STREAM_H_
+#define XLINK_STREAM_H_
+
+#include <stdint.h>
+#include <xs1.h>
+#include <xcore/chanend.h>
+#include <xcore/hwtimer.h>
+
+#include "app_conf.h"
+
+/*
+ * Framing used by the streaming mode.
+ *
+ * Each frame is a header word, the payload words, a CRC word and an END
+ * control token. The header holds XLINK_STREAM_MAGIC in the top byte, an
+ * 8 bit sequence number and the number of payload words. The CRC covers the
+ * header and the payload.
+ *
+ * The transmitter starts a frame only while it holds a credit. It starts
+ * with appconfXLINK_STREAM_CREDITS credits after each link handshake, and
+ * the receiver returns one XLINK_STREAM_CREDIT_TOKEN control token on the
+ * return path of the link for each END token it receives.
+ */
+#define XLINK_STREAM_MAGIC          0xA5
+#define XLINK_STREAM_CRC_POLY       0xEDB88320
+#define XLINK_STREAM_CREDIT_TOKEN   XS1_CT_ACK
+
+/* The frame is complete. Return a credit to the transmitter. */
+#define XLINK_STREAM_RX_CREDIT      1
+
+typedef struct {
+    unsigned credits;
+    uint32_t credits_received;
+    uint8_t seq;
+    hwtimer_t tmr;
+    uint32_t payload[appconfXLINK_STREAM_FRAME_WORDS];
+} xlink_stream_tx_t;
+
+typedef struct {
+    uint32_t bytes;                 /* Payload bytes in good frames. Wraps. */
+    uint32_t frames;                /* Good frames. Wraps. */
+    uint32_t crc_errors;            /* Frames that failed the CRC */
+    uint32_t seq_errors;            /* Frames missing from the sequence, including failed ones */
+    uint32_t sync_errors;           /* Bad headers, truncated frames and stray tokens */
+    uint32_t ctrl_tokens;           /* Other control tokens */
+    uint32_t timeouts;              /* Receive timeouts, each followed by a link handshake */
+    uint32_t recoveries;            /* Gaps of more than appconfXLINK_STREAM_GAP_TICKS between good frames */
+    uint32_t recovery_ticks_last;   /* The length of the last such gap */
+    uint32_t recovery_ticks_max;    /* The length of the longest such gap */
+} xlink_stream_rx_stats_t;
+
+typedef struct {
+    unsigned state;
+    unsigned words;
+    unsigned idx;
+    uint32_t crc;
+    uint8_t seq;
+    uint8_t seq_next;
+    int synced;
+    uint32_t last_frame_time;
+    xlink_stream_rx_stats_t stats;
+} xlink_stream_rx_t;
+
+/*
+ * Statistics report sent to the I2C slave once a second. All fields are
+ * little endian.
+ */
+#define XLINK_STREAM_REPORT_ID      0x90
+#define XLINK_STREAM_REPORT_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint8_t id;                     /* XLINK_STREAM_REPORT_ID */
+    uint8_t version;                /* XLINK_STREAM_REPORT_VERSION */
+    uint8_t rx_state;               /* The state of the receive task */
+    uint8_t reserved;
+    uint32_t interval_ticks;        /* Reference clock ticks covered by this report */
+    uint32_t bytes;                 /* Payload bytes received in the interval */
+    uint32_t frames;                /* Good frames received in the interval */
+    uint32_t bytes_per_sec;         /* bytes scaled to one second */
+    uint32_t bytes_per_sec_max;     /* The highest bytes_per_sec reported so far */
+    uint32_t crc_errors;            /* From here on, totals since startup */
+    uint32_t seq_errors;
+    uint32_t sync_errors;
+    uint32_t ctrl_tokens;
+    uint32_t timeouts;
+    uint32_t recoveries;
+    uint32_t recovery_ticks_last;
+    uint32_t recovery_ticks_max;
+} xlink_stream_report_t;
+
+void xlink_stream_tx_init(xlink_stream_tx_t *tx);
+
+/* Called after each link handshake */
+void xlink_stream_tx_reset(xlink_stream_tx_t *tx);
+
+/*
+ * Sends one frame, first waiting up to appconfXLINK_STREAM_CREDIT_TIME_OUT_TICKS
+ * for a credit if there is none. Returns 0 if the frame was sent, or -1 if
+ * no credit arrived.
+ */
+int xlink_stream_tx_frame(xlink_stream_tx_t *tx, chanend_t c);
+
+void xlink_stream_rx_init(xlink_stream_rx_t *rx);
+
+/* Called on a receive timeout. Drops any partly received frame. */
+void xlink_stream_rx_reset(xlink_stream_rx_t *rx);
+
+/* Handles a received data word */
+void xlink_stream_rx_word(xlink_stream_rx_t *rx, uint32_t word);
+
+/* Handles a received control token. Returns XLINK_STREAM_RX_CREDIT at the end of a frame. */
+int xlink_stream_rx_ctrl(xlink_stream_rx_t *rx, uint8_t ct);
+
+/* Handles a received data byte that is not part of a whole word */
+void xlink_stream_rx_byte(xlink_stream_rx_t *rx);
+
+/* Returns true while the receiver is dropping tokens up to the next END token */
+int xlink_stream_rx_discarding(const xlink_stream_rx_t *rx);
+
+#endif /* XLINK_STREAM_H_ */
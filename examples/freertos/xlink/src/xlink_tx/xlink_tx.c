@@ -17,15 +17,24 @@
 #include "app_conf.h"
 #include "link_helpers.h"
 #include "xlink_tx.h"
+#include "xlink_stream.h"
 #include "platform/platform_init.h"
 #include "platform/driver_instances.h"
 
 static unsigned g_comm_state = 0;
 
+#if appconfXLINK_STREAM_MODE
+static xlink_stream_tx_t g_stream_tx;
+static uint32_t g_reenable_time = 0;
+#endif
+
 void xlink_tx_reenable(void) {
     while(1) {
         vTaskDelay(pdMS_TO_TICKS(appconfRE_ENABLE_TX_PERIOD * 1000));
         g_comm_state = 1;
+#if appconfXLINK_STREAM_MODE
+        g_reenable_time = get_reference_time();
+#endif
         /* Reenable tx link */
         link_disable(get_local_tile_id(), appconfLINK_NUM);
         link_enable(get_local_tile_id(), appconfLINK_NUM);
@@ -40,6 +49,9 @@ void transmit_handler(unsigned comm_state) {
     int ret = 0;
     
     unsigned x = 0;
+#if appconfXLINK_STREAM_MODE
+    uint32_t credits_at_handshake = 0;
+#endif
 
     unsigned switch_id = get_local_tile_id();
 
@@ -79,6 +91,11 @@ void transmit_handler(unsigned comm_state) {
             case 3: /* Setup a static routing configuration */
                 x = 0;
                 x |= XS1_XSTATIC_ENABLE_SET(x, 1);
+#if appconfXLINK_STREAM_MODE
+                /* Credits come back on the return path of the link */
+                x |= XS1_XSTATIC_DEST_CHAN_END_SET(x, ((c_other_tile >> 8) & 0x0000001F));
+                x |= XS1_XSTATIC_DEST_PROC_SET(x, 1);
+#endif
                 x =  write_sswitch_reg(switch_id, XS1_SSWITCH_XSTATIC_0_NUM + appconfLINK_NUM, x);
 
                 delay_milliseconds(150);
@@ -94,15 +111,31 @@ void transmit_handler(unsigned comm_state) {
 
                 /* Setup local control vars */
                 err_ctr = 0;
+#if appconfXLINK_STREAM_MODE
+                xlink_stream_tx_reset(&g_stream_tx);
+                credits_at_handshake = g_stream_tx.credits_received;
+#endif
                 comm_state = 5;
                 break;
             case 5: /* Send data tokens */
+#if appconfXLINK_STREAM_MODE
+                if (xlink_stream_tx_frame(&g_stream_tx, c_other_tile) != 0) {
+                    /* No credit came back, so start again with a handshake */
+                    comm_state = 4;
+                } else if (g_reenable_time != 0 && g_stream_tx.credits_received != credits_at_handshake) {
+                    /* The first credit since the link was reenabled has come back */
+                    rtos_printf("xlink tx recovered %u us after reenable\n",
+                                (get_reference_time() - g_reenable_time) / (PLATFORM_REFERENCE_HZ / 1000000));
+                    g_reenable_time = 0;
+                }
+#else
                 chanend_out_byte(c_other_tile, 'a');
                 
                 if (err_ctr++ == appconfSEND_CTRL_TOKEN) {
                     err_ctr = 0;
                     chanend_out_control_token(c_other_tile, XS1_CT_ACK);
                 }
+#endif
                 break;
             case 6:
                 chanend_free(c_other_tile);
@@ -118,6 +151,9 @@ void xlink_tx(void) {
 
     rtos_osal_thread_core_exclusion_set(NULL, ~(1 << appconfXLINK_TX_IO_CORE));
     rtos_osal_thread_preemption_disable(NULL);
+#if appconfXLINK_STREAM_MODE
+    xlink_stream_tx_init(&g_stream_tx);
+#endif
     while(1) {
         TRY {
             transmit_handler(0);
@@ -14,6 +14,7 @@ set(APP_INCLUDES
     ${CMAKE_CURRENT_LIST_DIR}/src/link
     ${CMAKE_CURRENT_LIST_DIR}/src/xlink_rx
     ${CMAKE_CURRENT_LIST_DIR}/src/xlink_tx
+    ${CMAKE_CURRENT_LIST_DIR}/src/xlink_stream
 )
 add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/bsp_config)
 
@@ -0,0 +1,202 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BM_PIPELINE_H_
+#define BM_PIPELINE_H_
+
+/**
+ * \addtogroup bm_pipeline bm_pipeline
+ *
+ * A streaming pipeline framework for bare-metal applications.
+ *
+ * A pipeline is a chain of stages, each running on its own thread, joined
+ * by hops. A hop carries frames of one type from one stage to the next.
+ * Hops and stages are declared once, with BM_PIPELINE_HOP() and
+ * BM_PIPELINE_STAGE(). bm_pipeline_init() then allocates the channels that
+ * wire them together, and each stage is run as a job with
+ * bm_pipeline_stage_run(), which provides its event loop.
+ *
+ * Each hop owns a double buffer of its frame type in memory shared by the
+ * threads of the tile. A stage writes its output directly into a free
+ * buffer of its output hop, and passes the next stage a pointer to it over
+ * a streaming channel, rather than streaming every word of the frame. The
+ * next stage passes the pointer back once it has finished reading the
+ * frame, so a stage only waits for a buffer when the next stage is two
+ * frames behind.
+ *
+ * A stage's process function is called once per frame with its input and
+ * output frames. The first stage has no input hop and its process function
+ * waits for its input, for example from the mic array. The last stage has
+ * no output hop and its process function sends its output on, for example
+ * to I2S. A stage with an input hop may also be given a control channel.
+ * Its event loop then waits on both, and calls the stage's control
+ * function when a control request arrives between frames.
+ *
+ * Each stage keeps statistics of the time it spends processing and waiting,
+ * and of the latency of its input hop, measured from when the previous
+ * stage sent each frame to when this stage received it.
+ *
+ * All the stages of a pipeline must run on the same tile.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xcore/chanend.h>
+#include <xcore/parallel.h>
+
+/**
+ * The number of frame buffers in each hop.
+ */
+#define BM_PIPELINE_BUFFERS 2
+
+/**
+ * Function pointer group for stage process functions. Each process
+ * function must be declared with this attribute so that the stack size of
+ * bm_pipeline_stage_run() can be calculated.
+ */
+#define BM_PIPELINE_PROCESS_ATTR __attribute__((fptrgroup("bm_pipeline_process_fptr_grp")))
+
+/**
+ * Function pointer group for stage control functions.
+ */
+#define BM_PIPELINE_CTRL_ATTR __attribute__((fptrgroup("bm_pipeline_ctrl_fptr_grp")))
+
+/**
+ * Function pointer type for a stage's process function.
+ *
+ * \param state  The stage's state
+ * \param in     The input frame, or NULL for the first stage. Must not be
+ *               used after the function returns.
+ * \param out    The output frame to fill, or NULL for the last stage
+ */
+typedef void (*bm_pipeline_process_t)(void *state, const void *in, void *out);
+
+/**
+ * Function pointer type for a stage's control function. It must read the
+ * whole request from the channel.
+ *
+ * \param state   The stage's state
+ * \param c_ctrl  The control channel, which has a request waiting
+ */
+typedef void (*bm_pipeline_ctrl_t)(void *state, chanend_t c_ctrl);
+
+/**
+ * A hop between two stages. Declare with BM_PIPELINE_HOP().
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    uint8_t *frames;
+    size_t frame_bytes;
+    chanend_t c_producer;
+    chanend_t c_consumer;
+
+    /* Producer side */
+    unsigned next;
+    unsigned in_flight;
+
+    /* The time each buffer was sent */
+    volatile uint32_t sent_time[BM_PIPELINE_BUFFERS];
+} bm_pipeline_hop_t;
+
+/**
+ * Stage statistics, in reference clock ticks.
+ */
+typedef struct {
+    uint32_t frames;            /**< Frames processed */
+    uint64_t busy_ticks;        /**< Time spent in the process and control functions, and waiting for an output buffer */
+    uint64_t wait_ticks;        /**< Time spent waiting for an input frame or a control request */
+    uint64_t latency_ticks;     /**< The sum of the input hop latency over all frames */
+    uint32_t latency_max_ticks; /**< The largest input hop latency */
+} bm_pipeline_stats_t;
+
+/**
+ * A stage. Declare with BM_PIPELINE_STAGE().
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    bm_pipeline_hop_t *in;
+    bm_pipeline_hop_t *out;
+    BM_PIPELINE_PROCESS_ATTR bm_pipeline_process_t process;
+    BM_PIPELINE_CTRL_ATTR bm_pipeline_ctrl_t ctrl;
+    chanend_t c_ctrl;
+    void *state;
+
+    bm_pipeline_stats_t stats;
+} bm_pipeline_stage_t;
+
+/**
+ * Declares a hop carrying frames of a given type, with its buffers.
+ *
+ * \param name        The name of the hop
+ * \param frame_type  The type of the frames
+ */
+#define BM_PIPELINE_HOP(name, frame_type) \
+    static frame_type name##_frames[BM_PIPELINE_BUFFERS] __attribute__((aligned(8))); \
+    static bm_pipeline_hop_t name = { \
+        .frames = (uint8_t *) name##_frames, \
+        .frame_bytes = sizeof(frame_type), \
+    }
+
+/**
+ * Declares a stage.
+ *
+ * \param name         The name of the stage
+ * \param in_hop       A pointer to the input hop, or NULL for the first stage
+ * \param out_hop      A pointer to the output hop, or NULL for the last stage
+ * \param process_fn   The process function
+ * \param stage_state  A pointer to the stage's state, passed to its functions
+ */
+#define BM_PIPELINE_STAGE(name, in_hop, out_hop, process_fn, stage_state) \
+    static bm_pipeline_stage_t name = { \
+        .in = (in_hop), \
+        .out = (out_hop), \
+        .process = (bm_pipeline_process_t) (process_fn), \
+        .state = (stage_state), \
+    }
+
+/**
+ * Gives a stage a control channel. Must be called before the stage runs.
+ *
+ * \param stage   A pointer to the stage, which must have an input hop
+ * \param c_ctrl  The control channel
+ * \param ctrl    The control function
+ */
+void bm_pipeline_stage_ctrl_set(bm_pipeline_stage_t *stage,
+                                chanend_t c_ctrl,
+                                bm_pipeline_ctrl_t ctrl);
+
+/**
+ * Wires up a pipeline by allocating a channel for the output hop of each
+ * stage. Call once, before any of the stages run.
+ *
+ * \param stages      The stages, in order
+ * \param num_stages  The number of stages
+ */
+void bm_pipeline_init(bm_pipeline_stage_t *const stages[],
+                      size_t num_stages);
+
+/**
+ * Runs a stage. Does not return.
+ *
+ * \param stage  A pointer to the stage
+ */
+DECLARE_JOB(bm_pipeline_stage_run, (bm_pipeline_stage_t *));
+
+/**
+ * Gets a stage's statistics. May be called from another thread while the
+ * stage runs, in which case the counts may be from different frames.
+ *
+ * \param stage  A pointer to the stage
+ * \param stats  Receives the statistics
+ */
+void bm_pipeline_stats_get(const bm_pipeline_stage_t *stage,
+                           bm_pipeline_stats_t *stats);
+
+/**@}*/
+
+#endif /* BM_PIPELINE_H_ */
@@ -0,0 +1,168 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xcore/assert.h>
+#include <xcore/channel_streaming.h>
+#include <xcore/hwtimer.h>
+#include <xcore/triggerable.h>
+
+#include "bm_pipeline.h"
+
+/*
+ * The producer waits for the oldest buffer to come back only once both are
+ * in flight. Buffers come back in the order they were sent, so the one that
+ * comes back is always the next one to fill.
+ */
+static void *hop_acquire(bm_pipeline_hop_t *hop)
+{
+    if (hop->in_flight == BM_PIPELINE_BUFFERS) {
+        (void) s_chan_in_word(hop->c_producer);
+        hop->in_flight--;
+    }
+    return hop->frames + hop->next * hop->frame_bytes;
+}
+
+static void hop_send(bm_pipeline_hop_t *hop, void *frame)
+{
+    hop->sent_time[hop->next] = get_reference_time();
+    s_chan_out_word(hop->c_producer, (uint32_t) (uintptr_t) frame);
+    hop->in_flight++;
+    hop->next = (hop->next + 1) % BM_PIPELINE_BUFFERS;
+}
+
+static void hop_release(bm_pipeline_hop_t *hop, const void *frame)
+{
+    s_chan_out_word(hop->c_consumer, (uint32_t) (uintptr_t) frame);
+}
+
+static unsigned hop_index(const bm_pipeline_hop_t *hop, const void *frame)
+{
+    return ((const uint8_t *) frame - hop->frames) / hop->frame_bytes;
+}
+
+/* Processes one frame that arrived at time arrived, after the stage started waiting at time wait_start */
+static void stage_frame(bm_pipeline_stage_t *stage, const void *in, uint32_t wait_start, uint32_t arrived)
+{
+    bm_pipeline_stats_t *stats = &stage->stats;
+    void *out = NULL;
+
+    stats->wait_ticks += arrived - wait_start;
+
+    if (in != NULL) {
+        const uint32_t latency = arrived - stage->in->sent_time[hop_index(stage->in, in)];
+
+        stats->latency_ticks += latency;
+        if (latency > stats->latency_max_ticks) {
+            stats->latency_max_ticks = latency;
+        }
+    }
+
+    if (stage->out != NULL) {
+        out = hop_acquire(stage->out);
+    }
+
+    stage->process(stage->state, in, out);
+
+    if (in != NULL) {
+        hop_release(stage->in, in);
+    }
+    if (out != NULL) {
+        hop_send(stage->out, out);
+    }
+
+    stats->frames++;
+    stats->busy_ticks += get_reference_time() - arrived;
+}
+
+static void stage_run_ctrl(bm_pipeline_stage_t *stage)
+{
+    const chanend_t c_in = stage->in->c_consumer;
+    const chanend_t c_ctrl = stage->c_ctrl;
+    uint32_t wait_start;
+
+    triggerable_disable_all();
+    TRIGGERABLE_SETUP_EVENT_VECTOR(c_in, input_frame);
+    TRIGGERABLE_SETUP_EVENT_VECTOR(c_ctrl, ctrl_request);
+
+    triggerable_enable_trigger(c_in);
+    triggerable_enable_trigger(c_ctrl);
+
+    while (1) {
+        wait_start = get_reference_time();
+        TRIGGERABLE_WAIT_EVENT(input_frame, ctrl_request);
+        {
+            input_frame:
+            {
+                const void *in = (const void *) (uintptr_t) s_chan_in_word(c_in);
+
+                stage_frame(stage, in, wait_start, get_reference_time());
+            }
+            continue;
+        }
+        {
+            ctrl_request:
+            {
+                const uint32_t arrived = get_reference_time();
+
+                stage->ctrl(stage->state, c_ctrl);
+                stage->stats.wait_ticks += arrived - wait_start;
+                stage->stats.busy_ticks += get_reference_time() - arrived;
+            }
+            continue;
+        }
+    }
+}
+
+void bm_pipeline_stage_run(bm_pipeline_stage_t *stage)
+{
+    if (stage->ctrl != NULL) {
+        stage_run_ctrl(stage);
+    }
+
+    for (;;) {
+        const uint32_t wait_start = get_reference_time();
+        const void *in = NULL;
+
+        if (stage->in != NULL) {
+            in = (const void *) (uintptr_t) s_chan_in_word(stage->in->c_consumer);
+        }
+        stage_frame(stage, in, wait_start, get_reference_time());
+    }
+}
+
+void bm_pipeline_stats_get(const bm_pipeline_stage_t *stage,
+                           bm_pipeline_stats_t *stats)
+{
+    *stats = stage->stats;
+}
+
+void bm_pipeline_stage_ctrl_set(bm_pipeline_stage_t *stage,
+                                chanend_t c_ctrl,
+                                bm_pipeline_ctrl_t ctrl)
+{
+    xassert(stage->in != NULL);
+    stage->c_ctrl = c_ctrl;
+    stage->ctrl = ctrl;
+}
+
+void bm_pipeline_init(bm_pipeline_stage_t *const stages[],
+                      size_t num_stages)
+{
+    for (size_t i = 0; i < num_stages; i++) {
+        bm_pipeline_hop_t *hop = stages[i]->out;
+
+        memset(&stages[i]->stats, 0, sizeof(stages[i]->stats));
+
+        if (hop != NULL) {
+            const streaming_channel_t c = s_chan_alloc();
+
+            xassert(i + 1 < num_stages && stages[i + 1]->in == hop);
+            hop->c_producer = c.end_a;
+            hop->c_consumer = c.end_b;
+            hop->next = 0;
+            hop->in_flight = 0;
+        }
+    }
+}
@@ -0,0 +1,200 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BM_WORKER_POOL_H_
+#define BM_WORKER_POOL_H_
+
+/**
+ * \addtogroup bm_worker_pool bm_worker_pool
+ *
+ * A pool of worker threads for bare-metal applications.
+ *
+ * Each worker runs as a job with bm_worker_pool_worker_run(), and waits
+ * on a streaming channel for work from the pool's submitting thread. A
+ * waiting worker is paused by the hardware and takes no issue slots from
+ * the other threads of the tile, unlike a thread that spins to fill an
+ * unused slot.
+ *
+ * Work is a function over a range of items, such as the channels of a
+ * frame or the blocks of a FIR filter. bm_worker_pool_submit() hands one
+ * range to a worker, and bm_worker_pool_wait() waits for all submitted work
+ * to complete. bm_worker_pool_parallel_for() splits a range between the
+ * workers and the submitting thread, which runs a share itself, and returns
+ * once it is all done.
+ *
+ * A pool is used by one submitting thread, which must be on the same tile
+ * as the workers. Both the workers and the pool keep account of the time
+ * they spend working and waiting, which bm_worker_pool_report() prints.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xcore/chanend.h>
+#include <xcore/parallel.h>
+
+/**
+ * The most workers in one pool.
+ */
+#ifndef BM_WORKER_POOL_MAX_WORKERS
+#define BM_WORKER_POOL_MAX_WORKERS 7
+#endif
+
+/**
+ * Function pointer group for work functions. Each work function must be
+ * declared with this attribute so that the stack size of
+ * bm_worker_pool_worker_run() can be calculated.
+ */
+#define BM_WORKER_POOL_ATTR __attribute__((fptrgroup("bm_worker_pool_fptr_grp")))
+
+/**
+ * Function pointer type for a work function.
+ *
+ * \param arg    The argument given with the work
+ * \param begin  The first item to work on
+ * \param end    One past the last item to work on
+ */
+typedef void (*bm_worker_pool_fn_t)(void *arg, size_t begin, size_t end);
+
+/**
+ * Worker statistics, in reference clock ticks.
+ */
+typedef struct {
+    uint32_t jobs;              /**< Work items completed */
+    uint64_t busy_ticks;        /**< Time spent in work functions */
+    uint64_t idle_ticks;        /**< Time spent waiting for work */
+} bm_worker_pool_worker_stats_t;
+
+/**
+ * Submitting thread statistics, in reference clock ticks.
+ */
+typedef struct {
+    uint32_t submitted;         /**< Work submitted to workers */
+    uint32_t parallel_fors;     /**< Calls to bm_worker_pool_parallel_for() */
+    uint64_t local_ticks;       /**< Time spent running its own share of parallel fors */
+    uint64_t wait_ticks;        /**< Time spent waiting for workers to complete or become free */
+} bm_worker_pool_stats_t;
+
+/**
+ * A worker in a pool.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    chanend_t c_pool;
+    chanend_t c_worker;
+    unsigned busy;
+
+    BM_WORKER_POOL_ATTR bm_worker_pool_fn_t fn;
+    void *arg;
+    size_t begin;
+    size_t end;
+
+    bm_worker_pool_worker_stats_t stats;
+} bm_worker_pool_worker_t;
+
+/**
+ * Typedef to the worker pool struct.
+ */
+typedef struct bm_worker_pool_struct bm_worker_pool_t;
+
+/**
+ * Struct representing a worker pool.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct bm_worker_pool_struct {
+    bm_worker_pool_worker_t worker[BM_WORKER_POOL_MAX_WORKERS];
+    unsigned num_workers;
+    unsigned next;
+
+    bm_worker_pool_stats_t stats;
+};
+
+/**
+ * Initializes a worker pool. Call once, before any of its workers run.
+ *
+ * \param pool         A pointer to the worker pool
+ * \param num_workers  The number of workers, at most
+ *                     BM_WORKER_POOL_MAX_WORKERS. Each must be run with
+ *                     bm_worker_pool_worker_run().
+ */
+void bm_worker_pool_init(bm_worker_pool_t *pool,
+                         unsigned num_workers);
+
+/**
+ * Runs a worker of a pool. Does not return.
+ *
+ * \param pool    A pointer to the worker pool
+ * \param worker  The index of the worker, from 0 to one less than the
+ *                number of workers
+ */
+DECLARE_JOB(bm_worker_pool_worker_run, (bm_worker_pool_t *, unsigned));
+
+/**
+ * Submits work to the next worker in turn. If that worker is still busy,
+ * waits for it to complete its previous work first.
+ *
+ * \param pool   A pointer to the worker pool
+ * \param fn     The work function
+ * \param arg    The argument to pass to the work function
+ * \param begin  The first item to work on
+ * \param end    One past the last item to work on
+ */
+void bm_worker_pool_submit(bm_worker_pool_t *pool,
+                           bm_worker_pool_fn_t fn,
+                           void *arg,
+                           size_t begin,
+                           size_t end);
+
+/**
+ * Waits for all submitted work to complete.
+ *
+ * \param pool  A pointer to the worker pool
+ */
+void bm_worker_pool_wait(bm_worker_pool_t *pool);
+
+/**
+ * Runs a work function over a range of items, split as evenly as possible
+ * between the workers and the calling thread. Returns once the whole range
+ * is complete.
+ *
+ * \param pool   A pointer to the worker pool
+ * \param fn     The work function
+ * \param arg    The argument to pass to the work function
+ * \param count  The number of items. Work is only given to as many threads
+ *               as there are items.
+ */
+void bm_worker_pool_parallel_for(bm_worker_pool_t *pool,
+                                 bm_worker_pool_fn_t fn,
+                                 void *arg,
+                                 size_t count);
+
+/**
+ * Gets the statistics of the submitting thread and of one worker. May be
+ * called from the submitting thread while the workers run, in which case
+ * the worker counts may be from different jobs.
+ *
+ * \param pool          A pointer to the worker pool
+ * \param stats         Receives the submitting thread's statistics. May be NULL.
+ * \param worker        The index of the worker
+ * \param worker_stats  Receives the worker's statistics. May be NULL.
+ */
+void bm_worker_pool_stats_get(bm_worker_pool_t *pool,
+                              bm_worker_pool_stats_t *stats,
+                              unsigned worker,
+                              bm_worker_pool_worker_stats_t *worker_stats);
+
+/**
+ * Prints the share of its time each worker has spent working, and how the
+ * submitting thread has spent its time in the pool.
+ *
+ * \param pool  A pointer to the worker pool
+ */
+void bm_worker_pool_report(bm_worker_pool_t *pool);
+
+/**@}*/
+
+#endif /* BM_WORKER_POOL_H_ */
@@ -0,0 +1,167 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xcore/assert.h>
+#include <xcore/channel_streaming.h>
+#include <xcore/hwtimer.h>
+
+#include "xcore_utils.h"
+#include "bm_worker_pool.h"
+
+static void worker_complete(bm_worker_pool_t *pool, bm_worker_pool_worker_t *worker)
+{
+    if (worker->busy) {
+        const uint32_t start = get_reference_time();
+
+        (void) s_chan_in_word(worker->c_pool);
+        worker->busy = 0;
+        pool->stats.wait_ticks += get_reference_time() - start;
+    }
+}
+
+static void worker_submit(bm_worker_pool_t *pool,
+                          bm_worker_pool_worker_t *worker,
+                          bm_worker_pool_fn_t fn,
+                          void *arg,
+                          size_t begin,
+                          size_t end)
+{
+    worker_complete(pool, worker);
+
+    /* The worker only reads these once it has been signalled */
+    worker->fn = fn;
+    worker->arg = arg;
+    worker->begin = begin;
+    worker->end = end;
+    worker->busy = 1;
+
+    s_chan_out_word(worker->c_pool, 0);
+    pool->stats.submitted++;
+}
+
+void bm_worker_pool_worker_run(bm_worker_pool_t *pool, unsigned index)
+{
+    bm_worker_pool_worker_t *worker = &pool->worker[index];
+    bm_worker_pool_worker_stats_t *stats = &worker->stats;
+
+    xassert(index < pool->num_workers);
+
+    for (;;) {
+        const uint32_t wait_start = get_reference_time();
+        uint32_t start;
+
+        (void) s_chan_in_word(worker->c_worker);
+        start = get_reference_time();
+        stats->idle_ticks += start - wait_start;
+
+        worker->fn(worker->arg, worker->begin, worker->end);
+
+        stats->busy_ticks += get_reference_time() - start;
+        stats->jobs++;
+
+        s_chan_out_word(worker->c_worker, 0);
+    }
+}
+
+void bm_worker_pool_submit(bm_worker_pool_t *pool,
+                           bm_worker_pool_fn_t fn,
+                           void *arg,
+                           size_t begin,
+                           size_t end)
+{
+    xassert(pool->num_workers > 0);
+
+    worker_submit(pool, &pool->worker[pool->next], fn, arg, begin, end);
+    pool->next = (pool->next + 1) % pool->num_workers;
+}
+
+void bm_worker_pool_wait(bm_worker_pool_t *pool)
+{
+    for (unsigned i = 0; i < pool->num_workers; i++) {
+        worker_complete(pool, &pool->worker[i]);
+    }
+}
+
+void bm_worker_pool_parallel_for(bm_worker_pool_t *pool,
+                                 bm_worker_pool_fn_t fn,
+                                 void *arg,
+                                 size_t count)
+{
+    size_t shares = pool->num_workers + 1;
+    uint32_t start;
+
+    if (shares > count) {
+        shares = count;
+    }
+    pool->stats.parallel_fors++;
+
+    /* Workers take shares 1 onwards, the calling thread takes share 0 */
+    for (size_t i = 1; i < shares; i++) {
+        worker_submit(pool, &pool->worker[i - 1], fn, arg,
+                      count * i / shares, count * (i + 1) / shares);
+    }
+
+    if (shares > 0) {
+        start = get_reference_time();
+        fn(arg, 0, count / shares);
+        pool->stats.local_ticks += get_reference_time() - start;
+    }
+
+    bm_worker_pool_wait(pool);
+}
+
+void bm_worker_pool_stats_get(bm_worker_pool_t *pool,
+                              bm_worker_pool_stats_t *stats,
+                              unsigned worker,
+                              bm_worker_pool_worker_stats_t *worker_stats)
+{
+    if (stats != NULL) {
+        *stats = pool->stats;
+    }
+    if (worker_stats != NULL) {
+        xassert(worker < pool->num_workers);
+        *worker_stats = pool->worker[worker].stats;
+    }
+}
+
+/* Returns part as a share of whole in tenths of a percent */
+static unsigned permille(uint64_t part, uint64_t whole)
+{
+    return whole ? (unsigned) (1000 * part / whole) : 0;
+}
+
+void bm_worker_pool_report(bm_worker_pool_t *pool)
+{
+    const bm_worker_pool_stats_t stats = pool->stats;
+    unsigned share;
+
+    share = permille(stats.local_ticks, stats.local_ticks + stats.wait_ticks);
+    debug_printf("Worker pool: %u submitted, %u parallel fors, own share %u.%u%% of time in pool\n",
+                 stats.submitted, stats.parallel_fors, share / 10, share % 10);
+
+    for (unsigned i = 0; i < pool->num_workers; i++) {
+        const bm_worker_pool_worker_stats_t worker = pool->worker[i].stats;
+
+        share = permille(worker.busy_ticks, worker.busy_ticks + worker.idle_ticks);
+        debug_printf("\tworker %u: %u jobs, busy %u.%u%%\n",
+                     i, worker.jobs, share / 10, share % 10);
+    }
+}
+
+void bm_worker_pool_init(bm_worker_pool_t *pool,
+                         unsigned num_workers)
+{
+    xassert(num_workers <= BM_WORKER_POOL_MAX_WORKERS);
+
+    memset(pool, 0, sizeof(*pool));
+    pool->num_workers = num_workers;
+
+    for (unsigned i = 0; i < num_workers; i++) {
+        const streaming_channel_t c = s_chan_alloc();
+
+        pool->worker[i].c_pool = c.end_a;
+        pool->worker[i].c_worker = c.end_b;
+    }
+}
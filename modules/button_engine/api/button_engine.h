@@ -0,0 +1,199 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef BUTTON_ENGINE_H_
+#define BUTTON_ENGINE_H_
+
+/**
+ * \addtogroup button_engine button_engine
+ *
+ * An input engine for up to BUTTON_ENGINE_MAX_BUTTONS buttons on one port.
+ *
+ * The engine debounces the buttons, and decodes presses, releases, long
+ * presses and auto-repeats, all from one event loop with one timer. It
+ * does no I/O of its own. Its owner calls button_engine_update() with the
+ * value of the port and the reference time whenever the port changes, and
+ * whenever the time returned by the previous call is reached. Both
+ * bare-metal event loops, with a port trigger and a hardware timer, and
+ * RTOS tasks, woken by a GPIO ISR or a timeout, can drive it.
+ *
+ * A change on a button is only accepted once the button has held its new
+ * level for the debounce time, so bouncing contacts give one press and one
+ * release. While a button is held, it gives one long press event once it
+ * has been held for the long press time, and repeat events at the repeat
+ * period once it has been held for the repeat delay.
+ *
+ * Decoded events are put in a lock-free queue, from which
+ * button_engine_event_get() takes them. The thread that updates the engine
+ * and the thread that takes the events may differ, and need no lock
+ * between them, but each must be a single thread.
+ *
+ * All times are in reference clock ticks.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+/**
+ * The most buttons an engine decodes.
+ */
+#define BUTTON_ENGINE_MAX_BUTTONS 8
+
+/**
+ * The number of events the queue holds. Must be a power of two. When the
+ * queue is full, new events are dropped and counted.
+ */
+#ifndef BUTTON_ENGINE_QUEUE_LEN
+#define BUTTON_ENGINE_QUEUE_LEN 16
+#endif
+
+/**
+ * Button event types.
+ */
+typedef enum {
+    BUTTON_ENGINE_PRESS,        /**< The button was pressed */
+    BUTTON_ENGINE_RELEASE,      /**< The button was released */
+    BUTTON_ENGINE_LONG_PRESS,   /**< The button has been held for the long press time */
+    BUTTON_ENGINE_REPEAT,       /**< The button is still held, at the repeat period */
+} button_engine_event_type_t;
+
+/**
+ * A button event.
+ */
+typedef struct {
+    uint8_t button;             /**< The index of the button */
+    uint8_t type;               /**< The event type, a button_engine_event_type_t */
+    uint16_t count;             /**< For repeat events, the number of repeats so far in this press, from 1 */
+    uint32_t time;              /**< The time the event was decoded */
+    uint32_t held_ticks;        /**< The time the button had been held, up to the time of the event */
+} button_engine_event_t;
+
+/**
+ * Engine configuration.
+ */
+typedef struct {
+    unsigned num_buttons;       /**< The number of buttons, on bits 0 to num_buttons - 1 of the port */
+    uint32_t active_low;        /**< A mask of the buttons that read 0 when pressed */
+    uint32_t debounce_ticks;    /**< The time a button must hold a new level for it to be accepted */
+    uint32_t long_press_ticks;  /**< The hold time for a long press event, or 0 for none */
+    uint32_t repeat_mask;       /**< A mask of the buttons that auto-repeat */
+    uint32_t repeat_delay_ticks;/**< The hold time before the first repeat event */
+    uint32_t repeat_period_ticks;/**< The time between repeat events */
+} button_engine_config_t;
+
+/**
+ * Engine statistics.
+ */
+typedef struct {
+    uint32_t updates;           /**< Calls to button_engine_update() */
+    uint32_t bounces;           /**< Changes that did not hold for the debounce time */
+    uint32_t events;            /**< Events queued */
+    uint32_t dropped;           /**< Events dropped because the queue was full */
+} button_engine_stats_t;
+
+/**
+ * The state of one button.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    uint8_t raw;
+    uint8_t pressed;
+    uint8_t debouncing;
+    uint8_t hold_events;
+    uint8_t long_sent;
+    uint16_t repeats;
+    uint32_t changed_time;
+    uint32_t pressed_time;
+    uint32_t next_repeat_time;
+} button_engine_button_t;
+
+/**
+ * Typedef to the engine instance struct.
+ */
+typedef struct button_engine_struct button_engine_t;
+
+/**
+ * Struct representing an engine instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct button_engine_struct {
+    button_engine_config_t config;
+    button_engine_button_t button[BUTTON_ENGINE_MAX_BUTTONS];
+
+    button_engine_event_t queue[BUTTON_ENGINE_QUEUE_LEN];
+    volatile uint32_t queue_wr;
+    volatile uint32_t queue_rd;
+
+    button_engine_stats_t stats;
+};
+
+/**
+ * Initializes an engine.
+ *
+ * \param engine      A pointer to the engine instance
+ * \param config      The configuration, which is copied
+ * \param port_value  The current value of the port. Buttons that are
+ *                    pressed now give no event until they are released.
+ * \param now         The current time
+ */
+void button_engine_init(button_engine_t *engine,
+                        const button_engine_config_t *config,
+                        uint32_t port_value,
+                        uint32_t now);
+
+/**
+ * Updates the engine with the current value of the port, queues the events
+ * that are due, and returns when it next needs to be updated if the port
+ * does not change before then.
+ *
+ * \param engine      A pointer to the engine instance
+ * \param port_value  The current value of the port
+ * \param now         The current time
+ * \param next_time   Receives the time to call again by, if the return
+ *                    value is non-zero
+ *
+ * \returns non-zero if the engine needs to be updated at next_time even if
+ *          the port does not change, otherwise 0
+ */
+int button_engine_update(button_engine_t *engine,
+                         uint32_t port_value,
+                         uint32_t now,
+                         uint32_t *next_time);
+
+/**
+ * Takes the oldest event from the queue.
+ *
+ * \param engine  A pointer to the engine instance
+ * \param event   Receives the event
+ *
+ * \returns non-zero if an event was taken, or 0 if the queue was empty
+ */
+int button_engine_event_get(button_engine_t *engine,
+                            button_engine_event_t *event);
+
+/**
+ * Gets whether a button is pressed, after debouncing.
+ *
+ * \param engine  A pointer to the engine instance
+ * \param button  The index of the button
+ *
+ * \returns non-zero if the button is pressed
+ */
+int button_engine_pressed(button_engine_t *engine,
+                          unsigned button);
+
+/**
+ * Gets the engine statistics.
+ *
+ * \param engine  A pointer to the engine instance
+ * \param stats   Receives the statistics
+ */
+void button_engine_stats_get(button_engine_t *engine,
+                             button_engine_stats_t *stats);
+
+/**@}*/
+
+#endif /* BUTTON_ENGINE_H_ */
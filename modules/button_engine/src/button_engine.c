@@ -0,0 +1,211 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "compiler_barrier.h"
+#include "button_engine.h"
+
+#if (BUTTON_ENGINE_QUEUE_LEN & (BUTTON_ENGINE_QUEUE_LEN - 1)) != 0
+#error BUTTON_ENGINE_QUEUE_LEN must be a power of two
+#endif
+
+/* Times wrap, so they are compared by their signed distance from now */
+static int32_t ticks_until(uint32_t time, uint32_t now)
+{
+    return (int32_t) (time - now);
+}
+
+static void event_put(button_engine_t *engine,
+                      unsigned button,
+                      button_engine_event_type_t type,
+                      uint16_t count,
+                      uint32_t now,
+                      uint32_t held_ticks)
+{
+    const uint32_t wr = engine->queue_wr;
+    button_engine_event_t *event;
+
+    if (wr - engine->queue_rd == BUTTON_ENGINE_QUEUE_LEN) {
+        engine->stats.dropped++;
+        return;
+    }
+
+    event = &engine->queue[wr & (BUTTON_ENGINE_QUEUE_LEN - 1)];
+    event->button = button;
+    event->type = type;
+    event->count = count;
+    event->time = now;
+    event->held_ticks = held_ticks;
+
+    /* The event must be in the queue before the index publishes it */
+    COMPILER_BARRIER();
+    engine->queue_wr = wr + 1;
+    engine->stats.events++;
+}
+
+/* Keeps the earliest of the deadlines seen so far */
+static void deadline_add(int *pending, int32_t *earliest, uint32_t time, uint32_t now)
+{
+    int32_t ticks = ticks_until(time, now);
+
+    if (ticks < 0) {
+        ticks = 0;
+    }
+    if (!*pending || ticks < *earliest) {
+        *earliest = ticks;
+        *pending = 1;
+    }
+}
+
+static void button_update(button_engine_t *engine,
+                          unsigned index,
+                          uint8_t raw,
+                          uint32_t now)
+{
+    const button_engine_config_t *config = &engine->config;
+    button_engine_button_t *button = &engine->button[index];
+
+    if (raw != button->raw) {
+        button->raw = raw;
+        if (button->debouncing) {
+            /* Back to its accepted level before the debounce time was up */
+            button->debouncing = 0;
+            engine->stats.bounces++;
+        } else {
+            button->debouncing = 1;
+            button->changed_time = now;
+        }
+    }
+
+    if (button->debouncing && ticks_until(button->changed_time + config->debounce_ticks, now) <= 0) {
+        button->debouncing = 0;
+        button->pressed = raw;
+
+        if (raw) {
+            button->pressed_time = button->changed_time;
+            button->hold_events = 1;
+            button->long_sent = 0;
+            button->repeats = 0;
+            button->next_repeat_time = button->pressed_time + config->repeat_delay_ticks;
+            event_put(engine, index, BUTTON_ENGINE_PRESS, 0, now, now - button->pressed_time);
+        } else {
+            event_put(engine, index, BUTTON_ENGINE_RELEASE, 0, now, button->changed_time - button->pressed_time);
+        }
+    }
+
+    if (!button->pressed || !button->hold_events) {
+        return;
+    }
+
+    if (config->long_press_ticks != 0 && !button->long_sent &&
+        ticks_until(button->pressed_time + config->long_press_ticks, now) <= 0) {
+        button->long_sent = 1;
+        event_put(engine, index, BUTTON_ENGINE_LONG_PRESS, 0, now, now - button->pressed_time);
+    }
+
+    if ((config->repeat_mask & (1 << index)) &&
+        ticks_until(button->next_repeat_time, now) <= 0) {
+        /* One event however late the update is, with the next kept in phase */
+        do {
+            button->next_repeat_time += config->repeat_period_ticks;
+        } while (ticks_until(button->next_repeat_time, now) <= 0);
+        button->repeats++;
+        event_put(engine, index, BUTTON_ENGINE_REPEAT, button->repeats, now, now - button->pressed_time);
+    }
+}
+
+int button_engine_update(button_engine_t *engine,
+                         uint32_t port_value,
+                         uint32_t now,
+                         uint32_t *next_time)
+{
+    const button_engine_config_t *config = &engine->config;
+    const uint32_t levels = port_value ^ config->active_low;
+    int pending = 0;
+    int32_t earliest = 0;
+
+    engine->stats.updates++;
+
+    for (unsigned i = 0; i < config->num_buttons; i++) {
+        const button_engine_button_t *button = &engine->button[i];
+
+        button_update(engine, i, (levels >> i) & 1, now);
+
+        if (button->debouncing) {
+            deadline_add(&pending, &earliest, button->changed_time + config->debounce_ticks, now);
+        }
+        if (button->pressed && button->hold_events) {
+            if (config->long_press_ticks != 0 && !button->long_sent) {
+                deadline_add(&pending, &earliest, button->pressed_time + config->long_press_ticks, now);
+            }
+            if (config->repeat_mask & (1 << i)) {
+                deadline_add(&pending, &earliest, button->next_repeat_time, now);
+            }
+        }
+    }
+
+    if (pending) {
+        *next_time = now + earliest;
+    }
+    return pending;
+}
+
+int button_engine_event_get(button_engine_t *engine,
+                            button_engine_event_t *event)
+{
+    const uint32_t rd = engine->queue_rd;
+
+    if (engine->queue_wr == rd) {
+        return 0;
+    }
+
+    /* The index was read before the event it publishes */
+    COMPILER_BARRIER();
+    *event = engine->queue[rd & (BUTTON_ENGINE_QUEUE_LEN - 1)];
+
+    /* The event must be read before the index frees its slot */
+    COMPILER_BARRIER();
+    engine->queue_rd = rd + 1;
+
+    return 1;
+}
+
+int button_engine_pressed(button_engine_t *engine,
+                          unsigned button)
+{
+    return button < engine->config.num_buttons && engine->button[button].pressed;
+}
+
+void button_engine_stats_get(button_engine_t *engine,
+                             button_engine_stats_t *stats)
+{
+    *stats = engine->stats;
+}
+
+void button_engine_init(button_engine_t *engine,
+                        const button_engine_config_t *config,
+                        uint32_t port_value,
+                        uint32_t now)
+{
+    const uint32_t levels = port_value ^ config->active_low;
+
+    memset(engine, 0, sizeof(*engine));
+    engine->config = *config;
+
+    if (engine->config.num_buttons > BUTTON_ENGINE_MAX_BUTTONS) {
+        engine->config.num_buttons = BUTTON_ENGINE_MAX_BUTTONS;
+    }
+    if (engine->config.repeat_period_ticks == 0) {
+        engine->config.repeat_mask = 0;
+    }
+
+    for (unsigned i = 0; i < engine->config.num_buttons; i++) {
+        button_engine_button_t *button = &engine->button[i];
+
+        /* A button held from before gives no hold events, only its release */
+        button->raw = (levels >> i) & 1;
+        button->pressed = button->raw;
+        button->pressed_time = now;
+    }
+}
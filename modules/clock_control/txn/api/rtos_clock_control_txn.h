@@ -0,0 +1,198 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_CLOCK_CONTROL_TXN_H_
+#define RTOS_CLOCK_CONTROL_TXN_H_
+
+/**
+ * \addtogroup rtos_clock_control_txn rtos_clock_control_txn
+ *
+ * Atomic multi-register transactions on a clock control driver instance.
+ *
+ * Changing the PLL ratio and the clock dividers with the individual
+ * rtos_clock_control_set_*() functions leaves the clocks in intermediate
+ * states between calls, which another task, or another tile, may observe
+ * or interleave with its own changes. Callers also have no way to know
+ * when a change is complete, so they wait a fixed guard time after it.
+ *
+ * A transaction applies any combination of the PLL ratio and the
+ * processor, switch and reference clock dividers under the driver's local
+ * lock. Registers that already hold the requested value are not written.
+ * The dividers that are being raised are written before the PLL, and those
+ * being lowered after it, so that no clock ever runs faster than it did
+ * before or will after the transaction. Every written register is then
+ * read back, and the commit returns once they all hold the requested
+ * values, with the resulting clock frequencies and the time the transaction
+ * took. Registered listeners are called on completion, so other tasks may
+ * wait on a notification instead of a delay.
+ *
+ * The driver instance may be local or an RPC client, so a transaction may
+ * change the clocks of another tile. The latency is measured with the
+ * reference clock of the committing tile, which runs at a different rate
+ * during the transaction if the transaction changes that tile's PLL ratio
+ * or reference clock divider.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+#include "rtos_osal.h"
+#include "rtos_clock_control.h"
+
+/**
+ * The most completion listeners that may be registered on one instance.
+ */
+#ifndef RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS
+#define RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS 4
+#endif
+
+/** \name Settings flags
+ * The settings a transaction applies.
+ * @{
+ */
+#define RTOS_CLOCK_CONTROL_TXN_PLL          0x01 /**< The node PLL ratio */
+#define RTOS_CLOCK_CONTROL_TXN_PROCESSOR    0x02 /**< The processor clock divider */
+#define RTOS_CLOCK_CONTROL_TXN_SWITCH       0x04 /**< The switch clock divider */
+#define RTOS_CLOCK_CONTROL_TXN_REF          0x08 /**< The reference clock divider */
+#define RTOS_CLOCK_CONTROL_TXN_ALL          0x0F /**< All of the above */
+/**@}*/
+
+/**
+ * A set of clock settings.
+ */
+typedef struct {
+    uint32_t flags;             /**< The settings flags of the fields below that are valid */
+    unsigned pll_pre_div;       /**< The node PLL pre divider */
+    unsigned pll_mul;           /**< The node PLL multiplier */
+    unsigned pll_post_div;      /**< The node PLL post divider */
+    unsigned processor_clk_div; /**< The processor clock divider */
+    unsigned switch_clk_div;    /**< The switch clock divider */
+    unsigned ref_clk_div;       /**< The reference clock divider */
+} rtos_clock_control_settings_t;
+
+/**
+ * The outcome of a transaction.
+ */
+typedef struct {
+    int status;                 /**< 0 if every written register read back as requested, otherwise -1 */
+    uint32_t mismatched;        /**< The settings flags of the registers that did not read back as requested */
+    uint32_t written;           /**< The settings flags of the registers that were written */
+    uint32_t latency_ticks;     /**< The time from taking the lock to confirming the last register, in reference clock ticks */
+    unsigned processor_clock;   /**< The processor clock frequency afterwards */
+    unsigned switch_clock;      /**< The switch clock frequency afterwards */
+    unsigned ref_clock;         /**< The reference clock frequency afterwards */
+} rtos_clock_control_txn_result_t;
+
+/**
+ * Transaction statistics.
+ */
+typedef struct {
+    uint32_t commits;           /**< Transactions committed */
+    uint32_t no_ops;            /**< Transactions that found every register already as requested */
+    uint32_t failures;          /**< Transactions with a register that did not read back as requested */
+    uint32_t last_latency_ticks;/**< The latency of the last transaction */
+    uint32_t max_latency_ticks; /**< The longest latency of any transaction */
+} rtos_clock_control_txn_stats_t;
+
+/**
+ * Typedef to the transaction instance struct.
+ */
+typedef struct rtos_clock_control_txn_struct rtos_clock_control_txn_t;
+
+/**
+ * Function pointer type for a transaction completion listener. Called from
+ * the committing task after all locks are released, so it may call the
+ * functions on the same transaction instance, such as
+ * rtos_clock_control_txn_stats_get(). A commit from a listener calls the
+ * listeners again.
+ *
+ * \param txn       A pointer to the transaction instance
+ * \param settings  The settings that were committed
+ * \param result    The outcome of the transaction
+ * \param arg       The argument given to rtos_clock_control_txn_listener_add()
+ */
+typedef void (*rtos_clock_control_txn_listener_t)(rtos_clock_control_txn_t *txn,
+                                                  const rtos_clock_control_settings_t *settings,
+                                                  const rtos_clock_control_txn_result_t *result,
+                                                  void *arg);
+
+/**
+ * Struct representing a transaction instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_clock_control_txn_struct {
+    rtos_clock_control_t *cc_ctx;
+    rtos_osal_mutex_t lock;
+
+    rtos_clock_control_txn_listener_t listener[RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS];
+    void *listener_arg[RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS];
+    unsigned num_listeners;
+
+    rtos_clock_control_txn_stats_t stats;
+};
+
+/**
+ * Initializes a transaction instance.
+ *
+ * \param txn     A pointer to the transaction instance
+ * \param cc_ctx  The clock control driver instance, which must be started
+ *                before any transaction is committed
+ */
+void rtos_clock_control_txn_init(rtos_clock_control_txn_t *txn,
+                                 rtos_clock_control_t *cc_ctx);
+
+/**
+ * Registers a function to be called when each transaction completes.
+ *
+ * \param txn       A pointer to the transaction instance
+ * \param listener  The function to call
+ * \param arg       An argument to pass to the function
+ *
+ * \retval 0   on success
+ * \retval -1  if RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS listeners are already registered
+ */
+int rtos_clock_control_txn_listener_add(rtos_clock_control_txn_t *txn,
+                                        rtos_clock_control_txn_listener_t listener,
+                                        void *arg);
+
+/**
+ * Reads the current clock settings.
+ *
+ * \param txn       A pointer to the transaction instance
+ * \param settings  Receives every setting, with flags set to
+ *                  RTOS_CLOCK_CONTROL_TXN_ALL. May be modified and
+ *                  committed later, for example to restore the settings.
+ */
+void rtos_clock_control_txn_read(rtos_clock_control_txn_t *txn,
+                                 rtos_clock_control_settings_t *settings);
+
+/**
+ * Applies a set of clock settings as one transaction, and waits for it to
+ * complete.
+ *
+ * \param txn       A pointer to the transaction instance
+ * \param settings  The settings to apply. Only the settings named in its
+ *                  flags are changed.
+ * \param result    Receives the outcome of the transaction. May be NULL.
+ *
+ * \retval 0   if every written register read back as requested
+ * \retval -1  otherwise
+ */
+int rtos_clock_control_txn_commit(rtos_clock_control_txn_t *txn,
+                                  const rtos_clock_control_settings_t *settings,
+                                  rtos_clock_control_txn_result_t *result);
+
+/**
+ * Gets the transaction statistics.
+ *
+ * \param txn    A pointer to the transaction instance
+ * \param stats  Receives the statistics
+ */
+void rtos_clock_control_txn_stats_get(rtos_clock_control_txn_t *txn,
+                                      rtos_clock_control_txn_stats_t *stats);
+
+/**@}*/
+
+#endif /* RTOS_CLOCK_CONTROL_TXN_H_ */
@@ -0,0 +1,202 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xcore/hwtimer.h>
+
+#include "rtos_clock_control_txn.h"
+
+#define DIVIDERS    (RTOS_CLOCK_CONTROL_TXN_PROCESSOR | RTOS_CLOCK_CONTROL_TXN_SWITCH | RTOS_CLOCK_CONTROL_TXN_REF)
+
+static void settings_read(rtos_clock_control_t *cc_ctx,
+                          rtos_clock_control_settings_t *settings)
+{
+    settings->flags = RTOS_CLOCK_CONTROL_TXN_ALL;
+    rtos_clock_control_get_node_pll_ratio(cc_ctx,
+                                          &settings->pll_pre_div,
+                                          &settings->pll_mul,
+                                          &settings->pll_post_div);
+    settings->processor_clk_div = rtos_clock_control_get_processor_clk_div(cc_ctx);
+    settings->switch_clk_div = rtos_clock_control_get_switch_clk_div(cc_ctx);
+    settings->ref_clk_div = rtos_clock_control_get_ref_clk_div(cc_ctx);
+}
+
+/* The settings flags of the registers in want that differ from have */
+static uint32_t settings_diff(const rtos_clock_control_settings_t *want,
+                              const rtos_clock_control_settings_t *have)
+{
+    uint32_t diff = 0;
+
+    if ((want->flags & RTOS_CLOCK_CONTROL_TXN_PLL) &&
+        (want->pll_pre_div != have->pll_pre_div ||
+         want->pll_mul != have->pll_mul ||
+         want->pll_post_div != have->pll_post_div)) {
+        diff |= RTOS_CLOCK_CONTROL_TXN_PLL;
+    }
+    if ((want->flags & RTOS_CLOCK_CONTROL_TXN_PROCESSOR) && want->processor_clk_div != have->processor_clk_div) {
+        diff |= RTOS_CLOCK_CONTROL_TXN_PROCESSOR;
+    }
+    if ((want->flags & RTOS_CLOCK_CONTROL_TXN_SWITCH) && want->switch_clk_div != have->switch_clk_div) {
+        diff |= RTOS_CLOCK_CONTROL_TXN_SWITCH;
+    }
+    if ((want->flags & RTOS_CLOCK_CONTROL_TXN_REF) && want->ref_clk_div != have->ref_clk_div) {
+        diff |= RTOS_CLOCK_CONTROL_TXN_REF;
+    }
+
+    return diff;
+}
+
+/* The divider settings flags of the registers in want that are being raised from have */
+static uint32_t dividers_raised(const rtos_clock_control_settings_t *want,
+                                const rtos_clock_control_settings_t *have)
+{
+    uint32_t raised = 0;
+
+    if (want->processor_clk_div > have->processor_clk_div) {
+        raised |= RTOS_CLOCK_CONTROL_TXN_PROCESSOR;
+    }
+    if (want->switch_clk_div > have->switch_clk_div) {
+        raised |= RTOS_CLOCK_CONTROL_TXN_SWITCH;
+    }
+    if (want->ref_clk_div > have->ref_clk_div) {
+        raised |= RTOS_CLOCK_CONTROL_TXN_REF;
+    }
+
+    return raised;
+}
+
+static void dividers_write(rtos_clock_control_t *cc_ctx,
+                           const rtos_clock_control_settings_t *settings,
+                           uint32_t which)
+{
+    if (which & RTOS_CLOCK_CONTROL_TXN_PROCESSOR) {
+        rtos_clock_control_set_processor_clk_div(cc_ctx, settings->processor_clk_div);
+    }
+    if (which & RTOS_CLOCK_CONTROL_TXN_SWITCH) {
+        rtos_clock_control_set_switch_clk_div(cc_ctx, settings->switch_clk_div);
+    }
+    if (which & RTOS_CLOCK_CONTROL_TXN_REF) {
+        rtos_clock_control_set_ref_clk_div(cc_ctx, settings->ref_clk_div);
+    }
+}
+
+int rtos_clock_control_txn_commit(rtos_clock_control_txn_t *txn,
+                                  const rtos_clock_control_settings_t *settings,
+                                  rtos_clock_control_txn_result_t *result)
+{
+    rtos_clock_control_t *cc_ctx = txn->cc_ctx;
+    rtos_clock_control_settings_t current;
+    rtos_clock_control_txn_result_t res;
+    rtos_clock_control_txn_listener_t listener[RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS];
+    void *listener_arg[RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS];
+    unsigned num_listeners;
+    uint32_t start;
+    uint32_t raised;
+
+    memset(&res, 0, sizeof(res));
+
+    rtos_clock_control_get_local_lock(cc_ctx);
+    start = get_reference_time();
+
+    settings_read(cc_ctx, &current);
+    res.written = settings_diff(settings, &current);
+
+    /*
+     * Each clock is the PLL output over its divider. Raising a divider
+     * before the PLL changes and lowering one after means that no clock
+     * runs faster at any point than it did before or will after.
+     */
+    raised = res.written & dividers_raised(settings, &current);
+    dividers_write(cc_ctx, settings, raised);
+    if (res.written & RTOS_CLOCK_CONTROL_TXN_PLL) {
+        rtos_clock_control_set_node_pll_ratio(cc_ctx,
+                                              settings->pll_pre_div,
+                                              settings->pll_mul,
+                                              settings->pll_post_div);
+    }
+    dividers_write(cc_ctx, settings, res.written & DIVIDERS & ~raised);
+
+    if (res.written != 0) {
+        settings_read(cc_ctx, &current);
+        res.mismatched = settings_diff(settings, &current) & res.written;
+    }
+    res.latency_ticks = get_reference_time() - start;
+
+    res.processor_clock = rtos_clock_control_get_processor_clock(cc_ctx);
+    res.switch_clock = rtos_clock_control_get_switch_clock(cc_ctx);
+    res.ref_clock = rtos_clock_control_get_ref_clock(cc_ctx);
+    rtos_clock_control_release_local_lock(cc_ctx);
+
+    res.status = res.mismatched == 0 ? 0 : -1;
+
+    rtos_osal_mutex_get(&txn->lock, RTOS_OSAL_WAIT_FOREVER);
+    txn->stats.commits++;
+    if (res.written == 0) {
+        txn->stats.no_ops++;
+    }
+    if (res.status != 0) {
+        txn->stats.failures++;
+    }
+    txn->stats.last_latency_ticks = res.latency_ticks;
+    if (res.latency_ticks > txn->stats.max_latency_ticks) {
+        txn->stats.max_latency_ticks = res.latency_ticks;
+    }
+    num_listeners = txn->num_listeners;
+    memcpy(listener, txn->listener, num_listeners * sizeof(listener[0]));
+    memcpy(listener_arg, txn->listener_arg, num_listeners * sizeof(listener_arg[0]));
+    rtos_osal_mutex_put(&txn->lock);
+
+    /* Called without the lock, so that a listener may use this instance */
+    for (unsigned i = 0; i < num_listeners; i++) {
+        listener[i](txn, settings, &res, listener_arg[i]);
+    }
+
+    if (result != NULL) {
+        *result = res;
+    }
+
+    return res.status;
+}
+
+void rtos_clock_control_txn_read(rtos_clock_control_txn_t *txn,
+                                 rtos_clock_control_settings_t *settings)
+{
+    rtos_clock_control_get_local_lock(txn->cc_ctx);
+    settings_read(txn->cc_ctx, settings);
+    rtos_clock_control_release_local_lock(txn->cc_ctx);
+}
+
+int rtos_clock_control_txn_listener_add(rtos_clock_control_txn_t *txn,
+                                        rtos_clock_control_txn_listener_t listener,
+                                        void *arg)
+{
+    int ret = -1;
+
+    rtos_osal_mutex_get(&txn->lock, RTOS_OSAL_WAIT_FOREVER);
+    if (txn->num_listeners < RTOS_CLOCK_CONTROL_TXN_MAX_LISTENERS) {
+        txn->listener[txn->num_listeners] = listener;
+        txn->listener_arg[txn->num_listeners] = arg;
+        txn->num_listeners++;
+        ret = 0;
+    }
+    rtos_osal_mutex_put(&txn->lock);
+
+    return ret;
+}
+
+void rtos_clock_control_txn_stats_get(rtos_clock_control_txn_t *txn,
+                                      rtos_clock_control_txn_stats_t *stats)
+{
+    rtos_osal_mutex_get(&txn->lock, RTOS_OSAL_WAIT_FOREVER);
+    *stats = txn->stats;
+    rtos_osal_mutex_put(&txn->lock);
+}
+
+void rtos_clock_control_txn_init(rtos_clock_control_txn_t *txn,
+                                 rtos_clock_control_t *cc_ctx)
+{
+    memset(txn, 0, sizeof(*txn));
+    txn->cc_ctx = cc_ctx;
+    rtos_osal_mutex_create(&txn->lock, "cc_txn", RTOS_OSAL_NOT_RECURSIVE);
+}
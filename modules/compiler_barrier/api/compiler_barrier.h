@@ -0,0 +1,39 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef COMPILER_BARRIER_H_
+#define COMPILER_BARRIER_H_
+
+/**
+ * \addtogroup compiler_barrier compiler_barrier
+ *
+ * A compiler barrier for data handed between cores without a lock.
+ *
+ * The cores of an xcore tile share one memory with no caches between them,
+ * and each core performs its loads and stores in program order. A single
+ * writer can therefore hand data to a single reader through an index or a
+ * flag, with no hardware barrier, provided the writer stores the data
+ * before the index and the reader loads the index before the data. Only
+ * the compiler may move memory accesses across each other, and
+ * COMPILER_BARRIER() stops it from doing so. It emits no instructions.
+ *
+ * The index or flag itself should be volatile, so that the compiler loads
+ * it each time it is read.
+ *
+ * @{
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+/** Stops the compiler moving memory accesses across this point. */
+#define COMPILER_BARRIER() _ReadWriteBarrier()
+#else
+
+/** Stops the compiler moving memory accesses across this point. */
+#define COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+#endif
+
+/**@}*/
+
+#endif /* COMPILER_BARRIER_H_ */
@@ -0,0 +1,52 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_CPU_LOAD_H_
+#define RTOS_CPU_LOAD_H_
+
+/**
+ * \addtogroup rtos_cpu_load rtos_cpu_load
+ *
+ * Helpers for measuring CPU load from the FreeRTOS run time counters.
+ *
+ * The load of a core is the time its idle task did not run, and the
+ * idle tasks are found by name in a uxTaskGetSystemState() listing. The
+ * listing requires configUSE_TRACE_FACILITY, and the run time counters
+ * configGENERATE_RUN_TIME_STATS.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * Scales a time within an interval to tenths of a percent.
+ *
+ * \param time      The time, which is treated as 0 if negative
+ * \param interval  The interval, in the same units
+ *
+ * \return the load, from 0 to 1000. 0 if the interval is 0.
+ */
+uint16_t rtos_cpu_load_permille(int32_t time, uint32_t interval);
+
+/**
+ * Finds the idle tasks in a task listing.
+ *
+ * \param status         The listing, from uxTaskGetSystemState()
+ * \param num_tasks      The number of tasks in the listing
+ * \param idle_task      Receives the handles of up to configNUM_CORES idle tasks
+ * \param idle_run_time  Receives the run time counter of each idle task, or NULL
+ *
+ * \return the number of idle tasks found
+ */
+unsigned rtos_cpu_load_idle_tasks_find(const TaskStatus_t *status,
+                                       unsigned num_tasks,
+                                       TaskHandle_t *idle_task,
+                                       uint32_t *idle_run_time);
+
+/**@}*/
+
+#endif /* RTOS_CPU_LOAD_H_ */
@@ -0,0 +1,38 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "rtos_cpu_load.h"
+
+uint16_t rtos_cpu_load_permille(int32_t time, uint32_t interval)
+{
+    if (time <= 0 || interval == 0) {
+        return 0;
+    }
+    if ((uint32_t) time >= interval) {
+        return 1000;
+    }
+    return (uint16_t) (((uint64_t) time * 1000) / interval);
+}
+
+unsigned rtos_cpu_load_idle_tasks_find(const TaskStatus_t *status,
+                                       unsigned num_tasks,
+                                       TaskHandle_t *idle_task,
+                                       uint32_t *idle_run_time)
+{
+    const size_t idle_name_len = strlen(configIDLE_TASK_NAME);
+    unsigned num_idle = 0;
+
+    for (unsigned i = 0; i < num_tasks && num_idle < configNUM_CORES; i++) {
+        if (strncmp(status[i].pcTaskName, configIDLE_TASK_NAME, idle_name_len) == 0) {
+            idle_task[num_idle] = status[i].xHandle;
+            if (idle_run_time != NULL) {
+                idle_run_time[num_idle] = status[i].ulRunTimeCounter;
+            }
+            num_idle++;
+        }
+    }
+
+    return num_idle;
+}
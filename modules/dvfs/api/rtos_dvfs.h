@@ -0,0 +1,193 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_DVFS_H_
+#define RTOS_DVFS_H_
+
+/**
+ * \addtogroup rtos_dvfs rtos_dvfs
+ *
+ * A dynamic frequency scaling governor built on the clock control driver.
+ *
+ * The governor steps the tile through a table of clock levels, from level 0
+ * at full performance to the last and slowest level. Each level sets the
+ * processor clock divider and, optionally, the switch clock divider. The
+ * clocks are assumed to run at a rate inversely proportional to the
+ * divider, so that a level with twice the divider of another takes twice
+ * as long to do the same work. xcore.ai has no voltage scaling under
+ * software control, so only the frequency is scaled.
+ *
+ * A single task wakes once per period and measures the load of the busiest
+ * core over that period from the run time counters of the FreeRTOS idle
+ * tasks. The SMP kernel may run any idle task on any idle core, so this
+ * overestimates the load of the busiest core when the idle cores change,
+ * which errs on the side of performance.
+ *
+ * The governor steps up when either of two things shows that the tile is
+ * too slow:
+ *   - The busiest core's load is over up_load_permille. The governor goes
+ *     straight to level 0 at the end of the period, so a burst of load
+ *     waits at most one period, plus the transition, for full performance.
+ *   - A pipeline reports, with rtos_dvfs_slack_report(), that it finished
+ *     less than min_slack_us before its deadline. The governor is woken at
+ *     once and goes straight to level 0.
+ *
+ * It steps down one level at a time, only once both the load the busiest
+ * core would have at the next level has been under down_load_permille and
+ * any reported slack has been at least down_slack_us, for down_hold_periods
+ * periods in a row.
+ *
+ * Each transition holds the clock control driver's local lock so that it
+ * is not interleaved with any other user of the driver. The time taken by
+ * each transition, and the time spent at each level, are kept in the
+ * statistics returned by rtos_dvfs_stats_get().
+ *
+ * The governor measures the cores of the tile that it runs on, so the clock
+ * control driver instance it is given should control that tile's clock.
+ * The run time counters require configGENERATE_RUN_TIME_STATS and
+ * configUSE_TRACE_FACILITY to be enabled.
+ *
+ * Only one instance may be started on each tile.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "rtos_osal.h"
+#include "rtos_clock_control.h"
+
+/**
+ * The most levels in a level table.
+ */
+#ifndef RTOS_DVFS_MAX_LEVELS
+#define RTOS_DVFS_MAX_LEVELS 8
+#endif
+
+/**
+ * Pass as a level's switch clock divider to leave the switch clock
+ * unchanged at that level.
+ */
+#define RTOS_DVFS_SWITCH_UNCHANGED 0
+
+/**
+ * One clock level.
+ */
+typedef struct {
+    unsigned processor_clk_div; /**< The processor clock divider */
+    unsigned switch_clk_div;    /**< The switch clock divider, or RTOS_DVFS_SWITCH_UNCHANGED */
+} rtos_dvfs_level_t;
+
+/**
+ * Governor configuration.
+ */
+typedef struct {
+    const rtos_dvfs_level_t *levels;    /**< The level table, ordered from full performance to the slowest. Not copied. */
+    unsigned num_levels;                /**< The number of levels, at most RTOS_DVFS_MAX_LEVELS */
+    unsigned period_ms;                 /**< The time between load measurements, and so the longest a load burst waits for level 0 */
+    unsigned up_load_permille;          /**< Go to level 0 when the busiest core's load is over this */
+    unsigned down_load_permille;        /**< Step down only if the busiest core's load at the next level would be under this */
+    unsigned down_hold_periods;         /**< Periods in a row that the step down conditions must hold */
+    int32_t min_slack_us;               /**< Go to level 0 at once when a reported slack is under this */
+    int32_t down_slack_us;              /**< Step down only if every slack reported over the hold periods is at least this */
+} rtos_dvfs_config_t;
+
+/**
+ * Governor statistics.
+ */
+typedef struct {
+    unsigned level;                             /**< The current level */
+    uint32_t transitions_up;                    /**< Transitions to a faster level */
+    uint32_t transitions_down;                  /**< Transitions to a slower level */
+    uint32_t slack_boosts;                      /**< Transitions to level 0 caused by a slack report */
+    uint32_t max_transition_ticks;              /**< The longest transition, in reference clock ticks */
+    unsigned load_permille;                     /**< The busiest core's load over the last period */
+    int32_t min_slack_us;                       /**< The smallest slack reported over the last period, or INT32_MAX if none was */
+    uint64_t residency_ticks[RTOS_DVFS_MAX_LEVELS]; /**< The time spent at each level, in reference clock ticks */
+} rtos_dvfs_stats_t;
+
+/**
+ * Typedef to the governor instance struct.
+ */
+typedef struct rtos_dvfs_struct rtos_dvfs_t;
+
+/**
+ * Struct representing a governor instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_dvfs_struct {
+    rtos_clock_control_t *cc_ctx;
+    rtos_dvfs_config_t config;
+    rtos_osal_mutex_t lock;
+    rtos_osal_thread_t thread;
+    volatile int started;
+
+    /* The idle tasks, found when the governor starts, and their run time at the last measurement */
+    TaskHandle_t idle_task[configNUM_CORES];
+    uint32_t last_idle_run_time[configNUM_CORES];
+    unsigned num_idle;
+    uint32_t last_run_time;
+
+    /* Updated by rtos_dvfs_slack_report() */
+    volatile int32_t slack_min_us;
+    volatile int slack_boost;
+
+    unsigned level;
+    unsigned down_count;
+    uint32_t level_time;
+
+    rtos_dvfs_stats_t stats;
+};
+
+/**
+ * Initializes a governor instance. The clock is not changed until the
+ * governor is started.
+ *
+ * \param dvfs    A pointer to the governor instance
+ * \param cc_ctx  The clock control driver instance for this tile's clock
+ * \param config  The configuration, which is copied
+ */
+void rtos_dvfs_init(rtos_dvfs_t *dvfs,
+                    rtos_clock_control_t *cc_ctx,
+                    const rtos_dvfs_config_t *config);
+
+/**
+ * Starts the governor at level 0. Must be called after the scheduler and
+ * the clock control driver have started.
+ *
+ * \param dvfs      A pointer to the governor instance
+ * \param priority  The priority of the governor task. This should be above
+ *                  the tasks it measures, so that it is not delayed by the
+ *                  load it is meant to respond to.
+ */
+void rtos_dvfs_start(rtos_dvfs_t *dvfs,
+                     unsigned priority);
+
+/**
+ * Reports how long before its deadline a pipeline finished a unit of work.
+ * May be called from any task, on any core, at any rate. A negative slack
+ * is a missed deadline.
+ *
+ * \param dvfs      A pointer to the governor instance
+ * \param slack_us  The time between completion and the deadline in microseconds
+ */
+void rtos_dvfs_slack_report(rtos_dvfs_t *dvfs,
+                            int32_t slack_us);
+
+/**
+ * Gets the governor statistics. The residency includes the time spent at
+ * the current level up to the last measurement.
+ *
+ * \param dvfs   A pointer to the governor instance
+ * \param stats  Receives the statistics
+ */
+void rtos_dvfs_stats_get(rtos_dvfs_t *dvfs,
+                         rtos_dvfs_stats_t *stats);
+
+/**@}*/
+
+#endif /* RTOS_DVFS_H_ */
@@ -0,0 +1,244 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xcore/assert.h>
+#include <xcore/hwtimer.h>
+
+#include "rtos_cpu_load.h"
+#include "rtos_dvfs.h"
+
+#if !configGENERATE_RUN_TIME_STATS || !configUSE_TRACE_FACILITY
+#error The DVFS governor requires configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY
+#endif
+
+/* Room for tasks created between counting the tasks and listing them */
+#define TASK_LIST_SPARE 4
+
+/* Adds the time since the last call to the current level's residency. Called with the lock held. */
+static void residency_update(rtos_dvfs_t *dvfs, uint32_t now)
+{
+    dvfs->stats.residency_ticks[dvfs->level] += now - dvfs->level_time;
+    dvfs->level_time = now;
+}
+
+static void level_apply(rtos_dvfs_t *dvfs, unsigned level)
+{
+    const rtos_dvfs_level_t *to = &dvfs->config.levels[level];
+
+    rtos_clock_control_get_local_lock(dvfs->cc_ctx);
+    if (to->switch_clk_div != RTOS_DVFS_SWITCH_UNCHANGED) {
+        rtos_clock_control_set_switch_clk_div(dvfs->cc_ctx, to->switch_clk_div);
+    }
+    rtos_clock_control_set_processor_clk_div(dvfs->cc_ctx, to->processor_clk_div);
+    rtos_clock_control_release_local_lock(dvfs->cc_ctx);
+}
+
+static void transition(rtos_dvfs_t *dvfs, unsigned level)
+{
+    const uint32_t start = get_reference_time();
+    uint32_t ticks;
+
+    level_apply(dvfs, level);
+    ticks = get_reference_time() - start;
+
+    rtos_osal_mutex_get(&dvfs->lock, RTOS_OSAL_WAIT_FOREVER);
+    residency_update(dvfs, start);
+    if (level < dvfs->level) {
+        dvfs->stats.transitions_up++;
+    } else {
+        dvfs->stats.transitions_down++;
+    }
+    if (ticks > dvfs->stats.max_transition_ticks) {
+        dvfs->stats.max_transition_ticks = ticks;
+    }
+    dvfs->level = level;
+    dvfs->stats.level = level;
+    rtos_osal_mutex_put(&dvfs->lock);
+}
+
+/*
+ * The load of the busiest core since the last call. Each core runs its own
+ * idle task when it has nothing else to do, so the core that ran its idle
+ * task least was the busiest.
+ */
+static unsigned busiest_load_permille(rtos_dvfs_t *dvfs)
+{
+    const uint32_t now = portGET_RUN_TIME_COUNTER_VALUE();
+    const uint32_t interval = now - dvfs->last_run_time;
+    uint32_t min_idle = interval;
+
+    if (dvfs->num_idle == 0) {
+        /* Without the idle tasks the load cannot be measured, so stay at full performance */
+        return 1000;
+    }
+
+    for (unsigned i = 0; i < dvfs->num_idle; i++) {
+        TaskStatus_t status;
+        uint32_t idle;
+
+        /* Passing a state other than eInvalid skips looking it up */
+        vTaskGetInfo(dvfs->idle_task[i], &status, pdFALSE, eReady);
+        idle = status.ulRunTimeCounter - dvfs->last_idle_run_time[i];
+        dvfs->last_idle_run_time[i] = status.ulRunTimeCounter;
+        if (idle < min_idle) {
+            min_idle = idle;
+        }
+    }
+    dvfs->last_run_time = now;
+
+    return rtos_cpu_load_permille((int32_t) (interval - min_idle), interval);
+}
+
+static void govern(rtos_dvfs_t *dvfs)
+{
+    const rtos_dvfs_config_t *config = &dvfs->config;
+    const unsigned load = busiest_load_permille(dvfs);
+    uint32_t state;
+    int32_t slack;
+
+    state = rtos_osal_critical_enter();
+    slack = dvfs->slack_min_us;
+    dvfs->slack_min_us = INT32_MAX;
+    rtos_osal_critical_exit(state);
+
+    rtos_osal_mutex_get(&dvfs->lock, RTOS_OSAL_WAIT_FOREVER);
+    residency_update(dvfs, get_reference_time());
+    dvfs->stats.load_permille = load;
+    dvfs->stats.min_slack_us = slack;
+    rtos_osal_mutex_put(&dvfs->lock);
+
+    if (load > config->up_load_permille || slack < config->min_slack_us) {
+        dvfs->down_count = 0;
+        if (dvfs->level != 0) {
+            transition(dvfs, 0);
+        }
+    } else if (dvfs->level + 1 < config->num_levels) {
+        /* The same work takes longer in proportion to the processor clock divider */
+        const uint32_t next_load = (uint32_t) (((uint64_t) load * config->levels[dvfs->level + 1].processor_clk_div) /
+                                               config->levels[dvfs->level].processor_clk_div);
+
+        if (next_load < config->down_load_permille && slack >= config->down_slack_us) {
+            if (++dvfs->down_count >= config->down_hold_periods) {
+                dvfs->down_count = 0;
+                transition(dvfs, dvfs->level + 1);
+            }
+        } else {
+            dvfs->down_count = 0;
+        }
+    }
+}
+
+static void dvfs_thread(rtos_dvfs_t *dvfs)
+{
+    TickType_t period = pdMS_TO_TICKS(dvfs->config.period_ms);
+    TickType_t last_wake = xTaskGetTickCount();
+
+    if (period == 0) {
+        period = 1;
+    }
+
+    for (;;) {
+        const TickType_t elapsed = xTaskGetTickCount() - last_wake;
+
+        /* A slack report that needs a boost wakes the governor before the period is up */
+        if (elapsed < period) {
+            (void) ulTaskNotifyTake(pdTRUE, period - elapsed);
+        }
+
+        if (dvfs->slack_boost) {
+            dvfs->slack_boost = 0;
+            if (dvfs->level != 0) {
+                transition(dvfs, 0);
+                rtos_osal_mutex_get(&dvfs->lock, RTOS_OSAL_WAIT_FOREVER);
+                dvfs->stats.slack_boosts++;
+                rtos_osal_mutex_put(&dvfs->lock);
+            }
+        }
+
+        if (xTaskGetTickCount() - last_wake >= period) {
+            last_wake += period;
+            if (xTaskGetTickCount() - last_wake >= period) {
+                /* The governor was held off for more than a period. Do not try to catch up. */
+                last_wake = xTaskGetTickCount();
+            }
+            govern(dvfs);
+        }
+    }
+}
+
+void rtos_dvfs_slack_report(rtos_dvfs_t *dvfs,
+                            int32_t slack_us)
+{
+    uint32_t state;
+    int boost = 0;
+
+    state = rtos_osal_critical_enter();
+    if (slack_us < dvfs->slack_min_us) {
+        dvfs->slack_min_us = slack_us;
+    }
+    if (slack_us < dvfs->config.min_slack_us && dvfs->level != 0 && !dvfs->slack_boost) {
+        dvfs->slack_boost = 1;
+        boost = 1;
+    }
+    rtos_osal_critical_exit(state);
+
+    if (boost && dvfs->started) {
+        xTaskNotifyGive(dvfs->thread.task);
+    }
+}
+
+void rtos_dvfs_stats_get(rtos_dvfs_t *dvfs,
+                         rtos_dvfs_stats_t *stats)
+{
+    rtos_osal_mutex_get(&dvfs->lock, RTOS_OSAL_WAIT_FOREVER);
+    *stats = dvfs->stats;
+    rtos_osal_mutex_put(&dvfs->lock);
+}
+
+void rtos_dvfs_start(rtos_dvfs_t *dvfs,
+                     unsigned priority)
+{
+    const UBaseType_t max_tasks = uxTaskGetNumberOfTasks() + TASK_LIST_SPARE;
+    TaskStatus_t *status;
+    UBaseType_t num_tasks;
+    uint32_t run_time_total;
+
+    /* Find the idle tasks, and take the first measurement from here */
+    status = rtos_osal_malloc(max_tasks * sizeof(TaskStatus_t));
+    xassert(status != NULL);
+    num_tasks = uxTaskGetSystemState(status, max_tasks, &run_time_total);
+
+    dvfs->num_idle = rtos_cpu_load_idle_tasks_find(status, num_tasks, dvfs->idle_task, dvfs->last_idle_run_time);
+    dvfs->last_run_time = run_time_total;
+    rtos_osal_free(status);
+
+    level_apply(dvfs, 0);
+    dvfs->level = 0;
+    dvfs->level_time = get_reference_time();
+
+    rtos_osal_thread_create(
+            &dvfs->thread,
+            "dvfs",
+            (rtos_osal_entry_function_t) dvfs_thread,
+            dvfs,
+            RTOS_THREAD_STACK_SIZE(dvfs_thread),
+            priority);
+    dvfs->started = 1;
+}
+
+void rtos_dvfs_init(rtos_dvfs_t *dvfs,
+                    rtos_clock_control_t *cc_ctx,
+                    const rtos_dvfs_config_t *config)
+{
+    xassert(config->num_levels > 0 && config->num_levels <= RTOS_DVFS_MAX_LEVELS);
+
+    memset(dvfs, 0, sizeof(*dvfs));
+    dvfs->cc_ctx = cc_ctx;
+    dvfs->config = *config;
+    dvfs->slack_min_us = INT32_MAX;
+    dvfs->stats.min_slack_us = INT32_MAX;
+
+    rtos_osal_mutex_create(&dvfs->lock, "dvfs", RTOS_OSAL_NOT_RECURSIVE);
+}
@@ -0,0 +1,216 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_SLAB_HEAP_H_
+#define RTOS_SLAB_HEAP_H_
+
+/**
+ * \addtogroup rtos_slab_heap rtos_slab_heap
+ *
+ * A size class heap for SMP FreeRTOS.
+ *
+ * Requests of up to RTOS_SLAB_HEAP_MAX_BLOCK_BYTES, including an 8 byte
+ * header, are rounded up to a power of two block size. Each block size has
+ * its own free list on every core, so allocating and freeing a block is a
+ * constant time list operation done with only the interrupts of the calling
+ * core masked. No lock is shared between the cores on this path.
+ *
+ * When a core's list for a size is empty, a batch of blocks is moved to it
+ * from a shared pool, and when it grows past its limit a batch is moved
+ * back. These moves, carving new blocks from the underlying memory, and
+ * requests larger than RTOS_SLAB_HEAP_MAX_BLOCK_BYTES are done with the
+ * scheduler suspended, just as in heap_4.c. Large requests are served first
+ * fit from an address ordered free list that coalesces on free.
+ *
+ * Blocks carved for one size are never returned to the underlying memory,
+ * even once they are all free, so they cannot later serve another size or
+ * a large request. The heap suits applications, such as audio pipelines,
+ * that repeatedly allocate and free the same few sizes, and must be sized
+ * for the peak use of every size at once.
+ *
+ * The heap may be used directly through an instance, or in place of
+ * heap_4.c as the FreeRTOS heap by configuring the SDK with
+ * -DXCORE_SDK_SLAB_HEAP=ON. pvPortMalloc() and vPortFree() are then served
+ * by an instance covering configTOTAL_HEAP_SIZE bytes, and
+ * rtos_slab_heap_port_stats_get() returns its statistics.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * The number of block sizes. Block sizes are powers of two starting at 32
+ * bytes.
+ */
+#ifndef RTOS_SLAB_HEAP_CLASSES
+#define RTOS_SLAB_HEAP_CLASSES 8
+#endif
+
+#define RTOS_SLAB_HEAP_MIN_BLOCK_BYTES 32
+#define RTOS_SLAB_HEAP_MAX_BLOCK_BYTES (RTOS_SLAB_HEAP_MIN_BLOCK_BYTES << (RTOS_SLAB_HEAP_CLASSES - 1))
+
+/**
+ * The amount of memory carved into blocks at a time when a block size runs
+ * out. Block sizes larger than this are carved one block at a time.
+ */
+#ifndef RTOS_SLAB_HEAP_SLAB_BYTES
+#define RTOS_SLAB_HEAP_SLAB_BYTES 4096
+#endif
+
+/**
+ * The most bytes of each block size held by each core's free list, and the
+ * most blocks. At least one block of every size is always allowed.
+ */
+#ifndef RTOS_SLAB_HEAP_CACHE_BYTES
+#define RTOS_SLAB_HEAP_CACHE_BYTES 4096
+#endif
+
+#ifndef RTOS_SLAB_HEAP_CACHE_BLOCKS
+#define RTOS_SLAB_HEAP_CACHE_BLOCKS 16
+#endif
+
+/* A block header. Private to the implementation. */
+typedef struct rtos_slab_heap_hdr rtos_slab_heap_hdr_t;
+
+/**
+ * Statistics for one block size.
+ */
+typedef struct {
+    size_t block_bytes;     /**< The size of the blocks, including the header. */
+    uint32_t blocks;        /**< Blocks carved for this size. */
+    uint32_t in_use;        /**< Blocks currently allocated. */
+    uint32_t cached;        /**< Free blocks in the per core lists. */
+    uint32_t pooled;        /**< Free blocks in the shared pool. */
+} rtos_slab_heap_class_stats_t;
+
+/**
+ * Heap statistics. The per core counts are read without stopping the other
+ * cores, so they are approximate while allocations are in progress.
+ */
+typedef struct {
+    size_t heap_bytes;          /**< The size of the memory given to the heap. */
+    size_t free_bytes;          /**< Bytes in free blocks of any size and in the large free list. */
+    size_t min_ever_free_bytes; /**< The lowest number of free bytes seen when the shared state
+                                     was last changed. Blocks in the per core lists are not counted. */
+    size_t large_free_bytes;    /**< Bytes in the large free list, not yet carved into blocks. */
+    size_t largest_free_bytes;  /**< The largest chunk in the large free list. */
+    uint32_t large_free_chunks; /**< The number of chunks in the large free list. */
+    uint32_t fragmentation;     /**< 1000 * (1 - largest_free_bytes / large_free_bytes). */
+    uint32_t allocs;            /**< Successful allocations. */
+    uint32_t frees;             /**< Frees. */
+    uint32_t cache_hits;        /**< Allocations served from the calling core's list. */
+    uint32_t refills;           /**< Batches moved from the shared pool to a core. */
+    uint32_t flushes;           /**< Batches moved from a core to the shared pool. */
+    uint32_t large_allocs;      /**< Allocations larger than RTOS_SLAB_HEAP_MAX_BLOCK_BYTES. */
+    uint32_t failures;          /**< Allocations that failed. */
+    rtos_slab_heap_class_stats_t classes[RTOS_SLAB_HEAP_CLASSES];
+} rtos_slab_heap_stats_t;
+
+/* A per core free list. Private to the implementation. */
+typedef struct {
+    rtos_slab_heap_hdr_t *head;
+    uint32_t count;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t hits;
+} rtos_slab_heap_cache_t;
+
+/**
+ * Typedef to the heap instance struct.
+ */
+typedef struct rtos_slab_heap_struct rtos_slab_heap_t;
+
+/**
+ * Struct representing a heap instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_slab_heap_struct {
+    uint8_t *mem;
+    size_t size;
+
+    /* Large allocations, and the memory blocks are carved from */
+    rtos_slab_heap_hdr_t *large_free;
+    size_t large_free_bytes;
+    size_t min_ever_free_bytes;
+
+    /* Shared pools of free blocks */
+    rtos_slab_heap_hdr_t *pool[RTOS_SLAB_HEAP_CLASSES];
+    uint32_t pool_count[RTOS_SLAB_HEAP_CLASSES];
+    uint32_t blocks[RTOS_SLAB_HEAP_CLASSES];
+    uint32_t cache_max[RTOS_SLAB_HEAP_CLASSES];
+    uint32_t batch[RTOS_SLAB_HEAP_CLASSES];
+
+    uint32_t refills;
+    uint32_t flushes;
+    uint32_t large_allocs;
+    uint32_t large_frees;
+    uint32_t failures;
+
+    rtos_slab_heap_cache_t cache[configNUM_CORES][RTOS_SLAB_HEAP_CLASSES];
+};
+
+/**
+ * Initializes a heap instance.
+ *
+ * \param heap  A pointer to the heap instance
+ * \param mem   The memory to allocate from. Must be 8 byte aligned.
+ * \param size  The size of \p mem in bytes
+ */
+void rtos_slab_heap_init(rtos_slab_heap_t *heap,
+                         void *mem,
+                         size_t size);
+
+/**
+ * Allocates memory. Must not be called from an ISR.
+ *
+ * \param heap  A pointer to the heap instance
+ * \param size  The number of bytes to allocate
+ *
+ * \return an 8 byte aligned pointer to the memory, or NULL if \p size is 0
+ *         or there is not enough free memory
+ */
+void *rtos_slab_heap_malloc(rtos_slab_heap_t *heap,
+                            size_t size);
+
+/**
+ * Frees memory allocated by rtos_slab_heap_malloc(). The memory may be freed
+ * on any core. Must not be called from an ISR.
+ *
+ * \param heap  A pointer to the heap instance
+ * \param ptr   The memory to free, or NULL
+ */
+void rtos_slab_heap_free(rtos_slab_heap_t *heap,
+                         void *ptr);
+
+/**
+ * Gets the number of free bytes, including free blocks of every size.
+ *
+ * \param heap  A pointer to the heap instance
+ */
+size_t rtos_slab_heap_free_bytes(rtos_slab_heap_t *heap);
+
+/**
+ * Gets the heap statistics.
+ *
+ * \param heap   A pointer to the heap instance
+ * \param stats  Receives the statistics
+ */
+void rtos_slab_heap_stats_get(rtos_slab_heap_t *heap,
+                              rtos_slab_heap_stats_t *stats);
+
+/**
+ * Gets the statistics of the FreeRTOS heap when the SDK is configured with
+ * -DXCORE_SDK_SLAB_HEAP=ON.
+ *
+ * \param stats  Receives the statistics
+ */
+void rtos_slab_heap_port_stats_get(rtos_slab_heap_stats_t *stats);
+
+/**@}*/
+
+#endif /* RTOS_SLAB_HEAP_H_ */
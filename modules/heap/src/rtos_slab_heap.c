@@ -0,0 +1,476 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "rtos_slab_heap.h"
+
+/*
+ * Every allocation is preceded by a header. The tag of a block holds its
+ * size class, and the tag of a chunk from the large free list holds its
+ * size, including the header. The next pointer links free blocks and free
+ * chunks, and is unused while allocated.
+ */
+struct rtos_slab_heap_hdr {
+    size_t tag;
+    rtos_slab_heap_hdr_t *next;
+};
+
+#define HDR_BYTES           ((sizeof(rtos_slab_heap_hdr_t) + 7) & ~(size_t) 7)
+#define ALIGN_UP(n)         (((n) + 7) & ~(size_t) 7)
+#define MIN_CHUNK_BYTES     (HDR_BYTES + RTOS_SLAB_HEAP_MIN_BLOCK_BYTES)
+
+#define TAG_USED            0x80000000  /* A chunk that is allocated, or that has been carved into blocks */
+#define TAG_BLOCK           0x40000000  /* A block of one size class */
+#define TAG_FREE            0x20000000  /* A block in a free list */
+#define TAG_CLASS_MASK      0x000000FF
+#define TAG_SIZE_MASK       0x1FFFFFFF
+
+#define BLOCK_BYTES(cls)    ((size_t) RTOS_SLAB_HEAP_MIN_BLOCK_BYTES << (cls))
+
+#if (RTOS_SLAB_HEAP_MIN_BLOCK_BYTES & (RTOS_SLAB_HEAP_MIN_BLOCK_BYTES - 1)) != 0
+#error RTOS_SLAB_HEAP_MIN_BLOCK_BYTES must be a power of two
+#endif
+
+/*
+ * Before the scheduler starts only the calling core runs, and the core ID
+ * may not have been set up yet.
+ */
+static inline int core_id_get(void)
+{
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        return 0;
+    } else {
+        return portGET_CORE_ID();
+    }
+}
+
+/*
+ * Returns the size class of a block of at least n bytes, or -1 if n is
+ * larger than RTOS_SLAB_HEAP_MAX_BLOCK_BYTES.
+ */
+static inline int size_class(size_t n)
+{
+    if (n <= RTOS_SLAB_HEAP_MIN_BLOCK_BYTES) {
+        return 0;
+    } else if (n > RTOS_SLAB_HEAP_MAX_BLOCK_BYTES) {
+        return -1;
+    } else {
+        return 32 - __builtin_clz((unsigned) (n - 1)) - __builtin_ctz(RTOS_SLAB_HEAP_MIN_BLOCK_BYTES);
+    }
+}
+
+static inline void *hdr_to_ptr(rtos_slab_heap_hdr_t *hdr)
+{
+    return (uint8_t *) hdr + HDR_BYTES;
+}
+
+static inline rtos_slab_heap_hdr_t *ptr_to_hdr(void *ptr)
+{
+    return (rtos_slab_heap_hdr_t *) ((uint8_t *) ptr - HDR_BYTES);
+}
+
+/*
+ * Must be called with the scheduler suspended. Blocks held in the per core
+ * lists are free too, though the count of another core's list may be a
+ * moment out of date.
+ */
+static void min_ever_free_update(rtos_slab_heap_t *heap)
+{
+    size_t free_bytes = heap->large_free_bytes;
+
+    for (int cls = 0; cls < RTOS_SLAB_HEAP_CLASSES; cls++) {
+        uint32_t count = heap->pool_count[cls];
+        for (int core = 0; core < configNUM_CORES; core++) {
+            count += heap->cache[core][cls].count;
+        }
+        free_bytes += count * BLOCK_BYTES(cls);
+    }
+    if (free_bytes < heap->min_ever_free_bytes) {
+        heap->min_ever_free_bytes = free_bytes;
+    }
+}
+
+/*
+ * Removes a chunk of at least n bytes, including its header, from the large
+ * free list. Must be called with the scheduler suspended.
+ */
+static rtos_slab_heap_hdr_t *large_take(rtos_slab_heap_t *heap, size_t n)
+{
+    rtos_slab_heap_hdr_t **link = &heap->large_free;
+    rtos_slab_heap_hdr_t *chunk;
+
+    while ((chunk = *link) != NULL && chunk->tag < n) {
+        link = &chunk->next;
+    }
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    if (chunk->tag - n >= MIN_CHUNK_BYTES) {
+        rtos_slab_heap_hdr_t *rest = (rtos_slab_heap_hdr_t *) ((uint8_t *) chunk + n);
+        rest->tag = chunk->tag - n;
+        rest->next = chunk->next;
+        *link = rest;
+        chunk->tag = n;
+    } else {
+        *link = chunk->next;
+    }
+
+    heap->large_free_bytes -= chunk->tag;
+    chunk->tag |= TAG_USED;
+
+    return chunk;
+}
+
+/*
+ * Returns a chunk to the large free list, merging it with its neighbours.
+ * Must be called with the scheduler suspended.
+ */
+static void large_give(rtos_slab_heap_t *heap, rtos_slab_heap_hdr_t *chunk)
+{
+    rtos_slab_heap_hdr_t *prev = NULL;
+    rtos_slab_heap_hdr_t *next = heap->large_free;
+
+    chunk->tag &= TAG_SIZE_MASK;
+    heap->large_free_bytes += chunk->tag;
+
+    while (next != NULL && next < chunk) {
+        prev = next;
+        next = next->next;
+    }
+
+    if (next != NULL && (uint8_t *) chunk + chunk->tag == (uint8_t *) next) {
+        chunk->tag += next->tag;
+        chunk->next = next->next;
+    } else {
+        chunk->next = next;
+    }
+
+    if (prev != NULL && (uint8_t *) prev + prev->tag == (uint8_t *) chunk) {
+        prev->tag += chunk->tag;
+        prev->next = chunk->next;
+    } else if (prev != NULL) {
+        prev->next = chunk;
+    } else {
+        heap->large_free = chunk;
+    }
+}
+
+/*
+ * Carves a slab from the large free list into blocks of one size class and
+ * adds them to the shared pool. Must be called with the scheduler suspended.
+ */
+static void carve(rtos_slab_heap_t *heap, int cls)
+{
+    const size_t block_bytes = BLOCK_BYTES(cls);
+    uint32_t n = RTOS_SLAB_HEAP_SLAB_BYTES / block_bytes;
+    rtos_slab_heap_hdr_t *chunk = NULL;
+    uint8_t *p;
+
+    if (n > 1) {
+        chunk = large_take(heap, HDR_BYTES + n * block_bytes);
+    }
+    if (chunk == NULL) {
+        n = 1;
+        chunk = large_take(heap, HDR_BYTES + block_bytes);
+    }
+    if (chunk == NULL) {
+        return;
+    }
+
+    p = hdr_to_ptr(chunk);
+    for (uint32_t i = 0; i < n; i++) {
+        rtos_slab_heap_hdr_t *block = (rtos_slab_heap_hdr_t *) (p + i * block_bytes);
+        block->tag = TAG_BLOCK | TAG_FREE | cls;
+        block->next = (i + 1 < n) ? (rtos_slab_heap_hdr_t *) (p + (i + 1) * block_bytes) : heap->pool[cls];
+    }
+    heap->pool[cls] = (rtos_slab_heap_hdr_t *) p;
+    heap->pool_count[cls] += n;
+    heap->blocks[cls] += n;
+}
+
+/*
+ * Takes a batch of blocks from the shared pool, returning the first one and
+ * giving the rest to the calling core.
+ */
+static rtos_slab_heap_hdr_t *refill(rtos_slab_heap_t *heap, int cls)
+{
+    rtos_slab_heap_hdr_t *first;
+    rtos_slab_heap_hdr_t *last = NULL;
+    uint32_t n = 0;
+
+    vTaskSuspendAll();
+    {
+        if (heap->pool[cls] == NULL) {
+            carve(heap, cls);
+        }
+
+        first = heap->pool[cls];
+        if (first != NULL) {
+            last = first;
+            n = 1;
+            while (n < heap->batch[cls] && last->next != NULL) {
+                last = last->next;
+                n++;
+            }
+            heap->pool[cls] = last->next;
+            heap->pool_count[cls] -= n;
+            heap->refills++;
+            min_ever_free_update(heap);
+        } else {
+            heap->failures++;
+        }
+    }
+    (void) xTaskResumeAll();
+
+    if (first != NULL) {
+        const UBaseType_t mask = portSET_INTERRUPT_MASK();
+        rtos_slab_heap_cache_t *cache = &heap->cache[core_id_get()][cls];
+
+        if (n > 1) {
+            last->next = cache->head;
+            cache->head = first->next;
+            cache->count += n - 1;
+        }
+        cache->allocs++;
+        portCLEAR_INTERRUPT_MASK(mask);
+    }
+
+    return first;
+}
+
+void *rtos_slab_heap_malloc(rtos_slab_heap_t *heap,
+                            size_t size)
+{
+    rtos_slab_heap_hdr_t *hdr;
+    int cls;
+
+    if (size == 0 || size > TAG_SIZE_MASK - HDR_BYTES - 7) {
+        return NULL;
+    }
+
+    cls = size_class(HDR_BYTES + size);
+
+    if (cls < 0) {
+        vTaskSuspendAll();
+        {
+            hdr = large_take(heap, ALIGN_UP(HDR_BYTES + size));
+            if (hdr != NULL) {
+                heap->large_allocs++;
+                min_ever_free_update(heap);
+            } else {
+                heap->failures++;
+            }
+        }
+        (void) xTaskResumeAll();
+
+        return hdr != NULL ? hdr_to_ptr(hdr) : NULL;
+    }
+
+    {
+        const UBaseType_t mask = portSET_INTERRUPT_MASK();
+        rtos_slab_heap_cache_t *cache = &heap->cache[core_id_get()][cls];
+
+        hdr = cache->head;
+        if (hdr != NULL) {
+            cache->head = hdr->next;
+            cache->count--;
+            cache->allocs++;
+            cache->hits++;
+        }
+        portCLEAR_INTERRUPT_MASK(mask);
+    }
+
+    if (hdr == NULL) {
+        hdr = refill(heap, cls);
+        if (hdr == NULL) {
+            return NULL;
+        }
+    }
+
+    configASSERT(hdr->tag == (TAG_BLOCK | TAG_FREE | (unsigned) cls));
+    hdr->tag = TAG_BLOCK | cls;
+
+    return hdr_to_ptr(hdr);
+}
+
+void rtos_slab_heap_free(rtos_slab_heap_t *heap,
+                         void *ptr)
+{
+    rtos_slab_heap_hdr_t *hdr;
+    rtos_slab_heap_hdr_t *first = NULL;
+    rtos_slab_heap_hdr_t *last = NULL;
+    uint32_t n = 0;
+    int cls;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    hdr = ptr_to_hdr(ptr);
+    configASSERT((uint8_t *) hdr >= heap->mem && (uint8_t *) hdr < heap->mem + heap->size);
+
+    if (!(hdr->tag & TAG_BLOCK)) {
+        configASSERT(hdr->tag & TAG_USED);
+        vTaskSuspendAll();
+        {
+            large_give(heap, hdr);
+            heap->large_frees++;
+        }
+        (void) xTaskResumeAll();
+        return;
+    }
+
+    configASSERT(!(hdr->tag & TAG_FREE));
+    cls = hdr->tag & TAG_CLASS_MASK;
+    hdr->tag |= TAG_FREE;
+
+    {
+        const UBaseType_t mask = portSET_INTERRUPT_MASK();
+        rtos_slab_heap_cache_t *cache = &heap->cache[core_id_get()][cls];
+
+        hdr->next = cache->head;
+        cache->head = hdr;
+        cache->count++;
+        cache->frees++;
+
+        /* Hand the oldest batch back to the shared pool once over the limit */
+        if (cache->count > heap->cache_max[cls]) {
+            n = heap->batch[cls];
+            last = cache->head;
+            for (uint32_t i = 1; i < cache->count - n; i++) {
+                last = last->next;
+            }
+            first = last->next;
+            last->next = NULL;
+            cache->count -= n;
+
+            last = first;
+            while (last->next != NULL) {
+                last = last->next;
+            }
+        }
+        portCLEAR_INTERRUPT_MASK(mask);
+    }
+
+    if (first != NULL) {
+        vTaskSuspendAll();
+        {
+            last->next = heap->pool[cls];
+            heap->pool[cls] = first;
+            heap->pool_count[cls] += n;
+            heap->flushes++;
+        }
+        (void) xTaskResumeAll();
+    }
+}
+
+size_t rtos_slab_heap_free_bytes(rtos_slab_heap_t *heap)
+{
+    size_t free_bytes;
+
+    vTaskSuspendAll();
+    {
+        free_bytes = heap->large_free_bytes;
+        for (int cls = 0; cls < RTOS_SLAB_HEAP_CLASSES; cls++) {
+            uint32_t count = heap->pool_count[cls];
+            for (int core = 0; core < configNUM_CORES; core++) {
+                count += heap->cache[core][cls].count;
+            }
+            free_bytes += count * BLOCK_BYTES(cls);
+        }
+    }
+    (void) xTaskResumeAll();
+
+    return free_bytes;
+}
+
+void rtos_slab_heap_stats_get(rtos_slab_heap_t *heap,
+                              rtos_slab_heap_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    vTaskSuspendAll();
+    {
+        stats->heap_bytes = heap->size;
+        stats->min_ever_free_bytes = heap->min_ever_free_bytes;
+        stats->large_free_bytes = heap->large_free_bytes;
+        stats->free_bytes = heap->large_free_bytes;
+        stats->allocs = heap->large_allocs;
+        stats->frees = heap->large_frees;
+        stats->refills = heap->refills;
+        stats->flushes = heap->flushes;
+        stats->large_allocs = heap->large_allocs;
+        stats->failures = heap->failures;
+
+        for (rtos_slab_heap_hdr_t *chunk = heap->large_free; chunk != NULL; chunk = chunk->next) {
+            if (chunk->tag > stats->largest_free_bytes) {
+                stats->largest_free_bytes = chunk->tag;
+            }
+            stats->large_free_chunks++;
+        }
+
+        for (int cls = 0; cls < RTOS_SLAB_HEAP_CLASSES; cls++) {
+            rtos_slab_heap_class_stats_t *class_stats = &stats->classes[cls];
+
+            class_stats->block_bytes = BLOCK_BYTES(cls);
+            class_stats->blocks = heap->blocks[cls];
+            class_stats->pooled = heap->pool_count[cls];
+            for (int core = 0; core < configNUM_CORES; core++) {
+                const rtos_slab_heap_cache_t *cache = &heap->cache[core][cls];
+                class_stats->cached += cache->count;
+                stats->allocs += cache->allocs;
+                stats->frees += cache->frees;
+                stats->cache_hits += cache->hits;
+            }
+            if (class_stats->pooled + class_stats->cached < class_stats->blocks) {
+                class_stats->in_use = class_stats->blocks - class_stats->pooled - class_stats->cached;
+            }
+            stats->free_bytes += (class_stats->pooled + class_stats->cached) * class_stats->block_bytes;
+        }
+    }
+    (void) xTaskResumeAll();
+
+    if (stats->large_free_bytes > 0) {
+        stats->fragmentation = 1000 - (uint32_t) ((uint64_t) stats->largest_free_bytes * 1000 / stats->large_free_bytes);
+    }
+}
+
+void rtos_slab_heap_init(rtos_slab_heap_t *heap,
+                         void *mem,
+                         size_t size)
+{
+    uint8_t *start = (uint8_t *) ALIGN_UP((uintptr_t) mem);
+    rtos_slab_heap_hdr_t *chunk = (rtos_slab_heap_hdr_t *) start;
+
+    configASSERT(size > (size_t) (start - (uint8_t *) mem) + MIN_CHUNK_BYTES);
+    size = (size - (start - (uint8_t *) mem)) & ~(size_t) 7;
+    configASSERT(size <= TAG_SIZE_MASK);
+
+    memset(heap, 0, sizeof(*heap));
+    heap->mem = start;
+    heap->size = size;
+
+    chunk->tag = size;
+    chunk->next = NULL;
+    heap->large_free = chunk;
+    heap->large_free_bytes = size;
+    heap->min_ever_free_bytes = size;
+
+    for (int cls = 0; cls < RTOS_SLAB_HEAP_CLASSES; cls++) {
+        uint32_t cache_max = RTOS_SLAB_HEAP_CACHE_BYTES / BLOCK_BYTES(cls);
+
+        if (cache_max > RTOS_SLAB_HEAP_CACHE_BLOCKS) {
+            cache_max = RTOS_SLAB_HEAP_CACHE_BLOCKS;
+        }
+        if (cache_max < 1) {
+            cache_max = 1;
+        }
+        heap->cache_max[cls] = cache_max;
+        heap->batch[cls] = cache_max > 1 ? cache_max / 2 : 1;
+    }
+}
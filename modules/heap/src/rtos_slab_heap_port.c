@@ -0,0 +1,111 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * The FreeRTOS heap functions, served by a slab heap covering
+ * configTOTAL_HEAP_SIZE bytes. This replaces heap_4.c when the SDK is
+ * configured with -DXCORE_SDK_SLAB_HEAP=ON.
+ */
+
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "rtos_slab_heap.h"
+
+#if configAPPLICATION_ALLOCATED_HEAP == 1
+extern uint8_t ucHeap[configTOTAL_HEAP_SIZE];
+#else
+static uint8_t ucHeap[configTOTAL_HEAP_SIZE] __attribute__((aligned(8)));
+#endif
+
+static rtos_slab_heap_t heap;
+static volatile int heap_initialized;
+
+static void heap_init_check(void)
+{
+    if (!heap_initialized) {
+        vTaskSuspendAll();
+        {
+            if (!heap_initialized) {
+                rtos_slab_heap_init(&heap, ucHeap, sizeof(ucHeap));
+                heap_initialized = 1;
+            }
+        }
+        (void) xTaskResumeAll();
+    }
+}
+
+void *pvPortMalloc(size_t xWantedSize)
+{
+    void *pvReturn;
+
+    heap_init_check();
+
+    pvReturn = rtos_slab_heap_malloc(&heap, xWantedSize);
+    traceMALLOC(pvReturn, xWantedSize);
+
+#if configUSE_MALLOC_FAILED_HOOK == 1
+    if (pvReturn == NULL) {
+        extern void vApplicationMallocFailedHook(void);
+        vApplicationMallocFailedHook();
+    }
+#endif
+
+    return pvReturn;
+}
+
+void vPortFree(void *pv)
+{
+    if (pv != NULL) {
+        traceFREE(pv, 0);
+        rtos_slab_heap_free(&heap, pv);
+    }
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    heap_init_check();
+    return rtos_slab_heap_free_bytes(&heap);
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void)
+{
+    heap_init_check();
+    return heap.min_ever_free_bytes;
+}
+
+void vPortInitialiseBlocks(void)
+{
+    /* This just exists to keep the linker quiet. */
+}
+
+void vPortGetHeapStats(HeapStats_t *pxHeapStats)
+{
+    rtos_slab_heap_stats_t stats;
+
+    rtos_slab_heap_port_stats_get(&stats);
+
+    pxHeapStats->xAvailableHeapSpaceInBytes = stats.free_bytes;
+    pxHeapStats->xSizeOfLargestFreeBlockInBytes = stats.largest_free_bytes;
+    pxHeapStats->xSizeOfSmallestFreeBlockInBytes = stats.largest_free_bytes;
+    pxHeapStats->xNumberOfFreeBlocks = stats.large_free_chunks;
+    pxHeapStats->xMinimumEverFreeBytesRemaining = stats.min_ever_free_bytes;
+    pxHeapStats->xNumberOfSuccessfulAllocations = stats.allocs;
+    pxHeapStats->xNumberOfSuccessfulFrees = stats.frees;
+
+    for (int cls = RTOS_SLAB_HEAP_CLASSES - 1; cls >= 0; cls--) {
+        const uint32_t free_blocks = stats.classes[cls].pooled + stats.classes[cls].cached;
+        if (free_blocks > 0) {
+            pxHeapStats->xNumberOfFreeBlocks += free_blocks;
+            pxHeapStats->xSizeOfSmallestFreeBlockInBytes = stats.classes[cls].block_bytes;
+        }
+    }
+}
+
+void rtos_slab_heap_port_stats_get(rtos_slab_heap_stats_t *stats)
+{
+    heap_init_check();
+    rtos_slab_heap_stats_get(&heap, stats);
+}
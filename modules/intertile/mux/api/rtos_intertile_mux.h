@@ -0,0 +1,242 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_INTERTILE_MUX_H_
+#define RTOS_INTERTILE_MUX_H_
+
+/**
+ * \addtogroup rtos_intertile_mux rtos_intertile_mux
+ *
+ * Prioritized channels multiplexed over a single intertile port.
+ *
+ * Each intertile port is a rendezvous between one sender and one receiver,
+ * and all ports share the same link between the tiles. While a large
+ * message is in flight on one port, a message on any other port waits for
+ * it to finish, however urgent it is. The multiplexer instead carries a
+ * number of channels over one port, splits each message into chunks of at
+ * most RTOS_INTERTILE_MUX_CHUNK_BYTES, and after every chunk sends the next
+ * chunk from the highest priority channel that has one ready. A short
+ * control message therefore waits for at most one chunk of a bulk transfer.
+ *
+ * Messages are queued by rtos_intertile_mux_tx(), which copies the message
+ * and returns without waiting for the other tile. Each channel has a
+ * number of credits, which is the number of complete messages the
+ * receiving tile is able to hold until they are taken by
+ * rtos_intertile_mux_rx(). A message is only started while the sender
+ * holds a credit, and the credit is returned once the receiving task has
+ * taken the message. A slow receiver on one channel therefore never stalls
+ * the link for the others.
+ *
+ * Credits bound the number of messages held, and each channel's maximum
+ * message length bounds their size. The receiving tile allocates each
+ * message as its first chunk arrives. If the allocation fails the message
+ * is read and dropped, and counted in rtos_intertile_mux_stats_t::rx_dropped.
+ *
+ * An instance must be created on both tiles, using the same intertile port,
+ * and each channel must be opened on both tiles with the same number of
+ * credits before either instance is started. Channels may have any number
+ * of sending and receiving tasks.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+
+/**
+ * The number of channels available on each instance.
+ */
+#ifndef RTOS_INTERTILE_MUX_CHANNELS
+#define RTOS_INTERTILE_MUX_CHANNELS 8
+#endif
+
+/**
+ * The largest amount of message data sent as one intertile message. Smaller
+ * chunks bound the wait of high priority channels more tightly, at the cost
+ * of more intertile messages per byte.
+ */
+#ifndef RTOS_INTERTILE_MUX_CHUNK_BYTES
+#define RTOS_INTERTILE_MUX_CHUNK_BYTES 256
+#endif
+
+#if (RTOS_INTERTILE_MUX_CHUNK_BYTES & 3) != 0
+#error RTOS_INTERTILE_MUX_CHUNK_BYTES must be a multiple of 4
+#endif
+
+/**
+ * Statistics kept for each channel. Times are in reference clock ticks.
+ */
+typedef struct {
+    uint32_t tx_messages;        /**< Messages completely sent. */
+    uint32_t tx_bytes;           /**< Bytes of message data sent. */
+    uint32_t tx_chunks;          /**< Intertile messages used to send them. */
+    uint32_t tx_queue_depth;     /**< Messages queued and not yet completely sent. */
+    uint32_t tx_queue_depth_max; /**< The highest value of tx_queue_depth. */
+    uint32_t credit_waits;       /**< Messages that had to wait for a credit before starting. */
+    uint32_t latency_last;       /**< Time from queueing to the last chunk being sent, for the last message. */
+    uint32_t latency_max;        /**< The longest such time. */
+    uint64_t latency_total;      /**< The sum of these times over all messages sent. */
+    uint32_t rx_messages;        /**< Messages completely received. */
+    uint32_t rx_bytes;           /**< Bytes of message data received. */
+    uint32_t rx_queue_depth;     /**< Received messages not yet taken by rtos_intertile_mux_rx(). */
+    uint32_t rx_queue_depth_max; /**< The highest value of rx_queue_depth. */
+    uint32_t rx_dropped;         /**< Messages dropped because they could not be allocated or were too long. */
+} rtos_intertile_mux_stats_t;
+
+/* A message queued for sending. Private to the implementation. */
+typedef struct rtos_intertile_mux_msg rtos_intertile_mux_msg_t;
+
+/**
+ * Struct representing a channel.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    unsigned open;
+    unsigned priority;
+    size_t max_len;
+
+    /* Sending */
+    rtos_intertile_mux_msg_t *tx_head;
+    rtos_intertile_mux_msg_t *tx_tail;
+    size_t tx_sent;
+    unsigned credits;
+    unsigned credit_wait;
+    rtos_osal_semaphore_t tx_space;
+
+    /* Receiving */
+    rtos_osal_queue_t rx_queue;
+    uint8_t *rx_buf;
+    size_t rx_len;
+    size_t rx_offset;
+    unsigned rx_drop;
+    unsigned credit_return;
+
+    rtos_intertile_mux_stats_t stats;
+} rtos_intertile_mux_chan_t;
+
+/**
+ * Typedef to the multiplexer instance struct.
+ */
+typedef struct rtos_intertile_mux_struct rtos_intertile_mux_t;
+
+/**
+ * Struct representing a multiplexer instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_intertile_mux_struct {
+    rtos_intertile_t *intertile_ctx;
+    uint8_t port;
+    unsigned last_chan;
+
+    rtos_osal_mutex_t lock;
+    rtos_osal_semaphore_t tx_work;
+    rtos_osal_thread_t tx_thread;
+    rtos_osal_thread_t rx_thread;
+
+    rtos_intertile_mux_chan_t chan[RTOS_INTERTILE_MUX_CHANNELS];
+
+    /* Each chunk is an 8 byte header followed by up to a chunk of data */
+    uint32_t tx_chunk[(8 + RTOS_INTERTILE_MUX_CHUNK_BYTES) / sizeof(uint32_t)];
+    uint32_t rx_chunk[(8 + RTOS_INTERTILE_MUX_CHUNK_BYTES) / sizeof(uint32_t)];
+};
+
+/**
+ * Initializes a multiplexer instance.
+ *
+ * \param mux            A pointer to the multiplexer instance
+ * \param intertile_ctx  A pointer to the intertile instance to use
+ * \param port           The intertile port to carry the channels. It must
+ *                       not be used for anything else.
+ */
+void rtos_intertile_mux_init(rtos_intertile_mux_t *mux,
+                             rtos_intertile_t *intertile_ctx,
+                             uint8_t port);
+
+/**
+ * Opens a channel. Must be called before rtos_intertile_mux_start().
+ *
+ * \param mux       A pointer to the multiplexer instance
+ * \param chan      The channel number, less than RTOS_INTERTILE_MUX_CHANNELS
+ * \param priority  The priority of messages sent from this tile. Chunks
+ *                  from channels with higher values are sent first.
+ *                  Channels of equal priority take turns.
+ * \param tx_depth  The number of messages that may be queued for sending
+ *                  before rtos_intertile_mux_tx() blocks
+ * \param credits   The number of received messages held for
+ *                  rtos_intertile_mux_rx(). Must be the same on both tiles.
+ * \param max_len   The length in bytes of the longest message. Longer
+ *                  messages are refused by rtos_intertile_mux_tx(), and
+ *                  dropped if received. Must be the same on both tiles.
+ */
+void rtos_intertile_mux_channel_open(rtos_intertile_mux_t *mux,
+                                     unsigned chan,
+                                     unsigned priority,
+                                     unsigned tx_depth,
+                                     unsigned credits,
+                                     size_t max_len);
+
+/**
+ * Starts the tasks that send and receive chunks.
+ *
+ * \param mux       A pointer to the multiplexer instance
+ * \param priority  The priority of the tasks. This should be higher than
+ *                  the priority of the tasks using the channels.
+ */
+void rtos_intertile_mux_start(rtos_intertile_mux_t *mux,
+                              unsigned priority);
+
+/**
+ * Queues a message to send on a channel. The message is copied, so the
+ * buffer may be reused as soon as this returns.
+ *
+ * \param mux      A pointer to the multiplexer instance
+ * \param chan     The channel to send on
+ * \param msg      The message to send
+ * \param len      The length of the message in bytes. Must be greater
+ *                 than 0.
+ * \param timeout  The maximum time to wait for space in the channel's queue
+ *
+ * \return \p len, or 0 on timeout, if the message is longer than the
+ *         channel's maximum length, or if it could not be allocated
+ */
+size_t rtos_intertile_mux_tx(rtos_intertile_mux_t *mux,
+                             unsigned chan,
+                             const void *msg,
+                             size_t len,
+                             unsigned timeout);
+
+/**
+ * Receives a message from a channel.
+ *
+ * \param mux      A pointer to the multiplexer instance
+ * \param chan     The channel to receive on
+ * \param msg      Receives a pointer to the message. It must be freed with
+ *                 rtos_osal_free() once it has been consumed.
+ * \param timeout  The maximum time to wait for a message
+ *
+ * \return the length of the message, or 0 on timeout
+ */
+size_t rtos_intertile_mux_rx(rtos_intertile_mux_t *mux,
+                             unsigned chan,
+                             void **msg,
+                             unsigned timeout);
+
+/**
+ * Gets the statistics of a channel.
+ *
+ * \param mux    A pointer to the multiplexer instance
+ * \param chan   The channel
+ * \param stats  Receives the statistics
+ */
+void rtos_intertile_mux_stats_get(rtos_intertile_mux_t *mux,
+                                  unsigned chan,
+                                  rtos_intertile_mux_stats_t *stats);
+
+/**@}*/
+
+#endif /* RTOS_INTERTILE_MUX_H_ */
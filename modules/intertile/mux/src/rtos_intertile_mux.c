@@ -0,0 +1,442 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#define DEBUG_UNIT RTOS_INTERTILE_MUX
+
+#include <string.h>
+
+#include <xcore/assert.h>
+#include <xcore/hwtimer.h>
+
+#include "rtos_intertile_mux.h"
+
+/*
+ * Every intertile message on the port is a chunk_hdr_t followed by up to
+ * RTOS_INTERTILE_MUX_CHUNK_BYTES of data. The first chunk of a message
+ * gives the length of the whole message in arg. A credit chunk carries no
+ * data and returns arg credits for the channel to the other tile.
+ */
+typedef struct {
+    uint8_t chan;
+    uint8_t flags;
+    uint16_t len;
+    uint32_t arg;
+} chunk_hdr_t;
+
+#define CHUNK_FIRST   0x01
+#define CHUNK_LAST    0x02
+#define CHUNK_CREDIT  0x04
+
+_Static_assert(sizeof(chunk_hdr_t) == 8, "chunk header size does not match the chunk buffers");
+
+/* The message data follows the struct */
+struct rtos_intertile_mux_msg {
+    rtos_intertile_mux_msg_t *next;
+    size_t len;
+    uint32_t queued;
+};
+
+/* An item in a channel's receive queue */
+typedef struct {
+    void *buf;
+    size_t len;
+} rx_msg_t;
+
+static void mux_lock(rtos_intertile_mux_t *mux)
+{
+    rtos_osal_mutex_get(&mux->lock, RTOS_OSAL_WAIT_FOREVER);
+}
+
+static void mux_unlock(rtos_intertile_mux_t *mux)
+{
+    rtos_osal_mutex_put(&mux->lock);
+}
+
+/*
+ * Sending
+ */
+
+/*
+ * Picks the channel to send the next chunk from. This is the highest
+ * priority channel with a message in progress, or with a message waiting
+ * and a credit to start it. Ties go to the first channel after the one
+ * that sent last. Must be called with the lock held.
+ */
+static rtos_intertile_mux_chan_t *tx_schedule(rtos_intertile_mux_t *mux)
+{
+    rtos_intertile_mux_chan_t *best = NULL;
+    unsigned best_i = 0;
+
+    for (unsigned n = 1; n <= RTOS_INTERTILE_MUX_CHANNELS; n++) {
+        const unsigned i = (mux->last_chan + n) % RTOS_INTERTILE_MUX_CHANNELS;
+        rtos_intertile_mux_chan_t *ch = &mux->chan[i];
+
+        if (ch->tx_head == NULL) {
+            continue;
+        }
+        if (ch->tx_sent == 0 && ch->credits == 0) {
+            if (!ch->credit_wait) {
+                ch->credit_wait = 1;
+                ch->stats.credit_waits++;
+            }
+            continue;
+        }
+        if (best == NULL || ch->priority > best->priority) {
+            best = ch;
+            best_i = i;
+        }
+    }
+
+    if (best != NULL) {
+        mux->last_chan = best_i;
+    }
+
+    return best;
+}
+
+/* Called once the last chunk of the message at the head of ch has been sent */
+static void tx_complete(rtos_intertile_mux_t *mux, rtos_intertile_mux_chan_t *ch)
+{
+    rtos_intertile_mux_msg_t *msg;
+    uint32_t latency;
+
+    mux_lock(mux);
+    msg = ch->tx_head;
+    ch->tx_head = msg->next;
+    if (ch->tx_head == NULL) {
+        ch->tx_tail = NULL;
+    }
+    ch->tx_sent = 0;
+
+    latency = get_reference_time() - msg->queued;
+    ch->stats.tx_messages++;
+    ch->stats.tx_bytes += msg->len;
+    ch->stats.tx_queue_depth--;
+    ch->stats.latency_last = latency;
+    ch->stats.latency_total += latency;
+    if (latency > ch->stats.latency_max) {
+        ch->stats.latency_max = latency;
+    }
+    mux_unlock(mux);
+
+    rtos_osal_free(msg);
+    rtos_osal_semaphore_put(&ch->tx_space);
+}
+
+/* Sends one chunk if there is one to send. Returns 0 if there was nothing to send. */
+static int tx_next(rtos_intertile_mux_t *mux)
+{
+    chunk_hdr_t *hdr = (chunk_hdr_t *) mux->tx_chunk;
+    rtos_intertile_mux_chan_t *ch;
+    rtos_intertile_mux_msg_t *msg;
+    size_t offset;
+
+    mux_lock(mux);
+
+    /* Credits are returned ahead of any data */
+    for (unsigned i = 0; i < RTOS_INTERTILE_MUX_CHANNELS; i++) {
+        if (mux->chan[i].credit_return > 0) {
+            hdr->chan = i;
+            hdr->flags = CHUNK_CREDIT;
+            hdr->len = 0;
+            hdr->arg = mux->chan[i].credit_return;
+            mux->chan[i].credit_return = 0;
+            mux_unlock(mux);
+
+            rtos_intertile_tx(mux->intertile_ctx, mux->port, hdr, sizeof(chunk_hdr_t));
+            return 1;
+        }
+    }
+
+    ch = tx_schedule(mux);
+    if (ch == NULL) {
+        mux_unlock(mux);
+        return 0;
+    }
+
+    /*
+     * Only this task removes messages from the queue or advances tx_sent,
+     * so the message can be read once the lock is released.
+     */
+    msg = ch->tx_head;
+    offset = ch->tx_sent;
+
+    hdr->chan = ch - mux->chan;
+    hdr->flags = 0;
+    hdr->arg = 0;
+    if (offset == 0) {
+        hdr->flags |= CHUNK_FIRST;
+        hdr->arg = msg->len;
+        ch->credits--;
+        ch->credit_wait = 0;
+    }
+    hdr->len = msg->len - offset < RTOS_INTERTILE_MUX_CHUNK_BYTES ? msg->len - offset : RTOS_INTERTILE_MUX_CHUNK_BYTES;
+    if (offset + hdr->len == msg->len) {
+        hdr->flags |= CHUNK_LAST;
+    }
+    ch->tx_sent += hdr->len;
+    ch->stats.tx_chunks++;
+
+    mux_unlock(mux);
+
+    memcpy(hdr + 1, (const uint8_t *) (msg + 1) + offset, hdr->len);
+    rtos_intertile_tx(mux->intertile_ctx, mux->port, hdr, sizeof(chunk_hdr_t) + hdr->len);
+
+    if (hdr->flags & CHUNK_LAST) {
+        tx_complete(mux, ch);
+    }
+
+    return 1;
+}
+
+static void tx_thread(rtos_intertile_mux_t *mux)
+{
+    for (;;) {
+        if (!tx_next(mux)) {
+            rtos_osal_semaphore_get(&mux->tx_work, RTOS_OSAL_WAIT_FOREVER);
+        }
+    }
+}
+
+/*
+ * Receiving
+ */
+
+/*
+ * Called once the last chunk of a message that could not be held has been
+ * read. The message never takes its place in the receive queue, so its
+ * credit is returned straight away.
+ */
+static void rx_drop_complete(rtos_intertile_mux_t *mux, rtos_intertile_mux_chan_t *ch)
+{
+    ch->rx_drop = 0;
+
+    mux_lock(mux);
+    ch->stats.rx_dropped++;
+    ch->credit_return++;
+    mux_unlock(mux);
+
+    rtos_osal_semaphore_put(&mux->tx_work);
+}
+
+static void rx_data(rtos_intertile_mux_t *mux, rtos_intertile_mux_chan_t *ch, const chunk_hdr_t *hdr)
+{
+    if (hdr->flags & CHUNK_FIRST) {
+        xassert(ch->rx_buf == NULL && !ch->rx_drop);
+        ch->rx_len = hdr->arg;
+        ch->rx_offset = 0;
+
+        /* The length is chosen by the sender, so is checked before anything is allocated */
+        if (hdr->arg <= ch->max_len) {
+            ch->rx_buf = rtos_osal_malloc(hdr->arg);
+        }
+        if (ch->rx_buf == NULL) {
+            ch->rx_drop = 1;
+        }
+    }
+
+    xassert((ch->rx_buf != NULL || ch->rx_drop) && ch->rx_offset + hdr->len <= ch->rx_len);
+    if (!ch->rx_drop) {
+        memcpy(ch->rx_buf + ch->rx_offset, hdr + 1, hdr->len);
+    }
+    ch->rx_offset += hdr->len;
+
+    if ((hdr->flags & CHUNK_LAST) && ch->rx_drop) {
+        xassert(ch->rx_offset == ch->rx_len);
+        rx_drop_complete(mux, ch);
+    } else if (hdr->flags & CHUNK_LAST) {
+        const rx_msg_t m = {ch->rx_buf, ch->rx_len};
+        rtos_osal_status_t status;
+
+        xassert(ch->rx_offset == ch->rx_len);
+
+        mux_lock(mux);
+        ch->stats.rx_messages++;
+        ch->stats.rx_bytes += ch->rx_len;
+        ch->stats.rx_queue_depth++;
+        if (ch->stats.rx_queue_depth > ch->stats.rx_queue_depth_max) {
+            ch->stats.rx_queue_depth_max = ch->stats.rx_queue_depth;
+        }
+        mux_unlock(mux);
+
+        /* The sender held a credit for this message, so there is room for it */
+        status = rtos_osal_queue_send(&ch->rx_queue, &m, RTOS_OSAL_NO_WAIT);
+        xassert(status == RTOS_OSAL_SUCCESS);
+        (void) status;
+
+        ch->rx_buf = NULL;
+    }
+}
+
+static void rx_thread(rtos_intertile_mux_t *mux)
+{
+    const chunk_hdr_t *hdr = (const chunk_hdr_t *) mux->rx_chunk;
+
+    for (;;) {
+        const size_t len = rtos_intertile_rx_len(mux->intertile_ctx, mux->port, RTOS_OSAL_WAIT_FOREVER);
+        rtos_intertile_mux_chan_t *ch;
+
+        xassert(len >= sizeof(chunk_hdr_t) && len <= sizeof(mux->rx_chunk));
+        rtos_intertile_rx_data(mux->intertile_ctx, mux->rx_chunk, len);
+
+        xassert(hdr->chan < RTOS_INTERTILE_MUX_CHANNELS && mux->chan[hdr->chan].open);
+        xassert(len == sizeof(chunk_hdr_t) + hdr->len);
+        ch = &mux->chan[hdr->chan];
+
+        if (hdr->flags & CHUNK_CREDIT) {
+            mux_lock(mux);
+            ch->credits += hdr->arg;
+            mux_unlock(mux);
+            rtos_osal_semaphore_put(&mux->tx_work);
+        } else {
+            rx_data(mux, ch, hdr);
+        }
+    }
+}
+
+/*
+ * API
+ */
+
+void rtos_intertile_mux_init(rtos_intertile_mux_t *mux,
+                             rtos_intertile_t *intertile_ctx,
+                             uint8_t port)
+{
+    memset(mux, 0, sizeof(*mux));
+    mux->intertile_ctx = intertile_ctx;
+    mux->port = port;
+
+    rtos_osal_mutex_create(&mux->lock, "intertile_mux", RTOS_OSAL_NOT_RECURSIVE);
+
+    /* Only wakes the sending task, so one pending signal is enough */
+    rtos_osal_semaphore_create(&mux->tx_work, "intertile_mux_tx", 1, 0);
+}
+
+void rtos_intertile_mux_channel_open(rtos_intertile_mux_t *mux,
+                                     unsigned chan,
+                                     unsigned priority,
+                                     unsigned tx_depth,
+                                     unsigned credits,
+                                     size_t max_len)
+{
+    rtos_intertile_mux_chan_t *ch;
+
+    xassert(chan < RTOS_INTERTILE_MUX_CHANNELS);
+    xassert(tx_depth > 0 && credits > 0 && max_len > 0);
+
+    ch = &mux->chan[chan];
+    xassert(!ch->open);
+
+    ch->priority = priority;
+    ch->credits = credits;
+    ch->max_len = max_len;
+    rtos_osal_semaphore_create(&ch->tx_space, "intertile_mux_tx_space", tx_depth, tx_depth);
+    rtos_osal_queue_create(&ch->rx_queue, "intertile_mux_rx", credits, sizeof(rx_msg_t));
+    ch->open = 1;
+}
+
+void rtos_intertile_mux_start(rtos_intertile_mux_t *mux,
+                              unsigned priority)
+{
+    rtos_osal_thread_create(
+            &mux->rx_thread,
+            "intertile_mux_rx",
+            (rtos_osal_entry_function_t) rx_thread,
+            mux,
+            RTOS_THREAD_STACK_SIZE(rx_thread),
+            priority);
+
+    rtos_osal_thread_create(
+            &mux->tx_thread,
+            "intertile_mux_tx",
+            (rtos_osal_entry_function_t) tx_thread,
+            mux,
+            RTOS_THREAD_STACK_SIZE(tx_thread),
+            priority);
+}
+
+size_t rtos_intertile_mux_tx(rtos_intertile_mux_t *mux,
+                             unsigned chan,
+                             const void *msg,
+                             size_t len,
+                             unsigned timeout)
+{
+    rtos_intertile_mux_chan_t *ch;
+    rtos_intertile_mux_msg_t *m;
+
+    xassert(chan < RTOS_INTERTILE_MUX_CHANNELS && mux->chan[chan].open);
+    xassert(len > 0);
+    ch = &mux->chan[chan];
+
+    if (len > ch->max_len) {
+        return 0;
+    }
+
+    if (rtos_osal_semaphore_get(&ch->tx_space, timeout) != RTOS_OSAL_SUCCESS) {
+        return 0;
+    }
+
+    m = rtos_osal_malloc(sizeof(rtos_intertile_mux_msg_t) + len);
+    if (m == NULL) {
+        rtos_osal_semaphore_put(&ch->tx_space);
+        return 0;
+    }
+    memcpy(m + 1, msg, len);
+    m->next = NULL;
+    m->len = len;
+    m->queued = get_reference_time();
+
+    mux_lock(mux);
+    if (ch->tx_tail != NULL) {
+        ch->tx_tail->next = m;
+    } else {
+        ch->tx_head = m;
+    }
+    ch->tx_tail = m;
+    ch->stats.tx_queue_depth++;
+    if (ch->stats.tx_queue_depth > ch->stats.tx_queue_depth_max) {
+        ch->stats.tx_queue_depth_max = ch->stats.tx_queue_depth;
+    }
+    mux_unlock(mux);
+
+    rtos_osal_semaphore_put(&mux->tx_work);
+
+    return len;
+}
+
+size_t rtos_intertile_mux_rx(rtos_intertile_mux_t *mux,
+                             unsigned chan,
+                             void **msg,
+                             unsigned timeout)
+{
+    rtos_intertile_mux_chan_t *ch;
+    rx_msg_t m;
+
+    xassert(chan < RTOS_INTERTILE_MUX_CHANNELS && mux->chan[chan].open);
+    ch = &mux->chan[chan];
+
+    if (rtos_osal_queue_receive(&ch->rx_queue, &m, timeout) != RTOS_OSAL_SUCCESS) {
+        return 0;
+    }
+
+    mux_lock(mux);
+    ch->stats.rx_queue_depth--;
+    ch->credit_return++;
+    mux_unlock(mux);
+
+    rtos_osal_semaphore_put(&mux->tx_work);
+
+    *msg = m.buf;
+    return m.len;
+}
+
+void rtos_intertile_mux_stats_get(rtos_intertile_mux_t *mux,
+                                  unsigned chan,
+                                  rtos_intertile_mux_stats_t *stats)
+{
+    xassert(chan < RTOS_INTERTILE_MUX_CHANNELS);
+
+    mux_lock(mux);
+    *stats = mux->chan[chan].stats;
+    mux_unlock(mux);
+}
@@ -0,0 +1,344 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_RPC_ASYNC_H_
+#define RTOS_RPC_ASYNC_H_
+
+/**
+ * \addtogroup rtos_rpc_async rtos_rpc_async
+ *
+ * Asynchronous, batched remote procedure calls between tiles.
+ *
+ * The RPC built into the RTOS drivers makes every call on a remote driver
+ * instance a blocking intertile round trip. With this API a client instead
+ * queues calls, each paired with a future, and carries on. Queued calls are
+ * packed into a single intertile message, the batch, which is sent when it
+ * is full, when rtos_rpc_async_flush() is called, or when the client waits
+ * on a future whose call has not been sent. The host runs the calls of a
+ * batch in order and returns all of their results in a single reply, so a
+ * burst of N calls costs one round trip rather than N.
+ *
+ * Each client talks to one host over its own intertile port, and both use a
+ * fixed size buffer for batches; nothing is allocated per call. A client
+ * must only be used by one task. Replies are received by that task while it
+ * waits on or polls its futures.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+
+/**
+ * The maximum size of a batch, excluding its header. This limits both the
+ * total size of the requests in a batch and the total size of the responses
+ * they may return.
+ */
+#ifndef RTOS_RPC_ASYNC_BATCH_BYTES
+#define RTOS_RPC_ASYNC_BATCH_BYTES 512
+#endif
+
+#if (RTOS_RPC_ASYNC_BATCH_BYTES % 4) != 0 || RTOS_RPC_ASYNC_BATCH_BYTES > 0xFFFC
+#error RTOS_RPC_ASYNC_BATCH_BYTES must be a multiple of 4 and less than 64 KiB
+#endif
+
+/**
+ * The maximum number of calls in a batch.
+ */
+#ifndef RTOS_RPC_ASYNC_BATCH_CALLS
+#define RTOS_RPC_ASYNC_BATCH_CALLS 16
+#endif
+
+/**
+ * The number of function codes a host can register handlers for.
+ */
+#ifndef RTOS_RPC_ASYNC_FCODE_COUNT
+#define RTOS_RPC_ASYNC_FCODE_COUNT 32
+#endif
+
+/**
+ * The first function code available to applications. Function codes below
+ * this are used by the driver bindings in rtos_rpc_async_drivers.h.
+ */
+#define RTOS_RPC_ASYNC_FCODE_USER 8
+
+/**
+ * Call status values reserved by the RPC layer. Handlers should return
+ * values outside of this range.
+ */
+#define RTOS_RPC_ASYNC_ERR_FCODE    (-1000) /**< The host has no handler for the function code. */
+#define RTOS_RPC_ASYNC_ERR_SIZE     (-1001) /**< The request and response do not fit in a batch. */
+#define RTOS_RPC_ASYNC_ERR_TIMEOUT  (-1002) /**< The wait timed out. The call is still outstanding. */
+
+/**
+ * Function pointer group for RPC handlers.
+ */
+#define RTOS_RPC_ASYNC_HANDLER_ATTR __attribute__((fptrgroup("rtos_rpc_async_handler_fptr_grp")))
+
+/**
+ * An RPC handler. Runs in the host task.
+ *
+ * \param arg       The argument given when the handler was registered
+ * \param req       The request sent by the client
+ * \param req_len   The length of the request in bytes
+ * \param resp      Buffer for the response
+ * \param resp_len  On entry, the size of \p resp, which is the response size
+ *                  the client can accept. On return, the number of bytes
+ *                  written to \p resp.
+ *
+ * \return the call status, passed to the client as is. Only the low 16 bits
+ *         are sent, so it must be in the range of an int16_t.
+ */
+typedef int (*rtos_rpc_async_handler_t)(void *arg,
+                                        const void *req,
+                                        size_t req_len,
+                                        void *resp,
+                                        size_t *resp_len);
+
+/** The state of a future. */
+typedef enum {
+    RTOS_RPC_FUTURE_IDLE = 0,   /**< Not in use. */
+    RTOS_RPC_FUTURE_QUEUED,     /**< The call is in a batch that has not been sent. */
+    RTOS_RPC_FUTURE_SENT,       /**< The call has been sent and its result has not been received. */
+    RTOS_RPC_FUTURE_DONE,       /**< The result has been received. */
+} rtos_rpc_future_state_t;
+
+/**
+ * Typedef to the future struct.
+ */
+typedef struct rtos_rpc_future_struct rtos_rpc_future_t;
+
+/**
+ * Struct representing the future result of one call. It is owned by the
+ * caller and must not be reused or go out of scope until the call is done.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_rpc_future_struct {
+    volatile rtos_rpc_future_state_t state;
+    int status;
+    void *resp;
+    size_t resp_max;
+    size_t resp_len;
+    rtos_rpc_future_t *next;
+};
+
+/** Client statistics. */
+typedef struct {
+    uint32_t calls;         /**< Calls queued. */
+    uint32_t batches;       /**< Batches sent. */
+    uint32_t replies;       /**< Replies received. */
+    uint32_t full;          /**< Batches sent because the next call did not fit. */
+} rtos_rpc_async_client_stats_t;
+
+/** Host statistics. */
+typedef struct {
+    uint32_t calls;         /**< Calls run. */
+    uint32_t batches;       /**< Batches received. */
+    uint32_t max_calls;     /**< Most calls in a single batch. */
+} rtos_rpc_async_host_stats_t;
+
+/**
+ * Typedef to the client instance struct.
+ */
+typedef struct rtos_rpc_async_client_struct rtos_rpc_async_client_t;
+
+/**
+ * Struct representing a client instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_rpc_async_client_struct {
+    rtos_intertile_t *intertile_ctx;
+    uint8_t port;
+    uint16_t seq;
+
+    size_t batch_len;
+    size_t batch_resp_len;
+    unsigned batch_calls;
+
+    /* Outstanding calls in the order they were queued */
+    rtos_rpc_future_t *head;
+    rtos_rpc_future_t *tail;
+    rtos_rpc_future_t *first_queued;
+
+    rtos_rpc_async_client_stats_t stats;
+
+    uint32_t batch[(4 + RTOS_RPC_ASYNC_BATCH_BYTES) / sizeof(uint32_t)];
+    uint32_t reply[(4 + RTOS_RPC_ASYNC_BATCH_BYTES) / sizeof(uint32_t)];
+};
+
+/**
+ * Typedef to the host instance struct.
+ */
+typedef struct rtos_rpc_async_host_struct rtos_rpc_async_host_t;
+
+/**
+ * Struct representing a host instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_rpc_async_host_struct {
+    rtos_intertile_t *intertile_ctx;
+    uint8_t port;
+    rtos_osal_thread_t thread;
+
+    RTOS_RPC_ASYNC_HANDLER_ATTR rtos_rpc_async_handler_t handler[RTOS_RPC_ASYNC_FCODE_COUNT];
+    void *handler_arg[RTOS_RPC_ASYNC_FCODE_COUNT];
+
+    rtos_rpc_async_host_stats_t stats;
+
+    uint32_t batch[(4 + RTOS_RPC_ASYNC_BATCH_BYTES) / sizeof(uint32_t)];
+    uint32_t reply[(4 + RTOS_RPC_ASYNC_BATCH_BYTES) / sizeof(uint32_t)];
+};
+
+/**
+ * Initializes an RPC host. Handlers should be registered before the host is
+ * started.
+ *
+ * \param host           A pointer to the host instance
+ * \param intertile_ctx  The intertile instance connected to the client's tile
+ * \param port           The intertile port shared with the client
+ */
+void rtos_rpc_async_host_init(rtos_rpc_async_host_t *host,
+                              rtos_intertile_t *intertile_ctx,
+                              uint8_t port);
+
+/**
+ * Registers a handler for a function code.
+ *
+ * \param host     A pointer to the host instance
+ * \param fcode    The function code, less than RTOS_RPC_ASYNC_FCODE_COUNT
+ * \param handler  The handler
+ * \param arg      An argument passed to the handler, such as a driver instance
+ */
+void rtos_rpc_async_host_register(rtos_rpc_async_host_t *host,
+                                  unsigned fcode,
+                                  rtos_rpc_async_handler_t handler,
+                                  void *arg);
+
+/**
+ * Starts the host task, which runs batches as they arrive.
+ *
+ * \param host      A pointer to the host instance
+ * \param priority  The priority of the host task
+ */
+void rtos_rpc_async_host_start(rtos_rpc_async_host_t *host,
+                               unsigned priority);
+
+/**
+ * Gets a snapshot of the host statistics.
+ *
+ * \param host   A pointer to the host instance
+ * \param stats  A pointer to the struct to populate
+ */
+void rtos_rpc_async_host_stats_get(const rtos_rpc_async_host_t *host,
+                                   rtos_rpc_async_host_stats_t *stats);
+
+/**
+ * Initializes an RPC client.
+ *
+ * \param client         A pointer to the client instance
+ * \param intertile_ctx  The intertile instance connected to the host's tile
+ * \param port           The intertile port shared with the host
+ */
+void rtos_rpc_async_client_init(rtos_rpc_async_client_t *client,
+                                rtos_intertile_t *intertile_ctx,
+                                uint8_t port);
+
+/**
+ * Queues a call. The current batch is sent first if the call does not fit
+ * in it, which waits for the reply to any batch in flight. A call whose
+ * request and response cannot fit in any batch completes immediately with
+ * RTOS_RPC_ASYNC_ERR_SIZE. The host also completes a call with
+ * RTOS_RPC_ASYNC_ERR_SIZE if its response would not fit in the reply.
+ *
+ * \param client    A pointer to the client instance
+ * \param future    The future that receives the result
+ * \param fcode     The function code
+ * \param req       The request, copied into the batch before returning
+ * \param req_len   The length of the request in bytes
+ * \param resp      Buffer for the response. Written when the reply is
+ *                  received, so it must stay valid until the call is done.
+ * \param resp_max  The size of \p resp in bytes
+ */
+void rtos_rpc_async_call(rtos_rpc_async_client_t *client,
+                         rtos_rpc_future_t *future,
+                         unsigned fcode,
+                         const void *req,
+                         size_t req_len,
+                         void *resp,
+                         size_t resp_max);
+
+/**
+ * Sends the current batch, if it holds any calls. Only one batch is in
+ * flight at a time, so this first waits for the replies to any batches
+ * already sent, completing their futures.
+ *
+ * \param client  A pointer to the client instance
+ */
+void rtos_rpc_async_flush(rtos_rpc_async_client_t *client);
+
+/**
+ * Receives any replies that have already arrived, without blocking.
+ *
+ * \param client  A pointer to the client instance
+ *
+ * \return the number of calls completed
+ */
+unsigned rtos_rpc_async_poll(rtos_rpc_async_client_t *client);
+
+/**
+ * Waits for a call to complete. Sends the batch holding the call first if
+ * it has not been sent. Replies to earlier calls are received, and their
+ * futures completed, on the way.
+ *
+ * \param client   A pointer to the client instance
+ * \param future   The future to wait on
+ * \param timeout  The maximum time to wait for each reply
+ *
+ * \return the call status, or RTOS_RPC_ASYNC_ERR_TIMEOUT
+ */
+int rtos_rpc_future_wait(rtos_rpc_async_client_t *client,
+                         rtos_rpc_future_t *future,
+                         unsigned timeout);
+
+/**
+ * Checks whether a call has completed, without receiving replies.
+ *
+ * \param future  The future to check
+ *
+ * \return non-zero if the call has completed
+ */
+inline int rtos_rpc_future_done(const rtos_rpc_future_t *future)
+{
+    return future->state == RTOS_RPC_FUTURE_DONE;
+}
+
+/**
+ * Gets the number of response bytes returned by a completed call.
+ *
+ * \param future  The future of a completed call
+ *
+ * \return the response length in bytes
+ */
+inline size_t rtos_rpc_future_resp_len(const rtos_rpc_future_t *future)
+{
+    return future->resp_len;
+}
+
+/**
+ * Gets a snapshot of the client statistics.
+ *
+ * \param client  A pointer to the client instance
+ * \param stats   A pointer to the struct to populate
+ */
+void rtos_rpc_async_client_stats_get(const rtos_rpc_async_client_t *client,
+                                     rtos_rpc_async_client_stats_t *stats);
+
+/**@}*/
+
+#endif /* RTOS_RPC_ASYNC_H_ */
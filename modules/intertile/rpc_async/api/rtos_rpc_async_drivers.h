@@ -0,0 +1,112 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_RPC_ASYNC_DRIVERS_H_
+#define RTOS_RPC_ASYNC_DRIVERS_H_
+
+/**
+ * \addtogroup rtos_rpc_async_drivers rtos_rpc_async_drivers
+ *
+ * Asynchronous versions of the most frequently called GPIO and I2C master
+ * driver functions, for use on the tile that does not own the driver
+ * instance. On the tile that owns the instance, register the handlers with
+ * the RPC host. On the other tile, each call below queues the operation on
+ * an RPC client and returns; its result is available once the future is
+ * done. The status of a GPIO call is always 0. The status of an I2C call is
+ * the driver's return value.
+ *
+ * @{
+ */
+
+#include "rtos_gpio.h"
+#include "rtos_i2c_master.h"
+
+#include "rtos_rpc_async.h"
+
+/** Function codes used by the driver bindings. */
+enum {
+    RTOS_RPC_ASYNC_FCODE_GPIO_PORT_IN = 0,
+    RTOS_RPC_ASYNC_FCODE_GPIO_PORT_OUT,
+    RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_READ,
+    RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_WRITE,
+};
+
+/**
+ * Registers the GPIO handlers with an RPC host.
+ *
+ * \param host      A pointer to the RPC host instance
+ * \param gpio_ctx  A pointer to the local GPIO driver instance
+ */
+void rtos_rpc_async_gpio_host_register(rtos_rpc_async_host_t *host,
+                                       rtos_gpio_t *gpio_ctx);
+
+/**
+ * Queues a read of a GPIO port.
+ *
+ * \param client   A pointer to the RPC client instance
+ * \param future   The future for the call
+ * \param port_id  The GPIO port ID
+ * \param value    Receives the value of the port
+ */
+void rtos_rpc_async_gpio_port_in(rtos_rpc_async_client_t *client,
+                                 rtos_rpc_future_t *future,
+                                 rtos_gpio_port_id_t port_id,
+                                 uint32_t *value);
+
+/**
+ * Queues a write to a GPIO port.
+ *
+ * \param client   A pointer to the RPC client instance
+ * \param future   The future for the call
+ * \param port_id  The GPIO port ID
+ * \param value    The value to write
+ */
+void rtos_rpc_async_gpio_port_out(rtos_rpc_async_client_t *client,
+                                  rtos_rpc_future_t *future,
+                                  rtos_gpio_port_id_t port_id,
+                                  uint32_t value);
+
+/**
+ * Registers the I2C master handlers with an RPC host.
+ *
+ * \param host            A pointer to the RPC host instance
+ * \param i2c_master_ctx  A pointer to the local I2C master driver instance
+ */
+void rtos_rpc_async_i2c_master_host_register(rtos_rpc_async_host_t *host,
+                                             rtos_i2c_master_t *i2c_master_ctx);
+
+/**
+ * Queues a read of a single byte register.
+ *
+ * \param client       A pointer to the RPC client instance
+ * \param future       The future for the call. Its status is an
+ *                     i2c_regop_res_t.
+ * \param device_addr  The address of the device
+ * \param reg_addr     The address of the register
+ * \param data         Receives the value of the register
+ */
+void rtos_rpc_async_i2c_master_reg_read(rtos_rpc_async_client_t *client,
+                                        rtos_rpc_future_t *future,
+                                        uint8_t device_addr,
+                                        uint8_t reg_addr,
+                                        uint8_t *data);
+
+/**
+ * Queues a write to a single byte register.
+ *
+ * \param client       A pointer to the RPC client instance
+ * \param future       The future for the call. Its status is an
+ *                     i2c_regop_res_t.
+ * \param device_addr  The address of the device
+ * \param reg_addr     The address of the register
+ * \param data         The value to write
+ */
+void rtos_rpc_async_i2c_master_reg_write(rtos_rpc_async_client_t *client,
+                                         rtos_rpc_future_t *future,
+                                         uint8_t device_addr,
+                                         uint8_t reg_addr,
+                                         uint8_t data);
+
+/**@}*/
+
+#endif /* RTOS_RPC_ASYNC_DRIVERS_H_ */
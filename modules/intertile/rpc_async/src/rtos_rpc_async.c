@@ -0,0 +1,355 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#define DEBUG_UNIT RTOS_RPC_ASYNC
+
+#include <string.h>
+
+#include <xcore/assert.h>
+
+#include "rtos_printf.h"
+#include "rtos_rpc_async.h"
+
+/*
+ * A batch is a batch_hdr_t followed by one record per call. Each request
+ * record is a req_hdr_t followed by the request, and each reply record is a
+ * resp_hdr_t followed by the response. Records are padded to a multiple of
+ * four bytes. Both tiles share the same byte order and alignment rules, so
+ * the headers are sent as they are laid out in memory.
+ */
+typedef struct {
+    uint16_t count;
+    uint16_t seq;
+} batch_hdr_t;
+
+typedef struct {
+    uint8_t fcode;
+    uint8_t reserved;
+    uint16_t req_len;
+    uint16_t resp_max;
+    uint16_t reserved2;
+} req_hdr_t;
+
+typedef struct {
+    int16_t status;
+    uint16_t resp_len;
+} resp_hdr_t;
+
+#define PAD4(n) (((n) + 3) & ~3)
+
+static size_t req_record_len(size_t req_len)
+{
+    return sizeof(req_hdr_t) + PAD4(req_len);
+}
+
+static size_t resp_record_len(size_t resp_max)
+{
+    return sizeof(resp_hdr_t) + PAD4(resp_max);
+}
+
+/*
+ * Host
+ */
+
+static void host_run_batch(rtos_rpc_async_host_t *host, size_t len)
+{
+    const batch_hdr_t *hdr = (const batch_hdr_t *) host->batch;
+    const uint8_t *in = (const uint8_t *) host->batch + sizeof(batch_hdr_t);
+    const uint8_t *in_end = (const uint8_t *) host->batch + len;
+    batch_hdr_t *reply_hdr = (batch_hdr_t *) host->reply;
+    uint8_t *out = (uint8_t *) host->reply + sizeof(batch_hdr_t);
+    const uint8_t *out_end = (const uint8_t *) host->reply + sizeof(host->reply);
+    uint16_t i;
+
+    for (i = 0; i < hdr->count; i++) {
+        const req_hdr_t *req = (const req_hdr_t *) in;
+        resp_hdr_t *resp = (resp_hdr_t *) out;
+        size_t resp_len = req->resp_max;
+        int status;
+
+        xassert(in + sizeof(req_hdr_t) <= in_end && in + req_record_len(req->req_len) <= in_end);
+
+        /*
+         * Each request record is at least twice the size of a reply header,
+         * so the headers for the rest of the batch always fit. Only a
+         * response that would leave no room for them is refused.
+         */
+        if (out + resp_record_len(req->resp_max) + (hdr->count - i - 1) * sizeof(resp_hdr_t) > out_end) {
+            rtos_printf("RPC async host reply overflow for fcode %d\n", req->fcode);
+            status = RTOS_RPC_ASYNC_ERR_SIZE;
+            resp_len = 0;
+        } else if (req->fcode < RTOS_RPC_ASYNC_FCODE_COUNT && host->handler[req->fcode] != NULL) {
+            RTOS_RPC_ASYNC_HANDLER_ATTR rtos_rpc_async_handler_t handler = host->handler[req->fcode];
+            status = handler(host->handler_arg[req->fcode], req + 1, req->req_len, resp + 1, &resp_len);
+            if (resp_len > req->resp_max) {
+                resp_len = req->resp_max;
+            }
+        } else {
+            rtos_printf("RPC async host has no handler for fcode %d\n", req->fcode);
+            status = RTOS_RPC_ASYNC_ERR_FCODE;
+            resp_len = 0;
+        }
+
+        resp->status = status;
+        resp->resp_len = resp_len;
+
+        in += req_record_len(req->req_len);
+        out += resp_record_len(resp_len);
+    }
+
+    reply_hdr->count = hdr->count;
+    reply_hdr->seq = hdr->seq;
+
+    host->stats.batches++;
+    host->stats.calls += hdr->count;
+    if (hdr->count > host->stats.max_calls) {
+        host->stats.max_calls = hdr->count;
+    }
+
+    rtos_intertile_tx(host->intertile_ctx, host->port, host->reply, out - (uint8_t *) host->reply);
+}
+
+static void host_thread(rtos_rpc_async_host_t *host)
+{
+    for (;;) {
+        size_t len = rtos_intertile_rx_len(host->intertile_ctx, host->port, RTOS_OSAL_WAIT_FOREVER);
+
+        xassert(len >= sizeof(batch_hdr_t) && len <= sizeof(host->batch));
+        rtos_intertile_rx_data(host->intertile_ctx, host->batch, len);
+
+        host_run_batch(host, len);
+    }
+}
+
+void rtos_rpc_async_host_init(rtos_rpc_async_host_t *host,
+                              rtos_intertile_t *intertile_ctx,
+                              uint8_t port)
+{
+    memset(host, 0, sizeof(*host));
+    host->intertile_ctx = intertile_ctx;
+    host->port = port;
+}
+
+void rtos_rpc_async_host_register(rtos_rpc_async_host_t *host,
+                                  unsigned fcode,
+                                  rtos_rpc_async_handler_t handler,
+                                  void *arg)
+{
+    xassert(fcode < RTOS_RPC_ASYNC_FCODE_COUNT);
+
+    host->handler_arg[fcode] = arg;
+    host->handler[fcode] = handler;
+}
+
+void rtos_rpc_async_host_start(rtos_rpc_async_host_t *host,
+                               unsigned priority)
+{
+    rtos_osal_thread_create(
+            &host->thread,
+            "rpc_async_host",
+            (rtos_osal_entry_function_t) host_thread,
+            host,
+            RTOS_THREAD_STACK_SIZE(host_thread),
+            priority);
+}
+
+void rtos_rpc_async_host_stats_get(const rtos_rpc_async_host_t *host,
+                                   rtos_rpc_async_host_stats_t *stats)
+{
+    *stats = host->stats;
+}
+
+/*
+ * Client
+ */
+
+static void future_complete(rtos_rpc_future_t *future, int status, size_t resp_len)
+{
+    future->status = status;
+    future->resp_len = resp_len;
+    future->next = NULL;
+    future->state = RTOS_RPC_FUTURE_DONE;
+}
+
+/* Receives one reply if one arrives within the timeout. Returns the number of calls completed. */
+static unsigned client_receive(rtos_rpc_async_client_t *client, unsigned timeout)
+{
+    const batch_hdr_t *hdr = (const batch_hdr_t *) client->reply;
+    const uint8_t *in = (const uint8_t *) client->reply + sizeof(batch_hdr_t);
+    size_t len;
+    uint16_t i;
+
+    len = rtos_intertile_rx_len(client->intertile_ctx, client->port, timeout);
+    if (len == 0) {
+        return 0;
+    }
+
+    xassert(len >= sizeof(batch_hdr_t) && len <= sizeof(client->reply));
+    rtos_intertile_rx_data(client->intertile_ctx, client->reply, len);
+
+    /* Replies come back in the order the batches were sent */
+    for (i = 0; i < hdr->count; i++) {
+        const resp_hdr_t *resp = (const resp_hdr_t *) in;
+        rtos_rpc_future_t *future = client->head;
+        size_t resp_len = resp->resp_len;
+
+        xassert(future != NULL && future->state == RTOS_RPC_FUTURE_SENT);
+
+        client->head = future->next;
+        if (client->head == NULL) {
+            client->tail = NULL;
+        }
+
+        if (resp_len > future->resp_max) {
+            resp_len = future->resp_max;
+        }
+        if (resp_len > 0) {
+            memcpy(future->resp, resp + 1, resp_len);
+        }
+        future_complete(future, resp->status, resp_len);
+
+        in += resp_record_len(resp->resp_len);
+    }
+
+    client->stats.replies++;
+
+    return hdr->count;
+}
+
+void rtos_rpc_async_client_init(rtos_rpc_async_client_t *client,
+                                rtos_intertile_t *intertile_ctx,
+                                uint8_t port)
+{
+    memset(client, 0, sizeof(*client));
+    client->intertile_ctx = intertile_ctx;
+    client->port = port;
+}
+
+void rtos_rpc_async_flush(rtos_rpc_async_client_t *client)
+{
+    batch_hdr_t *hdr = (batch_hdr_t *) client->batch;
+    rtos_rpc_future_t *future;
+
+    if (client->batch_calls == 0) {
+        return;
+    }
+
+    /*
+     * The host blocks sending a reply until it is received, and it cannot
+     * receive this batch until then. Collect the replies to batches already
+     * sent first, so at most one batch is ever in flight.
+     */
+    while (client->head != NULL && client->head->state == RTOS_RPC_FUTURE_SENT) {
+        client_receive(client, RTOS_OSAL_WAIT_FOREVER);
+    }
+
+    hdr->count = client->batch_calls;
+    hdr->seq = client->seq++;
+
+    for (future = client->first_queued; future != NULL; future = future->next) {
+        future->state = RTOS_RPC_FUTURE_SENT;
+    }
+
+    rtos_intertile_tx(client->intertile_ctx, client->port, client->batch, sizeof(batch_hdr_t) + client->batch_len);
+
+    client->first_queued = NULL;
+    client->batch_len = 0;
+    client->batch_resp_len = 0;
+    client->batch_calls = 0;
+    client->stats.batches++;
+}
+
+void rtos_rpc_async_call(rtos_rpc_async_client_t *client,
+                         rtos_rpc_future_t *future,
+                         unsigned fcode,
+                         const void *req,
+                         size_t req_len,
+                         void *resp,
+                         size_t resp_max)
+{
+    const size_t req_rec = req_record_len(req_len);
+    const size_t resp_rec = resp_record_len(resp_max);
+    req_hdr_t *hdr;
+
+    future->resp = resp;
+    future->resp_max = resp_max;
+
+    if (req_rec > RTOS_RPC_ASYNC_BATCH_BYTES || resp_rec > RTOS_RPC_ASYNC_BATCH_BYTES) {
+        future_complete(future, RTOS_RPC_ASYNC_ERR_SIZE, 0);
+        return;
+    }
+
+    if (client->batch_calls == RTOS_RPC_ASYNC_BATCH_CALLS ||
+        client->batch_len + req_rec > RTOS_RPC_ASYNC_BATCH_BYTES ||
+        client->batch_resp_len + resp_rec > RTOS_RPC_ASYNC_BATCH_BYTES) {
+        client->stats.full++;
+        rtos_rpc_async_flush(client);
+    }
+
+    hdr = (req_hdr_t *) ((uint8_t *) client->batch + sizeof(batch_hdr_t) + client->batch_len);
+    hdr->fcode = fcode;
+    hdr->reserved = 0;
+    hdr->req_len = req_len;
+    hdr->resp_max = resp_max;
+    hdr->reserved2 = 0;
+    memcpy(hdr + 1, req, req_len);
+
+    client->batch_len += req_rec;
+    client->batch_resp_len += resp_rec;
+    client->batch_calls++;
+    client->stats.calls++;
+
+    future->status = 0;
+    future->resp_len = 0;
+    future->next = NULL;
+    future->state = RTOS_RPC_FUTURE_QUEUED;
+
+    if (client->tail != NULL) {
+        client->tail->next = future;
+    } else {
+        client->head = future;
+    }
+    client->tail = future;
+    if (client->first_queued == NULL) {
+        client->first_queued = future;
+    }
+}
+
+unsigned rtos_rpc_async_poll(rtos_rpc_async_client_t *client)
+{
+    unsigned completed = 0;
+    unsigned n;
+
+    while ((n = client_receive(client, 0)) > 0) {
+        completed += n;
+    }
+
+    return completed;
+}
+
+int rtos_rpc_future_wait(rtos_rpc_async_client_t *client,
+                         rtos_rpc_future_t *future,
+                         unsigned timeout)
+{
+    if (future->state == RTOS_RPC_FUTURE_QUEUED) {
+        rtos_rpc_async_flush(client);
+    }
+
+    while (future->state != RTOS_RPC_FUTURE_DONE) {
+        xassert(future->state == RTOS_RPC_FUTURE_SENT);
+        if (client_receive(client, timeout) == 0) {
+            return RTOS_RPC_ASYNC_ERR_TIMEOUT;
+        }
+    }
+
+    return future->status;
+}
+
+void rtos_rpc_async_client_stats_get(const rtos_rpc_async_client_t *client,
+                                     rtos_rpc_async_client_stats_t *stats)
+{
+    *stats = client->stats;
+}
+
+extern inline int rtos_rpc_future_done(const rtos_rpc_future_t *future);
+extern inline size_t rtos_rpc_future_resp_len(const rtos_rpc_future_t *future);
@@ -0,0 +1,147 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include "rtos_rpc_async_drivers.h"
+
+typedef struct {
+    int32_t port_id;
+    uint32_t value;
+} gpio_req_t;
+
+typedef struct {
+    uint8_t device_addr;
+    uint8_t reg_addr;
+    uint8_t data;
+} i2c_reg_req_t;
+
+/*
+ * GPIO
+ */
+
+RTOS_RPC_ASYNC_HANDLER_ATTR
+static int gpio_port_in_handler(void *arg, const void *req, size_t req_len, void *resp, size_t *resp_len)
+{
+    const gpio_req_t *r = req;
+    uint32_t value;
+
+    (void) req_len;
+
+    value = rtos_gpio_port_in(arg, r->port_id);
+    if (*resp_len >= sizeof(value)) {
+        *(uint32_t *) resp = value;
+        *resp_len = sizeof(value);
+    } else {
+        *resp_len = 0;
+    }
+
+    return 0;
+}
+
+RTOS_RPC_ASYNC_HANDLER_ATTR
+static int gpio_port_out_handler(void *arg, const void *req, size_t req_len, void *resp, size_t *resp_len)
+{
+    const gpio_req_t *r = req;
+
+    (void) req_len;
+    (void) resp;
+
+    rtos_gpio_port_out(arg, r->port_id, r->value);
+    *resp_len = 0;
+
+    return 0;
+}
+
+void rtos_rpc_async_gpio_host_register(rtos_rpc_async_host_t *host,
+                                       rtos_gpio_t *gpio_ctx)
+{
+    rtos_rpc_async_host_register(host, RTOS_RPC_ASYNC_FCODE_GPIO_PORT_IN, gpio_port_in_handler, gpio_ctx);
+    rtos_rpc_async_host_register(host, RTOS_RPC_ASYNC_FCODE_GPIO_PORT_OUT, gpio_port_out_handler, gpio_ctx);
+}
+
+void rtos_rpc_async_gpio_port_in(rtos_rpc_async_client_t *client,
+                                 rtos_rpc_future_t *future,
+                                 rtos_gpio_port_id_t port_id,
+                                 uint32_t *value)
+{
+    const gpio_req_t req = {port_id, 0};
+
+    rtos_rpc_async_call(client, future, RTOS_RPC_ASYNC_FCODE_GPIO_PORT_IN,
+                        &req, sizeof(req), value, sizeof(*value));
+}
+
+void rtos_rpc_async_gpio_port_out(rtos_rpc_async_client_t *client,
+                                  rtos_rpc_future_t *future,
+                                  rtos_gpio_port_id_t port_id,
+                                  uint32_t value)
+{
+    const gpio_req_t req = {port_id, value};
+
+    rtos_rpc_async_call(client, future, RTOS_RPC_ASYNC_FCODE_GPIO_PORT_OUT,
+                        &req, sizeof(req), NULL, 0);
+}
+
+/*
+ * I2C master
+ */
+
+RTOS_RPC_ASYNC_HANDLER_ATTR
+static int i2c_master_reg_read_handler(void *arg, const void *req, size_t req_len, void *resp, size_t *resp_len)
+{
+    const i2c_reg_req_t *r = req;
+    uint8_t data = 0;
+    i2c_regop_res_t res;
+
+    (void) req_len;
+
+    res = rtos_i2c_master_reg_read(arg, r->device_addr, r->reg_addr, &data);
+    if (*resp_len >= 1) {
+        *(uint8_t *) resp = data;
+        *resp_len = 1;
+    }
+
+    return res;
+}
+
+RTOS_RPC_ASYNC_HANDLER_ATTR
+static int i2c_master_reg_write_handler(void *arg, const void *req, size_t req_len, void *resp, size_t *resp_len)
+{
+    const i2c_reg_req_t *r = req;
+
+    (void) req_len;
+    (void) resp;
+
+    *resp_len = 0;
+
+    return rtos_i2c_master_reg_write(arg, r->device_addr, r->reg_addr, r->data);
+}
+
+void rtos_rpc_async_i2c_master_host_register(rtos_rpc_async_host_t *host,
+                                             rtos_i2c_master_t *i2c_master_ctx)
+{
+    rtos_rpc_async_host_register(host, RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_READ, i2c_master_reg_read_handler, i2c_master_ctx);
+    rtos_rpc_async_host_register(host, RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_WRITE, i2c_master_reg_write_handler, i2c_master_ctx);
+}
+
+void rtos_rpc_async_i2c_master_reg_read(rtos_rpc_async_client_t *client,
+                                        rtos_rpc_future_t *future,
+                                        uint8_t device_addr,
+                                        uint8_t reg_addr,
+                                        uint8_t *data)
+{
+    const i2c_reg_req_t req = {device_addr, reg_addr, 0};
+
+    rtos_rpc_async_call(client, future, RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_READ,
+                        &req, sizeof(req), data, 1);
+}
+
+void rtos_rpc_async_i2c_master_reg_write(rtos_rpc_async_client_t *client,
+                                         rtos_rpc_future_t *future,
+                                         uint8_t device_addr,
+                                         uint8_t reg_addr,
+                                         uint8_t data)
+{
+    const i2c_reg_req_t req = {device_addr, reg_addr, data};
+
+    rtos_rpc_async_call(client, future, RTOS_RPC_ASYNC_FCODE_I2C_MASTER_REG_WRITE,
+                        &req, sizeof(req), NULL, 0);
+}
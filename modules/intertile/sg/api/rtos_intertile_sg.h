@@ -0,0 +1,180 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_INTERTILE_SG_H_
+#define RTOS_INTERTILE_SG_H_
+
+/**
+ * \addtogroup rtos_intertile_sg rtos_intertile_sg
+ *
+ * Scatter-gather and zero-copy transfers over an intertile instance.
+ *
+ * rtos_intertile_tx() sends one contiguous buffer, so a header and a
+ * payload held separately must first be copied together, and the receiver
+ * learns the length from rtos_intertile_rx_len() before it can allocate a
+ * buffer and copy the message out of it. With this API the sender passes a
+ * list of segments to rtos_intertile_sg_tx(), and the receiver either gives
+ * the destination buffer up front with rtos_intertile_sg_rx(), or borrows a
+ * buffer from a pool with rtos_intertile_sg_rx_loan() and returns it once
+ * the message has been consumed.
+ *
+ * A message is carried as one or more intertile messages. Segments longer
+ * than RTOS_INTERTILE_SG_COPYBREAK bytes are sent straight from the
+ * sender's memory into the receiver's buffer, in intertile messages of up
+ * to RTOS_INTERTILE_SG_SEG_BYTES. Runs of shorter segments are
+ * gathered into a small staging buffer on the stack and sent together,
+ * since a copy of a few bytes costs less than an extra intertile message.
+ * The first intertile message always carries a short header describing the
+ * whole message.
+ *
+ * A port used with this API must only be used with this API. The
+ * intertile messages that make up one message are not sent under a single
+ * lock, so each port must have one sending task and one receiving task.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+
+/**
+ * Segments up to this many bytes are copied into the staging buffer rather
+ * than sent as their own intertile message.
+ */
+#ifndef RTOS_INTERTILE_SG_COPYBREAK
+#define RTOS_INTERTILE_SG_COPYBREAK 64
+#endif
+
+/**
+ * The size of the staging buffer, including the message header. Placed on
+ * the stack of the sending and receiving tasks.
+ */
+#ifndef RTOS_INTERTILE_SG_STAGE_BYTES
+#define RTOS_INTERTILE_SG_STAGE_BYTES 136
+#endif
+
+#if RTOS_INTERTILE_SG_STAGE_BYTES < RTOS_INTERTILE_SG_COPYBREAK + 8
+#error RTOS_INTERTILE_SG_STAGE_BYTES must hold the header and one short segment
+#endif
+
+/**
+ * Longer segments are sent as several intertile messages of at most this
+ * many bytes. The receiver discards the part of a message that does not
+ * fit in its buffer through its staging buffer, which is made at least
+ * this large.
+ */
+#ifndef RTOS_INTERTILE_SG_SEG_BYTES
+#define RTOS_INTERTILE_SG_SEG_BYTES 1024
+#endif
+
+#if RTOS_INTERTILE_SG_SEG_BYTES <= RTOS_INTERTILE_SG_COPYBREAK || (RTOS_INTERTILE_SG_SEG_BYTES % 4) != 0
+#error RTOS_INTERTILE_SG_SEG_BYTES must be a multiple of 4 greater than RTOS_INTERTILE_SG_COPYBREAK
+#endif
+
+/** A segment of a message to send. */
+typedef struct {
+    const void *base;   /**< The start of the segment. */
+    size_t len;         /**< The length of the segment in bytes. */
+} rtos_intertile_iov_t;
+
+/**
+ * Typedef to the buffer pool struct.
+ */
+typedef struct rtos_intertile_sg_pool_struct rtos_intertile_sg_pool_t;
+
+/**
+ * Struct representing a pool of receive buffers to loan out.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_intertile_sg_pool_struct {
+    size_t buf_size;
+    rtos_osal_queue_t free;
+};
+
+/**
+ * Sends a message gathered from a list of segments.
+ *
+ * \param ctx     A pointer to the intertile instance
+ * \param port    The port to send on
+ * \param iov     The segments, sent in order
+ * \param iovcnt  The number of segments
+ *
+ * \return the number of bytes sent
+ */
+size_t rtos_intertile_sg_tx(rtos_intertile_t *ctx,
+                            uint8_t port,
+                            const rtos_intertile_iov_t *iov,
+                            size_t iovcnt);
+
+/**
+ * Receives a message into a buffer provided by the caller. If the message
+ * is longer than the buffer, the part that fits is kept and the rest is
+ * discarded.
+ *
+ * \param ctx      A pointer to the intertile instance
+ * \param port     The port to receive on
+ * \param buf      The buffer to receive into
+ * \param size     The size of \p buf in bytes
+ * \param timeout  The maximum time to wait for the message to start
+ *
+ * \return the length of the message, which is greater than \p size if it
+ *         was truncated, or 0 on timeout or for an empty message
+ */
+size_t rtos_intertile_sg_rx(rtos_intertile_t *ctx,
+                            uint8_t port,
+                            void *buf,
+                            size_t size,
+                            unsigned timeout);
+
+/**
+ * Initializes a pool of receive buffers.
+ *
+ * \param pool      A pointer to the pool
+ * \param storage   Storage for \p count buffers of \p buf_size bytes each,
+ *                  word aligned
+ * \param buf_size  The size of each buffer in bytes. A multiple of 4.
+ * \param count     The number of buffers
+ */
+void rtos_intertile_sg_pool_init(rtos_intertile_sg_pool_t *pool,
+                                 void *storage,
+                                 size_t buf_size,
+                                 size_t count);
+
+/**
+ * Receives a message into a buffer borrowed from a pool. The buffer must be
+ * returned with rtos_intertile_sg_pool_release() once the message has been
+ * consumed, and may be returned by any task.
+ *
+ * \param ctx      A pointer to the intertile instance
+ * \param port     The port to receive on
+ * \param pool     The pool to borrow from
+ * \param len      Receives the length of the message, which is greater
+ *                 than the buffer size if it was truncated
+ * \param timeout  The maximum time to wait for a free buffer and then for
+ *                 the message to start
+ *
+ * \return the buffer holding the message, or NULL on timeout or for an
+ *         empty message
+ */
+void *rtos_intertile_sg_rx_loan(rtos_intertile_t *ctx,
+                                uint8_t port,
+                                rtos_intertile_sg_pool_t *pool,
+                                size_t *len,
+                                unsigned timeout);
+
+/**
+ * Returns a loaned buffer to its pool.
+ *
+ * \param pool  The pool the buffer was borrowed from
+ * \param buf   The buffer returned by rtos_intertile_sg_rx_loan()
+ */
+void rtos_intertile_sg_pool_release(rtos_intertile_sg_pool_t *pool,
+                                    void *buf);
+
+/**@}*/
+
+#endif /* RTOS_INTERTILE_SG_H_ */
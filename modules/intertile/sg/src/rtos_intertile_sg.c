@@ -0,0 +1,213 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#define DEBUG_UNIT RTOS_INTERTILE_SG
+
+#include <string.h>
+
+#include <xcore/assert.h>
+
+#include "rtos_intertile_sg.h"
+
+/*
+ * Starts the first intertile message of every message. Gives the number of
+ * intertile messages, including this one, and the total length of the data
+ * they carry. The rest of the first intertile message is data.
+ */
+typedef struct {
+    uint32_t len;
+    uint32_t count;
+} sg_hdr_t;
+
+/* The receive stage also drains the segment messages that do not fit */
+#if RTOS_INTERTILE_SG_SEG_BYTES > RTOS_INTERTILE_SG_STAGE_BYTES
+#define SG_RX_STAGE_BYTES RTOS_INTERTILE_SG_SEG_BYTES
+#else
+#define SG_RX_STAGE_BYTES RTOS_INTERTILE_SG_STAGE_BYTES
+#endif
+
+typedef struct {
+    rtos_intertile_t *ctx;
+    uint8_t port;
+    size_t count;
+    uint32_t stage[RTOS_INTERTILE_SG_STAGE_BYTES / sizeof(uint32_t)];
+    size_t stage_len;
+} sg_tx_t;
+
+static void stage_flush(sg_tx_t *tx)
+{
+    if (tx->stage_len > 0) {
+        if (tx->ctx != NULL) {
+            rtos_intertile_tx(tx->ctx, tx->port, tx->stage, tx->stage_len);
+        }
+        tx->count++;
+        tx->stage_len = 0;
+    }
+}
+
+/*
+ * Walks the segments and sends them, or when tx->ctx is NULL only counts
+ * the intertile messages that would be sent.
+ */
+static size_t sg_walk(sg_tx_t *tx, const rtos_intertile_iov_t *iov, size_t iovcnt)
+{
+    size_t len = 0;
+
+    tx->count = 0;
+    tx->stage_len = sizeof(sg_hdr_t);
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        const size_t seg_len = iov[i].len;
+
+        if (seg_len == 0) {
+            continue;
+        }
+        len += seg_len;
+
+        if (seg_len <= RTOS_INTERTILE_SG_COPYBREAK) {
+            if (tx->stage_len + seg_len > sizeof(tx->stage)) {
+                stage_flush(tx);
+            }
+            if (tx->ctx != NULL) {
+                memcpy((uint8_t *) tx->stage + tx->stage_len, iov[i].base, seg_len);
+            }
+            tx->stage_len += seg_len;
+        } else {
+            stage_flush(tx);
+            for (size_t sent = 0; sent < seg_len; sent += RTOS_INTERTILE_SG_SEG_BYTES) {
+                const size_t n = seg_len - sent < RTOS_INTERTILE_SG_SEG_BYTES ? seg_len - sent : RTOS_INTERTILE_SG_SEG_BYTES;
+                if (tx->ctx != NULL) {
+                    rtos_intertile_tx(tx->ctx, tx->port, (uint8_t *) iov[i].base + sent, n);
+                }
+                tx->count++;
+            }
+        }
+    }
+
+    stage_flush(tx);
+
+    return len;
+}
+
+size_t rtos_intertile_sg_tx(rtos_intertile_t *ctx,
+                            uint8_t port,
+                            const rtos_intertile_iov_t *iov,
+                            size_t iovcnt)
+{
+    sg_tx_t tx;
+    sg_hdr_t *hdr = (sg_hdr_t *) tx.stage;
+
+    /* The header needs the message count before anything is sent */
+    tx.ctx = NULL;
+    hdr->len = sg_walk(&tx, iov, iovcnt);
+    hdr->count = tx.count;
+
+    tx.ctx = ctx;
+    tx.port = port;
+    return sg_walk(&tx, iov, iovcnt);
+}
+
+/*
+ * Receives the rest of a message once its header has arrived. The header
+ * must be copied out of the stage first, as it is reused to drain
+ * intertile messages that do not fit in the buffer.
+ */
+static void sg_rx_data(rtos_intertile_t *ctx,
+                       uint8_t port,
+                       const sg_hdr_t *hdr,
+                       uint8_t *buf,
+                       size_t size,
+                       size_t offset,
+                       uint32_t *stage,
+                       size_t stage_size)
+{
+    for (uint32_t i = 1; i < hdr->count; i++) {
+        const size_t len = rtos_intertile_rx_len(ctx, port, RTOS_OSAL_WAIT_FOREVER);
+
+        if (offset + len <= size) {
+            rtos_intertile_rx_data(ctx, buf + offset, len);
+        } else {
+            /* Truncated. Keep what fits and drop the rest. */
+            xassert(len <= stage_size);
+            rtos_intertile_rx_data(ctx, stage, len);
+            if (offset < size) {
+                memcpy(buf + offset, stage, size - offset);
+            }
+        }
+        offset += len;
+    }
+
+    xassert(offset == hdr->len);
+}
+
+size_t rtos_intertile_sg_rx(rtos_intertile_t *ctx,
+                            uint8_t port,
+                            void *buf,
+                            size_t size,
+                            unsigned timeout)
+{
+    uint32_t stage[SG_RX_STAGE_BYTES / sizeof(uint32_t)];
+    sg_hdr_t hdr;
+    size_t len;
+    size_t inline_len;
+
+    len = rtos_intertile_rx_len(ctx, port, timeout);
+    if (len == 0) {
+        return 0;
+    }
+
+    xassert(len >= sizeof(sg_hdr_t) && len <= RTOS_INTERTILE_SG_STAGE_BYTES);
+    rtos_intertile_rx_data(ctx, stage, len);
+    memcpy(&hdr, stage, sizeof(hdr));
+
+    /* Data gathered into the first message is short, so is copied out */
+    inline_len = len - sizeof(sg_hdr_t);
+    memcpy(buf, (uint8_t *) stage + sizeof(sg_hdr_t), inline_len < size ? inline_len : size);
+
+    sg_rx_data(ctx, port, &hdr, buf, size, inline_len, stage, sizeof(stage));
+
+    return hdr.len;
+}
+
+void rtos_intertile_sg_pool_init(rtos_intertile_sg_pool_t *pool,
+                                 void *storage,
+                                 size_t buf_size,
+                                 size_t count)
+{
+    xassert((buf_size & 3) == 0);
+
+    pool->buf_size = buf_size;
+    rtos_osal_queue_create(&pool->free, "intertile_sg_pool", count, sizeof(void *));
+
+    for (size_t i = 0; i < count; i++) {
+        void *buf = (uint8_t *) storage + i * buf_size;
+        rtos_osal_queue_send(&pool->free, &buf, RTOS_OSAL_NO_WAIT);
+    }
+}
+
+void *rtos_intertile_sg_rx_loan(rtos_intertile_t *ctx,
+                                uint8_t port,
+                                rtos_intertile_sg_pool_t *pool,
+                                size_t *len,
+                                unsigned timeout)
+{
+    void *buf;
+
+    if (rtos_osal_queue_receive(&pool->free, &buf, timeout) != RTOS_OSAL_SUCCESS) {
+        return NULL;
+    }
+
+    *len = rtos_intertile_sg_rx(ctx, port, buf, pool->buf_size, timeout);
+    if (*len == 0) {
+        rtos_intertile_sg_pool_release(pool, buf);
+        return NULL;
+    }
+
+    return buf;
+}
+
+void rtos_intertile_sg_pool_release(rtos_intertile_sg_pool_t *pool,
+                                    void *buf)
+{
+    rtos_osal_queue_send(&pool->free, &buf, RTOS_OSAL_NO_WAIT);
+}
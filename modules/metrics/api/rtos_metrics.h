@@ -0,0 +1,173 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_METRICS_H_
+#define RTOS_METRICS_H_
+
+/**
+ * \addtogroup rtos_metrics rtos_metrics
+ *
+ * A low overhead system metrics service for FreeRTOS applications.
+ *
+ * A single task wakes periodically and takes a snapshot of the tile: the CPU
+ * load of each core and of each task over the last period, the stack high
+ * water mark of every task, the free, minimum ever free and largest free
+ * block of the heap, and the depth of any queues registered with
+ * rtos_metrics_queue_add(). The snapshot is packed into the compact binary
+ * format described in rtos_metrics_format.h.
+ *
+ * Each snapshot may be sent over an xscope probe, to be decoded on the host
+ * by xscope2metrics, and the latest one is always available from
+ * rtos_metrics_snapshot_get(), for example to return from a device control
+ * read command. Nothing is printed on the device.
+ *
+ * Task loads come from the FreeRTOS run time counters, so
+ * configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY must be
+ * enabled. Core loads additionally require rtos_metrics_trace.h to be
+ * included at the end of FreeRTOSConfig.h.
+ *
+ * Only one instance may be started on each tile.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "rtos_osal.h"
+#include "rtos_metrics_format.h"
+
+/**
+ * The most tasks included in a snapshot.
+ */
+#ifndef RTOS_METRICS_MAX_TASKS
+#define RTOS_METRICS_MAX_TASKS 32
+#endif
+
+/**
+ * The most queues that may be registered with rtos_metrics_queue_add().
+ */
+#ifndef RTOS_METRICS_MAX_QUEUES
+#define RTOS_METRICS_MAX_QUEUES 8
+#endif
+
+/**
+ * The largest number of snapshot bytes sent in one xscope record.
+ */
+#ifndef RTOS_METRICS_XSCOPE_RECORD_BYTES
+#define RTOS_METRICS_XSCOPE_RECORD_BYTES 240
+#endif
+
+/**
+ * Pass as the xscope probe to rtos_metrics_init() to not send snapshots
+ * over xscope.
+ */
+#define RTOS_METRICS_NO_XSCOPE -1
+
+/**
+ * The largest possible snapshot size in bytes.
+ */
+#define RTOS_METRICS_SNAPSHOT_MAX_BYTES (sizeof(rtos_metrics_snapshot_hdr_t) + \
+                                         configNUM_CORES * sizeof(uint16_t) + \
+                                         RTOS_METRICS_MAX_TASKS * sizeof(rtos_metrics_task_t) + \
+                                         RTOS_METRICS_MAX_QUEUES * sizeof(rtos_metrics_queue_t))
+
+/**
+ * Typedef to the metrics service instance struct.
+ */
+typedef struct rtos_metrics_struct rtos_metrics_t;
+
+/**
+ * Struct representing a metrics service instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_metrics_struct {
+    int xscope_probe;
+    TickType_t period;
+    rtos_osal_mutex_t lock;
+    rtos_osal_thread_t thread;
+
+    QueueHandle_t queue[RTOS_METRICS_MAX_QUEUES];
+    char queue_name[RTOS_METRICS_MAX_QUEUES][RTOS_METRICS_NAME_LEN];
+    unsigned num_queues;
+
+    /* The state at the previous sample, to turn the counters into loads */
+    uint32_t last_time;
+    uint32_t last_run_time_total;
+    uint32_t last_core_busy[configNUM_CORES];
+    UBaseType_t last_task_number[RTOS_METRICS_MAX_TASKS];
+    uint32_t last_task_run_time[RTOS_METRICS_MAX_TASKS];
+    unsigned last_num_tasks;
+    uint16_t seq;
+
+    TaskStatus_t status[RTOS_METRICS_MAX_TASKS];
+
+    /* The latest snapshot, and the one being built */
+    size_t snapshot_len;
+    uint32_t snapshot[RTOS_METRICS_SNAPSHOT_MAX_BYTES / sizeof(uint32_t) + 1];
+    uint32_t work[RTOS_METRICS_SNAPSHOT_MAX_BYTES / sizeof(uint32_t) + 1];
+};
+
+/**
+ * Initializes a metrics service instance.
+ *
+ * \param metrics       A pointer to the metrics service instance
+ * \param xscope_probe  The xscope probe to send snapshots on, or
+ *                      RTOS_METRICS_NO_XSCOPE. The probe's data type
+ *                      should be NONE.
+ * \param period_ms     The time between snapshots in milliseconds
+ */
+void rtos_metrics_init(rtos_metrics_t *metrics,
+                       int xscope_probe,
+                       unsigned period_ms);
+
+/**
+ * Registers a queue so that its depth is included in the snapshots. May be
+ * called before or after rtos_metrics_start().
+ *
+ * \param metrics  A pointer to the metrics service instance
+ * \param queue    The queue. This may also be a semaphore or mutex.
+ * \param name     A name for the queue. Only the first
+ *                 RTOS_METRICS_NAME_LEN characters are kept.
+ *
+ * \retval 0   on success
+ * \retval -1  if RTOS_METRICS_MAX_QUEUES queues are already registered
+ */
+int rtos_metrics_queue_add(rtos_metrics_t *metrics,
+                           QueueHandle_t queue,
+                           const char *name);
+
+/**
+ * Starts the task that takes the snapshots. Must be called after the
+ * scheduler has started and the idle tasks exist.
+ *
+ * \param metrics   A pointer to the metrics service instance
+ * \param priority  The priority of the task. A low priority keeps the
+ *                  service out of the way of the tasks it measures.
+ */
+void rtos_metrics_start(rtos_metrics_t *metrics,
+                        unsigned priority);
+
+/**
+ * Copies the latest snapshot.
+ *
+ * \param metrics  A pointer to the metrics service instance
+ * \param buf      Receives the snapshot
+ * \param size     The size of \p buf. RTOS_METRICS_SNAPSHOT_MAX_BYTES is
+ *                 always enough.
+ *
+ * \return the length of the snapshot, or 0 if there is none yet or it does
+ *         not fit in \p buf
+ */
+size_t rtos_metrics_snapshot_get(rtos_metrics_t *metrics,
+                                 void *buf,
+                                 size_t size);
+
+/**@}*/
+
+#endif /* RTOS_METRICS_H_ */
@@ -0,0 +1,98 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_METRICS_FORMAT_H_
+#define RTOS_METRICS_FORMAT_H_
+
+/**
+ * \addtogroup rtos_metrics_format rtos_metrics_format
+ *
+ * The binary snapshot format produced by the metrics service. This header
+ * only depends on <stdint.h> so that host tools may include it to decode
+ * snapshots.
+ *
+ * A snapshot is an rtos_metrics_snapshot_hdr_t followed by num_cores
+ * uint16_t core loads, num_tasks rtos_metrics_task_t records and num_queues
+ * rtos_metrics_queue_t records, with no padding in between. All fields are
+ * little endian. Loads are in tenths of a percent of one core, so a task that
+ * ran for the whole interval has a load of 1000.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+#define RTOS_METRICS_SNAPSHOT_ID        0x4D
+#define RTOS_METRICS_SNAPSHOT_VERSION   1
+
+/**
+ * The length of the task and queue names in a snapshot. Longer names are
+ * truncated, and shorter ones are padded with zeros.
+ */
+#define RTOS_METRICS_NAME_LEN           8
+
+/**
+ * Set in rtos_metrics_snapshot_hdr_t::flags when the core loads are valid.
+ * They are only measured when the hooks in rtos_metrics_trace.h are
+ * installed.
+ */
+#define RTOS_METRICS_FLAG_CORE_LOAD     0x01
+
+/**
+ * Set in rtos_metrics_snapshot_hdr_t::flags when there were more tasks or
+ * queues than the snapshot has room for.
+ */
+#define RTOS_METRICS_FLAG_TRUNCATED     0x02
+
+#pragma pack(push, 1)
+
+typedef struct {
+    uint8_t id;                      /**< RTOS_METRICS_SNAPSHOT_ID */
+    uint8_t version;                 /**< RTOS_METRICS_SNAPSHOT_VERSION */
+    uint8_t tile;                    /**< The tile that took the snapshot */
+    uint8_t flags;                   /**< RTOS_METRICS_FLAG_* */
+    uint8_t num_cores;               /**< The number of core loads that follow */
+    uint8_t num_tasks;               /**< The number of task records that follow */
+    uint8_t num_queues;              /**< The number of queue records that follow */
+    uint8_t reserved;
+    uint16_t length;                 /**< The length of the whole snapshot in bytes */
+    uint16_t seq;                    /**< Incremented for each snapshot */
+    uint32_t timestamp;              /**< Reference clock time of the snapshot */
+    uint32_t interval;               /**< Reference clock ticks since the previous snapshot */
+    uint32_t heap_free;              /**< Free heap bytes */
+    uint32_t heap_min_ever_free;     /**< The lowest value of heap_free since startup */
+    uint32_t heap_largest_free_block;/**< The largest allocation that can currently succeed */
+    uint32_t heap_free_blocks;       /**< The number of free blocks heap_free is split over */
+} rtos_metrics_snapshot_hdr_t;
+
+typedef struct {
+    char name[RTOS_METRICS_NAME_LEN];
+    uint16_t number;                 /**< The low 16 bits of the FreeRTOS task number */
+    uint16_t load;                   /**< CPU time used during the interval */
+    uint16_t stack_free;             /**< Stack high water mark in words, saturated at 0xFFFF */
+    uint8_t state;                   /**< The eTaskState of the task */
+    uint8_t priority;                /**< The current priority of the task */
+} rtos_metrics_task_t;
+
+typedef struct {
+    char name[RTOS_METRICS_NAME_LEN];
+    uint16_t waiting;                /**< Items in the queue */
+    uint16_t length;                 /**< Items the queue can hold */
+} rtos_metrics_queue_t;
+
+/**
+ * Snapshots sent over xscope are split into records that each start with
+ * this header. Records for one snapshot are sent in order, and offset is the
+ * position of the record's data in the snapshot.
+ */
+typedef struct {
+    uint8_t tile;
+    uint8_t seq;                     /**< The low 8 bits of the snapshot's seq */
+    uint16_t offset;
+} rtos_metrics_xscope_hdr_t;
+
+#pragma pack(pop)
+
+/**@}*/
+
+#endif /* RTOS_METRICS_FORMAT_H_ */
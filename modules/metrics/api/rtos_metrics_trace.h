@@ -0,0 +1,32 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_METRICS_TRACE_H_
+#define RTOS_METRICS_TRACE_H_
+
+/*
+ * Kernel hooks used by the metrics service to measure how busy each core
+ * is. Include this at the end of FreeRTOSConfig.h. Each context switch
+ * then adds the time the core spent running a task other than an idle task
+ * to a per core counter.
+ *
+ * Hooks already defined, for example by a trace recorder, are left alone,
+ * and core loads are then reported as unavailable.
+ */
+
+#if !defined(__ASSEMBLER__)
+
+void rtos_metrics_task_switched_in(void);
+void rtos_metrics_task_switched_out(void);
+
+#ifndef traceTASK_SWITCHED_IN
+#define traceTASK_SWITCHED_IN()     rtos_metrics_task_switched_in()
+#endif
+
+#ifndef traceTASK_SWITCHED_OUT
+#define traceTASK_SWITCHED_OUT()    rtos_metrics_task_switched_out()
+#endif
+
+#endif /* !defined(__ASSEMBLER__) */
+
+#endif /* RTOS_METRICS_TRACE_H_ */
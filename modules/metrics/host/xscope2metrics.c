@@ -0,0 +1,447 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "xscope_endpoint.h"
+#include "rtos_metrics_format.h"
+
+#define VERSION "1.0.0"
+
+// Abstraction for sleep portability
+#if defined(__GNUC__) || defined(__MINGW32__)
+#include <unistd.h>
+#define SLEEP_MS(x)             usleep((x) * 1000)
+#else
+#include <windows.h>
+#define SLEEP_MS(x)             Sleep(x)
+#endif
+
+#define NUM_ELEMS(x)            (sizeof(x) / sizeof(x[0]))
+
+/*
+ * The name of the xscope probe the metrics service sends snapshots on.
+ */
+#define XSCOPE_PROBE_NAME       "metrics"
+
+#define MAX_TILES               4
+#define MAX_SNAPSHOT_BYTES      0xFFFF
+
+/* The reference clock of the device */
+#define REFERENCE_HZ            100000000
+
+typedef enum error_code {
+    ERROR_NONE,
+    ERROR_MISSING_ARG,
+    ERROR_UNKOWN_ARG,
+    ERROR_ARG_VALUE_MISSING,
+    ERROR_BAD_SNAPSHOT,
+    ERROR_FILE_SYSTEM,
+    ERROR_CONNECT
+} error_code_t;
+
+/* A snapshot being reassembled from xscope records */
+typedef struct {
+    bool active;
+    uint8_t seq;
+    size_t len;
+    uint8_t buf[MAX_SNAPSHOT_BYTES];
+} reassembly_t;
+
+static const char *task_state_name[] = {"run", "ready", "block", "susp", "del"};
+
+/*
+ * The available command line argument flags/options.
+ */
+static const char *help_arg[] = {"-h", "--help"};
+static const char *version_arg[] = {"--version"};
+static const char *print_endpoint_arg[] = {"-p", "--print-endpoint"};
+static const char *input_file_arg[] = {"-i", "--in-file"};
+static const char *input_port_arg[] = {"-I", "--in-port"};
+static const char *csv_file_arg[] = {"-c", "--csv"};
+
+static bool running = true;
+static int probe_id = -1;
+static unsigned snapshot_count = 0;
+static unsigned dropped_count = 0;
+static reassembly_t tile_snapshot[MAX_TILES];
+
+/*
+ * Variables set by command line arguments.
+ */
+static bool show_help = false;
+static bool show_version = false;
+static bool print_endpoint = false;
+static char *input_host = NULL;
+static char *input_port = NULL;
+static char *input_filename = NULL;
+static char *csv_filename = NULL;
+static FILE *csv_file = NULL;
+
+static void print_help(char *arg0)
+{
+    printf("Usage:\n");
+    printf("    %s [-h] [--version]\n\n", arg0);
+    printf("    %s [-p] [-c <CSV_FILE>] -I <HOST>:<PORT>\n\n", arg0);
+    printf("    %s [-c <CSV_FILE>] -i <IN_FILE>\n\n", arg0);
+    printf("Decode the system metrics snapshots sent by the rtos_metrics service, either\n"
+           "live from an xscope endpoint socket connection or from a file of snapshots\n"
+           "read back, for example, over device control.\n\n");
+    printf("Options:\n");
+    printf("    -h, --help                  This help menu.\n");
+    printf("        --version               Print the version of this tool.\n");
+    printf("    -p, --print-endpoint        When using --in-port, this option will enable\n"
+           "                                reception of printf data on this xscope endpoint.\n");
+    printf("    -i, --in-file <IN_FILE>     A binary file of back to back snapshots to decode.\n");
+    printf("    -I, --in-port <HOST>:<PORT> The host and port (separated by ':') on which\n"
+           "                                xrun's or xgdb's --xscope-port is serving.\n");
+    printf("    -c, --csv <CSV_FILE>        Also write one line per task and snapshot to a CSV file.\n");
+}
+
+/*
+ * Checks that a snapshot is complete and consistent before it is decoded.
+ */
+static error_code_t check_snapshot(const uint8_t *buf, size_t len)
+{
+    rtos_metrics_snapshot_hdr_t hdr;
+    size_t expected;
+
+    if (len < sizeof(hdr))
+        return ERROR_BAD_SNAPSHOT;
+
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.id != RTOS_METRICS_SNAPSHOT_ID ||
+        hdr.version != RTOS_METRICS_SNAPSHOT_VERSION)
+        return ERROR_BAD_SNAPSHOT;
+
+    expected = sizeof(hdr) +
+               hdr.num_cores * sizeof(uint16_t) +
+               hdr.num_tasks * sizeof(rtos_metrics_task_t) +
+               hdr.num_queues * sizeof(rtos_metrics_queue_t);
+
+    return (hdr.length == expected && len >= expected) ? ERROR_NONE :
+                                                         ERROR_BAD_SNAPSHOT;
+}
+
+static void print_snapshot(const uint8_t *buf)
+{
+    rtos_metrics_snapshot_hdr_t hdr;
+    size_t offset = sizeof(hdr);
+    char name[RTOS_METRICS_NAME_LEN + 1];
+
+    memcpy(&hdr, buf, sizeof(hdr));
+    name[RTOS_METRICS_NAME_LEN] = '\0';
+
+    printf("Tile %u snapshot %u, interval %.1f ms%s\n", hdr.tile, hdr.seq,
+           hdr.interval * 1000.0 / REFERENCE_HZ,
+           (hdr.flags & RTOS_METRICS_FLAG_TRUNCATED) ? " (truncated)" : "");
+
+    printf("  Heap: free %u, min ever free %u, largest free block %u in %u blocks, fragmentation %.1f%%\n",
+           hdr.heap_free, hdr.heap_min_ever_free, hdr.heap_largest_free_block,
+           hdr.heap_free_blocks,
+           hdr.heap_free ? 100.0 - (100.0 * hdr.heap_largest_free_block) / hdr.heap_free : 0.0);
+
+    printf("  Core load:");
+    for (unsigned i = 0; i < hdr.num_cores; i++) {
+        uint16_t load;
+
+        memcpy(&load, &buf[offset], sizeof(load));
+        offset += sizeof(load);
+
+        if (hdr.flags & RTOS_METRICS_FLAG_CORE_LOAD)
+            printf(" %u:%5.1f%%", i, load / 10.0);
+    }
+    if (!(hdr.flags & RTOS_METRICS_FLAG_CORE_LOAD))
+        printf(" not measured");
+    printf("\n");
+
+    printf("  %-8s %5s %5s %4s %7s %10s\n", "Task", "Num", "State", "Prio",
+           "Load", "Stack free");
+    for (unsigned i = 0; i < hdr.num_tasks; i++) {
+        rtos_metrics_task_t task;
+
+        memcpy(&task, &buf[offset], sizeof(task));
+        offset += sizeof(task);
+        memcpy(name, task.name, RTOS_METRICS_NAME_LEN);
+
+        printf("  %-8s %5u %5s %4u %6.1f%% %10u\n", name, task.number,
+               task.state < NUM_ELEMS(task_state_name) ?
+                       task_state_name[task.state] : "?",
+               task.priority, task.load / 10.0, task.stack_free);
+
+        if (csv_file != NULL) {
+            fprintf(csv_file, "%u,%u,%u,%s,%u,%u,%u,%u,%u,%u,%u\n", hdr.tile,
+                    hdr.seq, hdr.timestamp, name, task.number, task.state,
+                    task.priority, task.load, task.stack_free, hdr.heap_free,
+                    hdr.heap_largest_free_block);
+        }
+    }
+
+    if (hdr.num_queues > 0)
+        printf("  %-8s %7s %6s\n", "Queue", "Waiting", "Length");
+    for (unsigned i = 0; i < hdr.num_queues; i++) {
+        rtos_metrics_queue_t queue;
+
+        memcpy(&queue, &buf[offset], sizeof(queue));
+        offset += sizeof(queue);
+        memcpy(name, queue.name, RTOS_METRICS_NAME_LEN);
+
+        printf("  %-8s %7u %6u\n", name, queue.waiting, queue.length);
+    }
+    printf("\n");
+
+    if (csv_file != NULL)
+        fflush(csv_file);
+    fflush(stdout);
+    snapshot_count++;
+}
+
+/*
+ * Adds one xscope record to the snapshot being reassembled for its tile,
+ * and decodes the snapshot once it is complete.
+ */
+static void process_record(const uint8_t *data, size_t len)
+{
+    rtos_metrics_xscope_hdr_t hdr;
+    reassembly_t *r;
+
+    if (len < sizeof(hdr))
+        return;
+
+    memcpy(&hdr, data, sizeof(hdr));
+    data += sizeof(hdr);
+    len -= sizeof(hdr);
+
+    if (hdr.tile >= MAX_TILES)
+        return;
+    r = &tile_snapshot[hdr.tile];
+
+    if (hdr.offset == 0) {
+        if (r->active)
+            dropped_count++;
+        r->active = true;
+        r->seq = hdr.seq;
+        r->len = 0;
+    } else if (!r->active || hdr.seq != r->seq || hdr.offset != r->len) {
+        // A record was lost. Wait for the start of the next snapshot.
+        if (r->active)
+            dropped_count++;
+        r->active = false;
+        return;
+    }
+
+    if (r->len + len > sizeof(r->buf)) {
+        r->active = false;
+        dropped_count++;
+        return;
+    }
+    memcpy(&r->buf[r->len], data, len);
+    r->len += len;
+
+    if (r->len >= sizeof(rtos_metrics_snapshot_hdr_t)) {
+        rtos_metrics_snapshot_hdr_t snapshot_hdr;
+
+        memcpy(&snapshot_hdr, r->buf, sizeof(snapshot_hdr));
+        if (r->len >= snapshot_hdr.length) {
+            r->active = false;
+            if (check_snapshot(r->buf, r->len) == ERROR_NONE)
+                print_snapshot(r->buf);
+            else
+                dropped_count++;
+        }
+    }
+}
+
+static error_code_t process_file(FILE *in_file)
+{
+    static uint8_t buf[MAX_SNAPSHOT_BYTES];
+    rtos_metrics_snapshot_hdr_t hdr;
+
+    while (fread(&hdr, sizeof(hdr), 1, in_file) == 1) {
+        size_t rest;
+
+        if (hdr.id != RTOS_METRICS_SNAPSHOT_ID || hdr.length < sizeof(hdr)) {
+            printf("ERROR: Not a metrics snapshot.\n");
+            return ERROR_BAD_SNAPSHOT;
+        }
+
+        rest = hdr.length - sizeof(hdr);
+        memcpy(buf, &hdr, sizeof(hdr));
+        if (fread(&buf[sizeof(hdr)], 1, rest, in_file) != rest ||
+            check_snapshot(buf, hdr.length) != ERROR_NONE) {
+            printf("ERROR: Truncated or corrupt snapshot.\n");
+            return ERROR_BAD_SNAPSHOT;
+        }
+
+        print_snapshot(buf);
+    }
+
+    return ERROR_NONE;
+}
+
+static void xscope_exit_cb(void)
+{
+    running = false;
+}
+
+static void xscope_register_cb(unsigned int id, unsigned int type,
+                               unsigned int r, unsigned int g, unsigned int b,
+                               unsigned char *name, unsigned char *unit,
+                               unsigned int data_type, unsigned char *data_name)
+{
+    if (strcmp((char *)name, XSCOPE_PROBE_NAME) == 0)
+        probe_id = id;
+}
+
+static void xscope_print_cb(unsigned long long timestamp, unsigned int length,
+                            unsigned char *data)
+{
+    if (!running || (length == 0))
+        return;
+
+    printf("[PRINT] ");
+
+    for (unsigned i = 0; i < length; i++)
+        printf("%c", data[i]);
+}
+
+static void xscope_record_cb(unsigned int id, unsigned long long timestamp,
+                             unsigned int length, unsigned long long data_val,
+                             unsigned char *data_bytes)
+{
+    if (!running || (int)id != probe_id)
+        return;
+
+    process_record(data_bytes, length);
+}
+
+static bool is_matching_arg(char *arg, const char *arg_options[],
+                            int num_options)
+{
+    for(int i = 0; i < num_options; i++)
+    {
+        if (0 == strcmp(arg, arg_options[i]))
+            return true;
+    }
+
+    return false;
+}
+
+static error_code_t next_arg_value(int argc, char *argv[], int *argi)
+{
+    if ((++(*argi) >= argc) || argv[*argi][0] == '-') {
+        printf("ERROR: Missing argument value (%s).\n", argv[*argi - 1]);
+        return ERROR_ARG_VALUE_MISSING;
+    }
+
+    return ERROR_NONE;
+}
+
+static error_code_t process_args(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (is_matching_arg(argv[i], help_arg, NUM_ELEMS(help_arg))) {
+            show_help = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], version_arg,
+                                   NUM_ELEMS(version_arg))) {
+            show_version = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], input_file_arg,
+                                   NUM_ELEMS(input_file_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            input_filename = argv[i];
+        } else if (is_matching_arg(argv[i], input_port_arg,
+                                   NUM_ELEMS(input_port_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            const char delims[] = ":";
+            input_host = strtok(argv[i], delims);
+            input_port = strtok(NULL, delims);
+        } else if (is_matching_arg(argv[i], csv_file_arg,
+                                   NUM_ELEMS(csv_file_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            csv_filename = argv[i];
+        } else if (is_matching_arg(argv[i], print_endpoint_arg,
+                                   NUM_ELEMS(print_endpoint_arg))) {
+            print_endpoint = true;
+        } else {
+            printf("ERROR: Unkown argument (%s).\n", argv[i]);
+            return ERROR_UNKOWN_ARG;
+        }
+    }
+
+    // Exactly one input source is required
+    if ((input_filename != NULL) == (input_host != NULL && input_port != NULL))
+        return ERROR_MISSING_ARG;
+
+    return ERROR_NONE;
+}
+
+int main(int argc, char *argv[])
+{
+    error_code_t exit_code = process_args(argc, argv);
+
+    if (show_help || exit_code) {
+        print_help(argv[0]);
+        return exit_code;
+    } else if (show_version) {
+        printf("version %s\n", VERSION);
+        return exit_code;
+    }
+
+    if (csv_filename) {
+        csv_file = fopen(csv_filename, "w");
+        if (csv_file == NULL)
+            return ERROR_FILE_SYSTEM;
+
+        fprintf(csv_file, "tile,seq,timestamp,task,number,state,priority,"
+                          "load_permille,stack_free_words,heap_free,"
+                          "heap_largest_free_block\n");
+    }
+
+    if (input_filename) {
+        FILE *in_file = fopen(input_filename, "rb");
+
+        if (in_file == NULL) {
+            exit_code = ERROR_FILE_SYSTEM;
+        } else {
+            exit_code = process_file(in_file);
+            fclose(in_file);
+        }
+    } else {
+        if (print_endpoint)
+            xscope_ep_set_print_cb(xscope_print_cb);
+
+        xscope_ep_set_register_cb(xscope_register_cb);
+        xscope_ep_set_record_cb(xscope_record_cb);
+        xscope_ep_set_exit_cb(xscope_exit_cb);
+
+        if (xscope_ep_connect(input_host, input_port)) {
+            printf("ERROR: Failed to connect to xscope.\n");
+            running = false;
+            exit_code = ERROR_CONNECT;
+        }
+
+        while (running)
+            SLEEP_MS(1000);
+
+        if (exit_code == ERROR_NONE)
+            xscope_ep_disconnect();
+
+        printf("Decoded %u snapshots, dropped %u.\n", snapshot_count,
+               dropped_count);
+    }
+
+    if (csv_file != NULL)
+        fclose(csv_file);
+
+    return exit_code;
+}
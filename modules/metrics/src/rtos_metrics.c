@@ -0,0 +1,323 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xscope.h>
+#include <xcore/hwtimer.h>
+
+#include "rtos_cpu_load.h"
+#include "rtos_metrics.h"
+
+#if !configGENERATE_RUN_TIME_STATS || !configUSE_TRACE_FACILITY
+#error The metrics service requires configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY
+#endif
+
+/*
+ * Per core state updated by the context switch hooks. Each core only
+ * writes its own entries, and the sampling task reads them without locking.
+ * A read that races with a context switch is off by at most that one
+ * switch, and is corrected at the next sample.
+ */
+static uint32_t core_busy[configNUM_CORES];
+static uint32_t core_switch_time[configNUM_CORES];
+static TaskHandle_t core_task[configNUM_CORES];
+
+/* The idle tasks, found when the service starts */
+static TaskHandle_t idle_task[configNUM_CORES];
+static volatile unsigned idle_task_count;
+
+#define HOOK_IN     0x01
+#define HOOK_OUT    0x02
+static volatile unsigned hooks_seen;
+
+static int task_is_idle(TaskHandle_t task)
+{
+    for (unsigned i = 0; i < idle_task_count; i++) {
+        if (task == idle_task[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void rtos_metrics_task_switched_in(void)
+{
+    const int core = portGET_CORE_ID();
+
+    core_switch_time[core] = get_reference_time();
+    core_task[core] = xTaskGetCurrentTaskHandle();
+    hooks_seen |= HOOK_IN;
+}
+
+void rtos_metrics_task_switched_out(void)
+{
+    const int core = portGET_CORE_ID();
+
+    if (!task_is_idle(core_task[core])) {
+        core_busy[core] += get_reference_time() - core_switch_time[core];
+    }
+    hooks_seen |= HOOK_OUT;
+}
+
+/* The busy time of a core, including the task it is running now */
+static uint32_t core_busy_now(int core, uint32_t now)
+{
+    uint32_t busy = core_busy[core];
+
+    if (!task_is_idle(core_task[core])) {
+        busy += now - core_switch_time[core];
+    }
+    return busy;
+}
+
+static void name_copy(char *dst, const char *src)
+{
+    /* Pads with zeros, and does not terminate a name that fills dst */
+    strncpy(dst, src, RTOS_METRICS_NAME_LEN);
+}
+
+static void status_sort(TaskStatus_t *status, unsigned n)
+{
+    /* Few tasks, and mostly in order already */
+    for (unsigned i = 1; i < n; i++) {
+        TaskStatus_t s = status[i];
+        unsigned j = i;
+
+        while (j > 0 && status[j - 1].xTaskNumber > s.xTaskNumber) {
+            status[j] = status[j - 1];
+            j--;
+        }
+        status[j] = s;
+    }
+}
+
+static void sample(rtos_metrics_t *metrics)
+{
+    uint8_t *snapshot = (uint8_t *) metrics->work;
+    rtos_metrics_snapshot_hdr_t hdr;
+    HeapStats_t heap;
+    uint32_t run_time_total;
+    uint32_t run_time_interval;
+    uint32_t now;
+    unsigned num_tasks;
+    unsigned last = 0;
+    size_t len = sizeof(hdr);
+
+    memset(&hdr, 0, sizeof(hdr));
+
+    num_tasks = uxTaskGetSystemState(metrics->status, RTOS_METRICS_MAX_TASKS, &run_time_total);
+    if (num_tasks == 0) {
+        /* More tasks than fit in the status array */
+        hdr.flags |= RTOS_METRICS_FLAG_TRUNCATED;
+    }
+    now = get_reference_time();
+    vPortGetHeapStats(&heap);
+
+    hdr.id = RTOS_METRICS_SNAPSHOT_ID;
+    hdr.version = RTOS_METRICS_SNAPSHOT_VERSION;
+    hdr.tile = THIS_XCORE_TILE;
+    hdr.num_cores = configNUM_CORES;
+    hdr.seq = metrics->seq++;
+    hdr.timestamp = now;
+    hdr.interval = now - metrics->last_time;
+    hdr.heap_free = heap.xAvailableHeapSpaceInBytes;
+    hdr.heap_min_ever_free = heap.xMinimumEverFreeBytesRemaining;
+    hdr.heap_largest_free_block = heap.xSizeOfLargestFreeBlockInBytes;
+    hdr.heap_free_blocks = heap.xNumberOfFreeBlocks;
+
+    /* Cores */
+    if (hooks_seen == (HOOK_IN | HOOK_OUT) && idle_task_count > 0) {
+        hdr.flags |= RTOS_METRICS_FLAG_CORE_LOAD;
+    }
+    for (int i = 0; i < configNUM_CORES; i++) {
+        const uint32_t busy = core_busy_now(i, now);
+        const uint16_t load = rtos_cpu_load_permille((int32_t) (busy - metrics->last_core_busy[i]), hdr.interval);
+
+        memcpy(&snapshot[len], &load, sizeof(load));
+        len += sizeof(load);
+        metrics->last_core_busy[i] = busy;
+    }
+
+    /* Tasks, in task number order so they can be matched with the last sample */
+    status_sort(metrics->status, num_tasks);
+    run_time_interval = run_time_total - metrics->last_run_time_total;
+
+    for (unsigned i = 0; i < num_tasks; i++) {
+        const TaskStatus_t *s = &metrics->status[i];
+        const uint32_t run_time = s->ulRunTimeCounter;
+        uint32_t task_time = run_time;
+        rtos_metrics_task_t task;
+
+        while (last < metrics->last_num_tasks && metrics->last_task_number[last] < s->xTaskNumber) {
+            last++;
+        }
+        if (last < metrics->last_num_tasks && metrics->last_task_number[last] == s->xTaskNumber) {
+            task_time = run_time - metrics->last_task_run_time[last];
+        }
+
+        name_copy(task.name, s->pcTaskName);
+        task.number = (uint16_t) s->xTaskNumber;
+        task.load = rtos_cpu_load_permille((int32_t) task_time, run_time_interval);
+        task.stack_free = s->usStackHighWaterMark > 0xFFFF ? 0xFFFF : (uint16_t) s->usStackHighWaterMark;
+        task.state = (uint8_t) s->eCurrentState;
+        task.priority = (uint8_t) s->uxCurrentPriority;
+
+        memcpy(&snapshot[len], &task, sizeof(task));
+        len += sizeof(task);
+    }
+    hdr.num_tasks = num_tasks;
+
+    for (unsigned i = 0; i < num_tasks; i++) {
+        metrics->last_task_number[i] = metrics->status[i].xTaskNumber;
+        metrics->last_task_run_time[i] = metrics->status[i].ulRunTimeCounter;
+    }
+    metrics->last_num_tasks = num_tasks;
+    metrics->last_run_time_total = run_time_total;
+    metrics->last_time = now;
+
+    /* Queues */
+    rtos_osal_mutex_get(&metrics->lock, RTOS_OSAL_WAIT_FOREVER);
+    for (unsigned i = 0; i < metrics->num_queues; i++) {
+        rtos_metrics_queue_t queue;
+        const UBaseType_t waiting = uxQueueMessagesWaiting(metrics->queue[i]);
+
+        memcpy(queue.name, metrics->queue_name[i], RTOS_METRICS_NAME_LEN);
+        queue.waiting = waiting;
+        queue.length = waiting + uxQueueSpacesAvailable(metrics->queue[i]);
+
+        memcpy(&snapshot[len], &queue, sizeof(queue));
+        len += sizeof(queue);
+    }
+    hdr.num_queues = metrics->num_queues;
+
+    hdr.length = len;
+    memcpy(snapshot, &hdr, sizeof(hdr));
+
+    memcpy(metrics->snapshot, snapshot, len);
+    metrics->snapshot_len = len;
+    rtos_osal_mutex_put(&metrics->lock);
+}
+
+static void xscope_send(rtos_metrics_t *metrics)
+{
+    const uint8_t *snapshot = (const uint8_t *) metrics->work;
+    const rtos_metrics_snapshot_hdr_t *hdr = (const rtos_metrics_snapshot_hdr_t *) snapshot;
+    uint32_t record[(sizeof(rtos_metrics_xscope_hdr_t) + RTOS_METRICS_XSCOPE_RECORD_BYTES) / sizeof(uint32_t) + 1];
+    rtos_metrics_xscope_hdr_t record_hdr;
+    size_t offset = 0;
+
+    record_hdr.tile = hdr->tile;
+    record_hdr.seq = (uint8_t) hdr->seq;
+
+    while (offset < hdr->length) {
+        size_t n = hdr->length - offset;
+
+        if (n > RTOS_METRICS_XSCOPE_RECORD_BYTES) {
+            n = RTOS_METRICS_XSCOPE_RECORD_BYTES;
+        }
+
+        record_hdr.offset = offset;
+        memcpy(record, &record_hdr, sizeof(record_hdr));
+        memcpy((uint8_t *) record + sizeof(record_hdr), &snapshot[offset], n);
+        xscope_bytes(metrics->xscope_probe, sizeof(record_hdr) + n, (const unsigned char *) record);
+
+        offset += n;
+    }
+}
+
+static void metrics_thread(rtos_metrics_t *metrics)
+{
+    for (;;) {
+        vTaskDelay(metrics->period);
+
+        sample(metrics);
+
+        if (metrics->xscope_probe != RTOS_METRICS_NO_XSCOPE) {
+            xscope_send(metrics);
+        }
+    }
+}
+
+void rtos_metrics_init(rtos_metrics_t *metrics,
+                       int xscope_probe,
+                       unsigned period_ms)
+{
+    memset(metrics, 0, sizeof(*metrics));
+
+    metrics->xscope_probe = xscope_probe;
+    metrics->period = pdMS_TO_TICKS(period_ms);
+
+    rtos_osal_mutex_create(&metrics->lock, "metrics", RTOS_OSAL_NOT_RECURSIVE);
+}
+
+int rtos_metrics_queue_add(rtos_metrics_t *metrics,
+                           QueueHandle_t queue,
+                           const char *name)
+{
+    int ret = -1;
+
+    rtos_osal_mutex_get(&metrics->lock, RTOS_OSAL_WAIT_FOREVER);
+    if (metrics->num_queues < RTOS_METRICS_MAX_QUEUES) {
+        metrics->queue[metrics->num_queues] = queue;
+        name_copy(metrics->queue_name[metrics->num_queues], name);
+        metrics->num_queues++;
+        ret = 0;
+    }
+    rtos_osal_mutex_put(&metrics->lock);
+
+    return ret;
+}
+
+void rtos_metrics_start(rtos_metrics_t *metrics,
+                        unsigned priority)
+{
+    uint32_t run_time_total;
+    uint32_t now;
+    unsigned num_tasks;
+
+    num_tasks = uxTaskGetSystemState(metrics->status, RTOS_METRICS_MAX_TASKS, &run_time_total);
+    now = get_reference_time();
+
+    /* Without the idle tasks the core loads cannot be measured */
+    idle_task_count = rtos_cpu_load_idle_tasks_find(metrics->status, num_tasks, idle_task, NULL);
+
+    /* The first snapshot covers the time from here */
+    status_sort(metrics->status, num_tasks);
+    for (unsigned i = 0; i < num_tasks; i++) {
+        metrics->last_task_number[i] = metrics->status[i].xTaskNumber;
+        metrics->last_task_run_time[i] = metrics->status[i].ulRunTimeCounter;
+    }
+    metrics->last_num_tasks = num_tasks;
+    metrics->last_run_time_total = run_time_total;
+    metrics->last_time = now;
+    for (int i = 0; i < configNUM_CORES; i++) {
+        metrics->last_core_busy[i] = core_busy_now(i, now);
+    }
+
+    rtos_osal_thread_create(
+            &metrics->thread,
+            "metrics",
+            (rtos_osal_entry_function_t) metrics_thread,
+            metrics,
+            RTOS_THREAD_STACK_SIZE(metrics_thread),
+            priority);
+}
+
+size_t rtos_metrics_snapshot_get(rtos_metrics_t *metrics,
+                                 void *buf,
+                                 size_t size)
+{
+    size_t len;
+
+    rtos_osal_mutex_get(&metrics->lock, RTOS_OSAL_WAIT_FOREVER);
+    len = metrics->snapshot_len;
+    if (len > size) {
+        len = 0;
+    } else {
+        memcpy(buf, metrics->snapshot, len);
+    }
+    rtos_osal_mutex_put(&metrics->lock);
+
+    return len;
+}
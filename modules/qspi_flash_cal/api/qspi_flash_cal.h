@@ -0,0 +1,196 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef QSPI_FLASH_CAL_H_
+#define QSPI_FLASH_CAL_H_
+
+/**
+ * \addtogroup qspi_flash_cal qspi_flash_cal
+ *
+ * Finds the fastest QSPI flash read timing that a board reliably supports.
+ *
+ * Quad reads are sampled a number of core clock cycles after each SCLK
+ * edge, and how many depends on the flash part, the board and the clock
+ * rate. Applications have hard-coded a clock divisor, sample delay and
+ * sample edge that are known to work, which leaves most boards running
+ * slower than they could. Calibration instead sweeps, fastest clock
+ * first, every sample point that the QSPI ports can make: each whole SCLK
+ * cycle of sample delay, on either edge, plus up to
+ * qspi_flash_cal_config_t::max_pad_delay core clock cycles of pad delay.
+ * Each point reads a known pattern from flash several times, and passes
+ * only if every read matches. The passing points of one divisor form a
+ * window, and the point in the middle of the widest window is taken if
+ * there are at least qspi_flash_cal_config_t::margin core clock cycles of
+ * passing points on each side of it. The first divisor to give such a
+ * point wins.
+ *
+ * The pattern is kept in a flash sector, with the chosen setting after
+ * it. At the next boot the setting is only checked against the pattern,
+ * and the sweep only runs again when it fails, or when the flash part or
+ * the calibration config has changed. The pattern and setting are read,
+ * and the sector written, at the safe setting the application gives,
+ * which is also the setting used when no point has enough margin. As the
+ * sweep cannot start without it, the safe setting should be slow, such as
+ * the SPI read clock and sample edge.
+ *
+ * All flash access is through user defined functions, so the calibration
+ * runs on the bare-metal QSPI flash library, through
+ * sdk::qspi_flash_cal::qspi_io, and against simulated flash on the host.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The size of the pattern, and of each calibration read. */
+#define QSPI_FLASH_CAL_PATTERN_SIZE     256
+
+/** The size of the sector that holds the pattern and the cached setting. */
+#define QSPI_FLASH_CAL_SECTOR_SIZE      4096
+
+/** Sample on the rising edge of SCLK. */
+#define QSPI_FLASH_CAL_EDGE_RISING      0
+
+/** Sample on the falling edge of SCLK. */
+#define QSPI_FLASH_CAL_EDGE_FALLING     1
+
+/** The pattern cannot be read back at the safe setting. */
+#define QSPI_FLASH_CAL_ERR_PATTERN      -1
+
+/** The config is not valid. */
+#define QSPI_FLASH_CAL_ERR_CONFIG       -2
+
+/**
+ * QSPI full speed read timing.
+ */
+typedef struct {
+    uint8_t divisor;            /**< The SCLK divisor, for an SCLK of the core clock / (2 * divisor) */
+    uint8_t sample_delay;       /**< The number of whole SCLK cycles to delay sampling by */
+    uint8_t sample_edge;        /**< QSPI_FLASH_CAL_EDGE_RISING or QSPI_FLASH_CAL_EDGE_FALLING */
+    uint8_t pad_delay;          /**< The number of core clock cycles to delay sampling the pads by */
+} qspi_flash_cal_setting_t;
+
+/**
+ * Calibration config.
+ */
+typedef struct {
+    unsigned addr;              /**< The address of the sector that holds the pattern and the cached setting */
+    uint32_t flash_id;          /**< The JEDEC ID of the flash part, so a new part is calibrated again */
+    const uint8_t *divisors;    /**< The candidate divisors, fastest first */
+    unsigned divisor_count;     /**< The number of candidate divisors */
+    unsigned max_sample_delay;  /**< The most whole SCLK cycles of sample delay to try */
+    unsigned max_pad_delay;     /**< The most core clock cycles of pad delay to try */
+    unsigned margin;            /**< The core clock cycles of passing points needed on each side of the chosen point */
+    unsigned reads_per_point;   /**< The number of pattern reads that must all pass at a point */
+    unsigned bench_bytes;       /**< The number of bytes read from address 0 to measure read bandwidth, or 0 */
+    qspi_flash_cal_setting_t safe; /**< A setting known to work, for the pattern and as a fallback */
+} qspi_flash_cal_config_t;
+
+/**
+ * Where the setting in a result came from.
+ */
+typedef enum {
+    QSPI_FLASH_CAL_SOURCE_SAFE,     /**< No point had enough margin, or there was an error */
+    QSPI_FLASH_CAL_SOURCE_CACHE,    /**< The cached setting still reads the pattern */
+    QSPI_FLASH_CAL_SOURCE_SWEEP,    /**< The setting was found by a sweep, and has been cached */
+} qspi_flash_cal_source_t;
+
+/**
+ * Calibration result.
+ */
+typedef struct {
+    qspi_flash_cal_setting_t setting;   /**< The setting to use */
+    qspi_flash_cal_source_t source;     /**< Where the setting came from */
+    uint16_t window_start;      /**< The first passing sample point around the setting, in core clock cycles after the rising edge with no delay */
+    uint16_t window_end;        /**< The last passing sample point around the setting */
+    uint32_t points_tried;      /**< The number of sample points tried */
+    uint32_t reads;             /**< The number of pattern reads */
+    uint32_t read_bytes_per_sec;        /**< The measured read bandwidth at the setting, or 0 */
+    uint32_t safe_read_bytes_per_sec;   /**< The measured read bandwidth at the safe setting, or 0 */
+} qspi_flash_cal_result_t;
+
+/**
+ * Calibrates the QSPI flash read timing, or checks the cached setting.
+ *
+ * On return, the flash may be at any setting, and the application must
+ * apply result->setting. result is always filled in, and on error its
+ * setting is the safe setting.
+ *
+ * \param config    The calibration config
+ * \param app_data  A pointer to the application specific data, passed to the
+ *                  user defined functions
+ * \param result    Receives the result
+ *
+ * \retval 0                            on success, including when the safe setting is chosen
+ * \retval QSPI_FLASH_CAL_ERR_PATTERN   if the pattern cannot be read at the safe setting
+ * \retval QSPI_FLASH_CAL_ERR_CONFIG    if the config is not valid
+ */
+int qspi_flash_cal_run(const qspi_flash_cal_config_t *config,
+                       void *app_data,
+                       qspi_flash_cal_result_t *result);
+
+/**
+ * Gets the calibration pattern.
+ *
+ * The pattern drives every SIO line high and low on alternate SCLK
+ * cycles, walks ones and zeros across the lines, and ends with
+ * pseudo-random data.
+ *
+ * \param buf  Receives QSPI_FLASH_CAL_PATTERN_SIZE bytes
+ */
+void qspi_flash_cal_pattern(uint8_t *buf);
+
+/**
+ * User defined flash read function, at a given setting.
+ *
+ * Reads with the quad read command, after applying the setting if it is
+ * not the one that is applied already.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param setting   The read timing to use
+ * \param addr      The flash address to read from
+ * \param buf       A pointer to the buffer to read into
+ * \param len       The number of bytes to read
+ *
+ * \return 0 on success
+ */
+int qspi_flash_cal_read(void *app_data, const qspi_flash_cal_setting_t *setting,
+                        unsigned addr, uint8_t *buf, size_t len);
+
+/**
+ * User defined flash write function.
+ *
+ * Only called just after a read at the safe setting, and never across a
+ * page boundary.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The flash address to write to
+ * \param buf       A pointer to the data to write
+ * \param len       The number of bytes to write
+ */
+void qspi_flash_cal_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len);
+
+/**
+ * User defined flash erase function.
+ *
+ * Only called just after a read at the safe setting.
+ *
+ * \param app_data  A pointer to the application specific data
+ * \param addr      The address of the sector to erase
+ * \param len       The number of bytes to erase, QSPI_FLASH_CAL_SECTOR_SIZE
+ */
+void qspi_flash_cal_erase(void *app_data, unsigned addr, size_t len);
+
+/**
+ * User defined time function, for the read bandwidth.
+ *
+ * \param app_data  A pointer to the application specific data
+ *
+ * \return the time in 100 MHz reference clock ticks
+ */
+uint32_t qspi_flash_cal_ticks(void *app_data);
+
+/**@}*/
+
+#endif /* QSPI_FLASH_CAL_H_ */
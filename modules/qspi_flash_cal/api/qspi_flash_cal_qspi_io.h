@@ -0,0 +1,56 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef QSPI_FLASH_CAL_QSPI_IO_H_
+#define QSPI_FLASH_CAL_QSPI_IO_H_
+
+/**
+ * \addtogroup qspi_flash_cal_qspi_io qspi_flash_cal_qspi_io
+ *
+ * Calibrates a flash on the bare-metal QSPI flash library.
+ *
+ * This provides the qspi_flash_cal user defined functions, with a
+ * qspi_flash_ctx_t as the application data. A setting is applied by
+ * deinitializing the flash, setting the full speed clock divisor, sample
+ * delay, sample edge and SIO pad delay in its qspi_io_ctx_t, and
+ * initializing it again. So an application that uses this must not also
+ * define the qspi_flash_cal user defined functions.
+ *
+ * @{
+ */
+
+#include "qspi_flash.h"
+#include "qspi_flash_cal.h"
+
+/**
+ * Calibrates a flash, and applies the result.
+ *
+ * The flash must have been initialized with qspi_flash_init(), with its
+ * ports, SPI read clock and any SFDP overrides already set. On return it
+ * is initialized at result->setting, in place of the full speed clock
+ * configuration it was initialized with. The JEDEC
+ * ID of the flash is read into the config that the calibration sees, so
+ * config->flash_id is not used.
+ *
+ * \param ctx     The flash context
+ * \param config  The calibration config
+ * \param result  Receives the result
+ *
+ * \return the return value of qspi_flash_cal_run()
+ */
+int qspi_flash_cal_qspi_flash(qspi_flash_ctx_t *ctx,
+                              const qspi_flash_cal_config_t *config,
+                              qspi_flash_cal_result_t *result);
+
+/**
+ * Gets the qspi_io sample edge for a setting.
+ *
+ * \param setting  The setting
+ *
+ * \return qspi_io_sample_edge_rising or qspi_io_sample_edge_falling
+ */
+qspi_io_sample_edge_t qspi_flash_cal_qspi_io_edge(const qspi_flash_cal_setting_t *setting);
+
+/**@}*/
+
+#endif /* QSPI_FLASH_CAL_QSPI_IO_H_ */
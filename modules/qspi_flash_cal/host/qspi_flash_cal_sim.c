@@ -0,0 +1,489 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Host test and benchmark for QSPI flash timing calibration.
+ *
+ * The flash is simulated with NOR semantics and a read timing window. A
+ * nibble that the flash launches on one SCLK edge is valid at the xcore
+ * pads from valid_ns after that edge until hold_ns after the next launch
+ * edge. A sample point is taken io_ns before its nominal time, for the
+ * SCLK output and SIO input delays of the ports and the board. Sampled
+ * within jitter_ns of either end of the window, a nibble is wrong one
+ * time in four; further outside, it is always the neighbouring nibble.
+ * Above the flash's maximum clock every read is garbage.
+ *
+ * For each board profile, calibration is run on blank flash, then again
+ * as at the next boot, then after the board's timing has drifted, after
+ * the cached setting is corrupted, with another flash part and with
+ * another config. The chosen setting is checked against the model, to be
+ * in the window with margin and at the fastest divisor that has such a
+ * point, and the read bandwidth and calibration time are reported. The
+ * exit code is non-zero on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qspi_flash_cal.h"
+
+#define CORE_CLOCK_MHZ          600.0
+#define FLASH_SIZE              (64 * 1024)
+#define CAL_ADDR                (FLASH_SIZE - QSPI_FLASH_CAL_SECTOR_SIZE)
+#define BENCH_BYTES             (32 * 1024)
+
+/* Flash timing model, in nanoseconds */
+#define SIM_CALL_NS             1000        /* driver overhead per read */
+#define SIM_READ_CYCLES         20          /* command, address, mode and dummy SCLK cycles of a quad read */
+#define SIM_APPLY_NS            20000       /* deinit and init to change setting */
+#define SIM_PAGE_PROGRAM_NS     400000
+#define SIM_ERASE_4K_NS         45000000
+
+typedef struct {
+    const char *name;
+    double fmax_mhz;        /* the fastest quad read clock of the flash part */
+    double valid_ns;        /* from the launch edge to valid data at the pads */
+    double hold_ns;         /* data still valid after the next launch edge */
+    double jitter_ns;       /* either side of the window, where reads sometimes fail */
+    double io_ns;           /* how much earlier than nominal a point samples */
+} board_t;
+
+typedef struct {
+    board_t board;
+    uint32_t id;
+    uint8_t mem[FLASH_SIZE];
+    qspi_flash_cal_setting_t applied;
+    uint64_t now_ns;
+    uint32_t erases;
+    uint32_t programs;
+    uint32_t applies;
+    uint32_t rng;
+} sim_flash_t;
+
+static sim_flash_t flash;
+static int failures;
+
+static const board_t boards[] = {
+    /* name          fmax   valid  hold  jitter  io */
+    { "explorer",    104.0,  8.0,  1.5,  0.5,  10.0 },
+    { "fast",        133.0,  5.0,  1.5,  0.3,   8.0 },
+    { "slow-part",    50.0,  8.0,  1.5,  0.5,  10.0 },
+    { "long-traces", 104.0, 12.0,  2.0,  0.8,  10.0 },
+};
+
+static const uint8_t divisors[] = { 2, 3, 4, 5, 6, 8, 12 };
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static uint32_t rng_next(void)
+{
+    uint32_t x = flash.rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return flash.rng = x;
+}
+
+static int setting_equal(const qspi_flash_cal_setting_t *a, const qspi_flash_cal_setting_t *b)
+{
+    return a->divisor == b->divisor && a->sample_delay == b->sample_delay &&
+           a->sample_edge == b->sample_edge && a->pad_delay == b->pad_delay;
+}
+
+static double sclk_mhz(unsigned divisor)
+{
+    return CORE_CLOCK_MHZ / (2 * divisor);
+}
+
+/* Where a point samples, from the launch edge: the rising edge, half a cycle after it, is point 0 */
+static double sample_ns(const board_t *board, unsigned divisor, unsigned t)
+{
+    const double core_ns = 1000.0 / CORE_CLOCK_MHZ;
+
+    return (divisor + t) * core_ns - board->io_ns;
+}
+
+/* 0 if a point always reads correctly, 1 if it sometimes fails, 2 if it always does */
+static int point_state(const board_t *board, unsigned divisor, unsigned t)
+{
+    const double period_ns = 1000.0 / sclk_mhz(divisor);
+    const double s = sample_ns(board, divisor, t);
+    const double end = period_ns + board->hold_ns;
+
+    if (sclk_mhz(divisor) > board->fmax_mhz) {
+        return 2;
+    }
+    if (s < board->valid_ns - board->jitter_ns || s > end + board->jitter_ns) {
+        return 2;
+    }
+    if (s < board->valid_ns + board->jitter_ns || s > end - board->jitter_ns) {
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned setting_point(const qspi_flash_cal_setting_t *setting)
+{
+    const unsigned half = 2 * setting->sample_delay + (setting->sample_edge == QSPI_FLASH_CAL_EDGE_FALLING);
+
+    return half * setting->divisor + setting->pad_delay;
+}
+
+static int point_reachable(const qspi_flash_cal_config_t *config, unsigned divisor, unsigned t)
+{
+    for (unsigned half = 0; half <= 2 * config->max_sample_delay + 1; half++) {
+        if (t >= half * divisor && t - half * divisor <= config->max_pad_delay) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* A point whose every reachable neighbour within the margin always reads correctly */
+static int point_has_margin(const board_t *board, const qspi_flash_cal_config_t *config,
+                            unsigned divisor, unsigned t)
+{
+    if (t < config->margin) {
+        return 0;
+    }
+    for (unsigned u = t - config->margin; u <= t + config->margin; u++) {
+        if (point_reachable(config, divisor, u) && point_state(board, divisor, u) != 0) {
+            return 0;
+        }
+    }
+    return point_reachable(config, divisor, t);
+}
+
+/*
+ * Simulated flash
+ */
+
+static void sim_reset(const board_t *board, uint32_t id)
+{
+    uint32_t x = 0x12345678;
+
+    memset(&flash, 0, sizeof(flash));
+    flash.board = *board;
+    flash.id = id;
+    flash.rng = 0x9E3779B9;
+    memset(flash.mem, 0xFF, sizeof(flash.mem));
+    /* Something like an image at the start, for the bandwidth reads */
+    for (unsigned i = 0; i < CAL_ADDR; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        flash.mem[i] = (uint8_t) x;
+    }
+}
+
+static uint8_t nibble_get(unsigned addr, int n)
+{
+    const uint8_t byte = (addr < FLASH_SIZE) ? flash.mem[addr] : 0xFF;
+
+    return (n == 0) ? (byte >> 4) : (byte & 0xF);
+}
+
+int qspi_flash_cal_read(void *app_data, const qspi_flash_cal_setting_t *setting,
+                        unsigned addr, uint8_t *buf, size_t len)
+{
+    const board_t *board = &flash.board;
+    const unsigned t = setting_point(setting);
+    const double period_ns = 1000.0 / sclk_mhz(setting->divisor);
+    const double s = sample_ns(board, setting->divisor, t);
+    const double end = period_ns + board->hold_ns;
+    const int garbage = sclk_mhz(setting->divisor) > board->fmax_mhz;
+
+    (void) app_data;
+
+    if (!setting_equal(setting, &flash.applied)) {
+        flash.applied = *setting;
+        flash.applies++;
+        flash.now_ns += SIM_APPLY_NS;
+    }
+    flash.now_ns += SIM_CALL_NS + (uint64_t) ((SIM_READ_CYCLES + 2 * len) * period_ns);
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t out = 0;
+
+        for (int n = 0; n < 2; n++) {
+            /* The nibbles either side, in the order they are sent */
+            const unsigned prev_addr = (n == 0) ? addr + i - 1 : addr + i;
+            const unsigned next_addr = (n == 0) ? addr + i : addr + i + 1;
+            uint8_t v = nibble_get(addr + i, n);
+
+            if (garbage) {
+                v = rng_next() & 0xF;
+            } else if (s < board->valid_ns - board->jitter_ns ||
+                       (s < board->valid_ns + board->jitter_ns && (rng_next() & 3) == 0)) {
+                v = (i == 0 && n == 0) ? 0xF : nibble_get(prev_addr, !n);
+            } else if (s > end + board->jitter_ns ||
+                       (s > end - board->jitter_ns && (rng_next() & 3) == 0)) {
+                v = nibble_get(next_addr, !n);
+            }
+            out = (out << 4) | v;
+        }
+        buf[i] = out;
+    }
+    return 0;
+}
+
+void qspi_flash_cal_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    (void) app_data;
+
+    for (size_t i = 0; i < len && addr + i < FLASH_SIZE; i++) {
+        flash.mem[addr + i] &= buf[i];
+    }
+    flash.programs++;
+    flash.now_ns += SIM_PAGE_PROGRAM_NS;
+}
+
+void qspi_flash_cal_erase(void *app_data, unsigned addr, size_t len)
+{
+    (void) app_data;
+
+    if (addr + len <= FLASH_SIZE) {
+        memset(&flash.mem[addr], 0xFF, len);
+    }
+    flash.erases++;
+    flash.now_ns += SIM_ERASE_4K_NS;
+}
+
+uint32_t qspi_flash_cal_ticks(void *app_data)
+{
+    (void) app_data;
+
+    return (uint32_t) (flash.now_ns / 10);
+}
+
+/*
+ * Tests
+ */
+
+static void config_default(qspi_flash_cal_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->addr = CAL_ADDR;
+    config->flash_id = flash.id;
+    config->divisors = divisors;
+    config->divisor_count = sizeof(divisors);
+    config->max_sample_delay = 2;
+    config->max_pad_delay = 5;
+    config->margin = 1;
+    config->reads_per_point = 8;
+    config->bench_bytes = BENCH_BYTES;
+    /* The SPI read timing of the examples: 25 MHz, falling edge, no delay */
+    config->safe.divisor = 12;
+    config->safe.sample_delay = 0;
+    config->safe.sample_edge = QSPI_FLASH_CAL_EDGE_FALLING;
+    config->safe.pad_delay = 0;
+}
+
+static int run(const qspi_flash_cal_config_t *config, qspi_flash_cal_result_t *result, double *ms)
+{
+    const uint64_t start = flash.now_ns;
+    uint32_t bench_ns;
+    int ret;
+
+    flash.erases = 0;
+    flash.programs = 0;
+    ret = qspi_flash_cal_run(config, NULL, result);
+
+    /* The bandwidth reads are not part of the calibration time */
+    bench_ns = 0;
+    if (result->read_bytes_per_sec != 0) {
+        bench_ns += (uint32_t) (1e9 * BENCH_BYTES / result->read_bytes_per_sec);
+    }
+    if (result->safe_read_bytes_per_sec != 0) {
+        bench_ns += (uint32_t) (1e9 * BENCH_BYTES / result->safe_read_bytes_per_sec);
+    }
+    *ms = (flash.now_ns - start - bench_ns) / 1e6;
+    return ret;
+}
+
+static const char *source_name(qspi_flash_cal_source_t source)
+{
+    switch (source) {
+    case QSPI_FLASH_CAL_SOURCE_CACHE:
+        return "cache";
+    case QSPI_FLASH_CAL_SOURCE_SWEEP:
+        return "sweep";
+    default:
+        return "safe";
+    }
+}
+
+static void report(const char *name, const char *what, const qspi_flash_cal_result_t *r, double ms)
+{
+    const qspi_flash_cal_setting_t *s = &r->setting;
+
+    printf("%-12s %-11s %-5s %5.1f MHz  delay %u %-7s pad %u  window %2u-%-2u  %4u points %5u reads %8.2f ms  %5.1f MB/s (safe %5.1f MB/s)\n",
+           name, what, source_name(r->source),
+           sclk_mhz(s->divisor), s->sample_delay,
+           s->sample_edge == QSPI_FLASH_CAL_EDGE_RISING ? "rising" : "falling",
+           s->pad_delay, r->window_start, r->window_end,
+           (unsigned) r->points_tried, (unsigned) r->reads, ms,
+           r->read_bytes_per_sec / 1e6, r->safe_read_bytes_per_sec / 1e6);
+}
+
+/* The chosen point has margin in the model, and no faster divisor has such a point */
+static void check_choice(const board_t *board, const qspi_flash_cal_config_t *config,
+                         const qspi_flash_cal_result_t *result, const char *name)
+{
+    const qspi_flash_cal_setting_t *s = &result->setting;
+    const unsigned t = setting_point(s);
+    char what[128];
+
+    snprintf(what, sizeof(what), "%s: chosen point has margin", name);
+    check(point_has_margin(board, config, s->divisor, t), what);
+
+    for (unsigned i = 0; i < config->divisor_count && config->divisors[i] != s->divisor; i++) {
+        const unsigned d = config->divisors[i];
+        const unsigned t_max = (2 * config->max_sample_delay + 1) * d + config->max_pad_delay;
+
+        for (unsigned u = 0; u <= t_max; u++) {
+            if (point_has_margin(board, config, d, u)) {
+                snprintf(what, sizeof(what), "%s: divisor %u has a point with margin at %u", name, d, u);
+                check(0, what);
+                break;
+            }
+        }
+    }
+
+    snprintf(what, sizeof(what), "%s: faster than the safe setting, or the safe setting", name);
+    check(result->read_bytes_per_sec > result->safe_read_bytes_per_sec ||
+          setting_equal(s, &config->safe), what);
+}
+
+static void board_test(const board_t *board)
+{
+    qspi_flash_cal_config_t config;
+    qspi_flash_cal_result_t first;
+    qspi_flash_cal_result_t r;
+    board_t drifted;
+    char what[128];
+    double ms;
+    int ret;
+
+    sim_reset(board, 0xEF4016);
+    config_default(&config);
+
+    /* Blank flash: the pattern is written and the sweep runs */
+    ret = run(&config, &first, &ms);
+    report(board->name, "first boot", &first, ms);
+    snprintf(what, sizeof(what), "%s: first boot sweeps", board->name);
+    check(ret == 0 && first.source == QSPI_FLASH_CAL_SOURCE_SWEEP, what);
+    check_choice(board, &config, &first, board->name);
+
+    /* The next boot only checks the cached setting */
+    ret = run(&config, &r, &ms);
+    report(board->name, "next boot", &r, ms);
+    snprintf(what, sizeof(what), "%s: next boot uses the cache", board->name);
+    check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_CACHE && setting_equal(&r.setting, &first.setting), what);
+    snprintf(what, sizeof(what), "%s: next boot writes nothing", board->name);
+    check(flash.erases == 0 && flash.programs == 0 && r.points_tried == 0, what);
+
+    /* The board's timing drifts until the cached setting fails */
+    drifted = *board;
+    while (point_state(&drifted, first.setting.divisor, setting_point(&first.setting)) == 0) {
+        drifted.valid_ns += 0.5;
+    }
+    flash.board = drifted;
+    ret = run(&config, &r, &ms);
+    report(board->name, "drifted", &r, ms);
+    snprintf(what, sizeof(what), "%s: drift calibrates again", board->name);
+    check(ret == 0 && r.source != QSPI_FLASH_CAL_SOURCE_CACHE, what);
+    if (r.source == QSPI_FLASH_CAL_SOURCE_SWEEP) {
+        check_choice(&drifted, &config, &r, board->name);
+    }
+    flash.board = *board;
+
+    /* A corrupt cached setting, another flash part and another config all sweep */
+    ret = run(&config, &r, &ms);
+    flash.mem[CAL_ADDR + QSPI_FLASH_CAL_PATTERN_SIZE + 12] ^= 0x01;
+    ret = run(&config, &r, &ms);
+    snprintf(what, sizeof(what), "%s: corrupt cache calibrates again", board->name);
+    check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_SWEEP, what);
+
+    config.flash_id = 0xC22016;
+    ret = run(&config, &r, &ms);
+    snprintf(what, sizeof(what), "%s: new flash part calibrates again", board->name);
+    check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_SWEEP, what);
+
+    config.margin = 2;
+    ret = run(&config, &r, &ms);
+    report(board->name, "margin 2", &r, ms);
+    snprintf(what, sizeof(what), "%s: new config calibrates again", board->name);
+    check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_SWEEP, what);
+    check_choice(board, &config, &r, board->name);
+}
+
+int main(int argc, char **argv)
+{
+    qspi_flash_cal_config_t config;
+    qspi_flash_cal_result_t r;
+    double ms;
+    int ret;
+
+    (void) argc;
+    (void) argv;
+
+    for (size_t i = 0; i < sizeof(boards) / sizeof(boards[0]); i++) {
+        board_test(&boards[i]);
+        printf("\n");
+    }
+
+    /* No point has the margin asked for, so the safe setting is used and nothing is cached */
+    {
+        sim_reset(&boards[0], 0xEF4016);
+        config_default(&config);
+        config.margin = 50;
+        ret = run(&config, &r, &ms);
+        report("no-margin", "first boot", &r, ms);
+        check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_SAFE && setting_equal(&r.setting, &config.safe),
+              "no margin uses the safe setting");
+        ret = run(&config, &r, &ms);
+        check(ret == 0 && r.source == QSPI_FLASH_CAL_SOURCE_SAFE && r.points_tried > 0,
+              "no margin is not cached");
+    }
+
+    /* The safe setting cannot read the pattern */
+    {
+        board_t dead = boards[0];
+
+        dead.valid_ns = 40.0;
+        sim_reset(&dead, 0xEF4016);
+        config_default(&config);
+        ret = run(&config, &r, &ms);
+        report("dead", "first boot", &r, ms);
+        check(ret == QSPI_FLASH_CAL_ERR_PATTERN && r.source == QSPI_FLASH_CAL_SOURCE_SAFE &&
+              setting_equal(&r.setting, &config.safe), "unreadable pattern reported");
+    }
+
+    /* A bad config */
+    {
+        sim_reset(&boards[0], 0xEF4016);
+        config_default(&config);
+        config.addr = CAL_ADDR + 1;
+        check(qspi_flash_cal_run(&config, NULL, &r) == QSPI_FLASH_CAL_ERR_CONFIG, "unaligned sector rejected");
+        config_default(&config);
+        config.divisor_count = 0;
+        check(qspi_flash_cal_run(&config, NULL, &r) == QSPI_FLASH_CAL_ERR_CONFIG, "no divisors rejected");
+    }
+
+    if (failures) {
+        printf("\nFAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("\nAll checks passed\n");
+    return 0;
+}
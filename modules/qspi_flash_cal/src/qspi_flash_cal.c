@@ -0,0 +1,377 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "qspi_flash_cal.h"
+
+#define RECORD_MAGIC    0x31434651  /* "QFC1" */
+#define REF_CLOCK_HZ    100000000
+
+/* Stored in the sector, just after the pattern */
+typedef struct {
+    uint32_t magic;
+    uint32_t config_crc;
+    uint32_t flash_id;
+    qspi_flash_cal_setting_t setting;
+    uint16_t window_start;
+    uint16_t window_end;
+    uint32_t crc;
+} cal_record_t;
+
+typedef struct {
+    const qspi_flash_cal_config_t *config;
+    void *app_data;
+    qspi_flash_cal_result_t *result;
+    uint8_t pattern[QSPI_FLASH_CAL_PATTERN_SIZE];
+    uint8_t buf[QSPI_FLASH_CAL_PATTERN_SIZE];
+} cal_state_t;
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+/* Any change to what is swept, or how, calibrates again */
+static uint32_t config_crc(const qspi_flash_cal_config_t *config)
+{
+    const uint32_t words[] = {
+        config->divisor_count,
+        config->max_sample_delay,
+        config->max_pad_delay,
+        config->margin,
+        config->reads_per_point,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+
+    crc = crc32(crc, words, sizeof(words));
+    crc = crc32(crc, config->divisors, config->divisor_count);
+    crc = crc32(crc, &config->safe, sizeof(config->safe));
+    return ~crc;
+}
+
+static uint32_t record_crc(const cal_record_t *record)
+{
+    return ~crc32(0xFFFFFFFF, record, offsetof(cal_record_t, crc));
+}
+
+void qspi_flash_cal_pattern(uint8_t *buf)
+{
+    static const uint8_t walk[8] = { 0x11, 0x22, 0x44, 0x88, 0xEE, 0xDD, 0xBB, 0x77 };
+    uint32_t x = 0x2545F491;
+    int i = 0;
+
+    /* Every line toggles on every SCLK cycle, then on every other one */
+    for (; i < 32; i++) {
+        buf[i] = (i & 1) ? 0xF0 : 0x0F;
+    }
+    for (; i < 64; i++) {
+        buf[i] = (i & 1) ? 0xFF : 0x00;
+    }
+    /* Neighbouring lines in opposite states */
+    for (; i < 96; i++) {
+        buf[i] = (i & 1) ? 0xA5 : 0x5A;
+    }
+    /* A one, then a zero, walking across the lines */
+    for (; i < 160; i++) {
+        buf[i] = walk[i & 7];
+    }
+    for (; i < QSPI_FLASH_CAL_PATTERN_SIZE; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (uint8_t) x;
+    }
+}
+
+static int pattern_check(cal_state_t *st, const qspi_flash_cal_setting_t *setting, unsigned reads)
+{
+    for (unsigned i = 0; i < reads; i++) {
+        st->result->reads++;
+        if (qspi_flash_cal_read(st->app_data, setting, st->config->addr, st->buf, QSPI_FLASH_CAL_PATTERN_SIZE) != 0 ||
+            memcmp(st->buf, st->pattern, QSPI_FLASH_CAL_PATTERN_SIZE) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Sample points are numbered in core clock cycles from the earliest one,
+ * the rising edge with no delay. Each half SCLK cycle is divisor cycles.
+ * Where the pad delay cannot reach a point, there is no point there.
+ */
+static int point_setting(const qspi_flash_cal_config_t *config, unsigned divisor, unsigned t,
+                         qspi_flash_cal_setting_t *setting)
+{
+    const unsigned max_half = 2 * config->max_sample_delay + 1;
+    unsigned half = t / divisor;
+    unsigned pad;
+
+    if (half > max_half) {
+        half = max_half;
+    }
+    pad = t - half * divisor;
+    if (pad > config->max_pad_delay) {
+        return 0;
+    }
+    setting->divisor = divisor;
+    setting->sample_delay = half / 2;
+    setting->sample_edge = (half & 1) ? QSPI_FLASH_CAL_EDGE_FALLING : QSPI_FLASH_CAL_EDGE_RISING;
+    setting->pad_delay = pad;
+    return 1;
+}
+
+/* Sweeps one divisor, and picks the middle of its widest window */
+static int divisor_sweep(cal_state_t *st, unsigned divisor)
+{
+    const qspi_flash_cal_config_t *config = st->config;
+    const unsigned t_max = (2 * config->max_sample_delay + 1) * divisor + config->max_pad_delay;
+    unsigned run_start = 0;
+    unsigned run_end = 0;
+    unsigned best_start = 0;
+    unsigned best_end = 0;
+    int in_run = 0;
+    int found = 0;
+    qspi_flash_cal_setting_t setting;
+
+    for (unsigned t = 0; t <= t_max + 1; t++) {
+        int pass = 0;
+
+        if (t <= t_max) {
+            if (!point_setting(config, divisor, t, &setting)) {
+                /* Out of reach, so it neither extends nor ends a window */
+                continue;
+            }
+            st->result->points_tried++;
+            pass = pattern_check(st, &setting, config->reads_per_point);
+        }
+
+        if (pass) {
+            if (!in_run) {
+                run_start = t;
+                in_run = 1;
+            }
+            run_end = t;
+        } else if (in_run) {
+            if (!found || run_end - run_start > best_end - best_start) {
+                best_start = run_start;
+                best_end = run_end;
+                found = 1;
+            }
+            in_run = 0;
+        }
+    }
+
+    if (!found) {
+        return 0;
+    }
+
+    /* The reachable point nearest the middle, which may not be exactly in it */
+    {
+        const unsigned mid = (best_start + best_end) / 2;
+        qspi_flash_cal_setting_t chosen = { 0 };
+        unsigned chosen_t = 0;
+        int have = 0;
+
+        for (unsigned t = best_start; t <= best_end; t++) {
+            if (point_setting(config, divisor, t, &setting)) {
+                const unsigned d = (t > mid) ? t - mid : mid - t;
+                const unsigned best_d = (chosen_t > mid) ? chosen_t - mid : mid - chosen_t;
+
+                if (!have || d < best_d) {
+                    chosen = setting;
+                    chosen_t = t;
+                    have = 1;
+                }
+            }
+        }
+        if (chosen_t - best_start < config->margin || best_end - chosen_t < config->margin) {
+            return 0;
+        }
+        st->result->setting = chosen;
+        st->result->window_start = best_start;
+        st->result->window_end = best_end;
+    }
+    return 1;
+}
+
+static int sector_write(cal_state_t *st, const cal_record_t *record)
+{
+    const qspi_flash_cal_config_t *config = st->config;
+
+    /* Gets the flash back to the safe setting before it is written */
+    if (qspi_flash_cal_read(st->app_data, &config->safe, config->addr, st->buf, QSPI_FLASH_CAL_PATTERN_SIZE) != 0) {
+        return 0;
+    }
+    qspi_flash_cal_erase(st->app_data, config->addr, QSPI_FLASH_CAL_SECTOR_SIZE);
+    qspi_flash_cal_write(st->app_data, config->addr, st->pattern, QSPI_FLASH_CAL_PATTERN_SIZE);
+    if (record != NULL) {
+        qspi_flash_cal_write(st->app_data, config->addr + QSPI_FLASH_CAL_PATTERN_SIZE,
+                             (const uint8_t *) record, sizeof(*record));
+    }
+    return pattern_check(st, &config->safe, 1);
+}
+
+/* Only erases when the record area has been written before */
+static int record_write(cal_state_t *st, const cal_record_t *record)
+{
+    const qspi_flash_cal_config_t *config = st->config;
+    const unsigned addr = config->addr + QSPI_FLASH_CAL_PATTERN_SIZE;
+
+    if (qspi_flash_cal_read(st->app_data, &config->safe, addr, st->buf, sizeof(*record)) != 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(*record); i++) {
+        if (st->buf[i] != 0xFF) {
+            return sector_write(st, record);
+        }
+    }
+    qspi_flash_cal_write(st->app_data, addr, (const uint8_t *) record, sizeof(*record));
+    return pattern_check(st, &config->safe, 1);
+}
+
+static uint32_t read_bandwidth(cal_state_t *st, const qspi_flash_cal_setting_t *setting)
+{
+    const unsigned bytes = st->config->bench_bytes;
+    uint32_t start;
+    uint32_t ticks;
+
+    if (bytes == 0) {
+        return 0;
+    }
+
+    start = qspi_flash_cal_ticks(st->app_data);
+    for (unsigned addr = 0; addr < bytes; addr += QSPI_FLASH_CAL_PATTERN_SIZE) {
+        const size_t len = (bytes - addr < QSPI_FLASH_CAL_PATTERN_SIZE) ? bytes - addr : QSPI_FLASH_CAL_PATTERN_SIZE;
+
+        qspi_flash_cal_read(st->app_data, setting, addr, st->buf, len);
+    }
+    ticks = qspi_flash_cal_ticks(st->app_data) - start;
+
+    return (ticks == 0) ? 0 : (uint32_t) (((uint64_t) bytes * REF_CLOCK_HZ) / ticks);
+}
+
+int qspi_flash_cal_run(const qspi_flash_cal_config_t *config,
+                       void *app_data,
+                       qspi_flash_cal_result_t *result)
+{
+    cal_state_t st;
+    cal_record_t record;
+    int pattern_ok;
+    int ret = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->setting = config->safe;
+    result->source = QSPI_FLASH_CAL_SOURCE_SAFE;
+
+    if (config->divisor_count == 0 || config->divisors == NULL || config->reads_per_point == 0 ||
+        (config->addr % QSPI_FLASH_CAL_SECTOR_SIZE) != 0) {
+        return QSPI_FLASH_CAL_ERR_CONFIG;
+    }
+
+    st.config = config;
+    st.app_data = app_data;
+    st.result = result;
+    qspi_flash_cal_pattern(st.pattern);
+
+    pattern_ok = pattern_check(&st, &config->safe, 1);
+    memset(&record, 0, sizeof(record));
+    qspi_flash_cal_read(app_data, &config->safe, config->addr + QSPI_FLASH_CAL_PATTERN_SIZE,
+                        (uint8_t *) &record, sizeof(record));
+
+    if (pattern_ok &&
+        record.magic == RECORD_MAGIC &&
+        record.crc == record_crc(&record) &&
+        record.config_crc == config_crc(config) &&
+        record.flash_id == config->flash_id &&
+        pattern_check(&st, &record.setting, config->reads_per_point)) {
+        result->setting = record.setting;
+        result->source = QSPI_FLASH_CAL_SOURCE_CACHE;
+        result->window_start = record.window_start;
+        result->window_end = record.window_end;
+    } else {
+        if (!pattern_ok && !sector_write(&st, NULL)) {
+            ret = QSPI_FLASH_CAL_ERR_PATTERN;
+        }
+
+        for (unsigned i = 0; ret == 0 && i < config->divisor_count; i++) {
+            if (divisor_sweep(&st, config->divisors[i])) {
+                result->source = QSPI_FLASH_CAL_SOURCE_SWEEP;
+                break;
+            }
+        }
+
+        if (result->source == QSPI_FLASH_CAL_SOURCE_SWEEP) {
+            memset(&record, 0, sizeof(record));
+            record.magic = RECORD_MAGIC;
+            record.config_crc = config_crc(config);
+            record.flash_id = config->flash_id;
+            record.setting = result->setting;
+            record.window_start = result->window_start;
+            record.window_end = result->window_end;
+            record.crc = record_crc(&record);
+            if (!record_write(&st, &record)) {
+                ret = QSPI_FLASH_CAL_ERR_PATTERN;
+            }
+        }
+
+        if (ret != 0) {
+            result->setting = config->safe;
+            result->source = QSPI_FLASH_CAL_SOURCE_SAFE;
+        }
+    }
+
+    if (ret == 0) {
+        result->safe_read_bytes_per_sec = read_bandwidth(&st, &config->safe);
+        result->read_bytes_per_sec = read_bandwidth(&st, &result->setting);
+    }
+
+    return ret;
+}
+
+__attribute__((weak))
+int qspi_flash_cal_read(void *app_data, const qspi_flash_cal_setting_t *setting,
+                        unsigned addr, uint8_t *buf, size_t len)
+{
+    (void) app_data;
+    (void) setting;
+    (void) addr;
+    (void) buf;
+    (void) len;
+
+    return -1;
+}
+
+__attribute__((weak))
+void qspi_flash_cal_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    (void) app_data;
+    (void) addr;
+    (void) buf;
+    (void) len;
+}
+
+__attribute__((weak))
+void qspi_flash_cal_erase(void *app_data, unsigned addr, size_t len)
+{
+    (void) app_data;
+    (void) addr;
+    (void) len;
+}
+
+__attribute__((weak))
+uint32_t qspi_flash_cal_ticks(void *app_data)
+{
+    (void) app_data;
+
+    return 0;
+}
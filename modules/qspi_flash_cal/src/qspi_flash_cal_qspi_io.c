@@ -0,0 +1,88 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <xcore/hwtimer.h>
+
+#include "qspi_flash_cal_qspi_io.h"
+
+qspi_io_sample_edge_t qspi_flash_cal_qspi_io_edge(const qspi_flash_cal_setting_t *setting)
+{
+    return (setting->sample_edge == QSPI_FLASH_CAL_EDGE_FALLING) ? qspi_io_sample_edge_falling
+                                                                 : qspi_io_sample_edge_rising;
+}
+
+static void setting_apply(qspi_flash_ctx_t *ctx, const qspi_flash_cal_setting_t *setting)
+{
+    qspi_io_ctx_t *qspi_io_ctx = &ctx->qspi_io_ctx;
+    const qspi_io_sample_edge_t edge = qspi_flash_cal_qspi_io_edge(setting);
+
+    if (qspi_io_ctx->full_speed_clk_divisor == setting->divisor &&
+        qspi_io_ctx->full_speed_sclk_sample_delay == setting->sample_delay &&
+        qspi_io_ctx->full_speed_sclk_sample_edge == edge &&
+        qspi_io_ctx->full_speed_sio_pad_delay == setting->pad_delay) {
+        return;
+    }
+
+    /* The clock block and port delays are only set up by the init */
+    qspi_flash_deinit(ctx);
+    qspi_io_ctx->full_speed_clk_divisor = setting->divisor;
+    qspi_io_ctx->full_speed_sclk_sample_delay = setting->sample_delay;
+    qspi_io_ctx->full_speed_sclk_sample_edge = edge;
+    qspi_io_ctx->full_speed_sio_pad_delay = setting->pad_delay;
+    qspi_flash_init(ctx);
+}
+
+int qspi_flash_cal_read(void *app_data, const qspi_flash_cal_setting_t *setting,
+                        unsigned addr, uint8_t *buf, size_t len)
+{
+    qspi_flash_ctx_t *ctx = app_data;
+
+    setting_apply(ctx, setting);
+    qspi_flash_read(ctx, buf, addr, len);
+    return 0;
+}
+
+void qspi_flash_cal_write(void *app_data, unsigned addr, const uint8_t *buf, size_t len)
+{
+    qspi_flash_ctx_t *ctx = app_data;
+
+    qspi_flash_write_enable(ctx);
+    qspi_flash_write(ctx, buf, addr, len);
+    qspi_flash_wait_while_write_in_progress(ctx);
+}
+
+void qspi_flash_cal_erase(void *app_data, unsigned addr, size_t len)
+{
+    qspi_flash_ctx_t *ctx = app_data;
+
+    (void) len;
+
+    /* The first erase type is the 4 KiB sector erase */
+    qspi_flash_write_enable(ctx);
+    qspi_flash_erase(ctx, addr, qspi_flash_erase_1);
+    qspi_flash_wait_while_write_in_progress(ctx);
+}
+
+uint32_t qspi_flash_cal_ticks(void *app_data)
+{
+    (void) app_data;
+
+    return get_reference_time();
+}
+
+int qspi_flash_cal_qspi_flash(qspi_flash_ctx_t *ctx,
+                              const qspi_flash_cal_config_t *config,
+                              qspi_flash_cal_result_t *result)
+{
+    qspi_flash_cal_config_t flash_config = *config;
+    uint32_t id = 0;
+    int ret;
+
+    qspi_flash_read_id(ctx, (uint8_t *) &id, 3);
+    flash_config.flash_id = id;
+
+    ret = qspi_flash_cal_run(&flash_config, ctx, result);
+    setting_apply(ctx, &result->setting);
+
+    return ret;
+}
@@ -0,0 +1,131 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SRC_FIR_KERNELS_H_
+#define SRC_FIR_KERNELS_H_
+
+/**
+ * \addtogroup src_fir_kernels src_fir_kernels
+ *
+ * Standalone host FIR kernels, shaped like the inner loops of the sample
+ * rate converters.
+ *
+ * On xcore the inner loops of the SSRC, ASRC and fixed factor of 3 filters
+ * accumulate 32 bit by 32 bit products into a 64 bit accumulator with the
+ * maccs instruction, and then saturate and extract a 32 bit result with
+ * lsats and lextract. The reference kernels here are a C model of that
+ * sequence. The SSE4.1 and AVX2 kernels form the same full 64 bit products
+ * and sum them with the same wrapping 64 bit arithmetic, so they give
+ * results that are bit exact with the reference whatever order the taps
+ * are summed in.
+ *
+ * The kernels are not yet integrated: no lib_src converter calls them, and
+ * they are only checked against the C model, not against the output of
+ * the converters.
+ *
+ * The generic functions dispatch to the fastest kernel that the host CPU
+ * supports, which may be overridden with src_fir_isa_set().
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+/**
+ * Kernel instruction sets.
+ */
+typedef enum {
+    SRC_FIR_ISA_C = 0,      /**< Portable C reference */
+    SRC_FIR_ISA_SSE41,      /**< x86 SSE4.1 */
+    SRC_FIR_ISA_AVX2,       /**< x86 AVX2 */
+    SRC_FIR_ISA_COUNT
+} src_fir_isa_t;
+
+/**
+ * Accumulates the dot product of \p n samples with \p n coefficients into a
+ * 64 bit accumulator, as a sequence of maccs instructions does.
+ *
+ * \param acc    The starting value of the accumulator
+ * \param x      The samples
+ * \param h      The coefficients
+ * \param n      The number of taps
+ *
+ * \return the accumulator
+ */
+typedef int64_t (*src_fir_dot_fn_t)(int64_t acc, const int32_t *x, const int32_t *h, unsigned n);
+
+/**
+ * Accumulates the dot products of \p n samples with two phases of a filter
+ * whose coefficients are interleaved, as the two times oversampling FIR
+ * does. acc[0] accumulates x[i] * h[2i] and acc[1] accumulates
+ * x[i] * h[2i + 1].
+ *
+ * \param acc    The two accumulators
+ * \param x      The samples
+ * \param h      The 2 * \p n interleaved coefficients
+ * \param n      The number of samples
+ */
+typedef void (*src_fir_dot2_fn_t)(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n);
+
+/**
+ * Saturates a 64 bit accumulator to 32 + \p shift bits and extracts bits
+ * \p shift to \p shift + 31, as lsats followed by lextract does.
+ *
+ * \param acc    The accumulator
+ * \param shift  The bit to extract from, 0 to 32
+ *
+ * \return the 32 bit result
+ */
+int32_t src_fir_extract(int64_t acc, unsigned shift);
+
+/** \copydoc src_fir_dot_fn_t */
+int64_t src_fir_dot(int64_t acc, const int32_t *x, const int32_t *h, unsigned n);
+
+/** \copydoc src_fir_dot2_fn_t */
+void src_fir_dot2(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n);
+
+/**
+ * Gets the dot product kernel for an instruction set.
+ *
+ * \return the kernel, or NULL if the instruction set is not built in
+ */
+src_fir_dot_fn_t src_fir_dot_kernel_get(src_fir_isa_t isa);
+
+/**
+ * Gets the interleaved two phase kernel for an instruction set.
+ *
+ * \return the kernel, or NULL if the instruction set is not built in
+ */
+src_fir_dot2_fn_t src_fir_dot2_kernel_get(src_fir_isa_t isa);
+
+/**
+ * Checks whether an instruction set is both built in and supported by the
+ * host CPU.
+ *
+ * \return non-zero if the kernels for \p isa can be used
+ */
+int src_fir_isa_supported(src_fir_isa_t isa);
+
+/**
+ * Selects the kernels used by src_fir_dot() and src_fir_dot2().
+ *
+ * \return 0 on success, or -1 if \p isa is not supported, in which case the
+ *         selection is unchanged
+ */
+int src_fir_isa_set(src_fir_isa_t isa);
+
+/**
+ * Gets the instruction set of the kernels used by src_fir_dot() and
+ * src_fir_dot2(). Until src_fir_isa_set() is called this is the fastest
+ * one supported.
+ */
+src_fir_isa_t src_fir_isa_get(void);
+
+/**
+ * Gets the name of an instruction set.
+ */
+const char *src_fir_isa_name(src_fir_isa_t isa);
+
+/**@}*/
+
+#endif /* SRC_FIR_KERNELS_H_ */
@@ -0,0 +1,160 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stddef.h>
+
+#include "src_fir_kernels.h"
+
+#if SRC_FIR_KERNELS_X86
+int64_t src_fir_dot_sse41(int64_t acc, const int32_t *x, const int32_t *h, unsigned n);
+void src_fir_dot2_sse41(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n);
+int64_t src_fir_dot_avx2(int64_t acc, const int32_t *x, const int32_t *h, unsigned n);
+void src_fir_dot2_avx2(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n);
+#endif
+
+/*
+ * maccs wraps modulo 2^64. The accumulation is done unsigned so that it
+ * wraps the same way in C without overflowing a signed type.
+ */
+static int64_t src_fir_dot_c(int64_t acc, const int32_t *x, const int32_t *h, unsigned n)
+{
+    uint64_t sum = (uint64_t) acc;
+
+    for (unsigned i = 0; i < n; i++) {
+        sum += (uint64_t) ((int64_t) x[i] * h[i]);
+    }
+
+    return (int64_t) sum;
+}
+
+static void src_fir_dot2_c(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n)
+{
+    uint64_t sum0 = (uint64_t) acc[0];
+    uint64_t sum1 = (uint64_t) acc[1];
+
+    for (unsigned i = 0; i < n; i++) {
+        sum0 += (uint64_t) ((int64_t) x[i] * h[2 * i]);
+        sum1 += (uint64_t) ((int64_t) x[i] * h[2 * i + 1]);
+    }
+
+    acc[0] = (int64_t) sum0;
+    acc[1] = (int64_t) sum1;
+}
+
+static const src_fir_dot_fn_t dot_kernels[SRC_FIR_ISA_COUNT] = {
+    [SRC_FIR_ISA_C] = src_fir_dot_c,
+#if SRC_FIR_KERNELS_X86
+    [SRC_FIR_ISA_SSE41] = src_fir_dot_sse41,
+    [SRC_FIR_ISA_AVX2] = src_fir_dot_avx2,
+#endif
+};
+
+static const src_fir_dot2_fn_t dot2_kernels[SRC_FIR_ISA_COUNT] = {
+    [SRC_FIR_ISA_C] = src_fir_dot2_c,
+#if SRC_FIR_KERNELS_X86
+    [SRC_FIR_ISA_SSE41] = src_fir_dot2_sse41,
+    [SRC_FIR_ISA_AVX2] = src_fir_dot2_avx2,
+#endif
+};
+
+static const char *const isa_names[SRC_FIR_ISA_COUNT] = {
+    [SRC_FIR_ISA_C] = "c",
+    [SRC_FIR_ISA_SSE41] = "sse4.1",
+    [SRC_FIR_ISA_AVX2] = "avx2",
+};
+
+/* Selected on first use. Every thread selects the same kernels, so the race is benign. */
+static src_fir_isa_t selected_isa = SRC_FIR_ISA_COUNT;
+static src_fir_dot_fn_t dot_kernel;
+static src_fir_dot2_fn_t dot2_kernel;
+
+int32_t src_fir_extract(int64_t acc, unsigned shift)
+{
+    if (shift < 32) {
+        const int64_t max = (int64_t) (((uint64_t) 1 << (31 + shift)) - 1);
+        const int64_t min = -max - 1;
+
+        if (acc > max) {
+            acc = max;
+        } else if (acc < min) {
+            acc = min;
+        }
+    }
+
+    return (int32_t) (acc >> shift);
+}
+
+int src_fir_isa_supported(src_fir_isa_t isa)
+{
+    switch (isa) {
+    case SRC_FIR_ISA_C:
+        return 1;
+#if SRC_FIR_KERNELS_X86
+    case SRC_FIR_ISA_SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case SRC_FIR_ISA_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+int src_fir_isa_set(src_fir_isa_t isa)
+{
+    if (!src_fir_isa_supported(isa)) {
+        return -1;
+    }
+
+    dot_kernel = dot_kernels[isa];
+    dot2_kernel = dot2_kernels[isa];
+    selected_isa = isa;
+
+    return 0;
+}
+
+src_fir_isa_t src_fir_isa_get(void)
+{
+    if (selected_isa == SRC_FIR_ISA_COUNT) {
+        int isa = SRC_FIR_ISA_COUNT - 1;
+
+        while (src_fir_isa_set((src_fir_isa_t) isa) != 0) {
+            isa--;
+        }
+    }
+
+    return selected_isa;
+}
+
+const char *src_fir_isa_name(src_fir_isa_t isa)
+{
+    return isa < SRC_FIR_ISA_COUNT ? isa_names[isa] : "unknown";
+}
+
+src_fir_dot_fn_t src_fir_dot_kernel_get(src_fir_isa_t isa)
+{
+    return isa < SRC_FIR_ISA_COUNT ? dot_kernels[isa] : NULL;
+}
+
+src_fir_dot2_fn_t src_fir_dot2_kernel_get(src_fir_isa_t isa)
+{
+    return isa < SRC_FIR_ISA_COUNT ? dot2_kernels[isa] : NULL;
+}
+
+int64_t src_fir_dot(int64_t acc, const int32_t *x, const int32_t *h, unsigned n)
+{
+    if (dot_kernel == NULL) {
+        (void) src_fir_isa_get();
+    }
+
+    return dot_kernel(acc, x, h, n);
+}
+
+void src_fir_dot2(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n)
+{
+    if (dot2_kernel == NULL) {
+        (void) src_fir_isa_get();
+    }
+
+    dot2_kernel(acc, x, h, n);
+}
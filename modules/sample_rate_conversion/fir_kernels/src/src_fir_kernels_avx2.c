@@ -0,0 +1,76 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include "src_fir_kernels.h"
+
+#if SRC_FIR_KERNELS_X86
+
+#include <immintrin.h>
+
+/*
+ * As the SSE4.1 kernels, with _mm256_mul_epi32() forming four full 64 bit
+ * products at a time.
+ */
+
+static uint64_t sum_lanes(__m256i v)
+{
+    uint64_t lane[4];
+
+    _mm256_storeu_si256((__m256i *) lane, v);
+
+    return lane[0] + lane[1] + lane[2] + lane[3];
+}
+
+int64_t src_fir_dot_avx2(int64_t acc, const int32_t *x, const int32_t *h, unsigned n)
+{
+    __m256i sum = _mm256_setzero_si256();
+    uint64_t total;
+    unsigned i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256i xv = _mm256_loadu_si256((const __m256i *) &x[i]);
+        const __m256i hv = _mm256_loadu_si256((const __m256i *) &h[i]);
+
+        sum = _mm256_add_epi64(sum, _mm256_mul_epi32(xv, hv));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epi32(_mm256_srli_epi64(xv, 32), _mm256_srli_epi64(hv, 32)));
+    }
+
+    total = (uint64_t) acc + sum_lanes(sum);
+    for (; i < n; i++) {
+        total += (uint64_t) ((int64_t) x[i] * h[i]);
+    }
+
+    return (int64_t) total;
+}
+
+void src_fir_dot2_avx2(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n)
+{
+    const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    uint64_t total0;
+    uint64_t total1;
+    unsigned i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128i xv = _mm_loadu_si128((const __m128i *) &x[i]);
+        /* {x0, x0, x1, x1, x2, x2, x3, x3} lines up with {h0, ..., h7} */
+        const __m256i xd = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(xv), dup);
+        const __m256i hv = _mm256_loadu_si256((const __m256i *) &h[2 * i]);
+
+        sum0 = _mm256_add_epi64(sum0, _mm256_mul_epi32(xd, hv));
+        sum1 = _mm256_add_epi64(sum1, _mm256_mul_epi32(_mm256_srli_epi64(xd, 32), _mm256_srli_epi64(hv, 32)));
+    }
+
+    total0 = (uint64_t) acc[0] + sum_lanes(sum0);
+    total1 = (uint64_t) acc[1] + sum_lanes(sum1);
+    for (; i < n; i++) {
+        total0 += (uint64_t) ((int64_t) x[i] * h[2 * i]);
+        total1 += (uint64_t) ((int64_t) x[i] * h[2 * i + 1]);
+    }
+
+    acc[0] = (int64_t) total0;
+    acc[1] = (int64_t) total1;
+}
+
+#endif /* SRC_FIR_KERNELS_X86 */
@@ -0,0 +1,80 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include "src_fir_kernels.h"
+
+#if SRC_FIR_KERNELS_X86
+
+#include <smmintrin.h>
+
+/*
+ * _mm_mul_epi32() multiplies the signed low words of each 64 bit lane into
+ * a full 64 bit product, as maccs does. The odd words are shifted down into
+ * the low words for a second multiply.
+ */
+
+static uint64_t sum_lanes(__m128i v)
+{
+    uint64_t lane[2];
+
+    _mm_storeu_si128((__m128i *) lane, v);
+
+    return lane[0] + lane[1];
+}
+
+int64_t src_fir_dot_sse41(int64_t acc, const int32_t *x, const int32_t *h, unsigned n)
+{
+    __m128i sum = _mm_setzero_si128();
+    uint64_t total;
+    unsigned i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128i xv = _mm_loadu_si128((const __m128i *) &x[i]);
+        const __m128i hv = _mm_loadu_si128((const __m128i *) &h[i]);
+
+        sum = _mm_add_epi64(sum, _mm_mul_epi32(xv, hv));
+        sum = _mm_add_epi64(sum, _mm_mul_epi32(_mm_srli_epi64(xv, 32), _mm_srli_epi64(hv, 32)));
+    }
+
+    total = (uint64_t) acc + sum_lanes(sum);
+    for (; i < n; i++) {
+        total += (uint64_t) ((int64_t) x[i] * h[i]);
+    }
+
+    return (int64_t) total;
+}
+
+void src_fir_dot2_sse41(int64_t acc[2], const int32_t *x, const int32_t *h, unsigned n)
+{
+    __m128i sum0 = _mm_setzero_si128();
+    __m128i sum1 = _mm_setzero_si128();
+    uint64_t total0;
+    uint64_t total1;
+    unsigned i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128i xv = _mm_loadu_si128((const __m128i *) &x[i]);
+        /* {x0, x0, x1, x1} and {x2, x2, x3, x3} line up with {h0, h1, h2, h3} and {h4, h5, h6, h7} */
+        const __m128i xlo = _mm_unpacklo_epi32(xv, xv);
+        const __m128i xhi = _mm_unpackhi_epi32(xv, xv);
+        const __m128i hlo = _mm_loadu_si128((const __m128i *) &h[2 * i]);
+        const __m128i hhi = _mm_loadu_si128((const __m128i *) &h[2 * i + 4]);
+
+        sum0 = _mm_add_epi64(sum0, _mm_mul_epi32(xlo, hlo));
+        sum0 = _mm_add_epi64(sum0, _mm_mul_epi32(xhi, hhi));
+        sum1 = _mm_add_epi64(sum1, _mm_mul_epi32(_mm_srli_epi64(xlo, 32), _mm_srli_epi64(hlo, 32)));
+        sum1 = _mm_add_epi64(sum1, _mm_mul_epi32(_mm_srli_epi64(xhi, 32), _mm_srli_epi64(hhi, 32)));
+    }
+
+    total0 = (uint64_t) acc[0] + sum_lanes(sum0);
+    total1 = (uint64_t) acc[1] + sum_lanes(sum1);
+    for (; i < n; i++) {
+        total0 += (uint64_t) ((int64_t) x[i] * h[2 * i]);
+        total1 += (uint64_t) ((int64_t) x[i] * h[2 * i + 1]);
+    }
+
+    acc[0] = (int64_t) total0;
+    acc[1] = (int64_t) total1;
+}
+
+#endif /* SRC_FIR_KERNELS_X86 */
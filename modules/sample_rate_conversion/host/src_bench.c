@@ -0,0 +1,315 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Sample rate conversion host benchmark.
+ *
+ * First checks that every SIMD FIR kernel the host supports is bit exact
+ * with the C model of the xcore inner loops, over random lengths and data
+ * that includes full scale values, so that the 64 bit accumulator wraps.
+ * Exits with an error if any result differs. The kernels are standalone,
+ * so this compares them with the model only, not with converter output.
+ *
+ * Then reports the throughput of each kernel for filter lengths used by the
+ * converters and, when the lib_src submodule is checked out, the throughput
+ * of the SSRC and ASRC converters for each rate pair and channel count, in
+ * input samples per second and as a multiple of real time. The converters
+ * run their own C FIR loops, not these kernels.
+ *
+ * Times are CPU time, so run on an idle machine for stable results.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src_fir_kernels.h"
+
+#if SRC_BENCH_LIB_SRC
+#include "src.h"
+#endif
+
+#define VERIFY_RUNS         2000
+#define VERIFY_MAX_TAPS     257
+
+#define KERNEL_BENCH_S      0.2
+#define CONVERTER_BENCH_S   0.5
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    /* xorshift32 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Mostly random words, with runs of full scale values to force the accumulator to wrap */
+static void fill(int32_t *buf, unsigned n)
+{
+    const int full_scale = (rng() & 3) == 0;
+
+    for (unsigned i = 0; i < n; i++) {
+        if (full_scale) {
+            buf[i] = (rng() & 1) ? INT32_MIN : INT32_MAX;
+        } else {
+            buf[i] = (int32_t) rng();
+        }
+    }
+}
+
+static double seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int verify(void)
+{
+    static int32_t x[VERIFY_MAX_TAPS];
+    static int32_t h[2 * VERIFY_MAX_TAPS];
+    const src_fir_dot_fn_t ref_dot = src_fir_dot_kernel_get(SRC_FIR_ISA_C);
+    const src_fir_dot2_fn_t ref_dot2 = src_fir_dot2_kernel_get(SRC_FIR_ISA_C);
+    int failures = 0;
+
+    for (int isa = SRC_FIR_ISA_C + 1; isa < SRC_FIR_ISA_COUNT; isa++) {
+        const src_fir_dot_fn_t dot = src_fir_dot_kernel_get(isa);
+        const src_fir_dot2_fn_t dot2 = src_fir_dot2_kernel_get(isa);
+        int isa_failures = 0;
+
+        if (!src_fir_isa_supported(isa)) {
+            printf("%-8s not supported, skipped\n", src_fir_isa_name(isa));
+            continue;
+        }
+
+        for (int run = 0; run < VERIFY_RUNS; run++) {
+            const unsigned n = rng() % (VERIFY_MAX_TAPS + 1);
+            const int64_t acc = ((int64_t) (int32_t) rng() << 32) | rng();
+            int64_t ref2[2] = {acc, ~acc};
+            int64_t out2[2] = {acc, ~acc};
+
+            fill(x, n);
+            fill(h, 2 * n);
+
+            if (dot(acc, x, h, n) != ref_dot(acc, x, h, n)) {
+                isa_failures++;
+            }
+
+            ref_dot2(ref2, x, h, n);
+            dot2(out2, x, h, n);
+            if (out2[0] != ref2[0] || out2[1] != ref2[1]) {
+                isa_failures++;
+            }
+        }
+
+        printf("%-8s %s (%d runs)\n", src_fir_isa_name(isa),
+               isa_failures ? "MISMATCH" : "bit exact", VERIFY_RUNS);
+        failures += isa_failures;
+    }
+
+    return failures;
+}
+
+static void kernel_bench(void)
+{
+    static const unsigned taps[] = {32, 64, 144, 512, 1024};
+    static int32_t x[1024];
+    static int32_t h[2 * 1024];
+    double c_rate[sizeof(taps) / sizeof(taps[0])][2];
+
+    fill(x, 1024);
+    fill(h, 2 * 1024);
+
+    printf("\n%-8s %6s %14s %14s\n", "kernel", "taps", "dot Mtap/s", "dot2 Mtap/s");
+
+    for (int isa = SRC_FIR_ISA_C; isa < SRC_FIR_ISA_COUNT; isa++) {
+        const src_fir_dot_fn_t dot = src_fir_dot_kernel_get(isa);
+        const src_fir_dot2_fn_t dot2 = src_fir_dot2_kernel_get(isa);
+
+        if (!src_fir_isa_supported(isa)) {
+            continue;
+        }
+
+        for (size_t t = 0; t < sizeof(taps) / sizeof(taps[0]); t++) {
+            const unsigned n = taps[t];
+            volatile int64_t sink = 0;
+            int64_t acc2[2] = {0, 0};
+            double rate[2];
+            unsigned long calls;
+            clock_t start;
+
+            calls = 0;
+            start = clock();
+            do {
+                for (int i = 0; i < 1000; i++) {
+                    sink += dot(sink, x, h, n);
+                }
+                calls += 1000;
+            } while (seconds(start) < KERNEL_BENCH_S);
+            rate[0] = (double) calls * n / seconds(start) / 1e6;
+
+            calls = 0;
+            start = clock();
+            do {
+                for (int i = 0; i < 1000; i++) {
+                    dot2(acc2, x, h, n);
+                }
+                calls += 1000;
+            } while (seconds(start) < KERNEL_BENCH_S);
+            rate[1] = (double) calls * 2 * n / seconds(start) / 1e6;
+            sink += acc2[0] + acc2[1];
+
+            if (isa == SRC_FIR_ISA_C) {
+                c_rate[t][0] = rate[0];
+                c_rate[t][1] = rate[1];
+                printf("%-8s %6u %14.1f %14.1f\n", src_fir_isa_name(isa), n, rate[0], rate[1]);
+            } else {
+                printf("%-8s %6u %8.1f x%4.1f %8.1f x%4.1f\n", src_fir_isa_name(isa), n,
+                       rate[0], rate[0] / c_rate[t][0], rate[1], rate[1] / c_rate[t][1]);
+            }
+        }
+    }
+}
+
+#if SRC_BENCH_LIB_SRC
+
+#define BLOCK_FRAMES        4
+#define MAX_CHANNELS        8
+#define MAX_OUT_FRAMES      (BLOCK_FRAMES * 5)
+
+typedef struct {
+    fs_code_t code;
+    unsigned rate;
+} bench_rate_t;
+
+static const bench_rate_t rates[] = {
+    {FS_CODE_44, 44100},
+    {FS_CODE_48, 48000},
+    {FS_CODE_88, 88200},
+    {FS_CODE_96, 96000},
+    {FS_CODE_176, 176400},
+    {FS_CODE_192, 192000},
+};
+
+static const struct {
+    int in;
+    int out;
+} rate_pairs[] = {
+    {0, 1}, {1, 0}, {1, 3}, {3, 1}, {1, 5}, {5, 1}, {2, 3},
+};
+
+static const unsigned channel_counts[] = {1, 2, 8};
+
+static int32_t in_buf[BLOCK_FRAMES * MAX_CHANNELS];
+static int32_t out_buf[MAX_OUT_FRAMES * MAX_CHANNELS];
+
+static void report(const char *name, const bench_rate_t *in, const bench_rate_t *out,
+                   unsigned channels, unsigned long frames, double elapsed)
+{
+    const double samples_per_s = (double) frames * channels / elapsed;
+
+    printf("%-5s %6u -> %6u %3u ch %12.0f %9.1f\n", name, in->rate, out->rate, channels,
+           samples_per_s, samples_per_s / ((double) in->rate * channels));
+}
+
+static void ssrc_bench(const bench_rate_t *in, const bench_rate_t *out, unsigned channels)
+{
+    static ssrc_state_t state[MAX_CHANNELS];
+    static int stack[MAX_CHANNELS][SSRC_STACK_LENGTH_MULT * BLOCK_FRAMES];
+    static ssrc_ctrl_t ctrl[MAX_CHANNELS];
+    unsigned long frames = 0;
+    clock_t start;
+
+    for (unsigned ch = 0; ch < channels; ch++) {
+        ctrl[ch].psState = &state[ch];
+        ctrl[ch].piStack = stack[ch];
+    }
+    ssrc_init(in->code, out->code, ctrl, channels, BLOCK_FRAMES, OFF);
+
+    start = clock();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            (void) ssrc_process((int *) in_buf, (int *) out_buf, ctrl);
+        }
+        frames += 1000 * BLOCK_FRAMES;
+    } while (seconds(start) < CONVERTER_BENCH_S);
+
+    report("ssrc", in, out, channels, frames, seconds(start));
+}
+
+static void asrc_bench(const bench_rate_t *in, const bench_rate_t *out, unsigned channels)
+{
+    static asrc_state_t state[MAX_CHANNELS];
+    static int stack[MAX_CHANNELS][ASRC_STACK_LENGTH_MULT * BLOCK_FRAMES];
+    static asrc_ctrl_t ctrl[MAX_CHANNELS];
+    static asrc_adfir_coefs_t adfir_coefs;
+    unsigned long frames = 0;
+    unsigned nominal_ratio;
+    clock_t start;
+
+    for (unsigned ch = 0; ch < channels; ch++) {
+        ctrl[ch].psState = &state[ch];
+        ctrl[ch].piStack = stack[ch];
+        ctrl[ch].piADCoefs = adfir_coefs.iASRCADFIRCoefs;
+    }
+    nominal_ratio = asrc_init(in->code, out->code, ctrl, channels, BLOCK_FRAMES, OFF);
+
+    start = clock();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            (void) asrc_process((int *) in_buf, (int *) out_buf, nominal_ratio, ctrl);
+        }
+        frames += 1000 * BLOCK_FRAMES;
+    } while (seconds(start) < CONVERTER_BENCH_S);
+
+    report("asrc", in, out, channels, frames, seconds(start));
+}
+
+static void converter_bench(void)
+{
+    fill(in_buf, BLOCK_FRAMES * MAX_CHANNELS);
+    for (size_t i = 0; i < BLOCK_FRAMES * MAX_CHANNELS; i++) {
+        in_buf[i] >>= 1;
+    }
+
+    printf("\n%-5s %16s %6s %12s %9s\n", "conv", "rates", "", "samples/s", "realtime");
+
+    for (size_t p = 0; p < sizeof(rate_pairs) / sizeof(rate_pairs[0]); p++) {
+        for (size_t c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+            ssrc_bench(&rates[rate_pairs[p].in], &rates[rate_pairs[p].out], channel_counts[c]);
+        }
+    }
+    for (size_t p = 0; p < sizeof(rate_pairs) / sizeof(rate_pairs[0]); p++) {
+        for (size_t c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+            asrc_bench(&rates[rate_pairs[p].in], &rates[rate_pairs[p].out], channel_counts[c]);
+        }
+    }
+}
+
+#endif /* SRC_BENCH_LIB_SRC */
+
+int main(int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    printf("Default kernels: %s\n\n", src_fir_isa_name(src_fir_isa_get()));
+
+    if (verify() != 0) {
+        printf("FAIL: SIMD kernels differ from the reference\n");
+        return EXIT_FAILURE;
+    }
+
+    kernel_bench();
+
+#if SRC_BENCH_LIB_SRC
+    converter_bench();
+#else
+    printf("\nlib_src not found, converter benchmarks skipped\n");
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * ASRC rate estimator simulation.
+ *
+ * Models a USB audio speaker stream bridged to a device clock by an ASRC.
+ * The host delivers one packet per millisecond of its own clock into a FIFO,
+ * and the device task takes one period per millisecond of the device clock
+ * from it through an ideal ASRC running at the ratio the estimator returns.
+ * Both clocks may drift from nominal. Packets arrive late by a random
+ * amount, as USB bus and interrupt latency would delay them, and the device
+ * task's timestamps are jittered as its wakeups would be. The timer starts
+ * shortly before it wraps.
+ *
+ * For each scenario, reports the time to gain lock, the time to regain it
+ * after losing it to a disturbance, the largest excursion of the
+ * compensated FIFO level from its target since lock was last gained, and the error of the final ratio from the true ratio.
+ * Exits with an error if any scenario fails to lock, is not locked at the
+ * end, or over or underruns its FIFO.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src_rate_est.h"
+
+#define TIMER_HZ            100000000
+#define TIMER_START_S       40.0        /* The 32 bit timer wraps at 42.9 s */
+
+#define SIM_S               60.0
+#define PERIOD_S            0.001
+#define FIFO_FRAMES         1024
+#define TARGET_FRAMES       (FIFO_FRAMES / 2)
+
+#define LOCK_WITHIN_S       20.0
+#define RATIO_AVERAGE_S     10.0
+#define RATIO_ERROR_MAX_PPM 5.0
+
+typedef struct {
+    const char *name;
+    uint32_t in_rate;
+    uint32_t out_rate;
+    double in_ppm;          /* Host clock error */
+    double out_ppm;         /* Device clock error */
+    double jitter_us;       /* Peak timestamp jitter */
+    double step_ppm;        /* Host clock step, half way through */
+    unsigned gap_packets;   /* Host packets dropped, a quarter of the way through */
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"nominal",               48000, 48000,    0,    0,   0,    0,  0},
+    {"host +100 ppm",         48000, 48000,  100,    0,   0,    0,  0},
+    {"host -100 ppm",         48000, 48000, -100,    0,   0,    0,  0},
+    {"host +500 ppm",         48000, 48000,  500,    0,   0,    0,  0},
+    {"host -500 ppm",         48000, 48000, -500,    0,   0,    0,  0},
+    {"both drift",            48000, 48000,  300, -200,   0,    0,  0},
+    {"jitter 50 us",          48000, 48000,  100,    0,  50,    0,  0},
+    {"jitter 100 us",         48000, 48000, -250,   50, 100,    0,  0},
+    {"44.1k to 48k",          44100, 48000,  200,  -30,  50,    0,  0},
+    {"96k to 48k",            96000, 48000, -150,   20,  50,    0,  0},
+    {"step +200 ppm",         48000, 48000,  -50,    0,  50,  200,  0},
+    {"gap of 4 packets",      48000, 48000,  100,    0,  50,    0,  4},
+};
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    /* xorshift32 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* A random delay of up to jitter_us */
+static double late(double jitter_us)
+{
+    return jitter_us * 1e-6 * (rng() / 4294967296.0);
+}
+
+/* Timer ticks at true time t */
+static uint32_t timestamp(double t)
+{
+    return (uint32_t) (uint64_t) llround((TIMER_START_S + t) * TIMER_HZ);
+}
+
+static int run(const scenario_t *s)
+{
+    src_rate_est_config_t config;
+    src_rate_est_t est;
+    src_rate_est_stats_t stats;
+    const uint32_t nominal = (uint32_t) (((uint64_t) s->in_rate << 28) / s->out_rate);
+    double in_ppm = s->in_ppm;
+    double t_in = 0;
+    double t_arrive = late(s->jitter_us);
+    double t_out = 0;
+    double level = TARGET_FRAMES;
+    double ratio_err_sum = 0;
+    unsigned ratio_err_n = 0;
+    uint32_t in_acc = 0;
+    uint32_t out_acc = 0;
+    uint32_t ratio = nominal;
+    unsigned packet = 0;
+    unsigned gap_left = 0;
+    int stepped = 0;
+    double first_lock_s = -1;
+    double relock_s = -1;
+    double disturb_s = -1;
+    int was_locked = 0;
+    int failed = 0;
+
+    src_rate_est_config_default(&config, nominal, s->in_rate, s->out_rate, TIMER_HZ, TARGET_FRAMES);
+    src_rate_est_init(&est, &config);
+
+    while (t_out < SIM_S) {
+        if (t_arrive <= t_out) {
+            /* A host packet of nominal length, once per millisecond of the host clock */
+            const unsigned frames = (in_acc + s->in_rate) / 1000;
+
+            in_acc = (in_acc + s->in_rate) % 1000;
+
+            if (!stepped && s->step_ppm != 0 && t_in >= SIM_S / 2) {
+                stepped = 1;
+                in_ppm += s->step_ppm;
+                disturb_s = t_in;
+            }
+            if (s->gap_packets && packet == (unsigned) (SIM_S / 4 / PERIOD_S)) {
+                gap_left = s->gap_packets;
+                disturb_s = t_in;
+            }
+
+            if (gap_left) {
+                gap_left--;
+            } else {
+                level += frames;
+                src_rate_est_in_timestamp(&est, frames, timestamp(t_arrive));
+            }
+
+            packet++;
+            t_in += PERIOD_S / (1 + in_ppm * 1e-6);
+            t_arrive = t_in + late(s->jitter_us);
+        } else {
+            /* A device period, pulled through the ASRC, once per millisecond of the device clock */
+            const unsigned frames = (out_acc + s->out_rate) / 1000;
+            const double true_ratio = (s->in_rate * (1 + in_ppm * 1e-6)) / (s->out_rate * (1 + s->out_ppm * 1e-6));
+            const uint32_t now = timestamp(t_out + late(s->jitter_us));
+
+            out_acc = (out_acc + s->out_rate) % 1000;
+
+            level -= frames * (ratio / 268435456.0);
+            src_rate_est_out_timestamp(&est, frames, now);
+
+            if (level < 0 || level > FIFO_FRAMES) {
+                printf("  %s: FIFO %s at %.3f s\n", s->name, level < 0 ? "underrun" : "overrun", t_out);
+                return 1;
+            }
+
+            /* The ASRC reads whole frames from the FIFO */
+            ratio = src_rate_est_update(&est, (int32_t) level << 8, now);
+
+            if (src_rate_est_locked(&est) && !was_locked) {
+                if (first_lock_s < 0) {
+                    first_lock_s = t_out;
+                } else if (disturb_s >= 0) {
+                    relock_s = t_out - disturb_s;
+                }
+            }
+            was_locked = src_rate_est_locked(&est);
+
+            if (t_out >= SIM_S - RATIO_AVERAGE_S) {
+                ratio_err_sum += (ratio / 268435456.0) / true_ratio - 1;
+                ratio_err_n++;
+            }
+
+            t_out += PERIOD_S / (1 + s->out_ppm * 1e-6);
+        }
+    }
+
+    src_rate_est_stats_get(&est, &stats);
+
+    {
+        const double ratio_err_ppm = ratio_err_sum / ratio_err_n * 1e6;
+
+        printf("%-18s %9.3f", s->name, first_lock_s);
+        if (relock_s >= 0) {
+            printf(" %9.3f", relock_s);
+        } else {
+            printf(" %9s", "-");
+        }
+        printf(" %10.2f %10.3f %9.1f %7u %7u\n",
+               stats.max_error_q8 / 256.0, ratio_err_ppm, stats.drift_ppb / 1000.0, stats.lock_losses, stats.dll_resets);
+
+        if (first_lock_s < 0 || first_lock_s > LOCK_WITHIN_S) {
+            printf("  %s: did not lock within %.0f s\n", s->name, LOCK_WITHIN_S);
+            failed = 1;
+        }
+        if (!src_rate_est_locked(&est)) {
+            printf("  %s: not locked at the end\n", s->name);
+            failed = 1;
+        }
+        if (fabs(ratio_err_ppm) > RATIO_ERROR_MAX_PPM) {
+            printf("  %s: final ratio error over %.0f ppm\n", s->name, RATIO_ERROR_MAX_PPM);
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+
+    (void) argc;
+    (void) argv;
+
+    printf("%-18s %9s %9s %10s %10s %9s %7s %7s\n",
+           "scenario", "lock (s)", "relock", "excursion", "ratio ppm", "drift", "losses", "resets");
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        failures += run(&scenarios[i]);
+    }
+
+    if (failures) {
+        printf("%d scenario(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All scenarios passed\n");
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SRC_MC_H_
+#define SRC_MC_H_
+
+/**
+ * \addtogroup src_mc src_mc
+ *
+ * Multi-channel batched SSRC and ASRC processing.
+ *
+ * Running each channel through its own single channel lib_src instance
+ * repeats the per block work of the converter for every channel: updating
+ * the rate ratio and, for the ASRC, generating the adaptive filter
+ * coefficients for every output sample. A multi-channel converter runs all
+ * of its channels in one lib_src instance, so this work is done once per
+ * block and the coefficients are shared by all the channels, leaving only
+ * the filter MACs to be repeated per channel.
+ *
+ * Blocks may be passed interleaved, as lib_src takes them, or channel
+ * major, with each channel's frames contiguous. A call processes any whole
+ * number of lib_src blocks of SRC_MC_BLOCK_FRAMES frames.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src.h"
+
+/**
+ * The most channels a multi-channel converter may have.
+ */
+#ifndef SRC_MC_MAX_CHANNELS
+#define SRC_MC_MAX_CHANNELS 16
+#endif
+
+/**
+ * The number of input frames in each block passed to lib_src.
+ */
+#ifndef SRC_MC_BLOCK_FRAMES
+#define SRC_MC_BLOCK_FRAMES 4
+#endif
+
+/**
+ * The most output frames that one block of input can produce, at the
+ * largest conversion ratio of 44.1 kHz to 192 kHz.
+ */
+#define SRC_MC_BLOCK_OUT_FRAMES_MAX (SRC_MC_BLOCK_FRAMES * 5)
+
+/**
+ * The output capacity, in frames per channel, that guarantees room for the
+ * output of \p in_frames input frames.
+ */
+#define SRC_MC_OUT_FRAMES_MAX(in_frames) (((in_frames) / SRC_MC_BLOCK_FRAMES) * SRC_MC_BLOCK_OUT_FRAMES_MAX)
+
+/**
+ * Sample buffer layouts.
+ */
+typedef enum {
+    SRC_MC_INTERLEAVED = 0,  /**< Frame by frame, channel 0 first in each frame */
+    SRC_MC_CHANNEL_MAJOR,    /**< Channel by channel, with a fixed stride between channels */
+} src_mc_layout_t;
+
+/**
+ * Typedef to the multi-channel SSRC instance struct.
+ */
+typedef struct src_mc_ssrc_struct src_mc_ssrc_t;
+
+/**
+ * Struct representing a multi-channel SSRC instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct src_mc_ssrc_struct {
+    unsigned n_channels;
+    src_mc_layout_t layout;
+
+    ssrc_ctrl_t ctrl[SRC_MC_MAX_CHANNELS];
+    ssrc_state_t state[SRC_MC_MAX_CHANNELS];
+    int stack[SRC_MC_MAX_CHANNELS][SSRC_STACK_LENGTH_MULT * SRC_MC_BLOCK_FRAMES];
+
+    int32_t in[SRC_MC_MAX_CHANNELS * SRC_MC_BLOCK_FRAMES];
+    int32_t out[SRC_MC_MAX_CHANNELS * SRC_MC_BLOCK_OUT_FRAMES_MAX];
+};
+
+/**
+ * Typedef to the multi-channel ASRC instance struct.
+ */
+typedef struct src_mc_asrc_struct src_mc_asrc_t;
+
+/**
+ * Struct representing a multi-channel ASRC instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct src_mc_asrc_struct {
+    unsigned n_channels;
+    src_mc_layout_t layout;
+    unsigned nominal_ratio;
+
+    asrc_ctrl_t ctrl[SRC_MC_MAX_CHANNELS];
+    asrc_state_t state[SRC_MC_MAX_CHANNELS];
+    int stack[SRC_MC_MAX_CHANNELS][ASRC_STACK_LENGTH_MULT * SRC_MC_BLOCK_FRAMES];
+    asrc_adfir_coefs_t adfir_coefs;
+
+    int32_t in[SRC_MC_MAX_CHANNELS * SRC_MC_BLOCK_FRAMES];
+    int32_t out[SRC_MC_MAX_CHANNELS * SRC_MC_BLOCK_OUT_FRAMES_MAX];
+};
+
+/**
+ * Initializes a multi-channel SSRC instance.
+ *
+ * \param ctx         A pointer to the instance
+ * \param fs_in       The input sample rate
+ * \param fs_out      The output sample rate
+ * \param n_channels  The number of channels, 1 to SRC_MC_MAX_CHANNELS
+ * \param layout      The layout of the input and output buffers
+ * \param dither      Whether to dither the output to 24 bits
+ *
+ * \return 0 on success, or -1 if \p n_channels is out of range
+ */
+int src_mc_ssrc_init(src_mc_ssrc_t *ctx,
+                     fs_code_t fs_in,
+                     fs_code_t fs_out,
+                     unsigned n_channels,
+                     src_mc_layout_t layout,
+                     dither_flag_t dither);
+
+/**
+ * Converts a batch of frames on all channels.
+ *
+ * With the SRC_MC_CHANNEL_MAJOR layout, channel c of the input starts at
+ * in[c * in_frames] and channel c of the output at out[c * out_stride].
+ *
+ * \param ctx         A pointer to the instance
+ * \param in          The input frames
+ * \param in_frames   The number of input frames per channel. Must be a
+ *                    multiple of SRC_MC_BLOCK_FRAMES.
+ * \param out         Receives the output frames. Must have room for
+ *                    SRC_MC_OUT_FRAMES_MAX(in_frames) frames per channel.
+ * \param out_stride  The distance between channels in the output, in
+ *                    samples, for the SRC_MC_CHANNEL_MAJOR layout. Ignored
+ *                    for the SRC_MC_INTERLEAVED layout.
+ *
+ * \return the number of output frames per channel
+ */
+size_t src_mc_ssrc_process(src_mc_ssrc_t *ctx,
+                           const int32_t *in,
+                           size_t in_frames,
+                           int32_t *out,
+                           size_t out_stride);
+
+/**
+ * Initializes a multi-channel ASRC instance.
+ *
+ * \param ctx         A pointer to the instance
+ * \param fs_in       The nominal input sample rate
+ * \param fs_out      The nominal output sample rate
+ * \param n_channels  The number of channels, 1 to SRC_MC_MAX_CHANNELS
+ * \param layout      The layout of the input and output buffers
+ * \param dither      Whether to dither the output to 24 bits
+ *
+ * \return 0 on success, or -1 if \p n_channels is out of range
+ */
+int src_mc_asrc_init(src_mc_asrc_t *ctx,
+                     fs_code_t fs_in,
+                     fs_code_t fs_out,
+                     unsigned n_channels,
+                     src_mc_layout_t layout,
+                     dither_flag_t dither);
+
+/**
+ * Gets the nominal ratio of the input rate to the output rate, in the
+ * fixed point format taken by src_mc_asrc_process().
+ */
+unsigned src_mc_asrc_nominal_ratio_get(const src_mc_asrc_t *ctx);
+
+/**
+ * Converts a batch of frames on all channels at one rate ratio.
+ *
+ * \param ctx         A pointer to the instance
+ * \param in          The input frames, laid out as for src_mc_ssrc_process()
+ * \param in_frames   The number of input frames per channel. Must be a
+ *                    multiple of SRC_MC_BLOCK_FRAMES.
+ * \param out         Receives the output frames. Must have room for
+ *                    SRC_MC_OUT_FRAMES_MAX(in_frames) frames per channel.
+ * \param out_stride  The distance between channels in the output, in
+ *                    samples, for the SRC_MC_CHANNEL_MAJOR layout
+ * \param fs_ratio    The ratio of the input rate to the output rate, as
+ *                    returned by src_mc_asrc_nominal_ratio_get() and
+ *                    adjusted to track the actual rates
+ *
+ * \return the number of output frames per channel
+ */
+size_t src_mc_asrc_process(src_mc_asrc_t *ctx,
+                           const int32_t *in,
+                           size_t in_frames,
+                           int32_t *out,
+                           size_t out_stride,
+                           unsigned fs_ratio);
+
+/**@}*/
+
+#endif /* SRC_MC_H_ */
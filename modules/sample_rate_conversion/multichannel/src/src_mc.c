@@ -0,0 +1,153 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "src_mc.h"
+
+/* Interleaves one block of channel major input */
+static void block_interleave(int32_t *dst,
+                             const int32_t *src,
+                             size_t src_stride,
+                             unsigned n_channels)
+{
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        const int32_t *s = &src[ch * src_stride];
+
+        for (unsigned i = 0; i < SRC_MC_BLOCK_FRAMES; i++) {
+            dst[i * n_channels + ch] = s[i];
+        }
+    }
+}
+
+/* De-interleaves n_frames of block output to channel major output */
+static void block_deinterleave(int32_t *dst,
+                               size_t dst_stride,
+                               const int32_t *src,
+                               unsigned n_frames,
+                               unsigned n_channels)
+{
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        int32_t *d = &dst[ch * dst_stride];
+
+        for (unsigned i = 0; i < n_frames; i++) {
+            d[i] = src[i * n_channels + ch];
+        }
+    }
+}
+
+int src_mc_ssrc_init(src_mc_ssrc_t *ctx,
+                     fs_code_t fs_in,
+                     fs_code_t fs_out,
+                     unsigned n_channels,
+                     src_mc_layout_t layout,
+                     dither_flag_t dither)
+{
+    if (n_channels == 0 || n_channels > SRC_MC_MAX_CHANNELS) {
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->n_channels = n_channels;
+    ctx->layout = layout;
+
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        ctx->ctrl[ch].psState = &ctx->state[ch];
+        ctx->ctrl[ch].piStack = ctx->stack[ch];
+    }
+
+    /* One instance for all channels, so that the per block work is done once */
+    ssrc_init(fs_in, fs_out, ctx->ctrl, n_channels, SRC_MC_BLOCK_FRAMES, dither);
+
+    return 0;
+}
+
+size_t src_mc_ssrc_process(src_mc_ssrc_t *ctx,
+                           const int32_t *in,
+                           size_t in_frames,
+                           int32_t *out,
+                           size_t out_stride)
+{
+    const unsigned n_channels = ctx->n_channels;
+    size_t out_frames = 0;
+
+    for (size_t frame = 0; frame < in_frames; frame += SRC_MC_BLOCK_FRAMES) {
+        unsigned n;
+
+        if (ctx->layout == SRC_MC_INTERLEAVED) {
+            n = ssrc_process((int *) &in[frame * n_channels],
+                             (int *) &out[out_frames * n_channels],
+                             ctx->ctrl);
+        } else {
+            block_interleave(ctx->in, &in[frame], in_frames, n_channels);
+            n = ssrc_process((int *) ctx->in, (int *) ctx->out, ctx->ctrl);
+            block_deinterleave(&out[out_frames], out_stride, ctx->out, n, n_channels);
+        }
+
+        out_frames += n;
+    }
+
+    return out_frames;
+}
+
+int src_mc_asrc_init(src_mc_asrc_t *ctx,
+                     fs_code_t fs_in,
+                     fs_code_t fs_out,
+                     unsigned n_channels,
+                     src_mc_layout_t layout,
+                     dither_flag_t dither)
+{
+    if (n_channels == 0 || n_channels > SRC_MC_MAX_CHANNELS) {
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->n_channels = n_channels;
+    ctx->layout = layout;
+
+    /* The adaptive filter coefficients are generated once per output sample and shared by every channel */
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        ctx->ctrl[ch].psState = &ctx->state[ch];
+        ctx->ctrl[ch].piStack = ctx->stack[ch];
+        ctx->ctrl[ch].piADCoefs = ctx->adfir_coefs.iASRCADFIRCoefs;
+    }
+
+    ctx->nominal_ratio = asrc_init(fs_in, fs_out, ctx->ctrl, n_channels, SRC_MC_BLOCK_FRAMES, dither);
+
+    return 0;
+}
+
+unsigned src_mc_asrc_nominal_ratio_get(const src_mc_asrc_t *ctx)
+{
+    return ctx->nominal_ratio;
+}
+
+size_t src_mc_asrc_process(src_mc_asrc_t *ctx,
+                           const int32_t *in,
+                           size_t in_frames,
+                           int32_t *out,
+                           size_t out_stride,
+                           unsigned fs_ratio)
+{
+    const unsigned n_channels = ctx->n_channels;
+    size_t out_frames = 0;
+
+    for (size_t frame = 0; frame < in_frames; frame += SRC_MC_BLOCK_FRAMES) {
+        unsigned n;
+
+        if (ctx->layout == SRC_MC_INTERLEAVED) {
+            n = asrc_process((int *) &in[frame * n_channels],
+                             (int *) &out[out_frames * n_channels],
+                             fs_ratio,
+                             ctx->ctrl);
+        } else {
+            block_interleave(ctx->in, &in[frame], in_frames, n_channels);
+            n = asrc_process((int *) ctx->in, (int *) ctx->out, fs_ratio, ctx->ctrl);
+            block_deinterleave(&out[out_frames], out_stride, ctx->out, n, n_channels);
+        }
+
+        out_frames += n;
+    }
+
+    return out_frames;
+}
@@ -0,0 +1,204 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SRC_RATE_EST_H_
+#define SRC_RATE_EST_H_
+
+/**
+ * \addtogroup src_rate_est src_rate_est
+ *
+ * Rate estimation and control for an ASRC bridging two clock domains.
+ *
+ * The producer side of the ASRC input FIFO reports when frames arrive and
+ * the consumer side reports when frames are taken, each with a timestamp
+ * from a common timer. A delay locked loop on each side filters the jitter
+ * out of the timestamps to estimate each side's actual frame period. Each
+ * DLL starts wide to acquire the period quickly, then narrows. The ratio of
+ * the two periods gives the drift of the two clocks from their nominal
+ * rates. This feed forward estimate tracks the drift without waiting for
+ * the FIFO to move.
+ *
+ * A PI controller on the FIFO fill level trims the ratio to pull the FIFO
+ * back to its target level and to remove any residual error in the
+ * estimate. Frames arrive a packet at a time, so the level seen at each
+ * update would jump by a whole packet as the two clocks slip past each
+ * other. The level is compensated by the input frames due since the last
+ * packet, using the input side's estimated period, to give the level a
+ * steady input would have reached, and smoothed before it is used.
+ *
+ * The output is the nominal ratio returned by asrc_init(), in the same
+ * fixed point format, scaled by the estimated drift and the controller's
+ * correction.
+ *
+ * The estimator reports lock once the fill level has stayed within a
+ * window of its target, with a steady drift estimate, for a number of
+ * updates in a row. It loses lock when the fill level leaves a wider
+ * window.
+ *
+ * The timestamp functions for each side and src_rate_est_update() may be
+ * called from three different threads or cores, as long as each is only
+ * called from one at a time.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+/**
+ * Rate estimator configuration. src_rate_est_config_default() fills in
+ * values suitable for USB audio with a 1 ms update period.
+ */
+typedef struct {
+    uint32_t nominal_ratio;     /**< The nominal ratio of the input rate to the output rate, as returned by asrc_init() */
+    uint32_t in_rate;           /**< The nominal input rate in Hz */
+    uint32_t out_rate;          /**< The nominal output rate in Hz */
+    uint32_t timer_hz;          /**< The rate of the timestamp timer in Hz */
+    int32_t target_level_q8;    /**< The target FIFO fill level in frames, Q24.8 */
+    unsigned level_shift;       /**< Level smoothing. Each update moves the smoothed level by 2^-level_shift of its change. */
+    int32_t kp_ppb;             /**< Proportional gain: ratio correction in parts per billion per frame of level error */
+    unsigned ki_shift;          /**< Integral time: the integral grows by the proportional term every 2^ki_shift updates */
+    int32_t limit_ppb;          /**< The largest ratio correction the controller may apply */
+    unsigned dll_acquire_shift; /**< DLL bandwidth while acquiring. Each timestamp moves the phase by 2^-dll_acquire_shift of its error. */
+    unsigned dll_shift;         /**< DLL bandwidth once acquired, narrower to reject more jitter */
+    unsigned dll_settle;        /**< Timestamps on each side before its DLL is acquired and its period estimate is used */
+    int32_t lock_level_q8;      /**< The level error, in frames Q24.8, to stay within to gain lock */
+    int32_t unlock_level_q8;    /**< The level error, in frames Q24.8, that loses lock */
+    int32_t lock_drift_ppb;     /**< The most the drift estimate may move while gaining lock */
+    unsigned lock_updates;      /**< Consecutive updates meeting the lock conditions to gain lock */
+} src_rate_est_config_t;
+
+/**
+ * Rate estimator statistics.
+ */
+typedef struct {
+    uint32_t updates;           /**< Calls to src_rate_est_update() */
+    uint32_t lock_time;         /**< The update at which lock was last gained, or 0 if it never was */
+    uint32_t lock_losses;       /**< Times lock was lost */
+    int32_t max_error_q8;       /**< The largest level error, in frames Q24.8, while locked */
+    int32_t level_error_q8;     /**< The last smoothed level error, in frames Q24.8 */
+    int32_t drift_ppb;          /**< The drift of the input over output rate estimated from the timestamps */
+    int32_t correction_ppb;     /**< The controller's correction */
+    uint32_t ratio;             /**< The last ratio returned */
+    uint32_t in_period_q16;     /**< The estimated input frame period in timer ticks, Q16.16 */
+    uint32_t out_period_q16;    /**< The estimated output frame period in timer ticks, Q16.16 */
+    uint32_t dll_resets;        /**< Times either DLL restarted after a gap in its timestamps */
+} src_rate_est_stats_t;
+
+/* A delay locked loop on one side's timestamps. Private to the implementation. */
+typedef struct {
+    volatile uint32_t period_q16;
+    volatile uint32_t events;
+    volatile uint32_t last_timestamp;
+    volatile uint32_t last_frames;
+    uint32_t nominal_q16;
+    int64_t period_q32;
+    int64_t phase_q16;
+    uint32_t resets;
+} src_rate_est_dll_t;
+
+/**
+ * Typedef to the rate estimator instance struct.
+ */
+typedef struct src_rate_est_struct src_rate_est_t;
+
+/**
+ * Struct representing a rate estimator instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct src_rate_est_struct {
+    src_rate_est_config_t config;
+
+    src_rate_est_dll_t in;
+    src_rate_est_dll_t out;
+
+    int32_t level_error_q8;
+    int64_t integral_q8;
+    int32_t drift_ref_ppb;
+    unsigned lock_count;
+    int locked;
+
+    src_rate_est_stats_t stats;
+};
+
+/**
+ * Fills in a default configuration.
+ *
+ * \param config          The configuration to fill in
+ * \param nominal_ratio   The nominal ratio returned by asrc_init()
+ * \param in_rate         The nominal input rate in Hz
+ * \param out_rate        The nominal output rate in Hz
+ * \param timer_hz        The rate of the timestamp timer in Hz
+ * \param target_frames   The target FIFO fill level in frames
+ */
+void src_rate_est_config_default(src_rate_est_config_t *config,
+                                 uint32_t nominal_ratio,
+                                 uint32_t in_rate,
+                                 uint32_t out_rate,
+                                 uint32_t timer_hz,
+                                 uint32_t target_frames);
+
+/**
+ * Initializes a rate estimator. Also used to restart it after a rate change.
+ *
+ * \param est     A pointer to the rate estimator instance
+ * \param config  The configuration, which is copied
+ */
+void src_rate_est_init(src_rate_est_t *est,
+                       const src_rate_est_config_t *config);
+
+/**
+ * Reports frames arriving at the input of the FIFO.
+ *
+ * \param est        A pointer to the rate estimator instance
+ * \param frames     The number of frames that arrived
+ * \param timestamp  The time they were written to the FIFO
+ */
+void src_rate_est_in_timestamp(src_rate_est_t *est,
+                               unsigned frames,
+                               uint32_t timestamp);
+
+/**
+ * Reports frames produced at the output of the ASRC.
+ *
+ * \param est        A pointer to the rate estimator instance
+ * \param frames     The number of frames produced
+ * \param timestamp  The time they were due
+ */
+void src_rate_est_out_timestamp(src_rate_est_t *est,
+                                unsigned frames,
+                                uint32_t timestamp);
+
+/**
+ * Runs the controller once. Call at a regular interval, such as once per
+ * audio period, and pass the result to asrc_process() until the next call.
+ *
+ * \param est        A pointer to the rate estimator instance
+ * \param level_q8   The FIFO fill level in frames, Q24.8
+ * \param timestamp  The time the level was read
+ *
+ * \return the ratio of the input rate to the output rate
+ */
+uint32_t src_rate_est_update(src_rate_est_t *est,
+                             int32_t level_q8,
+                             uint32_t timestamp);
+
+/**
+ * Checks whether the estimator is locked.
+ *
+ * \return non-zero if the estimator is locked
+ */
+int src_rate_est_locked(const src_rate_est_t *est);
+
+/**
+ * Gets the rate estimator statistics.
+ *
+ * \param est    A pointer to the rate estimator instance
+ * \param stats  Receives the statistics
+ */
+void src_rate_est_stats_get(const src_rate_est_t *est,
+                            src_rate_est_stats_t *stats);
+
+/**@}*/
+
+#endif /* SRC_RATE_EST_H_ */
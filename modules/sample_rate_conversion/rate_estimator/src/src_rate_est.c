@@ -0,0 +1,277 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include "src_rate_est.h"
+
+#define PPB             1000000000LL
+#define Q30_ONE         (1LL << 30)
+
+/* A period estimate may not stray further than this from nominal, 2^-8 or about 0.4% */
+#define DLL_PERIOD_RANGE_SHIFT  8
+
+static int32_t abs32(int32_t x)
+{
+    return x < 0 ? -x : x;
+}
+
+static int64_t clamp64(int64_t x, int64_t limit)
+{
+    if (x > limit) {
+        return limit;
+    } else if (x < -limit) {
+        return -limit;
+    }
+    return x;
+}
+
+static void dll_init(src_rate_est_dll_t *dll, uint32_t rate, uint32_t timer_hz)
+{
+    memset(dll, 0, sizeof(*dll));
+    dll->nominal_q16 = (uint32_t) (((uint64_t) timer_hz << 16) / rate);
+    dll->period_q16 = dll->nominal_q16;
+    dll->period_q32 = (int64_t) dll->nominal_q16 << 16;
+}
+
+/*
+ * A second order DLL after F. Adriaensen, "Using a DLL to filter time". The
+ * phase is the filtered time of the last event relative to its timestamp,
+ * so that only timestamp differences are used and the timer may wrap.
+ */
+static void dll_event(src_rate_est_dll_t *dll, unsigned frames, uint32_t timestamp,
+                      const src_rate_est_config_t *config)
+{
+    const unsigned shift = dll->events < config->dll_settle ? config->dll_acquire_shift : config->dll_shift;
+    const int64_t expected = (int64_t) frames * dll->period_q16;
+    int64_t dt_q16;
+    int64_t err;
+
+    if (frames == 0) {
+        return;
+    }
+
+    if (dll->events == 0) {
+        dll->last_timestamp = timestamp;
+        dll->last_frames = frames;
+        dll->phase_q16 = 0;
+        dll->events = 1;
+        return;
+    }
+
+    dt_q16 = (int64_t) (uint32_t) (timestamp - dll->last_timestamp) << 16;
+    dll->last_timestamp = timestamp;
+    dll->last_frames = frames;
+
+    err = dt_q16 - (dll->phase_q16 + expected);
+
+    if (err > expected || err < -expected) {
+        /* A gap or a burst, such as a stalled stream. Restart the phase and keep the period. */
+        dll->phase_q16 = 0;
+        dll->resets++;
+        return;
+    }
+
+    /* Move the filtered time a fraction of the way to the timestamp, and the period by the square of that fraction */
+    dll->phase_q16 = (err >> shift) - err;
+
+    /* The period is filtered with 16 more fractional bits than it is published with, so that small errors still move it */
+    {
+        const int64_t nominal_q32 = (int64_t) dll->nominal_q16 << 16;
+        const int64_t range = nominal_q32 >> DLL_PERIOD_RANGE_SHIFT;
+        int64_t period = dll->period_q32 + ((err << 16) >> (2 * shift + 1)) / (int64_t) frames;
+
+        dll->period_q32 = nominal_q32 + clamp64(period - nominal_q32, range);
+        dll->period_q16 = (uint32_t) (dll->period_q32 >> 16);
+    }
+
+    dll->events++;
+}
+
+/*
+ * The input frames due since the last packet arrived. Adding this to the
+ * level removes the jump of a whole packet that the level would otherwise
+ * show as the input and output clocks slip past each other.
+ */
+static int32_t level_compensation_q8(const src_rate_est_dll_t *dll, uint32_t timestamp)
+{
+    const int32_t frames_q8 = (int32_t) dll->last_frames << 8;
+    int32_t dt = (int32_t) (timestamp - dll->last_timestamp);
+    int64_t due_q8;
+
+    if (dll->events == 0) {
+        return 0;
+    }
+
+    if (dt < 0) {
+        /* The level was read before the last packet arrived, so measure from the one before it */
+        dt += (int32_t) (((uint64_t) dll->last_frames * dll->period_q16) >> 16);
+        if (dt < 0) {
+            dt = 0;
+        }
+    }
+
+    due_q8 = ((int64_t) dt << 24) / dll->period_q16;
+    if (due_q8 > frames_q8) {
+        due_q8 = frames_q8;
+    }
+
+    return (int32_t) due_q8;
+}
+
+void src_rate_est_config_default(src_rate_est_config_t *config,
+                                 uint32_t nominal_ratio,
+                                 uint32_t in_rate,
+                                 uint32_t out_rate,
+                                 uint32_t timer_hz,
+                                 uint32_t target_frames)
+{
+    config->nominal_ratio = nominal_ratio;
+    config->in_rate = in_rate;
+    config->out_rate = out_rate;
+    config->timer_hz = timer_hz;
+    config->target_level_q8 = (int32_t) target_frames << 8;
+    config->level_shift = 4;
+
+    /* A level error is corrected with a time constant of about two seconds */
+    config->kp_ppb = (int32_t) (PPB / (2 * (int64_t) in_rate));
+    config->ki_shift = 13;
+    config->limit_ppb = 1000000;
+
+    config->dll_acquire_shift = 6;
+    config->dll_shift = 9;
+    config->dll_settle = 256;
+
+    config->lock_level_q8 = 2 << 8;
+    config->unlock_level_q8 = 8 << 8;
+    config->lock_drift_ppb = 5000;
+    config->lock_updates = 500;
+}
+
+void src_rate_est_init(src_rate_est_t *est,
+                       const src_rate_est_config_t *config)
+{
+    memset(est, 0, sizeof(*est));
+    est->config = *config;
+
+    dll_init(&est->in, config->in_rate, config->timer_hz);
+    dll_init(&est->out, config->out_rate, config->timer_hz);
+
+    est->stats.ratio = config->nominal_ratio;
+}
+
+void src_rate_est_in_timestamp(src_rate_est_t *est,
+                               unsigned frames,
+                               uint32_t timestamp)
+{
+    dll_event(&est->in, frames, timestamp, &est->config);
+}
+
+void src_rate_est_out_timestamp(src_rate_est_t *est,
+                                unsigned frames,
+                                uint32_t timestamp)
+{
+    dll_event(&est->out, frames, timestamp, &est->config);
+}
+
+uint32_t src_rate_est_update(src_rate_est_t *est,
+                             int32_t level_q8,
+                             uint32_t timestamp)
+{
+    const src_rate_est_config_t *config = &est->config;
+    const uint32_t in_period = est->in.period_q16;
+    const uint32_t out_period = est->out.period_q16;
+    int64_t drift_q30 = Q30_ONE;
+    int64_t p_q8;
+    int64_t correction;
+    int64_t ratio;
+    int32_t drift_ppb;
+    int32_t err_q8;
+    int32_t abs_err_q8;
+
+    err_q8 = level_q8 + level_compensation_q8(&est->in, timestamp) - config->target_level_q8;
+    if (est->stats.updates++ == 0) {
+        est->level_error_q8 = err_q8;
+    } else {
+        est->level_error_q8 += (err_q8 - est->level_error_q8) >> config->level_shift;
+    }
+    err_q8 = est->level_error_q8;
+    abs_err_q8 = abs32(err_q8);
+
+    /*
+     * The input over output rate has drifted from nominal by the output
+     * period over its nominal, times the nominal input period over its
+     * actual.
+     */
+    if (est->in.events >= config->dll_settle && est->out.events >= config->dll_settle) {
+        const int64_t out_rel = ((int64_t) out_period << 30) / est->out.nominal_q16;
+        const int64_t in_rel = ((int64_t) est->in.nominal_q16 << 30) / in_period;
+
+        drift_q30 = (out_rel * in_rel) >> 30;
+    }
+    drift_ppb = (int32_t) (((drift_q30 - Q30_ONE) * PPB) >> 30);
+
+    /*
+     * PI on the level error. The drift estimate already tracks the rates, so
+     * the integral only has a small residual to remove. It only moves while
+     * the level is within the unlock window, and the proportional term alone
+     * pulls the level back from a large excursion such as a lost packet, so
+     * that the integral does not wind up and overshoot.
+     */
+    p_q8 = (int64_t) config->kp_ppb * err_q8;
+    if (abs_err_q8 <= config->unlock_level_q8) {
+        est->integral_q8 = clamp64(est->integral_q8 + (p_q8 >> config->ki_shift),
+                                   (int64_t) config->limit_ppb << 8);
+    }
+    correction = clamp64((p_q8 + est->integral_q8) >> 8, config->limit_ppb);
+
+    ratio = ((int64_t) config->nominal_ratio * drift_q30) >> 30;
+    ratio += (ratio * correction) / PPB;
+
+    /* Lock detection */
+    if (est->locked) {
+        if (abs_err_q8 > config->unlock_level_q8) {
+            est->locked = 0;
+            est->lock_count = 0;
+            est->stats.lock_losses++;
+        } else if (abs_err_q8 > est->stats.max_error_q8) {
+            est->stats.max_error_q8 = abs_err_q8;
+        }
+    } else {
+        /* The drift estimate must stay near where it was when the level first came within the window */
+        if (est->lock_count == 0) {
+            est->drift_ref_ppb = drift_ppb;
+        }
+        if (abs_err_q8 <= config->lock_level_q8 &&
+            abs32(drift_ppb - est->drift_ref_ppb) <= config->lock_drift_ppb) {
+            if (++est->lock_count >= config->lock_updates) {
+                est->locked = 1;
+                est->stats.lock_time = est->stats.updates;
+                est->stats.max_error_q8 = abs_err_q8;
+            }
+        } else {
+            est->lock_count = 0;
+        }
+    }
+
+    est->stats.level_error_q8 = err_q8;
+    est->stats.drift_ppb = drift_ppb;
+    est->stats.correction_ppb = (int32_t) correction;
+    est->stats.ratio = (uint32_t) ratio;
+
+    return (uint32_t) ratio;
+}
+
+int src_rate_est_locked(const src_rate_est_t *est)
+{
+    return est->locked;
+}
+
+void src_rate_est_stats_get(const src_rate_est_t *est,
+                            src_rate_est_stats_t *stats)
+{
+    *stats = est->stats;
+    stats->in_period_q16 = est->in.period_q16;
+    stats->out_period_q16 = est->out.period_q16;
+    stats->dll_resets = est->in.resets + est->out.resets;
+}
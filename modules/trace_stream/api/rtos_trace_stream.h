@@ -0,0 +1,157 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RTOS_TRACE_STREAM_H_
+#define RTOS_TRACE_STREAM_H_
+
+/**
+ * \addtogroup rtos_trace_stream rtos_trace_stream
+ *
+ * Buffering of trace data sent over xscope.
+ *
+ * Writing a trace event straight to xscope holds up the writing core until
+ * the event has left the tile, and every core that traces at the same time
+ * waits for the link in turn. With a trace stream each core instead copies
+ * its events into a ring buffer, which only takes a short memcpy inside a
+ * critical section. A low priority task periodically drains the ring,
+ * sending the events as records of up to
+ * RTOS_TRACE_STREAM_XSCOPE_RECORD_BYTES.
+ *
+ * All cores write to the one ring, so the events are sent in the order they
+ * were written, as a single stream such as Tracealyzer's PSF requires. The
+ * critical section nests inside any that the writer already holds, so a
+ * writer that timestamps each event inside its own critical section, as
+ * the Tracealyzer recorder does, has its events sent in timestamp order. An
+ * event that does not fit in the ring is dropped and counted.
+ *
+ * Before the scheduler starts, a write that does not fit first sends the
+ * ring's contents to xscope, so that nothing written that early, such as a
+ * trace header, is lost.
+ *
+ * When the SDK is configured with -DXCORE_SDK_TRACE_STREAM=ON, the
+ * Tracealyzer xscope stream port writes through the instance given to
+ * rtos_trace_stream_tracealyzer_set().
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "rtos_osal.h"
+
+/**
+ * The size of the ring buffer in bytes. Must be a power of two.
+ */
+#ifndef RTOS_TRACE_STREAM_BUFFER_BYTES
+#define RTOS_TRACE_STREAM_BUFFER_BYTES 16384
+#endif
+
+/**
+ * The largest number of bytes sent in one xscope record.
+ */
+#ifndef RTOS_TRACE_STREAM_XSCOPE_RECORD_BYTES
+#define RTOS_TRACE_STREAM_XSCOPE_RECORD_BYTES 256
+#endif
+
+/**
+ * Trace stream statistics.
+ */
+typedef struct {
+    uint32_t events;            /**< Events written to the ring. */
+    uint32_t bytes;             /**< Bytes written to the ring. */
+    uint32_t dropped_events;    /**< Events dropped because the ring was full. */
+    uint32_t dropped_bytes;     /**< Bytes dropped because the ring was full. */
+    uint32_t max_level;         /**< The most bytes held by the ring at once. */
+    uint32_t records;           /**< xscope records sent. */
+    uint32_t record_bytes;      /**< Bytes sent. */
+    uint32_t core_events[configNUM_CORES]; /**< Events written by each core. */
+} rtos_trace_stream_stats_t;
+
+/**
+ * Typedef to the trace stream instance struct.
+ */
+typedef struct rtos_trace_stream_struct rtos_trace_stream_t;
+
+/**
+ * Struct representing a trace stream instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_trace_stream_struct {
+    int xscope_probe;
+    TickType_t period;
+    volatile int drain_running;
+    rtos_osal_thread_t thread;
+
+    volatile uint32_t wr;
+    volatile uint32_t rd;
+    rtos_trace_stream_stats_t stats;
+    uint8_t buf[RTOS_TRACE_STREAM_BUFFER_BYTES];
+};
+
+/**
+ * Initializes a trace stream instance. Trace data may be written as soon
+ * as this returns.
+ *
+ * \param ts            A pointer to the trace stream instance
+ * \param xscope_probe  The xscope probe to send the trace data on. The
+ *                      probe's data type should be NONE.
+ */
+void rtos_trace_stream_init(rtos_trace_stream_t *ts,
+                            int xscope_probe);
+
+/**
+ * Starts the task that drains the ring. This may be called before the
+ * scheduler is started.
+ *
+ * \param ts         A pointer to the trace stream instance
+ * \param priority   The priority of the drain task. A low priority keeps
+ *                   the drain task out of the way of the tasks being traced.
+ * \param period_ms  The time between drains in milliseconds. The ring must
+ *                   hold all the trace data written in this time.
+ */
+void rtos_trace_stream_start(rtos_trace_stream_t *ts,
+                             unsigned priority,
+                             unsigned period_ms);
+
+/**
+ * Writes one trace event. May be called from any core, from a task or an
+ * ISR, and with interrupts masked. Does not block.
+ *
+ * \param ts    A pointer to the trace stream instance
+ * \param data  The event
+ * \param len   The length of the event in bytes
+ *
+ * \return \p len, or 0 if the event was dropped because the ring was full
+ */
+size_t rtos_trace_stream_write(rtos_trace_stream_t *ts,
+                               const void *data,
+                               size_t len);
+
+/**
+ * Gets the trace stream statistics. The counts are read without stopping
+ * the writers, so they are approximate while tracing.
+ *
+ * \param ts     A pointer to the trace stream instance
+ * \param stats  Receives the statistics
+ */
+void rtos_trace_stream_stats_get(rtos_trace_stream_t *ts,
+                                 rtos_trace_stream_stats_t *stats);
+
+/**
+ * Sets the instance that the Tracealyzer xscope stream port writes to when
+ * the SDK is configured with -DXCORE_SDK_TRACE_STREAM=ON. Must be called
+ * before xTraceEnable(). Until it is called, the stream port writes each
+ * event straight to xscope probe 0.
+ *
+ * \param ts  A pointer to the trace stream instance. Its xscope probe
+ *            should be 0.
+ */
+void rtos_trace_stream_tracealyzer_set(rtos_trace_stream_t *ts);
+
+/**@}*/
+
+#endif /* RTOS_TRACE_STREAM_H_ */
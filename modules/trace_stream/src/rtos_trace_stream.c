@@ -0,0 +1,155 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#include <xscope.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "compiler_barrier.h"
+#include "rtos_trace_stream.h"
+
+#if (RTOS_TRACE_STREAM_BUFFER_BYTES & (RTOS_TRACE_STREAM_BUFFER_BYTES - 1)) != 0
+#error RTOS_TRACE_STREAM_BUFFER_BYTES must be a power of two
+#endif
+
+#define RING_MASK (RTOS_TRACE_STREAM_BUFFER_BYTES - 1)
+
+/*
+ * Sends everything in the ring that was written before the call. The write
+ * index only ever advances by whole events, so this always stops at the end
+ * of an event. Only one caller may drain the ring at a time.
+ */
+static void ring_drain(rtos_trace_stream_t *ts)
+{
+    const uint32_t wr = ts->wr;
+    uint32_t rd = ts->rd;
+
+    /* Only send the events that the write index has published */
+    COMPILER_BARRIER();
+
+    while (rd != wr) {
+        size_t n = wr - rd;
+        const size_t contiguous = RTOS_TRACE_STREAM_BUFFER_BYTES - (rd & RING_MASK);
+
+        if (n > contiguous) {
+            n = contiguous;
+        }
+        if (n > RTOS_TRACE_STREAM_XSCOPE_RECORD_BYTES) {
+            n = RTOS_TRACE_STREAM_XSCOPE_RECORD_BYTES;
+        }
+
+        xscope_bytes(ts->xscope_probe, n, &ts->buf[rd & RING_MASK]);
+        ts->stats.records++;
+        ts->stats.record_bytes += n;
+
+        rd += n;
+        /* The events must be sent before the read index frees their space */
+        COMPILER_BARRIER();
+        ts->rd = rd;
+    }
+}
+
+size_t rtos_trace_stream_write(rtos_trace_stream_t *ts,
+                               const void *data,
+                               size_t len)
+{
+    uint32_t state;
+    uint32_t wr;
+    uint32_t level;
+    size_t first;
+
+    /* Serializes the writers on all cores, so that the ring holds one ordered stream */
+    state = rtos_osal_critical_enter();
+
+    if (len > RTOS_TRACE_STREAM_BUFFER_BYTES - (ts->wr - ts->rd) && !ts->drain_running) {
+        /* Nothing else drains the ring yet, so make room for the event now */
+        ring_drain(ts);
+    }
+
+    wr = ts->wr;
+    level = wr - ts->rd;
+
+    if (len > RTOS_TRACE_STREAM_BUFFER_BYTES - level) {
+        ts->stats.dropped_events++;
+        ts->stats.dropped_bytes += len;
+        rtos_osal_critical_exit(state);
+        return 0;
+    }
+
+    first = RTOS_TRACE_STREAM_BUFFER_BYTES - (wr & RING_MASK);
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&ts->buf[wr & RING_MASK], data, first);
+    memcpy(ts->buf, (const uint8_t *) data + first, len - first);
+
+    /* The event must be in the ring before the write index publishes it */
+    COMPILER_BARRIER();
+    ts->wr = wr + len;
+
+    ts->stats.events++;
+    ts->stats.bytes += len;
+    ts->stats.core_events[portGET_CORE_ID()]++;
+    level += len;
+    if (level > ts->stats.max_level) {
+        ts->stats.max_level = level;
+    }
+
+    rtos_osal_critical_exit(state);
+
+    return len;
+}
+
+static void rtos_trace_stream_thread(rtos_trace_stream_t *ts)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t state;
+
+    /* No writer may still be draining the ring once this task takes it over */
+    state = rtos_osal_critical_enter();
+    ts->drain_running = 1;
+    rtos_osal_critical_exit(state);
+
+    for (;;) {
+        ring_drain(ts);
+        vTaskDelayUntil(&last_wake, ts->period);
+    }
+}
+
+void rtos_trace_stream_stats_get(rtos_trace_stream_t *ts,
+                                 rtos_trace_stream_stats_t *stats)
+{
+    uint32_t state;
+
+    state = rtos_osal_critical_enter();
+    *stats = ts->stats;
+    rtos_osal_critical_exit(state);
+}
+
+void rtos_trace_stream_start(rtos_trace_stream_t *ts,
+                             unsigned priority,
+                             unsigned period_ms)
+{
+    ts->period = pdMS_TO_TICKS(period_ms);
+    if (ts->period == 0) {
+        ts->period = 1;
+    }
+
+    rtos_osal_thread_create(
+            &ts->thread,
+            "trace_stream",
+            (rtos_osal_entry_function_t) rtos_trace_stream_thread,
+            ts,
+            RTOS_THREAD_STACK_SIZE(rtos_trace_stream_thread),
+            priority);
+}
+
+void rtos_trace_stream_init(rtos_trace_stream_t *ts,
+                            int xscope_probe)
+{
+    memset(ts, 0, sizeof(*ts));
+    ts->xscope_probe = xscope_probe;
+}
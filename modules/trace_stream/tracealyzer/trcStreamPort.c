@@ -0,0 +1,43 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <xscope.h>
+
+#include <trcRecorder.h>
+
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+#if (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)
+
+#include "rtos_trace_stream.h"
+
+/* xscope2psf expects the trace data on this probe */
+#define TRACE_XSCOPE_PROBE 0
+
+static rtos_trace_stream_t *trace_stream;
+
+void rtos_trace_stream_tracealyzer_set(rtos_trace_stream_t *ts)
+{
+    trace_stream = ts;
+}
+
+traceResult xTraceStreamPortInitialize(TraceStreamPortBuffer_t *pxBuffer)
+{
+    (void) pxBuffer;
+
+    return TRC_SUCCESS;
+}
+
+traceResult prvTraceStreamPortWrite(void *pvData, uint32_t uiSize, int32_t *piBytesWritten)
+{
+    if (trace_stream != NULL) {
+        *piBytesWritten = (int32_t) rtos_trace_stream_write(trace_stream, pvData, uiSize);
+    } else {
+        xscope_bytes(TRACE_XSCOPE_PROBE, uiSize, pvData);
+        *piBytesWritten = (int32_t) uiSize;
+    }
+
+    return TRC_SUCCESS;
+}
+
+#endif /* (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING) */
+#endif /* (TRC_USE_TRACEALYZER_RECORDER == 1) */
@@ -0,0 +1,65 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Tracealyzer stream port that writes through a trace stream instance, so
+ * that events are buffered and a low priority task sends them over xscope.
+ * See rtos_trace_stream.h.
+ */
+
+#ifndef TRC_STREAM_PORT_H
+#define TRC_STREAM_PORT_H
+
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+#if (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)
+
+#include <stdint.h>
+
+#include <trcTypes.h>
+#include <trcStreamPortConfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (TRC_CFG_STREAM_PORT_USE_INTERNAL_BUFFER == 1)
+#error The trace stream buffers the events itself. Set TRC_CFG_STREAM_PORT_USE_INTERNAL_BUFFER to 0.
+#endif
+
+#define TRC_USE_INTERNAL_BUFFER 0
+
+#define TRC_STREAM_PORT_BUFFER_SIZE sizeof(TraceUnsignedBaseType_t)
+
+typedef struct TraceStreamPortBuffer {
+    uint8_t buffer[TRC_STREAM_PORT_BUFFER_SIZE];
+} TraceStreamPortBuffer_t;
+
+traceResult xTraceStreamPortInitialize(TraceStreamPortBuffer_t *pxBuffer);
+
+traceResult prvTraceStreamPortWrite(void *pvData, uint32_t uiSize, int32_t *piBytesWritten);
+
+#define xTraceStreamPortAllocate(uiSize, ppvData) ((void) (uiSize), xTraceStaticBufferGet(ppvData))
+
+#define xTraceStreamPortCommit(pvData, uiSize, piBytesCommitted) prvTraceStreamPortWrite(pvData, uiSize, piBytesCommitted)
+
+#define xTraceStreamPortWriteData(pvData, uiSize, piBytesWritten) prvTraceStreamPortWrite(pvData, uiSize, piBytesWritten)
+
+/* Commands from the host are not supported over xscope */
+#define xTraceStreamPortReadData(pvData, uiSize, piBytesRead) ((void) (pvData), (void) (uiSize), (*(piBytesRead) = 0), TRC_SUCCESS)
+
+#define xTraceStreamPortOnEnable(uiStartOption) ((void) (uiStartOption), TRC_SUCCESS)
+
+#define xTraceStreamPortOnDisable() (TRC_SUCCESS)
+
+#define xTraceStreamPortOnTraceBegin() (TRC_SUCCESS)
+
+#define xTraceStreamPortOnTraceEnd() (TRC_SUCCESS)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING) */
+#endif /* (TRC_USE_TRACEALYZER_RECORDER == 1) */
+
+#endif /* TRC_STREAM_PORT_H */
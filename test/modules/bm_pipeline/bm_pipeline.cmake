@@ -0,0 +1,4 @@
+module_test_bare_metal(test_bm_pipeline_benchmark
+    LINK_LIBRARIES
+        sdk::bm_pipeline
+)
@@ -0,0 +1,13 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Benchmark configuration */
+#define appconfBENCH_CHANNELS           2
+#define appconfBENCH_FRAME_LENGTH       256
+#define appconfBENCH_FRAME_TICKS        (100 * 100)     /* 100 us */
+#define appconfBENCH_RUN_TICKS          (500 * 100000)  /* 500 ms */
+
+#endif /* APP_CONF_H_ */
@@ -0,0 +1,324 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <xcore/channel.h>
+#include <xcore/channel_streaming.h>
+#include <xcore/hwtimer.h>
+#include <xcore/parallel.h>
+
+/* SDK headers */
+#include "xcore_utils.h"
+#include "bm_pipeline.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Compares a three stage bare-metal pipeline that streams every word of
+ * each frame between its stages, as the explorer board example used to,
+ * with the same pipeline built with sdk::bm_pipeline, which passes pointers
+ * to double buffered frames.
+ *
+ * The streamed pipeline runs on tile 0 and the bm_pipeline one on tile 1,
+ * each with the same three stages: a source that produces a frame every
+ * appconfBENCH_FRAME_TICKS, a gain stage, and a sink. After
+ * appconfBENCH_RUN_TICKS, each tile reports, for each stage, the latency of
+ * its input hop, measured from when the previous stage finished its frame
+ * to when this stage has the whole frame, and the fraction of the time the
+ * stage was busy rather than waiting for its input. A streamed stage is
+ * busy while it sends or receives the words of a frame.
+ *
+ * The source waits for the frame period in its process function, like a
+ * stage that waits for the mic array, so its busy fraction includes that
+ * wait.
+ *
+ * The test passes if every stage of both pipelines kept up with the frame
+ * period, processing all but BENCH_FRAMES_SLACK of the frames due in the
+ * run.
+ */
+
+typedef struct {
+    int32_t samples[appconfBENCH_CHANNELS][appconfBENCH_FRAME_LENGTH];
+} bench_frame_t;
+
+#define BENCH_FRAME_WORDS   (sizeof(bench_frame_t) / sizeof(uint32_t))
+
+typedef struct {
+    hwtimer_t tmr;
+    uint32_t next_time;
+    int32_t count;
+} bench_source_state_t;
+
+typedef struct {
+    volatile int32_t sum;
+} bench_sink_state_t;
+
+#define BENCH_STAGES    3
+
+#define BENCH_FRAMES_DUE    (appconfBENCH_RUN_TICKS / appconfBENCH_FRAME_TICKS)
+
+/* Up to two frames may be in flight on each double buffered hop */
+#define BENCH_FRAMES_SLACK  (2 * BENCH_STAGES)
+
+/*
+ * Stage processing, shared by both pipelines
+ */
+
+BM_PIPELINE_PROCESS_ATTR
+static void bench_source(bench_source_state_t *state, const void *in, bench_frame_t *out)
+{
+    (void) in;
+
+    hwtimer_wait_until(state->tmr, state->next_time);
+    state->next_time += appconfBENCH_FRAME_TICKS;
+
+    for (int ch = 0; ch < appconfBENCH_CHANNELS; ch++) {
+        for (int smp = 0; smp < appconfBENCH_FRAME_LENGTH; smp++) {
+            out->samples[ch][smp] = state->count++;
+        }
+    }
+}
+
+BM_PIPELINE_PROCESS_ATTR
+static void bench_gain(void *state, const bench_frame_t *in, bench_frame_t *out)
+{
+    (void) state;
+
+    for (int ch = 0; ch < appconfBENCH_CHANNELS; ch++) {
+        for (int smp = 0; smp < appconfBENCH_FRAME_LENGTH; smp++) {
+            out->samples[ch][smp] = in->samples[ch][smp] >> 1;
+        }
+    }
+}
+
+BM_PIPELINE_PROCESS_ATTR
+static void bench_sink(bench_sink_state_t *state, const bench_frame_t *in, void *out)
+{
+    int32_t sum = 0;
+
+    (void) out;
+
+    for (int ch = 0; ch < appconfBENCH_CHANNELS; ch++) {
+        for (int smp = 0; smp < appconfBENCH_FRAME_LENGTH; smp++) {
+            sum += in->samples[ch][smp];
+        }
+    }
+    state->sum = sum;
+}
+
+static void bench_source_init(bench_source_state_t *state)
+{
+    state->tmr = hwtimer_alloc();
+    state->next_time = hwtimer_get_time(state->tmr) + appconfBENCH_FRAME_TICKS;
+    state->count = 0;
+}
+
+/* Returns the number of stages that did not keep up */
+static int bench_report(const char *name, const bm_pipeline_stats_t stats[BENCH_STAGES])
+{
+    int failures = 0;
+
+    debug_printf("%s pipeline\n", name);
+    for (int i = 0; i < BENCH_STAGES; i++) {
+        const uint64_t total = stats[i].busy_ticks + stats[i].wait_ticks;
+        const unsigned busy_permille = total ? (unsigned) (1000 * stats[i].busy_ticks / total) : 0;
+        const unsigned latency_avg = stats[i].frames ? (unsigned) (stats[i].latency_ticks / stats[i].frames) : 0;
+
+        if (i == 0) {
+            debug_printf("\tstage %d: %u frames, busy %u.%u%%\n",
+                         i, stats[i].frames, busy_permille / 10, busy_permille % 10);
+        } else {
+            debug_printf("\tstage %d: %u frames, busy %u.%u%%, hop latency avg %u ticks, max %u ticks\n",
+                         i, stats[i].frames, busy_permille / 10, busy_permille % 10,
+                         latency_avg, stats[i].latency_max_ticks);
+        }
+
+        if (stats[i].frames + BENCH_FRAMES_SLACK < BENCH_FRAMES_DUE) {
+            debug_printf("\tstage %d FAIL: %u frames were due\n", i, BENCH_FRAMES_DUE);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/*
+ * The streamed pipeline. Each hop sends the time its frame was finished,
+ * followed by every word of the frame.
+ */
+
+static bm_pipeline_stats_t streamed_stats[BENCH_STAGES];
+
+static void streamed_frame_in(bm_pipeline_stats_t *stats, chanend_t c, bench_frame_t *frame)
+{
+    const uint32_t wait_start = get_reference_time();
+    const uint32_t sent = s_chan_in_word(c);
+    const uint32_t arrived = get_reference_time();
+    uint32_t latency;
+
+    s_chan_in_buf_word(c, (uint32_t *) frame, BENCH_FRAME_WORDS);
+    latency = get_reference_time() - sent;
+
+    stats->wait_ticks += arrived - wait_start;
+    stats->busy_ticks += get_reference_time() - arrived;
+    stats->latency_ticks += latency;
+    if (latency > stats->latency_max_ticks) {
+        stats->latency_max_ticks = latency;
+    }
+}
+
+static void streamed_frame_out(bm_pipeline_stats_t *stats, chanend_t c, bench_frame_t *frame)
+{
+    const uint32_t start = get_reference_time();
+
+    s_chan_out_word(c, start);
+    s_chan_out_buf_word(c, (uint32_t *) frame, BENCH_FRAME_WORDS);
+    stats->busy_ticks += get_reference_time() - start;
+}
+
+DECLARE_JOB(streamed_source, (chanend_t));
+DECLARE_JOB(streamed_gain, (chanend_t, chanend_t));
+DECLARE_JOB(streamed_sink, (chanend_t));
+DECLARE_JOB(streamed_report, (chanend_t));
+
+void streamed_source(chanend_t c_out)
+{
+    static bench_frame_t out;
+    bench_source_state_t state;
+    bm_pipeline_stats_t *stats = &streamed_stats[0];
+
+    bench_source_init(&state);
+
+    for (;;) {
+        const uint32_t start = get_reference_time();
+
+        bench_source(&state, NULL, &out);
+        stats->busy_ticks += get_reference_time() - start;
+        streamed_frame_out(stats, c_out, &out);
+        stats->frames++;
+    }
+}
+
+void streamed_gain(chanend_t c_in, chanend_t c_out)
+{
+    static bench_frame_t in;
+    static bench_frame_t out;
+    bm_pipeline_stats_t *stats = &streamed_stats[1];
+
+    for (;;) {
+        uint32_t start;
+
+        streamed_frame_in(stats, c_in, &in);
+        start = get_reference_time();
+        bench_gain(NULL, &in, &out);
+        stats->busy_ticks += get_reference_time() - start;
+        streamed_frame_out(stats, c_out, &out);
+        stats->frames++;
+    }
+}
+
+void streamed_sink(chanend_t c_in)
+{
+    static bench_frame_t in;
+    static bench_sink_state_t state;
+    bm_pipeline_stats_t *stats = &streamed_stats[2];
+
+    for (;;) {
+        uint32_t start;
+
+        streamed_frame_in(stats, c_in, &in);
+        start = get_reference_time();
+        bench_sink(&state, &in, NULL);
+        stats->busy_ticks += get_reference_time() - start;
+        stats->frames++;
+    }
+}
+
+void streamed_report(chanend_t c_done)
+{
+    bm_pipeline_stats_t stats[BENCH_STAGES];
+    hwtimer_t tmr = hwtimer_alloc();
+
+    hwtimer_delay(tmr, appconfBENCH_RUN_TICKS);
+    for (int i = 0; i < BENCH_STAGES; i++) {
+        stats[i] = streamed_stats[i];
+    }
+    hwtimer_free(tmr);
+
+    chan_out_word(c_done, bench_report("Streamed", stats));
+}
+
+/*
+ * The bm_pipeline pipeline
+ */
+
+static bench_source_state_t source_state;
+static bench_sink_state_t sink_state;
+
+BM_PIPELINE_HOP(hop_ab, bench_frame_t);
+BM_PIPELINE_HOP(hop_bc, bench_frame_t);
+
+BM_PIPELINE_STAGE(stage_a, NULL, &hop_ab, bench_source, &source_state);
+BM_PIPELINE_STAGE(stage_b, &hop_ab, &hop_bc, bench_gain, NULL);
+BM_PIPELINE_STAGE(stage_c, &hop_bc, NULL, bench_sink, &sink_state);
+
+static bm_pipeline_stage_t *const stages[BENCH_STAGES] = {&stage_a, &stage_b, &stage_c};
+
+DECLARE_JOB(pipeline_report, (chanend_t));
+
+void pipeline_report(chanend_t c_done)
+{
+    bm_pipeline_stats_t stats[BENCH_STAGES];
+    hwtimer_t tmr = hwtimer_alloc();
+    int failures;
+
+    hwtimer_delay(tmr, appconfBENCH_RUN_TICKS);
+    for (int i = 0; i < BENCH_STAGES; i++) {
+        bm_pipeline_stats_get(stages[i], &stats[i]);
+    }
+    hwtimer_free(tmr);
+
+    /* Wait for tile 0 to finish its report */
+    failures = chan_in_word(c_done);
+    failures += bench_report("bm_pipeline", stats);
+    debug_printf("** bm_pipeline benchmark %s **\n", failures == 0 ? "PASS" : "FAIL");
+
+    exit(failures == 0 ? 0 : 1);
+}
+
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c0;
+    (void)c2;
+    (void)c3;
+
+    streaming_channel_t s_chan_ab = s_chan_alloc();
+    streaming_channel_t s_chan_bc = s_chan_alloc();
+
+    PAR_JOBS (
+        PJOB(streamed_source, (s_chan_ab.end_a)),
+        PJOB(streamed_gain, (s_chan_ab.end_b, s_chan_bc.end_a)),
+        PJOB(streamed_sink, (s_chan_bc.end_b)),
+        PJOB(streamed_report, (c1))
+    );
+}
+
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c1;
+    (void)c2;
+    (void)c3;
+
+    bench_source_init(&source_state);
+    bm_pipeline_init(stages, BENCH_STAGES);
+
+    PAR_JOBS (
+        PJOB(bm_pipeline_stage_run, (stages[0])),
+        PJOB(bm_pipeline_stage_run, (stages[1])),
+        PJOB(bm_pipeline_stage_run, (stages[2])),
+        PJOB(pipeline_report, (c0))
+    );
+}
@@ -0,0 +1,4 @@
+module_test_bare_metal(test_bm_worker_pool_benchmark
+    LINK_LIBRARIES
+        sdk::bm_worker_pool
+)
@@ -0,0 +1,14 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Benchmark configuration */
+#define appconfBENCH_WORKERS            7
+#define appconfBENCH_CHANNELS           8
+#define appconfBENCH_FRAME_LENGTH       240
+#define appconfBENCH_TAPS               64
+#define appconfBENCH_FRAMES             32
+
+#endif /* APP_CONF_H_ */
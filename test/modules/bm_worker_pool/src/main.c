@@ -0,0 +1,179 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+#include <xcore/parallel.h>
+
+/* SDK headers */
+#include "xcore_utils.h"
+#include "bm_worker_pool.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Measures the speed up of FIR filtering with a pool of
+ * appconfBENCH_WORKERS workers over filtering on a single thread.
+ *
+ * Each frame of appconfBENCH_CHANNELS channels is filtered with an
+ * appconfBENCH_TAPS tap FIR three ways: on the calling thread alone, with
+ * the channels split between the calling thread and the workers, and with
+ * each channel's samples split into blocks between them. The time taken
+ * over appconfBENCH_FRAMES frames is reported per frame, followed by the
+ * pool's report. The test passes if both split runs give the same output
+ * as the single thread.
+ */
+
+#define BENCH_HISTORY   (appconfBENCH_TAPS - 1 + appconfBENCH_FRAME_LENGTH)
+#define BENCH_BLOCKS    (appconfBENCH_WORKERS + 1)
+
+static int32_t coef[appconfBENCH_TAPS];
+static int32_t input[appconfBENCH_CHANNELS][BENCH_HISTORY];
+static int32_t output[appconfBENCH_CHANNELS][appconfBENCH_FRAME_LENGTH];
+static int32_t expected[appconfBENCH_CHANNELS][appconfBENCH_FRAME_LENGTH];
+
+static bm_worker_pool_t pool;
+
+static void fir(int ch, size_t begin, size_t end)
+{
+    for (size_t n = begin; n < end; n++) {
+        int64_t acc = 0;
+
+        for (int k = 0; k < appconfBENCH_TAPS; k++) {
+            acc += (int64_t) coef[k] * input[ch][n + k];
+        }
+        output[ch][n] = (int32_t) (acc >> 30);
+    }
+}
+
+BM_WORKER_POOL_ATTR
+static void fir_channels(void *arg, size_t begin, size_t end)
+{
+    (void) arg;
+
+    for (size_t ch = begin; ch < end; ch++) {
+        fir(ch, 0, appconfBENCH_FRAME_LENGTH);
+    }
+}
+
+BM_WORKER_POOL_ATTR
+static void fir_blocks(void *arg, size_t begin, size_t end)
+{
+    const int ch = *(const int *) arg;
+
+    fir(ch, begin * appconfBENCH_FRAME_LENGTH / BENCH_BLOCKS, end * appconfBENCH_FRAME_LENGTH / BENCH_BLOCKS);
+}
+
+typedef enum {
+    BENCH_SINGLE,
+    BENCH_CHANNELS,
+    BENCH_BLOCKS_PER_CHANNEL,
+} bench_mode_t;
+
+static uint32_t bench(bench_mode_t mode)
+{
+    const uint32_t start = get_reference_time();
+
+    for (int frame = 0; frame < appconfBENCH_FRAMES; frame++) {
+        switch (mode) {
+        case BENCH_SINGLE:
+            fir_channels(NULL, 0, appconfBENCH_CHANNELS);
+            break;
+        case BENCH_CHANNELS:
+            bm_worker_pool_parallel_for(&pool, fir_channels, NULL, appconfBENCH_CHANNELS);
+            break;
+        case BENCH_BLOCKS_PER_CHANNEL:
+            for (int ch = 0; ch < appconfBENCH_CHANNELS; ch++) {
+                bm_worker_pool_parallel_for(&pool, fir_blocks, &ch, BENCH_BLOCKS);
+            }
+            break;
+        }
+    }
+
+    return (get_reference_time() - start) / appconfBENCH_FRAMES;
+}
+
+static int output_check(const char *name)
+{
+    if (memcmp(output, expected, sizeof(output)) != 0) {
+        debug_printf("\t%s FAIL: the output differs from the single thread\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+DECLARE_JOB(bench_run, (void));
+
+void bench_run(void)
+{
+    uint32_t single_ticks;
+    uint32_t ticks;
+    int failures = 0;
+
+    for (int k = 0; k < appconfBENCH_TAPS; k++) {
+        coef[k] = (1 << 30) / appconfBENCH_TAPS;
+    }
+    for (int ch = 0; ch < appconfBENCH_CHANNELS; ch++) {
+        for (int n = 0; n < BENCH_HISTORY; n++) {
+            input[ch][n] = (ch + 1) * n;
+        }
+    }
+
+    debug_printf("FIR of %d channels of %d samples, %d taps, %d workers\n",
+                 appconfBENCH_CHANNELS, appconfBENCH_FRAME_LENGTH, appconfBENCH_TAPS, appconfBENCH_WORKERS);
+
+    single_ticks = bench(BENCH_SINGLE);
+    debug_printf("\tsingle thread:       %u ticks per frame\n", single_ticks);
+    memcpy(expected, output, sizeof(output));
+
+    memset(output, 0, sizeof(output));
+    ticks = bench(BENCH_CHANNELS);
+    debug_printf("\tsplit by channel:    %u ticks per frame, speed up x%u.%02u\n",
+                 ticks, single_ticks / ticks, (100 * single_ticks / ticks) % 100);
+    failures += output_check("split by channel");
+
+    memset(output, 0, sizeof(output));
+    ticks = bench(BENCH_BLOCKS_PER_CHANNEL);
+    debug_printf("\tsplit by block:      %u ticks per frame, speed up x%u.%02u\n",
+                 ticks, single_ticks / ticks, (100 * single_ticks / ticks) % 100);
+    failures += output_check("split by block");
+
+    bm_worker_pool_report(&pool);
+
+    debug_printf("** bm_worker_pool benchmark %s **\n", failures == 0 ? "PASS" : "FAIL");
+
+    exit(failures == 0 ? 0 : 1);
+}
+
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c0;
+    (void)c1;
+    (void)c2;
+    (void)c3;
+
+    bm_worker_pool_init(&pool, appconfBENCH_WORKERS);
+
+    PAR_JOBS (
+        PJOB(bench_run, ()),
+        PJOB(bm_worker_pool_worker_run, (&pool, 0)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 1)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 2)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 3)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 4)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 5)),
+        PJOB(bm_worker_pool_worker_run, (&pool, 6))
+    );
+}
+
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c0;
+    (void)c1;
+    (void)c2;
+    (void)c3;
+}
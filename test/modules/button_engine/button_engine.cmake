@@ -0,0 +1,4 @@
+module_test_bare_metal(test_button_engine
+    LINK_LIBRARIES
+        sdk::button_engine
+)
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Copyright 2022 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+set -e
+
+XCORE_SDK_ROOT=`git rev-parse --show-toplevel`
+
+${XCORE_SDK_ROOT}/test/modules/shared/run_module_test.sh test_button_engine.xe 60
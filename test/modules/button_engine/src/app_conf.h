@@ -0,0 +1,16 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Test configuration, in reference clock ticks */
+#define appconfTEST_DEBOUNCE_TICKS      2000
+#define appconfTEST_LONG_PRESS_TICKS    100000
+#define appconfTEST_REPEAT_DELAY_TICKS  50000
+#define appconfTEST_REPEAT_PERIOD_TICKS 10000
+
+/* The number of updates timed for the update cost */
+#define appconfTEST_TIMED_UPDATES       1000
+
+#endif /* APP_CONF_H_ */
@@ -0,0 +1,262 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <xcore/hwtimer.h>
+
+/* SDK headers */
+#include "xcore_utils.h"
+#include "button_engine.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Drives a button engine with scripted port values and times, and checks
+ * the events it decodes: a bouncing press and release, a long press with
+ * auto-repeat, an update that is late for several repeats, two buttons
+ * held at once, and a button held from before the engine started. Then
+ * times the worst case cost of an update with every button changing.
+ */
+
+#define TEST_BUTTONS    4
+
+typedef struct {
+    uint32_t port;      /* Active low */
+    uint32_t time;
+} test_step_t;
+
+typedef struct {
+    uint8_t button;
+    uint8_t type;
+    uint16_t count;
+} test_event_t;
+
+static const button_engine_config_t config = {
+    .num_buttons = TEST_BUTTONS,
+    .active_low = (1 << TEST_BUTTONS) - 1,
+    .debounce_ticks = appconfTEST_DEBOUNCE_TICKS,
+    .long_press_ticks = appconfTEST_LONG_PRESS_TICKS,
+    .repeat_mask = 0x3,
+    .repeat_delay_ticks = appconfTEST_REPEAT_DELAY_TICKS,
+    .repeat_period_ticks = appconfTEST_REPEAT_PERIOD_TICKS,
+};
+
+static int failures;
+
+/*
+ * Runs the steps, updating the engine at each step and at every deadline
+ * it asks for before the next step, and checks the events against those
+ * expected.
+ */
+static void test_run(const char *name,
+                     uint32_t init_port,
+                     const test_step_t *steps, size_t num_steps,
+                     const test_event_t *expected, size_t num_expected,
+                     int follow_deadlines)
+{
+    button_engine_t engine;
+    button_engine_event_t event;
+    uint32_t port = init_port;
+    uint32_t now = 0;
+    uint32_t next_time;
+    int pending = 0;
+    size_t got = 0;
+    int ok = 1;
+
+    button_engine_init(&engine, &config, port, now);
+
+    for (size_t i = 0; i <= num_steps; i++) {
+        const uint32_t step_time = i < num_steps ? steps[i].time : now + 4 * appconfTEST_LONG_PRESS_TICKS;
+
+        while (follow_deadlines && pending && (int32_t) (next_time - step_time) < 0) {
+            now = next_time;
+            pending = button_engine_update(&engine, port, now, &next_time);
+        }
+        if (i == num_steps) {
+            break;
+        }
+        now = step_time;
+        port = steps[i].port;
+        pending = button_engine_update(&engine, port, now, &next_time);
+    }
+
+    while (button_engine_event_get(&engine, &event)) {
+        if (got >= num_expected ||
+            event.button != expected[got].button ||
+            event.type != expected[got].type ||
+            event.count != expected[got].count) {
+            debug_printf("\t%s: unexpected event %u: button %u type %u count %u\n",
+                         name, got, event.button, event.type, event.count);
+            ok = 0;
+        }
+        got++;
+    }
+    if (got != num_expected) {
+        debug_printf("\t%s: %u events, expected %u\n", name, got, num_expected);
+        ok = 0;
+    }
+
+    debug_printf("%s: %s\n", name, ok ? "PASS" : "FAIL");
+    failures += !ok;
+}
+
+#define TEST_RUN(name, init_port, steps, expected, follow) \
+    test_run(name, init_port, steps, sizeof(steps) / sizeof(steps[0]), \
+             expected, sizeof(expected) / sizeof(expected[0]), follow)
+
+#define RELEASED    0xF
+#define B0          0xE     /* Button 0 pressed */
+#define B01         0xC     /* Buttons 0 and 1 pressed */
+#define B2          0xB     /* Button 2 pressed */
+
+static void test_bounce(void)
+{
+    const test_step_t steps[] = {
+        {B0, 1000}, {RELEASED, 1100}, {B0, 1200}, {RELEASED, 1300}, {B0, 1400},
+        {B0, 1400 + appconfTEST_DEBOUNCE_TICKS},
+        {RELEASED, 20000}, {B0, 20100}, {RELEASED, 20200},
+        {RELEASED, 20200 + appconfTEST_DEBOUNCE_TICKS},
+    };
+    const test_event_t expected[] = {
+        {0, BUTTON_ENGINE_PRESS, 0},
+        {0, BUTTON_ENGINE_RELEASE, 0},
+    };
+
+    TEST_RUN("bounce", RELEASED, steps, expected, 0);
+}
+
+static void test_hold(void)
+{
+    /* Held for the long press time, with repeats from the repeat delay */
+    const test_step_t steps[] = {
+        {B0, 1000},
+        {RELEASED, 1000 + appconfTEST_DEBOUNCE_TICKS + appconfTEST_LONG_PRESS_TICKS + 5000},
+    };
+    const test_event_t expected[] = {
+        {0, BUTTON_ENGINE_PRESS, 0},
+        {0, BUTTON_ENGINE_REPEAT, 1},
+        {0, BUTTON_ENGINE_REPEAT, 2},
+        {0, BUTTON_ENGINE_REPEAT, 3},
+        {0, BUTTON_ENGINE_REPEAT, 4},
+        {0, BUTTON_ENGINE_REPEAT, 5},
+        {0, BUTTON_ENGINE_LONG_PRESS, 0},
+        {0, BUTTON_ENGINE_REPEAT, 6},
+        {0, BUTTON_ENGINE_RELEASE, 0},
+    };
+
+    TEST_RUN("hold", RELEASED, steps, expected, 1);
+}
+
+static void test_late(void)
+{
+    /* An update late by several repeat periods gives one repeat */
+    const test_step_t steps[] = {
+        {B0, 1000},
+        {B0, 1000 + appconfTEST_DEBOUNCE_TICKS},
+        {B0, 1000 + appconfTEST_REPEAT_DELAY_TICKS + 3 * appconfTEST_REPEAT_PERIOD_TICKS + 10},
+        {RELEASED, 1000 + appconfTEST_REPEAT_DELAY_TICKS + 3 * appconfTEST_REPEAT_PERIOD_TICKS + 20},
+        {RELEASED, 1000 + appconfTEST_REPEAT_DELAY_TICKS + 3 * appconfTEST_REPEAT_PERIOD_TICKS + 20 + appconfTEST_DEBOUNCE_TICKS},
+    };
+    const test_event_t expected[] = {
+        {0, BUTTON_ENGINE_PRESS, 0},
+        {0, BUTTON_ENGINE_REPEAT, 1},
+        {0, BUTTON_ENGINE_RELEASE, 0},
+    };
+
+    TEST_RUN("late", RELEASED, steps, expected, 0);
+}
+
+static void test_two_buttons(void)
+{
+    /* Button 2 does not repeat */
+    const test_step_t steps[] = {
+        {B01, 1000},
+        {B01 & B2, 1000 + appconfTEST_DEBOUNCE_TICKS + appconfTEST_REPEAT_DELAY_TICKS - 100},
+        {RELEASED, 1000 + appconfTEST_DEBOUNCE_TICKS + appconfTEST_REPEAT_DELAY_TICKS + 5000},
+    };
+    const test_event_t expected[] = {
+        {0, BUTTON_ENGINE_PRESS, 0},
+        {1, BUTTON_ENGINE_PRESS, 0},
+        {0, BUTTON_ENGINE_REPEAT, 1},
+        {1, BUTTON_ENGINE_REPEAT, 1},
+        {2, BUTTON_ENGINE_PRESS, 0},
+        {0, BUTTON_ENGINE_RELEASE, 0},
+        {1, BUTTON_ENGINE_RELEASE, 0},
+        {2, BUTTON_ENGINE_RELEASE, 0},
+    };
+
+    TEST_RUN("two buttons", RELEASED, steps, expected, 1);
+}
+
+static void test_held_at_init(void)
+{
+    /* No press, long press or repeat, only the release */
+    const test_step_t steps[] = {
+        {B0, 2 * appconfTEST_LONG_PRESS_TICKS},
+        {RELEASED, 2 * appconfTEST_LONG_PRESS_TICKS + 1000},
+    };
+    const test_event_t expected[] = {
+        {0, BUTTON_ENGINE_RELEASE, 0},
+    };
+
+    TEST_RUN("held at init", B0, steps, expected, 1);
+}
+
+static void test_update_cost(void)
+{
+    button_engine_t engine;
+    button_engine_event_t event;
+    uint32_t next_time;
+    uint32_t worst = 0;
+    uint32_t now = 0;
+
+    button_engine_init(&engine, &config, RELEASED, now);
+
+    for (int i = 0; i < appconfTEST_TIMED_UPDATES; i++) {
+        /* Every button changes, and every other update accepts the changes */
+        const uint32_t port = (i & 2) ? RELEASED : 0;
+        uint32_t start;
+        uint32_t ticks;
+
+        now += appconfTEST_DEBOUNCE_TICKS / 2;
+        start = get_reference_time();
+        (void) button_engine_update(&engine, port, now, &next_time);
+        ticks = get_reference_time() - start;
+        if (ticks > worst) {
+            worst = ticks;
+        }
+        while (button_engine_event_get(&engine, &event)) {
+        }
+    }
+
+    debug_printf("update cost: worst %u ticks for %d buttons\n", worst, TEST_BUTTONS);
+}
+
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c0;
+    (void)c1;
+    (void)c2;
+    (void)c3;
+
+    test_bounce();
+    test_hold();
+    test_late();
+    test_two_buttons();
+    test_held_at_init();
+    test_update_cost();
+
+    debug_printf("** button_engine test %s **\n", failures ? "FAIL" : "PASS");
+    exit(failures ? 1 : 0);
+}
+
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void)c0;
+    (void)c1;
+    (void)c2;
+    (void)c3;
+}
@@ -0,0 +1,5 @@
+module_test_freertos(test_dvfs_governor
+    LINK_LIBRARIES
+        rtos::drivers::clock_control
+        sdk::dvfs
+)
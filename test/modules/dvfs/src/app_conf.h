@@ -0,0 +1,28 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Governor configuration */
+#define appconfDVFS_PERIOD_MS               10
+#define appconfDVFS_UP_LOAD_PERMILLE        900
+#define appconfDVFS_DOWN_LOAD_PERMILLE      700
+#define appconfDVFS_DOWN_HOLD_PERIODS       5
+#define appconfDVFS_MIN_SLACK_US            500
+#define appconfDVFS_DOWN_SLACK_US           2000
+
+/* Test phases */
+#define appconfTEST_IDLE_MS                 2000
+#define appconfTEST_BURST_MS                1000
+#define appconfTEST_PIPELINE_MS             2000
+
+/* The pipeline runs every frame, doing work that takes appconfTEST_PIPELINE_WORK_US at full performance */
+#define appconfTEST_PIPELINE_FRAME_MS       10
+#define appconfTEST_PIPELINE_WORK_US        4000
+
+/* Task Priorities */
+#define appconfDVFS_TASK_PRIORITY           (configMAX_PRIORITIES - 1)
+#define appconfSTARTUP_TASK_PRIORITY        (configMAX_PRIORITIES / 2)
+
+#endif /* APP_CONF_H_ */
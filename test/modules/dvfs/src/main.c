@@ -0,0 +1,235 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+#include "rtos_clock_control.h"
+#include "rtos_dvfs.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Runs the DVFS governor on tile 0 through four phases, and checks that it
+ * moves between levels as it should:
+ *   - Idle. The governor should step down to the slowest level.
+ *   - A burst of full load on one core. The governor should go to level 0
+ *     within two periods.
+ *   - Idle again, back down to the slowest level.
+ *   - A pipeline that must finish a fixed amount of work every frame, with
+ *     enough slack at level 0 but not at the slowest level. The pipeline's
+ *     slack reports should boost the governor to level 0, after which no
+ *     more deadlines are missed.
+ * The residency and transitions at the end are printed.
+ */
+
+#define TICKS_PER_US    (PLATFORM_REFERENCE_HZ / 1000000)
+#define TICKS_PER_MS    (PLATFORM_REFERENCE_HZ / 1000)
+
+/* Assumes a 600 MHz processor clock at level 0 */
+static const rtos_dvfs_level_t levels[] = {
+    {1, RTOS_DVFS_SWITCH_UNCHANGED},
+    {2, RTOS_DVFS_SWITCH_UNCHANGED},
+    {3, RTOS_DVFS_SWITCH_UNCHANGED},
+    {6, RTOS_DVFS_SWITCH_UNCHANGED},
+};
+#define NUM_LEVELS  (sizeof(levels) / sizeof(levels[0]))
+
+static rtos_clock_control_t cc_ctx;
+static rtos_dvfs_t dvfs;
+
+static volatile uint32_t work_sink;
+
+static void work(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        work_sink += i;
+    }
+}
+
+/* The work loop iterations that take us at full performance */
+static uint32_t work_calibrate(uint32_t us)
+{
+    const uint32_t iterations = 100000;
+    uint32_t start;
+    uint32_t ticks;
+
+    start = get_reference_time();
+    work(iterations);
+    ticks = get_reference_time() - start;
+
+    return (uint32_t) (((uint64_t) iterations * us * TICKS_PER_US) / ticks);
+}
+
+static unsigned level_get(void)
+{
+    rtos_dvfs_stats_t stats;
+
+    rtos_dvfs_stats_get(&dvfs, &stats);
+    return stats.level;
+}
+
+static int phase_idle(void)
+{
+    unsigned level;
+
+    vTaskDelay(pdMS_TO_TICKS(appconfTEST_IDLE_MS));
+    level = level_get();
+    rtos_printf("idle: level %u\n", level);
+
+    return level == NUM_LEVELS - 1;
+}
+
+static int phase_burst(void)
+{
+    const uint32_t start = get_reference_time();
+    uint32_t latency = 0;
+    int boosted = 0;
+
+    while (get_reference_time() - start < appconfTEST_BURST_MS * TICKS_PER_MS) {
+        if (!boosted && level_get() == 0) {
+            boosted = 1;
+            latency = get_reference_time() - start;
+        }
+        work(1000);
+    }
+
+    if (!boosted) {
+        rtos_printf("burst: level 0 not reached\n");
+        return 0;
+    }
+    rtos_printf("burst: level 0 after %u us\n", latency / TICKS_PER_US);
+
+    return latency <= 2 * appconfDVFS_PERIOD_MS * TICKS_PER_MS;
+}
+
+static int phase_pipeline(uint32_t work_iterations)
+{
+    const unsigned frames = appconfTEST_PIPELINE_MS / appconfTEST_PIPELINE_FRAME_MS;
+    TickType_t last_wake = xTaskGetTickCount();
+    unsigned misses = 0;
+    unsigned last_miss = 0;
+
+    for (unsigned frame = 0; frame < frames; frame++) {
+        const uint32_t deadline = get_reference_time() + appconfTEST_PIPELINE_FRAME_MS * TICKS_PER_MS;
+        int32_t slack_us;
+
+        work(work_iterations);
+        slack_us = (int32_t) (deadline - get_reference_time()) / TICKS_PER_US;
+        rtos_dvfs_slack_report(&dvfs, slack_us);
+
+        if (slack_us < 0) {
+            misses++;
+            last_miss = frame;
+        }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(appconfTEST_PIPELINE_FRAME_MS));
+    }
+
+    rtos_printf("pipeline: %u of %u deadlines missed, the last at frame %u\n", misses, frames, last_miss);
+
+    /* Only the frame that triggered the boost, and the one in progress while it happened, may miss */
+    return level_get() == 0 && last_miss <= 1;
+}
+
+void startup_task(void *arg)
+{
+    const rtos_dvfs_config_t config = {
+        .levels = levels,
+        .num_levels = NUM_LEVELS,
+        .period_ms = appconfDVFS_PERIOD_MS,
+        .up_load_permille = appconfDVFS_UP_LOAD_PERMILLE,
+        .down_load_permille = appconfDVFS_DOWN_LOAD_PERMILLE,
+        .down_hold_periods = appconfDVFS_DOWN_HOLD_PERIODS,
+        .min_slack_us = appconfDVFS_MIN_SLACK_US,
+        .down_slack_us = appconfDVFS_DOWN_SLACK_US,
+    };
+    rtos_dvfs_stats_t stats;
+    uint32_t work_iterations;
+    int passed = 1;
+
+    rtos_printf("Startup task running from tile %d on core %d\n", THIS_XCORE_TILE, portGET_CORE_ID());
+
+    rtos_clock_control_start(&cc_ctx);
+
+    rtos_dvfs_init(&dvfs, &cc_ctx, &config);
+    rtos_dvfs_start(&dvfs, appconfDVFS_TASK_PRIORITY);
+
+    /* The governor starts at level 0 */
+    work_iterations = work_calibrate(appconfTEST_PIPELINE_WORK_US);
+
+    rtos_printf("\n** dvfs governor test start **\n");
+    passed &= phase_idle();
+    passed &= phase_burst();
+    passed &= phase_idle();
+    passed &= phase_pipeline(work_iterations);
+
+    rtos_dvfs_stats_get(&dvfs, &stats);
+    for (unsigned i = 0; i < NUM_LEVELS; i++) {
+        rtos_printf("level %u (div %u): %u ms\n", i, levels[i].processor_clk_div,
+                    (unsigned) (stats.residency_ticks[i] / TICKS_PER_MS));
+    }
+    rtos_printf("transitions: %u up, %u down, %u slack boosts, longest %u us\n",
+                stats.transitions_up, stats.transitions_down, stats.slack_boosts,
+                stats.max_transition_ticks / TICKS_PER_US);
+
+    passed &= stats.slack_boosts >= 1;
+    rtos_printf("** dvfs governor test %s **\n", passed ? "PASS" : "FAIL");
+
+    _Exit(passed ? 0 : 1);
+}
+
+void vApplicationMinimalIdleHook(void)
+{
+    asm volatile("waiteu");
+}
+
+static void tile_common_init(chanend_t c)
+{
+    (void) c;
+
+#if ON_TILE(0)
+    rtos_clock_control_init(&cc_ctx);
+
+    xTaskCreate((TaskFunction_t) startup_task,
+                "startup_task",
+                RTOS_THREAD_STACK_SIZE(startup_task),
+                NULL,
+                appconfSTARTUP_TASK_PRIORITY,
+                NULL);
+#endif
+
+    rtos_printf("start scheduler on tile %d\n", THIS_XCORE_TILE);
+    vTaskStartScheduler();
+}
+
+#if ON_TILE(0)
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c0;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c1);
+}
+#endif
+
+#if ON_TILE(1)
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c1;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c0);
+}
+#endif
@@ -0,0 +1,4 @@
+module_test_freertos(test_heap_benchmark
+    LINK_LIBRARIES
+        sdk::heap::slab
+)
@@ -0,0 +1,26 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Benchmark configuration */
+#define appconfBENCH_TASKS              configNUM_CORES
+#define appconfBENCH_ITERATIONS         20000
+#define appconfBENCH_LIVE_BLOCKS        4
+
+/*
+ * The size of the frames allocated and freed by the benchmark, in bytes.
+ * This matches a 240 sample, 2 channel, 32 bit audio frame as allocated by
+ * the example pipelines.
+ */
+#define appconfBENCH_FRAME_BYTES        (240 * 2 * sizeof(int32_t))
+
+/* The memory given to the slab heap instance under test */
+#define appconfBENCH_SLAB_HEAP_BYTES    (128 * 1024)
+
+/* Task Priorities */
+#define appconfSTARTUP_TASK_PRIORITY    (configMAX_PRIORITIES/2 + 5)
+#define appconfBENCH_TASK_PRIORITY      (configMAX_PRIORITIES/2)
+
+#endif /* APP_CONF_H_ */
@@ -0,0 +1,286 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+#include "rtos_slab_heap.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Compares the slab heap with the FreeRTOS heap under a multi core load.
+ *
+ * One task is pinned to each core. Each task keeps up to
+ * appconfBENCH_LIVE_BLOCKS allocations live, repeatedly freeing or
+ * allocating a random one of them, like the tasks of an audio pipeline
+ * that allocate and free a frame per block. Three quarters of the
+ * allocations are frames of appconfBENCH_FRAME_BYTES, and the rest are
+ * small messages of up to 128 bytes. The time taken by each call is
+ * measured with the reference timer.
+ */
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+} bench_heap_t;
+
+typedef struct {
+    uint32_t ops;
+    uint32_t failures;
+    uint32_t total_ticks;
+    uint32_t max_ticks;
+} bench_result_t;
+
+static const bench_heap_t *bench_heap;
+static bench_result_t bench_result[appconfBENCH_TASKS];
+static TaskHandle_t bench_task_handle[appconfBENCH_TASKS];
+static SemaphoreHandle_t bench_done;
+
+static rtos_slab_heap_t slab_heap;
+static uint8_t slab_heap_mem[appconfBENCH_SLAB_HEAP_BYTES] __attribute__((aligned(8)));
+
+static void *slab_heap_malloc(size_t size)
+{
+    return rtos_slab_heap_malloc(&slab_heap, size);
+}
+
+static void slab_heap_free(void *ptr)
+{
+    rtos_slab_heap_free(&slab_heap, ptr);
+}
+
+static const bench_heap_t freertos_heap = {
+    .name = "pvPortMalloc",
+    .malloc = pvPortMalloc,
+    .free = vPortFree,
+};
+
+static const bench_heap_t slab_heap_under_test = {
+    .name = "rtos_slab_heap",
+    .malloc = slab_heap_malloc,
+    .free = slab_heap_free,
+};
+
+void vApplicationMallocFailedHook(void)
+{
+    rtos_printf("Malloc Failed on tile %d!\n", THIS_XCORE_TILE);
+    xassert(0);
+    for(;;);
+}
+
+static void bench_task(void *arg)
+{
+    const int n = (int) arg;
+    bench_result_t *result = &bench_result[n];
+    void *live[appconfBENCH_LIVE_BLOCKS];
+    uint32_t seed = 0x9E3779B9 * (n + 1);
+
+    for (;;) {
+        (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        memset(result, 0, sizeof(*result));
+        memset(live, 0, sizeof(live));
+
+        for (int i = 0; i < appconfBENCH_ITERATIONS; i++) {
+            uint32_t start;
+            uint32_t ticks;
+            int slot;
+
+            seed = seed * 1664525 + 1013904223;
+            slot = (seed >> 16) % appconfBENCH_LIVE_BLOCKS;
+
+            if (live[slot] != NULL) {
+                start = get_reference_time();
+                bench_heap->free(live[slot]);
+                ticks = get_reference_time() - start;
+                live[slot] = NULL;
+            } else {
+                const size_t size = (seed & 3) ? appconfBENCH_FRAME_BYTES : 8 + ((seed >> 8) & 0x78);
+
+                start = get_reference_time();
+                live[slot] = bench_heap->malloc(size);
+                ticks = get_reference_time() - start;
+
+                if (live[slot] != NULL) {
+                    /* Touch the memory, as a real user would */
+                    *(volatile uint32_t *) live[slot] = i;
+                } else {
+                    result->failures++;
+                }
+            }
+
+            result->ops++;
+            result->total_ticks += ticks;
+            if (ticks > result->max_ticks) {
+                result->max_ticks = ticks;
+            }
+        }
+
+        for (int i = 0; i < appconfBENCH_LIVE_BLOCKS; i++) {
+            if (live[i] != NULL) {
+                bench_heap->free(live[i]);
+            }
+        }
+
+        xSemaphoreGive(bench_done);
+    }
+}
+
+/* Returns the number of failed allocations */
+static uint32_t bench_run(const bench_heap_t *heap)
+{
+    bench_result_t total = {0};
+    uint32_t start;
+    uint32_t elapsed;
+
+    bench_heap = heap;
+
+    start = get_reference_time();
+    for (int i = 0; i < appconfBENCH_TASKS; i++) {
+        xTaskNotifyGive(bench_task_handle[i]);
+    }
+    for (int i = 0; i < appconfBENCH_TASKS; i++) {
+        (void) xSemaphoreTake(bench_done, portMAX_DELAY);
+    }
+    elapsed = get_reference_time() - start;
+
+    for (int i = 0; i < appconfBENCH_TASKS; i++) {
+        total.ops += bench_result[i].ops;
+        total.failures += bench_result[i].failures;
+        total.total_ticks += bench_result[i].total_ticks;
+        if (bench_result[i].max_ticks > total.max_ticks) {
+            total.max_ticks = bench_result[i].max_ticks;
+        }
+    }
+
+    rtos_printf("%s: %d tasks, %u ops in %u us, %u ops/ms\n",
+                heap->name, appconfBENCH_TASKS, total.ops, elapsed / 100,
+                (uint32_t) ((uint64_t) total.ops * 100000 / elapsed));
+    rtos_printf("\tper call: avg %u ns, max %u ns, %u failures\n",
+                total.total_ticks * 10 / total.ops, total.max_ticks * 10, total.failures);
+    for (int i = 0; i < appconfBENCH_TASKS; i++) {
+        rtos_printf("\tcore %d: avg %u ns, max %u ns\n", i,
+                    bench_result[i].total_ticks * 10 / bench_result[i].ops,
+                    bench_result[i].max_ticks * 10);
+    }
+
+    return total.failures;
+}
+
+/* Returns the number of blocks still in use, which should be none */
+static uint32_t slab_heap_stats_print(void)
+{
+    rtos_slab_heap_stats_t stats;
+    uint32_t in_use = 0;
+
+    rtos_slab_heap_stats_get(&slab_heap, &stats);
+
+    rtos_printf("rtos_slab_heap stats:\n");
+    rtos_printf("\t%u of %u bytes free, minimum ever %u\n",
+                stats.free_bytes, stats.heap_bytes, stats.min_ever_free_bytes);
+    rtos_printf("\tlarge free list: %u bytes in %u chunks, largest %u, fragmentation %u.%u%%\n",
+                stats.large_free_bytes, stats.large_free_chunks, stats.largest_free_bytes,
+                stats.fragmentation / 10, stats.fragmentation % 10);
+    rtos_printf("\t%u allocs, %u frees, %u core list hits, %u refills, %u flushes, %u large, %u failures\n",
+                stats.allocs, stats.frees, stats.cache_hits, stats.refills, stats.flushes,
+                stats.large_allocs, stats.failures);
+    for (int i = 0; i < RTOS_SLAB_HEAP_CLASSES; i++) {
+        if (stats.classes[i].blocks > 0) {
+            rtos_printf("\t%u byte blocks: %u carved, %u in use, %u on cores, %u pooled\n",
+                        stats.classes[i].block_bytes, stats.classes[i].blocks, stats.classes[i].in_use,
+                        stats.classes[i].cached, stats.classes[i].pooled);
+        }
+        in_use += stats.classes[i].in_use;
+    }
+
+    return in_use;
+}
+
+void startup_task(void *arg)
+{
+    uint32_t failures = 0;
+
+    rtos_printf("Startup task running from tile %d on core %d\n", THIS_XCORE_TILE, portGET_CORE_ID());
+
+    rtos_slab_heap_init(&slab_heap, slab_heap_mem, sizeof(slab_heap_mem));
+    bench_done = xSemaphoreCreateCounting(appconfBENCH_TASKS, 0);
+
+    for (int i = 0; i < appconfBENCH_TASKS; i++) {
+        xTaskCreateAffinitySet((TaskFunction_t) bench_task,
+                               "bench",
+                               RTOS_THREAD_STACK_SIZE(bench_task),
+                               (void *) i,
+                               appconfBENCH_TASK_PRIORITY,
+                               1 << i,
+                               &bench_task_handle[i]);
+    }
+
+    /* Once to warm up both heaps, then again to measure */
+    bench_run(&freertos_heap);
+    bench_run(&slab_heap_under_test);
+
+    rtos_printf("\n** heap benchmark start **\n");
+    failures += bench_run(&freertos_heap);
+    failures += bench_run(&slab_heap_under_test);
+    failures += slab_heap_stats_print();
+    rtos_printf("** heap benchmark %s **\n", failures == 0 ? "PASS" : "FAIL");
+
+    _Exit(failures == 0 ? 0 : 1);
+}
+
+void vApplicationMinimalIdleHook(void)
+{
+    asm volatile("waiteu");
+}
+
+static void tile_common_init(chanend_t c)
+{
+    (void) c;
+
+#if ON_TILE(0)
+    xTaskCreate((TaskFunction_t) startup_task,
+                "startup_task",
+                RTOS_THREAD_STACK_SIZE(startup_task),
+                NULL,
+                appconfSTARTUP_TASK_PRIORITY,
+                NULL);
+#endif
+
+    rtos_printf("start scheduler on tile %d\n", THIS_XCORE_TILE);
+    vTaskStartScheduler();
+}
+
+#if ON_TILE(0)
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c0;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c1);
+}
+#endif
+
+#if ON_TILE(1)
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c1;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c0);
+}
+#endif
@@ -0,0 +1,4 @@
+module_test_freertos(test_sample_rate_conversion_benchmark
+    LINK_LIBRARIES
+        sdk::lib_src::multichannel
+)
@@ -0,0 +1,21 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Benchmark configuration */
+#define appconfBENCH_BATCH_FRAMES       32
+#define appconfBENCH_BATCHES            64
+
+/*
+ * The instructions per second available to one thread. With five or more
+ * threads active, each xcore.ai thread issues at a fifth of the 600 MHz
+ * core clock.
+ */
+#define appconfBENCH_THREAD_MIPS        (600 / 5)
+
+/* Task Priorities */
+#define appconfSTARTUP_TASK_PRIORITY    (configMAX_PRIORITIES - 1)
+
+#endif /* APP_CONF_H_ */
@@ -0,0 +1,344 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+#include "src.h"
+#include "src_mc.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Compares the multi-channel batched SSRC and ASRC with running one single
+ * channel lib_src instance per channel.
+ *
+ * For 2, 8 and 16 channels, each converter processes appconfBENCH_BATCHES
+ * batches of appconfBENCH_BATCH_FRAMES frames per channel, first with a
+ * loop over per channel instances, then batched with channel major and
+ * with interleaved buffers. The time taken is measured with the reference
+ * timer and reported as the MIPS needed per channel to keep up in real
+ * time, assuming appconfBENCH_THREAD_MIPS per thread. Each batched run's
+ * last batch of output must match the per channel loop's.
+ */
+
+#define BENCH_OUT_STRIDE    SRC_MC_OUT_FRAMES_MAX(appconfBENCH_BATCH_FRAMES)
+
+typedef enum {
+    BENCH_PER_CHANNEL,
+    BENCH_CHANNEL_MAJOR,
+    BENCH_INTERLEAVED,
+} bench_mode_t;
+
+static const char *const bench_mode_name[] = {
+    [BENCH_PER_CHANNEL] = "per channel loop",
+    [BENCH_CHANNEL_MAJOR] = "batched, channel major",
+    [BENCH_INTERLEAVED] = "batched, interleaved",
+};
+
+static const unsigned bench_channels[] = {2, 8, 16};
+
+/* One single channel lib_src instance per channel */
+static union {
+    struct {
+        ssrc_ctrl_t ctrl[SRC_MC_MAX_CHANNELS];
+        ssrc_state_t state[SRC_MC_MAX_CHANNELS];
+        int stack[SRC_MC_MAX_CHANNELS][SSRC_STACK_LENGTH_MULT * SRC_MC_BLOCK_FRAMES];
+    } ssrc;
+    struct {
+        asrc_ctrl_t ctrl[SRC_MC_MAX_CHANNELS];
+        asrc_state_t state[SRC_MC_MAX_CHANNELS];
+        int stack[SRC_MC_MAX_CHANNELS][ASRC_STACK_LENGTH_MULT * SRC_MC_BLOCK_FRAMES];
+        asrc_adfir_coefs_t adfir_coefs[SRC_MC_MAX_CHANNELS];
+        unsigned nominal_ratio;
+    } asrc;
+} per_channel;
+
+static union {
+    src_mc_ssrc_t ssrc;
+    src_mc_asrc_t asrc;
+} batched;
+
+/* The input, channel major, and the per channel loop's output to check the batched runs against */
+static int32_t in_ref[SRC_MC_MAX_CHANNELS * appconfBENCH_BATCH_FRAMES];
+static int32_t out_ref[SRC_MC_MAX_CHANNELS * BENCH_OUT_STRIDE];
+static size_t out_ref_frames;
+
+static int32_t in_buf[SRC_MC_MAX_CHANNELS * appconfBENCH_BATCH_FRAMES];
+static int32_t out_buf[SRC_MC_MAX_CHANNELS * BENCH_OUT_STRIDE];
+
+static void in_buf_fill(bench_mode_t mode, unsigned n_channels)
+{
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        for (int i = 0; i < appconfBENCH_BATCH_FRAMES; i++) {
+            const int32_t sample = in_ref[ch * appconfBENCH_BATCH_FRAMES + i];
+
+            if (mode == BENCH_INTERLEAVED) {
+                in_buf[i * n_channels + ch] = sample;
+            } else {
+                in_buf[ch * appconfBENCH_BATCH_FRAMES + i] = sample;
+            }
+        }
+    }
+}
+
+/*
+ * Keeps the per channel loop's output, and checks a batched run's output
+ * against it. Returns the number of failures.
+ */
+static int out_buf_check(const char *name, bench_mode_t mode, unsigned n_channels, size_t n_frames)
+{
+    if (mode == BENCH_PER_CHANNEL) {
+        memcpy(out_ref, out_buf, sizeof(out_ref));
+        out_ref_frames = n_frames;
+        return 0;
+    }
+
+    if (n_frames != out_ref_frames) {
+        rtos_printf("%s, %u ch, %s: %u frames out, expected %u\n", name, n_channels,
+                    bench_mode_name[mode], n_frames, out_ref_frames);
+        return 1;
+    }
+
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        for (size_t i = 0; i < n_frames; i++) {
+            const int32_t sample = mode == BENCH_INTERLEAVED ? out_buf[i * n_channels + ch]
+                                                             : out_buf[ch * BENCH_OUT_STRIDE + i];
+
+            if (sample != out_ref[ch * BENCH_OUT_STRIDE + i]) {
+                rtos_printf("%s, %u ch, %s: channel %u frame %u differs from the per channel loop\n", name,
+                            n_channels, bench_mode_name[mode], ch, i);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void ssrc_per_channel_init(fs_code_t fs_in, fs_code_t fs_out, unsigned n_channels)
+{
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        per_channel.ssrc.ctrl[ch].psState = &per_channel.ssrc.state[ch];
+        per_channel.ssrc.ctrl[ch].piStack = per_channel.ssrc.stack[ch];
+        ssrc_init(fs_in, fs_out, &per_channel.ssrc.ctrl[ch], 1, SRC_MC_BLOCK_FRAMES, OFF);
+    }
+}
+
+/* Returns the number of output frames per channel */
+static size_t ssrc_per_channel_process(unsigned n_channels)
+{
+    size_t n_frames = 0;
+
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        int32_t *in = &in_buf[ch * appconfBENCH_BATCH_FRAMES];
+        int32_t *out = &out_buf[ch * BENCH_OUT_STRIDE];
+
+        for (int frame = 0; frame < appconfBENCH_BATCH_FRAMES; frame += SRC_MC_BLOCK_FRAMES) {
+            out += ssrc_process((int *) &in[frame], (int *) out, &per_channel.ssrc.ctrl[ch]);
+        }
+        n_frames = out - &out_buf[ch * BENCH_OUT_STRIDE];
+    }
+
+    return n_frames;
+}
+
+static void asrc_per_channel_init(fs_code_t fs_in, fs_code_t fs_out, unsigned n_channels)
+{
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        per_channel.asrc.ctrl[ch].psState = &per_channel.asrc.state[ch];
+        per_channel.asrc.ctrl[ch].piStack = per_channel.asrc.stack[ch];
+        per_channel.asrc.ctrl[ch].piADCoefs = per_channel.asrc.adfir_coefs[ch].iASRCADFIRCoefs;
+        per_channel.asrc.nominal_ratio = asrc_init(fs_in, fs_out, &per_channel.asrc.ctrl[ch], 1, SRC_MC_BLOCK_FRAMES, OFF);
+    }
+}
+
+/* Returns the number of output frames per channel */
+static size_t asrc_per_channel_process(unsigned n_channels)
+{
+    size_t n_frames = 0;
+
+    for (unsigned ch = 0; ch < n_channels; ch++) {
+        int32_t *in = &in_buf[ch * appconfBENCH_BATCH_FRAMES];
+        int32_t *out = &out_buf[ch * BENCH_OUT_STRIDE];
+
+        for (int frame = 0; frame < appconfBENCH_BATCH_FRAMES; frame += SRC_MC_BLOCK_FRAMES) {
+            out += asrc_process((int *) &in[frame], (int *) out, per_channel.asrc.nominal_ratio,
+                                &per_channel.asrc.ctrl[ch]);
+        }
+        n_frames = out - &out_buf[ch * BENCH_OUT_STRIDE];
+    }
+
+    return n_frames;
+}
+
+/* The MIPS per channel, times 10, that processing n_frames at fs_in in ticks needs */
+static uint32_t mips_x10(uint32_t ticks, uint32_t n_frames, uint32_t fs_in, unsigned n_channels)
+{
+    return (uint32_t) ((uint64_t) ticks * fs_in * appconfBENCH_THREAD_MIPS * 10 /
+                       ((uint64_t) n_frames * PLATFORM_REFERENCE_HZ * n_channels));
+}
+
+/* Returns the number of failures */
+static int bench_ssrc(fs_code_t fs_in, fs_code_t fs_out, uint32_t rate_in, uint32_t rate_out)
+{
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(bench_channels) / sizeof(bench_channels[0]); c++) {
+        const unsigned n_channels = bench_channels[c];
+
+        for (bench_mode_t mode = BENCH_PER_CHANNEL; mode <= BENCH_INTERLEAVED; mode++) {
+            uint32_t start;
+            uint32_t ticks;
+            uint32_t mips;
+            size_t n_frames;
+
+            in_buf_fill(mode, n_channels);
+            if (mode == BENCH_PER_CHANNEL) {
+                ssrc_per_channel_init(fs_in, fs_out, n_channels);
+            } else {
+                src_mc_ssrc_init(&batched.ssrc, fs_in, fs_out, n_channels,
+                                 mode == BENCH_INTERLEAVED ? SRC_MC_INTERLEAVED : SRC_MC_CHANNEL_MAJOR, OFF);
+            }
+
+            start = get_reference_time();
+            for (int i = 0; i < appconfBENCH_BATCHES; i++) {
+                if (mode == BENCH_PER_CHANNEL) {
+                    n_frames = ssrc_per_channel_process(n_channels);
+                } else {
+                    n_frames = src_mc_ssrc_process(&batched.ssrc, in_buf, appconfBENCH_BATCH_FRAMES,
+                                                   out_buf, BENCH_OUT_STRIDE);
+                }
+            }
+            ticks = get_reference_time() - start;
+
+            mips = mips_x10(ticks, appconfBENCH_BATCHES * appconfBENCH_BATCH_FRAMES, rate_in, n_channels);
+            rtos_printf("ssrc %u -> %u, %2u ch, %-24s %u.%u MIPS per channel\n", rate_in, rate_out,
+                        n_channels, bench_mode_name[mode], mips / 10, mips % 10);
+
+            failures += out_buf_check("ssrc", mode, n_channels, n_frames);
+        }
+    }
+
+    return failures;
+}
+
+/* Returns the number of failures */
+static int bench_asrc(fs_code_t fs_in, fs_code_t fs_out, uint32_t rate_in, uint32_t rate_out)
+{
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(bench_channels) / sizeof(bench_channels[0]); c++) {
+        const unsigned n_channels = bench_channels[c];
+
+        for (bench_mode_t mode = BENCH_PER_CHANNEL; mode <= BENCH_INTERLEAVED; mode++) {
+            uint32_t start;
+            uint32_t ticks;
+            uint32_t mips;
+            size_t n_frames;
+
+            in_buf_fill(mode, n_channels);
+            if (mode == BENCH_PER_CHANNEL) {
+                asrc_per_channel_init(fs_in, fs_out, n_channels);
+            } else {
+                src_mc_asrc_init(&batched.asrc, fs_in, fs_out, n_channels,
+                                 mode == BENCH_INTERLEAVED ? SRC_MC_INTERLEAVED : SRC_MC_CHANNEL_MAJOR, OFF);
+            }
+
+            start = get_reference_time();
+            for (int i = 0; i < appconfBENCH_BATCHES; i++) {
+                if (mode == BENCH_PER_CHANNEL) {
+                    n_frames = asrc_per_channel_process(n_channels);
+                } else {
+                    n_frames = src_mc_asrc_process(&batched.asrc, in_buf, appconfBENCH_BATCH_FRAMES,
+                                                   out_buf, BENCH_OUT_STRIDE,
+                                                   src_mc_asrc_nominal_ratio_get(&batched.asrc));
+                }
+            }
+            ticks = get_reference_time() - start;
+
+            mips = mips_x10(ticks, appconfBENCH_BATCHES * appconfBENCH_BATCH_FRAMES, rate_in, n_channels);
+            rtos_printf("asrc %u -> %u, %2u ch, %-24s %u.%u MIPS per channel\n", rate_in, rate_out,
+                        n_channels, bench_mode_name[mode], mips / 10, mips % 10);
+
+            failures += out_buf_check("asrc", mode, n_channels, n_frames);
+        }
+    }
+
+    return failures;
+}
+
+void startup_task(void *arg)
+{
+    uint32_t seed = 0x9E3779B9;
+    int failures = 0;
+
+    rtos_printf("Startup task running from tile %d on core %d\n", THIS_XCORE_TILE, portGET_CORE_ID());
+
+    /* Random input at half scale */
+    for (size_t i = 0; i < sizeof(in_ref) / sizeof(in_ref[0]); i++) {
+        seed = seed * 1664525 + 1013904223;
+        in_ref[i] = (int32_t) seed >> 1;
+    }
+
+    rtos_printf("\n** sample rate conversion benchmark start **\n");
+    failures += bench_ssrc(FS_CODE_48, FS_CODE_44, 48000, 44100);
+    failures += bench_asrc(FS_CODE_44, FS_CODE_48, 44100, 48000);
+    rtos_printf("** sample rate conversion benchmark %s **\n", failures == 0 ? "PASS" : "FAIL");
+
+    _Exit(failures == 0 ? 0 : 1);
+}
+
+void vApplicationMinimalIdleHook(void)
+{
+    asm volatile("waiteu");
+}
+
+static void tile_common_init(chanend_t c)
+{
+    (void) c;
+
+#if ON_TILE(0)
+    xTaskCreate((TaskFunction_t) startup_task,
+                "startup_task",
+                RTOS_THREAD_STACK_SIZE(startup_task),
+                NULL,
+                appconfSTARTUP_TASK_PRIORITY,
+                NULL);
+#endif
+
+    rtos_printf("start scheduler on tile %d\n", THIS_XCORE_TILE);
+    vTaskStartScheduler();
+}
+
+#if ON_TILE(0)
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c0;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c1);
+}
+#endif
+
+#if ON_TILE(1)
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c1;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c0);
+}
+#endif
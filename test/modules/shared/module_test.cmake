@@ -0,0 +1,78 @@
+## Shared build fixtures for the module tests. Each test's sources are in
+## the src directory next to its cmake file.
+set(MODULE_TEST_SHARED_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+set(MODULE_TEST_COMPILER_FLAGS
+    -O2
+    -g
+    -report
+    -fxscope
+    -mcmodel=large
+    -Wno-xcore-fptrgroup
+)
+
+## Adds <name>.xe, a FreeRTOS test built for tile 0 and tile 1 and merged.
+##
+## module_test_freertos(<name> LINK_LIBRARIES <lib>... [COMPILE_DEFINITIONS <def>...])
+function(module_test_freertos name)
+    cmake_parse_arguments(ARG "" "" "LINK_LIBRARIES;COMPILE_DEFINITIONS" ${ARGN})
+
+    file(GLOB_RECURSE app_sources ${CMAKE_CURRENT_LIST_DIR}/src/*.c)
+    set(app_includes ${CMAKE_CURRENT_LIST_DIR}/src)
+    set(app_compile_definitions
+        DEBUG_PRINT_ENABLE=1
+        PLATFORM_USES_TILE_0=1
+        PLATFORM_USES_TILE_1=1
+        XE_BASE_TILE=0
+        ${ARG_COMPILE_DEFINITIONS}
+    )
+    set(app_fixtures
+        ${MODULE_TEST_SHARED_DIR}/config.xscope
+        ${MODULE_TEST_SHARED_DIR}/XCORE-AI-EXPLORER.xn
+    )
+
+    foreach(tile 0 1)
+        set(target tile${tile}_${name})
+        add_executable(${target} EXCLUDE_FROM_ALL)
+        target_sources(${target} PUBLIC ${app_sources})
+        target_include_directories(${target} PUBLIC ${app_includes})
+        target_compile_definitions(${target} PUBLIC ${app_compile_definitions} THIS_XCORE_TILE=${tile})
+        target_compile_options(${target} PRIVATE ${MODULE_TEST_COMPILER_FLAGS} ${app_fixtures})
+        target_link_libraries(${target} PUBLIC core::general rtos::freertos ${ARG_LINK_LIBRARIES})
+        target_link_options(${target} PRIVATE -report ${app_fixtures})
+    endforeach()
+
+    merge_binaries(${name} tile0_${name} tile1_${name} 1)
+endfunction()
+
+## Adds <name>.xe, a bare-metal test built once for both tiles.
+##
+## module_test_bare_metal(<name> LINK_LIBRARIES <lib>... [COMPILE_DEFINITIONS <def>...])
+function(module_test_bare_metal name)
+    cmake_parse_arguments(ARG "" "" "LINK_LIBRARIES;COMPILE_DEFINITIONS" ${ARGN})
+
+    file(GLOB_RECURSE app_sources ${CMAKE_CURRENT_LIST_DIR}/src/*.c)
+    set(app_includes ${CMAKE_CURRENT_LIST_DIR}/src)
+    set(app_compile_definitions
+        DEBUG_PRINT_ENABLE=1
+        PLATFORM_SUPPORTS_TILE_0=1
+        PLATFORM_SUPPORTS_TILE_1=1
+        PLATFORM_SUPPORTS_TILE_2=0
+        PLATFORM_SUPPORTS_TILE_3=0
+        PLATFORM_USES_TILE_0=1
+        PLATFORM_USES_TILE_1=1
+        ${ARG_COMPILE_DEFINITIONS}
+    )
+    set(app_fixtures
+        ${MODULE_TEST_SHARED_DIR}/config.xscope
+        ${MODULE_TEST_SHARED_DIR}/XCORE-AI-EXPLORER.xn
+    )
+
+    add_executable(${name} EXCLUDE_FROM_ALL)
+    target_sources(${name} PUBLIC ${app_sources})
+    target_include_directories(${name} PUBLIC ${app_includes})
+    target_compile_definitions(${name} PRIVATE ${app_compile_definitions})
+    target_compile_options(${name} PRIVATE ${MODULE_TEST_COMPILER_FLAGS} ${app_fixtures})
+    target_link_libraries(${name} PUBLIC core::general core::multitile_support ${ARG_LINK_LIBRARIES})
+    target_link_options(${name} PRIVATE -report ${app_fixtures})
+endfunction()
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Copyright 2022 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+# Runs a module test from the dist folder and checks its output. The test
+# passes if it prints PASS and never prints FAIL. A test that hangs or
+# crashes before printing PASS fails.
+#
+# Usage: run_module_test.sh <firmware> [timeout_s]
+
+set -e
+
+# Get unix name for determining OS
+UNAME=$(uname)
+
+FIRMWARE=$1
+TIMEOUT_S=${2:-60}
+
+rm -rf testing
+mkdir testing
+REPORT=testing/test.rpt
+
+XCORE_SDK_ROOT=`git rev-parse --show-toplevel`
+
+echo "****************"
+echo "* Run Tests    *"
+echo "****************"
+if [ "$UNAME" == "Linux" ] ; then
+    timeout ${TIMEOUT_S}s xrun --xscope ${XCORE_SDK_ROOT}/dist/${FIRMWARE} 2>&1 | tee -a ${REPORT}
+elif [ "$UNAME" == "Darwin" ] ; then
+    gtimeout ${TIMEOUT_S}s xrun --xscope ${XCORE_SDK_ROOT}/dist/${FIRMWARE} 2>&1 | tee -a ${REPORT}
+fi
+
+echo "****************"
+echo "* Parse Result *"
+echo "****************"
+if grep -qw "FAIL" ${REPORT} ; then
+    echo "${FIRMWARE} FAILED"
+    exit 1
+elif ! grep -qw "PASS" ${REPORT} ; then
+    echo "${FIRMWARE} FAILED: no result"
+    exit 1
+fi
+echo "${FIRMWARE} PASSED"
@@ -0,0 +1,20 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef APP_CONF_H_
+#define APP_CONF_H_
+
+/* Benchmark configuration */
+#define appconfBENCH_LOAD_MS                    3000
+#define appconfBENCH_SINK_EVENTS                2000
+#define appconfBENCH_SINK_EVENT_BYTES           24
+#define appconfBENCH_XSCOPE_PROBE               1
+
+/* Trace stream configuration */
+#define appconfTRACE_STREAM_PERIOD_MS           1
+
+/* Task Priorities */
+#define appconfSTARTUP_TASK_PRIORITY            (configMAX_PRIORITIES - 1)
+#define appconfTRACE_STREAM_TASK_PRIORITY       (tskIDLE_PRIORITY + 1)
+
+#endif /* APP_CONF_H_ */
@@ -0,0 +1,386 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xscope.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+
+/* Library headers */
+#include "rtos_printf.h"
+#include "rtos_trace_stream.h"
+
+/* App headers */
+#include "app_conf.h"
+
+/*
+ * Measures the cost of tracing with Tracealyzer.
+ *
+ * The first part runs the process and subprocess load of the tracealyzer
+ * example with all of the subprocesses active, emitting a user event on
+ * every iteration, and times each xTracePrintF() call on the core it ran
+ * on. Building the SDK with and without -DXCORE_SDK_TRACE_STREAM=ON compares
+ * buffered events with events written straight to xscope.
+ *
+ * The second part isolates the cost of the two ways of getting an event
+ * out. One task pinned to each core writes events as fast as it can, first
+ * straight to xscope and then to a trace stream, both on a probe of their
+ * own so that the Tracealyzer stream is left intact.
+ */
+
+#define STRINGIFY(str)                    #str
+
+#define REF_TMR_TICKS_PER_MS              (PLATFORM_REFERENCE_HZ / 1000)
+#define REF_TMR_TICKS_FROM_MS(x)          ((x) * REF_TMR_TICKS_PER_MS)
+
+#define PROCESS_RUN_DELAY_MS              1
+#define NUM_SUBPROCESS_TASKS              8
+#define SUBPROCESS_DELAY_TIME_MS          5
+#define SUBPROCESS_TIMER_MS               100
+
+#define TASK_NOTIF_MASK_RUN_TASK          0x00010000
+
+typedef struct {
+    uint32_t events;
+    uint32_t total_ticks;
+    uint32_t max_ticks;
+} bench_result_t;
+
+static const UBaseType_t base_task_priority =
+        configMAX_PRIORITIES - NUM_SUBPROCESS_TASKS - 2;
+
+#if ON_TILE(0)
+
+static TaskHandle_t ctx_subprocess_tasks[NUM_SUBPROCESS_TASKS] = { NULL };
+static SemaphoreHandle_t resource_mutex;
+static volatile int load_running;
+
+static bench_result_t event_result[configNUM_CORES];
+static bench_result_t sink_result[configNUM_CORES];
+
+static TraceStringHandle_t trc_run_iteration;
+static TraceStringHandle_t trc_subprocess;
+
+#if XCORE_SDK_TRACE_STREAM
+static rtos_trace_stream_t trace_stream;
+#endif
+
+/* A trace stream of its own for the sink benchmark, on appconfBENCH_XSCOPE_PROBE */
+static rtos_trace_stream_t sink_stream;
+static TaskHandle_t sink_task_handle[configNUM_CORES];
+static SemaphoreHandle_t sink_done;
+static volatile int sink_use_stream;
+
+static void result_add(bench_result_t *result, uint32_t ticks)
+{
+    result->events++;
+    result->total_ticks += ticks;
+    if (ticks > result->max_ticks) {
+        result->max_ticks = ticks;
+    }
+}
+
+static uint32_t result_print(const char *name, bench_result_t *results)
+{
+    bench_result_t total = {0};
+
+    for (int i = 0; i < configNUM_CORES; i++) {
+        total.events += results[i].events;
+        total.total_ticks += results[i].total_ticks;
+        if (results[i].max_ticks > total.max_ticks) {
+            total.max_ticks = results[i].max_ticks;
+        }
+    }
+
+    rtos_printf("%s: %u events, avg %u ns, max %u ns\n", name, total.events,
+                total.events ? total.total_ticks * 10 / total.events : 0, total.max_ticks * 10);
+    for (int i = 0; i < configNUM_CORES; i++) {
+        if (results[i].events > 0) {
+            rtos_printf("\tcore %d: %u events, avg %u ns, max %u ns\n", i, results[i].events,
+                        results[i].total_ticks * 10 / results[i].events, results[i].max_ticks * 10);
+        }
+    }
+
+    return total.events;
+}
+
+static void trace_print_timed(TraceStringHandle_t channel, uint32_t value)
+{
+    const uint32_t start = get_reference_time();
+    uint32_t ticks;
+
+    xTracePrintF(channel, "%d", value);
+    ticks = get_reference_time() - start;
+
+    /* The core is read after the event, as the task may have moved */
+    result_add(&event_result[portGET_CORE_ID()], ticks);
+}
+
+static void spin_ref_tmr_ticks(uint32_t ticks)
+{
+    const uint32_t start = get_reference_time();
+
+    while (get_reference_time() - start < ticks) {
+        ;
+    }
+}
+
+static void subprocess_tmr_callback(TimerHandle_t pxTimer)
+{
+    xTaskNotify(ctx_subprocess_tasks[0], TASK_NOTIF_MASK_RUN_TASK, eSetBits);
+}
+
+static void process_task(void *arg)
+{
+    uint32_t run_iteration = 0;
+    TimerHandle_t tmr_subprocess;
+
+    tmr_subprocess = xTimerCreate(STRINGIFY(tmr_subprocess),
+                                  pdMS_TO_TICKS(SUBPROCESS_TIMER_MS), pdTRUE,
+                                  NULL, subprocess_tmr_callback);
+    xTimerStart(tmr_subprocess, 0);
+
+    while (load_running) {
+        trace_print_timed(trc_run_iteration, run_iteration++);
+
+        xSemaphoreTake(resource_mutex, portMAX_DELAY);
+        spin_ref_tmr_ticks(REF_TMR_TICKS_FROM_MS(PROCESS_RUN_DELAY_MS));
+        xSemaphoreGive(resource_mutex);
+    }
+
+    xTimerStop(tmr_subprocess, 0);
+    vTaskDelete(NULL);
+}
+
+static void subprocess_task(void *arg)
+{
+    const uint32_t bits_to_clear_on_entry = 0x00000000UL;
+    const uint32_t bits_to_clear_on_exit = 0xFFFFFFFFUL;
+    uint32_t notif_value;
+    uint8_t inst = ((uint32_t)arg - (uint32_t)ctx_subprocess_tasks) /
+                   sizeof(TaskHandle_t);
+    uint8_t next_inst = inst + 1;
+
+    while (1) {
+        xTaskNotifyWait(bits_to_clear_on_entry, bits_to_clear_on_exit,
+                        &notif_value, portMAX_DELAY);
+
+        if ((notif_value & TASK_NOTIF_MASK_RUN_TASK) && load_running) {
+            xSemaphoreTake(resource_mutex, portMAX_DELAY);
+            trace_print_timed(trc_subprocess, inst);
+            spin_ref_tmr_ticks(REF_TMR_TICKS_FROM_MS(SUBPROCESS_DELAY_TIME_MS));
+
+            if (next_inst < NUM_SUBPROCESS_TASKS) {
+                xTaskNotify(ctx_subprocess_tasks[next_inst],
+                            TASK_NOTIF_MASK_RUN_TASK, eSetBits);
+            }
+
+            xSemaphoreGive(resource_mutex);
+        }
+    }
+}
+
+static void sink_task(void *arg)
+{
+    bench_result_t *result = &sink_result[(int) arg];
+    uint8_t event[appconfBENCH_SINK_EVENT_BYTES];
+
+    memset(event, (int) arg, sizeof(event));
+
+    for (;;) {
+        (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        memset(result, 0, sizeof(*result));
+
+        for (int i = 0; i < appconfBENCH_SINK_EVENTS; i++) {
+            const uint32_t start = get_reference_time();
+
+            if (sink_use_stream) {
+                rtos_trace_stream_write(&sink_stream, event, sizeof(event));
+            } else {
+                xscope_bytes(appconfBENCH_XSCOPE_PROBE, sizeof(event), event);
+            }
+            result_add(result, get_reference_time() - start);
+        }
+
+        xSemaphoreGive(sink_done);
+    }
+}
+
+static void sink_run(int use_stream)
+{
+    sink_use_stream = use_stream;
+
+    for (int i = 0; i < configNUM_CORES; i++) {
+        xTaskNotifyGive(sink_task_handle[i]);
+    }
+    for (int i = 0; i < configNUM_CORES; i++) {
+        (void) xSemaphoreTake(sink_done, portMAX_DELAY);
+    }
+}
+
+static void stream_stats_print(const char *name, rtos_trace_stream_t *ts,
+                               rtos_trace_stream_stats_t *stats_out)
+{
+    rtos_trace_stream_stats_t stats;
+
+    rtos_trace_stream_stats_get(ts, &stats);
+    *stats_out = stats;
+
+    rtos_printf("%s stream: %u events, %u bytes, %u dropped events, %u dropped bytes, max level %u\n", name,
+                stats.events, stats.bytes, stats.dropped_events, stats.dropped_bytes, stats.max_level);
+    rtos_printf("\t%u records, %u bytes sent\n", stats.records, stats.record_bytes);
+    for (int i = 0; i < configNUM_CORES; i++) {
+        rtos_printf("\tcore %d: %u events\n", i, stats.core_events[i]);
+    }
+}
+
+static void startup_task(void *arg)
+{
+    rtos_trace_stream_stats_t stats;
+    int failures = 0;
+
+    rtos_printf("\n** trace overhead benchmark start **\n");
+#if XCORE_SDK_TRACE_STREAM
+    rtos_printf("Tracealyzer events are buffered\n");
+#else
+    rtos_printf("Tracealyzer events are written straight to xscope\n");
+#endif
+
+    /* Part 1: Tracealyzer events under the tracealyzer example's load */
+    load_running = 1;
+    xTaskCreate((TaskFunction_t)process_task, STRINGIFY(process_task),
+                RTOS_THREAD_STACK_SIZE(process_task), NULL, base_task_priority,
+                NULL);
+    for (int i = 0; i < NUM_SUBPROCESS_TASKS; i++) {
+        char task_name[TRC_CFG_ENTRY_SYMBOL_MAX_LENGTH];
+
+        snprintf(task_name, sizeof(task_name), "%s_%02d",
+                 STRINGIFY(subprocess_task), i);
+        xTaskCreate((TaskFunction_t)subprocess_task, task_name,
+                    RTOS_THREAD_STACK_SIZE(subprocess_task),
+                    &ctx_subprocess_tasks[i], base_task_priority + i + 1,
+                    &ctx_subprocess_tasks[i]);
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(appconfBENCH_LOAD_MS));
+    load_running = 0;
+    vTaskDelay(pdMS_TO_TICKS(SUBPROCESS_TIMER_MS + NUM_SUBPROCESS_TASKS * SUBPROCESS_DELAY_TIME_MS));
+
+    if (result_print("xTracePrintF", event_result) == 0) {
+        rtos_printf("No Tracealyzer events were timed\n");
+        failures++;
+    }
+#if XCORE_SDK_TRACE_STREAM
+    stream_stats_print("Tracealyzer", &trace_stream, &stats);
+    if (stats.dropped_events != 0) {
+        rtos_printf("The Tracealyzer stream dropped events\n");
+        failures++;
+    }
+#endif
+
+    /* Part 2: the cost of each way of getting an event out, on every core at once */
+    rtos_trace_stream_init(&sink_stream, appconfBENCH_XSCOPE_PROBE);
+    rtos_trace_stream_start(&sink_stream, appconfTRACE_STREAM_TASK_PRIORITY, appconfTRACE_STREAM_PERIOD_MS);
+    sink_done = xSemaphoreCreateCounting(configNUM_CORES, 0);
+
+    for (int i = 0; i < configNUM_CORES; i++) {
+        xTaskCreateAffinitySet((TaskFunction_t) sink_task,
+                               "sink",
+                               RTOS_THREAD_STACK_SIZE(sink_task),
+                               (void *) i,
+                               base_task_priority,
+                               1 << i,
+                               &sink_task_handle[i]);
+    }
+    /* Let the drain task start, so that a full ring drops events rather than being sent by the writer */
+    vTaskDelay(pdMS_TO_TICKS(appconfTRACE_STREAM_PERIOD_MS) + 1);
+
+    sink_run(0);
+    result_print("xscope_bytes", sink_result);
+    sink_run(1);
+    result_print("rtos_trace_stream_write", sink_result);
+
+    /* Give the trace streams time to empty */
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    /* Every event that the sink stream accepted must have been sent */
+    stream_stats_print("Sink", &sink_stream, &stats);
+    if (stats.events + stats.dropped_events != configNUM_CORES * appconfBENCH_SINK_EVENTS ||
+        stats.record_bytes != stats.bytes) {
+        rtos_printf("The sink stream lost events\n");
+        failures++;
+    }
+
+    rtos_printf("** trace overhead benchmark %s **\n", failures == 0 ? "PASS" : "FAIL");
+
+    _Exit(failures == 0 ? 0 : 1);
+}
+
+#endif /* ON_TILE(0) */
+
+void vApplicationMinimalIdleHook(void)
+{
+    asm volatile("waiteu");
+}
+
+static void tile_common_init(chanend_t c)
+{
+    (void) c;
+
+#if ON_TILE(0)
+    resource_mutex = xSemaphoreCreateMutex();
+    vTraceSetSemaphoreName(resource_mutex, "Shared Resource");
+    trc_run_iteration = xTraceRegisterString("Run Iteration");
+    trc_subprocess = xTraceRegisterString("Subprocess");
+
+    xTaskCreate((TaskFunction_t) startup_task,
+                "startup_task",
+                RTOS_THREAD_STACK_SIZE(startup_task),
+                NULL,
+                appconfSTARTUP_TASK_PRIORITY,
+                NULL);
+#endif
+
+    rtos_printf("Start scheduler on tile %d\n", THIS_XCORE_TILE);
+    vTaskStartScheduler();
+}
+
+#if ON_TILE(0)
+void main_tile0(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c0;
+    (void) c2;
+    (void) c3;
+
+#if XCORE_SDK_TRACE_STREAM
+    rtos_trace_stream_init(&trace_stream, 0);
+    rtos_trace_stream_tracealyzer_set(&trace_stream);
+    rtos_trace_stream_start(&trace_stream, appconfTRACE_STREAM_TASK_PRIORITY, appconfTRACE_STREAM_PERIOD_MS);
+#endif
+    xTraceInitialize();
+    xTraceEnable(TRC_START);
+
+    tile_common_init(c1);
+}
+#endif
+
+#if ON_TILE(1)
+void main_tile1(chanend_t c0, chanend_t c1, chanend_t c2, chanend_t c3)
+{
+    (void) c1;
+    (void) c2;
+    (void) c3;
+
+    tile_common_init(c0);
+}
+#endif
@@ -0,0 +1,8 @@
+# See xcore_trace.h for valid USE_TRACE_MODE values.
+module_test_freertos(test_trace_stream_benchmark
+    LINK_LIBRARIES
+        rtos::drivers::trace
+        sdk::trace::stream
+    COMPILE_DEFINITIONS
+        USE_TRACE_MODE=TRACE_MODE_TRACEALYZER_STREAMING
+)
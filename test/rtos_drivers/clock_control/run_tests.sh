@@ -4,30 +4,6 @@
 
 set -e
 
-# Get unix name for determining OS
-UNAME=$(uname)
-
-rm -rf testing
-mkdir testing
-REPORT=testing/test.rpt
-FIRMWARE=test_rtos_driver_clock_control_test.xe
-TIMEOUT_S=60
-
-rm -f ${REPORT}
-
 XCORE_SDK_ROOT=`git rev-parse --show-toplevel`
 
-echo "****************"
-echo "* Run Tests    *"
-echo "****************"
-if [ "$UNAME" == "Linux" ] ; then
-    timeout ${TIMEOUT_S}s xrun --xscope ${XCORE_SDK_PATH}/dist/${FIRMWARE} 2>&1 | tee -a ${REPORT}
-elif [ "$UNAME" == "Darwin" ] ; then
-    gtimeout ${TIMEOUT_S}s xrun --xscope ${XCORE_SDK_PATH}/dist/${FIRMWARE} 2>&1 | tee -a ${REPORT}
-fi
-
-echo "****************"
-echo "* Parse Result *"
-echo "****************"
-
-echo "**Currently Not Implemented**"
+${XCORE_SDK_ROOT}/test/modules/shared/run_module_test.sh test_rtos_driver_clock_control_test.xe 60
@@ -12,6 +12,7 @@
 
 /* Library headers */
 #include "rtos_printf.h"
+#include "rtos_clock_control_txn.h"
 
 /* App headers */
 #include "app_conf.h"
@@ -20,6 +21,10 @@
 
 static chanend_t c_other_tile = 0;
 
+static rtos_clock_control_txn_t cc_txn;
+static volatile unsigned txn_completions = 0;
+static volatile unsigned txn_listener_errors = 0;
+
 void vApplicationMallocFailedHook(void)
 {
     rtos_printf("Malloc Failed on tile %d!\n", THIS_XCORE_TILE);
@@ -35,6 +40,44 @@ static void mem_analysis(void)
 	}
 }
 
+static void txn_done(rtos_clock_control_txn_t *txn,
+                     const rtos_clock_control_settings_t *settings,
+                     const rtos_clock_control_txn_result_t *result,
+                     void *arg)
+{
+    rtos_clock_control_txn_stats_t stats;
+
+    /*
+     * Listeners are called after the instance's lock is released, so they
+     * may take it again. The stats must already count this commit.
+     */
+    rtos_clock_control_txn_stats_get(txn, &stats);
+    if (stats.commits != txn_completions + 1) {
+        txn_listener_errors++;
+    }
+    txn_completions++;
+}
+
+static void txn_result_print(const char *side, const rtos_clock_control_txn_result_t *result)
+{
+    rtos_printf("\t%s res:%d written:0x%x mismatched:0x%x latency:%u us\n",
+                side, result->status, result->written, result->mismatched,
+                result->latency_ticks / (PLATFORM_REFERENCE_HZ / 1000000));
+    rtos_printf("\t%s processor:%u switch:%u ref:%u\n",
+                side, result->processor_clock, result->switch_clock, result->ref_clock);
+}
+
+/* Returns 1 and prints FAIL if the registers do not hold the committed settings */
+static int txn_result_check(const char *side, const rtos_clock_control_txn_result_t *result)
+{
+    txn_result_print(side, result);
+    if (result->status != 0 || result->mismatched != 0) {
+        rtos_printf("\t%s FAIL res:%d mismatched:0x%x\n", side, result->status, result->mismatched);
+        return 1;
+    }
+    return 0;
+}
+
 #define LOCAL_SYNC()    {chan_out_byte(c_other_tile, 0xA5); /*rtos_printf("local synced\n");*/}
 #define REMOTE_SYNC()   {(void) chan_in_byte(c_other_tile);; /*rtos_printf("remote synced\n");*/}
 void clock_controller_local_test_task(void *arg)
@@ -230,7 +273,51 @@ void clock_controller_local_test_task(void *arg)
     LOCAL_SYNC();
     rtos_printf("** local lock tests complete **\n");
 
-    _Exit(0);
+
+    rtos_clock_control_settings_t saved;
+    rtos_clock_control_settings_t settings;
+    rtos_clock_control_txn_result_t result;
+    rtos_clock_control_txn_stats_t stats;
+    int txn_failures = 0;
+    rtos_printf("\n** transaction tests start **\n");
+    rtos_clock_control_txn_init(&cc_txn, cc_ctx_t0);
+    rtos_clock_control_txn_listener_add(&cc_txn, txn_done, NULL);
+    LOCAL_SYNC();
+    rtos_printf("Local rtos_clock_control_txn_read\n");
+    rtos_clock_control_txn_read(&cc_txn, &saved);
+    rtos_printf("\tLocal pre:%d mul:%d post:%d processor:%d switch:%d ref:%d\n",
+                saved.pll_pre_div, saved.pll_mul, saved.pll_post_div,
+                saved.processor_clk_div, saved.switch_clk_div, saved.ref_clk_div);
+    rtos_printf("Local rtos_clock_control_txn_commit processor_clk_div 2 and switch_clk_div 2\n");
+    settings.flags = RTOS_CLOCK_CONTROL_TXN_PROCESSOR | RTOS_CLOCK_CONTROL_TXN_SWITCH;
+    settings.processor_clk_div = 2;
+    settings.switch_clk_div = 2;
+    rtos_clock_control_txn_commit(&cc_txn, &settings, &result);
+    txn_failures += txn_result_check("Local", &result);
+    rtos_printf("Local rtos_clock_control_txn_commit the same settings\n");
+    rtos_clock_control_txn_commit(&cc_txn, &settings, &result);
+    txn_failures += txn_result_check("Local", &result);
+    if (result.written != 0) {
+        rtos_printf("\tLocal FAIL written:0x%x, expected no registers to be written\n", result.written);
+        txn_failures++;
+    }
+    LOCAL_SYNC();
+    LOCAL_SYNC();
+    rtos_printf("Local rtos_clock_control_txn_commit the saved settings\n");
+    rtos_clock_control_txn_commit(&cc_txn, &saved, &result);
+    txn_failures += txn_result_check("Local", &result);
+    rtos_clock_control_txn_stats_get(&cc_txn, &stats);
+    rtos_printf("\tLocal commits:%u no_ops:%u failures:%u completions:%u max latency:%u us\n",
+                stats.commits, stats.no_ops, stats.failures, txn_completions,
+                stats.max_latency_ticks / (PLATFORM_REFERENCE_HZ / 1000000));
+    if (stats.commits != 3 || stats.no_ops != 1 || stats.failures != 0 ||
+        txn_completions != stats.commits || txn_listener_errors != 0) {
+        rtos_printf("\tLocal FAIL stats or listener calls\n");
+        txn_failures++;
+    }
+    rtos_printf("** transaction tests %s **\n", txn_failures == 0 ? "PASS" : "FAIL");
+
+    _Exit(txn_failures == 0 ? 0 : 1);
 
     /* Done */
     vTaskDelete(NULL);
@@ -403,6 +490,23 @@ void clock_controller_remote_test_task(void *arg)
     rtos_printf("\tRemote done\n");
     REMOTE_SYNC();
 
+
+    rtos_clock_control_settings_t settings;
+    rtos_clock_control_txn_result_t result;
+    rtos_clock_control_txn_init(&cc_txn, cc_ctx_t0);
+    REMOTE_SYNC();
+    REMOTE_SYNC();
+    rtos_printf("Remote rtos_clock_control_txn_commit pll 1 50 1, processor_clk_div 3 and switch_clk_div 1\n");
+    settings.flags = RTOS_CLOCK_CONTROL_TXN_PLL | RTOS_CLOCK_CONTROL_TXN_PROCESSOR | RTOS_CLOCK_CONTROL_TXN_SWITCH;
+    settings.pll_pre_div = 1;
+    settings.pll_mul = 50;
+    settings.pll_post_div = 1;
+    settings.processor_clk_div = 3;
+    settings.switch_clk_div = 1;
+    rtos_clock_control_txn_commit(&cc_txn, &settings, &result);
+    (void) txn_result_check("Remote", &result);
+    REMOTE_SYNC();
+
     /* Done */
     vTaskDelete(NULL);
 }
@@ -8,6 +8,7 @@ set(SWMEM_TEST      1)
 set(QSPI_FLASH_TEST 0)  ## Will fail on Explorer 2V0 due to custom flash part
 set(I2S_TEST        1)
 set(MIC_ARRAY_TEST  1)
+set(RPC_ASYNC_TEST  1)  ## Uses the GPIO driver started by GPIO_TEST
 
 #**********************
 # Gather Sources
@@ -48,6 +49,7 @@ set(APP_COMPILE_DEFINITIONS
     RUN_QSPI_FLASH_TESTS=${QSPI_FLASH_TEST}
     RUN_I2S_TESTS=${I2S_TEST}
     RUN_MIC_ARRAY_TESTS=${MIC_ARRAY_TEST}
+    RUN_RPC_ASYNC_TESTS=${RPC_ASYNC_TEST}
 
     MIC_ARRAY_CONFIG_MCLK_FREQ=24576000
     MIC_ARRAY_CONFIG_PDM_FREQ=3072000
@@ -77,7 +79,7 @@ target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES})
 target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES})
 target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} THIS_XCORE_TILE=0)
 target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
-target_link_libraries(${TARGET_NAME} PUBLIC core::general rtos::freertos rtos::drivers::audio)
+target_link_libraries(${TARGET_NAME} PUBLIC core::general rtos::freertos rtos::drivers::audio sdk::intertile::rpc_async sdk::intertile::sg sdk::intertile::mux)
 target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS})
 unset(TARGET_NAME)
 
@@ -87,7 +89,7 @@ target_sources(${TARGET_NAME} PUBLIC ${APP_SOURCES})
 target_include_directories(${TARGET_NAME} PUBLIC ${APP_INCLUDES})
 target_compile_definitions(${TARGET_NAME} PUBLIC ${APP_COMPILE_DEFINITIONS} THIS_XCORE_TILE=1)
 target_compile_options(${TARGET_NAME} PRIVATE ${APP_COMPILER_FLAGS})
-target_link_libraries(${TARGET_NAME} PUBLIC core::general rtos::freertos rtos::drivers::audio)
+target_link_libraries(${TARGET_NAME} PUBLIC core::general rtos::freertos rtos::drivers::audio sdk::intertile::rpc_async sdk::intertile::sg sdk::intertile::mux)
 target_link_options(${TARGET_NAME} PRIVATE ${APP_LINK_OPTIONS} )
 unset(TARGET_NAME)
 
@@ -26,6 +26,12 @@
 #define MIC_ARRAY_RPC_PORT 16
 #define MIC_ARRAY_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES/2)
 
+#define RPC_ASYNC_PORT 17
+#define RPC_ASYNC_HOST_TASK_PRIORITY (configMAX_PRIORITIES/2)
+
+#define INTERTILE_MUX_PORT 18
+#define INTERTILE_MUX_TASK_PRIORITY (configMAX_PRIORITIES-1)
+
 #define I2C_SLAVE_ISR_CORE   4
 #define I2C_SLAVE_CORE_MASK  (1 << 2)
 #define I2C_SLAVE_ADDR       0x7A
@@ -46,6 +46,8 @@ static void register_intertile_tests(intertile_test_ctx_t *test_ctx)
 {
     register_fixed_len_tx_test(test_ctx);
     register_var_len_tx_test(test_ctx);
+    register_sg_throughput_test(test_ctx);
+    register_mux_priority_test(test_ctx);
 }
 
 static void intertile_init_tests(intertile_test_ctx_t *test_ctx, rtos_intertile_t *intertile_ctx)
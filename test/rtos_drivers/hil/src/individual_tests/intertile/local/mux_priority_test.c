@@ -0,0 +1,240 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+#include "rtos_intertile_mux.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "mux_priority_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+/* A bulk channel streaming large frames, and a control channel that should not wait behind them */
+#define MUX_BULK_CHAN       0
+#define MUX_BULK_PRIORITY   0
+#define MUX_BULK_FRAME_LEN  4096
+#define MUX_BULK_FRAMES     64
+#define MUX_BULK_CREDITS    2
+
+#define MUX_CTRL_CHAN       1
+#define MUX_CTRL_PRIORITY   1
+#define MUX_CTRL_MSGS       32
+#define MUX_CTRL_CREDITS    4
+#define MUX_CTRL_MAX_LEN    sizeof(uint32_t)
+
+static rtos_intertile_mux_t mux;
+
+typedef struct {
+    TaskHandle_t main_task;
+    uint8_t *frame;
+} bulk_args_t;
+
+static uint8_t bulk_byte(int frame, size_t i)
+{
+    return (uint8_t) (frame * 7 + i * 13);
+}
+
+#if ON_TILE(INTERTILE_TX_TILE)
+static void bulk_thread(bulk_args_t *args)
+{
+    for (int f = 0; f < MUX_BULK_FRAMES; f++)
+    {
+        for (size_t i = 0; i < MUX_BULK_FRAME_LEN; i++)
+        {
+            args->frame[i] = bulk_byte(f, i);
+        }
+        rtos_intertile_mux_tx(&mux, MUX_BULK_CHAN, args->frame, MUX_BULK_FRAME_LEN, RTOS_OSAL_WAIT_FOREVER);
+    }
+
+    xTaskNotify(args->main_task, 0, eSetValueWithOverwrite);
+    vTaskSuspend(NULL);
+    while(1) {;}
+}
+#endif
+
+#if ON_TILE(INTERTILE_RX_TILE)
+static void bulk_thread(bulk_args_t *args)
+{
+    uint32_t result = 0;
+
+    for (int f = 0; f < MUX_BULK_FRAMES && result == 0; f++)
+    {
+        uint8_t *frame = NULL;
+        size_t len = rtos_intertile_mux_rx(&mux, MUX_BULK_CHAN, (void **) &frame, RTOS_OSAL_WAIT_MS(1000));
+
+        if (len != MUX_BULK_FRAME_LEN)
+        {
+            local_printf("RX bulk frame %d failed.  Got len %u expected %u", f, len, MUX_BULK_FRAME_LEN);
+            result = 1;
+        } else {
+            for (size_t i = 0; i < len; i++)
+            {
+                if (frame[i] != bulk_byte(f, i))
+                {
+                    local_printf("RX bulk frame %d failed at index %u", f, i);
+                    result = 1;
+                    break;
+                }
+            }
+        }
+        rtos_osal_free(frame);
+    }
+
+    xTaskNotify(args->main_task, result, eSetValueWithOverwrite);
+    vTaskSuspend(NULL);
+    while(1) {;}
+}
+#endif
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    bulk_args_t args;
+    TaskHandle_t bulk_handle;
+    uint32_t result = 0;
+    int ret = 0;
+
+    local_printf("Start");
+
+    rtos_intertile_mux_init(&mux, ctx->intertile_ctx, INTERTILE_MUX_PORT);
+    rtos_intertile_mux_channel_open(&mux, MUX_BULK_CHAN, MUX_BULK_PRIORITY, MUX_BULK_CREDITS, MUX_BULK_CREDITS, MUX_BULK_FRAME_LEN);
+    rtos_intertile_mux_channel_open(&mux, MUX_CTRL_CHAN, MUX_CTRL_PRIORITY, MUX_CTRL_CREDITS, MUX_CTRL_CREDITS, MUX_CTRL_MAX_LEN);
+    rtos_intertile_mux_start(&mux, INTERTILE_MUX_TASK_PRIORITY);
+
+    args.main_task = xTaskGetCurrentTaskHandle();
+    args.frame = rtos_osal_malloc(MUX_BULK_FRAME_LEN);
+    if (args.frame == NULL)
+    {
+        local_printf("Failed to allocate frame");
+        /* The other tile times out and fails */
+        return -1;
+    }
+
+    xTaskCreate((TaskFunction_t)bulk_thread,
+                "mux_bulk",
+                RTOS_THREAD_STACK_SIZE(bulk_thread),
+                &args,
+                configMAX_PRIORITIES/2,
+                &bulk_handle);
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    {
+        /* A message longer than the channel allows is refused */
+        if (rtos_intertile_mux_tx(&mux, MUX_CTRL_CHAN, args.frame, MUX_CTRL_MAX_LEN + 1, RTOS_OSAL_WAIT_FOREVER) != 0)
+        {
+            local_printf("Message longer than the channel maximum was sent");
+            ret = -1;
+        }
+
+        /* Control messages are sent while the bulk frames are streaming */
+        for (uint32_t i = 0; i < MUX_CTRL_MSGS; i++)
+        {
+            rtos_intertile_mux_tx(&mux, MUX_CTRL_CHAN, &i, sizeof(i), RTOS_OSAL_WAIT_FOREVER);
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    {
+        for (uint32_t i = 0; i < MUX_CTRL_MSGS && ret == 0; i++)
+        {
+            uint32_t *msg = NULL;
+            size_t len = rtos_intertile_mux_rx(&mux, MUX_CTRL_CHAN, (void **) &msg, RTOS_OSAL_WAIT_MS(1000));
+
+            if (len != sizeof(uint32_t) || *msg != i)
+            {
+                local_printf("RX control message %u failed.  Got len %u", i, len);
+                ret = -1;
+            }
+            rtos_osal_free(msg);
+        }
+    }
+    #endif
+
+    if (xTaskNotifyWait(0x00000000UL, 0xFFFFFFFFUL, &result, pdMS_TO_TICKS(5000)) == pdFALSE || result != 0)
+    {
+        local_printf("Bulk thread failed");
+        ret = -1;
+    }
+    vTaskDelete(bulk_handle);
+    rtos_osal_free(args.frame);
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    if (ret == 0)
+    {
+        rtos_intertile_mux_stats_t bulk;
+        rtos_intertile_mux_stats_t ctrl;
+        uint32_t bulk_mean;
+
+        rtos_intertile_mux_stats_get(&mux, MUX_BULK_CHAN, &bulk);
+        rtos_intertile_mux_stats_get(&mux, MUX_CTRL_CHAN, &ctrl);
+        bulk_mean = bulk.latency_total / bulk.tx_messages;
+
+        local_printf("Bulk: %u frames in %u chunks, queue depth max %u, credit waits %u, latency mean %u max %u ticks",
+                     bulk.tx_messages, bulk.tx_chunks, bulk.tx_queue_depth_max, bulk.credit_waits,
+                     bulk_mean, bulk.latency_max);
+        local_printf("Control: %u messages, latency mean %u max %u ticks",
+                     ctrl.tx_messages, (uint32_t) (ctrl.latency_total / ctrl.tx_messages), ctrl.latency_max);
+
+        /* A control message waits for at most one chunk, much less than a whole frame */
+        if (ctrl.latency_max >= bulk_mean)
+        {
+            local_printf("Control latency not bounded by the bulk chunk size");
+            ret = -1;
+        }
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    if (ret == 0)
+    {
+        rtos_intertile_mux_stats_t bulk;
+        rtos_intertile_mux_stats_t ctrl;
+
+        rtos_intertile_mux_stats_get(&mux, MUX_BULK_CHAN, &bulk);
+        rtos_intertile_mux_stats_get(&mux, MUX_CTRL_CHAN, &ctrl);
+
+        if (bulk.rx_dropped != 0 || ctrl.rx_dropped != 0)
+        {
+            local_printf("Dropped %u bulk and %u control messages", bulk.rx_dropped, ctrl.rx_dropped);
+            ret = -1;
+        }
+    }
+    #endif
+
+    if (ret == 0)
+    {
+        local_printf("Done");
+    }
+    return ret;
+}
+
+void register_mux_priority_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,272 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+
+/* Library headers */
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+#include "rtos_intertile_sg.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "sg_throughput_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+/* Core clock set by XCORE-AI-EXPLORER.xn, used to convert time to cycles */
+#define INTERTILE_BENCH_CORE_MHZ    600
+
+#define INTERTILE_BENCH_MAX_LEN     (64 * 1024)
+#define INTERTILE_BENCH_SIZES       8
+
+static const size_t bench_sizes[INTERTILE_BENCH_SIZES] = {
+    4, 16, 64, 256, 1024, 4096, 16384, INTERTILE_BENCH_MAX_LEN
+};
+
+typedef enum {
+    BENCH_COPY,     /* rtos_intertile_tx() of a staged copy, rtos_intertile_rx() then copy out */
+    BENCH_SG,       /* rtos_intertile_sg_tx() of header and payload, rtos_intertile_sg_rx() in place */
+    BENCH_LOAN,     /* rtos_intertile_sg_tx() of header and payload, rtos_intertile_sg_rx_loan() */
+    BENCH_METHODS
+} bench_method_t;
+
+static const char *const method_names[BENCH_METHODS] = {"copy", "sg", "loan"};
+
+typedef struct {
+    uint32_t seq;
+    uint32_t len;
+} bench_hdr_t;
+
+static int bench_iters(size_t len)
+{
+    return len <= 1024 ? 256 : (256 * 1024) / len;
+}
+
+static uint8_t bench_byte(size_t len, size_t i)
+{
+    return (uint8_t) (i * 13 + len);
+}
+
+#if ON_TILE(INTERTILE_TX_TILE)
+static void bench_tx(intertile_test_ctx_t *ctx, bench_method_t method, size_t len, const uint8_t *payload, uint8_t *stage)
+{
+    bench_hdr_t hdr = {0, len};
+    const int iters = bench_iters(len);
+
+    for (int i = 0; i < iters; i++)
+    {
+        hdr.seq = i;
+        if (method == BENCH_COPY)
+        {
+            memcpy(stage, &hdr, sizeof(hdr));
+            memcpy(stage + sizeof(hdr), payload, len);
+            rtos_intertile_tx(ctx->intertile_ctx, INTERTILE_RPC_PORT, stage, sizeof(hdr) + len);
+        } else {
+            const rtos_intertile_iov_t iov[2] = {
+                {&hdr, sizeof(hdr)},
+                {payload, len},
+            };
+            rtos_intertile_sg_tx(ctx->intertile_ctx, INTERTILE_RPC_PORT, iov, 2);
+        }
+    }
+}
+#endif
+
+#if ON_TILE(INTERTILE_RX_TILE)
+static int bench_check(const uint8_t *msg, size_t msg_len, int seq, size_t len)
+{
+    const bench_hdr_t *hdr = (const bench_hdr_t *) msg;
+
+    if (msg_len != sizeof(bench_hdr_t) + len || hdr->seq != seq || hdr->len != len)
+    {
+        local_printf("RX failed.  Got seq %u len %u expected seq %d len %u", hdr->seq, msg_len, seq, sizeof(bench_hdr_t) + len);
+        return -1;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (msg[sizeof(bench_hdr_t) + i] != bench_byte(len, i))
+        {
+            local_printf("RX failed at index %u of %u byte message", i, len);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int bench_rx(intertile_test_ctx_t *ctx, bench_method_t method, size_t len, uint8_t *dest, rtos_intertile_sg_pool_t *pool)
+{
+    const int iters = bench_iters(len);
+    uint32_t start = 0;
+    uint32_t ticks;
+    uint64_t bytes;
+
+    for (int i = 0; i < iters; i++)
+    {
+        const int last = (i == iters - 1);
+        size_t msg_len;
+        uint8_t *msg;
+
+        switch (method)
+        {
+        case BENCH_COPY:
+            msg_len = rtos_intertile_rx(ctx->intertile_ctx, INTERTILE_RPC_PORT, (void **) &msg, RTOS_OSAL_WAIT_MS(1000));
+            if (msg_len == 0)
+            {
+                local_printf("RX timed out");
+                return -1;
+            }
+            memcpy(dest, msg, msg_len);
+            rtos_osal_free(msg);
+            break;
+
+        case BENCH_SG:
+            msg_len = rtos_intertile_sg_rx(ctx->intertile_ctx, INTERTILE_RPC_PORT, dest, sizeof(bench_hdr_t) + INTERTILE_BENCH_MAX_LEN, RTOS_OSAL_WAIT_MS(1000));
+            if (msg_len == 0)
+            {
+                local_printf("RX timed out");
+                return -1;
+            }
+            break;
+
+        default:
+            msg = rtos_intertile_sg_rx_loan(ctx->intertile_ctx, INTERTILE_RPC_PORT, pool, &msg_len, RTOS_OSAL_WAIT_MS(1000));
+            if (msg == NULL)
+            {
+                local_printf("RX timed out");
+                return -1;
+            }
+            if (last && bench_check(msg, msg_len, i, len) != 0)
+            {
+                return -1;
+            }
+            rtos_intertile_sg_pool_release(pool, msg);
+            break;
+        }
+
+        /* Timing starts once the first message has arrived */
+        if (i == 0)
+        {
+            start = get_reference_time();
+        }
+
+        if (last && method != BENCH_LOAN && bench_check(dest, msg_len, i, len) != 0)
+        {
+            return -1;
+        }
+    }
+
+    ticks = get_reference_time() - start;
+    bytes = (uint64_t) (iters - 1) * len;
+
+    local_printf("RX %s %u B: %u.%02u MB/s, %u.%02u cycles/B",
+                 method_names[method],
+                 len,
+                 (unsigned) (bytes * 100 / ticks),
+                 (unsigned) ((bytes * 10000 / ticks) % 100),
+                 (unsigned) ((uint64_t) ticks * INTERTILE_BENCH_CORE_MHZ / 100 / bytes),
+                 (unsigned) (((uint64_t) ticks * INTERTILE_BENCH_CORE_MHZ / bytes) % 100));
+
+    return 0;
+}
+#endif
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    int ret = 0;
+
+    local_printf("Start");
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    {
+        uint8_t *payload = rtos_osal_malloc(INTERTILE_BENCH_MAX_LEN);
+        uint8_t *stage = rtos_osal_malloc(sizeof(bench_hdr_t) + INTERTILE_BENCH_MAX_LEN);
+
+        if (payload == NULL || stage == NULL)
+        {
+            local_printf("TX failed to allocate buffers");
+            /* The receiver times out and fails */
+            ret = -1;
+        } else {
+            for (int s = 0; s < INTERTILE_BENCH_SIZES; s++)
+            {
+                const size_t len = bench_sizes[s];
+
+                for (size_t i = 0; i < len; i++)
+                {
+                    payload[i] = bench_byte(len, i);
+                }
+
+                for (int m = 0; m < BENCH_METHODS; m++)
+                {
+                    bench_tx(ctx, m, len, payload, stage);
+                }
+            }
+            local_printf("TX done");
+        }
+
+        rtos_osal_free(payload);
+        rtos_osal_free(stage);
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    {
+        const size_t buf_size = sizeof(bench_hdr_t) + INTERTILE_BENCH_MAX_LEN;
+        uint8_t *dest = rtos_osal_malloc(buf_size);
+        uint8_t *pool_storage = rtos_osal_malloc(buf_size);
+        rtos_intertile_sg_pool_t pool;
+
+        if (dest == NULL || pool_storage == NULL)
+        {
+            local_printf("RX failed to allocate buffers");
+            ret = -1;
+        } else {
+            rtos_intertile_sg_pool_init(&pool, pool_storage, buf_size, 1);
+
+            for (int s = 0; s < INTERTILE_BENCH_SIZES && ret == 0; s++)
+            {
+                for (int m = 0; m < BENCH_METHODS && ret == 0; m++)
+                {
+                    ret = bench_rx(ctx, m, bench_sizes[s], dest, &pool);
+                }
+            }
+        }
+
+        rtos_osal_free(dest);
+        rtos_osal_free(pool_storage);
+    }
+    #endif
+
+    if (ret == 0)
+    {
+        local_printf("Done");
+    }
+    return ret;
+}
+
+void register_sg_throughput_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
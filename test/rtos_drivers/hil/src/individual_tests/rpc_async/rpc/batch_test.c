@@ -0,0 +1,187 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_gpio.h"
+#include "rtos_rpc_async.h"
+#include "rtos_rpc_async_drivers.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/gpio/gpio_test.h"
+#include "individual_tests/rpc_async/rpc_async_test.h"
+
+static const char* test_name = "rpc_batch_test";
+
+#define local_printf( FMT, ... )    rpc_async_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define RPC_BATCH_TEST_CALLS    40
+#define RPC_BATCH_TEST_RESP_MAX 32
+
+#if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+static uint8_t resp_buf[RPC_BATCH_TEST_CALLS][RPC_BATCH_TEST_RESP_MAX];
+static rtos_rpc_future_t futures[RPC_BATCH_TEST_CALLS];
+
+static int echo_test(rtos_rpc_async_client_t *client)
+{
+    uint8_t req[RPC_BATCH_TEST_RESP_MAX + 1];
+    rtos_rpc_async_client_stats_t stats;
+
+    for (int i = 0; i < RPC_BATCH_TEST_CALLS; i++)
+    {
+        size_t len = i % sizeof(req);
+
+        for (size_t j = 0; j < len; j++)
+        {
+            req[j] = i + j;
+        }
+        rtos_rpc_async_call(client, &futures[i], RPC_ASYNC_TEST_FCODE_ECHO,
+                            req, len, resp_buf[i], RPC_BATCH_TEST_RESP_MAX);
+    }
+
+    /* Waiting on the last call completes all the others */
+    for (int i = RPC_BATCH_TEST_CALLS - 1; i >= 0; i--)
+    {
+        size_t len = i % sizeof(req);
+        size_t expected = len < RPC_BATCH_TEST_RESP_MAX ? len : RPC_BATCH_TEST_RESP_MAX;
+        int status = rtos_rpc_future_wait(client, &futures[i], RTOS_OSAL_WAIT_MS(100));
+
+        if (status != (int) len)
+        {
+            local_printf("CLIENT echo %d failed with status %d", i, status);
+            return -1;
+        }
+        if (rtos_rpc_future_resp_len(&futures[i]) != expected)
+        {
+            local_printf("CLIENT echo %d got %u bytes expected %u", i, rtos_rpc_future_resp_len(&futures[i]), expected);
+            return -1;
+        }
+        for (size_t j = 0; j < expected; j++)
+        {
+            if (resp_buf[i][j] != (uint8_t) (i + j))
+            {
+                local_printf("CLIENT echo %d byte %u got 0x%x expected 0x%x", i, j, resp_buf[i][j], (uint8_t) (i + j));
+                return -1;
+            }
+        }
+    }
+
+    rtos_rpc_async_client_stats_get(client, &stats);
+    local_printf("CLIENT %u calls in %u batches", stats.calls, stats.batches);
+    if (stats.batches >= stats.calls)
+    {
+        local_printf("CLIENT calls were not batched");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int error_test(rtos_rpc_async_client_t *client)
+{
+    static uint8_t too_big[RTOS_RPC_ASYNC_BATCH_BYTES];
+    int status;
+
+    rtos_rpc_async_call(client, &futures[0], RTOS_RPC_ASYNC_FCODE_COUNT - 1, NULL, 0, NULL, 0);
+    status = rtos_rpc_future_wait(client, &futures[0], RTOS_OSAL_WAIT_MS(100));
+    if (status != RTOS_RPC_ASYNC_ERR_FCODE)
+    {
+        local_printf("CLIENT unregistered fcode got status %d", status);
+        return -1;
+    }
+
+    rtos_rpc_async_call(client, &futures[0], RPC_ASYNC_TEST_FCODE_ECHO, too_big, sizeof(too_big), NULL, 0);
+    if (!rtos_rpc_future_done(&futures[0]) ||
+        rtos_rpc_future_wait(client, &futures[0], 0) != RTOS_RPC_ASYNC_ERR_SIZE)
+    {
+        local_printf("CLIENT oversized call was not rejected");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int gpio_test(rtos_rpc_async_client_t *client, rtos_gpio_t *gpio_ctx)
+{
+    const rtos_gpio_port_id_t p_test_output = rtos_gpio_port(OUTPUT_PORT);
+    uint32_t after = 0;
+    uint32_t val;
+
+    /* All three calls go in one batch and run in order */
+    rtos_rpc_async_gpio_port_out(client, &futures[0], p_test_output, 1 << OUTPUT_PORT_PIN_OFFSET);
+    rtos_rpc_async_gpio_port_in(client, &futures[1], p_test_output, &after);
+    rtos_rpc_async_gpio_port_out(client, &futures[2], p_test_output, 0);
+
+    if (rtos_rpc_future_wait(client, &futures[2], RTOS_OSAL_WAIT_MS(100)) != 0 ||
+        !rtos_rpc_future_done(&futures[0]) ||
+        !rtos_rpc_future_done(&futures[1]))
+    {
+        local_printf("CLIENT gpio calls failed");
+        return -1;
+    }
+
+    after &= (1 << OUTPUT_PORT_PIN_OFFSET);
+    if (after != (1 << OUTPUT_PORT_PIN_OFFSET))
+    {
+        local_printf("CLIENT gpio read after write got 0x%x", after);
+        return -1;
+    }
+
+    /* Check against the driver's own RPC */
+    val = rtos_gpio_port_in(gpio_ctx, p_test_output) & (1 << OUTPUT_PORT_PIN_OFFSET);
+    if (val != 0)
+    {
+        local_printf("CLIENT gpio blocking read got 0x%x expected 0", val);
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+RPC_ASYNC_MAIN_TEST_ATTR
+static int main_test(rpc_async_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+    {
+        if (echo_test(&ctx->client) != 0)
+        {
+            return -1;
+        }
+        if (error_test(&ctx->client) != 0)
+        {
+            return -1;
+        }
+        if (gpio_test(&ctx->client, ctx->gpio_ctx) != 0)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_rpc_batch_test(rpc_async_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
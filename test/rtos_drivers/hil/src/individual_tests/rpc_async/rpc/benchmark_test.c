@@ -0,0 +1,162 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_gpio.h"
+#include "rtos_rpc_async.h"
+#include "rtos_rpc_async_drivers.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/gpio/gpio_test.h"
+#include "individual_tests/rpc_async/rpc_async_test.h"
+
+static const char* test_name = "rpc_benchmark_test";
+
+#define local_printf( FMT, ... )    rpc_async_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define RPC_BENCH_CALLS     64
+
+/* Reference clock ticks to nanoseconds per call */
+#define NS_PER_CALL(ticks)  ((ticks) * (1000000000 / PLATFORM_REFERENCE_HZ) / RPC_BENCH_CALLS)
+
+#if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+static rtos_rpc_future_t futures[RPC_BENCH_CALLS];
+static uint32_t values[RPC_BENCH_CALLS];
+
+/* One echo call at a time, each waited on before the next */
+static int bench_echo_latency(rtos_rpc_async_client_t *client, uint32_t *ticks)
+{
+    const uint32_t start = get_reference_time();
+    uint32_t req = 0;
+    uint32_t resp;
+
+    for (int i = 0; i < RPC_BENCH_CALLS; i++)
+    {
+        rtos_rpc_async_call(client, &futures[0], RPC_ASYNC_TEST_FCODE_ECHO, &req, sizeof(req), &resp, sizeof(resp));
+        if (rtos_rpc_future_wait(client, &futures[0], RTOS_OSAL_WAIT_MS(100)) != sizeof(req))
+        {
+            return -1;
+        }
+    }
+
+    *ticks = get_reference_time() - start;
+    return 0;
+}
+
+/* The GPIO driver's own blocking RPC */
+static int bench_gpio_blocking(rtos_gpio_t *gpio_ctx, uint32_t *ticks)
+{
+    const rtos_gpio_port_id_t p = rtos_gpio_port(OUTPUT_PORT);
+    const uint32_t start = get_reference_time();
+
+    for (int i = 0; i < RPC_BENCH_CALLS; i++)
+    {
+        values[i] = rtos_gpio_port_in(gpio_ctx, p);
+    }
+
+    *ticks = get_reference_time() - start;
+    return 0;
+}
+
+/* Reads sent batch_size at a time, each batch queued while the one before is in flight */
+static int bench_gpio_async(rtos_rpc_async_client_t *client, int batch_size, uint32_t *ticks)
+{
+    const rtos_gpio_port_id_t p = rtos_gpio_port(OUTPUT_PORT);
+    const uint32_t start = get_reference_time();
+
+    for (int i = 0; i < RPC_BENCH_CALLS; i++)
+    {
+        rtos_rpc_async_gpio_port_in(client, &futures[i], p, &values[i]);
+        if ((i + 1) % batch_size == 0)
+        {
+            rtos_rpc_async_flush(client);
+        }
+    }
+
+    if (rtos_rpc_future_wait(client, &futures[RPC_BENCH_CALLS - 1], RTOS_OSAL_WAIT_MS(100)) != 0)
+    {
+        return -1;
+    }
+
+    *ticks = get_reference_time() - start;
+
+    for (int i = 0; i < RPC_BENCH_CALLS; i++)
+    {
+        if (!rtos_rpc_future_done(&futures[i]))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+RPC_ASYNC_MAIN_TEST_ATTR
+static int main_test(rpc_async_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+    {
+        static const int batch_sizes[] = {1, 4, 16};
+        uint32_t ticks;
+        uint32_t blocking_ns;
+        uint32_t batched_ns = 0;
+
+        if (bench_echo_latency(&ctx->client, &ticks) != 0)
+        {
+            local_printf("CLIENT echo failed");
+            return -1;
+        }
+        local_printf("CLIENT echo round trip %u ns", NS_PER_CALL(ticks));
+
+        bench_gpio_blocking(ctx->gpio_ctx, &ticks);
+        blocking_ns = NS_PER_CALL(ticks);
+        local_printf("CLIENT gpio port_in blocking rpc %u ns/call", blocking_ns);
+
+        for (int i = 0; i < (int) (sizeof(batch_sizes) / sizeof(batch_sizes[0])); i++)
+        {
+            if (bench_gpio_async(&ctx->client, batch_sizes[i], &ticks) != 0)
+            {
+                local_printf("CLIENT gpio async batch %d failed", batch_sizes[i]);
+                return -1;
+            }
+            batched_ns = NS_PER_CALL(ticks);
+            local_printf("CLIENT gpio port_in async batch %d %u ns/call", batch_sizes[i], batched_ns);
+        }
+
+        if (batched_ns >= blocking_ns)
+        {
+            local_printf("CLIENT batched calls were not faster than blocking calls");
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_rpc_benchmark_test(rpc_async_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,116 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_gpio.h"
+#include "rtos_intertile.h"
+#include "rtos_rpc_async.h"
+#include "rtos_rpc_async_drivers.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/rpc_async/rpc_async_test.h"
+
+#if ON_TILE(RPC_ASYNC_HOST_TILE)
+RTOS_RPC_ASYNC_HANDLER_ATTR
+static int echo_handler(void *arg, const void *req, size_t req_len, void *resp, size_t *resp_len)
+{
+    if (req_len < *resp_len) {
+        *resp_len = req_len;
+    }
+    memcpy(resp, req, *resp_len);
+
+    return req_len;
+}
+#endif
+
+static int run_rpc_async_tests(rpc_async_test_ctx_t *test_ctx, chanend_t c)
+{
+    int retval = 0;
+
+    do
+    {
+        sync(c);
+        if (test_ctx->main_test[test_ctx->cur_test] != NULL)
+        {
+            RPC_ASYNC_MAIN_TEST_ATTR rpc_async_main_test_t fn;
+            fn = test_ctx->main_test[test_ctx->cur_test];
+            int tmp = fn(test_ctx);
+            retval = (retval != -1) ? tmp : retval;
+        } else {
+            rpc_async_printf("Missing main_test callback on test %d", test_ctx->cur_test);
+            retval = -1;
+        }
+    } while (++test_ctx->cur_test < test_ctx->test_cnt);
+
+    return retval;
+}
+
+static void start_rpc_async_devices(rpc_async_test_ctx_t *test_ctx)
+{
+#if ON_TILE(RPC_ASYNC_HOST_TILE)
+    rpc_async_printf("HOST start");
+    rtos_rpc_async_host_init(&test_ctx->host, test_ctx->intertile_ctx, RPC_ASYNC_PORT);
+    rtos_rpc_async_gpio_host_register(&test_ctx->host, test_ctx->gpio_ctx);
+    rtos_rpc_async_host_register(&test_ctx->host, RPC_ASYNC_TEST_FCODE_ECHO, echo_handler, NULL);
+    rtos_rpc_async_host_start(&test_ctx->host, RPC_ASYNC_HOST_TASK_PRIORITY);
+#endif
+
+#if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+    rpc_async_printf("CLIENT init");
+    rtos_rpc_async_client_init(&test_ctx->client, test_ctx->intertile_ctx, RPC_ASYNC_PORT);
+#endif
+
+    rpc_async_printf("Devices setup done");
+}
+
+static void register_rpc_async_tests(rpc_async_test_ctx_t *test_ctx)
+{
+    register_rpc_batch_test(test_ctx);
+    register_rpc_benchmark_test(test_ctx);
+}
+
+static void rpc_async_init_tests(rpc_async_test_ctx_t *test_ctx, rtos_intertile_t *intertile_ctx, rtos_gpio_t *gpio_ctx)
+{
+    memset(test_ctx, 0, sizeof(rpc_async_test_ctx_t));
+    test_ctx->intertile_ctx = intertile_ctx;
+    test_ctx->gpio_ctx = gpio_ctx;
+
+    test_ctx->cur_test = 0;
+    test_ctx->test_cnt = 0;
+
+    register_rpc_async_tests(test_ctx);
+    configASSERT(test_ctx->test_cnt <= RPC_ASYNC_MAX_TESTS);
+}
+
+int rpc_async_device_tests(rtos_intertile_t *intertile_ctx, rtos_gpio_t *gpio_ctx, chanend_t c)
+{
+    /* The host task keeps using the context after the tests return */
+    static rpc_async_test_ctx_t test_ctx;
+    int res = 0;
+
+    sync(c);
+    rpc_async_printf("Init test context");
+    rpc_async_init_tests(&test_ctx, intertile_ctx, gpio_ctx);
+    rpc_async_printf("Test context init");
+
+    sync(c);
+    rpc_async_printf("Start devices");
+    start_rpc_async_devices(&test_ctx);
+    rpc_async_printf("Devices started");
+
+    sync(c);
+    rpc_async_printf("Start tests");
+    res = run_rpc_async_tests(&test_ctx, c);
+
+    sync(c);   // Sync before return
+    return res;
+}
@@ -0,0 +1,51 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RPC_ASYNC_TEST_H_
+#define RPC_ASYNC_TEST_H_
+
+#include "rtos_test/rtos_test_utils.h"
+#include "rtos_rpc_async.h"
+
+#define rpc_async_printf( FMT, ... )       module_printf("RPC_ASYNC", FMT, ##__VA_ARGS__)
+
+#define RPC_ASYNC_MAX_TESTS   2
+
+#define RPC_ASYNC_MAIN_TEST_ATTR      __attribute__((fptrgroup("rtos_test_rpc_async_main_test_fptr_grp")))
+
+/* The host runs on the tile that owns the GPIO driver instance */
+#define RPC_ASYNC_HOST_TILE     1
+#define RPC_ASYNC_CLIENT_TILE   0
+
+/* Echoes the request back as the response and returns its length */
+#define RPC_ASYNC_TEST_FCODE_ECHO   (RTOS_RPC_ASYNC_FCODE_USER + 0)
+
+typedef struct rpc_async_test_ctx rpc_async_test_ctx_t;
+
+struct rpc_async_test_ctx {
+    uint32_t cur_test;
+    uint32_t test_cnt;
+    char *name[RPC_ASYNC_MAX_TESTS];
+
+    rtos_intertile_t *intertile_ctx;
+    rtos_gpio_t *gpio_ctx;
+
+#if ON_TILE(RPC_ASYNC_HOST_TILE)
+    rtos_rpc_async_host_t host;
+#endif
+#if ON_TILE(RPC_ASYNC_CLIENT_TILE)
+    rtos_rpc_async_client_t client;
+#endif
+
+    RPC_ASYNC_MAIN_TEST_ATTR int (*main_test[RPC_ASYNC_MAX_TESTS])(rpc_async_test_ctx_t *ctx);
+};
+
+typedef int (*rpc_async_main_test_t)(rpc_async_test_ctx_t *ctx);
+
+int rpc_async_device_tests(rtos_intertile_t *intertile_ctx, rtos_gpio_t *gpio_ctx, chanend_t c);
+
+/* RPC Tests */
+void register_rpc_batch_test(rpc_async_test_ctx_t *test_ctx);
+void register_rpc_benchmark_test(rpc_async_test_ctx_t *test_ctx);
+
+#endif /* RPC_ASYNC_TEST_H_ */
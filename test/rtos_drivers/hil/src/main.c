@@ -17,6 +17,7 @@
 #include "rtos_intertile.h"
 #include "rtos_mic_array.h"
 #include "rtos_qspi_flash.h"
+#include "rtos_rpc_async.h"
 
 /* App headers */
 #include "app_conf.h"
@@ -85,6 +86,17 @@ void vApplicationDaemonTaskStartup(void *arg)
         test_printf("SKIP GPIO");
     }
 
+    if (RUN_RPC_ASYNC_TESTS) {
+        if (rpc_async_device_tests(intertile_ctx, gpio_ctx, other_tile_c) != 0)
+        {
+            test_printf("FAIL RPC_ASYNC");
+        } else {
+            test_printf("PASS RPC_ASYNC");
+        }
+    } else {
+        test_printf("SKIP RPC_ASYNC");
+    }
+
     if (RUN_I2C_TESTS) {
         if (i2c_device_tests(i2c_master_ctx, i2c_slave_ctx, other_tile_c) != 0)
         {
@@ -5,3 +5,13 @@ include(${CMAKE_CURRENT_LIST_DIR}/rtos_drivers/hil/hil.cmake)
 include(${CMAKE_CURRENT_LIST_DIR}/rtos_drivers/hil_add/hil_add.cmake)
 include(${CMAKE_CURRENT_LIST_DIR}/rtos_drivers/usb/usb.cmake)
 include(${CMAKE_CURRENT_LIST_DIR}/rtos_drivers/wifi/wifi.cmake)
+
+## Add module tests
+include(${CMAKE_CURRENT_LIST_DIR}/modules/shared/module_test.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/bm_pipeline/bm_pipeline.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/bm_worker_pool/bm_worker_pool.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/button_engine/button_engine.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/dvfs/dvfs.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/heap/heap.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/sample_rate_conversion/sample_rate_conversion.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/modules/trace_stream/trace_stream.cmake)
@@ -12,9 +12,22 @@ mkdir -p ${DIST_DIR}
 # row format is: "target     copy_path"
 applications=(
     "example_freertos_device_control_host   examples/freertos/device_control/host"
+    "example_freertos_iot_mqtt_router_bench examples/freertos/iot/host"
     "fatfs_mkimage                          modules/rtos/modules/sw_services/fatfs/host"
     "xscope_host_endpoint                   modules/xscope_fileio/xscope_fileio/host"
     "xscope2psf                             examples/freertos/tracealyzer/host"
+    "xscope2metrics                         modules/metrics/host"
+    "src_bench                              modules/sample_rate_conversion/host"
+    "src_rate_est_sim                       modules/sample_rate_conversion/host"
+    "qspi_flash_cal_sim                     modules/qspi_flash_cal/host"
+    "example_freertos_usb_msc_flash_bench   examples/freertos/usb/host"
+    "example_freertos_usb_dfu_stream_bench  examples/freertos/usb/host"
+    "example_freertos_usb_boot_image_diff   examples/freertos/usb/host"
+    "example_freertos_usb_boot_image_patch_bench examples/freertos/usb/host"
+    "example_freertos_usb_class_bench_msc   examples/freertos/usb/host"
+    "example_freertos_usb_class_bench_cdc   examples/freertos/usb/host"
+    "example_freertos_usb_class_bench_uac2  examples/freertos/usb/host"
+    "example_freertos_usb_class_bench_video examples/freertos/usb/host"
 )
 
 # perform builds
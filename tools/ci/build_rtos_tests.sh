@@ -17,6 +17,13 @@ applications=(
     "test_rtos_driver_hil_add             XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "test_rtos_driver_usb                 XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "test_rtos_driver_wifi                XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_bm_pipeline_benchmark           XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_bm_worker_pool_benchmark        XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_button_engine                   XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_dvfs_governor                   XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_heap_benchmark                  XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_sample_rate_conversion_benchmark  XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "test_trace_stream_benchmark          XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
 )
 
 # perform builds
@@ -22,6 +22,7 @@ demos=(
     "example_freertos_usb_tusb_demo_hid_multiple_interface  XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "example_freertos_usb_tusb_demo_midi_test               XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "example_freertos_usb_tusb_demo_msc_dual_lun            XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
+    "example_freertos_usb_tusb_demo_msc_flash               XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "example_freertos_usb_tusb_demo_uac2_headset            XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "example_freertos_usb_tusb_demo_usbtmc                  XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"
     "example_freertos_usb_tusb_demo_video_capture           XCORE-AI-EXPLORER  xmos_cmake_toolchain/xs3a.cmake"